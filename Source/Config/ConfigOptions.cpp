@@ -32,8 +32,12 @@ u32		gSpeedSyncEnabled			= 0;		// Enable to limit frame rate.
 bool	gDynarecEnabled				= true;		// Use dynamic recompilation
 bool	gDynarecLoopOptimisation	= false;	// Enable the dynarec loop optmisation
 bool	gDynarecDoublesOptimisation	= false;	// Enable the dynarec Doubles optmisation
+bool	gCachedInterpreterEnabled	= true;		// Use the pre-decoded interpreter when the dynarec is off
+bool	gBatchCycleAccounting		= true;		// Update COUNT/events in batches while interpreting with the dynarec on
 bool	gOSHooksEnabled				= true;		// Apply os-hooks
 u32		gCheckTextureHashFrequency	= 0;		// How often to check textures for updates (every N frames, 0 to disable)
+u32		gRewindInterval				= 0;		// How often to capture a rewind snapshot (every N VIs, 0 to disable). Each capture is a full savestate, so it's off by default
+u32		gRewindBufferSize			= 64;		// Memory for rewind history, in MB
 bool	gDoubleDisplayEnabled		= true;		// Workaround for games that have shaking issues
 bool	gCleanSceneEnabled			= false;	// Clean our Scenes, it gets rid of many glitches
 bool	gClearDepthFrameBuffer		= false;	// Clears depth frame buffer, fixes shaky camera in DK64 and sun/flame glare in Zelda
@@ -41,7 +45,10 @@ bool	gAudioRateMatch				= false;	// Matches audio rate with framerate, only work
 bool	gVideoRateMatch				= false;	// Matches VI rate with framerate
 bool	gFogEnabled					= false;	// Enable fog
 bool    gMemoryAccessOptimisation   = false;    // Enable the memory access optmisation
+bool	gFastmemEnabled				= false;	// Access RDRAM through the fastmem mirrors (Core/Fastmem.h)
 bool	gCheatsEnabled				= false;	// Enable cheat codes
+bool	gHeadlessGraphics			= false;	// Render to a hidden window with vsync off
+bool	gRenderThreadEnabled		= false;	// Hand display lists' GL work to a render thread (SysGL/HLEGraphics/RenderThreadGL.h)
 u32		gControllerIndex			= 0;		// Which controller config to set
 
 DaedalusConfig g_DaedalusConfig;
@@ -39,6 +39,8 @@ extern DaedalusConfig	g_DaedalusConfig;
 extern bool gDynarecEnabled;			// Use dynamic recompilation
 extern bool gDynarecLoopOptimisation;	// Enable the dynarec loop optmisation
 extern bool gDynarecDoublesOptimisation;	// Enable the dynarec loop optmisation
+extern bool gCachedInterpreterEnabled;	// Use the pre-decoded interpreter when the dynarec is off
+extern bool gBatchCycleAccounting;		// Update COUNT/events in batches while interpreting with the dynarec on
 extern bool gOSHooksEnabled;			// Apply os-hooks
 extern u32	gSpeedSyncEnabled;
 extern bool gDoubleDisplayEnabled;
@@ -46,11 +48,16 @@ extern bool gAudioRateMatch;
 extern bool gVideoRateMatch;
 extern bool gFogEnabled;
 extern bool gMemoryAccessOptimisation;
+extern bool gFastmemEnabled;			// Access RDRAM through the fastmem mirrors, if the platform has them. Read by Memory_Init
 extern bool gCheatsEnabled;
+extern bool gHeadlessGraphics;			// Hidden window and no vsync, for benchmarks. Read by the graphics context when it's created
+extern bool gRenderThreadEnabled;		// Issue GL calls from a render thread. Read by the graphics plugin when a rom starts
 //ToDo: Needs moving to Graphics plugin config
 extern bool	gCleanSceneEnabled;
 extern bool	gClearDepthFrameBuffer;
 extern u32	gCheckTextureHashFrequency;
+extern u32	gRewindInterval;
+extern u32	gRewindBufferSize;
 //ToDo: Needs moving to Input plugin config
 extern u32	gControllerIndex;
 
@@ -38,6 +38,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define	DAEDALUS_ENABLE_ASSERTS				// Enable asserts
 //#define	DAEDALUS_ENABLE_PROFILING			// Enable the built-in profiler
 //#define	DAEDALUS_PROFILE_EXECUTION			// Enable to keep track of various execution stats
+//#define	DAEDALUS_CAPTURE_EVENT_TRACE		// Enable to write CPU event queue operations to event_trace.txt (see Core/CPUEventQueue_bench.cpp)
+//#define	DAEDALUS_CAPTURE_AUDIO_TRACE		// Enable to write audio HLE kernel inputs to audio_trace.bin (see HLEAudio/AudioHLEKernels_bench.cpp)
+//#define	DAEDALUS_VERIFY_AUDIO_TASKS		// Enable to check audio tasks run on the worker thread against synchronous runs (see HLEAudio/AudioHLETask.cpp)
+//#define	DAEDALUS_CAPTURE_JPEG_TASKS		// Enable to write JPEG tasks and the RDRAM they use to jpeg_tasks.bin (see Core/JpegTask_bench.cpp)
 #define	DAEDALUS_BATCH_TEST_ENABLED			// Enable the batch test
 //#define	ALLOW_TRACES_WHICH_EXCEPT
 #define	DAEDALUS_LOG							// Enable various logging
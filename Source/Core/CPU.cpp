@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // Stuff to handle Processor
 #include "stdafx.h"
 #include "CPU.h"
+#include "CPUEventQueue.h"
 
 #include <algorithm>
 #include <string>
@@ -33,6 +34,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "Memory.h"
 #include "R4300.h"
 #include "Registers.h"					// For REG_?? defines
+#include "Rewind.h"
 #include "ROM.h"
 #include "ROMBuffer.h"
 #include "RSP_HLE.h"
@@ -42,6 +44,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "Config/ConfigOptions.h"
 #include "Debug/DBGConsole.h"
 #include "Debug/DebugLog.h"
+#include "HLEAudio/AudioHLETask.h"
 #include "OSHLE/ultra_R4300.h"
 #include "System/System.h"
 #include "Utility/AtomicPrimitives.h"
@@ -85,6 +88,7 @@ enum ESaveStateOperation
 	SSO_NONE,
 	SSO_SAVE,
 	SSO_LOAD,
+	SSO_REWIND,
 };
 
 static ESaveStateOperation		gSaveStateOperation {SSO_NONE};
@@ -99,6 +103,9 @@ SCPUState *gPtrCPUState {(SCPUState*)0x10000};
 ALIGNED_GLOBAL(SCPUState, gCPUState, CACHE_ALIGN);
 #endif
 
+// Keeps gCPUState.Events[ 0 ] counting down to the earliest event
+static CCPUEventQueue	gEventQueue( gCPUState.Events[ 0 ], gCPUState.NumEvents );
+
 static bool	CPU_IsStateSimple()		   DAEDALUS_ATTRIBUTE_CONST;
 void (* g_pCPUCore)();
 
@@ -141,136 +148,95 @@ void CPU_SkipToNextEvent()
 	gCPUState.Events[ 0 ].mCount = 1;
 }
 
+#ifdef DAEDALUS_CAPTURE_EVENT_TRACE
+static FILE *		gEventTraceFile {};
+
+// One line per queue operation, in the format read by Core/CPUEventQueue_bench.cpp:
+//	<op> <time> <count> <event type>
+// where op is A(dd), C(ompare), P(op), R(emove) or V(bl count set from a savestate)
+static void CPU_TraceEvent( char op, s32 count, ECPUEventType event_type )
+{
+	if( gEventTraceFile != NULL )
+	{
+		fprintf( gEventTraceFile, "%c %lld %d %d\n", op, (long long)gEventQueue.GetTime(), count, event_type );
+	}
+}
+#endif
+
 static void CPU_ResetEventList()
 {
-	gCPUState.Events[ 0 ].mCount     = kInitialVIInterruptCycles;
-	gCPUState.Events[ 0 ].mEventType = CPU_EVENT_VBL;
-	gCPUState.NumEvents = 1;
+	gEventQueue.Reset();
+	gEventQueue.Add( kInitialVIInterruptCycles, CPU_EVENT_VBL );
 
 	RESET_EVENT_QUEUE_LOCK();
+
+#ifdef DAEDALUS_CAPTURE_EVENT_TRACE
+	if( gEventTraceFile != NULL )
+	{
+		fclose( gEventTraceFile );
+	}
+	gEventTraceFile = fopen( "event_trace.txt", "w" );
+	CPU_TraceEvent( 'A', kInitialVIInterruptCycles, CPU_EVENT_VBL );
+#endif
 }
 
 void CPU_AddEvent( s32 count, ECPUEventType event_type )
 {
 	LOCK_EVENT_QUEUE();
-#ifdef DAEDALUS_ENABLE_ASSERTS
-	DAEDALUS_ASSERT( count > 0, "Count is invalid" );
-	DAEDALUS_ASSERT( gCPUState.NumEvents < MAX_CPU_EVENTS, "Too many events" );
+
+#ifdef DAEDALUS_CAPTURE_EVENT_TRACE
+	CPU_TraceEvent( 'A', count, event_type );
 #endif
-	u32 event_idx {};
-	for( event_idx = 0; event_idx < gCPUState.NumEvents; ++event_idx )
-	{
-		CPUEvent & event = gCPUState.Events[ event_idx ];
+	gEventQueue.Add( count, event_type );
+}
 
-		if( count <= event.mCount )
-		{
-			//
-			//	This event belongs before the subsequent one so insert a space for it here and break out
-			//	Don't forget to decrement the counter for the subsequent event
-			//
-			event.mCount -= count;
-
-			u32 num_to_copy {gCPUState.NumEvents - event_idx};
-			if( num_to_copy > 0 )
-			{
-				memmove( &gCPUState.Events[ event_idx+1 ], &gCPUState.Events[ event_idx ], num_to_copy * sizeof( CPUEvent ) );
-			}
-			break;
-		}
+void CPU_RemoveEvent( ECPUEventType event_type )
+{
+	LOCK_EVENT_QUEUE();
 
-		//
-		//	Decrease counter by that for this event
-		//
-		count -= event.mCount;
-	}
-#ifdef DAEDALUS_ENABLE_ASSERTS
-	DAEDALUS_ASSERT( event_idx <= gCPUState.NumEvents, "Invalid idx" );
-	#endif
-	gCPUState.Events[ event_idx ].mCount = count;
-	gCPUState.Events[ event_idx ].mEventType = event_type;
-	gCPUState.NumEvents++;
+#ifdef DAEDALUS_CAPTURE_EVENT_TRACE
+	CPU_TraceEvent( 'R', 0, event_type );
+#endif
+	gEventQueue.Remove( event_type );
 }
 
 static void CPU_SetCompareEvent( s32 count )
 {
-	{
-		LOCK_EVENT_QUEUE();
+	LOCK_EVENT_QUEUE();
 
-#ifdef DAEDALUS_ENABLE_ASSERTS
-		DAEDALUS_ASSERT( count > 0, "Count is invalid" );
+#ifdef DAEDALUS_CAPTURE_EVENT_TRACE
+	CPU_TraceEvent( 'C', count, CPU_EVENT_COMPARE );
 #endif
-		//
-		//	Remove any existing compare events. Need to adjust any subsequent timer's count.
-		//
-		for( u32 i {}; i < gCPUState.NumEvents; ++i )
-		{
-			if( gCPUState.Events[ i ].mEventType == CPU_EVENT_COMPARE )
-			{
-				//
-				//	Check for a following event, and remove
-				//
-				if( i+1 < gCPUState.NumEvents )
-				{
-					gCPUState.Events[ i+1 ].mCount += gCPUState.Events[ i ].mCount;
-					u32 num_to_copy {gCPUState.NumEvents - (i+1)};
-					memmove( &gCPUState.Events[ i ], &gCPUState.Events[ i+1 ], num_to_copy * sizeof( CPUEvent ) );
-				}
-				gCPUState.NumEvents--;
-				break;
-			}
-		}
-	}
-
-	CPU_AddEvent( count, CPU_EVENT_COMPARE );
+	// Moves any existing compare event rather than removing it and adding a new one
+	gEventQueue.Reschedule( count, CPU_EVENT_COMPARE );
 }
 
 static ECPUEventType CPU_PopEvent()
 {
 	LOCK_EVENT_QUEUE();
 
-#ifdef DAEDALUS_ENABLE_ASSERTS
-	DAEDALUS_ASSERT( gCPUState.NumEvents > 0, "Event queue empty" );
-	DAEDALUS_ASSERT( gCPUState.Events[ 0 ].mCount <= 0, "Popping event when cycles remain" );
-	//DAEDALUS_ASSERT( gCPUState.Events[ 0 ].mCount == 0, "Popping event with a bit of underflow" );
+#ifdef DAEDALUS_CAPTURE_EVENT_TRACE
+	CPU_TraceEvent( 'P', 0, gCPUState.Events[ 0 ].mEventType );
 #endif
-
-	ECPUEventType event_type = gCPUState.Events[ 0 ].mEventType;
-
-	u32	num_to_copy {gCPUState.NumEvents - 1};
-	if( num_to_copy > 0 )
-	{
-		memmove( &gCPUState.Events[ 0 ], &gCPUState.Events[ 1 ], num_to_copy * sizeof( CPUEvent ) );
-	}
-	gCPUState.NumEvents--;
-
-	return event_type;
+	return gEventQueue.Pop();
 }
 
-// XXXX This is for savestate. Looks very suspicious to me
+// This is for savestates. Unlike the old delta list, this is always the number of cycles from now.
 u32 CPU_GetVideoInterruptEventCount()
 {
-	for( u32 i {}; i < gCPUState.NumEvents; ++i )
-	{
-		if(gCPUState.Events[ i ].mEventType == CPU_EVENT_VBL)
-		{
-			return gCPUState.Events[ i ].mCount;
-		}
-	}
+	LOCK_EVENT_QUEUE();
 
-	return 0;
+	return gEventQueue.GetCount( CPU_EVENT_VBL );
 }
 
-// XXXX This is for savestate. Looks very suspicious to me
 void CPU_SetVideoInterruptEventCount( u32 count )
 {
-	for( u32 i {}; i < gCPUState.NumEvents; ++i )
-	{
-		if(gCPUState.Events[ i ].mEventType == CPU_EVENT_VBL)
-		{
-			gCPUState.Events[ i ].mCount = count;
-			return;
-		}
-	}
+	LOCK_EVENT_QUEUE();
+
+#ifdef DAEDALUS_CAPTURE_EVENT_TRACE
+	CPU_TraceEvent( 'V', count, CPU_EVENT_VBL );
+#endif
+	gEventQueue.SetCount( count, CPU_EVENT_VBL );
 }
 
 void SCPUState::ClearStuffToDo()
@@ -358,6 +324,7 @@ bool CPU_RomOpen()
 	{
 		g_TLBs[i].Reset();
 	}
+	TLBCache_Invalidate();
 
 	// From R4300 manual
 	gCPUState.CPUControl[C0_RAND]._u32   = 32-1;			// TLBENTRIES-1
@@ -387,6 +354,7 @@ bool CPU_RomOpen()
 #endif
 
 	Dynamo_Reset();
+	Inter_Reset();
 
 	CPU_SelectCore();
 	return true;
@@ -407,6 +375,9 @@ void CPU_SelectCore()
 		Dynamo_SelectCore();
 	else
 #endif
+	if (gCachedInterpreterEnabled)
+		Inter_SelectCachedCore();
+	else
 		Inter_SelectCore();
 
 	if( gCPUStopOnSimpleState && CPU_IsStateSimple() )
@@ -460,6 +431,22 @@ bool CPU_RequestLoadState( const char * filename )
 	return true;	// XXXX could fail
 }
 
+bool CPU_RequestRewind()
+{
+	MutexLock lock( &gSaveStateMutex );
+
+	// Abort if already in the process of loading/saving
+	if( gSaveStateOperation != SSO_NONE )
+	{
+		return false;
+	}
+
+	gSaveStateOperation = SSO_REWIND;
+	gCPUState.AddJob(CPU_CHANGE_CORE);
+
+	return true;
+}
+
 static void HandleSaveStateOperationOnVerticalBlank()
 {
 	#ifdef DAEDALUS_ENABLE_ASSERTS
@@ -470,6 +457,11 @@ static void HandleSaveStateOperationOnVerticalBlank()
 
 	MutexLock lock( &gSaveStateMutex );
 
+#ifdef DAEDALUS_AUDIO_HLE_TASKS
+	// Its completion event isn't saved, so don't leave an audio task running
+	AudioHLETask_Flush();
+#endif
+
 	//
 	// Handle the save state
 	//
@@ -482,7 +474,10 @@ static void HandleSaveStateOperationOnVerticalBlank()
 		#ifdef DAEDALUS_DEBUG_CONSOLE
 		DBGConsole_Msg(0, "Saving '%s'\n", gSaveStateFilename.c_str());
 		#endif
-		SaveState_SaveToFile( gSaveStateFilename.c_str() );
+		if( !SaveState_SaveToFile( gSaveStateFilename.c_str() ) )
+		{
+			fprintf( stderr, "Couldn't save state to '%s'\n", gSaveStateFilename.c_str() );
+		}
 		gSaveStateOperation = SSO_NONE;
 		break;
 	case SSO_LOAD:
@@ -506,9 +501,29 @@ static void HandleSaveStateOperationOnVerticalBlank()
 			// NB: return without clearing gSaveStateOperation
 		}
 		break;
+	case SSO_REWIND:
+		if (Rewind_Restore())
+		{
+			CPU_ResetFragmentCache();
+		}
+		gSaveStateOperation = SSO_NONE;
+		break;
 	}
 }
 
+static void HandleRewindOnVerticalBlank()
+{
+	if( !Rewind_IsCaptureDue() )
+		return;
+
+#ifdef DAEDALUS_AUDIO_HLE_TASKS
+	// As for savestates, the audio task's completion event isn't captured
+	AudioHLETask_Flush();
+#endif
+
+	Rewind_Capture();
+}
+
 // Returns true if we handled a load request and should keep running.
 static bool HandleSaveStateOperationOnCPUStopRunning()
 {
@@ -698,6 +713,7 @@ void CPU_HANDLE_COUNT_INTERRUPT()
 			}
 
 			HandleSaveStateOperationOnVerticalBlank();
+			HandleRewindOnVerticalBlank();
 		}
 		break;
 	case CPU_EVENT_COMPARE:
@@ -708,6 +724,11 @@ void CPU_HANDLE_COUNT_INTERRUPT()
 		break;
 	case CPU_EVENT_AUDIO:
 		{
+#ifdef DAEDALUS_AUDIO_HLE_TASKS
+			// Nothing to do if the task was already flushed
+			if( !AudioHLETask_Finish() )
+				break;
+#endif
 			u32 status {Memory_SP_SetRegisterBits(SP_STATUS_REG, SP_STATUS_TASKDONE|SP_STATUS_YIELDED|SP_STATUS_BROKE|SP_STATUS_HALT)};
 			if( status & SP_STATUS_INTR_BREAK )
 				CPU_AddEvent(4000, CPU_EVENT_SPINT);
@@ -26,6 +26,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "R4300OpCode.h"
 #include "Memory.h"
 #include "TLB.h"
+#include "OSHLE/ultra_R4300.h"
 #include "Utility/SpinLock.h"
 
 //*****************************************************************************
@@ -130,7 +131,7 @@ ALIGNED_TYPE(struct, SCPUState, CACHE_ALIGN)
 	REG32			Temp3;				// 0x2A8	Temp storage Dynarec
 	REG32			Temp4;				// 0x2AC	Temp storage Dynarec
 
-	CPUEvent		Events[ MAX_CPU_EVENTS ];	// 0x2B0 //In practice there should only ever be 2 CPU_EVENTS
+	CPUEvent		Events[ MAX_CPU_EVENTS ];	// 0x2B0 Only Events[ 0 ] is used, counting down to the next event (see CCPUEventQueue)
 	u32				NumEvents;
 
 	void			AddJob( u32 job );
@@ -161,6 +162,7 @@ void	CPU_Skip();
 bool	CPU_Run();
 bool	CPU_RequestSaveState( const char * filename );
 bool	CPU_RequestLoadState( const char * filename );
+bool	CPU_RequestRewind();
 void	CPU_Halt( const char * reason );
 void	CPU_SelectCore();
 u32		CPU_GetVideoInterruptEventCount();
@@ -175,6 +177,7 @@ void	CPU_EnableBreakPoint( u32 address, bool enable );		// Enable/Disable the br
 #endif
 bool	CPU_IsRunning();
 void	CPU_AddEvent( s32 count, ECPUEventType event_type );
+void	CPU_RemoveEvent( ECPUEventType event_type );
 void	CPU_SkipToNextEvent();
 bool	CPU_CheckStuffToDo();
 
@@ -257,6 +260,23 @@ inline bool CPU_ProcessEventCycles( u32 cycles )
 	return gCPUState.Events[ 0 ].mCount <= 0;
 }
 
+//***********************************************
+// For interpreters which batch up the count updates
+// (see R4300_InstructionNeedsCountSync)
+//***********************************************
+inline void CPU_FlushPendingOps( s32 ops )
+{
+	if( ops > 0 )
+	{
+		gCPUState.CPUControl[C0_COUNT]._u32 = gCPUState.CPUControl[C0_COUNT]._u32 + ops * COUNTER_INCREMENT_PER_OP;
+
+		if (CPU_ProcessEventCycles( ops * COUNTER_INCREMENT_PER_OP ) )
+		{
+			CPU_HANDLE_COUNT_INTERRUPT();
+		}
+	}
+}
+
 #ifdef DAEDALUS_PROFILE_EXECUTION
 extern u64									gTotalInstructionsExecuted;
 extern u64									gTotalInstructionsEmulated;
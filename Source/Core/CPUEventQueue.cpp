@@ -0,0 +1,237 @@
+/*
+Copyright (C) 2001 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#include "stdafx.h"
+#include "CPUEventQueue.h"
+
+#include <algorithm>
+
+//*************************************************************************************
+//
+//*************************************************************************************
+CCPUEventQueue::CCPUEventQueue( CPUEvent & head, u32 & num_events )
+:	mHead( head )
+,	mNumEvents( num_events )
+{
+	Reset();
+}
+
+//*************************************************************************************
+//
+//*************************************************************************************
+void CCPUEventQueue::Reset()
+{
+	mNumEvents = 0;
+	mSequence = 0;
+	mHead.mCount = 0;
+	mSyncTime = 0;
+	mSyncCount = 0;
+}
+
+//*************************************************************************************
+//
+//*************************************************************************************
+void CCPUEventQueue::Add( s32 count, ECPUEventType event_type )
+{
+#ifdef DAEDALUS_ENABLE_ASSERTS
+	DAEDALUS_ASSERT( count > 0, "Count is invalid" );
+#endif
+	// Dropping an event is bad, but better than running off the end of mEntries
+	if( mNumEvents >= MAX_CPU_EVENTS )
+	{
+		DAEDALUS_ERROR( "Too many events" );
+		return;
+	}
+
+	s64		now( GetTime() );
+	u32		idx( mNumEvents++ );
+
+	mEntries[ idx ].Time = now + count;
+	mEntries[ idx ].Sequence = ++mSequence;
+	mEntries[ idx ].EventType = event_type;
+
+	SiftUp( idx );
+	SyncHead( now );
+}
+
+//*************************************************************************************
+//	The clock is moved on to the time the event was due, so any overrun is
+//	charged to the events which follow (as the delta list used to do)
+//*************************************************************************************
+ECPUEventType CCPUEventQueue::Pop()
+{
+#ifdef DAEDALUS_ENABLE_ASSERTS
+	DAEDALUS_ASSERT( mNumEvents > 0, "Event queue empty" );
+	DAEDALUS_ASSERT( mHead.mCount <= 0, "Popping event when cycles remain" );
+#endif
+	ECPUEventType	event_type( mEntries[ 0 ].EventType );
+	s64				now( mEntries[ 0 ].Time );
+
+	mEntries[ 0 ] = mEntries[ --mNumEvents ];
+	SiftDown( 0 );
+	SyncHead( now );
+
+	return event_type;
+}
+
+//*************************************************************************************
+//
+//*************************************************************************************
+void CCPUEventQueue::Remove( ECPUEventType event_type )
+{
+	s32		idx( Find( event_type ) );
+	if( idx < 0 )
+		return;
+
+#ifdef DAEDALUS_ENABLE_ASSERTS
+	DAEDALUS_ASSERT( mNumEvents > 1, "Should always have at least one event queued up" );
+#endif
+	s64		now( GetTime() );
+
+	mEntries[ idx ] = mEntries[ --mNumEvents ];
+	if( u32( idx ) < mNumEvents )
+	{
+		SiftDown( SiftUp( idx ) );
+	}
+	SyncHead( now );
+}
+
+//*************************************************************************************
+//
+//*************************************************************************************
+void CCPUEventQueue::Reschedule( s32 count, ECPUEventType event_type )
+{
+	s32		idx( Find( event_type ) );
+	if( idx < 0 )
+	{
+		Add( count, event_type );
+		return;
+	}
+
+#ifdef DAEDALUS_ENABLE_ASSERTS
+	DAEDALUS_ASSERT( count > 0, "Count is invalid" );
+#endif
+	s64		now( GetTime() );
+
+	mEntries[ idx ].Time = now + count;
+	mEntries[ idx ].Sequence = ++mSequence;
+
+	SiftDown( SiftUp( idx ) );
+	SyncHead( now );
+}
+
+//*************************************************************************************
+//
+//*************************************************************************************
+s32 CCPUEventQueue::GetCount( ECPUEventType event_type ) const
+{
+	s32		idx( Find( event_type ) );
+	if( idx < 0 )
+		return 0;
+
+	return s32( mEntries[ idx ].Time - GetTime() );
+}
+
+//*************************************************************************************
+//	Unlike Reschedule this keeps the event's place amongst any it ties with
+//*************************************************************************************
+void CCPUEventQueue::SetCount( s32 count, ECPUEventType event_type )
+{
+	s32		idx( Find( event_type ) );
+	if( idx < 0 )
+		return;
+
+	s64		now( GetTime() );
+
+	mEntries[ idx ].Time = now + count;
+
+	SiftDown( SiftUp( idx ) );
+	SyncHead( now );
+}
+
+//*************************************************************************************
+//	There are only ever a handful of events queued, so a scan is cheaper than
+//	keeping an index up to date on every swap
+//*************************************************************************************
+s32 CCPUEventQueue::Find( ECPUEventType event_type ) const
+{
+	for( u32 i = 0; i < mNumEvents; ++i )
+	{
+		if( mEntries[ i ].EventType == event_type )
+			return s32( i );
+	}
+	return -1;
+}
+
+//*************************************************************************************
+//
+//*************************************************************************************
+u32 CCPUEventQueue::SiftUp( u32 idx )
+{
+	while( idx > 0 )
+	{
+		u32		parent( (idx - 1) / 2 );
+		if( !Before( mEntries[ idx ], mEntries[ parent ] ) )
+			break;
+
+		std::swap( mEntries[ idx ], mEntries[ parent ] );
+		idx = parent;
+	}
+	return idx;
+}
+
+//*************************************************************************************
+//
+//*************************************************************************************
+void CCPUEventQueue::SiftDown( u32 idx )
+{
+	for( ;; )
+	{
+		u32		child( idx * 2 + 1 );
+		if( child >= mNumEvents )
+			break;
+
+		if( child + 1 < mNumEvents && Before( mEntries[ child + 1 ], mEntries[ child ] ) )
+		{
+			child++;
+		}
+
+		if( !Before( mEntries[ child ], mEntries[ idx ] ) )
+			break;
+
+		std::swap( mEntries[ idx ], mEntries[ child ] );
+		idx = child;
+	}
+}
+
+//*************************************************************************************
+//	Rewrite the countdown to the earliest event. If the queue is empty the
+//	countdown is left alone, so the clock carries on from where it is.
+//*************************************************************************************
+void CCPUEventQueue::SyncHead( s64 now )
+{
+	if( mNumEvents > 0 )
+	{
+		mHead.mCount = s32( mEntries[ 0 ].Time - now );
+		mHead.mEventType = mEntries[ 0 ].EventType;
+	}
+
+	mSyncTime = now;
+	mSyncCount = mHead.mCount;
+}
@@ -0,0 +1,93 @@
+/*
+Copyright (C) 2001 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#pragma once
+
+#ifndef CORE_CPUEVENTQUEUE_H_
+#define CORE_CPUEVENTQUEUE_H_
+
+#include "Core/CPU.h"
+
+//*************************************************************************************
+//	Timing events, kept in a binary min-heap ordered by the absolute cycle they
+//	fire on. Adding or rescheduling an event is O(log n) rather than a walk of
+//	a delta-encoded list. That's not a speed win with at most MAX_CPU_EVENTS
+//	queued: on the synthetic trace in CPUEventQueue_bench.cpp the heap is a
+//	few percent slower than the old list.
+//
+//	The dynarec, the interpreters and DynaRecStubs.S all count down the head
+//	event directly, so the earliest event is mirrored into a CPUEvent (i.e.
+//	gCPUState.Events[ 0 ]) as the number of cycles remaining until it fires.
+//	The current time is recovered from how far that countdown has moved.
+//
+//	Callers are responsible for locking (see LOCK_EVENT_QUEUE).
+//*************************************************************************************
+class CCPUEventQueue
+{
+public:
+	CCPUEventQueue( CPUEvent & head, u32 & num_events );
+
+	void			Reset();
+
+	void			Add( s32 count, ECPUEventType event_type );
+	ECPUEventType	Pop();
+
+	// Drops the queued event of this type, if there is one
+	void			Remove( ECPUEventType event_type );
+
+	// Moves the queued event of this type to fire in count cycles, adding one if there isn't one
+	void			Reschedule( s32 count, ECPUEventType event_type );
+
+	// Returns the cycles until the queued event of this type fires, or 0 if there isn't one
+	s32				GetCount( ECPUEventType event_type ) const;
+	void			SetCount( s32 count, ECPUEventType event_type );
+
+	u32				GetSize() const				{ return mNumEvents; }
+
+	// Absolute cycle count. Time spent overrunning an event isn't counted, to match the old delta list.
+	s64				GetTime() const				{ return mSyncTime + (mSyncCount - mHead.mCount); }
+
+private:
+	struct SEntry
+	{
+		s64				Time;
+		u32				Sequence;		// Breaks ties so the most recently added event fires first
+		ECPUEventType	EventType;
+	};
+
+	static inline bool	Before( const SEntry & a, const SEntry & b )
+	{
+		return a.Time < b.Time || (a.Time == b.Time && a.Sequence > b.Sequence);
+	}
+
+	s32				Find( ECPUEventType event_type ) const;
+	u32				SiftUp( u32 idx );
+	void			SiftDown( u32 idx );
+	void			SyncHead( s64 now );
+
+private:
+	SEntry			mEntries[ MAX_CPU_EVENTS ];
+	CPUEvent &		mHead;
+	u32 &			mNumEvents;
+	u32				mSequence;
+	s64				mSyncTime;			// The time when mHead.mCount was last written
+	s32				mSyncCount;			// The value it was set to
+};
+
+#endif // CORE_CPUEVENTQUEUE_H_
@@ -0,0 +1,304 @@
+// Microbenchmark for the CPU event queue. Replays a trace of CPU_AddEvent/CPU_SetCompareEvent/CPU_PopEvent
+// calls against the old delta-encoded list and CCPUEventQueue, checking both fire the same events.
+// Traces are written to event_trace.txt by builds with DAEDALUS_CAPTURE_EVENT_TRACE defined, and are
+// passed as the first argument; without one a synthetic trace with a game-like mix of VBL, COMPARE and
+// RSP events is used.
+
+#include "stdafx.h"
+#include "Core/CPUEventQueue.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+static const u32	kNumSyntheticOps = 1000000;
+static const u32	kMinReplayedOps = 20000000;
+
+struct SEventOp
+{
+	char			Op;				// A(dd), C(ompare), P(op), R(emove), V(bl count)
+	s32				Elapsed;		// Cycles run since the previous op
+	s32				Count;
+	ECPUEventType	EventType;
+};
+
+// The list CPU.cpp used to keep in gCPUState.Events
+struct SDeltaEventList
+{
+	CPUEvent		Events[ MAX_CPU_EVENTS ];
+	u32				NumEvents;
+
+	void Add( s32 count, ECPUEventType event_type )
+	{
+		u32 event_idx;
+		for( event_idx = 0; event_idx < NumEvents; ++event_idx )
+		{
+			CPUEvent & event = Events[ event_idx ];
+			if( count <= event.mCount )
+			{
+				event.mCount -= count;
+				memmove( &Events[ event_idx+1 ], &Events[ event_idx ], (NumEvents - event_idx) * sizeof( CPUEvent ) );
+				break;
+			}
+			count -= event.mCount;
+		}
+		Events[ event_idx ].mCount = count;
+		Events[ event_idx ].mEventType = event_type;
+		NumEvents++;
+	}
+
+	void Remove( ECPUEventType event_type )
+	{
+		for( u32 i = 0; i < NumEvents; ++i )
+		{
+			if( Events[ i ].mEventType == event_type )
+			{
+				if( i+1 < NumEvents )
+				{
+					Events[ i+1 ].mCount += Events[ i ].mCount;
+					memmove( &Events[ i ], &Events[ i+1 ], (NumEvents - (i+1)) * sizeof( CPUEvent ) );
+				}
+				NumEvents--;
+				break;
+			}
+		}
+	}
+
+	void SetCompare( s32 count )
+	{
+		Remove( CPU_EVENT_COMPARE );
+		Add( count, CPU_EVENT_COMPARE );
+	}
+
+	ECPUEventType Pop()
+	{
+		ECPUEventType event_type = Events[ 0 ].mEventType;
+		memmove( &Events[ 0 ], &Events[ 1 ], (NumEvents - 1) * sizeof( CPUEvent ) );
+		NumEvents--;
+		return event_type;
+	}
+
+	void SetVblCount( s32 count )
+	{
+		for( u32 i = 0; i < NumEvents; ++i )
+		{
+			if( Events[ i ].mEventType == CPU_EVENT_VBL )
+			{
+				Events[ i ].mCount = count;
+				return;
+			}
+		}
+	}
+
+	void		Reset()						{ NumEvents = 0; Events[ 0 ].mCount = 0; }
+	CPUEvent &	Head()						{ return Events[ 0 ]; }
+};
+
+struct SHeapEventList
+{
+	CPUEvent		Events[ MAX_CPU_EVENTS ];
+	u32				NumEvents;
+	CCPUEventQueue	Queue;
+
+	SHeapEventList() : Queue( Events[ 0 ], NumEvents ) {}
+
+	void			Add( s32 count, ECPUEventType event_type )	{ Queue.Add( count, event_type ); }
+	void			Remove( ECPUEventType event_type )			{ Queue.Remove( event_type ); }
+	void			SetCompare( s32 count )						{ Queue.Reschedule( count, CPU_EVENT_COMPARE ); }
+	ECPUEventType	Pop()										{ return Queue.Pop(); }
+	void			SetVblCount( s32 count )					{ Queue.SetCount( count, CPU_EVENT_VBL ); }
+	void			Reset()										{ Queue.Reset(); }
+	CPUEvent &		Head()										{ return Events[ 0 ]; }
+};
+
+// Runs a few thousand cycles at a time, reprogramming COMPARE and kicking off RSP tasks in between.
+static void MakeSyntheticTrace( std::vector< SEventOp > & ops )
+{
+	SHeapEventList	events;
+	u32				seed( 0x12345678 );
+	bool			audio_queued( false );
+	bool			spint_queued( false );
+	s32				elapsed( 0 );
+
+	SEventOp		op = { 'A', 0, 62500, CPU_EVENT_VBL };
+	ops.push_back( op );
+	events.Add( op.Count, op.EventType );
+
+	while( ops.size() < kNumSyntheticOps )
+	{
+		seed = seed * 1664525 + 1013904223;
+		u32		r( seed >> 8 );
+		s32		step( 1 + r % 3000 );
+
+		if( step >= events.Head().mCount )
+		{
+			// Overrun the event by up to the length of a short trace
+			step = events.Head().mCount + (r >> 20) % 8;
+			events.Head().mCount -= step;
+
+			SEventOp	pop = { 'P', elapsed + step, 0, events.Head().mEventType };
+			ops.push_back( pop );
+			elapsed = 0;
+
+			switch( events.Pop() )
+			{
+			case CPU_EVENT_VBL:
+				{
+					SEventOp	vbl = { 'A', 0, 62500 + (s32)(r % 2) * 1500, CPU_EVENT_VBL };
+					ops.push_back( vbl );
+					events.Add( vbl.Count, vbl.EventType );
+				}
+				break;
+			case CPU_EVENT_AUDIO:
+				audio_queued = false;
+				if( (r & 1) && !spint_queued )
+				{
+					SEventOp	spint = { 'A', 0, 4000, CPU_EVENT_SPINT };
+					ops.push_back( spint );
+					events.Add( spint.Count, spint.EventType );
+					spint_queued = true;
+				}
+				break;
+			case CPU_EVENT_SPINT:
+				spint_queued = false;
+				break;
+			default:
+				break;
+			}
+		}
+		else
+		{
+			events.Head().mCount -= step;
+			elapsed += step;
+
+			if( (r & 0xf) < 11 )
+			{
+				SEventOp	compare = { 'C', elapsed, 1000 + (s32)(r % 200000), CPU_EVENT_COMPARE };
+				ops.push_back( compare );
+				events.SetCompare( compare.Count );
+				elapsed = 0;
+			}
+			else if( !audio_queued )
+			{
+				SEventOp	audio = { 'A', elapsed, 5000 + (s32)(r % 20000), CPU_EVENT_AUDIO };
+				ops.push_back( audio );
+				events.Add( audio.Count, audio.EventType );
+				audio_queued = true;
+				elapsed = 0;
+			}
+		}
+	}
+}
+
+// Traces record the absolute time of each op, so run them through the queue once to get the cycles in between.
+static bool LoadTrace( const char * filename, std::vector< SEventOp > & ops )
+{
+	FILE *		fh( fopen( filename, "r" ) );
+	if( fh == NULL )
+		return false;
+
+	SHeapEventList	events;
+	char			op;
+	long long		time;
+	s32				count, event_type;
+	while( fscanf( fh, " %c %lld %d %d", &op, &time, &count, &event_type ) == 4 )
+	{
+		SEventOp	event_op = { op, (s32)(time - events.Queue.GetTime()), count, (ECPUEventType)event_type };
+		ops.push_back( event_op );
+
+		events.Head().mCount -= event_op.Elapsed;
+		switch( op )
+		{
+		case 'A':	events.Add( count, event_op.EventType ); break;
+		case 'C':	events.SetCompare( count ); break;
+		case 'P':	events.Pop(); break;
+		case 'R':	events.Remove( event_op.EventType ); break;
+		case 'V':	events.SetVblCount( count ); break;
+		}
+	}
+
+	fclose( fh );
+	return !ops.empty();
+}
+
+// Returns a checksum of the events fired, so the two queues can be compared
+template< typename T > static u32 Replay( T & events, const std::vector< SEventOp > & ops )
+{
+	u32		checksum( 0 );
+
+	events.Reset();
+	for( u32 i = 0; i < ops.size(); ++i )
+	{
+		const SEventOp &	op( ops[ i ] );
+
+		events.Head().mCount -= op.Elapsed;
+		switch( op.Op )
+		{
+		case 'A':	events.Add( op.Count, op.EventType ); break;
+		case 'C':	events.SetCompare( op.Count ); break;
+		case 'P':	checksum = checksum * 31 + events.Pop(); break;
+		case 'R':	events.Remove( op.EventType ); break;
+		case 'V':	events.SetVblCount( op.Count ); break;
+		}
+	}
+	return checksum;
+}
+
+template< typename T > static double Time( T fn )
+{
+	std::chrono::high_resolution_clock::time_point	start( std::chrono::high_resolution_clock::now() );
+	fn();
+	std::chrono::high_resolution_clock::time_point	end( std::chrono::high_resolution_clock::now() );
+	return std::chrono::duration< double, std::milli >( end - start ).count();
+}
+
+int main( int argc, char ** argv )
+{
+	std::vector< SEventOp >	ops;
+	if( argc > 1 )
+	{
+		if( !LoadTrace( argv[ 1 ], ops ) )
+		{
+			printf( "Couldn't read a trace from %s\n", argv[ 1 ] );
+			return 1;
+		}
+	}
+	else
+	{
+		MakeSyntheticTrace( ops );
+	}
+
+	u32		repeats( (kMinReplayedOps + ops.size() - 1) / ops.size() );
+	u32		num_ops( repeats * ops.size() );
+
+	SDeltaEventList	delta;
+	u32				delta_checksum( 0 );
+	double			delta_ms( Time( [&]()
+	{
+		for( u32 i = 0; i < repeats; ++i )
+		{
+			delta_checksum += Replay( delta, ops );
+		}
+	} ) );
+
+	SHeapEventList	heap;
+	u32				heap_checksum( 0 );
+	double			heap_ms( Time( [&]()
+	{
+		for( u32 i = 0; i < repeats; ++i )
+		{
+			heap_checksum += Replay( heap, ops );
+		}
+	} ) );
+
+	printf( "%u ops (%s trace of %u, replayed %u times)\n", num_ops, argc > 1 ? argv[ 1 ] : "synthetic", (u32)ops.size(), repeats );
+	printf( "Delta list:     %8.2fms (%5.2fns/op)\n", delta_ms, delta_ms * 1e6 / num_ops );
+	printf( "CCPUEventQueue: %8.2fms (%5.2fns/op)\n", heap_ms, heap_ms * 1e6 / num_ops );
+	if( delta_checksum != heap_checksum )
+	{
+		printf( "Event order differs (savestate loads in the trace will do this)\n" );
+	}
+	return 0;
+}
@@ -106,6 +106,7 @@ static void CheatCodes_Apply(u32 index, u32 mode)
 			}
 
 			*(u8 *)(p_mem) = (u8)value;
+			DirtyPages_Mark(address);
 			break;
 		case 0x81:
 		case 0xA1:
@@ -122,6 +123,7 @@ static void CheatCodes_Apply(u32 index, u32 mode)
 			}
 
 			*(u16 *)(p_mem) = value;
+			DirtyPages_Mark(address);
 			break;
 		case 0xD0:
 			skip = ( *(u8 *)(p_mem) != value );
@@ -136,10 +138,10 @@ static void CheatCodes_Apply(u32 index, u32 mode)
 			skip = ( *(u16 *)(p_mem) == value );
 			break;
 		case 0x88:
-			if( mode == GS_BUTTON )*(u8 *)(p_mem) = (u8)value;
+			if( mode == GS_BUTTON ) { *(u8 *)(p_mem) = (u8)value; DirtyPages_Mark(address); }
 			break;
 		case 0x89:
-			if( mode == GS_BUTTON )	*(u16 *)(p_mem) = value;
+			if( mode == GS_BUTTON )	{ *(u16 *)(p_mem) = value; DirtyPages_Mark(address); }
 			break;
 		case 0x04:
 			if( ((code->addr >> 20) & 0xF) == 0x5 )
@@ -165,7 +167,8 @@ static void CheatCodes_Apply(u32 index, u32 mode)
 					case 0x80:
 						do
 						{
-							*(u8 *)((u32)p_mem ^ U8_TWIDDLE) = (u8)value;
+							*(u8 *)((uintptr_t)p_mem ^ U8_TWIDDLE) = (u8)value;
+							Memory_MarkWritten(p_mem);
 							p_mem += offset;
 							value += (u8)valinc;
 							count--;
@@ -174,7 +177,8 @@ static void CheatCodes_Apply(u32 index, u32 mode)
 					case 0x81:
 						do
 						{
-							*(u16 *)((u32)p_mem ^ U16_TWIDDLE) = value;
+							*(u16 *)((uintptr_t)p_mem ^ U16_TWIDDLE) = value;
+							Memory_MarkWritten(p_mem);
 							p_mem += offset;
 							value += valinc;
 							count--;
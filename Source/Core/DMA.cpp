@@ -104,6 +104,7 @@ void DMA_SP_CopyToRDRAM()
 		//No swizzle is okay since alignment and size constrains are met //Salvy
 		fast_memcpy(&g_pu8RamBase[(rdram_address_reg & 0xFFFFFF)],
 					&g_pu8SpMemBase[(spmem_address_reg & 0xFFF)], (wrlen_reg & 0xFFF) + 1);
+		DirtyPages_MarkRange(rdram_address_reg & 0xFFFFFF, (wrlen_reg & 0xFFF) + 1);
 	}
 
 #else
@@ -123,6 +124,7 @@ void DMA_SP_CopyToRDRAM()
 		}
 		#endif
 		fast_memcpy_swizzle( &g_pu8RamBase[rdram_address], &g_pu8SpMemBase[spmem_address], length );
+		DirtyPages_MarkRange( rdram_address, length );
 		rdram_address += length + skip;
 		spmem_address += length;
 	}
@@ -178,6 +180,7 @@ void DMA_SI_CopyToDRAM( )
 	{
 		p_dst[i] = BSWAP32(p_src[i]);
 	}
+	DirtyPages_MarkRange(mem, 64);
 
 
 	Memory_SI_SetRegisterBits(SI_STATUS_REG, SI_STATUS_INTERRUPT);
@@ -239,10 +242,14 @@ static void OnCopiedRom()
 		// Set RDRAM size
 		u32 addr {(g_ROM.cic_chip != CIC_6105) ? (u32)0x318 : (u32)0x3F0};
 		*(u32 *)(g_pu8RamBase + addr) = gRamSize;
+		DirtyPages_Mark(addr);
 
 		// Azimer's DK64 hack, it makes DK64 boot!
 		if(g_ROM.GameHacks == DK64)
+		{
 			*(u32 *)(g_pu8RamBase + 0x2FE1C0) = 0xAD170014;
+			DirtyPages_Mark(0x2FE1C0);
+		}
 	}
 }
 
@@ -302,6 +309,9 @@ void DMA_PI_CopyToRDRAM()
 		#endif
 	}
 
+	// Covers the flash status words DMA_FLASH_CopyToDRAM writes too
+	DirtyPages_MarkRange(mem_address, pi_length_reg);
+
 	Memory_PI_ClrRegisterBits(PI_STATUS_REG, PI_STATUS_DMA_BUSY);
 	Memory_MI_SetRegisterBits(MI_INTR_REG, MI_INTR_PI);
 	R4300_Interrupt_UpdateCause3();
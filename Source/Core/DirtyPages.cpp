@@ -0,0 +1,107 @@
+/*
+Copyright (C) 2012 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#include "stdafx.h"
+#include "Core/DirtyPages.h"
+
+#include <string.h>
+
+#include "Config/ConfigOptions.h"
+#include "Core/Memory.h"
+#include "Math/MathUtil.h"
+
+DAEDALUS_STATIC_ASSERT( kNumDirtyPages << kDirtyPageShift == MAX_RAM_ADDRESS );
+
+u8				gDirtyPages[ kNumDirtyPages ];
+
+// The epoch each page was last written in, not counting gDirtyPages
+static u32		gPageEpochs[ kNumDirtyPages ];
+
+// Starts at 1 so everything looks written since epoch 0
+static u32		gEpoch = 1;
+
+void DirtyPages_MarkRange( u32 offset, u32 length )
+{
+	if( length == 0 || offset >= MAX_RAM_ADDRESS )
+		return;
+
+	u32 first( offset >> kDirtyPageShift );
+	u32 last( Min< u32 >( offset + length - 1, MAX_RAM_ADDRESS - 1 ) >> kDirtyPageShift );
+
+	// offset + length can wrap around for silly lengths
+	if( offset + length - 1 < offset )
+	{
+		last = kNumDirtyPages - 1;
+	}
+
+	memset( gDirtyPages + first, 1, last - first + 1 );
+}
+
+void DirtyPages_MarkAll()
+{
+	memset( gDirtyPages, 1, sizeof( gDirtyPages ) );
+}
+
+bool DirtyPages_IsReliable()
+{
+#if defined(DAEDALUS_PSP)
+	// Audio lists run on the ME, which writes to RDRAM behind the CPU's back
+	return false;
+#elif defined(DAEDALUS_ENABLE_DYNAREC) && !defined(DAEDALUS_DYNAREC_MARKS_DIRTY_PAGES)
+	return !gDynarecEnabled;
+#else
+	return true;
+#endif
+}
+
+u32 DirtyPages_GetEpoch()
+{
+	return gEpoch;
+}
+
+void DirtyPages_NextEpoch()
+{
+	for( u32 i = 0; i < kNumDirtyPages; ++i )
+	{
+		if( gDirtyPages[ i ] )
+		{
+			gPageEpochs[ i ] = gEpoch;
+			gDirtyPages[ i ] = 0;
+		}
+	}
+
+	++gEpoch;
+}
+
+bool DirtyPages_WrittenSince( u32 offset, u32 length, u32 epoch )
+{
+	if( length == 0 )
+		return false;
+
+	u32 end( offset + length - 1 );
+	if( end < offset || end >= MAX_RAM_ADDRESS )
+		return true;
+
+	for( u32 i = offset >> kDirtyPageShift; i <= end >> kDirtyPageShift; ++i )
+	{
+		if( gDirtyPages[ i ] || gPageEpochs[ i ] >= epoch )
+			return true;
+	}
+	return false;
+}
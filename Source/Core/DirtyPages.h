@@ -0,0 +1,69 @@
+/*
+Copyright (C) 2012 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#pragma once
+
+#ifndef CORE_DIRTYPAGES_H_
+#define CORE_DIRTYPAGES_H_
+
+#include "Utility/DaedalusTypes.h"
+
+//
+//	Tracks which 4KB pages of RDRAM have been written, so the texture cache
+//	only has to rehash textures whose source data may have changed.
+//
+//	Anything which writes to RDRAM has to note it here: the interpreter (the
+//	Write*Bits functions in Core/Memory.h), the x64 dynarec (in the code it
+//	generates), DMA, HLE'd RSP tasks and OS patches. Writes set a byte per page
+//	in gDirtyPages, so generated code can mark a page with a single store.
+//	Once per display list DirtyPages_NextEpoch() folds them into a per page
+//	record of the last epoch each page was written in.
+//
+
+static const u32	kDirtyPageShift	= 12;
+static const u32	kNumDirtyPages	= ( 8 * 1024 * 1024 ) >> kDirtyPageShift;	// MAX_RAM_ADDRESS
+
+extern u8			gDirtyPages[ kNumDirtyPages ];
+
+// offset is from the start of RDRAM. Anything past the end is ignored.
+inline void DirtyPages_Mark( u32 offset )
+{
+	u32 page( offset >> kDirtyPageShift );
+	if( page < kNumDirtyPages )
+	{
+		gDirtyPages[ page ] = 1;
+	}
+}
+
+void		DirtyPages_MarkRange( u32 offset, u32 length );
+
+// For when RDRAM has been replaced wholesale, e.g. by loading a savestate
+void		DirtyPages_MarkAll();
+
+// False if something can write to RDRAM without marking pages, e.g. a dynarec
+// backend which doesn't, in which case callers have to look for changes themselves.
+bool		DirtyPages_IsReliable();
+
+u32			DirtyPages_GetEpoch();
+void		DirtyPages_NextEpoch();
+
+// Has any of [offset, offset + length) been written since the start of epoch?
+bool		DirtyPages_WrittenSince( u32 offset, u32 length, u32 epoch );
+
+#endif // CORE_DIRTYPAGES_H_
@@ -36,6 +36,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "DynaRec/DynaRecProfile.h"
 #include "DynaRec/Fragment.h"
 #include "DynaRec/FragmentCache.h"
+#include "DynaRec/HotTraceTable.h"
 #include "DynaRec/TraceRecorder.h"
 #include "OSHLE/patch.h"				// GetCorrectOp
 #include "OSHLE/ultra_R4300.h"
@@ -62,10 +63,7 @@ static const u32					gMaxFragmentCacheSize {(8192 + 1024)}; //Maximum amount of
 static const u32					gMaxHotTraceMapSize {(2048 + TRACE_SIZE)};
 static const u32					gHotTraceThreshold {10};	//How many times interpreter has to loop a trace before it becomes hot and sent to dynarec
 
-//typedef CMemoryPoolAllocator< std::pair< const u32, u32 > > MyAllocator;
-//std::map< u32, u32, std::less<u32>, MyAllocator >				gHotTraceCountMap;
-//std::map< u32, u32, std::less<u32>, boost::pool_allocator<std::pair< const u32, u32 > > >				gHotTraceCountMap;
-std::map< u32, u32 >				gHotTraceCountMap {};
+CHotTraceTable						gHotTraceCountMap( gMaxHotTraceMapSize );
 CFragmentCache						gFragmentCache {};
 static bool							gResetFragmentCache {false};
 
@@ -105,29 +103,49 @@ void CPU_DynarecEnable()
 }
 
 //*****************************************************************************
-// If fragments overlap dynarec has to start all over which is very costly
+// Only the fragments compiled from the overwritten pages are thrown away.
+// This can be called from generated code, so the fragments are retired later
+// in CPU_HandleDynaRecOnBranch
 //*****************************************************************************
 void R4300_CALL_TYPE CPU_InvalidateICacheRange( u32 address, u32 length )
 {
 	if( gFragmentCache.ShouldInvalidateOnWrite( address, length ) )
 	{
-#ifndef DAEDALUS_SILENT
-		printf( "Write to %08x (%d bytes) overlaps fragment cache entries\n", address, length );
+#ifdef DAEDALUS_DEBUG_CONSOLE
+		DBGConsole_Msg( 0, "Write to %08x (%d bytes) overlaps fragment cache entries", address, length );
 #endif
-		CPU_ResetFragmentCache();
+		gFragmentCache.InvalidateRange( address, length );
 	}
 }
 
 
+//*****************************************************************************
+//	With BatchCycles set COUNT and the event queue aren't updated after every
+//	op. Pending counts the ops executed since the last update and Budget is
+//	the distance to the next event when it was made, so we only need to stop
+//	when the event is due or an op which can observe the count comes along.
+//*****************************************************************************
+struct SCycleBudget
+{
+	s32		Pending;
+	s32		Budget;
+};
+
+static DAEDALUS_FORCEINLINE void CPU_FlushCycleBudget( SCycleBudget & cycles )
+{
+	CPU_FlushPendingOps( cycles.Pending );
+	cycles.Pending = 0;
+	cycles.Budget = gCPUState.Events[ 0 ].mCount;
+}
+
 //*****************************************************************************
 //	Execute a single MIPS op. The conditionals for the templated arguments
 //	are completely optimised away by the compiler.
 //
-//	DynaRec:		Run this function with dynarec enabled
-//	TranslateOp:	Use this to translate breakpoints/patches to original op
-//					before execution.
+//	TraceEnabled:	Record the op for the trace recorder
+//	BatchCycles:	Update the count in batches (see SCycleBudget)
 //*****************************************************************************
-template< bool TraceEnabled > DAEDALUS_FORCEINLINE void CPU_EXECUTE_OP()
+template< bool TraceEnabled, bool BatchCycles > DAEDALUS_FORCEINLINE void CPU_EXECUTE_OP( SCycleBudget & cycles )
 {
 
 	u8 * p_Instruction {};
@@ -141,10 +159,17 @@ template< bool TraceEnabled > DAEDALUS_FORCEINLINE void CPU_EXECUTE_OP()
 	op_code = GetCorrectOp( op_code );
 #endif
 
+	bool	sync_count( BatchCycles && R4300_InstructionNeedsCountSync( op_code ) );
+	if( sync_count )
+	{
+		CPU_FlushCycleBudget( cycles );
+	}
+
 	#ifdef DAEDALUS_ENABLE_SYNCHRONISATION
 	SYNCH_POINT( DAED_SYNC_REG_PC, gCPUState.CurrentPC, "Program Counter doesn't match" );
 	SYNCH_POINT( DAED_SYNC_FRAGMENT_PC, gCPUState.CurrentPC + gCPUState.Delay, "Program Counter/Delay doesn't match while interpreting" );
-	SYNCH_POINT( DAED_SYNC_REG_PC, gCPUState.CPUControl[C0_COUNT]._u32, "Count doesn't match" );
+	// Include any pending ops, so this matches the unbatched core
+	SYNCH_POINT( DAED_SYNC_REG_PC, gCPUState.CPUControl[C0_COUNT]._u32 + (BatchCycles ? cycles.Pending * COUNTER_INCREMENT_PER_OP : 0), "Count doesn't match" );
 	#endif
 	if( TraceEnabled )
 	{
@@ -172,14 +197,34 @@ template< bool TraceEnabled > DAEDALUS_FORCEINLINE void CPU_EXECUTE_OP()
 #endif
 	}
 	#ifdef DAEDALUS_ENABLE_SYNCHRONISATION
+	// Hash COUNT as the unbatched core would see it
+	const u32	pending_count( BatchCycles ? cycles.Pending * COUNTER_INCREMENT_PER_OP : 0 );
+	gCPUState.CPUControl[C0_COUNT]._u32 += pending_count;
 	SYNCH_POINT( DAED_SYNC_REGS, CPU_ProduceRegisterHash(), "Registers don't match" );
+	gCPUState.CPUControl[C0_COUNT]._u32 -= pending_count;
 	#endif
-	// Increment count register
-	gCPUState.CPUControl[C0_COUNT]._u32 = gCPUState.CPUControl[C0_COUNT]._u32 + COUNTER_INCREMENT_PER_OP;
+	if( BatchCycles )
+	{
+		// The op may have added events or skipped to the next one
+		if( sync_count )
+		{
+			cycles.Budget = gCPUState.Events[ 0 ].mCount;
+		}
 
-	if (CPU_ProcessEventCycles( COUNTER_INCREMENT_PER_OP ) )
+		if( ++cycles.Pending >= cycles.Budget )
+		{
+			CPU_FlushCycleBudget( cycles );
+		}
+	}
+	else
 	{
-		CPU_HANDLE_COUNT_INTERRUPT();
+		// Increment count register
+		gCPUState.CPUControl[C0_COUNT]._u32 = gCPUState.CPUControl[C0_COUNT]._u32 + COUNTER_INCREMENT_PER_OP;
+
+		if (CPU_ProcessEventCycles( COUNTER_INCREMENT_PER_OP ) )
+		{
+			CPU_HANDLE_COUNT_INTERRUPT();
+		}
 	}
 
 	switch (gCPUState.Delay)
@@ -199,7 +244,18 @@ template< bool TraceEnabled > DAEDALUS_FORCEINLINE void CPU_EXECUTE_OP()
 			CPU_SetPC(gCPUState.TargetPC);
 			gCPUState.Delay = NO_DELAY;
 
+			// Fragments update the count themselves, so it needs to be up to date
+			if( BatchCycles )
+			{
+				CPU_FlushCycleBudget( cycles );
+			}
+
 			CPU_HandleDynaRecOnBranch( backwards, TraceEnabled );
+
+			if( BatchCycles )
+			{
+				cycles.Budget = gCPUState.Events[ 0 ].mCount;
+			}
 		}
 		break;
 	case NO_DELAY:
@@ -225,23 +281,32 @@ void	CPU_ResetFragmentCache()
 // Keep executing instructions until there are other tasks to do (i.e. gCPUState.GetStuffToDo() is set)
 // Process these tasks and loop
 //*****************************************************************************
-template < bool DynaRec, bool TraceEnabled > void CPU_Go()
+template < bool DynaRec, bool TraceEnabled, bool BatchCycles > void CPU_Go()
 {
 	DAEDALUS_PROFILE( __FUNCTION__ );
 
 	while (CPU_KeepRunning())
 	{
+		SCycleBudget	cycles;
+		cycles.Pending = 0;
+		cycles.Budget = gCPUState.Events[ 0 ].mCount;
+
 		//
 		// Keep executing ops as long as there's nothing to do
 		//
 		u32	stuff_to_do( gCPUState.GetStuffToDo() );
 		while(stuff_to_do == 0)
 		{
-			CPU_EXECUTE_OP< TraceEnabled >();
+			CPU_EXECUTE_OP< TraceEnabled, BatchCycles >( cycles );
 
 			stuff_to_do = gCPUState.GetStuffToDo();
 		}
 
+		if( BatchCycles )
+		{
+			CPU_FlushPendingOps( cycles.Pending );
+		}
+
 		if( TraceEnabled && (stuff_to_do != CPU_CHANGE_CORE) )
 		{
 			if(gTraceRecorder.IsTraceActive())
@@ -310,11 +375,15 @@ void	CPU_DumpFragmentCache()
 	{
 		std::vector< SAddressHitCount >	hit_counts;
 
-		hit_counts.reserve( gHotTraceCountMap.size() );
+		hit_counts.reserve( gHotTraceCountMap.GetSize() );
 
-		for(std::map<u32,u32>::const_iterator it = gHotTraceCountMap.begin(); it != gHotTraceCountMap.end(); ++it )
+		for( u32 i = 0; i < gHotTraceCountMap.GetCapacity(); ++i )
 		{
-			hit_counts.push_back( SAddressHitCount( it->first, it->second ) );
+			const CHotTraceTable::SEntry & entry( gHotTraceCountMap.GetEntry( i ) );
+			if( entry.Count != 0 )
+			{
+				hit_counts.push_back( SAddressHitCount( entry.Address, entry.Count ) );
+			}
 		}
 
 		std::sort( hit_counts.begin(), hit_counts.end(), SortByHitCount );
@@ -364,7 +433,7 @@ void CPU_CreateAndAddFragment()
 
 	if( p_fragment != NULL )
 	{
-		gHotTraceCountMap.erase( p_fragment->GetEntryAddress() );
+		gHotTraceCountMap.Erase( p_fragment->GetEntryAddress() );
 		gFragmentCache.InsertFragment( p_fragment );
 
 		//DBGConsole_Msg( 0, "Inserted hot trace at [R%08x]! (size is %d. %dKB)", p_fragment->GetEntryAddress(), gFragmentCache.GetCacheSize(), gFragmentCache.GetMemoryUsage() / 1024 );
@@ -430,6 +499,13 @@ void CPU_HandleDynaRecOnBranch( bool backwards, bool trace_already_enabled )
 		u32			entry_count( gCPUState.CPUControl[C0_COUNT]._u32 ); // Just used DYNAREC_PROFILE_ENTEREXIT
 #endif
 		u32			entry_address( gCPUState.CurrentPC );
+
+		// Safe point to retire any fragments which have been overwritten
+		if( gFragmentCache.HasPendingInvalidations() && !gTraceRecorder.IsTraceActive() )
+		{
+			gFragmentCache.ProcessInvalidations();
+		}
+
 #ifdef DAEDALUS_DEBUG_DYNAREC
 		CFragment * p_fragment( gFragmentCache.LookupFragment( entry_address ) );
 #else
@@ -478,7 +554,7 @@ void CPU_HandleDynaRecOnBranch( bool backwards, bool trace_already_enabled )
 #endif
 						{
 							gFragmentCache.Clear();
-							gHotTraceCountMap.clear();		// Makes sense to clear this now, to get accurate usage stats
+							gHotTraceCountMap.Clear();		// Makes sense to clear this now, to get accurate usage stats
 #ifdef DAEDALUS_ENABLE_OS_HOOKS
 							Patch_PatchAll();
 #endif
@@ -495,28 +571,18 @@ void CPU_HandleDynaRecOnBranch( bool backwards, bool trace_already_enabled )
 					if( gFragmentCache.GetCacheSize() > gMaxFragmentCacheSize)
 					{
 						gFragmentCache.Clear();
-						gHotTraceCountMap.clear();		// Makes sense to clear this now, to get accurate usage stats
+						gHotTraceCountMap.Clear();		// Makes sense to clear this now, to get accurate usage stats
 #ifdef DAEDALUS_ENABLE_OS_HOOKS
 						Patch_PatchAll();
 #endif
 					}
 
-					// If there is no fragment for this target, start tracing
-					u32 trace_count( ++gHotTraceCountMap[ gCPUState.CurrentPC ] );
-					if( gHotTraceCountMap.size() >= gMaxHotTraceMapSize )
-					{
-						#ifdef DAEDALUS_DEBUG_CONSOLE
-						DBGConsole_Msg( 0, "Hot trace cache hit %d, dumping", gHotTraceCountMap.size() );
-						#endif
-						gHotTraceCountMap.clear();
-						gFragmentCache.Clear();
-#ifdef DAEDALUS_ENABLE_OS_HOOKS
-						Patch_PatchAll();
-#endif
-					}
-					else if( trace_count == gHotTraceThreshold )
+					// If there is no fragment for this target, start tracing.
+					// The table ages itself when it fills up (see CHotTraceTable::Age)
+					u32 trace_count( gHotTraceCountMap.Increment( gCPUState.CurrentPC ) );
+					if( trace_count == gHotTraceThreshold )
 					{
-						//DBGConsole_Msg( 0, "Identified hot trace at [R%08x]! (size is %d)", gCPUState.CurrentPC, gHotTraceCountMap.size() );
+						//DBGConsole_Msg( 0, "Identified hot trace at [R%08x]! (size is %d)", gCPUState.CurrentPC, gHotTraceCountMap.GetSize() );
 						gTraceRecorder.StartTrace( gCPUState.CurrentPC );
 
 						if(!trace_already_enabled)
@@ -532,8 +598,8 @@ void CPU_HandleDynaRecOnBranch( bool backwards, bool trace_already_enabled )
 						{
 							u32 reason( gAbortedTraceReasons[ gCPUState.CurrentPC ] );
 							use( reason );
-							//DBGConsole_Msg( 0, "Hot trace at [R%08x] has count of %d! (reason is %x) size %d", gCPUState.CurrentPC, trace_count, reason, gHotTraceCountMap.size( ) );
-							DAED_LOG( DEBUG_DYNAREC_CACHE, "Hot trace at %08x has count of %d! (reason is %x) size %d", gCPUState.CurrentPC, trace_count, reason, gHotTraceCountMap.size( ) );
+							//DBGConsole_Msg( 0, "Hot trace at [R%08x] has count of %d! (reason is %x) size %d", gCPUState.CurrentPC, trace_count, reason, gHotTraceCountMap.GetSize( ) );
+							DAED_LOG( DEBUG_DYNAREC_CACHE, "Hot trace at %08x has count of %d! (reason is %x) size %d", gCPUState.CurrentPC, trace_count, reason, gHotTraceCountMap.GetSize( ) );
 						}
 						else
 						{
@@ -561,7 +627,7 @@ void CPU_HandleDynaRecOnBranch( bool backwards, bool trace_already_enabled )
 
 void Dynamo_Reset()
 {
-	gHotTraceCountMap.clear();
+	gHotTraceCountMap.Clear();
 	gFragmentCache.Clear();
 	gResetFragmentCache = false;
 	gTraceRecorder.AbortTrace();
@@ -576,11 +642,11 @@ void Dynamo_SelectCore()
 
 	if (trace_enabled)
 	{
-		g_pCPUCore = CPU_Go< true, true >;
+		g_pCPUCore = gBatchCycleAccounting ? CPU_Go< true, true, true > : CPU_Go< true, true, false >;
 	}
 	else
 	{
-		g_pCPUCore = CPU_Go< true, false >;
+		g_pCPUCore = gBatchCycleAccounting ? CPU_Go< true, false, true > : CPU_Go< true, false, false >;
 	}
 }
 
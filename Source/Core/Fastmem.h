@@ -0,0 +1,113 @@
+/*
+Copyright (C) 2012 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#pragma once
+
+#ifndef CORE_FASTMEM_H_
+#define CORE_FASTMEM_H_
+
+#ifdef DAEDALUS_FASTMEM
+
+#include <stddef.h>
+
+//
+//	Fastmem reserves 4GB of host address space, one byte for each N64 address,
+//	and maps RDRAM into it at both 0x80000000 and 0xA0000000. Everything else
+//	(hardware registers, TLB mapped addresses, RDRAM past gRamSize) is left
+//	unmapped, and the fault handler in SysLinux/Utility/FastmemLinux.cpp
+//	decodes the faulting instruction and passes the access on to the usual
+//	g_MemoryLookupTable handlers.
+//
+//	The fault handler can only decode a few simple forms of mov, so accesses
+//	must go through the functions below rather than dereferencing pointers
+//	into the region directly.
+//
+//	It's off unless --fastmem is passed. On a synthetic ROM which mostly
+//	hits RDRAM, the interpreter ran about 9% slower with it on, and the
+//	dynarec about 4% slower, so it hasn't earned being the default yet.
+//
+
+// NULL unless fastmem is active
+extern u8 *		gFastmemBase;
+
+// Maps RDRAM into the region and installs the fault handler. Returns a plain
+// view of RDRAM for g_pMemoryBuffers, or NULL if fastmem couldn't be set up.
+u8 *			Fastmem_Init( u32 ram_size );
+void			Fastmem_Fini();
+
+// Unmaps the mirrors past ram_size, so those accesses reach the handlers
+void			Fastmem_SetRamSize( u32 ram_size );
+
+// KSEG0 and KSEG1. Anything else is TLB mapped, and faulting on every access would be ruinous
+inline bool Fastmem_IsDirectAddress( u32 address )
+{
+	return gFastmemBase != NULL && ( address >> 30 ) == 2;
+}
+
+inline u8 Fastmem_Read8( u32 address )
+{
+	u32 value;
+	asm volatile( "movzbl (%1,%2), %0" : "=r"( value ) : "r"( gFastmemBase ), "r"( u64( address ) ) : "memory" );
+	return u8( value );
+}
+
+inline u16 Fastmem_Read16( u32 address )
+{
+	u32 value;
+	asm volatile( "movzwl (%1,%2), %0" : "=r"( value ) : "r"( gFastmemBase ), "r"( u64( address ) ) : "memory" );
+	return u16( value );
+}
+
+inline u32 Fastmem_Read32( u32 address )
+{
+	u32 value;
+	asm volatile( "movl (%1,%2), %0" : "=r"( value ) : "r"( gFastmemBase ), "r"( u64( address ) ) : "memory" );
+	return value;
+}
+
+inline u64 Fastmem_Read64( u32 address )
+{
+	u64 value;
+	asm volatile( "movq (%1,%2), %0" : "=r"( value ) : "r"( gFastmemBase ), "r"( u64( address ) ) : "memory" );
+	return value;
+}
+
+inline void Fastmem_Write8( u32 address, u8 value )
+{
+	asm volatile( "movb %b0, (%1,%2)" : : "r"( value ), "r"( gFastmemBase ), "r"( u64( address ) ) : "memory" );
+}
+
+inline void Fastmem_Write16( u32 address, u16 value )
+{
+	asm volatile( "movw %w0, (%1,%2)" : : "r"( value ), "r"( gFastmemBase ), "r"( u64( address ) ) : "memory" );
+}
+
+inline void Fastmem_Write32( u32 address, u32 value )
+{
+	asm volatile( "movl %0, (%1,%2)" : : "r"( value ), "r"( gFastmemBase ), "r"( u64( address ) ) : "memory" );
+}
+
+inline void Fastmem_Write64( u32 address, u64 value )
+{
+	asm volatile( "movq %0, (%1,%2)" : : "r"( value ), "r"( gFastmemBase ), "r"( u64( address ) ) : "memory" );
+}
+
+#endif // DAEDALUS_FASTMEM
+
+#endif // CORE_FASTMEM_H_
@@ -20,6 +20,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // Stuff to handle Processor
 #include "stdafx.h"
 
+#include <string.h>
+
 #include "CPU.h"
 #include "Registers.h"					// For REG_?? defines
 #include "Memory.h"
@@ -162,6 +164,335 @@ void Inter_SelectCore()
    g_pCPUCore = CPU_Go;
 }
 
+//*****************************************************************************
+//	Cached interpreter
+//
+//	Ops are decoded once into SDecodedOp, with the operands pulled out and the
+//	handler looked up through the SPECIAL/REGIMM tables. Decoded ops are kept
+//	per physical page of RDRAM. Before an op is executed it is compared with
+//	memory, so self modifying code is handled without any invalidation hooks.
+//
+//	COUNT and the event queue are only updated when an event becomes due, or
+//	before an op which could look at them (loads/stores, COP0, branches etc).
+//	Everything else runs without touching them, so the timing is the same as
+//	the plain interpreter.
+//*****************************************************************************
+#if defined( __GNUC__ )
+#define DAEDALUS_COMPUTED_GOTO
+#endif
+
+namespace
+{
+
+enum EDecodedOpKind
+{
+	KIND_NOP = 0,		// Must be zero, so a cleared page decodes as NOPs
+	KIND_CALL,			// Call the cached handler
+	KIND_DISPATCH,		// Go through R4300Instruction, as SR can swap the COP1 handlers
+	KIND_ADDIU,
+	KIND_SLTI,
+	KIND_SLTIU,
+	KIND_ANDI,
+	KIND_ORI,
+	KIND_XORI,
+	KIND_LUI,
+	KIND_SLL,
+	KIND_SRL,
+	KIND_SRA,
+	KIND_ADDU,
+	KIND_SUBU,
+	KIND_AND,
+	KIND_OR,
+	KIND_XOR,
+	KIND_NOR,
+	KIND_SLT,
+	KIND_SLTU,
+
+	NUM_DECODED_OP_KINDS
+};
+
+struct SDecodedOp
+{
+	u32					Raw;			// The op this was decoded from
+	u8					Kind;
+	u8					Sync;			// Needs COUNT/events to be up to date
+	u8					Rs;
+	u8					Rt;
+	u8					Rd;
+	u8					Sa;
+	u32					Imm;			// Already sign/zero extended as the op requires
+	CPU_Instruction		Handler;
+};
+
+const u32				kPageShift = 12;
+const u32				kPageMask = (1 << kPageShift) - 1;
+const u32				kOpsPerPage = 1 << (kPageShift - 2);
+const u32				kNumPages = MAX_RAM_ADDRESS >> kPageShift;
+
+SDecodedOp *			gDecodedPages[ kNumPages ] = {};
+
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+static void Inter_DecodeOp( SDecodedOp & op, u32 raw )
+{
+	OpCode	op_code;
+	op_code._u32 = raw;
+
+	op.Raw = raw;
+	op.Kind = KIND_DISPATCH;
+	op.Sync = R4300_InstructionNeedsCountSync( op_code );
+	op.Rs = op_code.rs;
+	op.Rt = op_code.rt;
+	op.Rd = op_code.rd;
+	op.Sa = op_code.sa;
+	op.Imm = 0;
+	op.Handler = NULL;
+
+	switch( op_code.op )
+	{
+	case OP_SPECOP:
+		op.Kind = KIND_CALL;
+		op.Handler = R4300_GetInstructionHandler( op_code );
+		switch( op_code.spec_op )
+		{
+		case SpecOp_SLL:	op.Kind = raw == 0 ? KIND_NOP : KIND_SLL;	break;
+		case SpecOp_SRL:	op.Kind = KIND_SRL;		break;
+		case SpecOp_SRA:	op.Kind = KIND_SRA;		break;
+		case SpecOp_ADDU:	op.Kind = KIND_ADDU;	break;
+		case SpecOp_SUBU:	op.Kind = KIND_SUBU;	break;
+		case SpecOp_AND:	op.Kind = KIND_AND;		break;
+		case SpecOp_OR:		op.Kind = KIND_OR;		break;
+		case SpecOp_XOR:	op.Kind = KIND_XOR;		break;
+		case SpecOp_NOR:	op.Kind = KIND_NOR;		break;
+		case SpecOp_SLT:	op.Kind = KIND_SLT;		break;
+		case SpecOp_SLTU:	op.Kind = KIND_SLTU;	break;
+		default:
+			break;
+		}
+		break;
+
+	case OP_REGIMM:
+		op.Kind = KIND_CALL;
+		op.Handler = R4300_GetInstructionHandler( op_code );
+		break;
+
+	case OP_ADDIU:	op.Kind = KIND_ADDIU;	op.Imm = (s32)(s16)op_code.immediate;			break;
+	case OP_SLTI:	op.Kind = KIND_SLTI;	op.Imm = (s32)(s16)op_code.immediate;			break;
+	case OP_SLTIU:	op.Kind = KIND_SLTIU;	op.Imm = (s32)(s16)op_code.immediate;			break;
+	case OP_ANDI:	op.Kind = KIND_ANDI;	op.Imm = (u16)op_code.immediate;				break;
+	case OP_ORI:	op.Kind = KIND_ORI;		op.Imm = (u16)op_code.immediate;				break;
+	case OP_XORI:	op.Kind = KIND_XORI;	op.Imm = (u16)op_code.immediate;				break;
+	case OP_LUI:	op.Kind = KIND_LUI;		op.Imm = (s32)(s16)op_code.immediate << 16;		break;
+
+	default:
+		break;
+	}
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+static SDecodedOp * Inter_GetDecodedPage( u32 page )
+{
+	SDecodedOp *	p_ops( gDecodedPages[ page ] );
+	if( p_ops == NULL )
+	{
+		p_ops = new SDecodedOp[ kOpsPerPage ];
+		memset( p_ops, 0, kOpsPerPage * sizeof( SDecodedOp ) );
+		gDecodedPages[ page ] = p_ops;
+	}
+	return p_ops;
+}
+
+//*****************************************************************************
+//	Run ops from the current page until the PC leaves it or there is
+//	something to do
+//*****************************************************************************
+static void Inter_ExecuteCachedOps()
+{
+	u32		pc( gCPUState.CurrentPC );
+	u32		physical( pc & 0x1FFFFFFF );
+
+	const MemFuncRead & m( g_MemoryLookupTableRead[ pc >> 18 ] );
+
+	// Only code running from RDRAM through KSEG0/KSEG1 is cached
+	if( (pc & 0xC0000000) != 0x80000000 || m.pRead == NULL || physical >= gRamSize )
+	{
+		CPU_EXECUTE_OP< false >();
+		return;
+	}
+
+	SDecodedOp *	p_ops( Inter_GetDecodedPage( physical >> kPageShift ) );
+	const u32		page_base( pc & ~kPageMask );
+	const u32 *		p_code( reinterpret_cast< const u32 * >( m.pRead + page_base ) );
+	u32				index( (pc & kPageMask) >> 2 );
+
+	s32				pending( 0 );
+	s32				budget( gCPUState.Events[ 0 ].mCount );
+
+#ifdef DAEDALUS_COMPUTED_GOTO
+	static const void * const	labels[ NUM_DECODED_OP_KINDS ] =
+	{
+		&&L_KIND_NOP, &&L_KIND_CALL, &&L_KIND_DISPATCH,
+		&&L_KIND_ADDIU, &&L_KIND_SLTI, &&L_KIND_SLTIU, &&L_KIND_ANDI, &&L_KIND_ORI, &&L_KIND_XORI, &&L_KIND_LUI,
+		&&L_KIND_SLL, &&L_KIND_SRL, &&L_KIND_SRA,
+		&&L_KIND_ADDU, &&L_KIND_SUBU, &&L_KIND_AND, &&L_KIND_OR, &&L_KIND_XOR, &&L_KIND_NOR, &&L_KIND_SLT, &&L_KIND_SLTU,
+	};
+#define OP_CASE( kind )		L_##kind:
+#else
+#define OP_CASE( kind )		case kind:
+#endif
+#define OP_NEXT()			goto op_done
+
+	for( ;; )
+	{
+		SDecodedOp &	op( p_ops[ index ] );
+		const u32 *		p_instruction( p_code + index );
+
+		if( DAEDALUS_EXPECT_UNLIKELY( op.Raw != *p_instruction ) )
+		{
+			Inter_DecodeOp( op, *p_instruction );
+		}
+
+		// Cache instruction base pointer (used for SpeedHack() @ R4300.0)
+		gLastAddress = (u8 *)p_instruction;
+
+		if( op.Sync )
+		{
+			CPU_FlushPendingOps( pending );
+			pending = 0;
+		}
+
+#ifdef DAEDALUS_COMPUTED_GOTO
+		goto *labels[ op.Kind ];
+#else
+		switch( op.Kind )
+		{
+#endif
+		OP_CASE( KIND_NOP )			OP_NEXT();
+		OP_CASE( KIND_CALL )		op.Handler( op.Raw );					OP_NEXT();
+		OP_CASE( KIND_DISPATCH )	R4300Instruction[ op.Raw >> 26 ]( op.Raw );	OP_NEXT();
+
+		OP_CASE( KIND_ADDIU )		gGPR[ op.Rt ]._s64 = (s64)(s32)( gGPR[ op.Rs ]._s32_0 + (s32)op.Imm );			OP_NEXT();
+		OP_CASE( KIND_SLTI )		gGPR[ op.Rt ]._u64 = gGPR[ op.Rs ]._s64 < (s64)(s32)op.Imm;						OP_NEXT();
+		OP_CASE( KIND_SLTIU )		gGPR[ op.Rt ]._u64 = gGPR[ op.Rs ]._u64 < (u64)(s64)(s32)op.Imm;				OP_NEXT();
+		OP_CASE( KIND_ANDI )		gGPR[ op.Rt ]._u64 = gGPR[ op.Rs ]._u64 & (u64)op.Imm;							OP_NEXT();
+		OP_CASE( KIND_ORI )			gGPR[ op.Rt ]._u64 = gGPR[ op.Rs ]._u64 | (u64)op.Imm;							OP_NEXT();
+		OP_CASE( KIND_XORI )		gGPR[ op.Rt ]._u64 = gGPR[ op.Rs ]._u64 ^ (u64)op.Imm;							OP_NEXT();
+		OP_CASE( KIND_LUI )			gGPR[ op.Rt ]._s64 = (s64)(s32)op.Imm;											OP_NEXT();
+
+		OP_CASE( KIND_SLL )			gGPR[ op.Rd ]._s64 = (s64)(s32)( gGPR[ op.Rt ]._u32_0 << op.Sa );				OP_NEXT();
+		OP_CASE( KIND_SRL )			gGPR[ op.Rd ]._s64 = (s64)(s32)( gGPR[ op.Rt ]._u32_0 >> op.Sa );				OP_NEXT();
+		OP_CASE( KIND_SRA )			gGPR[ op.Rd ]._s64 = (s64)(s32)( gGPR[ op.Rt ]._s32_0 >> op.Sa );				OP_NEXT();
+
+		OP_CASE( KIND_ADDU )		gGPR[ op.Rd ]._s64 = (s64)(s32)( gGPR[ op.Rs ]._s32_0 + gGPR[ op.Rt ]._s32_0 );	OP_NEXT();
+		OP_CASE( KIND_SUBU )		gGPR[ op.Rd ]._s64 = (s64)(s32)( gGPR[ op.Rs ]._s32_0 - gGPR[ op.Rt ]._s32_0 );	OP_NEXT();
+		OP_CASE( KIND_AND )			gGPR[ op.Rd ]._u64 = gGPR[ op.Rs ]._u64 & gGPR[ op.Rt ]._u64;					OP_NEXT();
+		OP_CASE( KIND_OR )			gGPR[ op.Rd ]._u64 = gGPR[ op.Rs ]._u64 | gGPR[ op.Rt ]._u64;					OP_NEXT();
+		OP_CASE( KIND_XOR )			gGPR[ op.Rd ]._u64 = gGPR[ op.Rs ]._u64 ^ gGPR[ op.Rt ]._u64;					OP_NEXT();
+		OP_CASE( KIND_NOR )			gGPR[ op.Rd ]._u64 = ~( gGPR[ op.Rs ]._u64 | gGPR[ op.Rt ]._u64 );				OP_NEXT();
+		OP_CASE( KIND_SLT )			gGPR[ op.Rd ]._u64 = gGPR[ op.Rs ]._s64 < gGPR[ op.Rt ]._s64;					OP_NEXT();
+		OP_CASE( KIND_SLTU )		gGPR[ op.Rd ]._u64 = gGPR[ op.Rs ]._u64 < gGPR[ op.Rt ]._u64;					OP_NEXT();
+#ifndef DAEDALUS_COMPUTED_GOTO
+		default:
+			NODEFAULT;
+		}
+#endif
+
+op_done:
+		gGPR[0]._u64 = 0;	//Ensure r0 is zero
+
+#ifdef DAEDALUS_PROFILE_EXECUTION
+		gTotalInstructionsEmulated++;
+#endif
+
+		// The op may have added events or skipped to the next one
+		if( op.Sync )
+		{
+			budget = gCPUState.Events[ 0 ].mCount;
+		}
+
+		if( ++pending >= budget )
+		{
+			CPU_FlushPendingOps( pending );
+			pending = 0;
+			budget = gCPUState.Events[ 0 ].mCount;
+		}
+
+		switch (gCPUState.Delay)
+		{
+		case DO_DELAY:
+			INCREMENT_PC();
+			gCPUState.Delay = EXEC_DELAY;
+			break;
+		case EXEC_DELAY:
+			CPU_SetPC(gCPUState.TargetPC);
+			gCPUState.Delay = NO_DELAY;
+			break;
+		case NO_DELAY:
+			INCREMENT_PC();
+			break;
+		default:
+			NODEFAULT;
+		}
+
+		if( gCPUState.GetStuffToDo() != 0 )
+			break;
+
+		u32		offset( gCPUState.CurrentPC - page_base );
+		if( offset > kPageMask )
+			break;
+
+		index = offset >> 2;
+	}
+
+#undef OP_CASE
+#undef OP_NEXT
+
+	CPU_FlushPendingOps( pending );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+static void CPU_GoCached()
+{
+	DAEDALUS_PROFILE( __FUNCTION__ );
+
+	while (CPU_KeepRunning())
+	{
+		while( gCPUState.GetStuffToDo() == 0 )
+		{
+			Inter_ExecuteCachedOps();
+		}
+
+		if (CPU_CheckStuffToDo())
+			break;
+	}
+}
+
+void Inter_SelectCachedCore()
+{
+#ifdef DAEDALUS_ENABLE_SYNCHRONISATION
+	// Synchronisation needs to see every op
+	g_pCPUCore = CPU_Go;
+#else
+	g_pCPUCore = CPU_GoCached;
+#endif
+}
+
+void Inter_Reset()
+{
+	for( u32 i = 0; i < kNumPages; ++i )
+	{
+		delete [] gDecodedPages[ i ];
+		gDecodedPages[ i ] = NULL;
+	}
+}
+
 //*****************************************************************************
 // Hacky function to use when debugging
 //*****************************************************************************
@@ -0,0 +1,188 @@
+/**
+* Mupen64 hle rsp - jpeg.c
+* Copyright (C) 2012 Bobby Smiles                                       *
+* Copyright (C) 2009 Richard Goedeken                                   *
+* Copyright (C) 2002 Hacktarux
+*
+* Mupen64 homepage: http://mupen64.emulation64.com
+* email address: hacktarux@yahoo.fr
+*
+* If you want to contribute to the project please contact
+* me first (maybe someone is already making what you are
+* planning to do).
+*
+*
+* This program is free software; you can redistribute it and/
+* or modify it under the terms of the GNU General Public Li-
+* cence as published by the Free Software Foundation; either
+* version 2 of the Licence, or any later version.
+*
+* This program is distributed in the hope that it will be use-
+* ful, but WITHOUT ANY WARRANTY; without even the implied war-
+* ranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public Licence for more details.
+*
+* You should have received a copy of the GNU General Public
+* Licence along with this program; if not, write to the Free
+* Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139,
+* USA.
+*
+**/
+
+#include "stdafx.h"
+#include "JpegKernels.h"
+
+#include "Debug/DBGConsole.h"
+
+static u16 clamp_RGBA_component(s16 x)
+{
+    if (x > 0xff0) { x = 0xff0; } else if (x < 0) { x = 0; }
+    return (x & 0xf80);
+}
+
+static u16 GetRGBA(s16 y, s16 u, s16 v)
+{
+    const float fY = (float)y + 2048.0f;
+    const float fU = (float)u;
+    const float fV = (float)v;
+
+    const u16 r = clamp_RGBA_component((s16)(fY             + 1.4025*fV));
+    const u16 g = clamp_RGBA_component((s16)(fY - 0.3443*fU - 0.7144*fV));
+    const u16 b = clamp_RGBA_component((s16)(fY + 1.7729*fU            ));
+
+    return (r << 4) | (g >> 1) | (b >> 6) | 1;
+}
+
+static void ConvertRGBA_Scalar(u16 *rgba, const s16 *y, const s16 *u, const s16 *v)
+{
+    for (u32 i {}; i < 8; ++i)
+    {
+        rgba[i] = GetRGBA(y[i], u[i >> 1], v[i >> 1]);
+    }
+}
+
+/***************************************************************************
+ * Fast 2D IDCT using separable formulation and normalization
+ * Computations use single precision floats
+ * Implementation based on Wikipedia :
+ * http://fr.wikipedia.org/wiki/Transform%C3%A9e_en_cosinus_discr%C3%A8te
+ **************************************************************************/
+
+/* Normalized such as C4 = 1 */
+#define C3   1.175875602f
+#define C6   0.541196100f
+#define K1   0.765366865f   //  C2-C6
+#define K2  -1.847759065f   // -C2-C6
+#define K3  -0.390180644f   //  C5-C3
+#define K4  -1.961570561f   // -C5-C3
+#define K5   1.501321110f   //  C1+C3-C5-C7
+#define K6   2.053119869f   //  C1+C3-C5+C7
+#define K7   3.072711027f   //  C1+C3+C5-C7
+#define K8   0.298631336f   // -C1+C3+C5-C7
+#define K9  -0.899976223f   //  C7-C3
+#define K10 -2.562915448f   // -C1-C3
+static void InverseDCT1D(const float * const x, float *dst, u32 stride)
+{
+    float e[4] {};
+    float f[4] {};
+    float x26 {}, x1357 {}, x15 {}, x37 {}, x17 {}, x35 {};
+
+    x15   =  K3 * (x[1] + x[5]);
+    x37   =  K4 * (x[3] + x[7]);
+    x17   =  K9 * (x[1] + x[7]);
+    x35   = K10 * (x[3] + x[5]);
+    x1357 =  C3 * (x[1] + x[3] + x[5] + x[7]);
+    x26   =  C6 * (x[2] + x[6]);
+
+    f[0] = x[0] + x[4];
+    f[1] = x[0] - x[4];
+    f[2] = x26 + K1*x[2];
+    f[3] = x26 + K2*x[6];
+
+    e[0] = x1357 + x15 + K5*x[1] + x17;
+    e[1] = x1357 + x37 + K7*x[3] + x35;
+    e[2] = x1357 + x15 + K6*x[5] + x35;
+    e[3] = x1357 + x37 + K8*x[7] + x17;
+
+    *dst = f[0] + f[2] + e[0]; dst += stride;
+    *dst = f[1] + f[3] + e[1]; dst += stride;
+    *dst = f[1] - f[3] + e[2]; dst += stride;
+    *dst = f[0] - f[2] + e[3]; dst += stride;
+    *dst = f[0] - f[2] - e[3]; dst += stride;
+    *dst = f[1] - f[3] - e[2]; dst += stride;
+    *dst = f[1] + f[3] - e[1]; dst += stride;
+    *dst = f[0] + f[2] - e[0]; dst += stride;
+}
+#undef C3
+#undef C6
+#undef K1
+#undef K2
+#undef K3
+#undef K4
+#undef K5
+#undef K6
+#undef K7
+#undef K8
+#undef K9
+#undef K10
+
+static void InverseDCTSubBlock_Scalar(s16 *dst, const s16 *src)
+{
+    float x[8] {};
+    float block[SUBBLOCK_SIZE] {};
+    u32 i {}, j {};
+
+    /* idct 1d on rows (+transposition) */
+    for (i = 0; i < 8; ++i)
+    {
+        for (j = 0; j < 8; ++j)
+        {
+            x[j] = (float)src[i*8+j];
+        }
+
+        InverseDCT1D(x, &block[i], 8);
+    }
+
+    /* idct 1d on columns (thanks to previous transposition) */
+    for (i = 0; i < 8; ++i)
+    {
+        InverseDCT1D(&block[i*8], x, 1);
+
+        /* C4 = 1 normalization implies a division by 8 */
+        for (j = 0; j < 8; ++j)
+        {
+            dst[i+j*8] = (s16)x[j] >> 3;
+        }
+    }
+}
+
+const JpegKernels gJpegKernelsScalar =
+{
+	"Scalar",
+	InverseDCTSubBlock_Scalar,
+	ConvertRGBA_Scalar,
+};
+
+const JpegKernels * gJpegKernels = &gJpegKernelsScalar;
+
+const JpegKernels * Jpeg_SelectKernels()
+{
+#ifdef DAEDALUS_JPEG_X86
+	__builtin_cpu_init();
+	if( __builtin_cpu_supports( "avx2" ) )
+		return &gJpegKernelsAVX2;
+	if( __builtin_cpu_supports( "sse4.1" ) )
+		return &gJpegKernelsSSE41;
+#endif
+	return &gJpegKernelsScalar;
+}
+
+bool Jpeg_InitKernels()
+{
+	gJpegKernels = Jpeg_SelectKernels();
+
+	#ifdef DAEDALUS_DEBUG_CONSOLE
+	DBGConsole_Msg( 0, "JPEG kernels: %s", gJpegKernels->Name );
+	#endif
+	return true;
+}
@@ -0,0 +1,63 @@
+/*
+Copyright (C) 2001,2006-2007 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#pragma once
+
+#ifndef CORE_JPEGKERNELS_H_
+#define CORE_JPEGKERNELS_H_
+
+#include "Utility/DaedalusTypes.h"
+
+// As with the audio HLE kernels, the SSE4.1 and AVX2 versions are built with
+// per-function target attributes and picked at runtime.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DAEDALUS_JPEG_X86
+#endif
+
+#define SUBBLOCK_SIZE 64
+
+//
+//	The inner loops of the JPEG task (see Core/JpegTask.cpp).
+//	Every implementation must give bit-identical results to the scalar one -
+//	see Core/JpegTask_bench.cpp.
+//
+struct JpegKernels
+{
+	const char *	Name;
+
+	// 8x8 inverse DCT of a subblock. dst and src may be the same.
+	void	(*InverseDCTSubBlock)( s16 * dst, const s16 * src );
+
+	// Converts 8 pixels to RGBA5551. Each u/v sample is shared by two neighbouring pixels.
+	void	(*ConvertRGBA)( u16 * rgba, const s16 * y, const s16 * u, const s16 * v );
+};
+
+extern const JpegKernels	gJpegKernelsScalar;
+#ifdef DAEDALUS_JPEG_X86
+extern const JpegKernels	gJpegKernelsSSE41;
+extern const JpegKernels	gJpegKernelsAVX2;
+#endif
+
+// The fastest set of kernels this CPU supports. Scalar until Jpeg_InitKernels is called.
+extern const JpegKernels *	gJpegKernels;
+
+const JpegKernels *			Jpeg_SelectKernels();
+bool						Jpeg_InitKernels();
+
+#endif // CORE_JPEGKERNELS_H_
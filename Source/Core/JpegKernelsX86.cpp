@@ -0,0 +1,337 @@
+/*
+Copyright (C) 2001,2006-2007 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+//
+//	SSE4.1 and AVX2 versions of the JPEG kernels. These have to match the
+//	scalar versions in JpegKernels.cpp bit for bit, so each lane does exactly
+//	the float (or double) operations the scalar code does, in the same order.
+//	In particular nothing here may be contracted into an FMA.
+//
+
+#include "stdafx.h"
+#include "JpegKernels.h"
+
+#ifdef DAEDALUS_JPEG_X86
+
+#include <immintrin.h>
+
+#define TARGET_SSE41	__attribute__((target("sse4.1")))
+#define TARGET_AVX2		__attribute__((target("avx2")))
+
+// Constants of the IDCT, see InverseDCT1D in JpegKernels.cpp
+static const float	kC3 =  1.175875602f;
+static const float	kC6 =  0.541196100f;
+static const float	kK1 =  0.765366865f;
+static const float	kK2 = -1.847759065f;
+static const float	kK3 = -0.390180644f;
+static const float	kK4 = -1.961570561f;
+static const float	kK5 =  1.501321110f;
+static const float	kK6 =  2.053119869f;
+static const float	kK7 =  3.072711027f;
+static const float	kK8 =  0.298631336f;
+static const float	kK9 = -0.899976223f;
+static const float	kK10 = -2.562915448f;
+
+//*****************************************************************************
+//	SSE4.1
+//*****************************************************************************
+// One 1D IDCT per lane. x[j] holds element j of each lane's row, out[k] gets output k.
+TARGET_SSE41 static inline void InverseDCT1D_SSE41( const __m128 (&x)[8], __m128 (&out)[8] )
+{
+	__m128	x15( _mm_mul_ps( _mm_set1_ps( kK3 ), _mm_add_ps( x[1], x[5] ) ) );
+	__m128	x37( _mm_mul_ps( _mm_set1_ps( kK4 ), _mm_add_ps( x[3], x[7] ) ) );
+	__m128	x17( _mm_mul_ps( _mm_set1_ps( kK9 ), _mm_add_ps( x[1], x[7] ) ) );
+	__m128	x35( _mm_mul_ps( _mm_set1_ps( kK10 ), _mm_add_ps( x[3], x[5] ) ) );
+	__m128	x1357( _mm_mul_ps( _mm_set1_ps( kC3 ), _mm_add_ps( _mm_add_ps( _mm_add_ps( x[1], x[3] ), x[5] ), x[7] ) ) );
+	__m128	x26( _mm_mul_ps( _mm_set1_ps( kC6 ), _mm_add_ps( x[2], x[6] ) ) );
+
+	__m128	f0( _mm_add_ps( x[0], x[4] ) );
+	__m128	f1( _mm_sub_ps( x[0], x[4] ) );
+	__m128	f2( _mm_add_ps( x26, _mm_mul_ps( _mm_set1_ps( kK1 ), x[2] ) ) );
+	__m128	f3( _mm_add_ps( x26, _mm_mul_ps( _mm_set1_ps( kK2 ), x[6] ) ) );
+
+	__m128	e0( _mm_add_ps( _mm_add_ps( _mm_add_ps( x1357, x15 ), _mm_mul_ps( _mm_set1_ps( kK5 ), x[1] ) ), x17 ) );
+	__m128	e1( _mm_add_ps( _mm_add_ps( _mm_add_ps( x1357, x37 ), _mm_mul_ps( _mm_set1_ps( kK7 ), x[3] ) ), x35 ) );
+	__m128	e2( _mm_add_ps( _mm_add_ps( _mm_add_ps( x1357, x15 ), _mm_mul_ps( _mm_set1_ps( kK6 ), x[5] ) ), x35 ) );
+	__m128	e3( _mm_add_ps( _mm_add_ps( _mm_add_ps( x1357, x37 ), _mm_mul_ps( _mm_set1_ps( kK8 ), x[7] ) ), x17 ) );
+
+	__m128	f02p( _mm_add_ps( f0, f2 ) );
+	__m128	f02m( _mm_sub_ps( f0, f2 ) );
+	__m128	f13p( _mm_add_ps( f1, f3 ) );
+	__m128	f13m( _mm_sub_ps( f1, f3 ) );
+
+	out[0] = _mm_add_ps( f02p, e0 );
+	out[1] = _mm_add_ps( f13p, e1 );
+	out[2] = _mm_add_ps( f13m, e2 );
+	out[3] = _mm_add_ps( f02m, e3 );
+	out[4] = _mm_sub_ps( f02m, e3 );
+	out[5] = _mm_sub_ps( f13m, e2 );
+	out[6] = _mm_sub_ps( f13p, e1 );
+	out[7] = _mm_sub_ps( f02p, e0 );
+}
+
+// out[k*8 + r] = IDCT of row r of in, element k. Both passes of the 2D IDCT have this form.
+TARGET_SSE41 static void InverseDCTPass_SSE41( const float * in, float * out )
+{
+	for( u32 half {}; half < 2; ++half )
+	{
+		const float *	rows( in + half * 4 * 8 );
+		__m128			x[8];
+		for( u32 j {}; j < 8; j += 4 )
+		{
+			__m128	r0( _mm_loadu_ps( rows + 0 * 8 + j ) );
+			__m128	r1( _mm_loadu_ps( rows + 1 * 8 + j ) );
+			__m128	r2( _mm_loadu_ps( rows + 2 * 8 + j ) );
+			__m128	r3( _mm_loadu_ps( rows + 3 * 8 + j ) );
+			_MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+			x[j + 0] = r0;
+			x[j + 1] = r1;
+			x[j + 2] = r2;
+			x[j + 3] = r3;
+		}
+
+		__m128	o[8];
+		InverseDCT1D_SSE41( x, o );
+
+		for( u32 k {}; k < 8; ++k )
+		{
+			_mm_storeu_ps( out + k * 8 + half * 4, o[k] );
+		}
+	}
+}
+
+TARGET_SSE41 static void InverseDCTSubBlock_SSE41( s16 * dst, const s16 * src )
+{
+	float	in[SUBBLOCK_SIZE];
+	float	block[SUBBLOCK_SIZE];
+	float	x[SUBBLOCK_SIZE];
+
+	for( u32 i {}; i < SUBBLOCK_SIZE; i += 8 )
+	{
+		__m128i	s( _mm_loadu_si128( (const __m128i *)(src + i) ) );
+		_mm_storeu_ps( in + i,     _mm_cvtepi32_ps( _mm_cvtepi16_epi32( s ) ) );
+		_mm_storeu_ps( in + i + 4, _mm_cvtepi32_ps( _mm_cvtepi16_epi32( _mm_srli_si128( s, 8 ) ) ) );
+	}
+
+	InverseDCTPass_SSE41( in, block );
+	InverseDCTPass_SSE41( block, x );
+
+	// (s16)x >> 3, where the conversion keeps the low 16 bits of the truncated int
+	for( u32 i {}; i < SUBBLOCK_SIZE; i += 8 )
+	{
+		__m128i	lo( _mm_cvttps_epi32( _mm_loadu_ps( x + i ) ) );
+		__m128i	hi( _mm_cvttps_epi32( _mm_loadu_ps( x + i + 4 ) ) );
+		lo = _mm_srai_epi32( _mm_srai_epi32( _mm_slli_epi32( lo, 16 ), 16 ), 3 );
+		hi = _mm_srai_epi32( _mm_srai_epi32( _mm_slli_epi32( hi, 16 ), 16 ), 3 );
+		_mm_storeu_si128( (__m128i *)(dst + i), _mm_packs_epi32( lo, hi ) );
+	}
+}
+
+// clamp_RGBA_component for 4 lanes of truncated ints, keeping the low 16 bits as the scalar (s16) cast does
+TARGET_SSE41 static inline __m128i ClampRGBAComponent_SSE41( __m128i x )
+{
+	x = _mm_srai_epi32( _mm_slli_epi32( x, 16 ), 16 );
+	x = _mm_max_epi32( _mm_min_epi32( x, _mm_set1_epi32( 0xff0 ) ), _mm_setzero_si128() );
+	return _mm_and_si128( x, _mm_set1_epi32( 0xf80 ) );
+}
+
+TARGET_SSE41 static inline __m128i PackRGBA_SSE41( __m128i r, __m128i g, __m128i b )
+{
+	__m128i	rgba( _mm_or_si128( _mm_slli_epi32( ClampRGBAComponent_SSE41( r ), 4 ),
+							    _mm_srli_epi32( ClampRGBAComponent_SSE41( g ), 1 ) ) );
+	rgba = _mm_or_si128( rgba, _mm_srli_epi32( ClampRGBAComponent_SSE41( b ), 6 ) );
+	return _mm_or_si128( rgba, _mm_set1_epi32( 1 ) );
+}
+
+// Two pixels in the low lanes of y/u/v, as doubles the way GetRGBA computes them
+TARGET_SSE41 static inline void GetRGBA2_SSE41( __m128i y, __m128i u, __m128i v, __m128i & r, __m128i & g, __m128i & b )
+{
+	__m128d	fy( _mm_cvtepi32_pd( y ) );
+	__m128d	fu( _mm_cvtepi32_pd( u ) );
+	__m128d	fv( _mm_cvtepi32_pd( v ) );
+
+	r = _mm_cvttpd_epi32( _mm_add_pd( fy, _mm_mul_pd( _mm_set1_pd( 1.4025 ), fv ) ) );
+	g = _mm_cvttpd_epi32( _mm_sub_pd( _mm_sub_pd( fy, _mm_mul_pd( _mm_set1_pd( 0.3443 ), fu ) ), _mm_mul_pd( _mm_set1_pd( 0.7144 ), fv ) ) );
+	b = _mm_cvttpd_epi32( _mm_add_pd( fy, _mm_mul_pd( _mm_set1_pd( 1.7729 ), fu ) ) );
+}
+
+TARGET_SSE41 static void ConvertRGBA_SSE41( u16 * rgba, const s16 * y, const s16 * u, const s16 * v )
+{
+	// fY = y + 2048 is exact as a float, so it can be formed as an int
+	__m128i	y16( _mm_loadu_si128( (const __m128i *)y ) );
+	__m128i	y32[2] = { _mm_add_epi32( _mm_cvtepi16_epi32( y16 ), _mm_set1_epi32( 2048 ) ),
+					   _mm_add_epi32( _mm_cvtepi16_epi32( _mm_srli_si128( y16, 8 ) ), _mm_set1_epi32( 2048 ) ) };
+
+	// Each chroma sample covers two pixels
+	__m128i	u_wide( _mm_cvtepi16_epi32( _mm_loadl_epi64( (const __m128i *)u ) ) );
+	__m128i	v_wide( _mm_cvtepi16_epi32( _mm_loadl_epi64( (const __m128i *)v ) ) );
+	__m128i	u2[2] = { _mm_unpacklo_epi32( u_wide, u_wide ), _mm_unpackhi_epi32( u_wide, u_wide ) };
+	__m128i	v2[2] = { _mm_unpacklo_epi32( v_wide, v_wide ), _mm_unpackhi_epi32( v_wide, v_wide ) };
+
+	__m128i	packed[2];
+	for( u32 h {}; h < 2; ++h )
+	{
+		__m128i	r_lo, g_lo, b_lo, r_hi, g_hi, b_hi;
+		GetRGBA2_SSE41( y32[h], u2[h], v2[h], r_lo, g_lo, b_lo );
+		GetRGBA2_SSE41( _mm_srli_si128( y32[h], 8 ), _mm_srli_si128( u2[h], 8 ), _mm_srli_si128( v2[h], 8 ), r_hi, g_hi, b_hi );
+
+		packed[h] = PackRGBA_SSE41( _mm_unpacklo_epi64( r_lo, r_hi ), _mm_unpacklo_epi64( g_lo, g_hi ), _mm_unpacklo_epi64( b_lo, b_hi ) );
+	}
+
+	_mm_storeu_si128( (__m128i *)rgba, _mm_packus_epi32( packed[0], packed[1] ) );
+}
+
+const JpegKernels gJpegKernelsSSE41 =
+{
+	"SSE4.1",
+	InverseDCTSubBlock_SSE41,
+	ConvertRGBA_SSE41,
+};
+
+//*****************************************************************************
+//	AVX2
+//*****************************************************************************
+TARGET_AVX2 static inline void InverseDCT1D_AVX2( const __m256 (&x)[8], __m256 (&out)[8] )
+{
+	__m256	x15( _mm256_mul_ps( _mm256_set1_ps( kK3 ), _mm256_add_ps( x[1], x[5] ) ) );
+	__m256	x37( _mm256_mul_ps( _mm256_set1_ps( kK4 ), _mm256_add_ps( x[3], x[7] ) ) );
+	__m256	x17( _mm256_mul_ps( _mm256_set1_ps( kK9 ), _mm256_add_ps( x[1], x[7] ) ) );
+	__m256	x35( _mm256_mul_ps( _mm256_set1_ps( kK10 ), _mm256_add_ps( x[3], x[5] ) ) );
+	__m256	x1357( _mm256_mul_ps( _mm256_set1_ps( kC3 ), _mm256_add_ps( _mm256_add_ps( _mm256_add_ps( x[1], x[3] ), x[5] ), x[7] ) ) );
+	__m256	x26( _mm256_mul_ps( _mm256_set1_ps( kC6 ), _mm256_add_ps( x[2], x[6] ) ) );
+
+	__m256	f0( _mm256_add_ps( x[0], x[4] ) );
+	__m256	f1( _mm256_sub_ps( x[0], x[4] ) );
+	__m256	f2( _mm256_add_ps( x26, _mm256_mul_ps( _mm256_set1_ps( kK1 ), x[2] ) ) );
+	__m256	f3( _mm256_add_ps( x26, _mm256_mul_ps( _mm256_set1_ps( kK2 ), x[6] ) ) );
+
+	__m256	e0( _mm256_add_ps( _mm256_add_ps( _mm256_add_ps( x1357, x15 ), _mm256_mul_ps( _mm256_set1_ps( kK5 ), x[1] ) ), x17 ) );
+	__m256	e1( _mm256_add_ps( _mm256_add_ps( _mm256_add_ps( x1357, x37 ), _mm256_mul_ps( _mm256_set1_ps( kK7 ), x[3] ) ), x35 ) );
+	__m256	e2( _mm256_add_ps( _mm256_add_ps( _mm256_add_ps( x1357, x15 ), _mm256_mul_ps( _mm256_set1_ps( kK6 ), x[5] ) ), x35 ) );
+	__m256	e3( _mm256_add_ps( _mm256_add_ps( _mm256_add_ps( x1357, x37 ), _mm256_mul_ps( _mm256_set1_ps( kK8 ), x[7] ) ), x17 ) );
+
+	__m256	f02p( _mm256_add_ps( f0, f2 ) );
+	__m256	f02m( _mm256_sub_ps( f0, f2 ) );
+	__m256	f13p( _mm256_add_ps( f1, f3 ) );
+	__m256	f13m( _mm256_sub_ps( f1, f3 ) );
+
+	out[0] = _mm256_add_ps( f02p, e0 );
+	out[1] = _mm256_add_ps( f13p, e1 );
+	out[2] = _mm256_add_ps( f13m, e2 );
+	out[3] = _mm256_add_ps( f02m, e3 );
+	out[4] = _mm256_sub_ps( f02m, e3 );
+	out[5] = _mm256_sub_ps( f13m, e2 );
+	out[6] = _mm256_sub_ps( f13p, e1 );
+	out[7] = _mm256_sub_ps( f02p, e0 );
+}
+
+TARGET_AVX2 static inline void Transpose8x8_AVX2( __m256 (&m)[8] )
+{
+	__m256	t0( _mm256_unpacklo_ps( m[0], m[1] ) );
+	__m256	t1( _mm256_unpackhi_ps( m[0], m[1] ) );
+	__m256	t2( _mm256_unpacklo_ps( m[2], m[3] ) );
+	__m256	t3( _mm256_unpackhi_ps( m[2], m[3] ) );
+	__m256	t4( _mm256_unpacklo_ps( m[4], m[5] ) );
+	__m256	t5( _mm256_unpackhi_ps( m[4], m[5] ) );
+	__m256	t6( _mm256_unpacklo_ps( m[6], m[7] ) );
+	__m256	t7( _mm256_unpackhi_ps( m[6], m[7] ) );
+
+	__m256	s0( _mm256_shuffle_ps( t0, t2, _MM_SHUFFLE( 1, 0, 1, 0 ) ) );
+	__m256	s1( _mm256_shuffle_ps( t0, t2, _MM_SHUFFLE( 3, 2, 3, 2 ) ) );
+	__m256	s2( _mm256_shuffle_ps( t1, t3, _MM_SHUFFLE( 1, 0, 1, 0 ) ) );
+	__m256	s3( _mm256_shuffle_ps( t1, t3, _MM_SHUFFLE( 3, 2, 3, 2 ) ) );
+	__m256	s4( _mm256_shuffle_ps( t4, t6, _MM_SHUFFLE( 1, 0, 1, 0 ) ) );
+	__m256	s5( _mm256_shuffle_ps( t4, t6, _MM_SHUFFLE( 3, 2, 3, 2 ) ) );
+	__m256	s6( _mm256_shuffle_ps( t5, t7, _MM_SHUFFLE( 1, 0, 1, 0 ) ) );
+	__m256	s7( _mm256_shuffle_ps( t5, t7, _MM_SHUFFLE( 3, 2, 3, 2 ) ) );
+
+	m[0] = _mm256_permute2f128_ps( s0, s4, 0x20 );
+	m[1] = _mm256_permute2f128_ps( s1, s5, 0x20 );
+	m[2] = _mm256_permute2f128_ps( s2, s6, 0x20 );
+	m[3] = _mm256_permute2f128_ps( s3, s7, 0x20 );
+	m[4] = _mm256_permute2f128_ps( s0, s4, 0x31 );
+	m[5] = _mm256_permute2f128_ps( s1, s5, 0x31 );
+	m[6] = _mm256_permute2f128_ps( s2, s6, 0x31 );
+	m[7] = _mm256_permute2f128_ps( s3, s7, 0x31 );
+}
+
+TARGET_AVX2 static void InverseDCTSubBlock_AVX2( s16 * dst, const s16 * src )
+{
+	__m256	m[8];
+	for( u32 r {}; r < 8; ++r )
+	{
+		m[r] = _mm256_cvtepi32_ps( _mm256_cvtepi16_epi32( _mm_loadu_si128( (const __m128i *)(src + r * 8) ) ) );
+	}
+
+	// Rows of the block after each pass are the outputs of the 1D IDCTs, so transpose to put the inputs in lanes
+	__m256	o[8];
+	Transpose8x8_AVX2( m );
+	InverseDCT1D_AVX2( m, o );
+	Transpose8x8_AVX2( o );
+	InverseDCT1D_AVX2( o, m );
+
+	for( u32 r {}; r < 8; r += 2 )
+	{
+		__m256i	a( _mm256_cvttps_epi32( m[r] ) );
+		__m256i	b( _mm256_cvttps_epi32( m[r + 1] ) );
+		a = _mm256_srai_epi32( _mm256_srai_epi32( _mm256_slli_epi32( a, 16 ), 16 ), 3 );
+		b = _mm256_srai_epi32( _mm256_srai_epi32( _mm256_slli_epi32( b, 16 ), 16 ), 3 );
+
+		// packs works within 128 bit lanes, so fix up the order afterwards
+		__m256i	ab( _mm256_permute4x64_epi64( _mm256_packs_epi32( a, b ), _MM_SHUFFLE( 3, 1, 2, 0 ) ) );
+		_mm256_storeu_si256( (__m256i *)(dst + r * 8), ab );
+	}
+}
+
+TARGET_AVX2 static inline __m128i GetRGBA4_AVX2( __m128i y, __m128i u, __m128i v )
+{
+	__m256d	fy( _mm256_cvtepi32_pd( y ) );
+	__m256d	fu( _mm256_cvtepi32_pd( u ) );
+	__m256d	fv( _mm256_cvtepi32_pd( v ) );
+
+	__m128i	r( _mm256_cvttpd_epi32( _mm256_add_pd( fy, _mm256_mul_pd( _mm256_set1_pd( 1.4025 ), fv ) ) ) );
+	__m128i	g( _mm256_cvttpd_epi32( _mm256_sub_pd( _mm256_sub_pd( fy, _mm256_mul_pd( _mm256_set1_pd( 0.3443 ), fu ) ), _mm256_mul_pd( _mm256_set1_pd( 0.7144 ), fv ) ) ) );
+	__m128i	b( _mm256_cvttpd_epi32( _mm256_add_pd( fy, _mm256_mul_pd( _mm256_set1_pd( 1.7729 ), fu ) ) ) );
+
+	return PackRGBA_SSE41( r, g, b );
+}
+
+TARGET_AVX2 static void ConvertRGBA_AVX2( u16 * rgba, const s16 * y, const s16 * u, const s16 * v )
+{
+	__m128i	y16( _mm_loadu_si128( (const __m128i *)y ) );
+	__m128i	y32_lo( _mm_add_epi32( _mm_cvtepi16_epi32( y16 ), _mm_set1_epi32( 2048 ) ) );
+	__m128i	y32_hi( _mm_add_epi32( _mm_cvtepi16_epi32( _mm_srli_si128( y16, 8 ) ), _mm_set1_epi32( 2048 ) ) );
+
+	__m128i	u_wide( _mm_cvtepi16_epi32( _mm_loadl_epi64( (const __m128i *)u ) ) );
+	__m128i	v_wide( _mm_cvtepi16_epi32( _mm_loadl_epi64( (const __m128i *)v ) ) );
+
+	__m128i	lo( GetRGBA4_AVX2( y32_lo, _mm_unpacklo_epi32( u_wide, u_wide ), _mm_unpacklo_epi32( v_wide, v_wide ) ) );
+	__m128i	hi( GetRGBA4_AVX2( y32_hi, _mm_unpackhi_epi32( u_wide, u_wide ), _mm_unpackhi_epi32( v_wide, v_wide ) ) );
+
+	_mm_storeu_si128( (__m128i *)rgba, _mm_packus_epi32( lo, hi ) );
+}
+
+const JpegKernels gJpegKernelsAVX2 =
+{
+	"AVX2",
+	InverseDCTSubBlock_AVX2,
+	ConvertRGBA_AVX2,
+};
+
+#endif // DAEDALUS_JPEG_X86
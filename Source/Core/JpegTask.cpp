@@ -33,11 +33,23 @@
 
 #include <stdlib.h>
 
+#include <vector>
+
 #include "Debug/DBGConsole.h"
+#include "JpegKernels.h"
 #include "Memory.h"
 #include "OSHLE/ultra_sptask.h"
+#include "Utility/ThreadPool.h"
+
+#ifdef DAEDALUS_CAPTURE_JPEG_TASKS
+#include <stdio.h>
+#endif
+
+/* FIXME: assume presence of expansion pack */
+#define MEMMASK 0x7fffff
 
-#define SUBBLOCK_SIZE 64
+// Macroblocks are independent once their DC values are known, so they're decoded across the thread pool in batches of this many
+static const u32 kMacroblocksPerBatch = 4;
 
 typedef void (*tile_line_emitter_t)(const s16 *y, const s16 *u, u32 address);
 
@@ -52,11 +64,9 @@ static void rdram_write_many_u32(const u32 *src, u32 address, u32 count);
 static u8 clamp_u8(s16 x);
 //static s16 clamp_s12(s16 x);
 static s16 clamp_s16(s32 x);
-static u16 clamp_RGBA_component(s16 x);
 
 /* pixel conversion & foratting */
 static u32 GetUYVY(s16 y1, s16 y2, s16 u, s16 v);
-static u16 GetRGBA(s16 y, s16 u, s16 v);
 
 /* tile line emitters */
 static void EmitYUVTileLine(const s16 *y, const s16 *u, u32 address);
@@ -64,7 +74,7 @@ static void EmitYUVTileLine(const s16 *y, const s16 *u, u32 address);
 static void EmitRGBATileLine(const s16 *y, const s16 *u, u32 address);
 
 /* macroblocks operations */
-static void DecodeMacroblock1(s16 *macroblock, s32 *y_dc, s32 *u_dc, s32 *v_dc, const s16 *qtable);
+static void DecodeMacroblock1(s16 *macroblock, const s16 *dc, const s16 *qtable);
 static void DecodeMacroblock2(s16 *macroblock, u32 subblock_count, const s16 qtables[3][SUBBLOCK_SIZE]);
 //static void DecodeMacroblock3(s16 *macroblock, u32 subblock_count, const s16 qtables[3][SUBBLOCK_SIZE]);
 static void EmitTilesMode0(const tile_line_emitter_t emit_line, const s16 *macroblock, u32 address);
@@ -77,8 +87,6 @@ static void ReorderSubBlock(s16 *dst, const s16 *src, const u32 *table);
 static void MultSubBlocks(s16 *dst, const s16 *src1, const s16 *src2, u32 shift);
 static void ScaleSubBlock(s16 *dst, const s16 *src, s16 scale);
 static void RShiftSubBlock(s16 *dst, const s16 *src, u32 shift);
-static void InverseDCT1D(const float * const x, float *dst, u32 stride);
-static void InverseDCTSubBlock(s16 *dst, const s16 *src);
 //static void RescaleYSubBlock(s16 *dst, const s16 *src);
 //static void RescaleUVSubBlock(s16 *dst, const s16 *src);
 
@@ -122,6 +130,71 @@ const u32 TRANSPOSE_TABLE[SUBBLOCK_SIZE] =
 };
 
 
+/***************************************************************************
+ * The task's pointers hold N64 addresses, which always fit in 32 bits.
+ **************************************************************************/
+static u32 GetTaskDataAddress(const OSTask *task)
+{
+    return (u32)(uintptr_t)task->t.data_ptr;
+}
+
+#ifdef DAEDALUS_CAPTURE_JPEG_TASKS
+static FILE * gJpegCaptureFile {};
+
+/***************************************************************************
+ * Appends a task and the RDRAM it reads to jpeg_tasks.bin, for
+ * Core/JpegTask_bench.cpp. Each record is:
+ *   u32 tag ('P' or 'O'), u32 data_ptr, u32 data_size, u32 yield_data_size,
+ *   u32 num_ranges, then num_ranges of { u32 address, u32 length, u8 rdram[length] }
+ * with the RDRAM bytes as they are in g_pu8RamBase.
+ **************************************************************************/
+static void JpegCapture_Write(u32 tag, const OSTask *task, const u32 (*ranges)[2], u32 num_ranges)
+{
+    if (gJpegCaptureFile == NULL)
+    {
+        gJpegCaptureFile = fopen("jpeg_tasks.bin", "wb");
+        if (gJpegCaptureFile == NULL) { return; }
+    }
+
+    u32 header[5] {tag, GetTaskDataAddress(task), task->t.data_size, task->t.yield_data_size, num_ranges};
+    fwrite(header, sizeof(header), 1, gJpegCaptureFile);
+
+    for (u32 i {}; i < num_ranges; ++i)
+    {
+        u32 address {ranges[i][0] & MEMMASK};
+        u32 length {ranges[i][1]};
+        if (length > MEMMASK + 1 - address) { length = MEMMASK + 1 - address; }
+        fwrite(&address, sizeof(address), 1, gJpegCaptureFile);
+        fwrite(&length, sizeof(length), 1, gJpegCaptureFile);
+        fwrite(g_pu8RamBase + address, length, 1, gJpegCaptureFile);
+    }
+    fflush(gJpegCaptureFile);
+}
+#endif
+
+struct JpegDecodePSJob
+{
+    u32 address;
+    u32 subblock_count;
+    u32 macroblock_size;
+    const s16 (*qtables)[SUBBLOCK_SIZE];
+    void (*EmitTilesMode)(const tile_line_emitter_t, const s16 *, u32);
+};
+
+static void jpeg_decode_PS_Macroblocks(void *arg, u32 begin, u32 end)
+{
+    const JpegDecodePSJob &job {*(const JpegDecodePSJob *)arg};
+    std::vector<s16> macroblock(job.macroblock_size >> 1);
+
+    for (u32 mb = begin; mb < end; ++mb)
+    {
+        u32 address {job.address + mb*job.macroblock_size};
+
+        rdram_read_many_u16((u16*)macroblock.data(), address, job.macroblock_size >> 1);
+        DecodeMacroblock2(macroblock.data(), job.subblock_count, job.qtables);
+        job.EmitTilesMode(EmitRGBATileLine, macroblock.data(), address);
+    }
+}
 
 /***************************************************************************
  * JPEG decoding ucode found in Ocarina of Time, Pokemon Stadium 1 and
@@ -129,9 +202,7 @@ const u32 TRANSPOSE_TABLE[SUBBLOCK_SIZE] =
  **************************************************************************/
 void jpeg_decode_PS(OSTask *task)
 {
-	s16 *macroblock {};
     s16 qtables[3][SUBBLOCK_SIZE];
-    u32 mb {};
 
     #ifdef DAEDALUS_DEBUG_CONSOLE
     if (task->t.flags & 0x1)
@@ -140,12 +211,13 @@ void jpeg_decode_PS(OSTask *task)
         return;
     }
     #endif
-    u32       address          {rdram_read_u32((u32)task->t.data_ptr)};
-    const u32 macroblock_count {rdram_read_u32((u32)task->t.data_ptr + 4)};
-    const u32 mode             {rdram_read_u32((u32)task->t.data_ptr + 8)};
-    const u32 qtableY_ptr      {rdram_read_u32((u32)task->t.data_ptr + 12)};
-    const u32 qtableU_ptr      {rdram_read_u32((u32)task->t.data_ptr + 16)};
-    const u32 qtableV_ptr      {rdram_read_u32((u32)task->t.data_ptr + 20)};
+    const u32 data_ptr         {GetTaskDataAddress(task)};
+    u32       address          {rdram_read_u32(data_ptr)};
+    const u32 macroblock_count {rdram_read_u32(data_ptr + 4)};
+    const u32 mode             {rdram_read_u32(data_ptr + 8)};
+    const u32 qtableY_ptr      {rdram_read_u32(data_ptr + 12)};
+    const u32 qtableU_ptr      {rdram_read_u32(data_ptr + 16)};
+    const u32 qtableV_ptr      {rdram_read_u32(data_ptr + 20)};
 
     #ifdef DAEDALUS_DEBUG_CONSOLE
     if (mode != 0 && mode != 2)
@@ -159,38 +231,56 @@ void jpeg_decode_PS(OSTask *task)
     rdram_read_many_u16((u16*)qtables[1], qtableU_ptr, SUBBLOCK_SIZE);
     rdram_read_many_u16((u16*)qtables[2], qtableV_ptr, SUBBLOCK_SIZE);
 
-	void (*EmitTilesMode)(const tile_line_emitter_t, const s16 *, u32);
+	const u32 subblock_count {mode + 4};
+	const u32 macroblock_size {2*subblock_count*SUBBLOCK_SIZE};
+
+#ifdef DAEDALUS_CAPTURE_JPEG_TASKS
+    const u32 ranges[5][2] {
+        {data_ptr, 24},
+        {qtableY_ptr, 2*SUBBLOCK_SIZE}, {qtableU_ptr, 2*SUBBLOCK_SIZE}, {qtableV_ptr, 2*SUBBLOCK_SIZE},
+        {address, macroblock_count*macroblock_size} };
+    JpegCapture_Write('P', task, ranges, 5);
+#endif
+
+    JpegDecodePSJob job;
+    job.address = address;
+    job.subblock_count = subblock_count;
+    job.macroblock_size = macroblock_size;
+    job.qtables = (const s16 (*)[SUBBLOCK_SIZE])qtables;
 
 	if (mode == 0)
 	{
-		EmitTilesMode =  EmitTilesMode0;
+		job.EmitTilesMode =  EmitTilesMode0;
 	}
 	else
 	{
-		EmitTilesMode =  EmitTilesMode2;
+		job.EmitTilesMode =  EmitTilesMode2;
 	}
 
-	const u32 subblock_count {mode + 4};
-	const u32 macroblock_size {2*subblock_count*SUBBLOCK_SIZE};
+    // Each macroblock's tiles are written over its own coefficients, so they don't interfere
+    ThreadPool_ParallelFor(macroblock_count, kMacroblocksPerBatch, jpeg_decode_PS_Macroblocks, &job);
+}
 
-	macroblock = (s16 *)malloc(sizeof(*macroblock) * macroblock_size);
-  #ifdef DAEDALUS_DEBUG_CONSOLE
-	if (!macroblock)
-	{
-		DBGConsole_Msg(0, "jpeg_decode_PS: could not allocate macroblock");
-		return;
-	}
-  #endif
+struct JpegDecodeOBJob
+{
+    u32 address;
+    const s16 *dcs;            // The running DC values, 6 per macroblock
+    const s16 *qtable;
+};
 
-    for (mb = 0; mb < macroblock_count; ++mb)
+static void jpeg_decode_OB_Macroblocks(void *arg, u32 begin, u32 end)
+{
+    const JpegDecodeOBJob &job {*(const JpegDecodeOBJob *)arg};
+
+    for (u32 mb = begin; mb < end; ++mb)
     {
-        rdram_read_many_u16((u16*)macroblock, address, macroblock_size >> 1);
-        DecodeMacroblock2(macroblock, subblock_count, (const s16 (*)[SUBBLOCK_SIZE])qtables);
-		EmitTilesMode(EmitRGBATileLine, macroblock, address);
+        s16 macroblock[6*SUBBLOCK_SIZE];
+        u32 address {job.address + mb*(2*6*SUBBLOCK_SIZE)};
 
-        address += macroblock_size;
+        rdram_read_many_u16((u16*)macroblock, address, 6*SUBBLOCK_SIZE);
+        DecodeMacroblock1(macroblock, &job.dcs[mb*6], job.qtable);
+        EmitTilesMode2(EmitYUVTileLine, macroblock, address);
     }
-	free(macroblock);
 }
 
 /***************************************************************************
@@ -199,14 +289,18 @@ void jpeg_decode_PS(OSTask *task)
 void jpeg_decode_OB(OSTask *task)
 {
     s16 qtable[SUBBLOCK_SIZE] {};
-    u32 mb {};
 
     s32 y_dc {}, u_dc {}, v_dc {};
 
-	u32  address  {(u32)task->t.data_ptr};
+	u32  address  {GetTaskDataAddress(task)};
 	const u32 macroblock_count {task->t.data_size};
 	const u32  qscale   {task->t.yield_data_size};
 
+#ifdef DAEDALUS_CAPTURE_JPEG_TASKS
+    const u32 ranges[1][2] { {address, macroblock_count*(2*6*SUBBLOCK_SIZE)} };
+    JpegCapture_Write('O', task, ranges, 1);
+#endif
+
     if (task->t.yield_data_size != 0 )
     {
         if (task->t.yield_data_size > 0)
@@ -219,16 +313,31 @@ void jpeg_decode_OB(OSTask *task)
         }
     }
 
-    for (mb = 0; mb < macroblock_count; ++mb)
+    // The DC coefficients are deltas from the previous subblock's, so accumulate them up front.
+    // Nothing is written over a macroblock until it's decoded, so they can be read straight from RDRAM.
+    std::vector<s16> dcs(macroblock_count*6);
+    for (u32 mb {}; mb < macroblock_count; ++mb)
     {
-        s16 macroblock[6*SUBBLOCK_SIZE];
+        for (u32 sb {}; sb < 6; ++sb)
+        {
+            u16 dc {};
+            rdram_read_many_u16(&dc, address + mb*(2*6*SUBBLOCK_SIZE) + sb*(2*SUBBLOCK_SIZE), 1);
+            switch(sb)
+            {
+            case 0: case 1: case 2: case 3:
+                    y_dc += (s16)dc; dcs[mb*6 + sb] = y_dc & 0xffff; break;
+            case 4: u_dc += (s16)dc; dcs[mb*6 + sb] = u_dc & 0xffff; break;
+            case 5: v_dc += (s16)dc; dcs[mb*6 + sb] = v_dc & 0xffff; break;
+            }
+        }
+    }
 
-        rdram_read_many_u16((u16*)macroblock, address, 6*SUBBLOCK_SIZE);
-        DecodeMacroblock1(macroblock, &y_dc, &u_dc, &v_dc, (qscale != 0) ? qtable : NULL);
-        EmitTilesMode2(EmitYUVTileLine, macroblock, address);
+    JpegDecodeOBJob job;
+    job.address = address;
+    job.dcs = dcs.data();
+    job.qtable = (qscale != 0) ? qtable : NULL;
 
-        address += (2*6*SUBBLOCK_SIZE);
-    }
+    ThreadPool_ParallelFor(macroblock_count, kMacroblocksPerBatch, jpeg_decode_OB_Macroblocks, &job);
 }
 
 static u8 clamp_u8(s16 x)
@@ -248,12 +357,6 @@ static s16 clamp_s16(s32 x)
     return x;
 }
 
-static u16 clamp_RGBA_component(s16 x)
-{
-    if (x > 0xff0) { x = 0xff0; } else if (x < 0) { x = 0; }
-    return (x & 0xf80);
-}
-
 static u32 GetUYVY(s16 y1, s16 y2, s16 u, s16 v)
 {
     return (u32)clamp_u8(u)  << 24
@@ -262,19 +365,6 @@ static u32 GetUYVY(s16 y1, s16 y2, s16 u, s16 v)
         |  (u32)clamp_u8(y2);
 }
 
-static u16 GetRGBA(s16 y, s16 u, s16 v)
-{
-    const float fY = (float)y + 2048.0f;
-    const float fU = (float)u;
-    const float fV = (float)v;
-
-    const u16 r = clamp_RGBA_component((s16)(fY             + 1.4025*fV));
-    const u16 g = clamp_RGBA_component((s16)(fY - 0.3443*fU - 0.7144*fV));
-    const u16 b = clamp_RGBA_component((s16)(fY + 1.7729*fU            ));
-
-    return (r << 4) | (g >> 1) | (b >> 6) | 1;
-}
-
 static void EmitYUVTileLine(const s16 *y, const s16 *u, u32 address)
 {
     u32 uyvy[8] {};
@@ -320,22 +410,8 @@ static void EmitRGBATileLine(const s16 *y, const s16 *u, u32 address)
     const s16 * const v  = u + SUBBLOCK_SIZE;
     const s16 * const y2 = y + SUBBLOCK_SIZE;
 
-    rgba[0]  = GetRGBA(y[0],  u[0], v[0]);
-    rgba[1]  = GetRGBA(y[1],  u[0], v[0]);
-    rgba[2]  = GetRGBA(y[2],  u[1], v[1]);
-    rgba[3]  = GetRGBA(y[3],  u[1], v[1]);
-    rgba[4]  = GetRGBA(y[4],  u[2], v[2]);
-    rgba[5]  = GetRGBA(y[5],  u[2], v[2]);
-    rgba[6]  = GetRGBA(y[6],  u[3], v[3]);
-    rgba[7]  = GetRGBA(y[7],  u[3], v[3]);
-    rgba[8]  = GetRGBA(y2[0], u[4], v[4]);
-    rgba[9]  = GetRGBA(y2[1], u[4], v[4]);
-    rgba[10] = GetRGBA(y2[2], u[5], v[5]);
-    rgba[11] = GetRGBA(y2[3], u[5], v[5]);
-    rgba[12] = GetRGBA(y2[4], u[6], v[6]);
-    rgba[13] = GetRGBA(y2[5], u[6], v[6]);
-    rgba[14] = GetRGBA(y2[6], u[7], v[7]);
-    rgba[15] = GetRGBA(y2[7], u[7], v[7]);
+    gJpegKernels->ConvertRGBA(&rgba[0], y,  &u[0], &v[0]);
+    gJpegKernels->ConvertRGBA(&rgba[8], y2, &u[4], &v[4]);
 
     rdram_write_many_u16(rgba, address, 16);
 }
@@ -374,27 +450,20 @@ static void EmitTilesMode2(const tile_line_emitter_t emit_line, const s16 *macro
     }
 }
 
-static void DecodeMacroblock1(s16 *macroblock, s32 *y_dc, s32 *u_dc, s32 *v_dc, const s16 *qtable)
+static void DecodeMacroblock1(s16 *macroblock, const s16 *dc, const s16 *qtable)
 {
 
     for (u32 sb = 0; sb < 6; ++sb)
     {
         s16 tmp_sb[SUBBLOCK_SIZE] {};
 
-        /* update DC */
-        s32 dc {(s32)macroblock[0]};
-        switch(sb)
-        {
-        case 0: case 1: case 2: case 3:
-                *y_dc += dc; macroblock[0] = *y_dc & 0xffff; break;
-        case 4: *u_dc += dc; macroblock[0] = *u_dc & 0xffff; break;
-        case 5: *v_dc += dc; macroblock[0] = *v_dc & 0xffff; break;
-        }
+        /* DC, already accumulated by jpeg_decode_OB */
+        macroblock[0] = dc[sb];
 
         ZigZagSubBlock(tmp_sb, macroblock);
         if (qtable != NULL) { MultSubBlocks(tmp_sb, tmp_sb, qtable, 0); }
         TransposeSubBlock(macroblock, tmp_sb);
-        InverseDCTSubBlock(macroblock, macroblock);
+        gJpegKernels->InverseDCTSubBlock(macroblock, macroblock);
 
         macroblock += SUBBLOCK_SIZE;
     }
@@ -413,7 +482,7 @@ static void DecodeMacroblock2(s16 *macroblock, u32 subblock_count, const s16 qta
 
         MultSubBlocks(macroblock, macroblock, qtables[q], 4);
         ZigZagSubBlock(tmp_sb, macroblock);
-        InverseDCTSubBlock(macroblock, tmp_sb);
+        gJpegKernels->InverseDCTSubBlock(macroblock, tmp_sb);
 
         macroblock += SUBBLOCK_SIZE;
     }
@@ -499,100 +568,6 @@ static void RShiftSubBlock(s16 *dst, const s16 *src, u32 shift)
     }
 }
 
-/***************************************************************************
- * Fast 2D IDCT using separable formulation and normalization
- * Computations use single precision floats
- * Implementation based on Wikipedia :
- * http://fr.wikipedia.org/wiki/Transform%C3%A9e_en_cosinus_discr%C3%A8te
- **************************************************************************/
-
-/* Normalized such as C4 = 1 */
-#define C3   1.175875602f
-#define C6   0.541196100f
-#define K1   0.765366865f   //  C2-C6
-#define K2  -1.847759065f   // -C2-C6
-#define K3  -0.390180644f   //  C5-C3
-#define K4  -1.961570561f   // -C5-C3
-#define K5   1.501321110f   //  C1+C3-C5-C7
-#define K6   2.053119869f   //  C1+C3-C5+C7
-#define K7   3.072711027f   //  C1+C3+C5-C7
-#define K8   0.298631336f   // -C1+C3+C5-C7
-#define K9  -0.899976223f   //  C7-C3
-#define K10 -2.562915448f   // -C1-C3
-static void InverseDCT1D(const float * const x, float *dst, u32 stride)
-{
-    float e[4] {};
-    float f[4] {};
-    float x26 {}, x1357 {}, x15 {}, x37 {}, x17 {}, x35 {};
-
-    x15   =  K3 * (x[1] + x[5]);
-    x37   =  K4 * (x[3] + x[7]);
-    x17   =  K9 * (x[1] + x[7]);
-    x35   = K10 * (x[3] + x[5]);
-    x1357 =  C3 * (x[1] + x[3] + x[5] + x[7]);
-    x26   =  C6 * (x[2] + x[6]);
-
-    f[0] = x[0] + x[4];
-    f[1] = x[0] - x[4];
-    f[2] = x26 + K1*x[2];
-    f[3] = x26 + K2*x[6];
-
-    e[0] = x1357 + x15 + K5*x[1] + x17;
-    e[1] = x1357 + x37 + K7*x[3] + x35;
-    e[2] = x1357 + x15 + K6*x[5] + x35;
-    e[3] = x1357 + x37 + K8*x[7] + x17;
-
-    *dst = f[0] + f[2] + e[0]; dst += stride;
-    *dst = f[1] + f[3] + e[1]; dst += stride;
-    *dst = f[1] - f[3] + e[2]; dst += stride;
-    *dst = f[0] - f[2] + e[3]; dst += stride;
-    *dst = f[0] - f[2] - e[3]; dst += stride;
-    *dst = f[1] - f[3] - e[2]; dst += stride;
-    *dst = f[1] + f[3] - e[1]; dst += stride;
-    *dst = f[0] + f[2] - e[0]; dst += stride;
-}
-#undef C3
-#undef C6
-#undef K1
-#undef K2
-#undef K3
-#undef K4
-#undef K5
-#undef K6
-#undef K7
-#undef K8
-#undef K9
-#undef K10
-
-static void InverseDCTSubBlock(s16 *dst, const s16 *src)
-{
-    float x[8] {};
-    float block[SUBBLOCK_SIZE] {};
-    u32 i {}, j {};
-
-    /* idct 1d on rows (+transposition) */
-    for (i = 0; i < 8; ++i)
-    {
-        for (j = 0; j < 8; ++j)
-        {
-            x[j] = (float)src[i*8+j];
-        }
-
-        InverseDCT1D(x, &block[i], 8);
-    }
-
-    /* idct 1d on columns (thanks to previous transposition) */
-    for (i = 0; i < 8; ++i)
-    {
-        InverseDCT1D(&block[i*8], x, 1);
-
-        /* C4 = 1 normalization implies a division by 8 */
-        for (j = 0; j < 8; ++j)
-        {
-            dst[i+j*8] = (s16)x[j] >> 3;
-        }
-    }
-}
 /*
 static void RescaleYSubBlock(s16 *dst, const s16 *src)
 {
@@ -621,9 +596,6 @@ static void RescaleUVSubBlock(s16 *dst, const s16 *src)
 */
 
 
-/* FIXME: assume presence of expansion pack */
-#define MEMMASK 0x7fffff
-
 //ToDo: fast_memcpy_swizzle?
 static void rdram_read_many_u16(u16 *dst, u32 address, u32 count)
 {
@@ -642,6 +614,7 @@ static void rdram_read_many_u16(u16 *dst, u32 address, u32 count)
 static void rdram_write_many_u16(const u16 *src, u32 address, u32 count)
 {
 	u8 *dst {g_pu8RamBase + (address& MEMMASK)};
+	DirtyPages_MarkRange(address & MEMMASK, count * 2);
     while (count != 0)
     {
        *(u8*)((uintptr_t)dst++ ^ U8_TWIDDLE) = (u8)(*src >> 8);
@@ -666,6 +639,7 @@ static u32 rdram_read_u32(u32 address)
 static void rdram_write_many_u32(const u32 *src, u32 address, u32 count)
 {
 	u8 *dst {g_pu8RamBase + (address& MEMMASK)};
+	DirtyPages_MarkRange(address & MEMMASK, count * 4);
     while (count != 0)
     {
        *(u8*)((uintptr_t)dst++ ^ U8_TWIDDLE) = (u8)(*src >> 24);
@@ -0,0 +1,382 @@
+// Benchmark for the JPEG RSP tasks. Replays tasks through the scalar, SSE4.1 and AVX2 kernels, both on
+// the calling thread and across the thread pool, checking the RDRAM each leaves behind matches the
+// single threaded scalar run byte for byte.
+// Tasks are written to jpeg_tasks.bin by builds with DAEDALUS_CAPTURE_JPEG_TASKS defined, and are
+// passed as the first argument; without one, randomly generated Pokemon Stadium (both modes) and
+// Ogre Battle tasks are replayed instead.
+
+#include "stdafx.h"
+#include "Core/JpegKernels.h"
+#include "Core/Memory.h"
+#include "OSHLE/ultra_sptask.h"
+#include "Utility/ThreadPool.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+void jpeg_decode_PS(OSTask *task);
+void jpeg_decode_OB(OSTask *task);
+
+void *	g_pMemoryBuffers[ NUM_MEM_BUFFERS ];
+
+static const u32	kRamSize = 8 * 1024 * 1024;
+static const u32	kNumSyntheticTasks = 8;
+static const u32	kMacroblocksPerTask = 300;			// Roughly a 320x240 picture
+static const u32	kMinReplayedMacroblocks = 200000;
+
+struct SRange
+{
+	u32					Address;
+	std::vector< u8 >	Data;
+};
+
+struct STask
+{
+	u32					Tag;				// 'P' for jpeg_decode_PS, 'O' for jpeg_decode_OB
+	u32					DataPtr;
+	u32					DataSize;
+	u32					YieldDataSize;
+	u32					NumMacroblocks;
+	std::vector< SRange >	Ranges;
+};
+
+static u32 gSeed( 0x12345678 );
+
+static u32 Random()
+{
+	gSeed = gSeed * 1664525 + 1013904223;
+	return gSeed >> 8;
+}
+
+// Writes big endian words the way the N64 sees them, i.e. byteswapped within each word
+static void PokeU16( std::vector< u8 > & data, u32 offset, u16 value )
+{
+	data[ (offset + 0) ^ U8_TWIDDLE ] = u8( value >> 8 );
+	data[ (offset + 1) ^ U8_TWIDDLE ] = u8( value );
+}
+
+static void PokeU32( std::vector< u8 > & data, u32 offset, u32 value )
+{
+	PokeU16( data, offset, u16( value >> 16 ) );
+	PokeU16( data, offset + 2, u16( value ) );
+}
+
+static u32 PeekU32( const std::vector< u8 > & data, u32 offset )
+{
+	u32		value( 0 );
+	for( u32 i = 0; i < 4; ++i )
+	{
+		value = (value << 8) | data[ (offset + i) ^ U8_TWIDDLE ];
+	}
+	return value;
+}
+
+// Mostly small coefficients with the odd large one, like a quantised picture
+static s16 RandomCoefficient( u32 index )
+{
+	if( index == 0 )
+		return s16( (Random() & 0x1ff) - 0x100 );
+
+	u32		r( Random() );
+	if( (r & 3) != 0 )
+		return 0;
+	return s16( ((r >> 2) % 65) - 32 );
+}
+
+static void MakeMacroblocks( SRange & range, u32 num_macroblocks, u32 subblock_count )
+{
+	range.Data.resize( num_macroblocks * subblock_count * 2 * SUBBLOCK_SIZE );
+	for( u32 sb = 0; sb < num_macroblocks * subblock_count; ++sb )
+	{
+		for( u32 i = 0; i < SUBBLOCK_SIZE; ++i )
+		{
+			PokeU16( range.Data, (sb * SUBBLOCK_SIZE + i) * 2, u16( RandomCoefficient( i ) ) );
+		}
+	}
+}
+
+static void MakeSyntheticTasks( std::vector< STask > & tasks )
+{
+	u32		address( 0x100000 );
+
+	for( u32 t = 0; t < kNumSyntheticTasks; ++t )
+	{
+		STask	task;
+		task.NumMacroblocks = kMacroblocksPerTask;
+
+		if( t % 3 != 2 )
+		{
+			// jpeg_decode_PS: a parameter block, three quantisation tables and the macroblocks
+			u32		mode( (t % 3) == 0 ? 0 : 2 );
+			u32		subblock_count( mode + 4 );
+			u32		qtables( address + 0x40 );
+			u32		macroblocks( address + 0x200 );
+
+			task.Tag = 'P';
+			task.DataPtr = address;
+			task.DataSize = 24;
+			task.YieldDataSize = 0;
+
+			SRange	params;
+			params.Address = address;
+			params.Data.resize( 24 );
+			PokeU32( params.Data, 0, macroblocks );
+			PokeU32( params.Data, 4, kMacroblocksPerTask );
+			PokeU32( params.Data, 8, mode );
+			for( u32 q = 0; q < 3; ++q )
+			{
+				PokeU32( params.Data, 12 + q * 4, qtables + q * 2 * SUBBLOCK_SIZE );
+			}
+			task.Ranges.push_back( params );
+
+			SRange	tables;
+			tables.Address = qtables;
+			tables.Data.resize( 3 * 2 * SUBBLOCK_SIZE );
+			for( u32 i = 0; i < 3 * SUBBLOCK_SIZE; ++i )
+			{
+				PokeU16( tables.Data, i * 2, u16( 1 + Random() % 32 ) );
+			}
+			task.Ranges.push_back( tables );
+
+			SRange	data;
+			data.Address = macroblocks;
+			MakeMacroblocks( data, kMacroblocksPerTask, subblock_count );
+			task.Ranges.push_back( data );
+
+			address = macroblocks + data.Data.size();
+		}
+		else
+		{
+			// jpeg_decode_OB: the macroblocks are the task data, and the quantisation scale is in yield_data_size
+			task.Tag = 'O';
+			task.DataPtr = address;
+			task.DataSize = kMacroblocksPerTask;
+			task.YieldDataSize = 1 + Random() % 4;
+
+			SRange	data;
+			data.Address = address;
+			MakeMacroblocks( data, kMacroblocksPerTask, 6 );
+			task.Ranges.push_back( data );
+
+			address += data.Data.size();
+		}
+
+		address = (address + 0xfff) & ~0xfff;
+		tasks.push_back( task );
+	}
+}
+
+template< typename T > static bool Read( FILE * fh, T * data, u32 count = 1 )
+{
+	return fread( data, sizeof( T ), count, fh ) == count;
+}
+
+// See JpegCapture_Write in Core/JpegTask.cpp for the format
+static bool LoadTasks( const char * filename, std::vector< STask > & tasks )
+{
+	FILE *	fh( fopen( filename, "rb" ) );
+	if( fh == NULL )
+		return false;
+
+	bool	ok( true );
+	u32		header[ 5 ];
+	while( ok && Read( fh, header, 5 ) )
+	{
+		STask	task;
+		task.Tag = header[ 0 ];
+		task.DataPtr = header[ 1 ];
+		task.DataSize = header[ 2 ];
+		task.YieldDataSize = header[ 3 ];
+		task.NumMacroblocks = 0;
+
+		for( u32 i = 0; ok && i < header[ 4 ]; ++i )
+		{
+			SRange	range;
+			u32		length;
+			ok = Read( fh, &range.Address ) && Read( fh, &length ) && range.Address + length <= kRamSize;
+			if( ok )
+			{
+				range.Data.resize( length );
+				ok = length == 0 || Read( fh, range.Data.data(), length );
+			}
+			task.Ranges.push_back( range );
+		}
+
+		// jpeg_decode_OB gets the count from the task, jpeg_decode_PS from its parameter block
+		if( ok && task.Tag == 'O' )
+		{
+			task.NumMacroblocks = task.DataSize;
+		}
+		else if( ok && !task.Ranges.empty() && task.Ranges[ 0 ].Data.size() >= 8 )
+		{
+			task.NumMacroblocks = PeekU32( task.Ranges[ 0 ].Data, 4 );
+		}
+		ok = ok && (task.Tag == 'P' || task.Tag == 'O');
+		if( ok )
+		{
+			tasks.push_back( task );
+		}
+	}
+
+	fclose( fh );
+	return !tasks.empty();
+}
+
+// Loads the task's RDRAM and runs it
+static void RunTask( const STask & task )
+{
+	for( u32 i = 0; i < task.Ranges.size(); ++i )
+	{
+		const SRange &	range( task.Ranges[ i ] );
+		if( !range.Data.empty() )
+		{
+			memcpy( g_pu8RamBase + range.Address, range.Data.data(), range.Data.size() );
+		}
+	}
+
+	OSTask	os_task;
+	memset( &os_task, 0, sizeof( os_task ) );
+	os_task.t.data_ptr = (u64 *)(uintptr_t)task.DataPtr;
+	os_task.t.data_size = task.DataSize;
+	os_task.t.yield_data_size = task.YieldDataSize;
+
+	if( task.Tag == 'P' )
+	{
+		jpeg_decode_PS( &os_task );
+	}
+	else
+	{
+		jpeg_decode_OB( &os_task );
+	}
+}
+
+// The bytes the task left in each of its ranges
+static void GetOutput( const STask & task, std::vector< u8 > & output )
+{
+	output.clear();
+	for( u32 i = 0; i < task.Ranges.size(); ++i )
+	{
+		const SRange &	range( task.Ranges[ i ] );
+		output.insert( output.end(), g_pu8RamBase + range.Address, g_pu8RamBase + range.Address + range.Data.size() );
+	}
+}
+
+template< typename T > static double Time( T fn )
+{
+	std::chrono::high_resolution_clock::time_point	start( std::chrono::high_resolution_clock::now() );
+	fn();
+	std::chrono::high_resolution_clock::time_point	end( std::chrono::high_resolution_clock::now() );
+	return std::chrono::duration< double, std::milli >( end - start ).count();
+}
+
+int main( int argc, char ** argv )
+{
+	std::vector< u8 >	ram( kRamSize );
+	g_pMemoryBuffers[ MEM_RD_RAM ] = ram.data();
+
+	std::vector< STask >	tasks;
+	if( argc > 1 )
+	{
+		if( !LoadTasks( argv[ 1 ], tasks ) )
+		{
+			printf( "Couldn't read any tasks from %s\n", argv[ 1 ] );
+			return 1;
+		}
+	}
+	else
+	{
+		MakeSyntheticTasks( tasks );
+	}
+
+	std::vector< const JpegKernels * >	kernels;
+	kernels.push_back( &gJpegKernelsScalar );
+#ifdef DAEDALUS_JPEG_X86
+	__builtin_cpu_init();
+	if( __builtin_cpu_supports( "sse4.1" ) )
+		kernels.push_back( &gJpegKernelsSSE41 );
+	if( __builtin_cpu_supports( "avx2" ) )
+		kernels.push_back( &gJpegKernelsAVX2 );
+#endif
+
+	u32		num_macroblocks( 0 );
+	for( u32 i = 0; i < tasks.size(); ++i )		num_macroblocks += tasks[ i ].NumMacroblocks;
+	if( num_macroblocks == 0 )					num_macroblocks = 1;
+
+	printf( "%s: %u tasks, %u macroblocks. Runtime selection: %s\n",
+			argc > 1 ? argv[ 1 ] : "synthetic", (u32)tasks.size(), num_macroblocks, Jpeg_SelectKernels()->Name );
+
+	// The reference output, from the scalar kernels on this thread
+	std::vector< std::vector< u8 > >	expected( tasks.size() );
+	gJpegKernels = &gJpegKernelsScalar;
+	for( u32 i = 0; i < tasks.size(); ++i )
+	{
+		RunTask( tasks[ i ] );
+		GetOutput( tasks[ i ], expected[ i ] );
+	}
+
+	u32		repeats( (kMinReplayedMacroblocks + num_macroblocks - 1) / num_macroblocks );
+	double	reference_ms( 0.0 );
+	bool	exact( true );
+	for( u32 threaded = 0; threaded < 2; ++threaded )
+	{
+		if( threaded )
+		{
+			ThreadPool_Init();
+		}
+
+		for( u32 k = 0; k < kernels.size(); ++k )
+		{
+			gJpegKernels = kernels[ k ];
+
+			u32		mismatches( 0 );
+			for( u32 i = 0; i < tasks.size(); ++i )
+			{
+				std::vector< u8 >	actual;
+				RunTask( tasks[ i ] );
+				GetOutput( tasks[ i ], actual );
+				if( actual != expected[ i ] )
+				{
+					mismatches++;
+				}
+			}
+			if( mismatches > 0 )
+			{
+				printf( "%-8s %-8s %u of %u tasks differ from scalar\n", threaded ? "Pool" : "Inline", kernels[ k ]->Name, mismatches, (u32)tasks.size() );
+				exact = false;
+			}
+
+			double	ms( Time( [&]()
+			{
+				for( u32 r = 0; r < repeats; ++r )
+				{
+					for( u32 i = 0; i < tasks.size(); ++i )
+					{
+						RunTask( tasks[ i ] );
+					}
+				}
+			} ) );
+
+			if( threaded == 0 && k == 0 )
+			{
+				reference_ms = ms;
+			}
+			printf( "%-8s %-8s %8.2fms (%6.2fus/macroblock, %5.2fx)\n", threaded ? "Pool" : "Inline", kernels[ k ]->Name,
+					ms, ms * 1e3 / (repeats * num_macroblocks), reference_ms / ms );
+		}
+
+		if( threaded )
+		{
+			ThreadPool_Fini();
+		}
+	}
+
+	if( !exact )
+	{
+		printf( "JPEG tasks are not bit exact!\n" );
+		return 1;
+	}
+	return 0;
+}
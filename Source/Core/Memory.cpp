@@ -162,6 +162,20 @@ bool Memory_Init()
 		// Skip zero sized areas. An example of this is the cart rom
 		if (region_size > 0)
 		{
+#ifdef DAEDALUS_FASTMEM
+			// RDRAM has to come from the fastmem mapping so the mirrors see the same memory. It starts zeroed
+			if (m == MEM_RD_RAM && gFastmemEnabled)
+			{
+				g_pMemoryBuffers[m] = Fastmem_Init(region_size);
+				if (g_pMemoryBuffers[m] != NULL)
+				{
+					continue;
+				}
+				#ifdef DAEDALUS_DEBUG_CONSOLE
+				DBGConsole_Msg(0, "Fastmem isn't available, falling back to the lookup tables");
+				#endif
+			}
+#endif
 			//count+=region_size;
 			g_pMemoryBuffers[m] = new u8[region_size];
 			//g_pMemoryBuffers[m] = Memory_AllocRegion(region_size);
@@ -214,6 +228,13 @@ void Memory_Fini(void)
 	gMemBase = NULL;
 
 #else
+#ifdef DAEDALUS_FASTMEM
+	if (gFastmemBase != NULL)
+	{
+		Fastmem_Fini();
+		g_pMemoryBuffers[MEM_RD_RAM] = NULL;
+	}
+#endif
 	for (u32 m {}; m < NUM_MEM_BUFFERS; m++)
 	{
 		if (g_pMemoryBuffers[m] != NULL)
@@ -260,6 +281,7 @@ bool Memory_Reset()
 			memset(g_pMemoryBuffers[i], 0, MemoryRegionSizes[i]);
 		}
 	}
+	DirtyPages_MarkAll();
 
 	gDMAUsed = false;
 	return true;
@@ -290,7 +312,7 @@ static void Memory_Tlb_Hack()
 	   u32 start_addr {0x7F000000 >> 18};
 	   u32 end_addr   {0x7FFFFFFF >> 18};
 
-	   u8 * pRead {(u8*)(reinterpret_cast< u32 >(rom_address) + offset - (start_addr << 18))};
+	   u8 * pRead {(u8*)(reinterpret_cast< uintptr_t >(rom_address) + offset - (start_addr << 18))};
 
 	   for (u32 i = start_addr; i <= end_addr; i++)
 	   {
@@ -298,7 +320,7 @@ static void Memory_Tlb_Hack()
 	   }
 	}
 
-	g_MemoryLookupTableRead[0x70000000 >> 18].pRead = (u8*)(reinterpret_cast< u32 >( g_pMemoryBuffers[MEM_RD_RAM]) - 0x70000000);
+	g_MemoryLookupTableRead[0x70000000 >> 18].pRead = (u8*)(reinterpret_cast< uintptr_t >( g_pMemoryBuffers[MEM_RD_RAM]) - 0x70000000);
 }
 
 static void Memory_InitFunc(u32 start, u32 size, const u32 ReadRegion, const u32 WriteRegion, mReadFunction ReadFunc, mWriteFunction WriteFunc)
@@ -316,14 +338,14 @@ static void Memory_InitFunc(u32 start, u32 size, const u32 ReadRegion, const u32
 
 		if (ReadRegion)
 		{
-			g_MemoryLookupTableRead[start_addr|(0x8000>>2)].pRead = (u8*)(reinterpret_cast< u32 >(g_pMemoryBuffers[ReadRegion]) - (((start>>16)|0x8000) << 16));
-			g_MemoryLookupTableRead[start_addr|(0xA000>>2)].pRead = (u8*)(reinterpret_cast< u32 >(g_pMemoryBuffers[ReadRegion]) - (((start>>16)|0xA000) << 16));
+			g_MemoryLookupTableRead[start_addr|(0x8000>>2)].pRead = (u8*)(reinterpret_cast< uintptr_t >(g_pMemoryBuffers[ReadRegion]) - (((start>>16)|0x8000) << 16));
+			g_MemoryLookupTableRead[start_addr|(0xA000>>2)].pRead = (u8*)(reinterpret_cast< uintptr_t >(g_pMemoryBuffers[ReadRegion]) - (((start>>16)|0xA000) << 16));
 		}
 
 		if (WriteRegion)
 		{
-			g_MemoryLookupTableWrite[start_addr|(0x8000>>2)].pWrite = (u8*)(reinterpret_cast< u32 >(g_pMemoryBuffers[WriteRegion]) - (((start>>16)|0x8000) << 16));
-			g_MemoryLookupTableWrite[start_addr|(0xA000>>2)].pWrite = (u8*)(reinterpret_cast< u32 >(g_pMemoryBuffers[WriteRegion]) - (((start>>16)|0xA000) << 16));
+			g_MemoryLookupTableWrite[start_addr|(0x8000>>2)].pWrite = (u8*)(reinterpret_cast< uintptr_t >(g_pMemoryBuffers[WriteRegion]) - (((start>>16)|0x8000) << 16));
+			g_MemoryLookupTableWrite[start_addr|(0xA000>>2)].pWrite = (u8*)(reinterpret_cast< uintptr_t >(g_pMemoryBuffers[WriteRegion]) - (((start>>16)|0xA000) << 16));
 		}
 
 		start_addr++;
@@ -366,6 +388,13 @@ void Memory_InitTables()
 	u32 rom_size {RomBuffer::GetRomSize()};
 	u32 ram_size {gRamSize};
 
+#ifdef DAEDALUS_FASTMEM
+	if (gFastmemBase != NULL)
+	{
+		Fastmem_SetRamSize(ram_size);
+	}
+#endif
+
 	#ifdef DAEDALUS_DEBUG_CONSOLE
 	DBGConsole_Msg(0, "Initialising %s main memory", (ram_size == MEMORY_8_MEG) ? "8Mb" : "4Mb");
 	#endif
@@ -22,6 +22,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #ifndef CORE_MEMORY_H_
 #define CORE_MEMORY_H_
 
+#include "Core/DirtyPages.h"
+#include "Core/Fastmem.h"
 #include "OSHLE/ultra_rcp.h"
 #include "Utility/AtomicPrimitives.h"
 #include "Utility/Endian.h"
@@ -110,6 +112,25 @@ inline void* DAEDALUS_ATTRIBUTE_CONST ReadAddress( u32 address )
 	return m.ReadFunc( address );
 }
 
+// Notes a write through a host pointer for Core/DirtyPages.h. Pointers outside RDRAM are ignored.
+inline void Memory_MarkWritten( const void * p )
+{
+	uintptr_t offset( (uintptr_t)p - (uintptr_t)g_pMemoryBuffers[MEM_RD_RAM] );
+	if( offset < MAX_RAM_ADDRESS )
+	{
+		gDirtyPages[ offset >> kDirtyPageShift ] = 1;
+	}
+}
+
+inline void Memory_MarkWritten( const void * p, u32 length )
+{
+	uintptr_t offset( (uintptr_t)p - (uintptr_t)g_pMemoryBuffers[MEM_RD_RAM] );
+	if( offset < MAX_RAM_ADDRESS )
+	{
+		DirtyPages_MarkRange( u32( offset ), length );
+	}
+}
+
 inline void WriteAddress( u32 address, u32 value )
 {
 	const MemFuncWrite & m( g_MemoryLookupTableWrite[ address >> 18 ] );
@@ -117,7 +138,9 @@ inline void WriteAddress( u32 address, u32 value )
 	// Access through pointer with no function calls at all (Fast)
 	if( m.pWrite )
 	{
-		*(u32*)( m.pWrite + address ) = value;
+		u32 * p( (u32*)( m.pWrite + address ) );
+		*p = value;
+		Memory_MarkWritten( p );
 		return;
 	}
 	// Need to go through the HW access handlers or TLB (Slow)
@@ -152,22 +175,26 @@ inline u16 QuickRead16Bits( u8 *p_base, u32 offset )
 inline void QuickWrite16Bits( u8 *p_base, u32 offset, u16 value)
 {
 	*(u16 *)((uintptr_t)(p_base + offset) ^ U16_TWIDDLE) = value;
+	Memory_MarkWritten( p_base + offset );
 }
 
 inline void QuickWrite64Bits( u8 *p_base, u32 offset, u64 value )
 {
 	u64 data = (value>>32) + (value<<32);
 	*(u64 *)(p_base + offset) = data;
+	Memory_MarkWritten( p_base + offset );
 }
 
 inline void QuickWrite32Bits( u8 *p_base, u32 offset, u32 value )
 {
 	*(u32 *)(p_base + offset) = value;
+	Memory_MarkWritten( p_base + offset );
 }
 
 inline void QuickWrite32Bits( u8 *p_base, u32 value )
 {
 	*(u32 *)(p_base) = value;
+	Memory_MarkWritten( p_base );
 }
 
 // Useful defines for making code look nicer:
@@ -251,10 +278,64 @@ inline u32 Read32Bits( u32 address )				{ MEMORY_CHECK_ALIGN( address, 4 ); retu
 inline u16 Read16Bits( u32 address )				{ MEMORY_CHECK_ALIGN( address, 2 ); return *(u16 *)ReadAddress( address ); }
 inline u8 Read8Bits( u32 address )					{                                   return *(u8  *)ReadAddress( address ); }
 
-inline void Write64Bits( u32 address, u64 data )	{ MEMORY_CHECK_ALIGN( address, 8 ); *(u64 *)ReadAddress( address ) = data; }
+inline void Write64Bits( u32 address, u64 data )	{ MEMORY_CHECK_ALIGN( address, 8 ); u64 * p = (u64 *)ReadAddress( address ); *p = data; Memory_MarkWritten( p ); }
 inline void Write32Bits( u32 address, u32 data )	{ MEMORY_CHECK_ALIGN( address, 4 ); WriteAddress(address, data); }
-inline void Write16Bits( u32 address, u16 data )	{ MEMORY_CHECK_ALIGN( address, 2 ); *(u16 *)ReadAddress(address) = data; }
-inline void Write8Bits( u32 address, u8 data )		{                                   *(u8 *)ReadAddress(address) = data;}
+inline void Write16Bits( u32 address, u16 data )	{ MEMORY_CHECK_ALIGN( address, 2 ); u16 * p = (u16 *)ReadAddress(address); *p = data; Memory_MarkWritten( p ); }
+inline void Write8Bits( u32 address, u8 data )		{                                   u8 * p = (u8 *)ReadAddress(address); *p = data; Memory_MarkWritten( p ); }
+
+#elif (DAEDALUS_ENDIAN_MODE == DAEDALUS_ENDIAN_LITTLE) && defined(DAEDALUS_FASTMEM)
+
+inline u64 Read64Bits( u32 address )
+{
+	MEMORY_CHECK_ALIGN( address, 8 );
+	u64 data = Fastmem_IsDirectAddress( address ) ? Fastmem_Read64( address ) : *(u64 *)ReadAddress( address );
+	return (data>>32) + (data<<32);
+}
+inline u32 Read32Bits( u32 address )
+{
+	MEMORY_CHECK_ALIGN( address, 4 );
+	return Fastmem_IsDirectAddress( address ) ? Fastmem_Read32( address ) : *(u32 *)ReadAddress( address );
+}
+inline u16 Read16Bits( u32 address )
+{
+	MEMORY_CHECK_ALIGN( address, 2 );
+	address ^= U16_TWIDDLE;
+	return Fastmem_IsDirectAddress( address ) ? Fastmem_Read16( address ) : *(u16 *)ReadAddress( address );
+}
+inline u8 Read8Bits( u32 address )
+{
+	address ^= U8_TWIDDLE;
+	return Fastmem_IsDirectAddress( address ) ? Fastmem_Read8( address ) : *(u8 *)ReadAddress( address );
+}
+
+// Direct addresses are KSEG0/KSEG1, so the RDRAM offset is the bottom 29 bits. Anything past
+// RDRAM faults through to the hardware register handlers, and is too far out to be marked.
+inline void Write64Bits( u32 address, u64 data )
+{
+	MEMORY_CHECK_ALIGN( address, 8 );
+	data = (data>>32) + (data<<32);
+	if( Fastmem_IsDirectAddress( address ) )	{ Fastmem_Write64( address, data ); DirtyPages_Mark( address & 0x1FFFFFFF ); }
+	else										{ u64 * p = (u64 *)ReadAddress( address ); *p = data; Memory_MarkWritten( p ); }
+}
+inline void Write32Bits( u32 address, u32 data )
+{
+	MEMORY_CHECK_ALIGN( address, 4 );
+	if( Fastmem_IsDirectAddress( address ) )	{ Fastmem_Write32( address, data ); DirtyPages_Mark( address & 0x1FFFFFFF ); }
+	else										WriteAddress( address, data );
+}
+inline void Write16Bits( u32 address, u16 data )
+{
+	MEMORY_CHECK_ALIGN( address, 2 );
+	address ^= U16_TWIDDLE;
+	if( Fastmem_IsDirectAddress( address ) )	{ Fastmem_Write16( address, data ); DirtyPages_Mark( address & 0x1FFFFFFF ); }
+	else										{ u16 * p = (u16 *)ReadAddress( address ); *p = data; Memory_MarkWritten( p ); }
+}
+inline void Write8Bits( u32 address, u8 data )
+{
+	address ^= U8_TWIDDLE;
+	if( Fastmem_IsDirectAddress( address ) )	{ Fastmem_Write8( address, data ); DirtyPages_Mark( address & 0x1FFFFFFF ); }
+	else										{ u8 * p = (u8 *)ReadAddress( address ); *p = data; Memory_MarkWritten( p ); }
+}
 
 #elif (DAEDALUS_ENDIAN_MODE == DAEDALUS_ENDIAN_LITTLE)
 
@@ -263,10 +344,10 @@ inline u32 Read32Bits( u32 address )				{ MEMORY_CHECK_ALIGN( address, 4 ); retu
 inline u16 Read16Bits( u32 address )				{ MEMORY_CHECK_ALIGN( address, 2 ); return *(u16 *)ReadAddress( address ^ U16_TWIDDLE ); }
 inline u8 Read8Bits( u32 address )					{                                   return *(u8  *)ReadAddress( address ^ U8_TWIDDLE ); }
 
-inline void Write64Bits( u32 address, u64 data )	{ MEMORY_CHECK_ALIGN( address, 8 ); *(u64 *)ReadAddress( address ) = (data>>32) + (data<<32); }
+inline void Write64Bits( u32 address, u64 data )	{ MEMORY_CHECK_ALIGN( address, 8 ); u64 * p = (u64 *)ReadAddress( address ); *p = (data>>32) + (data<<32); Memory_MarkWritten( p ); }
 inline void Write32Bits( u32 address, u32 data )	{ MEMORY_CHECK_ALIGN( address, 4 ); WriteAddress(address, data); }
-inline void Write16Bits( u32 address, u16 data )	{ MEMORY_CHECK_ALIGN( address, 2 ); *(u16 *)ReadAddress(address ^ U16_TWIDDLE) = data; }
-inline void Write8Bits( u32 address, u8 data )		{                                   *(u8 *)ReadAddress(address ^ U8_TWIDDLE) = data;}
+inline void Write16Bits( u32 address, u16 data )	{ MEMORY_CHECK_ALIGN( address, 2 ); u16 * p = (u16 *)ReadAddress(address ^ U16_TWIDDLE); *p = data; Memory_MarkWritten( p ); }
+inline void Write8Bits( u32 address, u8 data )		{                                   u8 * p = (u8 *)ReadAddress(address ^ U8_TWIDDLE); *p = data; Memory_MarkWritten( p ); }
 
 #else
 #error No DAEDALUS_ENDIAN_MODE specified
@@ -274,8 +355,8 @@ inline void Write8Bits( u32 address, u8 data )		{
 
 //inline void Write64Bits_NoSwizzle( u32 address, u64 data ){ MEMORY_CHECK_ALIGN( address, 8 ); *(u64 *)WriteAddress( address ) = (data>>32) + (data<<32); }
 inline void Write32Bits_NoSwizzle( u32 address, u32 data )	{ MEMORY_CHECK_ALIGN( address, 4 ); WriteAddress(address, data); }
-inline void Write16Bits_NoSwizzle( u32 address, u16 data )	{ MEMORY_CHECK_ALIGN( address, 2 ); *(u16 *)ReadAddress(address) = data; }
-inline void Write8Bits_NoSwizzle( u32 address, u8 data )	{                                   *(u8 *)ReadAddress(address) = data;}
+inline void Write16Bits_NoSwizzle( u32 address, u16 data )	{ MEMORY_CHECK_ALIGN( address, 2 ); u16 * p = (u16 *)ReadAddress(address); *p = data; Memory_MarkWritten( p ); }
+inline void Write8Bits_NoSwizzle( u32 address, u8 data )	{                                   u8 * p = (u8 *)ReadAddress(address); *p = data; Memory_MarkWritten( p ); }
 
 /////////////////////////////////////////////////////
 /////////////////////////////////////////////////////
@@ -39,6 +39,15 @@ static void * ReadMapped( u32 address )
 	gTLBReadHit++;
 #endif
 
+	void * p_cached {TLBCache_Lookup(address)};
+	if (p_cached != NULL)
+	{
+#ifdef DAEDALUS_PROFILE_EXECUTION
+		gTLBCacheReadHit++;
+#endif
+		return p_cached;
+	}
+
 	u32 physical_addr {TLBEntry::Translate(address, missing)};
 	if (physical_addr != 0)
 	{
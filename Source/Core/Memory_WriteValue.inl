@@ -33,10 +33,22 @@ static void WriteValueMapped( u32 address, u32 value )
 	gTLBWriteHit++;
 #endif
 
+	void * p_cached {TLBCache_Lookup(address)};
+	if (p_cached != NULL)
+	{
+#ifdef DAEDALUS_PROFILE_EXECUTION
+		gTLBCacheWriteHit++;
+#endif
+		*(u32*)p_cached = value;
+		Memory_MarkWritten( p_cached );
+		return;
+	}
+
 	u32 physical_addr {TLBEntry::Translate(address, missing)};
 	if (physical_addr != 0)
 	{
 		*(u32*)(g_pu8RamBase + (physical_addr & 0x007FFFFF)) = value;
+		DirtyPages_Mark( physical_addr & 0x007FFFFF );
 	}
 	else
 	{
@@ -48,6 +60,7 @@ static void WriteValue_8000_807F( u32 address, u32 value )
 {
 	// Note: Mask is slighty different when EPAK isn't used 0x003FFFFF
 	*(u32 *)((u8 *)g_pMemoryBuffers[MEM_RD_RAM] + (address & 0x007FFFFF)) = value;
+	DirtyPages_Mark( address & 0x007FFFFF );
 }
 
 // 0x03F0 0000 to 0x03FF FFFF  RDRAM registers
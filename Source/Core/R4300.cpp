@@ -532,6 +532,50 @@ bool	R4300_InstructionHandlerNeedsPC( OpCode op_code )
 	}
 }
 
+//	Returns true if the instruction may read or modify COUNT or the event
+//	queue (either directly or through memory mapped registers, exceptions,
+//	SpeedHack() etc). Interpreters which only update COUNT periodically must
+//	bring it up to date before executing these. Everything else is pure
+//	register arithmetic.
+
+bool	R4300_InstructionNeedsCountSync( OpCode op_code )
+{
+	switch( op_code.op )
+	{
+	case OP_ADDI:
+	case OP_ADDIU:
+	case OP_SLTI:
+	case OP_SLTIU:
+	case OP_ANDI:
+	case OP_ORI:
+	case OP_XORI:
+	case OP_LUI:
+	case OP_DADDI:
+	case OP_DADDIU:
+		return false;
+
+	case OP_SPECOP:
+		switch( op_code.spec_op )
+		{
+		case SpecOp_JR:
+		case SpecOp_JALR:
+		case SpecOp_SYSCALL:
+		case SpecOp_BREAK:
+			return true;
+		default:
+			return false;
+		}
+
+	case OP_COPRO1:
+		// Only the branches, which may hit SpeedHack()
+		return op_code.cop1_op == Cop1Op_BCInstr;
+
+	default:
+		// Loads/stores, COP0, jumps and branches, patches
+		return true;
+	}
+}
+
 void R4300_CALL_TYPE R4300_SetSR( u32 new_value )
 {
 #ifdef DAEDALUS_DEBUG_CONSOLE
@@ -1989,6 +2033,11 @@ static void R4300_CALL_TYPE R4300_Cop0_MTC0( R4300_CALL_SIGNATURE )
 			}
 			break;
 
+		case C0_ENTRYHI:
+			// Changing the ASID invalidates any cached translations
+			TLBCache_SetEntryHi(new_value);
+			break;
+
 		// Need to check CONFIG register writes - not all fields are writable.
 		// This also sets Endianness mode.
 
@@ -2015,7 +2064,7 @@ static void R4300_CALL_TYPE R4300_TLB_TLBR( R4300_CALL_SIGNATURE ) 				// TLB Re
 	u32 index {gCPUState.CPUControl[C0_INX]._u32 & 0x1F};
 
 	gCPUState.CPUControl[C0_PAGEMASK]._u32 = g_TLBs[index].mask;
-	gCPUState.CPUControl[C0_ENTRYHI ]._u32 = g_TLBs[index].hi   & (~g_TLBs[index].pagemask);
+	TLBCache_SetEntryHi( g_TLBs[index].hi & (~g_TLBs[index].pagemask) );
 	gCPUState.CPUControl[C0_ENTRYLO0]._u32 = g_TLBs[index].pfne | g_TLBs[index].g;
 	gCPUState.CPUControl[C0_ENTRYLO1]._u32 = g_TLBs[index].pfno | g_TLBs[index].g;
 
@@ -35,6 +35,7 @@ inline CPU_Instruction	R4300_GetDInstructionHandler( OpCode op_code )
 
 CPU_Instruction	R4300_GetInstructionHandler( OpCode op_code );
 bool			R4300_InstructionHandlerNeedsPC( OpCode op_code );
+bool			R4300_InstructionNeedsCountSync( OpCode op_code );
 inline void			R4300_ExecuteInstruction( OpCode op_code )
 {
 	R4300Instruction[ op_code.op ]( op_code._u32 );
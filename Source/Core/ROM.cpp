@@ -40,6 +40,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "OSHLE/ultra_R4300.h"
 #include "Plugins/AudioPlugin.h"
 #include "Plugins/GraphicsPlugin.h"
+#include "Test/BatchTest.h"
 #include "Utility/CRC.h"
 #include "Utility/FramerateLimiter.h"
 #include "Utility/IO.h"
@@ -515,6 +516,10 @@ bool ROM_LoadFile(const RomID & rom_id, const RomSettings & settings, const SRom
 	// Read and apply preferences from preferences.ini
 	preferences.Apply();
 
+#ifdef DAEDALUS_BATCH_BENCH
+	BatchTest_ApplyPreferenceOverrides();
+#endif
+
 	// Parse cheat file this rom, if cheat feature is enabled
 	// This is also done when accessing the cheat menu
 	// But we do this when ROM is loaded too, to allow any forced enabled cheats to work.
@@ -20,6 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "stdafx.h"
 #include "ROMBuffer.h"
 
+#include "CPU.h"
 #include "ROM.h"
 #include "DMA.h"
 
@@ -31,13 +32,30 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "Math/MathUtil.h"
 
 #include "Debug/DBGConsole.h"
+#include "Debug/Dump.h"
 
 #include "Utility/Preferences.h"
 #include "Utility/ROMFile.h"
 #include "Utility/ROMFileCache.h"
+#include "Utility/ROMFileMapped.h"
 #include "Utility/ROMFileMemory.h"
 #include "Utility/Stream.h"
 #include "Utility/IO.h"
+#include "Utility/Timing.h"
+
+// Zipped roms are inflated on a background thread while the game boots.
+// The PSP streams large roms instead, and has no Cond implementation.
+#if defined( DAEDALUS_COMPRESSED_ROM_SUPPORT ) && !defined( DAEDALUS_PSP )
+#define DAEDALUS_BACKGROUND_ROM_LOAD
+#endif
+
+#ifdef DAEDALUS_BACKGROUND_ROM_LOAD
+#include <atomic>
+
+#include "Utility/Cond.h"
+#include "Utility/Mutex.h"
+#include "Utility/Thread.h"
+#endif
 
 #ifdef DAEDALUS_PSP
 extern bool PSP_IS_SLIM;
@@ -50,6 +68,29 @@ namespace
 	u32				sRomSize( 0 );
 	bool			sRomFixed( false );
 	ROMFileCache *	spRomFileCache( NULL );
+#ifdef DAEDALUS_MAPPED_ROMS
+	ROMFileMapped *	spRomFileMapped( NULL );
+#endif
+
+	// For reporting how long each way of opening the rom takes to get a picture up
+	const char *	spRomOpenMode( "" );
+	u64				sRomOpenTime( 0 );
+	bool			sFirstFrameReported( false );
+
+#ifdef DAEDALUS_BACKGROUND_ROM_LOAD
+	// Big enough that the header and boot code are in the first one
+	const u32			ROM_LOAD_CHUNK_SIZE = 256 * 1024;
+
+	ROMFile *			spRomLoadFile( NULL );		// Owned by the loader thread while it runs
+	ThreadHandle		sRomLoadThread( kInvalidThreadHandle );
+	Mutex				sRomLoadMutex( "RomLoad" );
+	Cond *				spRomLoadCond( NULL );		// Signalled as each chunk is finished
+	std::atomic< u32 >	sRomBytesReady( 0 );		// spRomData is valid up to here
+	std::atomic< bool >	sRomLoadAbort( false );
+	bool				sRomLoadFinished( false );	// Protected by sRomLoadMutex
+	bool				sRomLoadFailed( false );
+	u64					sRomLoadStallTicks( 0 );
+#endif
 
 #ifdef DAEDALUS_COMPRESSED_ROM_SUPPORT
 	static bool		DECOMPRESS_ROMS( true );
@@ -156,6 +197,172 @@ namespace
 		return p_new_file;
 	}
 #endif
+
+#ifdef DAEDALUS_MAPPED_ROMS
+	bool	OpenMapped( const char * filename, COutputStream & messages )
+	{
+		const char * ext( IO::Path::FindExtension( filename ) );
+		if( ext != NULL && _strcmpi( ext, ".zip" ) == 0 )
+		{
+			return false;
+		}
+
+		// Byteswapped roms are converted once into a copy kept alongside the saves
+		IO::Filename	swapped_filename;
+		Dump_GetSaveDirectory( swapped_filename, filename, ".swapped" );
+
+		ROMFileMapped *	p_rom_file( new ROMFileMapped( filename, swapped_filename ) );
+		if( !p_rom_file->Open( messages ) )
+		{
+			DBGConsole_Msg( 0, "Unable to map [C%s], loading it instead", filename );
+			delete p_rom_file;
+			return false;
+		}
+
+		spRomFileMapped = p_rom_file;
+		spRomData = p_rom_file->GetData();
+		sRomSize = p_rom_file->GetRomSize();
+		sRomFixed = true;
+		spRomOpenMode = p_rom_file->IsSwappedCopy() ? "mapped swapped copy" : "mapped";
+		return true;
+	}
+#endif
+
+#ifdef DAEDALUS_BACKGROUND_ROM_LOAD
+	u32 DAEDALUS_THREAD_CALL_TYPE RomLoadThread( void * arg )
+	{
+		u32		offset( sRomBytesReady.load() );
+		bool	failed( false );
+
+		while( offset < sRomSize && !sRomLoadAbort.load() )
+		{
+			u32		length( Min( sRomSize - offset, ROM_LOAD_CHUNK_SIZE ) );
+			if( !spRomLoadFile->ReadChunk( offset, spRomData + offset, length ) )
+			{
+				failed = true;
+				break;
+			}
+			offset += length;
+
+			MutexLock	lock( &sRomLoadMutex );
+			sRomBytesReady.store( offset );
+			if( spRomLoadCond != NULL )
+			{
+				CondSignal( spRomLoadCond );
+			}
+		}
+
+		// Nothing past offset is ever marked as ready. Zero it anyway, so a DMA that's
+		// already underway when the CPU is halted reads something defined.
+		if( failed )
+		{
+			DBGConsole_Msg( 0, "[RFailed to inflate the rom from %08x]", offset );
+			memset( spRomData + offset, 0, sRomSize - offset );
+		}
+
+		// Release anyone still waiting, WaitForRomBytesSlow() halts the CPU if the load failed
+		MutexLock	lock( &sRomLoadMutex );
+		sRomLoadFinished = true;
+		sRomLoadFailed = failed;
+		if( spRomLoadCond != NULL )
+		{
+			CondSignal( spRomLoadCond );
+		}
+		return 0;
+	}
+
+	// Inflates the start of the rom, and leaves a thread inflating the rest. Takes ownership of p_rom_file.
+	bool	StartBackgroundLoad( ROMFile * p_rom_file, u8 * p_bytes )
+	{
+		u32		first_chunk( Min( sRomSize, ROM_LOAD_CHUNK_SIZE ) );
+		if( !p_rom_file->ReadChunk( 0, p_bytes, first_chunk ) )
+		{
+			delete p_rom_file;
+			return false;
+		}
+
+		spRomLoadFile = p_rom_file;
+		spRomData = p_bytes;
+		sRomBytesReady.store( first_chunk );
+		sRomLoadAbort.store( false );
+		sRomLoadFinished = false;
+		sRomLoadFailed = false;
+		sRomLoadStallTicks = 0;
+
+		spRomLoadCond = CondCreate();
+		if( spRomLoadCond != NULL )
+		{
+			sRomLoadThread = CreateThread( "RomLoad", RomLoadThread, NULL );
+		}
+
+		if( sRomLoadThread == kInvalidThreadHandle )
+		{
+			// Just do it all now
+			RomLoadThread( NULL );
+			return !sRomLoadFailed;
+		}
+		return true;
+	}
+
+	void	StopBackgroundLoad()
+	{
+		if( sRomLoadThread != kInvalidThreadHandle )
+		{
+			sRomLoadAbort.store( true );
+			JoinThread( sRomLoadThread, -1 );
+			ReleaseThreadHandle( sRomLoadThread );
+			sRomLoadThread = kInvalidThreadHandle;
+		}
+
+		if( spRomLoadCond != NULL )
+		{
+			CondDestroy( spRomLoadCond );
+			spRomLoadCond = NULL;
+		}
+
+		delete spRomLoadFile;
+		spRomLoadFile = NULL;
+		sRomBytesReady.store( 0 );
+	}
+
+	DAEDALUS_ATTRIBUTE_NOINLINE void	WaitForRomBytesSlow( u32 end )
+	{
+		u64		start;
+		NTiming::GetPreciseTime( &start );
+
+		{
+			MutexLock	lock( &sRomLoadMutex );
+			while( sRomBytesReady.load() < end && !sRomLoadFinished )
+			{
+				CondWait( spRomLoadCond, &sRomLoadMutex, kTimeoutInfinity );
+			}
+
+			if( sRomLoadFailed )
+			{
+				CPU_Halt( "The rom failed to load" );
+			}
+		}
+
+		u64		now;
+		NTiming::GetPreciseTime( &now );
+		sRomLoadStallTicks += now - start;
+	}
+#endif
+
+	// Blocks until the given range of the rom has been inflated
+	inline void	WaitForRomBytes( u32 offset, u32 length )
+	{
+#ifdef DAEDALUS_BACKGROUND_ROM_LOAD
+		if( spRomLoadFile != NULL )
+		{
+			u32		end( (offset < sRomSize && length <= sRomSize - offset) ? offset + length : sRomSize );
+			if( end > sRomBytesReady.load() )
+			{
+				WaitForRomBytesSlow( end );
+			}
+		}
+#endif
+	}
 }
 
 //*****************************************************************************
@@ -182,8 +389,21 @@ void RomBuffer::Destroy()
 //*****************************************************************************
 bool RomBuffer::Open()
 {
+	NTiming::GetPreciseTime( &sRomOpenTime );
+	sFirstFrameReported = false;
+
 	CNullOutputStream messages;
 	const char * filename   = g_ROM.mFileName;
+
+#ifdef DAEDALUS_MAPPED_ROMS
+	if( OpenMapped( filename, messages ) )
+	{
+		DBGConsole_Msg(0, "Opened [C%s] (%s)\n", filename, spRomOpenMode);
+		sRomLoaded = true;
+		return true;
+	}
+#endif
+
 	ROMFile *    p_rom_file = ROMFile::Create( filename );
 	if(p_rom_file == NULL)
 	{
@@ -206,7 +426,28 @@ bool RomBuffer::Open()
 		u32		size_aligned( AlignPow2( sRomSize, 4 ) );
 		u8 *	p_bytes( (u8*)CROMFileMemory::Get()->Alloc( size_aligned ) );
 
+		spRomOpenMode = "loaded";
+
 #ifndef DAEDALUS_PSP
+#ifdef DAEDALUS_BACKGROUND_ROM_LOAD
+		if( p_rom_file->IsCompressed() )
+		{
+			// The loader thread owns the file from here
+			ROMFile *	p_loader_file( p_rom_file );
+			p_rom_file = NULL;
+
+			if( !StartBackgroundLoad( p_loader_file, p_bytes ) )
+			{
+				DBGConsole_Msg(0, "Failed to load [C%s]\n", filename);
+				StopBackgroundLoad();
+				CROMFileMemory::Get()->Free( p_bytes );
+				spRomData = NULL;
+				return false;
+			}
+			spRomOpenMode = "inflating in the background";
+		}
+		else
+#endif
 		if( !p_rom_file->LoadData( sRomSize, p_bytes, messages ) )
 		{
 			DBGConsole_Msg(0, "Failed to load [C%s]\n", filename);
@@ -296,6 +537,7 @@ bool RomBuffer::Open()
 		spRomFileCache = new ROMFileCache();
 		spRomFileCache->Open( p_rom_file );
 		sRomFixed = false;
+		spRomOpenMode = "streamed";
 	}
 
 	DBGConsole_Msg(0, "Opened [C%s]\n", filename);
@@ -308,6 +550,19 @@ bool RomBuffer::Open()
 //*****************************************************************************
 void	RomBuffer::Close()
 {
+#ifdef DAEDALUS_BACKGROUND_ROM_LOAD
+	StopBackgroundLoad();
+#endif
+
+#ifdef DAEDALUS_MAPPED_ROMS
+	if (spRomFileMapped)
+	{
+		delete spRomFileMapped;
+		spRomFileMapped = NULL;
+		spRomData = NULL;
+	}
+#endif
+
 	if (spRomData)
 	{
 		CROMFileMemory::Get()->Free( spRomData );
@@ -329,6 +584,33 @@ void	RomBuffer::Close()
 bool	RomBuffer::IsRomLoaded() { return sRomLoaded; }
 u32		RomBuffer::GetRomSize() { return sRomSize; }
 
+//*****************************************************************************
+//
+//*****************************************************************************
+void	RomBuffer::ReportFirstFrame()
+{
+	if( !sRomLoaded || sFirstFrameReported )
+		return;
+
+	u64		now;
+	NTiming::GetPreciseTime( &now );
+	sFirstFrameReported = true;
+
+	DBGConsole_Msg( 0, "First frame [M%d]ms after opening the rom (%s)", (u32)NTiming::ToMilliseconds( now - sRomOpenTime ), spRomOpenMode );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+u32		RomBuffer::GetLoadStallMs()
+{
+#ifdef DAEDALUS_BACKGROUND_ROM_LOAD
+	return (u32)NTiming::ToMilliseconds( sRomLoadStallTicks );
+#else
+	return 0;
+#endif
+}
+
 namespace
 {
 	void	CopyBytesRaw( ROMFileCache * p_cache, u8 * p_dst, u32 rom_offset, u32 length )
@@ -375,6 +657,7 @@ void	RomBuffer::GetRomBytesRaw( void * p_dst, u32 rom_start, u32 length )
 {
 	if( sRomFixed )
 	{
+		WaitForRomBytes( rom_start, length );
 		memcpy(p_dst, (const u8*)spRomData + rom_start, length );
 	}
 	else
@@ -395,6 +678,8 @@ void	RomBuffer::PutRomBytesRaw( u32 rom_start, const void * p_src, u32 length )
 	DAEDALUS_ASSERT( IsRomAddressFixed(), "Cannot put rom bytes when the data isn't fixed" );
 	#endif
 
+	// Don't let the loader overwrite the new bytes
+	WaitForRomBytes( rom_start, length );
 	memcpy( (u8*)spRomData + rom_start, p_src, length );
 
 }
@@ -408,6 +693,7 @@ void * RomBuffer::GetAddressRaw( u32 rom_start )
 	{
 		if( sRomFixed )
 		{
+			WaitForRomBytes( rom_start, SCRATCH_BUFFER_LENGTH );
 			return (u8 *)spRomData + rom_start;
 		}
 		else
@@ -435,6 +721,7 @@ void RomBuffer::CopyToRam( u8 * p_dst, u32 dst_offset, u32 dst_size, u32 src_off
 		const u8 *	p_src( (const u8 *)spRomData );
 		u32			src_size( sRomSize );
 
+		WaitForRomBytes( src_offset, length );
 		DMA_HandleTransfer( p_dst, dst_offset, dst_size, p_src, src_offset, src_size, length );
 	}
 	else
@@ -489,6 +776,8 @@ const void * RomBuffer::GetFixedRomBaseAddress()
 	DAEDALUS_ASSERT( IsRomLoaded(), "The rom isn't loaded" );
 	DAEDALUS_ASSERT( IsRomAddressFixed(), "Trying to access the rom base address when it's not fixed" );
 #endif
+	// Whoever asks for this can read anywhere, so wait for the whole rom
+	WaitForRomBytes( 0, sRomSize );
 	return spRomData;
 
 }
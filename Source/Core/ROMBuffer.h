@@ -26,7 +26,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 //
 //	This class is responsible for maintaining the image of the rom.
-//	For the PC, this just loads the rom into a single chunk of memory.
+//	For the PC, this just loads the rom into a single chunk of memory
+//	(or on Linux/OSX, maps uncompressed roms straight from disk).
 //	For the PSP/Xbox the whole rom won't fit into memory at once,
 //	so it must stream chunks in on demand.
 //
@@ -44,6 +45,12 @@ class RomBuffer
 
 		static u32		GetRomSize();
 
+		/// Logs the time from Open to the first frame being displayed, once per rom
+		static void		ReportFirstFrame();
+
+		/// Total time emulation has spent waiting for a zipped rom to be inflated
+		static u32		GetLoadStallMs();
+
 		/// Copy bytes of memory from the cart, with no swizzling etc
 		/// rom_start is 0-based (i.e. not a full rom address)
 		static void		GetRomBytesRaw( void * p_dst, u32 rom_start, u32 length );
@@ -32,7 +32,6 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "OSHLE/ultra_sptask.h"
 #include "Plugins/AudioPlugin.h"
 #include "Plugins/GraphicsPlugin.h"
-#include "Test/BatchTest.h"
 #include "Utility/IO.h"
 #include "Utility/PrintOpCode.h"
 #include "Utility/Profiler.h"
@@ -159,14 +158,6 @@ static EProcessResult RSP_HLE_Graphics()
 		R4300_Interrupt_UpdateCause3();
 	}
 
-
-#ifdef DAEDALUS_BATCH_TEST_ENABLED
-	if (CBatchTestEventHandler * handler = BatchTest_GetHandler())
-	{
-		handler->OnDisplayListComplete();
-	}
-#endif
-
 	return PR_COMPLETED;
 }
 
@@ -205,7 +196,7 @@ void jpeg_decode_OB(OSTask *task);
 
 	// most ucode_boot procedure copy 0xf80 bytes of ucode whatever the ucode_size is.
 	// For practical purpose we use a ucode_size = min(0xf80, task->ucode_size)
-	u32 sum {sum_bytes(g_pu8RamBase + (u32)task->t.ucode , Min<u32>(task->t.ucode_size, 0xf80) >> 1)};
+	u32 sum {sum_bytes(g_pu8RamBase + (u32)(uintptr_t)task->t.ucode , Min<u32>(task->t.ucode_size, 0xf80) >> 1)};
 
 	//DBGConsole_Msg(0, "JPEG Task: Sum=0x%08x", sum);
 	switch(sum)
@@ -241,6 +232,7 @@ EProcessResult RSP_HLE_CICX105(OSTask * task)
 				memcpy(g_pu8SpImemBase + 0x120, g_pu8RamBase + 0x1e8, 0x1f0);
 
 				/* dma_write(0x1120, 0x2fb1f0, 0xfe817000) */
+				DirtyPages_MarkRange(0x2fb1f0, 24 * 0xff0);
 				for (i = 0; i < 24; ++i)
 				{
 					memcpy(dst, src, 8);
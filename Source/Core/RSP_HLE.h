@@ -36,4 +36,7 @@ enum EProcessResult
 
 void RSP_HLE_ProcessTask();
 
+// Flags the SP as halted with the given status bits, raising an SP interrupt if it's enabled
+void RSP_HLE_Finished( u32 setbits );
+
 #endif // CORE_RSP_HLE_H_
@@ -0,0 +1,277 @@
+/*
+Copyright (C) 2012 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#include "stdafx.h"
+#include "Rewind.h"
+
+#include <stdio.h>
+
+#include <deque>
+#include <vector>
+
+#include "RewindDelta.h"
+#include "ROM.h"
+#include "SaveState.h"
+
+#include "Config/ConfigOptions.h"
+#include "Debug/DBGConsole.h"
+#include "OSHLE/ultra_os.h"
+#include "Utility/Timing.h"
+
+namespace
+{
+	struct RewindFrame
+	{
+		u32		Offset;			// In words, into gArena
+		u32		Length;			// In words
+	};
+
+	// Deltas, oldest first. They are packed into gArena in the same order, wrapping at the end.
+	std::deque< RewindFrame >	gFrames;
+	std::vector< u32 >			gArena;
+
+	// The newest snapshot, which the newest delta is applied to when stepping back
+	std::vector< u8 >			gKeyImage;
+	bool						gHasKeyImage = false;
+
+	std::vector< u8 >			gCaptureImage;
+	std::vector< u32 >			gDeltaScratch;
+
+	u32							gVIsSinceCapture = 0;
+	f32							gCaptureMs = 0.0f;
+	f32							gRestoreMs = 0.0f;
+
+void DiscardHistory()
+{
+	gFrames.clear();
+	gHasKeyImage = false;
+}
+
+//*****************************************************************************
+//	Finds room for a delta at the end of the ring, discarding the oldest
+//	deltas which are in the way.
+//*****************************************************************************
+bool AllocateFrame( u32 length, RewindFrame * p_frame )
+{
+	u32		arena_size( u32( gArena.size() ) );
+	if( length > arena_size )
+	{
+		return false;
+	}
+
+	u32		offset( 0 );
+	if( !gFrames.empty() )
+	{
+		const RewindFrame & newest( gFrames.back() );
+		offset = newest.Offset + newest.Length;
+
+		if( offset + length > arena_size )
+		{
+			// Wrap around. Anything left past this point is the oldest history, and is lost
+			while( !gFrames.empty() && gFrames.front().Offset >= offset )
+			{
+				gFrames.pop_front();
+			}
+			offset = 0;
+		}
+	}
+
+	while( !gFrames.empty() &&
+		   gFrames.front().Offset < offset + length &&
+		   gFrames.front().Offset + gFrames.front().Length > offset )
+	{
+		gFrames.pop_front();
+	}
+
+	p_frame->Offset = offset;
+	p_frame->Length = length;
+	return true;
+}
+
+f32 TicksToMs( u64 ticks )
+{
+	u64		freq;
+	NTiming::GetPreciseFrequency( &freq );
+	return f32( ticks ) * 1000.0f / f32( freq );
+}
+
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+bool Rewind_RomOpen()
+{
+	DiscardHistory();
+	gVIsSinceCapture = 0;
+	gCaptureMs = 0.0f;
+	gRestoreMs = 0.0f;
+
+	if( gRewindInterval > 0 )
+	{
+		gArena.resize( gRewindBufferSize * 1024 * 1024 / sizeof( u32 ) );
+	}
+	return true;
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void Rewind_RomClose()
+{
+	DiscardHistory();
+
+	// Give the memory back, it's several times the size of RDRAM
+	std::vector< u32 >().swap( gArena );
+	std::vector< u8 >().swap( gKeyImage );
+	std::vector< u8 >().swap( gCaptureImage );
+	std::vector< u32 >().swap( gDeltaScratch );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+bool Rewind_IsCaptureDue()
+{
+	if( gRewindInterval == 0 || gArena.empty() )
+		return false;
+
+	return ++gVIsSinceCapture >= gRewindInterval;
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void Rewind_Capture()
+{
+	u64		start;
+	NTiming::GetPreciseTime( &start );
+
+	SaveState_SaveToMemory( gCaptureImage );
+
+	// Round up to whole words, so the delta can be done a word at a time
+	gCaptureImage.resize( ( gCaptureImage.size() + 3 ) & ~3 );
+
+	if( gHasKeyImage && gKeyImage.size() == gCaptureImage.size() )
+	{
+		u32		num_words( u32( gCaptureImage.size() / sizeof( u32 ) ) );
+		gDeltaScratch.resize( num_words + 4 );
+
+		u32		length( Rewind_EncodeDelta( reinterpret_cast< const u32 * >( &gCaptureImage[ 0 ] ),
+											reinterpret_cast< const u32 * >( &gKeyImage[ 0 ] ),
+											num_words, &gDeltaScratch[ 0 ] ) );
+
+		RewindFrame		frame;
+		if( AllocateFrame( length, &frame ) )
+		{
+			memcpy( &gArena[ frame.Offset ], &gDeltaScratch[ 0 ], length * sizeof( u32 ) );
+			gFrames.push_back( frame );
+		}
+		else
+		{
+			// Too big to keep - the history before this point can't be reached any more
+			gFrames.clear();
+		}
+	}
+	else
+	{
+		// First capture, or RDRAM was resized by loading a savestate
+		gFrames.clear();
+	}
+
+	gKeyImage.swap( gCaptureImage );
+	gHasKeyImage = true;
+
+	u64		end;
+	NTiming::GetPreciseTime( &end );
+
+	gCaptureMs = TicksToMs( end - start );
+	gVIsSinceCapture = 0;
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+bool Rewind_Restore()
+{
+	if( !gHasKeyImage )
+		return false;
+
+	u64		start;
+	NTiming::GetPreciseTime( &start );
+
+	bool	ok( SaveState_LoadFromMemory( gKeyImage ) );
+
+	// Step the key image back ready for the next restore
+	if( ok && !gFrames.empty() )
+	{
+		const RewindFrame & frame( gFrames.back() );
+		u32		num_words( u32( gKeyImage.size() / sizeof( u32 ) ) );
+
+		if( !Rewind_ApplyDelta( &gArena[ frame.Offset ], frame.Length, reinterpret_cast< u32 * >( &gKeyImage[ 0 ] ), num_words ) )
+		{
+			DAEDALUS_ERROR( "Corrupt rewind delta" );
+			gFrames.clear();
+			gHasKeyImage = false;
+		}
+		else
+		{
+			gFrames.pop_back();
+		}
+	}
+	else
+	{
+		gHasKeyImage = false;
+	}
+
+	gVIsSinceCapture = 0;
+
+	u64		end;
+	NTiming::GetPreciseTime( &end );
+
+	gRestoreMs = TicksToMs( end - start );
+
+	// Stepping back is meant to be seamless, so say if it drops a frame, even in release builds
+	const f32	frame_ms( g_ROM.TvType == OS_TV_PAL ? 1000.0f / 50.0f : 1000.0f / 60.0f );
+	if( gRestoreMs > frame_ms )
+	{
+		fprintf( stderr, "Rewind: restore took %.2fms, longer than a %.2fms frame\n", gRestoreMs, frame_ms );
+	}
+
+	#ifdef DAEDALUS_DEBUG_CONSOLE
+	DBGConsole_Msg( 0, "Rewound in %.2fms, %d snapshots left", gRestoreMs, gHasKeyImage ? u32( gFrames.size() + 1 ) : 0 );
+	#endif
+	return ok;
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+f32 Rewind_GetCaptureMs()
+{
+	return gCaptureMs;
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+f32 Rewind_GetRestoreMs()
+{
+	return gRestoreMs;
+}
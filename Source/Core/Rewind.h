@@ -0,0 +1,52 @@
+/*
+Copyright (C) 2012 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#pragma once
+
+#ifndef CORE_REWIND_H_
+#define CORE_REWIND_H_
+
+//
+//	Keeps a ring of in-memory savestates, captured every gRewindInterval VIs,
+//	so the game can be stepped back without touching the disk.
+//	The newest snapshot is kept whole; older ones are stored as the XOR of
+//	each snapshot with the one after it, with runs of unchanged words removed.
+//	The deltas live in a fixed gRewindBufferSize arena and the oldest are
+//	discarded when it fills up.
+//
+//	Everything here runs on the CPU thread, from the VI handler.
+//
+
+bool	Rewind_RomOpen();
+void	Rewind_RomClose();
+
+// Called on every VI. Returns true when a snapshot should be captured.
+bool	Rewind_IsCaptureDue();
+void	Rewind_Capture();
+
+// Returns to the newest snapshot and discards it, so repeated calls step further back.
+bool	Rewind_Restore();
+
+// How long the last capture took. It all lands on one VI, so this is the size of the hitch.
+f32		Rewind_GetCaptureMs();
+
+// How long the last restore took. Restores which take longer than a frame are also reported on stderr.
+f32		Rewind_GetRestoreMs();
+
+#endif // CORE_REWIND_H_
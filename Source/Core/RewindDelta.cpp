@@ -0,0 +1,95 @@
+/*
+Copyright (C) 2012 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#include "stdafx.h"
+#include "RewindDelta.h"
+
+//*****************************************************************************
+//
+//*****************************************************************************
+u32 Rewind_EncodeDelta( const u32 * p_newer, const u32 * p_older, u32 num_words, u32 * p_out )
+{
+	u32 *	p_dst( p_out );
+	u32		i( 0 );
+
+	while( i < num_words )
+	{
+		u32		unchanged_start( i );
+		while( i < num_words && p_newer[ i ] == p_older[ i ] )
+		{
+			++i;
+		}
+
+		u32		changed_start( i );
+		while( i < num_words )
+		{
+			if( p_newer[ i ] == p_older[ i ] &&
+				( i + 1 >= num_words || p_newer[ i + 1 ] == p_older[ i + 1 ] ) )
+			{
+				break;
+			}
+			++i;
+		}
+
+		*p_dst++ = changed_start - unchanged_start;
+		*p_dst++ = i - changed_start;
+		for( u32 j = changed_start; j < i; ++j )
+		{
+			*p_dst++ = p_newer[ j ] ^ p_older[ j ];
+		}
+	}
+
+	return u32( p_dst - p_out );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+bool Rewind_ApplyDelta( const u32 * p_delta, u32 delta_words, u32 * p_image, u32 num_words )
+{
+	const u32 *	p_end( p_delta + delta_words );
+	u32			i( 0 );
+
+	while( p_delta < p_end )
+	{
+		if( p_end - p_delta < 2 )
+		{
+			return false;
+		}
+
+		u32		unchanged( p_delta[ 0 ] );
+		u32		changed( p_delta[ 1 ] );
+		p_delta += 2;
+
+		// Written so the counts from a corrupt delta can't overflow
+		if( unchanged > num_words - i || changed > num_words - i - unchanged || changed > u32( p_end - p_delta ) )
+		{
+			return false;
+		}
+
+		i += unchanged;
+
+		for( u32 j = 0; j < changed; ++j )
+		{
+			p_image[ i++ ] ^= *p_delta++;
+		}
+	}
+
+	return true;
+}
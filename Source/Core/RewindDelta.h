@@ -0,0 +1,41 @@
+/*
+Copyright (C) 2012 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#pragma once
+
+#ifndef CORE_REWINDDELTA_H_
+#define CORE_REWINDDELTA_H_
+
+//
+//	Delta encoding for rewind snapshots. A delta is a list of tokens:
+//		[unchanged word count] [changed word count] [changed words XORed]...
+//	A single unchanged word is kept in the run of changed words, so each token
+//	skips at least two words and the output is never more than 4 words larger
+//	than the input. As it's an XOR, applying the delta to either image gives
+//	the other.
+//
+
+// Writes the delta between two images of num_words to p_out, which must have room for num_words + 4 words.
+// Returns its length in words.
+u32		Rewind_EncodeDelta( const u32 * p_newer, const u32 * p_older, u32 num_words, u32 * p_out );
+
+// Returns false if the delta doesn't fit an image of num_words, e.g. it was made from a bigger one
+bool	Rewind_ApplyDelta( const u32 * p_delta, u32 delta_words, u32 * p_image, u32 num_words );
+
+#endif // CORE_REWINDDELTA_H_
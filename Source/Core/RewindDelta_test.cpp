@@ -0,0 +1,158 @@
+#include <stdafx.h>
+#include "Core/RewindDelta.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+static u32 gSeed( 0x12345678 );
+
+static u32 Random()
+{
+	gSeed = gSeed * 1664525 + 1013904223;
+	return gSeed >> 8;
+}
+
+// Encodes newer against older, checks the delta is within its size bound, and that applying it
+// to either image gives the other
+static void CheckRoundTrip( const std::vector< u32 > & newer, const std::vector< u32 > & older )
+{
+	u32					num_words( u32( newer.size() ) );
+	std::vector< u32 >	delta( num_words + 4 + 1, 0xdeadbeef );
+
+	u32		length( Rewind_EncodeDelta( newer.data(), older.data(), num_words, delta.data() ) );
+	ASSERT_LE( length, num_words + 4 );
+	EXPECT_EQ( 0xdeadbeef, delta[ num_words + 4 ] );
+
+	std::vector< u32 >	image( older );
+	ASSERT_TRUE( Rewind_ApplyDelta( delta.data(), length, image.data(), num_words ) );
+	EXPECT_EQ( newer, image );
+
+	ASSERT_TRUE( Rewind_ApplyDelta( delta.data(), length, image.data(), num_words ) );
+	EXPECT_EQ( older, image );
+}
+
+static std::vector< u32 > RandomImage( u32 num_words )
+{
+	std::vector< u32 >	image( num_words );
+	for( u32 i = 0; i < num_words; ++i )
+	{
+		image[ i ] = Random();
+	}
+	return image;
+}
+
+TEST(RewindDelta, EmptyImage)
+{
+	std::vector< u32 >	empty;
+	u32					delta[ 4 ];
+
+	EXPECT_EQ( 0u, Rewind_EncodeDelta( empty.data(), empty.data(), 0, delta ) );
+	EXPECT_TRUE( Rewind_ApplyDelta( delta, 0, empty.data(), 0 ) );
+}
+
+TEST(RewindDelta, IdenticalImagesAreOneToken)
+{
+	std::vector< u32 >	image( RandomImage( 1000 ) );
+	u32					delta[ 1004 ];
+
+	ASSERT_EQ( 2u, Rewind_EncodeDelta( image.data(), image.data(), 1000, delta ) );
+	EXPECT_EQ( 1000u, delta[ 0 ] );
+	EXPECT_EQ( 0u, delta[ 1 ] );
+
+	CheckRoundTrip( image, image );
+}
+
+TEST(RewindDelta, ZeroRuns)
+{
+	// Changes at the very start and with no unchanged words before them, so the first token skips nothing
+	std::vector< u32 >	older( 64, 0 );
+	std::vector< u32 >	newer( older );
+	newer[ 0 ] = 1;
+	newer[ 1 ] = 2;
+	newer[ 40 ] = 3;
+	CheckRoundTrip( newer, older );
+
+	// Every word changed, so there's a single token with no unchanged run
+	CheckRoundTrip( RandomImage( 64 ), older );
+}
+
+TEST(RewindDelta, RunsCrossingTheEnd)
+{
+	std::vector< u32 >	older( RandomImage( 100 ) );
+
+	// A changed run ending on the last word
+	std::vector< u32 >	newer( older );
+	for( u32 i = 90; i < 100; ++i )
+	{
+		newer[ i ] ^= 0xff;
+	}
+	CheckRoundTrip( newer, older );
+
+	// A single changed word at the end, and one just before it with an unchanged word between
+	newer = older;
+	newer[ 97 ] ^= 1;
+	newer[ 99 ] ^= 1;
+	CheckRoundTrip( newer, older );
+
+	// An unchanged run reaching the end
+	newer = older;
+	newer[ 10 ] ^= 1;
+	CheckRoundTrip( newer, older );
+}
+
+TEST(RewindDelta, SingleUnchangedWordsStayInTheRun)
+{
+	// Alternating changed and unchanged words is the worst case for the size of the delta
+	std::vector< u32 >	older( 257, 0 );
+	std::vector< u32 >	newer( older );
+	for( u32 i = 0; i < newer.size(); i += 2 )
+	{
+		newer[ i ] = 1;
+	}
+	CheckRoundTrip( newer, older );
+}
+
+TEST(RewindDelta, RandomChanges)
+{
+	for( u32 iteration = 0; iteration < 1000; ++iteration )
+	{
+		u32					num_words( Random() % 300 );
+		std::vector< u32 >	older( RandomImage( num_words ) );
+		std::vector< u32 >	newer( older );
+
+		u32		num_changes( num_words > 0 ? Random() % num_words : 0 );
+		for( u32 i = 0; i < num_changes; ++i )
+		{
+			newer[ Random() % num_words ] = Random();
+		}
+		CheckRoundTrip( newer, older );
+	}
+}
+
+TEST(RewindDelta, RejectsDeltasForDifferentSizes)
+{
+	std::vector< u32 >	older( RandomImage( 100 ) );
+	std::vector< u32 >	newer( older );
+	newer[ 95 ] ^= 1;
+
+	std::vector< u32 >	delta( 104 );
+	u32		length( Rewind_EncodeDelta( newer.data(), older.data(), 100, delta.data() ) );
+
+	// Applying it to a smaller image would write past the end
+	std::vector< u32 >	smaller( older.begin(), older.begin() + 90 );
+	EXPECT_FALSE( Rewind_ApplyDelta( delta.data(), length, smaller.data(), u32( smaller.size() ) ) );
+	EXPECT_TRUE( std::equal( smaller.begin(), smaller.end(), older.begin() ) );
+
+	// A truncated delta ends part way through a token. What's been applied by then is left in the image.
+	std::vector< u32 >	image( older );
+	EXPECT_FALSE( Rewind_ApplyDelta( delta.data(), length - 1, image.data(), 100 ) );
+
+	// A bigger image is fine, the words past the end of the delta are unchanged
+	std::vector< u32 >	bigger( older );
+	bigger.resize( 120, 7 );
+	ASSERT_TRUE( Rewind_ApplyDelta( delta.data(), length, bigger.data(), u32( bigger.size() ) ) );
+	EXPECT_TRUE( std::equal( newer.begin(), newer.end(), bigger.begin() ) );
+	EXPECT_EQ( 7u, bigger[ 110 ] );
+}
@@ -20,6 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "stdafx.h"
 
 #include <stdio.h>
+#include <string.h>
 
 #include "SaveState.h"
 #include "Memory.h"
@@ -32,9 +33,21 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "Math/MathUtil.h"
 #include "OSHLE/patch.h"
 #include "OSHLE/ultra_R4300.h"
+#include "Plugins/AudioPlugin.h"
+#include "Plugins/GraphicsPlugin.h"
 #include "System/System.h"
+#include "Utility/IO.h"
 #include "Utility/ROMFile.h"
+#include "Utility/Thread.h"
+#include "Utility/Timing.h"
 #include "Utility/ZlibWrapper.h"
+
+// Compress and write savestates on a separate thread, so the emulation doesn't hitch.
+// The PSP can't spare the memory for the extra copy of RDRAM.
+#ifndef DAEDALUS_PSP
+#define DAEDALUS_ASYNC_SAVESTATES
+#endif
+
 //
 //	SaveState code written initially by Lkb. Seems to be based about Project 64's
 //	savestate format, which is partially documented here: http://www.hcs64.com/usf/usf.txt
@@ -42,16 +55,71 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 const u32 SAVESTATE_PROJECT64_MAGIC_NUMBER = 0x23D8A6C8;
 
-class SaveState_ostream_gzip
+//
+//	Streams which keep the savestate in memory, so it can be captured and restored
+//	without touching the disk (see Rewind.cpp). These match the interface of
+//	COutStream and CInStream.
+//
+class CMemoryOutStream
+{
+	public:
+		explicit CMemoryOutStream( std::vector< u8 > & buffer )
+			: mBuffer( buffer )
+		{
+			mBuffer.clear();
+		}
+
+		bool IsOpen() const			{ return true; }
+
+		bool WriteData( const void * data, u32 length )
+		{
+			const u8 * p_data( reinterpret_cast< const u8 * >( data ) );
+			mBuffer.insert( mBuffer.end(), p_data, p_data + length );
+			return true;
+		}
+
+	private:
+		std::vector< u8 > &		mBuffer;
+};
+
+class CMemoryInStream
+{
+	public:
+		explicit CMemoryInStream( const std::vector< u8 > & buffer )
+			: mBuffer( buffer )
+			, mOffset( 0 )
+		{
+		}
+
+		bool IsOpen() const			{ return true; }
+
+		bool ReadData( void * data, u32 length )
+		{
+			if( length > mBuffer.size() - mOffset )
+				return false;
+
+			memcpy( data, &mBuffer[ mOffset ], length );
+			mOffset += length;
+			return true;
+		}
+
+	private:
+		const std::vector< u8 > &	mBuffer;
+		size_t						mOffset;
+};
+
+template< typename Stream >
+class SaveState_ostream
 {
 public:
-	SaveState_ostream_gzip( const char * filename )
-		: mStream( filename )
+	template< typename Source >
+	explicit SaveState_ostream( Source & source )
+		: mStream( source )
 	{
 	}
 
 	template<typename T>
-	inline SaveState_ostream_gzip& operator << (const T& data)
+	inline SaveState_ostream& operator << (const T& data)
 	{
 		write(&data, sizeof(T));
 		return *this;
@@ -106,14 +174,16 @@ public:
 	}
 
 private:
-	COutStream		mStream;
+	Stream			mStream;
 };
 
-class SaveState_istream_gzip
+template< typename Stream >
+class SaveState_istream
 {
 public:
-	explicit SaveState_istream_gzip( const char * filename )
-		: mStream( filename )
+	template< typename Source >
+	explicit SaveState_istream( Source & source )
+		: mStream( source )
 	{}
 
 	inline bool IsValid() const
@@ -122,7 +192,7 @@ public:
 	}
 
 	template<typename T>
-	inline SaveState_istream_gzip& operator >> (T& data)
+	inline SaveState_istream& operator >> (T& data)
 	{
 		if (read(&data, sizeof(data)) != sizeof(data))
 		{
@@ -145,16 +215,6 @@ public:
 			skip(size - MemoryRegionSizes[buffernum]);
 	}
 
-	inline void read_memory_buffer_write_value(int buffernum, int address)
-	{
-		for( u32 i = 0; i < MemoryRegionSizes[buffernum]; i += 4 )
-		{
-			u32 value;
-			*this >> value;
-			Write32Bits(address + i, value);
-		}
-	}
-
 	void skip( size_t size )
 	{
 		if( mStream.IsOpen() )
@@ -184,17 +244,17 @@ public:
 	}
 
 private:
-	CInStream			mStream;
+	Stream				mStream;
 };
 
+typedef SaveState_ostream< COutStream >			SaveState_ostream_gzip;
+typedef SaveState_istream< CInStream >			SaveState_istream_gzip;
+typedef SaveState_ostream< CMemoryOutStream >	SaveState_ostream_memory;
+typedef SaveState_istream< CMemoryInStream >	SaveState_istream_memory;
 
-bool SaveState_SaveToFile( const char * filename )
+template< typename OStream >
+static void SaveState_Write( OStream & stream )
 {
-	SaveState_ostream_gzip stream( filename );
-
-	if( !stream.IsValid() )
-		return false;
-
 	stream << SAVESTATE_PROJECT64_MAGIC_NUMBER;
 	stream << gRamSize;
 	ROMHeader rom_header;
@@ -248,6 +308,105 @@ bool SaveState_SaveToFile( const char * filename )
 	stream.write( g_pMemoryBuffers[MEM_PIF_RAM], 0x40);
 	stream.write( g_pMemoryBuffers[MEM_RD_RAM], gRamSize);
 	stream.write_memory_buffer(MEM_SP_MEM);
+}
+
+#ifdef DAEDALUS_ASYNC_SAVESTATES
+namespace
+{
+	// The snapshot being written by gSaveStateWriter. Kept between saves so it only needs allocating once.
+	std::vector< u8 >	gSaveStateBuffer;
+	IO::Filename		gSaveStateFilename;
+	ThreadHandle		gSaveStateWriter = kInvalidThreadHandle;
+	bool				gSaveStateWriteOk = true;		// Only read when the write wasn't on its own thread
+
+	u32 DAEDALUS_THREAD_CALL_TYPE SaveStateWriterThread( void * arg )
+	{
+		// Write to a temporary file first, so a crash never leaves a half written savestate behind
+		IO::Filename	temp_filename;
+		IO::Path::Assign( temp_filename, gSaveStateFilename );
+		IO::Path::AddExtension( temp_filename, ".tmp" );
+
+		bool	ok;
+		{
+			COutStream	stream( temp_filename );
+			ok = stream.IsOpen() && stream.WriteData( &gSaveStateBuffer[ 0 ], gSaveStateBuffer.size() );
+		}
+
+		// MoveFile won't replace an existing file on Windows
+		if( ok && !IO::File::Move( temp_filename, gSaveStateFilename ) )
+		{
+			IO::File::Delete( gSaveStateFilename );
+			ok = IO::File::Move( temp_filename, gSaveStateFilename );
+		}
+
+		if( !ok )
+		{
+			// Nothing is waiting on the result, and DBGConsole_Msg is compiled out of release builds
+			fprintf( stderr, "Failed to write savestate '%s'\n", gSaveStateFilename );
+			IO::File::Delete( temp_filename );
+		}
+		gSaveStateWriteOk = ok;
+		return 0;
+	}
+}
+#endif
+
+void SaveState_Flush()
+{
+#ifdef DAEDALUS_ASYNC_SAVESTATES
+	if( gSaveStateWriter != kInvalidThreadHandle )
+	{
+		JoinThread( gSaveStateWriter, -1 );
+		ReleaseThreadHandle( gSaveStateWriter );
+		gSaveStateWriter = kInvalidThreadHandle;
+	}
+#endif
+}
+
+bool SaveState_SaveToFile( const char * filename )
+{
+#ifdef DAEDALUS_ASYNC_SAVESTATES
+	u64 start;
+	NTiming::GetPreciseTime( &start );
+
+	// The previous save has usually finished long ago, but its buffer can't be reused until it has
+	SaveState_Flush();
+
+	SaveState_SaveToMemory( gSaveStateBuffer );
+	IO::Path::Assign( gSaveStateFilename, filename );
+
+	gSaveStateWriter = CreateThread( "SaveState", SaveStateWriterThread, NULL );
+	bool	queued( gSaveStateWriter != kInvalidThreadHandle );
+	if( !queued )
+	{
+		SaveStateWriterThread( NULL );
+	}
+
+	u64 end;
+	NTiming::GetPreciseTime( &end );
+	u64 freq;
+	NTiming::GetPreciseFrequency( &freq );
+
+	DBGConsole_Msg( 0, "Savestate took %.2fms on the emulation thread", f32( end - start ) * 1000.0f / f32( freq ) );
+
+	// If it was written synchronously we already know how it went
+	return queued || gSaveStateWriteOk;
+#else
+	SaveState_ostream_gzip stream( filename );
+
+	if( !stream.IsValid() )
+		return false;
+
+	SaveState_Write( stream );
+	return true;
+#endif
+}
+
+bool SaveState_SaveToMemory( std::vector< u8 > & buffer )
+{
+	SaveState_ostream_memory stream( buffer );
+
+	SaveState_Write( stream );
 	return true;
 }
 
@@ -272,13 +431,9 @@ static void Swap_PIF()
 	}
 }
 
-bool SaveState_LoadFromFile( const char * filename )
+template< typename IStream >
+static bool SaveState_Read( IStream & stream )
 {
-	SaveState_istream_gzip stream( filename );
-
-	if( !stream.IsValid() )
-		return false;
-
 	u32 value;
 	stream >> value;
 	if(value != SAVESTATE_PROJECT64_MAGIC_NUMBER)
@@ -340,8 +495,19 @@ bool SaveState_LoadFromFile( const char * filename )
 	stream.read(miRegData, MemoryRegionSizes[MEM_MI_REG]);
 	memcpy(g_pMemoryBuffers[MEM_MI_REG], miRegData, MemoryRegionSizes[MEM_MI_REG]);
 
-	stream.read_memory_buffer_write_value(MEM_VI_REG, 0x84400000); // call WriteValue to update global and GFX plugin data
-	stream.read_memory_buffer_write_value(MEM_AI_REG, 0x84500000); // call WriteValue to update audio plugin data
+	// Restore the VI and AI registers directly, then tell the plugins about the ones they track.
+	// Replaying them through Write32Bits would redraw the old frame and requeue the last audio buffer.
+	stream.read_memory_buffer(MEM_VI_REG);
+	stream.read_memory_buffer(MEM_AI_REG);
+	if (gGraphicsPlugin != NULL)
+	{
+		gGraphicsPlugin->ViStatusChanged();
+		gGraphicsPlugin->ViWidthChanged();
+	}
+	if (gAudioPlugin != NULL)
+	{
+		gAudioPlugin->DacrateChanged( g_ROM.TvType ? CAudioPlugin::ST_NTSC : CAudioPlugin::ST_PAL );
+	}
 
 	// here to undo any modifications done by plugins
 	memcpy(g_pMemoryBuffers[MEM_DPC_REG], dpcRegData, MemoryRegionSizes[MEM_DPC_REG]);
@@ -366,6 +532,7 @@ bool SaveState_LoadFromFile( const char * filename )
 
 		g_TLBs[i].UpdateValue(pagemask, hi, lo1, lo0);
 	}
+	TLBCache_Invalidate();		// EntryHi (and so the ASID) is restored below
 	for(i = 0; i < 32; i++)
 	{
 		if(i == C0_SR)
@@ -388,6 +555,7 @@ bool SaveState_LoadFromFile( const char * filename )
 
 	stream.read(g_pMemoryBuffers[MEM_RD_RAM], gRamSize);
 	stream.read_memory_buffer(MEM_SP_MEM); //, 0x84000000);
+	DirtyPages_MarkAll();
 
 #ifdef DAEDALUS_ENABLE_OS_HOOKS
 	Patch_PatchAll();
@@ -396,8 +564,29 @@ bool SaveState_LoadFromFile( const char * filename )
 	return true;
 }
 
+bool SaveState_LoadFromFile( const char * filename )
+{
+	SaveState_Flush();
+
+	SaveState_istream_gzip stream( filename );
+
+	if( !stream.IsValid() )
+		return false;
+
+	return SaveState_Read( stream );
+}
+
+bool SaveState_LoadFromMemory( const std::vector< u8 > & buffer )
+{
+	SaveState_istream_memory stream( buffer );
+
+	return SaveState_Read( stream );
+}
+
 RomID SaveState_GetRomID( const char * filename )
 {
+	SaveState_Flush();
+
 	SaveState_istream_gzip stream( filename );
 
 	if( !stream.IsValid() )
@@ -420,6 +609,8 @@ RomID SaveState_GetRomID( const char * filename )
 
 const char* SaveState_GetRom( const char * filename )
 {
+	SaveState_Flush();
+
 	SaveState_istream_gzip stream( filename );
 
 	if( !stream.IsValid() )
@@ -23,10 +23,21 @@
 #ifndef CORE_SAVESTATE_H_
 #define CORE_SAVESTATE_H_
 
+#include <vector>
+
 class RomID;
 
 bool SaveState_LoadFromFile( const char * filename );
+// Savestates are written in the background, so true only means the snapshot was taken and queued.
+// A write which fails after that is reported on stderr.
 bool SaveState_SaveToFile( const char * filename );
+
+// Waits for SaveState_SaveToFile to finish writing in the background
+void SaveState_Flush();
+
+// Used by Rewind.cpp to keep snapshots in memory. The format matches the files.
+bool SaveState_LoadFromMemory( const std::vector< u8 > & buffer );
+bool SaveState_SaveToMemory( std::vector< u8 > & buffer );
 RomID SaveState_GetRomID( const char * filename );
 const char* SaveState_GetRom(const char * filename);
 
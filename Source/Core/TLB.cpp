@@ -21,12 +21,79 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "TLB.h"
 #include "CPU.h"
+#include "Memory.h"
 #include "Debug/DebugLog.h"
 #include "Debug/DBGConsole.h"
 
 #include "OSHLE/ultra_R4300.h"
 
 ALIGNED_GLOBAL(TLBEntry, g_TLBs[32], CACHE_ALIGN);
+ALIGNED_GLOBAL(TLBCacheEntry, g_TLBCache[TLB_CACHE_SIZE], CACHE_ALIGN);
+
+#ifdef DAEDALUS_PROFILE_EXECUTION
+u32			gTLBCacheReadHit  {};
+u32			gTLBCacheWriteHit {};
+#endif
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void TLBCache_Invalidate()
+{
+	for( u32 i {}; i < TLB_CACHE_SIZE; ++i )
+	{
+		g_TLBCache[i].VPage = TLB_CACHE_INVALID_PAGE;
+	}
+}
+
+//*****************************************************************************
+//	Drop any cached pages in [address, address + size)
+//*****************************************************************************
+static void TLBCache_InvalidateRange( u32 address, u32 size )
+{
+	u32 num_pages {size >> TLB_CACHE_PAGE_SHIFT};
+	if( num_pages == 0 || num_pages >= TLB_CACHE_SIZE )
+	{
+		TLBCache_Invalidate();
+		return;
+	}
+
+	for( u32 i {}; i < num_pages; ++i )
+	{
+		u32 page {address + (i << TLB_CACHE_PAGE_SHIFT)};
+		TLBCacheEntry & entry = g_TLBCache[ (page >> TLB_CACHE_PAGE_SHIFT) & TLB_CACHE_MASK ];
+		if( entry.VPage == page )
+		{
+			entry.VPage = TLB_CACHE_INVALID_PAGE;
+		}
+	}
+}
+
+//*****************************************************************************
+//	Translations were made for the current ASID, so flush if it changes
+//*****************************************************************************
+void TLBCache_SetEntryHi( u32 value )
+{
+	if( (gCPUState.CPUControl[C0_ENTRYHI]._u32 ^ value) & TLBHI_PIDMASK )
+	{
+		TLBCache_Invalidate();
+	}
+	gCPUState.CPUControl[C0_ENTRYHI]._u32 = value;
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+static void TLBCache_Fill( u32 address, u32 physical_addr )
+{
+	u32 page_mask {(1 << TLB_CACHE_PAGE_SHIFT) - 1};
+	u32 vpage {address & ~page_mask};
+	u32 ppage {physical_addr & 0x007FFFFF & ~page_mask};
+
+	TLBCacheEntry & entry = g_TLBCache[ (address >> TLB_CACHE_PAGE_SHIFT) & TLB_CACHE_MASK ];
+	entry.VPage = vpage;
+	entry.Base = reinterpret_cast< uintptr_t >( g_pu8RamBase ) + ppage - vpage;
+}
 
 void TLBEntry::UpdateValue(u32 _pagemask, u32 _hi, u32 _pfno, u32 _pfne)
 {
@@ -37,6 +104,9 @@ void TLBEntry::UpdateValue(u32 _pagemask, u32 _hi, u32 _pfno, u32 _pfne)
 	// TLB[INDEX] <- PageMask || (EntryHi AND NOT PageMask) || EntryLo1 || EntryLo0
 	DPF( DEBUG_TLB, "PAGEMASK: 0x%08x ENTRYHI: 0x%08x. ENTRYLO1: 0x%08x. ENTRYLO0: 0x%08x", _pagemask, _hi, _pfno, _pfne);
 
+	// Anything cached from the entry being replaced is now stale
+	TLBCache_InvalidateRange(addrcheck, ~vpnmask + 1);
+
 	pagemask = _pagemask;
 	hi = _hi;
 	pfne = _pfne;
@@ -164,15 +234,22 @@ u32 TLBEntry::Translate(u32 address, bool& missing)
 		const TLBEntry & tlb {g_TLBs[iMatched]};
 
 		// Check for odd/even entry
+		u32 physical_addr {};
 		if (address & tlb.checkbit)
 		{
 			if( (tlb.pfno & TLBLO_V) != 0 )
-				return  tlb.pfnohi | (address & tlb.mask2);
+				physical_addr = tlb.pfnohi | (address & tlb.mask2);
 		}
 		else
 		{
 			if( (tlb.pfne & TLBLO_V) != 0 )
-				return tlb.pfnehi | (address & tlb.mask2);
+				physical_addr = tlb.pfnehi | (address & tlb.mask2);
+		}
+
+		if (physical_addr != 0)
+		{
+			TLBCache_Fill(address, physical_addr);
+			return physical_addr;
 		}
 
 		// Throw TLB Invalid exception
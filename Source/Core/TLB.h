@@ -19,6 +19,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #pragma once
 
+#include <stddef.h>
+
 #include "Utility/Alignment.h"
 #include "Utility/DaedalusTypes.h"
 
@@ -46,3 +48,44 @@ public:
 };
 
 ALIGNED_EXTERN(TLBEntry, g_TLBs[32], CACHE_ALIGN);
+
+//*****************************************************************************
+//	Direct mapped cache of recent TLB translations, at 4KB page granularity,
+//	so most mapped accesses avoid scanning g_TLBs. Entries are filled by
+//	TLBEntry::Translate and dropped when a TLB entry is written or the ASID
+//	in EntryHi changes. The code generators probe it inline, so the layout
+//	must stay in sync with them.
+//*****************************************************************************
+struct TLBCacheEntry
+{
+	u32			VPage;		// Virtual address of the page, or TLB_CACHE_INVALID_PAGE
+	uintptr_t	Base;		// Base + virtual address gives the host address
+};
+
+#define TLB_CACHE_PAGE_SHIFT	12
+#define TLB_CACHE_SIZE			1024
+#define TLB_CACHE_MASK			(TLB_CACHE_SIZE - 1)
+
+// KSEG0 is never translated through the TLB, so this never matches a mapped address
+#define TLB_CACHE_INVALID_PAGE	0x80000000
+
+ALIGNED_EXTERN(TLBCacheEntry, g_TLBCache[TLB_CACHE_SIZE], CACHE_ALIGN);
+
+#ifdef DAEDALUS_PROFILE_EXECUTION
+extern u32		gTLBCacheReadHit;
+extern u32		gTLBCacheWriteHit;
+#endif
+
+// Returns NULL if the page isn't cached
+inline void * TLBCache_Lookup( u32 address )
+{
+	const TLBCacheEntry & entry( g_TLBCache[ (address >> TLB_CACHE_PAGE_SHIFT) & TLB_CACHE_MASK ] );
+
+	if( entry.VPage == (address & ~((1 << TLB_CACHE_PAGE_SHIFT) - 1)) )
+		return (void *)(entry.Base + address);
+
+	return NULL;
+}
+
+void TLBCache_Invalidate();
+void TLBCache_SetEntryHi( u32 value );
@@ -22,6 +22,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #ifndef DYNAREC_ASSEMBLYUTILS_H_
 #define DYNAREC_ASSEMBLYUTILS_H_
 
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "Utility/DaedalusTypes.h"
@@ -38,7 +39,7 @@ public:
 	bool			IsSet() const				{ return mpLocation != NULL; }
 	const void *	GetTarget() const			{ return mpLocation; }
 	const u8 *		GetTargetU8P() const		{ return reinterpret_cast< const u8 * >( mpLocation ); }
-	u32				GetTargetU32() const		{ return reinterpret_cast< u32 >( mpLocation ); }
+	u32				GetTargetU32() const		{ return u32( reinterpret_cast< uintptr_t >( mpLocation ) ); }
 
 
 
@@ -77,6 +78,7 @@ namespace AssemblyUtils
 {
 	bool		PatchJumpLong( CJumpLocation jump, CCodeLabel target );
 	bool		PatchJumpLongAndFlush( CJumpLocation jump, CCodeLabel target );
+	CCodeLabel	GetJumpTarget( CJumpLocation jump );
 	void		ReplaceBranchWithJump( CJumpLocation branch, CCodeLabel target );
 }
 
@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define DYNAREC_CODEBUFFERMANAGER_H_
 
 #include "Utility/DaedalusTypes.h"
+#include "AssemblyUtils.h"
 
 class CCodeGenerator;
 
@@ -32,9 +33,16 @@ public:
 	virtual void					Reset() = 0;
 	virtual	void					Finalise() = 0;
 
-	virtual	CCodeGenerator *		StartNewBlock() = 0;
+	// num_instructions is the length of the trace, so space can be sized to fit it.
+	// Returns NULL if there's no room for another block. The fragment will have to be dropped.
+	virtual	CCodeGenerator *		StartNewBlock( u32 num_instructions ) = 0;
+	// Returns the size of the primary code, or 0 if the block overran its space and was dropped
 	virtual	u32						FinaliseCurrentBlock() = 0;
 
+	// Return the primary buffer space used by a retired block. The default
+	// implementation doesn't reuse space until the next Reset().
+	virtual	void					ReleaseBlock( CCodeLabel start, u32 size )	{}
+
 public:
 	static	CCodeBufferManager *	Create();
 };
@@ -53,7 +53,8 @@ class CCodeGenerator
 		virtual void				Finalise( ExceptionHandlerFn p_exception_handler_fn, const std::vector< CJumpLocation > & exception_handler_jumps ) = 0;
 
 
-		virtual void				UpdateRegisterCaching( u32 instruction_idx ) = 0;
+		// Called before each instruction. Only needed by backends which keep N64 registers in host registers
+		virtual void				UpdateRegisterCaching( u32 instruction_idx ) {}
 
 		virtual RegisterSnapshotHandle	GetRegisterSnapshot() = 0;
 
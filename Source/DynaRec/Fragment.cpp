@@ -103,6 +103,15 @@ CFragment::CFragment( CCodeBufferManager * p_manager,
 	mRegisterUsage = register_usage;
 #endif
 
+	for( TraceBuffer::const_iterator it = trace.begin(); it != trace.end(); ++it )
+	{
+		u32		page( it->Address >> 12 );
+		if( std::find( mPages.begin(), mPages.end(), page ) == mPages.end() )
+		{
+			mPages.push_back( page );
+		}
+	}
+
 	Assemble( p_manager, exit_address, trace, branch_details, register_usage );
 }
 
@@ -579,7 +588,9 @@ void CFragment::Assemble( CCodeBufferManager * p_manager,
 
 	const u32				NO_JUMP_ADDRESS( 0 );
 
-	CCodeGenerator *		p_generator( p_manager->StartNewBlock() );
+	CCodeGenerator *		p_generator( p_manager->StartNewBlock( trace.size() ) );
+	if( p_generator == NULL )
+		return;
 
 	mEntryPoint = p_generator->GetEntryPoint();
 
@@ -840,6 +851,10 @@ void CFragment::Assemble( CCodeBufferManager * p_manager,
 
 	mFragmentFunctionLength = p_manager->FinaliseCurrentBlock();
 	mOutputLength = mFragmentFunctionLength - ADDITIONAL_OUTPUT_BYTES;
+	if( mFragmentFunctionLength == 0 )
+	{
+		mEntryPoint = CCodeLabel();
+	}
 
 	delete p_generator;
 }
@@ -853,7 +868,10 @@ void CFragment::Assemble( CCodeBufferManager * p_manager, CCodeLabel function_pt
 	std::vector< CJumpLocation >		exception_handler_jumps;
 	SRegisterUsageInfo register_usage;
 
-	CCodeGenerator *p_generator = p_manager->StartNewBlock();
+	CCodeGenerator *p_generator = p_manager->StartNewBlock( 0 );
+	if( p_generator == NULL )
+		return;
+
 	mEntryPoint = p_generator->GetEntryPoint();
 
 
@@ -871,6 +889,10 @@ void CFragment::Assemble( CCodeBufferManager * p_manager, CCodeLabel function_pt
 	p_generator->Finalise( HandleException, exception_handler_jumps );
 	mFragmentFunctionLength = p_manager->FinaliseCurrentBlock();
 	mOutputLength = mFragmentFunctionLength - ADDITIONAL_OUTPUT_BYTES;
+	if( mFragmentFunctionLength == 0 )
+	{
+		mEntryPoint = CCodeLabel();
+	}
 
 	delete p_generator;
 }
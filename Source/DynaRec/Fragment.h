@@ -79,7 +79,7 @@ public:
 #endif
 
 		u32			GetEntryAddress() const						{ return mEntryAddress; }
-		CCodeLabel	GetEntryTarget() const						{ return mEntryPoint; }
+		CCodeLabel	GetEntryTarget() const						{ return mEntryPoint; }	// Not set if there was no room to assemble the fragment
 
 		u32			GetMemoryUsage() const;
 		u32			GetInputLength() const						{ return mInputLength; }
@@ -90,6 +90,11 @@ public:
 		const FragmentPatchList &	GetPatchList() const		{ return mPatchList; }
 		void		DiscardPatchList()							{ mPatchList.clear(); }
 
+		// The 4KB pages (address >> 12) which this fragment was compiled from.
+		// Empty for OS hook fragments, which don't depend on the contents of RAM.
+		const std::vector< u32 > &	GetPages() const			{ return mPages; }
+		u32			GetFunctionLength() const					{ return mFragmentFunctionLength; }
+
 #ifdef FRAGMENT_RETAIN_ADDITIONAL_INFO
 		u32			GetHitCount() const							{ return mHitCount; }
 		u32			GetCyclesExecuted() const					{ return mHitCount * mOutputLength / 4; }
@@ -111,6 +116,7 @@ private:
 		u32								mEntryAddress;
 
 		std::vector< SFragmentPatchDetails >	mPatchList;
+		std::vector< u32 >				mPages;
 
 		CCodeLabel						mEntryPoint;
 		u32								mInputLength;
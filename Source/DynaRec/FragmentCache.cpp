@@ -48,10 +48,14 @@ CFragmentCache::CFragmentCache()
 :	mMemoryUsage( 0 )
 ,	mInputLength( 0 )
 ,	mOutputLength( 0 )
+,	mClearCount( 0 )
 ,	mCachedFragmentAddress( 0 )
 ,	mpCachedFragment( NULL )
+,	mPendingInvalidation( false )
 {
 	memset( mpCacheHashTable, 0, sizeof(mpCacheHashTable) );
+	memset( mPendingPages, 0, sizeof(mPendingPages) );
+	memset( mPageInvalidations, 0, sizeof(mPageInvalidations) );
 
 	mFragments.reserve( 2000 );
 
@@ -103,11 +107,11 @@ CFragment * CFragmentCache::LookupFragment( u32 address ) const
 
 			// put in hash table
 			mpCacheHashTable[ix].addr = address;
-			mpCacheHashTable[ix].ptr = reinterpret_cast< u32 >( mpCachedFragment );
+			mpCacheHashTable[ix].ptr = mpCachedFragment;
 		}
 		else
 		{
-			mpCachedFragment = reinterpret_cast< CFragment * >( mpCacheHashTable[ix].ptr );
+			mpCachedFragment = mpCacheHashTable[ix].ptr;
 		}
 	}
 
@@ -154,14 +158,14 @@ CFragment * CFragmentCache::LookupFragmentQ( u32 address ) const
 
 			// put in hash table
 			mpCacheHashTable[ix].addr = address;
-			mpCacheHashTable[ix].ptr = reinterpret_cast< u32 >( mpCachedFragment );
+			mpCacheHashTable[ix].ptr = mpCachedFragment;
 		}
 		else
 		{
 #ifdef HASH_TABLE_STATS
 			hit++;
 #endif
-			mpCachedFragment = reinterpret_cast< CFragment * >( mpCacheHashTable[ix].ptr );
+			mpCachedFragment = mpCacheHashTable[ix].ptr;
 		}
 
 #ifdef HASH_TABLE_STATS
@@ -183,7 +187,7 @@ void CFragmentCache::InsertFragment( CFragment * p_fragment )
 {
 	u32		fragment_address( p_fragment->GetEntryAddress() );
 
-	mCacheCoverage.ExtendCoverage( fragment_address, p_fragment->GetInputLength() );
+	mCacheCoverage.AddFragment( p_fragment );
 
 	SFragmentEntry				entry( fragment_address, NULL );
 	FragmentVec::iterator		it( std::lower_bound( mFragments.begin(), mFragments.end(), entry ) );
@@ -196,7 +200,7 @@ void CFragmentCache::InsertFragment( CFragment * p_fragment )
 	// Update the hash table (it stores failed lookups now, so we need to be sure to purge any stale entries in there
 	u32 ix {MakeHashIdx( fragment_address )};
 	mpCacheHashTable[ix].addr = fragment_address;
-	mpCacheHashTable[ix].ptr = reinterpret_cast< u32 >( p_fragment );
+	mpCacheHashTable[ix].ptr = p_fragment;
 
 	// Process any jumps for this before inserting new ones
 	JumpMap::iterator	jump_it( mJumpMap.find( fragment_address ) );
@@ -206,10 +210,12 @@ void CFragmentCache::InsertFragment( CFragment * p_fragment )
 		for( JumpList::const_iterator it = jumps.begin(); it != jumps.end(); ++it )
 		{
 			//DBGConsole_Msg( 0, "Inserting [R%08x], patching jump at %08x ", address, (*it) );
-			PatchJumpLongAndFlush( (*it), p_fragment->GetEntryTarget() );
+			PatchJumpLongAndFlush( it->Jump, p_fragment->GetEntryTarget() );
 		}
 
-		// All patched - clear
+		// All patched - remember the links so they can be undone if this fragment is retired
+		JumpList &	links( mLinkMap[ fragment_address ] );
+		links.insert( links.end(), jumps.begin(), jumps.end() );
 		mJumpMap.erase( jump_it );
 	}
 
@@ -225,13 +231,16 @@ void CFragmentCache::InsertFragment( CFragment * p_fragment )
 		#endif
 
 #ifdef DAEDALUS_DEBUG_DYNAREC
-		CFragment * p_fragment( LookupFragment( target_address ) );
+		CFragment * p_target_fragment( LookupFragment( target_address ) );
 #else
-		CFragment * p_fragment( LookupFragmentQ( target_address ) );
+		CFragment * p_target_fragment( LookupFragmentQ( target_address ) );
 #endif
-		if( p_fragment != NULL )
+		if( p_target_fragment != NULL )
 		{
-			PatchJumpLongAndFlush( jump, p_fragment->GetEntryTarget() );
+			SFragmentLink	link( p_fragment, jump, GetJumpTarget( jump ) );
+
+			PatchJumpLongAndFlush( jump, p_target_fragment->GetEntryTarget() );
+			mLinkMap[ target_address ].push_back( link );
 
 	#ifdef DAEDALUS_ENABLE_ASSERTS
 			DAEDALUS_ASSERT( mJumpMap.find( target_address ) == mJumpMap.end(), "Jump map still contains an entry for this" );
@@ -240,7 +249,7 @@ void CFragmentCache::InsertFragment( CFragment * p_fragment )
 		else if( target_address != u32(~0) )
 		{
 			// Store the address for later processing
-			mJumpMap[ target_address ].push_back( jump );
+			mJumpMap[ target_address ].push_back( SFragmentLink( p_fragment, jump, GetJumpTarget( jump ) ) );
 		}
 	}
 
@@ -287,6 +296,7 @@ void CFragmentCache::Clear()
 	}
 
 	mFragments.erase( mFragments.begin(), mFragments.end() );
+	mClearCount++;
 	mMemoryUsage = 0;
 	mInputLength = 0;
 	mOutputLength = 0;
@@ -294,8 +304,11 @@ void CFragmentCache::Clear()
 	mpCachedFragment = NULL;
 	memset( mpCacheHashTable, 0, sizeof(mpCacheHashTable) );
 	mJumpMap.clear();
+	mLinkMap.clear();
 
 	mCacheCoverage.Reset();
+	mPendingInvalidation = false;
+	memset( mPendingPages, 0, sizeof(mPendingPages) );
 
 	mpCodeBufferManager->Reset();
 }
@@ -308,6 +321,181 @@ bool CFragmentCache::ShouldInvalidateOnWrite( u32 address, u32 length ) const
 	return mCacheCoverage.IsCovered( address, length );
 }
 
+//*************************************************************************************
+//	Called when memory is written (DMA, CACHE ops). This can happen while a
+//	fragment is executing, so we just note the pages here.
+//*************************************************************************************
+void CFragmentCache::InvalidateRange( u32 address, u32 length )
+{
+	u32		first_page, last_page;
+
+	if( length == 0 ||
+		!CFragmentCacheCoverage::AddressToPage( address, &first_page ) ||
+		!CFragmentCacheCoverage::AddressToPage( address + length - 1, &last_page ) )
+	{
+		return;
+	}
+
+	for( u32 page = first_page; page <= last_page; ++page )
+	{
+		if( !mCacheCoverage.GetFragments( page ).empty() )
+		{
+			mPendingPages[ page >> 5 ] |= 1 << (page & 31);
+			mPendingInvalidation = true;
+		}
+	}
+}
+
+//*************************************************************************************
+//	Retire all the fragments which were compiled from the pending pages.
+//	Returns the number of fragments retired.
+//*************************************************************************************
+u32 CFragmentCache::ProcessInvalidations()
+{
+	if( !mPendingInvalidation )
+		return 0;
+
+	std::vector< CFragment * >	retired;
+
+	for( u32 i = 0; i < ARRAYSIZE( mPendingPages ); ++i )
+	{
+		u32		bits( mPendingPages[ i ] );
+		while( bits != 0 )
+		{
+			u32		bit( 0 );
+			while( (bits & (1 << bit)) == 0 )
+			{
+				++bit;
+			}
+			bits &= ~(1 << bit);
+
+			u32		page( (i << 5) + bit );
+			const std::vector< CFragment * > &	fragments( mCacheCoverage.GetFragments( page ) );
+
+			mPageInvalidations[ page ]++;
+#ifdef DAEDALUS_DEBUG_CONSOLE
+			DBGConsole_Msg( 0, "Dynarec: page %08x invalidated (%d times), retiring %d fragments",
+				page << CFragmentCacheCoverage::MEM_USAGE_SHIFT, mPageInvalidations[ page ], fragments.size() );
+#endif
+			retired.insert( retired.end(), fragments.begin(), fragments.end() );
+		}
+		mPendingPages[ i ] = 0;
+	}
+	mPendingInvalidation = false;
+
+	// A fragment can span several pages
+	std::sort( retired.begin(), retired.end() );
+	retired.erase( std::unique( retired.begin(), retired.end() ), retired.end() );
+
+	RetireFragments( retired );
+
+	return retired.size();
+}
+
+//*************************************************************************************
+//	Unlink the fragments from the cache, revert any jumps other fragments have
+//	made into them and release their code.
+//	fragments must be sorted.
+//*************************************************************************************
+void CFragmentCache::RetireFragments( const std::vector< CFragment * > & fragments )
+{
+	if( fragments.empty() )
+		return;
+
+	// Drop any exits owned by the retired fragments
+	JumpMap *	maps[] = { &mJumpMap, &mLinkMap };
+	for( u32 m = 0; m < ARRAYSIZE( maps ); ++m )
+	{
+		JumpMap &	jump_map( *maps[ m ] );
+		for( JumpMap::iterator it = jump_map.begin(); it != jump_map.end(); )
+		{
+			JumpList &	jumps( it->second );
+			for( u32 j = 0; j < jumps.size(); )
+			{
+				if( std::binary_search( fragments.begin(), fragments.end(), jumps[ j ].Fragment ) )
+				{
+					jumps[ j ] = jumps.back();
+					jumps.pop_back();
+				}
+				else
+				{
+					++j;
+				}
+			}
+
+			if( jumps.empty() )
+			{
+				jump_map.erase( it++ );
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	for( std::vector< CFragment * >::const_iterator it = fragments.begin(); it != fragments.end(); ++it )
+	{
+		CFragment *	p_fragment( *it );
+		u32			fragment_address( p_fragment->GetEntryAddress() );
+
+		// Point any jumps into this fragment back at their exit stubs, and wait for it to be recompiled
+		JumpMap::iterator	link_it( mLinkMap.find( fragment_address ) );
+		if( link_it != mLinkMap.end() )
+		{
+			JumpList &	jumps( link_it->second );
+			for( JumpList::const_iterator jit = jumps.begin(); jit != jumps.end(); ++jit )
+			{
+				PatchJumpLongAndFlush( jit->Jump, jit->Unlinked );
+			}
+
+			JumpList &	pending( mJumpMap[ fragment_address ] );
+			pending.insert( pending.end(), jumps.begin(), jumps.end() );
+			mLinkMap.erase( link_it );
+		}
+
+		SFragmentEntry				entry( fragment_address, NULL );
+		FragmentVec::iterator		fit( std::lower_bound( mFragments.begin(), mFragments.end(), entry ) );
+		if( fit != mFragments.end() && fit->Fragment == p_fragment )
+		{
+			mFragments.erase( fit );
+		}
+
+		u32 ix {MakeHashIdx( fragment_address )};
+		if( mpCacheHashTable[ix].addr == fragment_address )
+		{
+			mpCacheHashTable[ix].addr = 0;
+			mpCacheHashTable[ix].ptr = NULL;
+		}
+
+		mCacheCoverage.RemoveFragment( p_fragment );
+
+		mMemoryUsage -= p_fragment->GetMemoryUsage();
+		mInputLength -= p_fragment->GetInputLength();
+		mOutputLength -= p_fragment->GetOutputLength();
+
+		mpCodeBufferManager->ReleaseBlock( p_fragment->GetEntryTarget(), p_fragment->GetFunctionLength() );
+
+		delete p_fragment;
+	}
+
+	mCachedFragmentAddress = 0;
+	mpCachedFragment = NULL;
+}
+
+//*************************************************************************************
+//
+//*************************************************************************************
+u32 CFragmentCache::GetPageInvalidationCount( u32 address ) const
+{
+	u32		page;
+	if( CFragmentCacheCoverage::AddressToPage( address, &page ) )
+	{
+		return mPageInvalidations[ page ];
+	}
+	return 0;
+}
+
 #ifdef DAEDALUS_DEBUG_DYNAREC
 //*************************************************************************************
 //
@@ -396,6 +584,18 @@ void CFragmentCache::DumpStats( const char * outputdir ) const
 			}
 		}
 
+		fputs( "</table></div>\n", fh );
+
+		fputs( "<h1>Invalidated Pages</h1>\n", fh );
+		fputs( "<div align=\"center\"><table>\n", fh );
+		fputs( "<tr><th>Page</th><th>Invalidations</th></tr>\n", fh );
+		for( u32 i = 0; i < ARRAYSIZE( mPageInvalidations ); ++i )
+		{
+			if( mPageInvalidations[ i ] == 0 )
+				continue;
+
+			fprintf( fh, "<tr><td>0x%08x</td><td>%d</td></tr>\n", 0x80000000 | (i << CFragmentCacheCoverage::MEM_USAGE_SHIFT), mPageInvalidations[ i ] );
+		}
 		fputs( "</table></div>\n", fh );
 		fputs( "</body></html>\n", fh );
 
@@ -408,41 +608,68 @@ void CFragmentCache::DumpStats( const char * outputdir ) const
 //*************************************************************************************
 //
 //*************************************************************************************
-#define AddressToIndex( addr ) ((addr - BASE_ADDRESS) >> MEM_USAGE_SHIFT)
+bool CFragmentCacheCoverage::AddressToPage( u32 address, u32 * p_page )
+{
+	// Only KSEG0/KSEG1 are tracked
+	if( (address & 0xC0000000) != 0x80000000 )
+		return false;
+
+	u32		page( (address & 0x1FFFFFFF) >> MEM_USAGE_SHIFT );
+	if( page >= NUM_MEM_USAGE_ENTRIES )
+		return false;
+
+	*p_page = page;
+	return true;
+}
 
 //*************************************************************************************
 //
 //*************************************************************************************
-void CFragmentCacheCoverage::ExtendCoverage( u32 address, u32 len )
+void CFragmentCacheCoverage::AddFragment( CFragment * p_fragment )
 {
-	u32 first_entry( AddressToIndex( address ) );
-	u32 last_entry( AddressToIndex( address + len ) );
+	const std::vector< u32 > &	pages( p_fragment->GetPages() );
 
-	// Mark all entries as true
-	for( u32 i = first_entry; i <= last_entry && i < NUM_MEM_USAGE_ENTRIES; ++i )
+	for( std::vector< u32 >::const_iterator it = pages.begin(); it != pages.end(); ++it )
 	{
-		mCacheCoverage[ i ] = true;
+		u32		page;
+		if( AddressToPage( *it << MEM_USAGE_SHIFT, &page ) )
+		{
+			mPageFragments[ page ].push_back( p_fragment );
+		}
 	}
 }
 
 //*************************************************************************************
 //
 //*************************************************************************************
-bool CFragmentCacheCoverage::IsCovered( u32 address, u32 len ) const
+void CFragmentCacheCoverage::RemoveFragment( CFragment * p_fragment )
 {
-	if((address - BASE_ADDRESS) == 0)
+	const std::vector< u32 > &	pages( p_fragment->GetPages() );
+
+	for( std::vector< u32 >::const_iterator it = pages.begin(); it != pages.end(); ++it )
 	{
-		DBGConsole_Msg( 0, "Cache coverage address is overlapping" );
-		return true;
+		u32		page;
+		if( AddressToPage( *it << MEM_USAGE_SHIFT, &page ) )
+		{
+			std::vector< CFragment * > &	fragments( mPageFragments[ page ] );
+			fragments.erase( std::remove( fragments.begin(), fragments.end(), p_fragment ), fragments.end() );
+		}
 	}
+}
 
-	u32 first_entry( AddressToIndex( address ) );
-	u32 last_entry( AddressToIndex( address + len ) );
+//*************************************************************************************
+//
+//*************************************************************************************
+bool CFragmentCacheCoverage::IsCovered( u32 address, u32 len ) const
+{
+	u32		first_page, last_page;
 
-	// Mark all entries as true
-	for( u32 i = first_entry; i <= last_entry && i < NUM_MEM_USAGE_ENTRIES; ++i )
+	if( len == 0 || !AddressToPage( address, &first_page ) || !AddressToPage( address + len - 1, &last_page ) )
+		return false;
+
+	for( u32 i = first_page; i <= last_page; ++i )
 	{
-		if( mCacheCoverage[ i ] )
+		if( !mPageFragments[ i ].empty() )
 			return true;
 	}
 
@@ -454,5 +681,8 @@ bool CFragmentCacheCoverage::IsCovered( u32 address, u32 len ) const
 //*************************************************************************************
 void CFragmentCacheCoverage::Reset( )
 {
-	memset( mCacheCoverage, 0, sizeof( mCacheCoverage ) );
+	for( u32 i = 0; i < NUM_MEM_USAGE_ENTRIES; ++i )
+	{
+		mPageFragments[ i ].clear();
+	}
 }
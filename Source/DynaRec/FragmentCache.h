@@ -21,9 +21,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define DYNAREC_FRAGMENTCACHE_H_
 
 #include "Utility/DaedalusTypes.h"
+#include "AssemblyUtils.h"
 
 class	CFragment;
-class	CJumpLocation;
 class	CCodeBufferManager;
 
 #include <map>
@@ -31,8 +31,8 @@ class	CCodeBufferManager;
 
 struct FHashT
 {
-	u32	addr;
-	u32 ptr;
+	u32			addr;
+	CFragment *	ptr;
 };
 
 //*************************************************************************************
@@ -43,22 +43,23 @@ class CFragmentCacheCoverage
 public:
 	CFragmentCacheCoverage() { Reset(); }
 
-	void			ExtendCoverage( u32 address, u32 len );
+	void			AddFragment( CFragment * p_fragment );
+	void			RemoveFragment( CFragment * p_fragment );
 	bool			IsCovered( u32 address, u32 len ) const;
 
-	void			Reset();
-
-private:
-	static u32		AddressToIndex( u32 address );
+	// Pages are indexed on their physical address, so KSEG0 and KSEG1 aliases share an entry
+	static bool		AddressToPage( u32 address, u32 * p_page );
+	const std::vector< CFragment * > &	GetFragments( u32 page ) const	{ return mPageFragments[ page ]; }
 
-private:
-	static const u32 BASE_ADDRESS = 0x80000000;
+	void			Reset();
 
+public:
 	static const u32 MEMORY_8_MEG = 8*1024*1024;
 	static const u32 MEM_USAGE_SHIFT = 12;		// 4k
 	static const u32 NUM_MEM_USAGE_ENTRIES = MEMORY_8_MEG >> MEM_USAGE_SHIFT;
 
-	bool			mCacheCoverage[ NUM_MEM_USAGE_ENTRIES ];
+private:
+	std::vector< CFragment * >	mPageFragments[ NUM_MEM_USAGE_ENTRIES ];
 };
 
 //*************************************************************************************
@@ -78,6 +79,7 @@ public:
 
 	u32						GetCacheSize() const					{ return mFragments.size(); }
 	void					Clear();
+	u32						GetClearCount() const					{ return mClearCount; }
 
 #ifdef DAEDALUS_DEBUG_DYNAREC
 	void					DumpStats( const char * outputdir ) const;
@@ -89,6 +91,13 @@ public:
 
 	bool					ShouldInvalidateOnWrite( u32 address, u32 length ) const;
 
+	// Invalidation is deferred until ProcessInvalidations() is called from a safe point
+	void					InvalidateRange( u32 address, u32 length );
+	bool					HasPendingInvalidations() const			{ return mPendingInvalidation; }
+	u32						ProcessInvalidations();
+
+	u32						GetPageInvalidationCount( u32 address ) const;
+
 private:
 	struct SFragmentEntry
 	{
@@ -113,10 +122,28 @@ private:
 	u32						mMemoryUsage;
 	u32						mInputLength;
 	u32						mOutputLength;
+	u32						mClearCount;
 
-	typedef std::vector< CJumpLocation >	JumpList;
+	struct SFragmentLink
+	{
+		SFragmentLink( CFragment * fragment, CJumpLocation jump, CCodeLabel unlinked )
+			:	Fragment( fragment )
+			,	Jump( jump )
+			,	Unlinked( unlinked )
+		{
+		}
+
+		CFragment *		Fragment;		// The fragment which owns the jump
+		CJumpLocation	Jump;
+		CCodeLabel		Unlinked;		// Where the jump went before it was patched (the exit stub)
+	};
+
+	typedef std::vector< SFragmentLink >	JumpList;
 	typedef std::map< u32, JumpList >		JumpMap;
-	JumpMap					mJumpMap;
+	JumpMap					mJumpMap;			// Exits waiting for a fragment at the target address
+	JumpMap					mLinkMap;			// Exits which have been patched to jump to the fragment at the target address
+
+	void					RetireFragments( const std::vector< CFragment * > & fragments );
 
 	mutable u32				mCachedFragmentAddress;
 	mutable CFragment *		mpCachedFragment;
@@ -133,6 +160,10 @@ private:
 	CCodeBufferManager *	mpCodeBufferManager;
 
 	CFragmentCacheCoverage	mCacheCoverage;
+
+	bool					mPendingInvalidation;
+	u32						mPendingPages[ CFragmentCacheCoverage::NUM_MEM_USAGE_ENTRIES / 32 ];
+	u32						mPageInvalidations[ CFragmentCacheCoverage::NUM_MEM_USAGE_ENTRIES ];
 };
 
 extern CFragmentCache				gFragmentCache;
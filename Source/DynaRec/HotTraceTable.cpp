@@ -0,0 +1,182 @@
+/*
+Copyright (C) 2006 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#include "stdafx.h"
+#include "HotTraceTable.h"
+
+#include <string.h>
+
+#include <vector>
+
+#include "Debug/DBGConsole.h"
+
+//*************************************************************************************
+//
+//*************************************************************************************
+CHotTraceTable::CHotTraceTable( u32 max_entries )
+:	mpEntries( NULL )
+,	mMask( 0 )
+,	mShift( 32 )
+,	mSize( 0 )
+,	mMaxEntries( max_entries )
+,	mAgeCount( 0 )
+{
+	// Keep the load factor under 50% so probe sequences stay short
+	u32		capacity( 1 );
+	while( capacity < max_entries * 2 )
+	{
+		capacity <<= 1;
+		mShift--;
+	}
+
+	mpEntries = new SEntry[ capacity ];
+	mMask = capacity - 1;
+
+	Clear();
+}
+
+//*************************************************************************************
+//
+//*************************************************************************************
+CHotTraceTable::~CHotTraceTable()
+{
+	delete [] mpEntries;
+}
+
+//*************************************************************************************
+//
+//*************************************************************************************
+void CHotTraceTable::Clear()
+{
+	memset( mpEntries, 0, GetCapacity() * sizeof( SEntry ) );
+	mSize = 0;
+}
+
+//*************************************************************************************
+//
+//*************************************************************************************
+u32 CHotTraceTable::GetCount( u32 address ) const
+{
+	u32		i( Hash( address ) );
+	while( mpEntries[ i ].Count != 0 )
+	{
+		if( mpEntries[ i ].Address == address )
+			return mpEntries[ i ].Count;
+
+		i = (i + 1) & mMask;
+	}
+	return 0;
+}
+
+//*************************************************************************************
+//
+//*************************************************************************************
+void CHotTraceTable::Insert( u32 address, u32 count )
+{
+	u32		i( Hash( address ) );
+	while( mpEntries[ i ].Count != 0 )
+	{
+		i = (i + 1) & mMask;
+	}
+
+	mpEntries[ i ].Address = address;
+	mpEntries[ i ].Count = count;
+	mSize++;
+}
+
+//*************************************************************************************
+//	Remove an entry, shifting back any entries further along the probe
+//	sequence so we don't need tombstones
+//*************************************************************************************
+void CHotTraceTable::Erase( u32 address )
+{
+	u32		i( Hash( address ) );
+	while( mpEntries[ i ].Address != address )
+	{
+		if( mpEntries[ i ].Count == 0 )
+			return;
+
+		i = (i + 1) & mMask;
+	}
+
+	if( mpEntries[ i ].Count == 0 )
+		return;
+
+	u32		j( i );
+	for( ;; )
+	{
+		mpEntries[ i ].Count = 0;
+
+		u32		home;
+		do
+		{
+			j = (j + 1) & mMask;
+			if( mpEntries[ j ].Count == 0 )
+			{
+				mSize--;
+				return;
+			}
+
+			home = Hash( mpEntries[ j ].Address );
+		}
+		// Skip entries whose home slot lies cyclically in (i, j]
+		while( i <= j ? (i < home && home <= j) : (i < home || home <= j) );
+
+		mpEntries[ i ] = mpEntries[ j ];
+		i = j;
+	}
+}
+
+//*************************************************************************************
+//	Halve all the counts, dropping anything that reaches zero. Addresses which
+//	were only seen once or twice (most of them) go, while hot loops which
+//	haven't yet reached the threshold are remembered.
+//*************************************************************************************
+void CHotTraceTable::Age()
+{
+	std::vector< SEntry >	survivors;
+	survivors.reserve( mSize );
+
+	do
+	{
+		survivors.clear();
+		for( u32 i = 0; i < GetCapacity(); ++i )
+		{
+			SEntry	entry( mpEntries[ i ] );
+			entry.Count >>= 1;
+			if( entry.Count != 0 )
+			{
+				survivors.push_back( entry );
+			}
+		}
+
+		Clear();
+		for( u32 i = 0; i < survivors.size(); ++i )
+		{
+			Insert( survivors[ i ].Address, survivors[ i ].Count );
+		}
+	}
+	while( mSize > mMaxEntries / 2 );
+
+	mAgeCount++;
+
+	#ifdef DAEDALUS_DEBUG_CONSOLE
+	DBGConsole_Msg( 0, "Hot trace table full, aged to %d entries", mSize );
+	#endif
+}
@@ -0,0 +1,97 @@
+/*
+Copyright (C) 2006 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#pragma once
+
+#ifndef DYNAREC_HOTTRACETABLE_H_
+#define DYNAREC_HOTTRACETABLE_H_
+
+#include "Utility/DaedalusTypes.h"
+
+//*************************************************************************************
+//	Counts how many times the interpreter has branched to each address.
+//	Open addressed with linear probing, so a lookup usually touches a single
+//	cache line. When the table fills up the counts are halved and addresses
+//	which drop to zero are evicted, rather than forgetting everything.
+//*************************************************************************************
+class CHotTraceTable
+{
+public:
+	struct SEntry
+	{
+		u32		Address;
+		u32		Count;			// 0 means the slot is empty
+	};
+
+	explicit CHotTraceTable( u32 max_entries );
+	~CHotTraceTable();
+
+	// Returns the updated count for the address
+	inline u32		Increment( u32 address )
+	{
+		u32		i( Hash( address ) );
+		while( mpEntries[ i ].Count != 0 )
+		{
+			if( mpEntries[ i ].Address == address )
+			{
+				return ++mpEntries[ i ].Count;
+			}
+			i = (i + 1) & mMask;
+		}
+
+		mpEntries[ i ].Address = address;
+		mpEntries[ i ].Count = 1;
+		if( ++mSize >= mMaxEntries )
+		{
+			Age();
+		}
+		return 1;
+	}
+
+	u32				GetCount( u32 address ) const;
+	void			Erase( u32 address );
+	void			Clear();
+	void			Age();
+
+	u32				GetSize() const					{ return mSize; }
+	u32				GetAgeCount() const				{ return mAgeCount; }
+
+	// For dumping stats. Empty slots have a Count of zero
+	u32				GetCapacity() const				{ return mMask + 1; }
+	const SEntry &	GetEntry( u32 i ) const			{ return mpEntries[ i ]; }
+
+private:
+	inline u32		Hash( u32 address ) const
+	{
+		// Instructions are word aligned, so drop the bottom two bits
+		return ((address >> 2) * 0x9E3779B1) >> mShift;
+	}
+
+	void			Insert( u32 address, u32 count );
+
+private:
+	SEntry *		mpEntries;
+	u32				mMask;
+	u32				mShift;
+	u32				mSize;
+	u32				mMaxEntries;
+	u32				mAgeCount;
+};
+
+#endif // DYNAREC_HOTTRACETABLE_H_
@@ -0,0 +1,88 @@
+// Microbenchmark for the hot trace counter used by CPU_HandleDynaRecOnBranch.
+// Compares the old std::map (cleared when full) against CHotTraceTable.
+
+#include "stdafx.h"
+#include "DynaRec/HotTraceTable.h"
+
+#include <stdio.h>
+
+#include <chrono>
+#include <map>
+#include <vector>
+
+static const u32	kMaxEntries = 2048 + 1024;		// gMaxHotTraceMapSize on non-PSP builds
+static const u32	kThreshold = 10;				// gHotTraceThreshold
+static const u32	kNumBranches = 20000000;
+
+// A handful of hot loops plus a long tail of addresses that are only branched to a few times,
+// which is roughly what the interpreter sees before the dynarec warms up.
+static void MakeBranchStream( std::vector< u32 > & stream )
+{
+	u32		seed( 0x12345678 );
+	stream.resize( kNumBranches );
+	for( u32 i = 0; i < kNumBranches; ++i )
+	{
+		seed = seed * 1664525 + 1013904223;
+		u32		r( seed >> 8 );
+		if( (r & 3) != 0 )
+		{
+			stream[ i ] = 0x80000000 + ((r % 256) << 6);					// Hot
+		}
+		else
+		{
+			stream[ i ] = 0x80100000 + ((r % (256 * 1024)) << 2);			// Cold
+		}
+	}
+}
+
+template< typename T > static double Time( T fn )
+{
+	std::chrono::high_resolution_clock::time_point	start( std::chrono::high_resolution_clock::now() );
+	fn();
+	std::chrono::high_resolution_clock::time_point	end( std::chrono::high_resolution_clock::now() );
+	return std::chrono::duration< double, std::milli >( end - start ).count();
+}
+
+int main()
+{
+	std::vector< u32 >	stream;
+	MakeBranchStream( stream );
+
+	u32		map_hot( 0 ), map_clears( 0 );
+	double	map_ms( Time( [&]()
+	{
+		std::map< u32, u32 >	counts;
+		for( u32 i = 0; i < kNumBranches; ++i )
+		{
+			u32 count( ++counts[ stream[ i ] ] );
+			if( counts.size() >= kMaxEntries )
+			{
+				counts.clear();
+				map_clears++;
+			}
+			else if( count == kThreshold )
+			{
+				map_hot++;
+			}
+		}
+	} ) );
+
+	u32		table_hot( 0 ), table_ages( 0 );
+	double	table_ms( Time( [&]()
+	{
+		CHotTraceTable	counts( kMaxEntries );
+		for( u32 i = 0; i < kNumBranches; ++i )
+		{
+			if( counts.Increment( stream[ i ] ) == kThreshold )
+			{
+				table_hot++;
+			}
+		}
+		table_ages = counts.GetAgeCount();
+	} ) );
+
+	printf( "%u branches, %u entry limit\n", kNumBranches, kMaxEntries );
+	printf( "std::map:       %8.2fms (%5.2fns/branch), %u traces hot, %u clears\n", map_ms, map_ms * 1e6 / kNumBranches, map_hot, map_clears );
+	printf( "CHotTraceTable: %8.2fms (%5.2fns/branch), %u traces hot, %u ages\n", table_ms, table_ms * 1e6 / kNumBranches, table_hot, table_ages );
+	return 0;
+}
@@ -297,6 +297,13 @@ CFragment *		CTraceRecorder::CreateFragment( CCodeBufferManager * p_manager )
 	CFragment *	p_frament( new CFragment( p_manager, mStartTraceAddress, mExpectedExitTraceAddress,
 		mTraceBuffer, register_usage, mBranchDetails, mNeedIndirectExitMap ) );
 
+	// The code buffer was full. It'll be flushed before the next trace.
+	if( !p_frament->GetEntryTarget().IsSet() )
+	{
+		delete p_frament;
+		p_frament = NULL;
+	}
+
 	//DBGConsole_Msg( 0, "Inserting hot trace for [R%08x]!", mStartTraceAddress );
 
 	mTracing = false;
@@ -80,7 +80,13 @@ class CNativeTexture : public CRefCounted
 		void *				mpPalette;
 
 #ifdef DAEDALUS_GL
-		GLuint				mTextureId;
+		GLuint				mTextureId;		// Written by the render thread, if there is one (see SysGL/HLEGraphics/RenderThreadGL.h)
+		bool				mTextureQueued;	// The render thread has been asked to create mTextureId
+
+		void				UploadGL( const void * data, const void * palette ) const;
+
+		static void			CreateTextureGL( const void * p_data );
+		static void			UploadTextureGL( const void * p_data );
 #endif
 
 #ifdef DAEDALUS_PSP
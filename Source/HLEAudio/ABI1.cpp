@@ -28,6 +28,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "audiohle.h"
 #include "AudioHLEProcessor.h"
+#include "AudioHLETask.h"
 
 #include "Math/MathUtil.h"
 
@@ -257,3 +258,46 @@ AudioHLEInstruction ABI1[0x20] =
     SPNOOP , SPNOOP, SPNOOP   , SPNOOP    , SPNOOP  , SPNOOP    , SPNOOP  , SPNOOP,
     SPNOOP , SPNOOP, SPNOOP   , SPNOOP    , SPNOOP  , SPNOOP    , SPNOOP  , SPNOOP
 };
+
+// The RDRAM accesses of the commands above, for AudioHLETask
+bool ABI1_Scan( const u32 * p_alist, u32 num_commands, AudioHLEScan & scan )
+{
+	for( u32 i {}; i < num_commands; ++i )
+	{
+		AudioHLECommand command;
+		command.cmd0 = *p_alist++;
+		command.cmd1 = *p_alist++;
+
+		switch( command.cmd )
+		{
+		case 1:		// ADPCM
+			if( (command.Abi1ADPCM.Flags & 0x1) == 0 )
+				scan.Read( (command.Abi1ADPCM.Flags & 0x2) ? scan.LoopVal : command.Abi1ADPCM.Address, 32 );
+			scan.Write( command.Abi1ADPCM.Address, 32 );
+			break;
+		case 3:		// ENVMIXER
+			scan.Write( command.Abi1EnvMixer.Address, 40 );
+			break;
+		case 4:		// LOADBUFF
+			scan.Read( command.Abi1LoadBuffer.Address & 0xfffffc, scan.Count );
+			break;
+		case 5:		// RESAMPLE
+			scan.Write( command.Abi1Resample.Address, 12 );
+			break;
+		case 6:		// SAVEBUFF
+			scan.Write( command.Abi1SaveBuffer.Address & 0xfffffc, scan.Count );
+			break;
+		case 8:		// SETBUFF
+			if( (command.Abi1SetBuffer.Flags & 0x8) == 0 )
+				scan.Count = command.Abi1SetBuffer.Count;
+			break;
+		case 11:	// LOADADPCM
+			scan.Read( command.Abi1LoadADPCM.Address, command.Abi1LoadADPCM.Count & ~15 );
+			break;
+		case 15:	// SETLOOP
+			scan.LoopVal = command.Abi1SetLoop.LoopVal;
+			break;
+		}
+	}
+	return true;
+}
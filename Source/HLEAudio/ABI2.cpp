@@ -30,6 +30,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "audiohle.h"
 #include "AudioHLEProcessor.h"
+#include "AudioHLETask.h"
 
 #include "Math/MathUtil.h"
 
@@ -540,19 +541,21 @@ static void HILOGAIN( AudioHLECommand command )
 
 static void FILTER2( AudioHLECommand command )
 {
-	static int cnt {};
-	static s16 *lutt6 {};
-	static s16 *lutt5 {};
+	s16 *lutt5 {};
 	u8 *save {(rdram+(command.cmd1&0xFFFFFF))};
 	u8 t4 {(u8)((command.cmd0 >> 0x10) & 0xFF)};
 
 	if (t4 > 1) { // Then set the cnt variable
-		cnt = (command.cmd0 & 0xFFFF);
-		lutt6 = (s16 *)save;
+		gAudioHLEState.FilterCount = (command.cmd0 & 0xFFFF);
+		gAudioHLEState.FilterLut = command.cmd1&0xFFFFFF;
 //				memcpy (dmem+0xFE0, rdram+(command.cmd1&0xFFFFFF), 0x10);
 		return;
 	}
 
+	// Kept as an address rather than a pointer, as the RDRAM can move between tasks (see AudioHLETask.cpp)
+	int cnt {gAudioHLEState.FilterCount};
+	s16 *lutt6 {(s16 *)(rdram+gAudioHLEState.FilterLut)};
+
 	if (t4 == 0) {
 //				memcpy (dmem+0xFB0, rdram+(command.cmd1&0xFFFFFF), 0x20);
 		lutt5 = (short *)(save+0x10);
@@ -696,3 +699,64 @@ AudioHLEInstruction ABI2[0x20] =
   FILTER/SEGMENT - Still needs to be finished up... add FILTER?
   UNKNOWWN #27	 - Is this worth doing?  Looks like a pain in the ass just for WaveRace64
 */
+
+// The RDRAM accesses of the commands above, for AudioHLETask
+bool ABI2_Scan( const u32 * p_alist, u32 num_commands, AudioHLEScan & scan )
+{
+	bool	zelda_abi( isZeldaABI );
+	u32		filter_lut( gAudioHLEState.FilterLut );
+
+	for( u32 i {}; i < num_commands; ++i )
+	{
+		AudioHLECommand command;
+		command.cmd0 = *p_alist++;
+		command.cmd1 = *p_alist++;
+
+		switch( command.cmd )
+		{
+		case 1:		// ADPCM2
+			{
+				u8	flags( (command.cmd0 >> 16) & 0xff );
+				u32	address( command.cmd1 & 0xffffff );
+				if( (flags & 0x1) == 0 )
+					scan.Read( (flags & 0x2) ? scan.LoopVal : address, 32 );
+				scan.Write( address, 32 );
+			}
+			break;
+		case 5:		// RESAMPLE2
+			scan.Write( command.Abi2Resample.Address, 12 );
+			break;
+		case 7:		// SEGMENT2, which is FILTER2 in the Zelda ABI
+			if( zelda_abi || (command.cmd0 & 0xffffff) != 0 )
+			{
+				zelda_abi = true;
+				if( ((command.cmd0 >> 16) & 0xff) > 1 )
+				{
+					filter_lut = command.cmd1 & 0xffffff;
+				}
+				else
+				{
+					scan.Write( filter_lut, 16 );
+					scan.Write( command.cmd1 & 0xffffff, 32 );
+				}
+			}
+			break;
+		case 8:		// SETBUFF2
+			scan.Count = command.Abi2SetBuffer.Count;
+			break;
+		case 11:	// LOADADPCM2
+			scan.Read( command.Abi2LoadADPCM.Address, command.Abi2LoadADPCM.Count & ~15 );
+			break;
+		case 15:	// SETLOOP2
+			scan.LoopVal = command.Abi2SetLoop.LoopVal;
+			break;
+		case 20:	// LOADBUFF2
+			scan.Read( command.Abi2LoadBuffer.SrcAddr & 0xfffffc, command.Abi2LoadBuffer.Count );
+			break;
+		case 21:	// SAVEBUFF2
+			scan.Write( command.Abi2SaveBuffer.DstAddr & 0xfffffc, command.Abi2SaveBuffer.Count );
+			break;
+		}
+	}
+	return true;
+}
@@ -30,6 +30,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "audiohle.h"
 #include "AudioHLEProcessor.h"
+#include "AudioHLETask.h"
 
 #include "Debug/DBGConsole.h"
 
@@ -647,3 +648,50 @@ AudioHLEInstruction ABI3[0x20] =
     SPNOOP , SPNOOP, SPNOOP   , SPNOOP    , SPNOOP  , SPNOOP    , SPNOOP  , SPNOOP,
     SPNOOP , SPNOOP, SPNOOP   , SPNOOP    , SPNOOP  , SPNOOP    , SPNOOP  , SPNOOP
 };
+
+// The RDRAM accesses of the commands above, for AudioHLETask
+bool ABI3_Scan( const u32 * p_alist, u32 num_commands, AudioHLEScan & scan )
+{
+	for( u32 i {}; i < num_commands; ++i )
+	{
+		AudioHLECommand command;
+		command.cmd0 = *p_alist++;
+		command.cmd1 = *p_alist++;
+
+		switch( command.cmd )
+		{
+		case 1:		// ADPCM3
+			{
+				u8	flags( (command.cmd1 >> 0x1c) & 0xff );
+				u32	address( command.cmd0 & 0xffffff );
+				if( (flags & 0x1) == 0 )
+					scan.Read( (flags & 0x2) ? scan.LoopVal : address, 32 );
+				scan.Write( address, 32 );
+			}
+			break;
+		case 3:		// ENVMIXER3
+			scan.Write( command.cmd1 & 0xffffff, 48 );
+			break;
+		case 4:		// LOADBUFF3
+			scan.Read( command.cmd1 & 0xfffffc, ((command.cmd0 >> 0xC) + 3) & 0xFFC );
+			break;
+		case 5:		// RESAMPLE3
+			scan.Write( command.cmd0 & 0xffffff, 12 );
+			break;
+		case 6:		// SAVEBUFF3
+			scan.Write( command.cmd1 & 0xfffffc, ((command.cmd0 >> 0xC) + 3) & 0xFFC );
+			break;
+		case 7:		// MP3 - reads an 8 byte header and 3 blocks of 0x180, writing the output over them
+			scan.Read( command.cmd1 & 0xffffff, 8 + 3 * 0x180 );
+			scan.Write( command.cmd1 & 0xffffff, 3 * 0x180 );
+			break;
+		case 11:	// LOADADPCM3
+			scan.Read( command.Abi3LoadADPCM.Address, command.Abi3LoadADPCM.Count & ~15 );
+			break;
+		case 15:	// SETLOOP3
+			scan.LoopVal = command.Abi3SetLoop.LoopVal;
+			break;
+		}
+	}
+	return true;
+}
@@ -28,6 +28,16 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "SysPSP/Utility/CacheUtil.h"
 #endif
 
+// The writer publishes samples with a release store of mWritePtr, which the reader acquires before
+// reading them (and vice versa for mReadPtr). On the PSP these are plain volatiles.
+#ifdef DAEDALUS_PSP
+#define LOAD_PTR( p )			(p)
+#define STORE_PTR( p, v )		(p) = (v)
+#else
+#define LOAD_PTR( p )			(p).load( std::memory_order_acquire )
+#define STORE_PTR( p, v )		(p).store( (v), std::memory_order_release )
+#endif
+
 CAudioBuffer::CAudioBuffer( u32 buffer_size )
 	:	mBufferBegin( new Sample[ buffer_size ] )
 	,	mBufferEnd( mBufferBegin + buffer_size )
@@ -48,8 +58,10 @@ u32 CAudioBuffer::GetNumBufferedSamples() const
 	dcache_wbinv_all();
 #endif
 
-	// Safe? What if we read mWrite, and then mRead moves to start of buffer?
-	s32 diff {mWritePtr - mReadPtr};
+	// The reader may move on after we look at mReadPtr, so this can overestimate slightly
+	const Sample *	read_ptr( LOAD_PTR( mReadPtr ) );
+	const Sample *	write_ptr( LOAD_PTR( mWritePtr ) );
+	s32 diff {write_ptr - read_ptr};
 
 	if( diff < 0 )
 	{
@@ -71,8 +83,8 @@ void CAudioBuffer::AddSamples( const Sample * samples, u32 num_samples, u32 freq
 	//fwrite( samples, sizeof( Sample ), num_samples, fh );
 	//fflush( fh );
 
-	const Sample *	read_ptr( mReadPtr );		// No need to invalidate, as this is uncached/volatile
-	Sample *		write_ptr( mWritePtr );
+	const Sample *	read_ptr( LOAD_PTR( mReadPtr ) );		// No need to invalidate, as this is uncached/volatile
+	Sample *		write_ptr( LOAD_PTR( mWritePtr ) );
 
 	//
 	//	'r' is the number of input samples we progress through for each output sample.
@@ -121,24 +133,17 @@ void CAudioBuffer::AddSamples( const Sample * samples, u32 num_samples, u32 freq
 		s &= 4095;
 #endif
 
-		write_ptr++;
-		if( write_ptr >= mBufferEnd )
-			write_ptr = mBufferBegin;
-		/*
-		while( write_ptr == read_ptr )
-		{
-			// The buffer is full - spin until the read pointer advances.
-			//    Note - spends a lot of time here if program is running
-			//    fast. This loop locks the speed to the playback rate
-			//    as the program winds up waiting for the buffer to empty.
-			// ToDo: Adjust Audio Frequency/ Look at Turok in this regard.
-			// We might want to put a Sleep in when executing on the SC?
-			//Give time to other threads when using SYNC mode.
-			if ( gAudioPluginEnabled == APM_ENABLED_SYNC )	ThreadYield();
-
-			read_ptr = mReadPtr;
-		}
-*/
+		Sample * next_ptr( write_ptr + 1 );
+		if( next_ptr >= mBufferEnd )
+			next_ptr = mBufferBegin;
+
+#ifndef DAEDALUS_PSP
+		// The buffer is full. Drop the rest rather than block the emulation thread -
+		// in sync mode the framerate limiter keeps us from getting this far ahead.
+		if( next_ptr == read_ptr )
+			break;
+#endif
+		write_ptr = next_ptr;
 		*write_ptr = out;
 	}
 
@@ -146,7 +151,7 @@ void CAudioBuffer::AddSamples( const Sample * samples, u32 num_samples, u32 freq
 	// Ensure samples array is written back before mWritePtr
 	//dcache_wbinv_range_unaligned( mBufferBegin, mBufferEnd );
 
-	mWritePtr = write_ptr;		// Needs cache wbinv
+	STORE_PTR( mWritePtr, write_ptr );		// Needs cache wbinv on the PSP
 }
 
 #ifdef DAEDALUS_PSP
@@ -211,8 +216,8 @@ u32	CAudioBuffer::Drain( Sample * samples, u32 num_samples )
 	// Ideally we could just invalidate this range?
 	//dcache_wbinv_range_unaligned( mBufferBegin, mBufferEnd );
 
-	const Sample *	read_ptr( mReadPtr );		// No need to invalidate, as this is uncached/volatile
-	const Sample *	write_ptr( mWritePtr );		//
+	const Sample *	read_ptr( mReadPtr.load( std::memory_order_relaxed ) );
+	const Sample *	write_ptr( LOAD_PTR( mWritePtr ) );
 
 	Sample *	out_ptr( samples );
 	u32			samples_required( num_samples );
@@ -239,7 +244,7 @@ u32	CAudioBuffer::Drain( Sample * samples, u32 num_samples )
 	//fwrite( samples, sizeof( Sample ), (num_samples-samples_required), fh );
 	//fflush( fh );
 
-	mReadPtr = read_ptr;		// No need to invalidate, as this is uncached
+	STORE_PTR( mReadPtr, read_ptr );
 
 	//
 	//	If there weren't enough samples, zero out the buffer
@@ -24,6 +24,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "Utility/DaedalusTypes.h"
 
+#ifndef DAEDALUS_PSP
+#include <atomic>
+#endif
+
 struct Sample
 {
 	s16		L;
@@ -33,8 +37,11 @@ struct Sample
 // A utility class for buffering up samples, upsampling to the desired
 // output frequency and copying them to the desired output buffer.
 //
-// N.B. This class currently does no synchronisation - it's assumed that
-// the calling code will handle this
+// N.B. This class does no locking. It's safe for one thread to call AddSamples
+// while another calls Drain. Elsewhere the read and write pointers are atomics,
+// so the samples are published with release/acquire ordering, and AddSamples
+// drops samples rather than overwriting ones the reader hasn't got to yet.
+// On the PSP the ME reads them through uncached memory instead.
 class CAudioBuffer
 {
 public:
@@ -50,8 +57,13 @@ private:
 	Sample *		mBufferBegin;
 	Sample *		mBufferEnd;
 
+#ifdef DAEDALUS_PSP
 	const Sample * volatile	mReadPtr;
 	Sample * volatile		mWritePtr;
+#else
+	std::atomic< const Sample * >	mReadPtr;
+	std::atomic< Sample * >			mWritePtr;
+#endif
 };
 
 
@@ -0,0 +1,296 @@
+/*
+Copyright (C) 2003 Azimer
+Copyright (C) 2001,2006-2007 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+//
+//	N.B. This source code is derived from Azimer's Audio plugin (v0.55?)
+//	and modified by StrmnNrmn to work with Daedalus PSP. Thanks Azimer!
+//	Drop me a line if you get chance :)
+//
+
+#include "stdafx.h"
+#include "AudioHLEKernels.h"
+
+#include "Debug/DBGConsole.h"
+#include "Math/MathUtil.h"
+
+static void Mix_Scalar( s16 * out, const s16 * in, s32 gain, u32 num_samples )
+{
+	for( u32 x = num_samples; x != 0; x-- )
+	{
+		*out = Saturate<s16>( FixedPointMul15( *in++, gain ) + s32( *out ) );
+		out++;
+	}
+}
+
+static u32 Resample_Scalar( u32 * out, const s16 * in, u32 src_ptr, u32 & accumulator, u32 pitch, u32 num_words )
+{
+	u32 acc( accumulator );
+	u32 tmp {};
+
+	for( u32 i = num_words; i != 0 ; i-- )
+	{
+		tmp =  (in[src_ptr^1] + FixedPointMul16( in[(src_ptr+1)^1] - in[src_ptr^1], acc )) << 16;
+		acc += pitch;
+		src_ptr += acc >> 16;
+		acc &= 0xFFFF;
+
+		tmp |= (in[src_ptr^1] + FixedPointMul16( in[(src_ptr+1)^1] - in[src_ptr^1], acc )) & 0xFFFF;
+		acc += pitch;
+		src_ptr += acc >> 16;
+		acc &= 0xFFFF;
+
+		*out++ = tmp;
+	}
+
+	accumulator = acc;
+	return src_ptr;
+}
+
+//
+//	l1/l2 are IN/OUT
+//
+static inline void DecodeSamples( s16 * out, s32 & l1, s32 & l2, const s32 * input, const s16 * book1, const s16 * book2 )
+{
+	s32 a[8] {};
+
+	a[0] = (s32)book1[0]*l1;
+	a[0] += (s32)book2[0]*l2;
+	a[0] += input[0]*2048;
+
+	a[1] = (s32)book1[1]*l1;
+	a[1] += (s32)book2[1]*l2;
+	a[1] += (s32)book2[0]*input[0];
+	a[1] += input[1]*2048;
+
+	a[2] = (s32)book1[2]*l1;
+	a[2] += (s32)book2[2]*l2;
+	a[2] += (s32)book2[1]*input[0];
+	a[2] += (s32)book2[0]*input[1];
+	a[2] += input[2]*2048;
+
+	a[3] = (s32)book1[3]*l1;
+	a[3] += (s32)book2[3]*l2;
+	a[3] += (s32)book2[2]*input[0];
+	a[3] += (s32)book2[1]*input[1];
+	a[3] += (s32)book2[0]*input[2];
+	a[3] += input[3]*2048;
+
+	a[4] = (s32)book1[4]*l1;
+	a[4] += (s32)book2[4]*l2;
+	a[4] += (s32)book2[3]*input[0];
+	a[4] += (s32)book2[2]*input[1];
+	a[4] += (s32)book2[1]*input[2];
+	a[4] += (s32)book2[0]*input[3];
+	a[4] += input[4]*2048;
+
+	a[5] = (s32)book1[5]*l1;
+	a[5] += (s32)book2[5]*l2;
+	a[5] += (s32)book2[4]*input[0];
+	a[5] += (s32)book2[3]*input[1];
+	a[5] += (s32)book2[2]*input[2];
+	a[5] += (s32)book2[1]*input[3];
+	a[5] += (s32)book2[0]*input[4];
+	a[5] += input[5]*2048;
+
+	a[6] = (s32)book1[6]*l1;
+	a[6] += (s32)book2[6]*l2;
+	a[6] += (s32)book2[5]*input[0];
+	a[6] += (s32)book2[4]*input[1];
+	a[6] += (s32)book2[3]*input[2];
+	a[6] += (s32)book2[2]*input[3];
+	a[6] += (s32)book2[1]*input[4];
+	a[6] += (s32)book2[0]*input[5];
+	a[6] += input[6]*2048;
+
+	a[7] = (s32)book1[7]*l1;
+	a[7] += (s32)book2[7]*l2;
+	a[7] += (s32)book2[6]*input[0];
+	a[7] += (s32)book2[5]*input[1];
+	a[7] += (s32)book2[4]*input[2];
+	a[7] += (s32)book2[3]*input[3];
+	a[7] += (s32)book2[2]*input[4];
+	a[7] += (s32)book2[1]*input[5];
+	a[7] += (s32)book2[0]*input[6];
+	a[7] += input[7]*2048;
+
+	*out++ =      Saturate<s16>( a[1] >> 11 );
+	*out++ =      Saturate<s16>( a[0] >> 11 );
+	*out++ =      Saturate<s16>( a[3] >> 11 );
+	*out++ =      Saturate<s16>( a[2] >> 11 );
+	*out++ =      Saturate<s16>( a[5] >> 11 );
+	*out++ =      Saturate<s16>( a[4] >> 11 );
+	*out++ = l2 = Saturate<s16>( a[7] >> 11 );
+	*out++ = l1 = Saturate<s16>( a[6] >> 11 );
+}
+
+static void DecodeADPCM_Scalar( s16 * out, s32 & l1, s32 & l2, const s32 * input, const s16 * book1, const s16 * book2 )
+{
+	DecodeSamples( out + 0, l1, l2, input + 0, book1, book2 );
+	DecodeSamples( out + 8, l1, l2, input + 8, book1, book2 );
+}
+
+static u32 EnvMix_Scalar( s16 * out, s16 * aux1, s16 * aux2, s16 * aux3, const s16 * inp,
+						  const EnvMixRamp & left, const EnvMixRamp & right, s16 Dry, s16 Wet, bool aux )
+{
+	s32 LAcc {left.Acc}, LVol {left.Vol}, LTrg {left.Trg};
+	s32 RAcc {right.Acc}, RVol {right.Vol}, RTrg {right.Trg};
+	s32 MainR {}, MainL {}, AuxR {}, AuxL {};
+	s32 i1 {},o1 {},a1 {},a2 {},a3 {};
+	u32 reached {};
+
+	s32 oMainL {(Dry * (LTrg>>16) + 0x4000) >> 15};
+	s32 oAuxL  {(Wet * (LTrg>>16) + 0x4000) >> 15};
+	s32 oMainR {(Dry * (RTrg>>16) + 0x4000) >> 15};
+	s32 oAuxR  {(Wet * (RTrg>>16) + 0x4000) >> 15};
+
+	for (u32 ptr {}; ptr < 8; ptr++)
+	{
+		i1=(s32)inp[ptr^1];
+		o1=(s32)out[ptr^1];
+		a1=(s32)aux1[ptr^1];
+		if (aux)
+		{
+			a2=(s32)aux2[ptr^1];
+			a3=(s32)aux3[ptr^1];
+		}
+
+		LAcc += LVol;
+		RAcc += RVol;
+
+		if (LVol <= 0)
+		{
+			// Decrementing
+			if (LAcc < LTrg)
+			{
+				LAcc = LTrg;
+				reached |= 1;
+				MainL = oMainL;
+				AuxL  = oAuxL;
+			}
+			else
+			{
+				MainL = (Dry * ((s32)LAcc>>16) + 0x4000) >> 15;
+				AuxL  = (Wet * ((s32)LAcc>>16) + 0x4000) >> 15;
+			}
+		}
+		else
+		{
+			if (LAcc > LTrg)
+			{
+				LAcc = LTrg;
+				reached |= 1;
+				MainL = oMainL;
+				AuxL  = oAuxL;
+			}
+			else
+			{
+				MainL = (Dry * ((s32)LAcc>>16) + 0x4000) >> 15;
+				AuxL  = (Wet * ((s32)LAcc>>16) + 0x4000) >> 15;
+			}
+		}
+
+		if (RVol <= 0)
+		{
+			// Decrementing
+			if (RAcc < RTrg)
+			{
+				RAcc = RTrg;
+				reached |= 2;
+				MainR = oMainR;
+				AuxR  = oAuxR;
+			}
+			else
+			{
+				MainR = (Dry * ((s32)RAcc>>16) + 0x4000) >> 15;
+				AuxR  = (Wet * ((s32)RAcc>>16) + 0x4000) >> 15;
+			}
+		}
+		else
+		{
+			if (RAcc > RTrg)
+			{
+				RAcc = RTrg;
+				reached |= 2;
+				MainR = oMainR;
+				AuxR  = oAuxR;
+			}
+			else
+			{
+				MainR = (Dry * ((s32)RAcc>>16) + 0x4000) >> 15;
+				AuxR  = (Wet * ((s32)RAcc>>16) + 0x4000) >> 15;
+			}
+		}
+
+		o1 += (/*(o1*0x7fff)+*/(i1*MainR) + 0x4000) >> 15;
+		a1 += (/*(a1*0x7fff)+*/ (i1*MainL) + 0x4000) >> 15;
+
+		o1 = Saturate<s16>( o1 );
+		a1 = Saturate<s16>( a1 );
+
+		out[ptr^1]=o1;
+		aux1[ptr^1]=a1;
+		if (aux)
+		{
+			a2+=(/*(a2*0x7fff)+*/(i1*AuxR)+0x4000)>>15;
+			a3+=(/*(a3*0x7fff)+*/(i1*AuxL)+0x4000)>>15;
+
+			a2 = Saturate<s16>( a2 );
+			a3 = Saturate<s16>( a3 );
+
+			aux2[ptr^1]=a2;
+			aux3[ptr^1]=a3;
+		}
+	}
+
+	return reached;
+}
+
+const AudioHLEKernels gAudioHLEKernelsScalar =
+{
+	"Scalar",
+	Mix_Scalar,
+	Resample_Scalar,
+	DecodeADPCM_Scalar,
+	EnvMix_Scalar,
+};
+
+const AudioHLEKernels * gAudioHLEKernels = &gAudioHLEKernelsScalar;
+
+const AudioHLEKernels * AudioHLE_SelectKernels()
+{
+#ifdef DAEDALUS_AUDIO_HLE_X86
+	__builtin_cpu_init();
+	if( __builtin_cpu_supports( "avx2" ) )
+		return &gAudioHLEKernelsAVX2;
+	if( __builtin_cpu_supports( "sse4.1" ) )
+		return &gAudioHLEKernelsSSE41;
+#endif
+	return &gAudioHLEKernelsScalar;
+}
+
+bool AudioHLE_InitKernels()
+{
+	gAudioHLEKernels = AudioHLE_SelectKernels();
+
+	#ifdef DAEDALUS_DEBUG_CONSOLE
+	DBGConsole_Msg( 0, "Audio HLE kernels: %s", gAudioHLEKernels->Name );
+	#endif
+	return true;
+}
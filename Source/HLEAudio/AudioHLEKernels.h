@@ -0,0 +1,97 @@
+/*
+Copyright (C) 2003 Azimer
+Copyright (C) 2001,2006-2007 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#pragma once
+
+#ifndef HLEAUDIO_AUDIOHLEKERNELS_H_
+#define HLEAUDIO_AUDIOHLEKERNELS_H_
+
+#include "Utility/DaedalusTypes.h"
+
+// SSE4.1 and AVX2 versions of the kernels are built with per-function target
+// attributes, so they can be picked at runtime without any special build flags.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DAEDALUS_AUDIO_HLE_X86
+#endif
+
+inline s32		FixedPointMulFull16( s32 a, s32 b )
+{
+	return s32( ( (s64)a * (s64)b ) >> 16 );
+}
+
+inline s32		FixedPointMul16( s32 a, s32 b )
+{
+	return s32( ( a * b ) >> 16 );
+}
+
+inline s32		FixedPointMul15( s32 a, s32 b )
+{
+	return s32( ( a * b ) >> 15 );
+}
+
+// One side of the envelope mixer's volume ramp, for a block of 8 samples
+struct EnvMixRamp
+{
+	s32		Acc;		// Volume before the first sample (16.16)
+	s32		Vol;		// Added for each sample
+	s32		Trg;		// Volume is clamped here once it passes it
+};
+
+//
+//	The inner loops of AudioHLEState's ADPCMDecode, Resample, EnvMixer and Mixer.
+//	Every implementation must give bit-identical results to the scalar one -
+//	see HLEAudio/AudioHLEKernels_bench.cpp.
+//
+//	Buffers are accessed with the same ^1 swizzle as the rest of the HLE code.
+//	The vector versions assume buffers which overlap do so exactly, or at least
+//	16 samples apart; AudioHLEState falls back to gAudioHLEKernelsScalar otherwise.
+//
+struct AudioHLEKernels
+{
+	const char *	Name;
+
+	// out[i] = Saturate( out[i] + in[i] * gain >> 15 )
+	void	(*Mix)( s16 * out, const s16 * in, s32 gain, u32 num_samples );
+
+	// Writes num_words pairs of samples, linearly interpolated from in[src_ptr]. Returns the updated src_ptr.
+	u32		(*Resample)( u32 * out, const s16 * in, u32 src_ptr, u32 & accumulator, u32 pitch, u32 num_words );
+
+	// Decodes 16 samples (two frames of 8) from the unpacked codes in input. l1/l2 are IN/OUT
+	void	(*DecodeADPCM)( s16 * out, s32 & l1, s32 & l2, const s32 * input, const s16 * book1, const s16 * book2 );
+
+	// Mixes 8 samples of in into out/aux1 (and aux2/aux3 if aux is set).
+	// Returns a mask of which ramps reached their target (1 for left, 2 for right).
+	u32		(*EnvMix)( s16 * out, s16 * aux1, s16 * aux2, s16 * aux3, const s16 * in,
+					   const EnvMixRamp & left, const EnvMixRamp & right, s16 dry, s16 wet, bool aux );
+};
+
+extern const AudioHLEKernels	gAudioHLEKernelsScalar;
+#ifdef DAEDALUS_AUDIO_HLE_X86
+extern const AudioHLEKernels	gAudioHLEKernelsSSE41;
+extern const AudioHLEKernels	gAudioHLEKernelsAVX2;
+#endif
+
+// The fastest set of kernels this CPU supports. Scalar until AudioHLE_InitKernels is called.
+extern const AudioHLEKernels *	gAudioHLEKernels;
+
+const AudioHLEKernels *			AudioHLE_SelectKernels();
+bool							AudioHLE_InitKernels();
+
+#endif // HLEAUDIO_AUDIOHLEKERNELS_H_
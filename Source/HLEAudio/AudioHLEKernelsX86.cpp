@@ -0,0 +1,415 @@
+/*
+Copyright (C) 2003 Azimer
+Copyright (C) 2001,2006-2007 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+//
+//	SSE4.1 and AVX2 versions of the audio HLE kernels. These have to match the
+//	scalar versions in AudioHLEKernels.cpp bit for bit, including where the
+//	scalar code relies on 32 bit multiplies wrapping.
+//
+
+#include "stdafx.h"
+#include "AudioHLEKernels.h"
+
+#ifdef DAEDALUS_AUDIO_HLE_X86
+
+#include <immintrin.h>
+
+#define TARGET_SSE41	__attribute__((target("sse4.1")))
+#define TARGET_AVX2		__attribute__((target("avx2")))
+
+// The resampler steps through up to 8 samples at once without renormalising the accumulator
+static const u32 kMaxVectorPitch = 0x0FFFFFFF;
+
+// Once the ramp hits its target the scalar code restarts it from there, which only
+// matches working out each sample's volume independently if nothing overflows
+static inline bool RampFits( const EnvMixRamp & ramp )
+{
+	s64 end( s64( ramp.Acc ) + 8 * s64( ramp.Vol ) );
+	s64 next( s64( ramp.Trg ) + ramp.Vol );
+
+	return end == s32( end ) && next == s32( next );
+}
+
+// Two s16s in each 32 bit lane, for _mm_madd_epi16
+static inline u32 PackPair( s32 a, s32 b )
+{
+	return u32( u16( a ) ) | (u32( u16( b ) ) << 16);
+}
+
+//*****************************************************************************
+//	SSE4.1
+//*****************************************************************************
+// (x * y + 0x4000) >> 15, for 32 bit lanes
+TARGET_SSE41 static inline __m128i MulRound15_SSE41( __m128i x, __m128i y )
+{
+	return _mm_srai_epi32( _mm_add_epi32( _mm_mullo_epi32( x, y ), _mm_set1_epi32( 0x4000 ) ), 15 );
+}
+
+// Volume for 4 samples of the ramp, clamped to its target
+TARGET_SSE41 static inline __m128i RampVolume_SSE41( const EnvMixRamp & ramp, __m128i steps, __m128i & reached )
+{
+	__m128i acc( _mm_add_epi32( _mm_set1_epi32( ramp.Acc ), _mm_mullo_epi32( steps, _mm_set1_epi32( ramp.Vol ) ) ) );
+	__m128i trg( _mm_set1_epi32( ramp.Trg ) );
+	__m128i hit( ramp.Vol <= 0 ? _mm_cmplt_epi32( acc, trg ) : _mm_cmpgt_epi32( acc, trg ) );
+
+	reached = _mm_or_si128( reached, hit );
+	return _mm_blendv_epi8( acc, trg, hit );
+}
+
+TARGET_SSE41 static void Mix_SSE41( s16 * out, const s16 * in, s32 gain, u32 num_samples )
+{
+	if( gain == s16( gain ) )
+	{
+		const __m128i g( _mm_set1_epi16( s16( gain ) ) );
+
+		for( ; num_samples >= 8; num_samples -= 8, in += 8, out += 8 )
+		{
+			__m128i	i( _mm_loadu_si128( (const __m128i *)in ) );
+			__m128i	o( _mm_loadu_si128( (const __m128i *)out ) );
+			__m128i	lo( _mm_mullo_epi16( i, g ) );
+			__m128i	hi( _mm_mulhi_epi16( i, g ) );
+
+			// Full 32 bit products, plus out sign extended (by unpacking it with itself)
+			__m128i	r0( _mm_add_epi32( _mm_srai_epi32( _mm_unpacklo_epi16( lo, hi ), 15 ), _mm_srai_epi32( _mm_unpacklo_epi16( o, o ), 16 ) ) );
+			__m128i	r1( _mm_add_epi32( _mm_srai_epi32( _mm_unpackhi_epi16( lo, hi ), 15 ), _mm_srai_epi32( _mm_unpackhi_epi16( o, o ), 16 ) ) );
+
+			_mm_storeu_si128( (__m128i *)out, _mm_packs_epi32( r0, r1 ) );
+		}
+	}
+
+	gAudioHLEKernelsScalar.Mix( out, in, gain, num_samples );
+}
+
+TARGET_SSE41 static u32 Resample_SSE41( u32 * out, const s16 * in, u32 src_ptr, u32 & accumulator, u32 pitch, u32 num_words )
+{
+	if( pitch > kMaxVectorPitch )
+		return gAudioHLEKernelsScalar.Resample( out, in, src_ptr, accumulator, pitch, num_words );
+
+	// Each word holds the first sample of the pair in the high half, so the lanes are in the order 1,0,3,2
+	const __m128i	steps( _mm_mullo_epi32( _mm_setr_epi32( 1, 0, 3, 2 ), _mm_set1_epi32( pitch ) ) );
+	const __m128i	mask( _mm_set1_epi32( 0xFFFF ) );
+	u32				acc( accumulator );
+
+	for( ; num_words >= 2; num_words -= 2, out += 2 )
+	{
+		__m128i	t( _mm_add_epi32( _mm_set1_epi32( acc ), steps ) );
+		u32		p0( src_ptr + ((acc + 1 * pitch) >> 16) );
+		u32		p1( src_ptr + ((acc + 0 * pitch) >> 16) );
+		u32		p2( src_ptr + ((acc + 3 * pitch) >> 16) );
+		u32		p3( src_ptr + ((acc + 2 * pitch) >> 16) );
+
+		__m128i	a( _mm_setr_epi32( in[p0^1], in[p1^1], in[p2^1], in[p3^1] ) );
+		__m128i	b( _mm_setr_epi32( in[(p0+1)^1], in[(p1+1)^1], in[(p2+1)^1], in[(p3+1)^1] ) );
+		__m128i	f( _mm_and_si128( t, mask ) );
+		__m128i	r( _mm_add_epi32( a, _mm_srai_epi32( _mm_mullo_epi32( _mm_sub_epi32( b, a ), f ), 16 ) ) );
+
+		// Truncate to 16 bits, rather than saturate
+		r = _mm_and_si128( r, mask );
+		_mm_storel_epi64( (__m128i *)out, _mm_packus_epi32( r, r ) );
+
+		acc += 4 * pitch;
+		src_ptr += acc >> 16;
+		acc &= 0xFFFF;
+	}
+
+	accumulator = acc;
+	return gAudioHLEKernelsScalar.Resample( out, in, src_ptr, accumulator, pitch, num_words );
+}
+
+TARGET_SSE41 static void DecodeADPCM_SSE41( s16 * out, s32 & l1, s32 & l2, const s32 * input, const s16 * book1, const s16 * book2 )
+{
+	const __m128i	b1( _mm_loadu_si128( (const __m128i *)book1 ) );
+	const __m128i	b2( _mm_loadu_si128( (const __m128i *)book2 ) );
+
+	// Weights of each input in the 8 outputs: book2 delayed by one sample more than the input, plus 2048 for the input itself
+	const __m128i	c0( _mm_insert_epi16( _mm_slli_si128( b2,  2 ), 2048, 0 ) );
+	const __m128i	c1( _mm_insert_epi16( _mm_slli_si128( b2,  4 ), 2048, 1 ) );
+	const __m128i	c2( _mm_insert_epi16( _mm_slli_si128( b2,  6 ), 2048, 2 ) );
+	const __m128i	c3( _mm_insert_epi16( _mm_slli_si128( b2,  8 ), 2048, 3 ) );
+	const __m128i	c4( _mm_insert_epi16( _mm_slli_si128( b2, 10 ), 2048, 4 ) );
+	const __m128i	c5( _mm_insert_epi16( _mm_slli_si128( b2, 12 ), 2048, 5 ) );
+	const __m128i	c6( _mm_insert_epi16( _mm_slli_si128( b2, 14 ), 2048, 6 ) );
+	const __m128i	c7( _mm_insert_epi16( _mm_setzero_si128(), 2048, 7 ) );
+
+	// Interleave the weights in pairs, for outputs 0-3 and 4-7
+	const __m128i	w_lo[5] = { _mm_unpacklo_epi16( b1, b2 ), _mm_unpacklo_epi16( c0, c1 ), _mm_unpacklo_epi16( c2, c3 ), _mm_unpacklo_epi16( c4, c5 ), _mm_unpacklo_epi16( c6, c7 ) };
+	const __m128i	w_hi[5] = { _mm_unpackhi_epi16( b1, b2 ), _mm_unpackhi_epi16( c0, c1 ), _mm_unpackhi_epi16( c2, c3 ), _mm_unpackhi_epi16( c4, c5 ), _mm_unpackhi_epi16( c6, c7 ) };
+
+	for( u32 frame = 0; frame < 2; ++frame, input += 8, out += 8 )
+	{
+		__m128i	v[5] = { _mm_set1_epi32( PackPair( l1, l2 ) ),
+						 _mm_set1_epi32( PackPair( input[0], input[1] ) ),
+						 _mm_set1_epi32( PackPair( input[2], input[3] ) ),
+						 _mm_set1_epi32( PackPair( input[4], input[5] ) ),
+						 _mm_set1_epi32( PackPair( input[6], input[7] ) ) };
+
+		__m128i	lo( _mm_madd_epi16( w_lo[0], v[0] ) );
+		__m128i	hi( _mm_madd_epi16( w_hi[0], v[0] ) );
+		for( u32 i = 1; i < 5; ++i )
+		{
+			lo = _mm_add_epi32( lo, _mm_madd_epi16( w_lo[i], v[i] ) );
+			hi = _mm_add_epi32( hi, _mm_madd_epi16( w_hi[i], v[i] ) );
+		}
+
+		__m128i	r( _mm_packs_epi32( _mm_srai_epi32( lo, 11 ), _mm_srai_epi32( hi, 11 ) ) );
+		l1 = s16( _mm_extract_epi16( r, 6 ) );
+		l2 = s16( _mm_extract_epi16( r, 7 ) );
+
+		r = _mm_shufflehi_epi16( _mm_shufflelo_epi16( r, _MM_SHUFFLE( 2, 3, 0, 1 ) ), _MM_SHUFFLE( 2, 3, 0, 1 ) );
+		_mm_storeu_si128( (__m128i *)out, r );
+	}
+}
+
+TARGET_SSE41 static u32 EnvMix_SSE41( s16 * out, s16 * aux1, s16 * aux2, s16 * aux3, const s16 * inp,
+									  const EnvMixRamp & left, const EnvMixRamp & right, s16 dry, s16 wet, bool aux )
+{
+	if( !RampFits( left ) || !RampFits( right ) )
+		return gAudioHLEKernelsScalar.EnvMix( out, aux1, aux2, aux3, inp, left, right, dry, wet, aux );
+
+	// How far into the ramp each lane is. Samples are processed in the order 1,0,3,2...
+	const __m128i	steps[2] = { _mm_setr_epi32( 2, 1, 4, 3 ), _mm_setr_epi32( 6, 5, 8, 7 ) };
+	const __m128i	d( _mm_set1_epi32( dry ) );
+	const __m128i	w( _mm_set1_epi32( wet ) );
+
+	__m128i			i16( _mm_loadu_si128( (const __m128i *)inp ) );
+	__m128i			o16( _mm_loadu_si128( (const __m128i *)out ) );
+	__m128i			a16( _mm_loadu_si128( (const __m128i *)aux1 ) );
+	__m128i			b16( aux ? _mm_loadu_si128( (const __m128i *)aux2 ) : _mm_setzero_si128() );
+	__m128i			c16( aux ? _mm_loadu_si128( (const __m128i *)aux3 ) : _mm_setzero_si128() );
+
+	__m128i			reached_l( _mm_setzero_si128() );
+	__m128i			reached_r( _mm_setzero_si128() );
+	__m128i			o[2], a[2], b[2], c[2];
+
+	for( u32 h = 0; h < 2; ++h )
+	{
+		__m128i	vol_l( _mm_srai_epi32( RampVolume_SSE41( left, steps[h], reached_l ), 16 ) );
+		__m128i	vol_r( _mm_srai_epi32( RampVolume_SSE41( right, steps[h], reached_r ), 16 ) );
+		__m128i	main_l( MulRound15_SSE41( d, vol_l ) );
+		__m128i	main_r( MulRound15_SSE41( d, vol_r ) );
+		__m128i	aux_l( MulRound15_SSE41( w, vol_l ) );
+		__m128i	aux_r( MulRound15_SSE41( w, vol_r ) );
+
+		__m128i	i( _mm_cvtepi16_epi32( h ? _mm_srli_si128( i16, 8 ) : i16 ) );
+		o[h] = _mm_add_epi32( _mm_cvtepi16_epi32( h ? _mm_srli_si128( o16, 8 ) : o16 ), MulRound15_SSE41( i, main_r ) );
+		a[h] = _mm_add_epi32( _mm_cvtepi16_epi32( h ? _mm_srli_si128( a16, 8 ) : a16 ), MulRound15_SSE41( i, main_l ) );
+		b[h] = _mm_add_epi32( _mm_cvtepi16_epi32( h ? _mm_srli_si128( b16, 8 ) : b16 ), MulRound15_SSE41( i, aux_r ) );
+		c[h] = _mm_add_epi32( _mm_cvtepi16_epi32( h ? _mm_srli_si128( c16, 8 ) : c16 ), MulRound15_SSE41( i, aux_l ) );
+	}
+
+	// Stored in the same order as the scalar version, in case any of these are the same buffer
+	_mm_storeu_si128( (__m128i *)out, _mm_packs_epi32( o[0], o[1] ) );
+	_mm_storeu_si128( (__m128i *)aux1, _mm_packs_epi32( a[0], a[1] ) );
+	if( aux )
+	{
+		_mm_storeu_si128( (__m128i *)aux2, _mm_packs_epi32( b[0], b[1] ) );
+		_mm_storeu_si128( (__m128i *)aux3, _mm_packs_epi32( c[0], c[1] ) );
+	}
+
+	return (_mm_testz_si128( reached_l, reached_l ) ? 0 : 1) | (_mm_testz_si128( reached_r, reached_r ) ? 0 : 2);
+}
+
+const AudioHLEKernels gAudioHLEKernelsSSE41 =
+{
+	"SSE4.1",
+	Mix_SSE41,
+	Resample_SSE41,
+	DecodeADPCM_SSE41,
+	EnvMix_SSE41,
+};
+
+//*****************************************************************************
+//	AVX2
+//*****************************************************************************
+TARGET_AVX2 static inline __m256i MulRound15_AVX2( __m256i x, __m256i y )
+{
+	return _mm256_srai_epi32( _mm256_add_epi32( _mm256_mullo_epi32( x, y ), _mm256_set1_epi32( 0x4000 ) ), 15 );
+}
+
+TARGET_AVX2 static inline __m256i RampVolume_AVX2( const EnvMixRamp & ramp, __m256i steps, u32 & reached, u32 bit )
+{
+	__m256i acc( _mm256_add_epi32( _mm256_set1_epi32( ramp.Acc ), _mm256_mullo_epi32( steps, _mm256_set1_epi32( ramp.Vol ) ) ) );
+	__m256i trg( _mm256_set1_epi32( ramp.Trg ) );
+	__m256i hit( ramp.Vol <= 0 ? _mm256_cmpgt_epi32( trg, acc ) : _mm256_cmpgt_epi32( acc, trg ) );
+
+	if( !_mm256_testz_si256( hit, hit ) )
+		reached |= bit;
+	return _mm256_blendv_epi8( acc, trg, hit );
+}
+
+// Saturates 8 32 bit lanes to s16
+TARGET_AVX2 static inline __m128i Pack_AVX2( __m256i x )
+{
+	return _mm_packs_epi32( _mm256_castsi256_si128( x ), _mm256_extracti128_si256( x, 1 ) );
+}
+
+TARGET_AVX2 static void Mix_AVX2( s16 * out, const s16 * in, s32 gain, u32 num_samples )
+{
+	if( gain == s16( gain ) )
+	{
+		const __m256i g( _mm256_set1_epi16( s16( gain ) ) );
+
+		for( ; num_samples >= 16; num_samples -= 16, in += 16, out += 16 )
+		{
+			__m256i	i( _mm256_loadu_si256( (const __m256i *)in ) );
+			__m256i	o( _mm256_loadu_si256( (const __m256i *)out ) );
+			__m256i	lo( _mm256_mullo_epi16( i, g ) );
+			__m256i	hi( _mm256_mulhi_epi16( i, g ) );
+
+			// The unpacks and packs both work within each 128 bit lane, so the order comes out right
+			__m256i	r0( _mm256_add_epi32( _mm256_srai_epi32( _mm256_unpacklo_epi16( lo, hi ), 15 ), _mm256_srai_epi32( _mm256_unpacklo_epi16( o, o ), 16 ) ) );
+			__m256i	r1( _mm256_add_epi32( _mm256_srai_epi32( _mm256_unpackhi_epi16( lo, hi ), 15 ), _mm256_srai_epi32( _mm256_unpackhi_epi16( o, o ), 16 ) ) );
+
+			_mm256_storeu_si256( (__m256i *)out, _mm256_packs_epi32( r0, r1 ) );
+		}
+	}
+
+	Mix_SSE41( out, in, gain, num_samples );
+}
+
+// N.B. The gathers read 32 bits for each sample, so may touch the s16 after the last one used
+TARGET_AVX2 static u32 Resample_AVX2( u32 * out, const s16 * in, u32 src_ptr, u32 & accumulator, u32 pitch, u32 num_words )
+{
+	if( pitch > kMaxVectorPitch )
+		return gAudioHLEKernelsScalar.Resample( out, in, src_ptr, accumulator, pitch, num_words );
+
+	const __m256i	steps( _mm256_mullo_epi32( _mm256_setr_epi32( 1, 0, 3, 2, 5, 4, 7, 6 ), _mm256_set1_epi32( pitch ) ) );
+	const __m256i	mask( _mm256_set1_epi32( 0xFFFF ) );
+	const __m256i	one( _mm256_set1_epi32( 1 ) );
+	const int *		base( reinterpret_cast< const int * >( in ) );
+	u32				acc( accumulator );
+
+	for( ; num_words >= 4; num_words -= 4, out += 4 )
+	{
+		__m256i	t( _mm256_add_epi32( _mm256_set1_epi32( acc ), steps ) );
+		__m256i	p( _mm256_add_epi32( _mm256_set1_epi32( src_ptr ), _mm256_srli_epi32( t, 16 ) ) );
+		__m256i	ga( _mm256_i32gather_epi32( base, _mm256_xor_si256( p, one ), 2 ) );
+		__m256i	gb( _mm256_i32gather_epi32( base, _mm256_xor_si256( _mm256_add_epi32( p, one ), one ), 2 ) );
+
+		// Only the low half of each gathered word is wanted
+		__m256i	a( _mm256_srai_epi32( _mm256_slli_epi32( ga, 16 ), 16 ) );
+		__m256i	b( _mm256_srai_epi32( _mm256_slli_epi32( gb, 16 ), 16 ) );
+		__m256i	f( _mm256_and_si256( t, mask ) );
+		__m256i	r( _mm256_add_epi32( a, _mm256_srai_epi32( _mm256_mullo_epi32( _mm256_sub_epi32( b, a ), f ), 16 ) ) );
+
+		r = _mm256_and_si256( r, mask );
+		_mm_storeu_si128( (__m128i *)out, _mm_packus_epi32( _mm256_castsi256_si128( r ), _mm256_extracti128_si256( r, 1 ) ) );
+
+		acc += 8 * pitch;
+		src_ptr += acc >> 16;
+		acc &= 0xFFFF;
+	}
+
+	accumulator = acc;
+	return Resample_SSE41( out, in, src_ptr, accumulator, pitch, num_words );
+}
+
+TARGET_AVX2 static void DecodeADPCM_AVX2( s16 * out, s32 & l1, s32 & l2, const s32 * input, const s16 * book1, const s16 * book2 )
+{
+	const __m128i	b1( _mm_loadu_si128( (const __m128i *)book1 ) );
+	const __m128i	b2( _mm_loadu_si128( (const __m128i *)book2 ) );
+
+	const __m128i	c0( _mm_insert_epi16( _mm_slli_si128( b2,  2 ), 2048, 0 ) );
+	const __m128i	c1( _mm_insert_epi16( _mm_slli_si128( b2,  4 ), 2048, 1 ) );
+	const __m128i	c2( _mm_insert_epi16( _mm_slli_si128( b2,  6 ), 2048, 2 ) );
+	const __m128i	c3( _mm_insert_epi16( _mm_slli_si128( b2,  8 ), 2048, 3 ) );
+	const __m128i	c4( _mm_insert_epi16( _mm_slli_si128( b2, 10 ), 2048, 4 ) );
+	const __m128i	c5( _mm_insert_epi16( _mm_slli_si128( b2, 12 ), 2048, 5 ) );
+	const __m128i	c6( _mm_insert_epi16( _mm_slli_si128( b2, 14 ), 2048, 6 ) );
+	const __m128i	c7( _mm_insert_epi16( _mm_setzero_si128(), 2048, 7 ) );
+
+	// As the SSE4.1 version, with outputs 0-3 in the low lane and 4-7 in the high one
+	#define WEIGHTS( x, y )	_mm256_inserti128_si256( _mm256_castsi128_si256( _mm_unpacklo_epi16( x, y ) ), _mm_unpackhi_epi16( x, y ), 1 )
+	const __m256i	weights[5] = { WEIGHTS( b1, b2 ), WEIGHTS( c0, c1 ), WEIGHTS( c2, c3 ), WEIGHTS( c4, c5 ), WEIGHTS( c6, c7 ) };
+	#undef WEIGHTS
+
+	for( u32 frame = 0; frame < 2; ++frame, input += 8, out += 8 )
+	{
+		__m256i	a( _mm256_madd_epi16( weights[0], _mm256_set1_epi32( PackPair( l1, l2 ) ) ) );
+		a = _mm256_add_epi32( a, _mm256_madd_epi16( weights[1], _mm256_set1_epi32( PackPair( input[0], input[1] ) ) ) );
+		a = _mm256_add_epi32( a, _mm256_madd_epi16( weights[2], _mm256_set1_epi32( PackPair( input[2], input[3] ) ) ) );
+		a = _mm256_add_epi32( a, _mm256_madd_epi16( weights[3], _mm256_set1_epi32( PackPair( input[4], input[5] ) ) ) );
+		a = _mm256_add_epi32( a, _mm256_madd_epi16( weights[4], _mm256_set1_epi32( PackPair( input[6], input[7] ) ) ) );
+
+		__m128i	r( Pack_AVX2( _mm256_srai_epi32( a, 11 ) ) );
+		l1 = s16( _mm_extract_epi16( r, 6 ) );
+		l2 = s16( _mm_extract_epi16( r, 7 ) );
+
+		r = _mm_shufflehi_epi16( _mm_shufflelo_epi16( r, _MM_SHUFFLE( 2, 3, 0, 1 ) ), _MM_SHUFFLE( 2, 3, 0, 1 ) );
+		_mm_storeu_si128( (__m128i *)out, r );
+	}
+}
+
+TARGET_AVX2 static u32 EnvMix_AVX2( s16 * out, s16 * aux1, s16 * aux2, s16 * aux3, const s16 * inp,
+									const EnvMixRamp & left, const EnvMixRamp & right, s16 dry, s16 wet, bool aux )
+{
+	if( !RampFits( left ) || !RampFits( right ) )
+		return gAudioHLEKernelsScalar.EnvMix( out, aux1, aux2, aux3, inp, left, right, dry, wet, aux );
+
+	const __m256i	steps( _mm256_setr_epi32( 2, 1, 4, 3, 6, 5, 8, 7 ) );
+	const __m256i	d( _mm256_set1_epi32( dry ) );
+	const __m256i	w( _mm256_set1_epi32( wet ) );
+	u32				reached( 0 );
+
+	__m256i	vol_l( _mm256_srai_epi32( RampVolume_AVX2( left, steps, reached, 1 ), 16 ) );
+	__m256i	vol_r( _mm256_srai_epi32( RampVolume_AVX2( right, steps, reached, 2 ), 16 ) );
+
+	__m256i	i( _mm256_cvtepi16_epi32( _mm_loadu_si128( (const __m128i *)inp ) ) );
+	__m256i	o( _mm256_cvtepi16_epi32( _mm_loadu_si128( (const __m128i *)out ) ) );
+	__m256i	a( _mm256_cvtepi16_epi32( _mm_loadu_si128( (const __m128i *)aux1 ) ) );
+
+	if( aux )
+	{
+		__m256i	b( _mm256_cvtepi16_epi32( _mm_loadu_si128( (const __m128i *)aux2 ) ) );
+		__m256i	c( _mm256_cvtepi16_epi32( _mm_loadu_si128( (const __m128i *)aux3 ) ) );
+
+		b = _mm256_add_epi32( b, MulRound15_AVX2( i, MulRound15_AVX2( w, vol_r ) ) );
+		c = _mm256_add_epi32( c, MulRound15_AVX2( i, MulRound15_AVX2( w, vol_l ) ) );
+
+		o = _mm256_add_epi32( o, MulRound15_AVX2( i, MulRound15_AVX2( d, vol_r ) ) );
+		a = _mm256_add_epi32( a, MulRound15_AVX2( i, MulRound15_AVX2( d, vol_l ) ) );
+
+		_mm_storeu_si128( (__m128i *)out, Pack_AVX2( o ) );
+		_mm_storeu_si128( (__m128i *)aux1, Pack_AVX2( a ) );
+		_mm_storeu_si128( (__m128i *)aux2, Pack_AVX2( b ) );
+		_mm_storeu_si128( (__m128i *)aux3, Pack_AVX2( c ) );
+	}
+	else
+	{
+		o = _mm256_add_epi32( o, MulRound15_AVX2( i, MulRound15_AVX2( d, vol_r ) ) );
+		a = _mm256_add_epi32( a, MulRound15_AVX2( i, MulRound15_AVX2( d, vol_l ) ) );
+
+		_mm_storeu_si128( (__m128i *)out, Pack_AVX2( o ) );
+		_mm_storeu_si128( (__m128i *)aux1, Pack_AVX2( a ) );
+	}
+
+	return reached;
+}
+
+const AudioHLEKernels gAudioHLEKernelsAVX2 =
+{
+	"AVX2",
+	Mix_AVX2,
+	Resample_AVX2,
+	DecodeADPCM_AVX2,
+	EnvMix_AVX2,
+};
+
+#endif // DAEDALUS_AUDIO_HLE_X86
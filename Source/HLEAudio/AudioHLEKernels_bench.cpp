@@ -0,0 +1,370 @@
+// Microbenchmark for the audio HLE kernels. Replays the kernel calls made by recorded alists through
+// the scalar, SSE4.1 and AVX2 kernels, checking every output matches the scalar one bit for bit.
+// Traces are written to audio_trace.bin by builds with DAEDALUS_CAPTURE_AUDIO_TRACE defined, and are
+// passed as the first argument; without one, randomly generated calls with roughly the sizes games use
+// are replayed instead.
+
+#include "stdafx.h"
+#include "HLEAudio/AudioHLEKernels.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+static const u32	kNumSyntheticCalls = 20000;
+static const u32	kMinReplayedSamples = 50000000;
+static const u32	kResamplePadding = 2;			// The AVX2 gathers can read one s16 past the end
+
+struct SMixCall
+{
+	s32					Gain;
+	std::vector< s16 >	In;
+	std::vector< s16 >	Out;
+};
+
+struct SResampleCall
+{
+	u32					SrcPtr;				// Relative to In, which starts on an even sample
+	u32					Accumulator;
+	u32					Pitch;
+	u32					NumWords;
+	std::vector< s16 >	In;
+};
+
+struct SADPCMCall
+{
+	s32					L1;
+	s32					L2;
+	s32					Input[ 16 ];
+	s16					Book[ 16 ];
+};
+
+struct SEnvMixCall
+{
+	EnvMixRamp			Left;
+	EnvMixRamp			Right;
+	s16					Dry;
+	s16					Wet;
+	bool				Aux;
+	s16					Buffers[ 5 ][ 8 ];	// in, out, aux1, aux2, aux3
+};
+
+struct STrace
+{
+	std::vector< SMixCall >			Mix;
+	std::vector< SResampleCall >	Resample;
+	std::vector< SADPCMCall >		ADPCM;
+	std::vector< SEnvMixCall >		EnvMix;
+};
+
+static u32 gSeed( 0x12345678 );
+
+static u32 Random()
+{
+	gSeed = gSeed * 1664525 + 1013904223;
+	return gSeed >> 8;
+}
+
+static s16 RandomSample()
+{
+	return s16( Random() ^ (Random() << 8) );
+}
+
+// Full range samples, so the saturation paths are exercised as well as the common case
+static void MakeSyntheticTrace( STrace & trace )
+{
+	for( u32 i = 0; i < kNumSyntheticCalls; ++i )
+	{
+		SMixCall	mix;
+		u32			n( 0x170 / 2 + (Random() % 3) * 8 + (Random() & 7) );
+		mix.Gain = (Random() & 7) == 0 ? -32768 : RandomSample();
+		for( u32 s = 0; s < n; ++s )
+		{
+			mix.In.push_back( RandomSample() );
+			mix.Out.push_back( RandomSample() );
+		}
+		trace.Mix.push_back( mix );
+
+		SResampleCall	resample;
+		resample.NumWords = 0x170 / 4 + (Random() & 3);
+		resample.Pitch = 2 * (0x4000 + Random() % 0x10000);
+		resample.Accumulator = Random() & 0xFFFF;
+		resample.SrcPtr = Random() & 1;
+		u32		in_samples( resample.SrcPtr + ((resample.Accumulator + 2 * resample.NumWords * u64( resample.Pitch )) >> 16) + 4 );
+		for( u32 s = 0; s < in_samples + kResamplePadding; ++s )
+		{
+			resample.In.push_back( RandomSample() );
+		}
+		trace.Resample.push_back( resample );
+
+		for( u32 b = 0; b < 4; ++b )
+		{
+			SADPCMCall	adpcm;
+			adpcm.L1 = RandomSample();
+			adpcm.L2 = RandomSample();
+			u32		scale( Random() % 13 );
+			for( u32 s = 0; s < 16; ++s )
+			{
+				s32		nibble( s16( (Random() & 0xf) << 12 ) );
+				adpcm.Input[ s ] = scale < 12 ? FixedPointMul16( nibble, 0x8000 >> (11 - scale) ) : nibble;
+				adpcm.Book[ s ] = s16( RandomSample() >> (Random() % 4) );
+			}
+			trace.ADPCM.push_back( adpcm );
+		}
+
+		for( u32 g = 0; g < 0x170 / 16; ++g )
+		{
+			SEnvMixCall		envmix;
+			EnvMixRamp *	ramps[ 2 ] = { &envmix.Left, &envmix.Right };
+			for( u32 r = 0; r < 2; ++r )
+			{
+				EnvMixRamp &	ramp( *ramps[ r ] );
+				ramp.Trg = s32( RandomSample() ) << 16;
+				switch( Random() % 3 )
+				{
+				case 0:	ramp.Acc = ramp.Trg; ramp.Vol = 0; break;
+				case 1:	ramp.Acc = s32( RandomSample() ) << 16; ramp.Vol = s32( (s64( ramp.Trg ) - ramp.Acc) >> 3 ); break;
+				default: ramp.Acc = s32( RandomSample() ) << 16; ramp.Vol = s32( Random() ) - 0x800000; break;
+				}
+			}
+			envmix.Dry = RandomSample();
+			envmix.Wet = RandomSample();
+			envmix.Aux = (Random() & 1) != 0;
+			for( u32 b = 0; b < 5; ++b )
+			{
+				for( u32 s = 0; s < 8; ++s )
+				{
+					envmix.Buffers[ b ][ s ] = RandomSample();
+				}
+			}
+			trace.EnvMix.push_back( envmix );
+		}
+	}
+}
+
+template< typename T > static bool Read( FILE * fh, T * data, u32 count = 1 )
+{
+	return fread( data, sizeof( T ), count, fh ) == count;
+}
+
+// See AudioTrace_Write in HLEAudio/AudioHLEProcessor.cpp for the format
+static bool LoadTrace( const char * filename, STrace & trace )
+{
+	FILE *	fh( fopen( filename, "rb" ) );
+	if( fh == NULL )
+		return false;
+
+	bool	ok( true );
+	u32		tag;
+	while( ok && Read( fh, &tag ) )
+	{
+		switch( tag )
+		{
+		case 'M':
+			{
+				SMixCall	mix;
+				u32			n;
+				ok = Read( fh, &mix.Gain ) && Read( fh, &n );
+				mix.In.resize( n );
+				mix.Out.resize( n );
+				ok = ok && (n == 0 || (Read( fh, mix.In.data(), n ) && Read( fh, mix.Out.data(), n )));
+				trace.Mix.push_back( mix );
+			}
+			break;
+		case 'R':
+			{
+				SResampleCall	resample;
+				u32				first, n;
+				ok = Read( fh, &resample.SrcPtr ) && Read( fh, &resample.Accumulator ) && Read( fh, &resample.Pitch ) &&
+					 Read( fh, &resample.NumWords ) && Read( fh, &first ) && Read( fh, &n );
+				resample.SrcPtr -= first;
+				resample.In.resize( n + kResamplePadding );
+				ok = ok && Read( fh, resample.In.data(), n );
+				trace.Resample.push_back( resample );
+			}
+			break;
+		case 'A':
+			{
+				SADPCMCall	adpcm;
+				ok = Read( fh, &adpcm.L1 ) && Read( fh, &adpcm.L2 ) && Read( fh, adpcm.Input, 16 ) && Read( fh, adpcm.Book, 16 );
+				trace.ADPCM.push_back( adpcm );
+			}
+			break;
+		case 'E':
+			{
+				SEnvMixCall	envmix;
+				u32			aux;
+				ok = Read( fh, &envmix.Left ) && Read( fh, &envmix.Right ) && Read( fh, &envmix.Dry ) && Read( fh, &envmix.Wet ) &&
+					 Read( fh, &aux ) && Read( fh, &envmix.Buffers[ 0 ][ 0 ], 5 * 8 );
+				envmix.Aux = aux != 0;
+				trace.EnvMix.push_back( envmix );
+			}
+			break;
+		default:
+			ok = false;
+			break;
+		}
+	}
+
+	fclose( fh );
+	return !(trace.Mix.empty() && trace.Resample.empty() && trace.ADPCM.empty() && trace.EnvMix.empty());
+}
+
+//
+//	Each of these runs one call and appends whatever it wrote to output
+//
+static void RunMix( const AudioHLEKernels & kernels, const SMixCall & call, std::vector< s16 > & output )
+{
+	std::vector< s16 >	out( call.Out );
+	kernels.Mix( out.data(), call.In.data(), call.Gain, out.size() );
+	output.insert( output.end(), out.begin(), out.end() );
+}
+
+static void RunResample( const AudioHLEKernels & kernels, const SResampleCall & call, std::vector< s16 > & output )
+{
+	std::vector< u32 >	out( call.NumWords );
+	u32					accumulator( call.Accumulator );
+	u32					src_ptr( kernels.Resample( out.data(), call.In.data(), call.SrcPtr, accumulator, call.Pitch, call.NumWords ) );
+
+	const s16 *			samples( reinterpret_cast< const s16 * >( out.data() ) );
+	output.insert( output.end(), samples, samples + 2 * out.size() );
+	output.push_back( s16( src_ptr ) );
+	output.push_back( s16( accumulator ) );
+}
+
+static void RunADPCM( const AudioHLEKernels & kernels, const SADPCMCall & call, std::vector< s16 > & output )
+{
+	s16		out[ 16 ];
+	s32		l1( call.L1 ), l2( call.L2 );
+	kernels.DecodeADPCM( out, l1, l2, call.Input, call.Book, call.Book + 8 );
+
+	output.insert( output.end(), out, out + 16 );
+	output.push_back( s16( l1 ) );
+	output.push_back( s16( l2 ) );
+}
+
+static void RunEnvMix( const AudioHLEKernels & kernels, const SEnvMixCall & call, std::vector< s16 > & output )
+{
+	s16		buffers[ 5 ][ 8 ];
+	memcpy( buffers, call.Buffers, sizeof( buffers ) );
+	u32		reached( kernels.EnvMix( buffers[ 1 ], buffers[ 2 ], buffers[ 3 ], buffers[ 4 ], buffers[ 0 ], call.Left, call.Right, call.Dry, call.Wet, call.Aux ) );
+
+	output.insert( output.end(), &buffers[ 1 ][ 0 ], &buffers[ 1 ][ 0 ] + 4 * 8 );
+	output.push_back( s16( reached ) );
+}
+
+template< typename T > static double Time( T fn )
+{
+	std::chrono::high_resolution_clock::time_point	start( std::chrono::high_resolution_clock::now() );
+	fn();
+	std::chrono::high_resolution_clock::time_point	end( std::chrono::high_resolution_clock::now() );
+	return std::chrono::duration< double, std::milli >( end - start ).count();
+}
+
+// Checks kernels against the scalar versions call by call, then times them. Returns false on any mismatch.
+template< typename TCall, typename TRun >
+static bool Bench( const char * name, const std::vector< TCall > & calls, u32 samples_per_call, TRun run,
+				   const std::vector< const AudioHLEKernels * > & kernels )
+{
+	if( calls.empty() )
+		return true;
+
+	bool	exact( true );
+	for( u32 k = 1; k < kernels.size(); ++k )
+	{
+		u32		mismatches( 0 );
+		for( u32 i = 0; i < calls.size(); ++i )
+		{
+			std::vector< s16 >	expected, actual;
+			run( gAudioHLEKernelsScalar, calls[ i ], expected );
+			run( *kernels[ k ], calls[ i ], actual );
+			if( expected != actual )
+			{
+				mismatches++;
+			}
+		}
+		if( mismatches > 0 )
+		{
+			printf( "%-12s %-8s %u of %u calls differ from scalar\n", name, kernels[ k ]->Name, mismatches, (u32)calls.size() );
+			exact = false;
+		}
+	}
+
+	u32		repeats( (kMinReplayedSamples + calls.size() * samples_per_call - 1) / (calls.size() * samples_per_call) );
+	u32		num_samples( repeats * calls.size() * samples_per_call );
+	double	scalar_ms( 0.0 );
+	for( u32 k = 0; k < kernels.size(); ++k )
+	{
+		std::vector< s16 >	output;
+		output.reserve( 64 );
+		double	ms( Time( [&]()
+		{
+			for( u32 r = 0; r < repeats; ++r )
+			{
+				for( u32 i = 0; i < calls.size(); ++i )
+				{
+					output.clear();
+					run( *kernels[ k ], calls[ i ], output );
+				}
+			}
+		} ) );
+
+		if( k == 0 )
+		{
+			scalar_ms = ms;
+		}
+		printf( "%-12s %-8s %8.2fms (%5.2fns/sample, %4.2fx)\n", name, kernels[ k ]->Name, ms, ms * 1e6 / num_samples, scalar_ms / ms );
+	}
+	return exact;
+}
+
+int main( int argc, char ** argv )
+{
+	STrace	trace;
+	if( argc > 1 )
+	{
+		if( !LoadTrace( argv[ 1 ], trace ) )
+		{
+			printf( "Couldn't read a trace from %s\n", argv[ 1 ] );
+			return 1;
+		}
+	}
+	else
+	{
+		MakeSyntheticTrace( trace );
+	}
+
+	std::vector< const AudioHLEKernels * >	kernels;
+	kernels.push_back( &gAudioHLEKernelsScalar );
+#ifdef DAEDALUS_AUDIO_HLE_X86
+	__builtin_cpu_init();
+	if( __builtin_cpu_supports( "sse4.1" ) )
+		kernels.push_back( &gAudioHLEKernelsSSE41 );
+	if( __builtin_cpu_supports( "avx2" ) )
+		kernels.push_back( &gAudioHLEKernelsAVX2 );
+#endif
+
+	printf( "%s trace: %u mix, %u resample, %u adpcm, %u envmix calls. Runtime selection: %s\n",
+			argc > 1 ? argv[ 1 ] : "synthetic", (u32)trace.Mix.size(), (u32)trace.Resample.size(),
+			(u32)trace.ADPCM.size(), (u32)trace.EnvMix.size(), AudioHLE_SelectKernels()->Name );
+
+	// Mix and resample calls vary in length, so use the average
+	u32		mix_samples( 0 ), resample_samples( 0 );
+	for( u32 i = 0; i < trace.Mix.size(); ++i )			mix_samples += trace.Mix[ i ].In.size();
+	for( u32 i = 0; i < trace.Resample.size(); ++i )	resample_samples += 2 * trace.Resample[ i ].NumWords;
+
+	bool	exact( true );
+	exact &= Bench( "Mix", trace.Mix, trace.Mix.empty() ? 1 : mix_samples / trace.Mix.size(), RunMix, kernels );
+	exact &= Bench( "Resample", trace.Resample, trace.Resample.empty() ? 1 : resample_samples / trace.Resample.size(), RunResample, kernels );
+	exact &= Bench( "DecodeADPCM", trace.ADPCM, 16, RunADPCM, kernels );
+	exact &= Bench( "EnvMix", trace.EnvMix, 8, RunEnvMix, kernels );
+
+	if( !exact )
+	{
+		printf( "Vector kernels are not bit exact!\n" );
+		return 1;
+	}
+	return 0;
+}
@@ -30,26 +30,52 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <string.h>
 
 #include "audiohle.h"
+#include "AudioHLEKernels.h"
 
 #include "Math/MathUtil.h"
 #include "Utility/FastMemcpy.h"
 
-inline s32		FixedPointMulFull16( s32 a, s32 b )
+#ifdef DAEDALUS_CAPTURE_AUDIO_TRACE
+#include <stdio.h>
+#endif
+
+AudioHLEState gAudioHLEState;
+
+// The vector kernels work on up to 16 samples at once, so buffers that partially overlap within that need the scalar ones
+static inline bool BuffersClash( const void * a, const void * b )
 {
-	return s32( ( (s64)a * (s64)b ) >> 16 );
+	s64		diff( (const u8 *)a - (const u8 *)b );
+	return diff != 0 && diff > -32 && diff < 32;
 }
 
-inline s32		FixedPointMul16( s32 a, s32 b )
+#ifdef DAEDALUS_CAPTURE_AUDIO_TRACE
+static FILE *		gAudioTraceFile {};
+
+//
+//	The inputs to each kernel call, in the format read by HLEAudio/AudioHLEKernels_bench.cpp.
+//	Each record is a u32 tag followed by:
+//	'M'	s32 gain, u32 n, s16 in[n], s16 out[n]
+//	'R'	u32 src_ptr, u32 accumulator, u32 pitch, u32 num_words, u32 first, u32 n, s16 in[first..first+n)
+//	'A'	s32 l1, s32 l2, s32 input[16], s16 book1[8], s16 book2[8]
+//	'E'	EnvMixRamp left, EnvMixRamp right, s16 dry, s16 wet, u32 aux, s16 in[8], out[8], aux1[8], aux2[8], aux3[8]
+//
+static void AudioTrace_Write( const void * data, u32 size )
 {
-	return s32( ( a * b ) >> 16 );
+	if( gAudioTraceFile == NULL )
+	{
+		gAudioTraceFile = fopen( "audio_trace.bin", "wb" );
+	}
+	if( gAudioTraceFile != NULL )
+	{
+		fwrite( data, size, 1, gAudioTraceFile );
+	}
 }
 
-inline s32		FixedPointMul15( s32 a, s32 b )
+template< typename T > static void AudioTrace_Write( const T & value )
 {
-	return s32( ( a * b ) >> 15 );
+	AudioTrace_Write( &value, sizeof( T ) );
 }
-
-AudioHLEState gAudioHLEState;
+#endif
 
 void	AudioHLEState::ClearBuffer( u16 addr, u16 count )
 {
@@ -70,9 +96,7 @@ void	AudioHLEState::EnvMixer( u8 flags, u32 address )
 	s16 *aux1 {(s16 *)(Buffer+AuxA)};
 	s16 *aux2 {(s16 *)(Buffer+AuxC)};
 	s16 *aux3 {(s16 *)(Buffer+AuxE)};
-	s32 MainR {}, MainL {}, AuxR {}, AuxL {};
 
-	s32 i1 {},o1 {},a1 {},a2 {},a3 {};
 	u16 AuxIncRate{1};
 	s16 zero[8] {};
 	memset(zero,0,16);
@@ -83,7 +107,6 @@ void	AudioHLEState::EnvMixer( u8 flags, u32 address )
 	u32 ptr {};
 	s32 RRamp {}, LRamp {};
 	s32 LAdderStart{} , RAdderStart {}, LAdderEnd {}, RAdderEnd {};
-	s32 oMainR {}, oMainL {}, oAuxR {}, oAuxL {};
 
 	s16* buff {(s16*)(rdram+address)};
 
@@ -127,10 +150,15 @@ void	AudioHLEState::EnvMixer( u8 flags, u32 address )
 		aux2 = aux3 = zero;
 	}
 
-	oMainL = (Dry * (LTrg>>16) + 0x4000) >> 15;
-	oAuxL  = (Wet * (LTrg>>16) + 0x4000) >> 15;
-	oMainR = (Dry * (RTrg>>16) + 0x4000) >> 15;
-	oAuxR  = (Wet * (RTrg>>16) + 0x4000) >> 15;
+	bool clash {BuffersClash( inp, out ) || BuffersClash( inp, aux1 ) || BuffersClash( out, aux1 )};
+	if (AuxIncRate)
+	{
+		const s16 * buffers[] = { inp, out, aux1, aux2, aux3 };
+		for (u32 i {3}; i < 5; i++)
+			for (u32 j {}; j < i; j++)
+				clash |= BuffersClash( buffers[i], buffers[j] );
+	}
+	const AudioHLEKernels & kernels( clash ? gAudioHLEKernelsScalar : *gAudioHLEKernels );
 
 	for (s32 y {}; y < Count; y += 0x10)
 	{
@@ -174,117 +202,30 @@ void	AudioHLEState::EnvMixer( u8 flags, u32 address )
 			RVol = 0;
 		}
 
-		for (s32 x {}; x < 8; x++)
-		{
-			i1=(s32)inp[ptr^1];
-			o1=(s32)out[ptr^1];
-			a1=(s32)aux1[ptr^1];
-			if (AuxIncRate)
-			{
-				a2=(s32)aux2[ptr^1];
-				a3=(s32)aux3[ptr^1];
-			}
-			// TODO: here...
-			//LAcc = LTrg;
-			//RAcc = RTrg;
-
-			LAcc += LVol;
-			RAcc += RVol;
-
-			if (LVol <= 0)
-			{
-				// Decrementing
-				if (LAcc < LTrg)
-				{
-					LAcc = LTrg;
-					LAdderStart = LTrg;
-					MainL = oMainL;
-					AuxL  = oAuxL;
-				}
-				else
-				{
-					MainL = (Dry * ((s32)LAcc>>16) + 0x4000) >> 15;
-					AuxL  = (Wet * ((s32)LAcc>>16) + 0x4000) >> 15;
-				}
-			}
-			else
-			{
-				if (LAcc > LTrg)
-				{
-					LAcc = LTrg;
-					LAdderStart = LTrg;
-					MainL = oMainL;
-					AuxL  = oAuxL;
-				}
-				else
-				{
-					MainL = (Dry * ((s32)LAcc>>16) + 0x4000) >> 15;
-					AuxL  = (Wet * ((s32)LAcc>>16) + 0x4000) >> 15;
-				}
-			}
-
-			if (RVol <= 0)
-			{
-				// Decrementing
-				if (RAcc < RTrg)
-				{
-					RAcc = RTrg;
-					RAdderStart = RTrg;
-					MainR = oMainR;
-					AuxR  = oAuxR;
-				}
-				else
-				{
-					MainR = (Dry * ((s32)RAcc>>16) + 0x4000) >> 15;
-					AuxR  = (Wet * ((s32)RAcc>>16) + 0x4000) >> 15;
-				}
-			}
-			else
-			{
-				if (RAcc > RTrg)
-				{
-					RAcc = RTrg;
-					RAdderStart = RTrg;
-					MainR = oMainR;
-					AuxR  = oAuxR;
-				}
-				else
-				{
-					MainR = (Dry * ((s32)RAcc>>16) + 0x4000) >> 15;
-					AuxR  = (Wet * ((s32)RAcc>>16) + 0x4000) >> 15;
-				}
-			}
-
-			//fprintf (dfile, "%04X ", (LAcc>>16));
-
-			o1 += (/*(o1*0x7fff)+*/(i1*MainR) + 0x4000) >> 15;
-			a1 += (/*(a1*0x7fff)+*/ (i1*MainL) + 0x4000) >> 15;
-
-			/*		o1=((s64)(((s64)o1*0xfffe)+((s64)i1*MainR*2)+0x8000)>>16);
-
-			a1=((s64)(((s64)a1*0xfffe)+((s64)i1*MainL*2)+0x8000)>>16);*/
-
-			o1 = Saturate<s16>( o1 );
-			a1 = Saturate<s16>( a1 );
-
-			out[ptr^1]=o1;
-			aux1[ptr^1]=a1;
-			if (AuxIncRate)
-			{
-				//a2=((s64)(((s64)a2*0xfffe)+((s64)i1*AuxR*2)+0x8000)>>16);
-
-				//a3=((s64)(((s64)a3*0xfffe)+((s64)i1*AuxL*2)+0x8000)>>16);
-				a2+=(/*(a2*0x7fff)+*/(i1*AuxR)+0x4000)>>15;
-				a3+=(/*(a3*0x7fff)+*/(i1*AuxL)+0x4000)>>15;
-
-				a2 = Saturate<s16>( a2 );
-				a3 = Saturate<s16>( a3 );
-
-				aux2[ptr^1]=a2;
-				aux3[ptr^1]=a3;
-			}
-			ptr++;
-		}
+		EnvMixRamp left {LAcc, LVol, LTrg};
+		EnvMixRamp right {RAcc, RVol, RTrg};
+
+#ifdef DAEDALUS_CAPTURE_AUDIO_TRACE
+		AudioTrace_Write( u32( 'E' ) );
+		AudioTrace_Write( left );
+		AudioTrace_Write( right );
+		AudioTrace_Write( Dry );
+		AudioTrace_Write( Wet );
+		AudioTrace_Write( u32( AuxIncRate ) );
+		AudioTrace_Write( inp + ptr, 16 );
+		AudioTrace_Write( out + ptr, 16 );
+		AudioTrace_Write( aux1 + ptr, 16 );
+		AudioTrace_Write( AuxIncRate ? aux2 + ptr : zero, 16 );
+		AudioTrace_Write( AuxIncRate ? aux3 + ptr : zero, 16 );
+#endif
+		u32 reached {kernels.EnvMix( out + ptr, aux1 + ptr, aux2 + ptr * AuxIncRate, aux3 + ptr * AuxIncRate, inp + ptr,
+									  left, right, Dry, Wet, AuxIncRate != 0 )};
+		if (reached & 1)
+			LAdderStart = LTrg;
+		if (reached & 2)
+			RAdderStart = RTrg;
+
+		ptr += 8;
 	}
 
 	/*LAcc = LAdderEnd;
@@ -314,7 +255,7 @@ void	AudioHLEState::Resample( u8 flags, u32 pitch, u32 address )
 	u32		srcPtr((InBuffer / 2) - 1);
 	u32		dstPtr(OutBuffer / 4);
 
-	u32 accumulator {}, tmp {};
+	u32 accumulator {};
 
 	if (flags & 0x1)
 	{
@@ -327,20 +268,32 @@ void	AudioHLEState::Resample( u8 flags, u32 pitch, u32 address )
 		accumulator = *(u16 *)(rdram + address + 10);
 	}
 
-	for(u32 i = (((Count + 0xF) & 0xFFF0) >> 2); i != 0 ; i-- )
-	{
-		tmp =  (in[srcPtr^1] + FixedPointMul16( in[(srcPtr+1)^1] - in[srcPtr^1], accumulator )) << 16;
-		accumulator += pitch;
-		srcPtr += accumulator >> 16;
-		accumulator &= 0xFFFF;
+	u32 num_words( ((Count + 0xF) & 0xFFF0) >> 2 );
+
+	// The range of samples this might read (allowing for the ^1), and write
+	u64 in_begin {srcPtr & ~1};
+	u64 in_end {((srcPtr + ((accumulator + u64( num_words * 2 ) * pitch) >> 16) + 1) | 1) + 1};
+	u64 out_begin {u64( dstPtr ) * 2};
+	u64 out_end {out_begin + num_words * 2};
 
-		tmp |= (in[srcPtr^1] + FixedPointMul16( in[(srcPtr+1)^1] - in[srcPtr^1], accumulator )) & 0xFFFF;
-		accumulator += pitch;
-		srcPtr += accumulator >> 16;
-		accumulator &= 0xFFFF;
+	// The scalar kernel handles the output feeding back into the input in the same way as the RSP
+	bool clash {in_begin < out_end && out_begin < in_end};
+	const AudioHLEKernels & kernels( clash ? gAudioHLEKernelsScalar : *gAudioHLEKernels );
 
-		out[dstPtr++] = tmp;
+#ifdef DAEDALUS_CAPTURE_AUDIO_TRACE
+	if (in_end <= sizeof( Buffer ) / sizeof( s16 ))
+	{
+		AudioTrace_Write( u32( 'R' ) );
+		AudioTrace_Write( srcPtr );
+		AudioTrace_Write( accumulator );
+		AudioTrace_Write( pitch );
+		AudioTrace_Write( num_words );
+		AudioTrace_Write( u32( in_begin ) );
+		AudioTrace_Write( u32( in_end - in_begin ) );
+		AudioTrace_Write( in + in_begin, u32( in_end - in_begin ) * sizeof( s16 ) );
 	}
+#endif
+	srcPtr = kernels.Resample( out + dstPtr, in, srcPtr, accumulator, pitch, num_words );
 
 	((u16 *)rdram)[((address >> 1))^1] = in[srcPtr^1];
 	*(u16 *)(rdram + address + 10) = (u16)accumulator;
@@ -380,86 +333,6 @@ inline void AudioHLEState::ExtractSamples( s32 * output, u32 inPtr ) const
 	*output++ = (s16)((icode&0x0f)<<12);
 }
 
-//
-//	l1/l2 are IN/OUT
-//
-inline void DecodeSamples( s16 * out, s32 & l1, s32 & l2, const s32 * input, const s16 * book1, const s16 * book2 )
-{
-	s32 a[8] {};
-
-	a[0] = (s32)book1[0]*l1;
-	a[0] += (s32)book2[0]*l2;
-	a[0] += input[0]*2048;
-
-	a[1] = (s32)book1[1]*l1;
-	a[1] += (s32)book2[1]*l2;
-	a[1] += (s32)book2[0]*input[0];
-	a[1] += input[1]*2048;
-
-	a[2] = (s32)book1[2]*l1;
-	a[2] += (s32)book2[2]*l2;
-	a[2] += (s32)book2[1]*input[0];
-	a[2] += (s32)book2[0]*input[1];
-	a[2] += input[2]*2048;
-
-	a[3] = (s32)book1[3]*l1;
-	a[3] += (s32)book2[3]*l2;
-	a[3] += (s32)book2[2]*input[0];
-	a[3] += (s32)book2[1]*input[1];
-	a[3] += (s32)book2[0]*input[2];
-	a[3] += input[3]*2048;
-
-	a[4] = (s32)book1[4]*l1;
-	a[4] += (s32)book2[4]*l2;
-	a[4] += (s32)book2[3]*input[0];
-	a[4] += (s32)book2[2]*input[1];
-	a[4] += (s32)book2[1]*input[2];
-	a[4] += (s32)book2[0]*input[3];
-	a[4] += input[4]*2048;
-
-	a[5] = (s32)book1[5]*l1;
-	a[5] += (s32)book2[5]*l2;
-	a[5] += (s32)book2[4]*input[0];
-	a[5] += (s32)book2[3]*input[1];
-	a[5] += (s32)book2[2]*input[2];
-	a[5] += (s32)book2[1]*input[3];
-	a[5] += (s32)book2[0]*input[4];
-	a[5] += input[5]*2048;
-
-	a[6] = (s32)book1[6]*l1;
-	a[6] += (s32)book2[6]*l2;
-	a[6] += (s32)book2[5]*input[0];
-	a[6] += (s32)book2[4]*input[1];
-	a[6] += (s32)book2[3]*input[2];
-	a[6] += (s32)book2[2]*input[3];
-	a[6] += (s32)book2[1]*input[4];
-	a[6] += (s32)book2[0]*input[5];
-	a[6] += input[6]*2048;
-
-	a[7] = (s32)book1[7]*l1;
-	a[7] += (s32)book2[7]*l2;
-	a[7] += (s32)book2[6]*input[0];
-	a[7] += (s32)book2[5]*input[1];
-	a[7] += (s32)book2[4]*input[2];
-	a[7] += (s32)book2[3]*input[3];
-	a[7] += (s32)book2[2]*input[4];
-	a[7] += (s32)book2[1]*input[5];
-	a[7] += (s32)book2[0]*input[6];
-	a[7] += input[7]*2048;
-
-	*out++ =      Saturate<s16>( a[1] >> 11 );
-	*out++ =      Saturate<s16>( a[0] >> 11 );
-	*out++ =      Saturate<s16>( a[3] >> 11 );
-	*out++ =      Saturate<s16>( a[2] >> 11 );
-	*out++ =      Saturate<s16>( a[5] >> 11 );
-	*out++ =      Saturate<s16>( a[4] >> 11 );
-	*out++ = l2 = Saturate<s16>( a[7] >> 11 );
-	*out++ = l1 = Saturate<s16>( a[6] >> 11 );
-}
-
-
-
-
 void AudioHLEState::ADPCMDecode( u8 flags, u32 address )
 {
 	bool	init( (flags&0x1) != 0 );
@@ -482,8 +355,7 @@ void AudioHLEState::ADPCMDecode( u8 flags, u32 address )
 	s32 l2 {out[14]};
 	out+=16;
 
-	s32 inp1[8] {};
-	s32 inp2[8] {};
+	s32 inp[16] {};
 
 	s32 count {(s16)Count};		// XXXX why convert this to signed?
 	while(count>0)
@@ -509,17 +381,24 @@ void AudioHLEState::ADPCMDecode( u8 flags, u32 address )
 														// that this could be negative, in which case we do
 														// not use the calculated vscale value... see the
 														// if(code>12) check below
-			ExtractSamplesScale( inp1, inPtr + 0, vscale );
-			ExtractSamplesScale( inp2, inPtr + 4, vscale );
+			ExtractSamplesScale( inp + 0, inPtr + 0, vscale );
+			ExtractSamplesScale( inp + 8, inPtr + 4, vscale );
 		}
 		else
 		{
-			ExtractSamples( inp1, inPtr + 0 );
-			ExtractSamples( inp2, inPtr + 4 );
+			ExtractSamples( inp + 0, inPtr + 0 );
+			ExtractSamples( inp + 8, inPtr + 4 );
 		}
 
-		DecodeSamples( out + 0, l1, l2, inp1, book1, book2 );
-		DecodeSamples( out + 8, l1, l2, inp2, book1, book2 );
+#ifdef DAEDALUS_CAPTURE_AUDIO_TRACE
+		AudioTrace_Write( u32( 'A' ) );
+		AudioTrace_Write( l1 );
+		AudioTrace_Write( l2 );
+		AudioTrace_Write( inp );
+		AudioTrace_Write( book1, 16 );
+		AudioTrace_Write( book2, 16 );
+#endif
+		gAudioHLEKernels->DecodeADPCM( out, l1, l2, inp, book1, book2 );
 
 		inPtr += 8;
 		out += 16;
@@ -658,11 +537,15 @@ void	AudioHLEState::Mixer( u16 dmemout, u16 dmemin, s32 gain, u16 count )
 	s16*  in( (s16 *)(Buffer + dmemin) );
 	s16* out( (s16 *)(Buffer + dmemout) );
 
-	for( u32 x = count >> 1; x != 0; x-- )
-	{
-		*out = Saturate<s16>( FixedPointMul15( *in++, gain ) + s32( *out ) );
-		out++;
-	}
+#ifdef DAEDALUS_CAPTURE_AUDIO_TRACE
+	AudioTrace_Write( u32( 'M' ) );
+	AudioTrace_Write( gain );
+	AudioTrace_Write( u32( count >> 1 ) );
+	AudioTrace_Write( in, (count >> 1) * sizeof( s16 ) );
+	AudioTrace_Write( out, (count >> 1) * sizeof( s16 ) );
+#endif
+	const AudioHLEKernels & kernels( BuffersClash( out, in ) ? gAudioHLEKernelsScalar : *gAudioHLEKernels );
+	kernels.Mix( out, in, gain, count >> 1 );
 
 #else
 	for( u32 x {}; x < count; x+=2 )
@@ -91,6 +91,9 @@ public:
 	s16		EnvDry;				// 0x001C(T8)
 	s16		EnvWet;				// 0x001E(T8)
 
+	s32		FilterCount;		// ABI2 FILTER (Zelda)
+	u32		FilterLut;			// RDRAM address of the filter's coefficients
+
 };
 
 extern AudioHLEState gAudioHLEState;
@@ -0,0 +1,332 @@
+/*
+Copyright (C) 2001,2006-2007 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+//
+//	Runs audio tasks on a worker thread, so the alist is processed while the
+//	CPU carries on emulating.
+//
+//	Before a task is queued its alist is scanned (see the ABIs' AudioHLEScanners)
+//	for the RDRAM it will read and write. The ranges it reads are copied into a
+//	private copy of RDRAM, which the worker runs the alist against. When the
+//	CPU_EVENT_AUDIO scheduled for the task fires, the ranges it wrote are copied
+//	back and the SP is flagged as done, just like a task run synchronously.
+//
+//	The SP only runs one task at a time, so while a task is in flight the worker
+//	has gAudioHLEState to itself.
+//
+
+#include "stdafx.h"
+#include "AudioHLETask.h"
+
+#ifdef DAEDALUS_AUDIO_HLE_TASKS
+
+#include <string.h>
+
+#include "audiohle.h"
+#include "AudioHLEProcessor.h"
+
+#include "Core/CPU.h"
+#include "Core/Memory.h"
+#include "Debug/DBGConsole.h"
+#include "OSHLE/ultra_sptask.h"
+#include "Utility/Cond.h"
+#include "Utility/Mutex.h"
+#include "Utility/Thread.h"
+
+extern bool isMKABI;
+extern bool isZeldaABI;
+
+// How long after starting a task CPU_EVENT_AUDIO completes it. About 1ms of emulated time,
+// which is in the region of what the RSP takes over a typical alist.
+static const s32	kAudioTaskCycles = 50000;
+
+static const u32	kShadowRamSize = MAX_RAM_ADDRESS;
+
+static Mutex		gTaskMutex( "AudioHLETask" );
+static Cond *		gTaskQueuedCond {};		// Signalled when there's a task for the worker, or it should quit
+static Cond *		gTaskDoneCond {};		// Signalled when the worker finishes a task
+static ThreadHandle	gTaskThread {kInvalidThreadHandle};
+
+// Shared with the worker, protected by gTaskMutex
+static bool			gTaskQueued {};
+static bool			gWorkerQuit {};
+static u32			gTaskDataPtr {};
+static u32			gTaskDataSize {};
+
+// Only touched by the emulation thread, or by the worker while gTaskQueued is set
+static u8 *			gShadowRam {};
+static AudioHLEScan	gTaskScan;
+static bool			gTaskInFlight {};
+
+#ifdef DAEDALUS_VERIFY_AUDIO_TASKS
+static const u8		kShadowPoison = 0xCD;
+static AudioHLEState	gVerifyStateBefore;
+static AudioHLEState	gVerifyStateAsync;
+static u32			gVerifyTaskCount {};
+#endif
+
+static u32 DAEDALUS_THREAD_CALL_TYPE AudioHLETask_WorkerThread( void * arg )
+{
+	MutexLock	lock( &gTaskMutex );
+
+	for( ;; )
+	{
+		while( !gTaskQueued && !gWorkerQuit )
+		{
+			CondWait( gTaskQueuedCond, &gTaskMutex, kTimeoutInfinity );
+		}
+
+		if( gWorkerQuit )
+			break;
+
+		u32		data_ptr( gTaskDataPtr );
+		u32		data_size( gTaskDataSize );
+
+		gTaskMutex.Unlock();
+		Audio_UcodeAList( gShadowRam, data_ptr, data_size );
+		gTaskMutex.Lock();
+
+		gTaskQueued = false;
+		CondSignal( gTaskDoneCond );
+	}
+
+	return 0;
+}
+
+bool AudioHLETask_Init()
+{
+	gTaskQueuedCond = CondCreate();
+	gTaskDoneCond = CondCreate();
+	return gTaskQueuedCond != NULL && gTaskDoneCond != NULL;
+}
+
+void AudioHLETask_Fini()
+{
+	AudioHLETask_Flush();
+
+	if( gTaskThread != kInvalidThreadHandle )
+	{
+		{
+			MutexLock	lock( &gTaskMutex );
+			gWorkerQuit = true;
+			CondSignal( gTaskQueuedCond );
+		}
+		JoinThread( gTaskThread, -1 );
+		ReleaseThreadHandle( gTaskThread );
+		gTaskThread = kInvalidThreadHandle;
+		gWorkerQuit = false;
+	}
+
+	if( gTaskQueuedCond != NULL )	{ CondDestroy( gTaskQueuedCond ); gTaskQueuedCond = NULL; }
+	if( gTaskDoneCond != NULL )		{ CondDestroy( gTaskDoneCond ); gTaskDoneCond = NULL; }
+
+	delete [] gShadowRam;
+	gShadowRam = NULL;
+}
+
+static bool AudioHLETask_StartWorker()
+{
+	if( gTaskThread != kInvalidThreadHandle )
+		return true;
+
+	gShadowRam = new u8[ kShadowRamSize ];
+#ifdef DAEDALUS_VERIFY_AUDIO_TASKS
+	memset( gShadowRam, kShadowPoison, kShadowRamSize );
+#endif
+
+	gTaskThread = CreateThread( "AudioHLETask", AudioHLETask_WorkerThread, NULL );
+	if( gTaskThread == kInvalidThreadHandle )
+	{
+		#ifdef DAEDALUS_DEBUG_CONSOLE
+		DBGConsole_Msg( 0, "Unable to start the audio task thread - running audio tasks synchronously" );
+		#endif
+		delete [] gShadowRam;
+		gShadowRam = NULL;
+		return false;
+	}
+	return true;
+}
+
+static bool AudioHLETask_RangesFit( const std::vector< AudioRamRange > & ranges )
+{
+	for( size_t i {}; i < ranges.size(); ++i )
+	{
+		if( ranges[ i ].Address + ranges[ i ].Length > kShadowRamSize )
+			return false;
+	}
+	return true;
+}
+
+static void AudioHLETask_Queue( u32 data_ptr, u32 data_size )
+{
+	// The worker is idle, so its copy of RDRAM can be updated directly
+	for( size_t i {}; i < gTaskScan.Reads.size(); ++i )
+	{
+		const AudioRamRange &	range( gTaskScan.Reads[ i ] );
+		memcpy( gShadowRam + range.Address, g_pu8RamBase + range.Address, range.Length );
+	}
+
+	MutexLock	lock( &gTaskMutex );
+	gTaskDataPtr = data_ptr;
+	gTaskDataSize = data_size;
+	gTaskQueued = true;
+	CondSignal( gTaskQueuedCond );
+}
+
+static void AudioHLETask_Wait()
+{
+	MutexLock	lock( &gTaskMutex );
+	while( gTaskQueued )
+	{
+		CondWait( gTaskDoneCond, &gTaskMutex, kTimeoutInfinity );
+	}
+}
+
+#ifdef DAEDALUS_VERIFY_AUDIO_TASKS
+//
+//	Runs the task on the worker, then synchronously from the same starting point,
+//	and reports any difference. The synchronous results are the ones kept.
+//	The worker's copy of RDRAM is poisoned outside the scanned ranges, so reads
+//	the scanner missed show up as differences, and writes it missed are caught here.
+//
+static void AudioHLETask_Verify( u32 data_ptr, u32 data_size )
+{
+	bool	mk_abi( isMKABI );
+	bool	zelda_abi( isZeldaABI );
+
+	gVerifyStateBefore = gAudioHLEState;
+
+	AudioHLETask_Queue( data_ptr, data_size );
+	AudioHLETask_Wait();
+
+	gVerifyStateAsync = gAudioHLEState;
+	bool	mk_abi_async( isMKABI );
+	bool	zelda_abi_async( isZeldaABI );
+
+	gAudioHLEState = gVerifyStateBefore;
+	isMKABI = mk_abi;
+	isZeldaABI = zelda_abi;
+	Audio_UcodeAList( g_pu8RamBase, data_ptr, data_size );
+	Audio_MarkWrites( gTaskScan );
+
+	bool	state_matches( memcmp( &gAudioHLEState, &gVerifyStateAsync, sizeof( AudioHLEState ) ) == 0 &&
+						   isMKABI == mk_abi_async && isZeldaABI == zelda_abi_async );
+	if( !state_matches )
+	{
+		#ifdef DAEDALUS_DEBUG_CONSOLE
+		DBGConsole_Msg( 0, "[RAudio task %d: state differs from the synchronous run]", gVerifyTaskCount );
+		#endif
+	}
+
+	for( size_t i {}; i < gTaskScan.Writes.size(); ++i )
+	{
+		const AudioRamRange &	range( gTaskScan.Writes[ i ] );
+		if( memcmp( gShadowRam + range.Address, g_pu8RamBase + range.Address, range.Length ) != 0 )
+		{
+			#ifdef DAEDALUS_DEBUG_CONSOLE
+			DBGConsole_Msg( 0, "[RAudio task %d: RDRAM 0x%08x-0x%08x differs from the synchronous run]",
+							gVerifyTaskCount, range.Address, range.Address + range.Length );
+			#endif
+		}
+	}
+
+	for( size_t i {}; i < gTaskScan.Reads.size(); ++i )
+	{
+		const AudioRamRange &	range( gTaskScan.Reads[ i ] );
+		memset( gShadowRam + range.Address, kShadowPoison, range.Length );
+	}
+
+	for( u32 i {}; i < kShadowRamSize; ++i )
+	{
+		if( gShadowRam[ i ] != kShadowPoison )
+		{
+			#ifdef DAEDALUS_DEBUG_CONSOLE
+			DBGConsole_Msg( 0, "[RAudio task %d: wrote to RDRAM 0x%08x, which wasn't scanned]", gVerifyTaskCount, i );
+			#endif
+			memset( gShadowRam, kShadowPoison, kShadowRamSize );
+			break;
+		}
+	}
+
+	gVerifyTaskCount++;
+}
+#endif // DAEDALUS_VERIFY_AUDIO_TASKS
+
+EProcessResult AudioHLETask_Start()
+{
+	// A game shouldn't be able to start a task while one is in flight, as the SP isn't halted until it completes
+	if( gTaskInFlight )
+	{
+		AudioHLETask_Flush();
+	}
+
+	if( !AudioHLETask_StartWorker() ||
+		!Audio_ScanUcode( gTaskScan ) ||
+		!AudioHLETask_RangesFit( gTaskScan.Reads ) )
+	{
+		Audio_Ucode();
+		return PR_COMPLETED;
+	}
+
+	OSTask *	task( (OSTask *)(g_pu8SpMemBase + 0x0FC0) );
+	u32			data_ptr( (u32)(uintptr_t)task->t.data_ptr );
+	u32			data_size( task->t.data_size );
+
+#ifdef DAEDALUS_VERIFY_AUDIO_TASKS
+	AudioHLETask_Verify( data_ptr, data_size );
+	return PR_COMPLETED;
+#else
+	AudioHLETask_Queue( data_ptr, data_size );
+	gTaskInFlight = true;
+
+	CPU_AddEvent( kAudioTaskCycles, CPU_EVENT_AUDIO );
+	return PR_STARTED;
+#endif
+}
+
+bool AudioHLETask_Finish()
+{
+	if( !gTaskInFlight )
+		return false;
+
+	AudioHLETask_Wait();
+
+	for( size_t i {}; i < gTaskScan.Writes.size(); ++i )
+	{
+		const AudioRamRange &	range( gTaskScan.Writes[ i ] );
+		memcpy( g_pu8RamBase + range.Address, gShadowRam + range.Address, range.Length );
+	}
+	Audio_MarkWrites( gTaskScan );
+
+	gTaskInFlight = false;
+	return true;
+}
+
+void AudioHLETask_Flush()
+{
+	// The task completes now rather than when its event was due. Its event is dropped, so it
+	// can't complete a later task early or leave two audio events in the queue.
+	if( AudioHLETask_Finish() )
+	{
+		CPU_RemoveEvent( CPU_EVENT_AUDIO );
+		RSP_HLE_Finished( SP_STATUS_TASKDONE|SP_STATUS_BROKE|SP_STATUS_HALT );
+	}
+}
+
+#endif // DAEDALUS_AUDIO_HLE_TASKS
@@ -0,0 +1,92 @@
+/*
+Copyright (C) 2001,2006-2007 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#pragma once
+
+#ifndef HLEAUDIO_AUDIOHLETASK_H_
+#define HLEAUDIO_AUDIOHLETASK_H_
+
+#include <vector>
+
+#include "Core/RSP_HLE.h"
+#include "Utility/DaedalusTypes.h"
+
+// The PSP runs audio tasks asynchronously on the ME instead (see SysPSP/HLEAudio/AudioPluginPSP.cpp)
+#ifndef DAEDALUS_PSP
+#define DAEDALUS_AUDIO_HLE_TASKS
+#endif
+
+struct AudioRamRange
+{
+	u32		Address;
+	u32		Length;
+};
+
+//
+//	The RDRAM an alist touches, filled in by the ABI's AudioHLEScanner.
+//	Ranges are rounded out to whole words, as the ABI code swizzles within them.
+//
+struct AudioHLEScan
+{
+	void	Clear()								{ Reads.clear(); Writes.clear(); }
+
+	void	Read( u32 address, u32 length )		{ Add( Reads, address, length ); }
+
+	// Anything written is read too, so that bytes in the range the task doesn't write keep their value
+	void	Write( u32 address, u32 length )	{ Add( Reads, address, length ); Add( Writes, address, length ); }
+
+	// Mirrors of the AudioHLEState fields which the alist's addresses depend on
+	u16		Count;
+	u32		LoopVal;
+
+	std::vector< AudioRamRange >	Reads;
+	std::vector< AudioRamRange >	Writes;
+
+private:
+	static void	Add( std::vector< AudioRamRange > & ranges, u32 address, u32 length )
+	{
+		if( length > 0 )
+		{
+			u32		begin( address & ~3 );
+			u32		end( ( address + length + 3 ) & ~3 );
+			AudioRamRange	range = { begin, end - begin };
+			ranges.push_back( range );
+		}
+	}
+};
+
+#ifdef DAEDALUS_AUDIO_HLE_TASKS
+
+bool			AudioHLETask_Init();
+void			AudioHLETask_Fini();
+
+// Starts the task in SP memory on the worker thread. Returns PR_STARTED if it was queued, in which case
+// CPU_EVENT_AUDIO completes it, or PR_COMPLETED if it had to be run synchronously.
+EProcessResult	AudioHLETask_Start();
+
+// Waits for the worker and writes the task's output back to RDRAM. Called for CPU_EVENT_AUDIO.
+// Returns false if there was no task in flight.
+bool			AudioHLETask_Finish();
+
+// Completes any task in flight right away and drops its CPU_EVENT_AUDIO, e.g. before a savestate is taken
+void			AudioHLETask_Flush();
+
+#endif // DAEDALUS_AUDIO_HLE_TASKS
+
+#endif // HLEAUDIO_AUDIOHLETASK_H_
@@ -28,7 +28,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "stdafx.h"
 #include "audiohle.h"
 #include "AudioHLEProcessor.h"
+#include "AudioHLETask.h"
 
+#include "Core/DirtyPages.h"
 #include "OSHLE/ultra_sptask.h"
 
 #include "Utility/Profiler.h"
@@ -52,18 +54,21 @@ AudioHLEInstruction ABIUnknown [0x20] = { // Unknown ABI
 //				 60% of all games use this.  Distributed 3rd Party ABI
 //
 extern AudioHLEInstruction ABI1[0x20];
+bool ABI1_Scan( const u32 * p_alist, u32 num_commands, AudioHLEScan & scan );
 //---------------------------------------------------------------------------------------------
 //
 //     ABI 2 : WaveRace JAP, MarioKart 64, Mario64 JAP RumbleEdition,
 //				 Yoshi Story, Pokemon Games, Zelda64, Zelda MoM (miyamoto)
 //				 Most NCL or NOA games (Most commands)
 extern AudioHLEInstruction ABI2[0x20];
+bool ABI2_Scan( const u32 * p_alist, u32 num_commands, AudioHLEScan & scan );
 //---------------------------------------------------------------------------------------------
 //
 //     ABI 3 : DK64, Perfect Dark, Banjo Kazooi, Banjo Tooie
 //				 All RARE games except Golden Eye 007
 //
 extern AudioHLEInstruction ABI3[0x20];
+bool ABI3_Scan( const u32 * p_alist, u32 num_commands, AudioHLEScan & scan );
 //---------------------------------------------------------------------------------------------
 //
 //     ABI 5 : Factor 5 - MoSys/MusyX
@@ -76,7 +81,9 @@ extern AudioHLEInstruction ABI3[0x20];
 
 
 AudioHLEInstruction *ABI = ABIUnknown;
+AudioHLEScanner ABIScanner = NULL;		// NULL if the ABI's alists can only be run synchronously
 bool bAudioChanged = false;
+u8 * gAudioHLERamBase = NULL;
 extern bool isMKABI;
 extern bool isZeldaABI;
 
@@ -95,20 +102,32 @@ void Audio_Reset()
 //*****************************************************************************
 inline void Audio_Ucode_Detect(OSTask * pTask)
 {
-	u8* p_base {g_pu8RamBase + (u32)pTask->t.ucode_data};
+	u8* p_base {g_pu8RamBase + (u32)(uintptr_t)pTask->t.ucode_data};
 	if (*(u32*)(p_base + 0) != 0x01)
 	{
 		if (*(u32*)(p_base + 0x10) == 0x00000001)
+		{
 			ABI = ABIUnknown;
+			ABIScanner = NULL;
+		}
 		else
+		{
 			ABI = ABI3;
+			ABIScanner = ABI3_Scan;
+		}
 	}
 	else
 	{
 		if (*(u32*)(p_base + 0x30) == 0xF0000F00)
+		{
 			ABI = ABI1;
+			ABIScanner = ABI1_Scan;
+		}
 		else
+		{
 			ABI = ABI2;
+			ABIScanner = ABI2_Scan;
+		}
 	}
 }
 
@@ -130,11 +149,74 @@ void Audio_Ucode()
 		Audio_Ucode_Detect( pTask );
 	}
 
+	// The ABIs write straight to RDRAM, so the alist is scanned first to find out which pages it writes.
+	// It has to be scanned before it's run, as the addresses depend on the state it starts from.
+	static AudioHLEScan	scan;
+	bool	track_writes {DirtyPages_IsReliable()};
+	bool	scanned {track_writes && Audio_ScanUcode( scan )};
+
+	Audio_UcodeAList( g_pu8RamBase, (u32)(uintptr_t)pTask->t.data_ptr, pTask->t.data_size );
+
+	if ( scanned )
+	{
+		Audio_MarkWrites( scan );
+	}
+	else if ( track_writes )
+	{
+		DirtyPages_MarkAll();
+	}
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void Audio_MarkWrites( const AudioHLEScan & scan )
+{
+	for( size_t i {}; i < scan.Writes.size(); ++i )
+	{
+		DirtyPages_MarkRange( scan.Writes[ i ].Address, scan.Writes[ i ].Length );
+	}
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+bool Audio_ScanUcode( AudioHLEScan & scan )
+{
+	OSTask * pTask = (OSTask *)(g_pu8SpMemBase + 0x0FC0);
+
+	if ( !bAudioChanged )
+	{
+		bAudioChanged = true;
+		Audio_Ucode_Detect( pTask );
+	}
+
+	if ( ABIScanner == NULL )
+		return false;
+
+	u32 data_ptr {(u32)(uintptr_t)pTask->t.data_ptr};
+	u32 data_size {pTask->t.data_size};
+
+	scan.Clear();
+	scan.Count = gAudioHLEState.Count;
+	scan.LoopVal = 0;
+	scan.Read( data_ptr, data_size );
+
+	return ABIScanner( (const u32 *)(g_pu8RamBase + data_ptr), data_size >> 3, scan );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void Audio_UcodeAList( u8 * ram_base, u32 data_ptr, u32 data_size )
+{
+	gAudioHLERamBase = ram_base;
+
 	gAudioHLEState.LoopVal = 0;
 	//memset( gAudioHLEState.Segments, 0, sizeof( gAudioHLEState.Segments ) );
 
-	u32 * p_alist {(u32 *)(g_pu8RamBase + (u32)pTask->t.data_ptr)};
-	u32 ucode_size {(pTask->t.data_size >> 3)};	//ABI5 can return 0 here!!!
+	u32 * p_alist {(u32 *)(ram_base + data_ptr)};
+	u32 ucode_size {(data_size >> 3)};	//ABI5 can return 0 here!!!
 
 	while( ucode_size )
 	{
@@ -396,17 +396,35 @@ DAEDALUS_STATIC_ASSERT( sizeof( AudioHLECommand ) == 8 );
 
 typedef void ( * AudioHLEInstruction )( AudioHLECommand command );
 
+// Works out which RDRAM an alist reads and writes without running it (see HLEAudio/AudioHLETask.cpp).
+// Returns false if the alist uses a command whose accesses can't be known ahead of time.
+struct AudioHLEScan;
+typedef bool ( * AudioHLEScanner )( const u32 * p_alist, u32 num_commands, AudioHLEScan & scan );
+
 // These must be defined...
 #include "Core/Memory.h"
 
+// The RDRAM the ABI reads and writes. Normally the real thing, but tasks run
+// on the worker thread see a private copy (see HLEAudio/AudioHLETask.cpp).
+extern u8 *	gAudioHLERamBase;
+
 // MMmm, why not use the defines from Memory.h?
 // ToDo : remove these and use the ones already provided by the core?
 #define dmem	((u8*)g_pMemoryBuffers[MEM_SP_MEM] + SP_DMA_DMEM)
 #define imem	((u8*)g_pMemoryBuffers[MEM_SP_MEM] + SP_DMA_IMEM)
-#define rdram	((u8*)g_pMemoryBuffers[MEM_RD_RAM])
+#define rdram	gAudioHLERamBase
 
 // Use these functions to interface with the HLE Audio...
 void Audio_Ucode();
 void Audio_Reset();
 
+// Audio_Ucode, split in two for HLEAudio/AudioHLETask.cpp.
+// Audio_ScanUcode detects the ABI if needed and scans the task in SP memory.
+// Audio_UcodeAList runs an alist against the given copy of RDRAM.
+bool Audio_ScanUcode( AudioHLEScan & scan );
+void Audio_UcodeAList( u8 * ram_base, u32 data_ptr, u32 data_size );
+
+// Notes the RDRAM a scanned alist wrote in Core/DirtyPages.h
+void Audio_MarkWrites( const AudioHLEScan & scan );
+
 #endif // HLEAUDIO_AUDIOHLE_H_
@@ -48,7 +48,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // Vertex allocation.
 // AllocVerts/FreeVerts:
 //   Allocate vertices whose lifetime must extend beyond the current scope.
-//   On OSX we just use malloc, though we could use a scratch allocator to simplify.
+//   On GL we write straight into the renderer's (mapped) vertex buffer.
 //   On PSP we again use sceGuGetMemory.
 struct TempVerts
 {
@@ -58,21 +58,14 @@ struct TempVerts
 	{
 	}
 
-	~TempVerts()
-	{
-#ifdef DAEDALUS_GL
-		free(Verts);
-#endif
-	}
-
 	DaedalusVtx * Alloc(u32 count)
 	{
-		u32 bytes {count * sizeof(DaedalusVtx)};
 #ifdef DAEDALUS_PSP
+		u32 bytes {count * sizeof(DaedalusVtx)};
 		Verts = static_cast<DaedalusVtx*>(sceGuGetMemory(bytes));
 #endif
 #ifdef DAEDALUS_GL
-		Verts = static_cast<DaedalusVtx*>(malloc(bytes));
+		Verts = gRenderer->AllocVertices(count);
 #endif
 
 		Count = count;
@@ -153,6 +146,7 @@ BaseRenderer::BaseRenderer()
 
 ,	mNumIndices(0)
 ,	mVtxClipFlagsUnion( 0 )
+,	mNumTrisSubmitted( 0 )
 
 #ifdef DAEDALUS_DEBUG_DISPLAYLIST
 ,	mNumTrisRendered( 0 )
@@ -268,6 +262,9 @@ void BaseRenderer::BeginScene()
 
 void BaseRenderer::EndScene()
 {
+#ifdef DAEDALUS_GL
+	FlushDraws();
+#endif
 	CGraphicsContext::Get()->EndFrame();
 
 	//
@@ -382,7 +379,7 @@ void BaseRenderer::UpdateViewport()
 	sceGuOffset(vx - (vp_w/2),vy - (vp_h/2));
 	sceGuViewport(vx + vp_x, vy + vp_y, vp_w, vp_h);
 #elif defined(DAEDALUS_GL)
-	glViewport(vp_x, (s32)mScreenHeight - (vp_h + vp_y), vp_w, vp_h);
+	SetGLViewport(vp_x, (s32)mScreenHeight - (vp_h + vp_y), vp_w, vp_h);
 #else
 	DAEDALUS_ERROR("Code to set viewport not implemented on this platform");
 #endif
@@ -535,6 +532,7 @@ void BaseRenderer::FlushTris()
 	//
 	//	Render out our vertices
 	RenderTriangles( temp_verts.Verts, temp_verts.Count, gRDPOtherMode.depth_source ? true : false );
+	mNumTrisSubmitted += temp_verts.Count / 3;
 
 	mNumIndices = 0;
 	mVtxClipFlagsUnion = 0;
@@ -600,7 +598,7 @@ static u32 clipToHyperPlane( DaedalusVtx4 * dest, const DaedalusVtx4 * source, u
 	DaedalusVtx4 * out(dest);
 
 	const DaedalusVtx4 * a {};
-	const DaedalusVtx4 * b(source) {};
+	const DaedalusVtx4 * b(source);
 
 	f32 bDotPlane = b->ProjectedPos.Dot( plane );
 
@@ -677,7 +675,9 @@ namespace
 	DaedalusVtx4		temp_b[ 8 ] {};
 	// Flying Dragon clips more than 256
 	const u32			MAX_CLIPPED_VERTS {320};
+#ifndef DAEDALUS_GL
 	DaedalusVtx			clip_vtx[MAX_CLIPPED_VERTS];
+#endif
 }
 
 
@@ -701,6 +701,11 @@ void BaseRenderer::PrepareTrisClipped( TempVerts * temp_verts ) const
 	//
 	u32 num_vertices {};
 
+#ifdef DAEDALUS_GL
+	// Unused space in the vertex buffer isn't lost, so clip straight into it rather than going via clip_vtx
+	DaedalusVtx * clip_vtx = temp_verts->Alloc( MAX_CLIPPED_VERTS );
+#endif
+
 	for(u32 i {}; i < (mNumIndices - 2);)
 	{
 		const u32 & idx0 {mIndexBuffer[ i++ ]};
@@ -796,6 +801,9 @@ void BaseRenderer::PrepareTrisClipped( TempVerts * temp_verts ) const
 		}
 	}
 
+#ifdef DAEDALUS_GL
+	temp_verts->Count = num_vertices;
+#else
 	//
 	//	Now the vertices have been clipped we need to write them into
 	//	a buffer we obtain this from the display list.
@@ -805,6 +813,7 @@ void BaseRenderer::PrepareTrisClipped( TempVerts * temp_verts ) const
 
 		memcpy( p_vertices, clip_vtx, num_vertices * sizeof(DaedalusVtx) );	//std memcpy() is as fast as VFPU here!
 	}
+#endif
 }
 
 
@@ -954,70 +963,7 @@ void BaseRenderer::SetNewVertexInfo(u32 address, u32 v0, u32 n)
 
 #else	//Transform using VFPU(fast) or FPU/CPU(slow)
 
-//
-
-v3 BaseRenderer::LightVert( const v3 & norm ) const
-{
-	const v3 & col {mTnL.Lights[mTnL.NumLights].Colour};
-	v3 result( col.x, col.y, col.z );
-
-	for ( u32 l {}; l < mTnL.NumLights; l++ )
-	{
-		f32 fCosT {norm.Dot( mTnL.Lights[l].Direction )};
-		if (fCosT > 0.0f)
-		{
-			result.x += mTnL.Lights[l].Colour.x * fCosT;
-			result.y += mTnL.Lights[l].Colour.y * fCosT;
-			result.z += mTnL.Lights[l].Colour.z * fCosT;
-		}
-	}
-
-	//Clamp to 1.0
-	if( result.x > 1.0f ) result.x = 1.0f;
-	if( result.y > 1.0f ) result.y = 1.0f;
-	if( result.z > 1.0f ) result.z = 1.0f;
-
-	return result;
-}
-
-
-//
-
-v3 BaseRenderer::LightPointVert( const v4 & w ) const
-{
-	const v3 & col {mTnL.Lights[mTnL.NumLights].Colour};
-	v3 result( col.x, col.y, col.z );
-
-	for ( u32 l {}; l < mTnL.NumLights; l++ )
-	{
-		if ( mTnL.Lights[l].SkipIfZero )
-		{
-			v3 distance_vec( mTnL.Lights[l].Position.x-w.x, mTnL.Lights[l].Position.y-w.y, mTnL.Lights[l].Position.z-w.z );
-
-			f32 light_qlen {distance_vec.LengthSq()};
-			f32 light_llen {sqrtf( light_qlen )};
-
-			f32 at = mTnL.Lights[l].ca + mTnL.Lights[l].la * light_llen + mTnL.Lights[l].qa * light_qlen;
-			if (at > 0.0f)
-			{
-				f32 fCosT = 1.0f/at;
-				result.x += mTnL.Lights[l].Colour.x * fCosT;
-				result.y += mTnL.Lights[l].Colour.y * fCosT;
-				result.z += mTnL.Lights[l].Colour.z * fCosT;
-			}
-		}
-	}
-
-	//Clamp to 1.0
-	if( result.x > 1.0f ) result.x = 1.0f;
-	if( result.y > 1.0f ) result.y = 1.0f;
-	if( result.z > 1.0f ) result.z = 1.0f;
-
-	return result;
-}
-
-
-// Standard rendering pipeline using FPU/CPU
+// Standard rendering pipeline using FPU/CPU, or SIMD where the CPU has it (see TnLKernels.h)
 
 void BaseRenderer::SetNewVertexInfo(u32 address, u32 v0, u32 n)
 {
@@ -1032,125 +978,20 @@ void BaseRenderer::SetNewVertexInfo(u32 address, u32 v0, u32 n)
 	DL_PF( "    Ambient color RGB[%f][%f][%f] Texture scale X[%f] Texture scale Y[%f]", mTnL.Lights[mTnL.NumLights].Colour.x, mTnL.Lights[mTnL.NumLights].Colour.y, mTnL.Lights[mTnL.NumLights].Colour.z, mTnL.TextureScaleX, mTnL.TextureScaleY);
 	DL_PF( "    Light[%d %s] Texture[%s] EnvMap[%s] Fog[%s]", mTnL.NumLights, (mTnL.Flags.Light)? (mTnL.Flags.PointLight)? "Point":"Normal":"Off", (mTnL.Flags.Texture)? "On":"Off", (mTnL.Flags.TexGen)? (mTnL.Flags.TexGenLin)? "Linear":"Spherical":"Off", (mTnL.Flags.Fog)? "On":"Off");
 #endif
-	// Transform and Project + Lighting or Transform and Project with Colour
-	//
-	for (u32 i = v0; i < v0 + n; i++)
-	{
-		const FiddledVtx & vert = pVtxBase[i - v0];
-
-		// VTX Transform
-		//
-		v4 w( f32( vert.x ), f32( vert.y ), f32( vert.z ), 1.0f );
-
-		v4 & projected( mVtxProjected[i].ProjectedPos );
-		projected = mat_world_project.Transform( w );
-		mVtxProjected[i].TransformedPos = mat_world.Transform( w );
-
-		//	Initialise the clipping flags
-		//
-		u32 clip_flags {};
-		if		(projected.x < -projected.w)	clip_flags |= X_POS;
-		else if (projected.x > projected.w)		clip_flags |= X_NEG;
-
-		if		(projected.y < -projected.w)	clip_flags |= Y_POS;
-		else if (projected.y > projected.w)		clip_flags |= Y_NEG;
-
-		if		(projected.z < -projected.w)	clip_flags |= Z_POS;
-		else if (projected.z > projected.w)		clip_flags |= Z_NEG;
-		mVtxProjected[i].ClipFlags = clip_flags;
-
-		// LIGHTING OR COLOR
-		//
-		if ( mTnL.Flags.Light )
-		{
-			v3 model_normal(f32( vert.norm_x ), f32( vert.norm_y ), f32( vert.norm_z ) );
-			v3 vecTransformedNormal {};
-			vecTransformedNormal = mat_world.TransformNormal( model_normal );
-			vecTransformedNormal.Normalise();
-
-			v3 col {};
-
-			if ( mTnL.Flags.PointLight )
-			{//POINT LIGHT
-				col = LightPointVert(w); // Majora's Mask uses this
-			}
-			else
-			{//NORMAL LIGHT
-				col = LightVert(vecTransformedNormal);
-			}
-			mVtxProjected[i].Colour.x = col.x;
-			mVtxProjected[i].Colour.y = col.y;
-			mVtxProjected[i].Colour.z = col.z;
-			mVtxProjected[i].Colour.w = vert.rgba_a * (1.0f / 255.0f);
-
-			// ENV MAPPING
-			//
-			if ( mTnL.Flags.TexGen )
-			{
-				// Update texture coords n.b. need to divide tu/tv by bogus scale on addition to buffer
-				// If the vert is already lit, then there is no normal (and hence we can't generate tex coord)
-#if 1			// 1->Lets use mat_world_project instead of mat_world for nicer effect (see SSV space ship) //Corn
-				vecTransformedNormal = mat_world_project.TransformNormal( model_normal );
-				vecTransformedNormal.Normalise();
-#endif
-
-				const v3 & norm {vecTransformedNormal};
-
-				if( mTnL.Flags.TexGenLin )
-				{
-					mVtxProjected[i].Texture.x = 0.5f * ( 1.0f + norm.x );
-					mVtxProjected[i].Texture.y = 0.5f * ( 1.0f + norm.y );
-				}
-				else
-				{
-					//Cheap way to do Acos(x)/Pi (abs() fixes star in SM64, sort of) //Corn
-					f32 NormX {fabsf( norm.x )};
-					f32 NormY {fabsf( norm.y )};
-					mVtxProjected[i].Texture.x =  0.5f - 0.25f * NormX - 0.25f * NormX * NormX * NormX;
-					mVtxProjected[i].Texture.y =  0.5f - 0.25f * NormY - 0.25f * NormY * NormY * NormY;
-				}
-			}
-			else
-			{
-				//Set Texture coordinates
-				mVtxProjected[i].Texture.x = (float)vert.tu * mTnL.TextureScaleX;
-				mVtxProjected[i].Texture.y = (float)vert.tv * mTnL.TextureScaleY;
-			}
-		}
-		else
-		{
-			//if( mTnL.Flags.Shade )
-			{// FLAT shade
-				mVtxProjected[i].Colour = v4( vert.rgba_r * (1.0f / 255.0f), vert.rgba_g * (1.0f / 255.0f), vert.rgba_b * (1.0f / 255.0f), vert.rgba_a * (1.0f / 255.0f) );
-			}
-			/*else
-			{// PRIM shade, SSV uses this, doesn't seem to do anything????
-				mVtxProjected[i].Colour = mPrimitiveColour.GetColourV4();
-			}*/
-
-
-			//Set Texture coordinates
-			mVtxProjected[i].Texture.x = (float)vert.tu * mTnL.TextureScaleX;
-			mVtxProjected[i].Texture.y = (float)vert.tv * mTnL.TextureScaleY;
-		}
 
+	// Only the PSP fogs per vertex
 #ifdef DAEDALUS_PSP
-		//Fog
-		if ( mTnL.Flags.Fog )
-		{
-			if(projected.w > 0.0f)	//checking for positive w fixes near plane fog errors //Corn
-			{
-				f32 eye_z {projected.z / projected.w};
-				f32 fog_alpha {eye_z * mTnL.FogMult + mTnL.FogOffs};
-				//f32 fog_alpha = eye_z * 20.0f - 19.0f;	//Fog test line
-				mVtxProjected[i].Colour.w = Clamp< f32 >( fog_alpha, 0.0f, 1.0f );
-			}
-			else
-			{
-				mVtxProjected[i].Colour.w = 0.0f;
-			}
-		}
+	const bool fog {mTnL.Flags.Fog != 0};
+#else
+	const bool fog {false};
 #endif
+
+	// Transform and Project + Lighting or Transform and Project with Colour
+	//
+	for (u32 i = 0; i < n; i += kTnLBatchSize)
+	{
+		const u32 count {Min( n - i, kTnLBatchSize )};
+		gTnLKernels->TransformVertices( &mVtxProjected[v0 + i], pVtxBase + i, count, mat_world_project, mat_world, mTnL, fog );
 	}
 }
 
@@ -1276,7 +1117,7 @@ void BaseRenderer::SetNewVertexInfoConker(u32 address, u32 v0, u32 n)
 			}
 			else
 			{	//NORMAL LIGHT
-				for (l {}; l < mTnL.NumLights; l++)
+				for (l = 0; l < mTnL.NumLights; l++)
 				{
 					if ( mTnL.Lights[l].SkipIfZero )
 					{
@@ -1330,7 +1171,7 @@ void BaseRenderer::SetNewVertexInfoConker(u32 address, u32 v0, u32 n)
 
 void BaseRenderer::SetNewVertexInfoDKR(u32 address, u32 v0, u32 n, bool billboard)
 {
-	u32 pVtxBase {u32(g_pu8RamBase + address)};
+	uintptr_t pVtxBase {uintptr_t(g_pu8RamBase + address)};
 	const Matrix4x4 & mat_world_project {mModelViewStack[mDKRMatIdx]};
 
 #ifdef DAEDALUS_DEBUG_DISPLAYLIST
@@ -1863,7 +1704,7 @@ void BaseRenderer::UpdateTileSnapshot( u32 index, u32 tile_idx )
 	DL_PF( "    Use Tile[%d] as Texture[%d] [%dx%d] [%s/%dbpp] [%s u, %s v] -> Adr[0x%08x] PAL[0x%x] Hash[0x%08x] Pitch[%d] TopLeft[%0.3f|%0.3f]",
 			tile_idx, index, ti.GetWidth(), ti.GetHeight(), ti.GetFormatName(), ti.GetSizeInBits(),
 			(mode_u==GU_CLAMP)? "Clamp" : "Repeat", (mode_v==GU_CLAMP)? "Clamp" : "Repeat",
-			ti.GetLoadAddress(), ti.GetTlutAddress(), ti.GetHashCode(), ti.GetPitch(),
+			ti.GetLoadAddress(), u32( ti.GetTlutAddress() ), ti.GetHashCode(), ti.GetPitch(),
 			mTileTopLeft[ index ].s / 4.f, mTileTopLeft[ index ].t / 4.f );
 			#endif
 }
@@ -1997,7 +1838,7 @@ void BaseRenderer::SetScissor( u32 x0, u32 y0, u32 x1, u32 y1 )
 	// NB: OpenGL is x,y,w,h. Errors if width or height is negative, so clamp this.
 	s32 w {Max<s32>( r - l, 0 )};
 	s32 h {Max<s32>( b - t, 0 )};
-	glScissor( l, (s32)mScreenHeight - (t + h), w, h );
+	SetGLScissor( l, (s32)mScreenHeight - (t + h), w, h );
 #else
 	DAEDALUS_ERROR("Need to implement scissor for this platform.")
 #endif
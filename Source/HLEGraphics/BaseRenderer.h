@@ -27,6 +27,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "Utility/RefCounted.h"
 #include "HLEGraphics/DaedalusVtx.h"
 #include "HLEGraphics/TextureInfo.h"
+#include "HLEGraphics/TnLKernels.h"
 #include "Graphics/ColourValue.h"
 #include "Utility/Preferences.h"
 
@@ -75,127 +76,6 @@ struct FiddledVtxPD
 	s16 tu;
 };
 
-struct FiddledVtx
-{
-        s16 y;
-        s16 x;
-
-        union
-        {
-			s16 flag;
-            struct
-            {
-				s8 normz;
-				u8 pad;
-            };
-        };
-        s16 z;
-
-        s16 tv;
-        s16 tu;
-
-        union
-        {
-            struct
-            {
-                    u8 rgba_a;
-                    u8 rgba_b;
-                    u8 rgba_g;
-                    u8 rgba_r;
-            };
-            struct
-            {
-                    s8 norm_a;
-                    s8 norm_z;      // b
-                    s8 norm_y;      // g
-                    s8 norm_x;      // r
-            };
-        };
-};
-DAEDALUS_STATIC_ASSERT( sizeof(FiddledVtx) == 16 );
-
-ALIGNED_TYPE(struct, DaedalusLight, 16)
-{
-	v3		Direction;		// w component is ignored. Should be normalised
-	u32		SkipIfZero;		// Used by CBFD & MM
-	v3		Colour;			// Colour, components in range 0..1
-	f32		Iscale;			// Used by CBFD
-	v4		Position;		// Position -32768 to 32767
-	f32		ca;				// Used by MM(GBI2 point light)
-	f32		la;				// Used by MM(GBI2 point light)
-	f32		qa;				// Used by MM(GBI2 point light)
-	u32		Pad0;			// Padding
-};
-DAEDALUS_STATIC_ASSERT( sizeof( DaedalusLight ) == 64 );	//Size=64 bytes and order is important or VFPU ASM for PSP will fail
-
-// Order here should be the same as in TnLMode
-enum ETnLModeFlags
-{
-	TNL_LIGHT		= 1 << 0,
-	TNL_TEXGEN		= 1 << 1,
-	TNL_TEXGENLIN	= 1 << 2,
-	TNL_FOG			= 1 << 3,
-	TNL_SHADE		= 1 << 4,
-	TNL_ZBUFFER		= 1 << 5,
-	TNL_TRICULL		= 1 << 6,
-	TNL_CULLBACK	= 1 << 7,
-	TNL_POINTLIGHT	= 1 << 8,
-};
-
-struct TnLMode
-{
-	union
-	{
-		struct
-		{
-			u32 Light : 1;			// 0x1
-			u32 TexGen : 1;			// 0x2
-			u32 TexGenLin : 1;		// 0x4
-			u32 Fog : 1;			// 0x8
-			u32 Shade : 1;			// 0x10
-			u32 Zbuffer : 1;		// 0x20
-			u32 TriCull : 1;		// 0x40
-			u32 CullBack : 1;		// 0x80
-			u32 PointLight : 1;		// 0x100
-			u32 pad0 : 23;			// 0x0
-		};
-
-		struct
-		{
-			u16 Modes;
-			u16 Texture;
-		};
-
-		u32	_u32;
-	};
-};
-
-ALIGNED_TYPE(struct, TnLParams, 16)
-{
-	TnLMode			Flags;			//TnL flags
-	u32				NumLights;		//Number of lights
-	f32				TextureScaleX;	//Texture scale X
-	f32				TextureScaleY;	//Texture scale Y
-	DaedalusLight	Lights[12];		//Conker uses up to 12 lights
-	f32				CoordMod[16];	//Used by CBFD lights
-	f32				FogMult;		//Fog mult
-	f32				FogOffs;		//Fog offset
-};
-//DAEDALUS_STATIC_ASSERT( sizeof( TnLParams ) == 32 );
-
-// Bits for clipping
-// 543210
-// +++---
-// zyxzyx
-// NB: These are ordered such that the VFPU can generate them easily - make sure you keep the VFPU code up to date if changing these.
-#define X_NEG  0x01	//left
-#define Y_NEG  0x02	//bottom
-#define Z_NEG  0x04	//far
-#define X_POS  0x08	//right
-#define Y_POS  0x10	//top
-#define Z_POS  0x20	//near
-#define CLIP_TEST_FLAGS ( X_POS | X_NEG | Y_POS | Y_NEG | Z_POS | Z_NEG )
-
 enum CycleType
 {
 	CYCLE_1CYCLE = 0,		// Please keep in this order - matches RDP
@@ -320,6 +200,9 @@ public:
 	inline c32			GetBlendColour() const					{ return mBlendColour; }
 	inline u32			GetFillColour() const					{ return mFillColour; }
 
+	// Triangles passed to RenderTriangles since the renderer was created, after culling and clipping
+	inline u64			GetNumTrisSubmitted() const				{ return mNumTrisSubmitted; }
+
 #ifdef DAEDALUS_DEBUG_DISPLAYLIST
 	// Rendering stats
 	inline u32			GetNumTrisRendered() const				{ return mNumTrisRendered; }
@@ -335,6 +218,20 @@ public:
 
 	CRefPtr<CNativeTexture> LoadTextureDirectly( const TextureInfo & ti );
 
+#if defined(DAEDALUS_GL)
+	// Returns room for num_vertices in the renderer's vertex buffer. Space is only used up once it's drawn,
+	// so it's fine to ask for more than is needed. Equivalent to sceGuGetMemory on the PSP.
+	virtual DaedalusVtx *	AllocVertices( u32 num_vertices ) = 0;
+
+	// Draws may be deferred so they can be merged. Issue them before changing any GL state directly.
+	virtual void			FlushDraws() = 0;
+
+	// In GL window coordinates. These go through the renderer rather than calling GL here,
+	// as it may be recording commands for the render thread (see SysGL/HLEGraphics/RenderThreadGL.h).
+	virtual void			SetGLViewport( s32 x, s32 y, s32 w, s32 h ) = 0;
+	virtual void			SetGLScissor( s32 x, s32 y, s32 w, s32 h ) = 0;
+#endif
+
 protected:
 #ifdef DAEDALUS_PSP
 	inline void			UpdateFogEnable()						{ if(gFogEnabled) mTnL.Flags.Fog ? sceGuEnable(GU_FOG) : sceGuDisable(GU_FOG); }
@@ -370,8 +267,7 @@ protected:
 	void				PrepareTrisClipped( TempVerts * temp_verts ) const;
 	void				PrepareTrisUnclipped( TempVerts * temp_verts ) const;
 
-	v3					LightVert( const v3 & norm ) const;
-	v3					LightPointVert( const v4 & w ) const;
+	v3					LightVert( const v3 & norm ) const		{ return TnL_LightVert( mTnL, norm ); }
 
 private:
 	void				InitViewport();
@@ -456,6 +352,7 @@ protected:
 	DaedalusVtx4		mVtxProjected[kMaxN64Vertices];		// Transformed and projected vertices (suitable for clipping etc)
 	u32					mVtxClipFlagsUnion;					// Bitwise OR of all the vertex flags added to the current batch. If this is 0, we can trivially accept everything without clipping
 
+	u64					mNumTrisSubmitted;
 
 #ifdef DAEDALUS_DEBUG_DISPLAYLIST
 	//
@@ -32,6 +32,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "Graphics/TextureTransform.h"
 
 #include "Config/ConfigOptions.h"
+#include "Core/DirtyPages.h"
 #include "Core/ROM.h"
 #include "Debug/DBGConsole.h"
 #include "Debug/Dump.h"
@@ -44,12 +45,16 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 static std::vector<u8>		gTexelBuffer {};
 static NativePf8888			gPaletteBuffer[ 256 ];
-
-// NB: On the PSP we generate a lightweight hash of the texture data before
-// updating the native texture. This avoids some expensive work where possible.
-// On other platforms (e.g. OSX) updating textures is relatively inexpensive, so
-// we just skip the hashing process entirely, and update textures every frame
-// regardless of whether they've actually changed.
+static u32						gNumConversions {};
+
+// When every write to RDRAM marks its page (see Core/DirtyPages.h), textures are
+// only rehashed when their pages have been written, and only reconverted when the
+// hash has changed.
+// Otherwise, on the PSP we periodically hash the texture data before updating the
+// native texture. This avoids some expensive work where possible. On other
+// platforms (e.g. OSX) updating textures is relatively inexpensive, so we just skip
+// the hashing process entirely, and update textures every frame regardless of
+// whether they've actually changed.
 #ifdef DAEDALUS_PSP
 static const bool kUpdateTexturesEveryFrame = false;
 #else
@@ -188,10 +193,16 @@ static void UpdateTexture( const TextureInfo & ti, CNativeTexture * texture )
 			}
 
 			texture->SetData( texels, palette );
+			gNumConversions++;
 		}
 	}
 }
 
+u32 CachedTexture::GetNumConversions()
+{
+	return gNumConversions;
+}
+
 CachedTexture * CachedTexture::Create( const TextureInfo & ti )
 {
 	if( ti.GetWidth() == 0 || ti.GetHeight() == 0 )
@@ -213,6 +224,7 @@ CachedTexture::CachedTexture( const TextureInfo & ti )
 :	mTextureInfo( ti )
 ,	mpTexture(NULL)
 ,	mTextureContentsHash( 0 )
+,	mHashEpoch( 0 )
 ,	mFrameLastUpToDate( gRDPFrame )
 ,	mFrameLastUsed( gRDPFrame )
 {
@@ -253,13 +265,22 @@ bool CachedTexture::Initialise()
 // Update the hash of the texture. Returns true if the texture should be updated.
 bool CachedTexture::UpdateTextureHash()
 {
-	if (kUpdateTexturesEveryFrame)
+	if (!DirtyPages_IsReliable())
 	{
-		// NB always assume we need updating.
-		return true;
+		if (kUpdateTexturesEveryFrame)
+		{
+			// NB always assume we need updating.
+			return true;
+		}
+
+		// If CRC checking is disabled, never update
+		if (gCheckTextureHashFrequency == 0)
+			return false;
 	}
 
-	u32 new_hash_value {mTextureInfo.GenerateHashValue()};
+	mHashEpoch = DirtyPages_GetEpoch();
+
+	u64 new_hash_value {mTextureInfo.GenerateHashValue()};
 	bool changed       {new_hash_value != mTextureContentsHash};
 
 	mTextureContentsHash = new_hash_value;
@@ -289,6 +310,10 @@ bool CachedTexture::IsFresh() const
 	if (gRDPFrame == mFrameLastUsed)
 		return true;
 
+	// If writes are tracked, it's fresh until something writes to its pages
+	if (DirtyPages_IsReliable())
+		return !mTextureInfo.WrittenSince( mHashEpoch );
+
 	// If we're not updating textures every frame, check how long it's been
 	// since we last updated it.
 	if (!kUpdateTexturesEveryFrame)
@@ -302,7 +327,9 @@ bool CachedTexture::IsFresh() const
 
 bool CachedTexture::HasExpired() const
 {
-	if (!kUpdateTexturesEveryFrame)
+	// These hacks make up for the texture data only being checked periodically.
+	// When writes are tracked, the texture is rehashed as soon as anything changes.
+	if (!kUpdateTexturesEveryFrame && !DirtyPages_IsReliable())
 	{
 		if (!IsFresh())
 		{
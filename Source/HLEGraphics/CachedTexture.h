@@ -37,6 +37,9 @@ class CachedTexture
 	public:
 		static CachedTexture *			Create( const TextureInfo & ti );
 
+		// Number of times texels have been converted from N64 formats, for benchmarking
+		static u32						GetNumConversions();
+
 		inline const CRefPtr<CNativeTexture> &	GetTexture() const			{ return mpTexture; }
 		inline const TextureInfo &		GetTextureInfo() const				{ return mTextureInfo; }
 
@@ -58,7 +61,8 @@ class CachedTexture
 
 		CRefPtr<CNativeTexture>			mpTexture;
 
-		u32								mTextureContentsHash;
+		u64								mTextureContentsHash;
+		u32								mHashEpoch;			// DirtyPages epoch mTextureContentsHash was taken in
 		u32								mFrameLastUpToDate;	// Frame # that this was last updated
 		u32								mFrameLastUsed;		// Frame # that this was last used
 };
@@ -0,0 +1,249 @@
+/*
+Copyright (C) 2012 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#include "stdafx.h"
+#include "DLCapture.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "Core/Memory.h"
+#include "Core/ROM.h"
+#include "Debug/DBGConsole.h"
+#include "Debug/Dump.h"
+#include "Utility/IO.h"
+#include "Utility/ZlibWrapper.h"
+
+namespace
+{
+
+//
+//	File layout, gzipped:
+//		SCaptureHeader
+//		SP memory (MemoryRegionSizes[MEM_SP_MEM] bytes). The OSTask is at 0xFC0.
+//		VI registers (MemoryRegionSizes[MEM_VI_REG] bytes)
+//		For each RDRAM page which isn't all zero: u32 page index, then the page
+//		kEndOfPages
+//
+const u32		kCaptureMagic   = 0x31434c44;		// 'DLC1'
+const u32		kCaptureVersion = 1;
+const u32		kPageSize       = 4096;
+const u32		kEndOfPages     = 0xffffffff;
+
+struct SCaptureHeader
+{
+	u32		Magic;
+	u32		Version;
+	u32		RamSize;
+	u32		Hacks;
+	u32		TvType;
+	u32		PageSize;
+	char	RomName[ 20 ];
+};
+
+volatile u32	gFramesToCapture = 0;
+
+bool IsPageEmpty( const u8 * p_page )
+{
+	const u32 *	p_words( reinterpret_cast< const u32 * >( p_page ) );
+	for( u32 i = 0; i < kPageSize / sizeof( u32 ); ++i )
+	{
+		if( p_words[ i ] != 0 )
+			return false;
+	}
+	return true;
+}
+
+//*****************************************************************************
+//	Rom name with the padding trimmed, safe to use in a filename
+//*****************************************************************************
+void GetCaptureBaseName( char * p_name, u32 len )
+{
+	u32		n( 0 );
+	for( u32 i = 0; i < ARRAYSIZE( g_ROM.rh.Name ) && n + 1 < len; ++i )
+	{
+		char	c( g_ROM.rh.Name[ i ] );
+		if( c == '\0' )
+			break;
+		p_name[ n++ ] = isalnum( u8( c ) ) ? c : '_';
+	}
+	while( n > 0 && p_name[ n - 1 ] == '_' )
+	{
+		--n;
+	}
+	if( n == 0 )
+	{
+		strcpy( p_name, "Unknown" );
+		return;
+	}
+	p_name[ n ] = '\0';
+}
+
+bool FindCaptureFilename( IO::Filename & filename )
+{
+	IO::Filename	dir;
+	Dump_GetDumpDirectory( dir, "dlcapture" );
+
+	char			base[ 32 ];
+	GetCaptureBaseName( base, sizeof( base ) );
+
+	for( u32 i = 0; i < 10000; ++i )
+	{
+		char		name[ 64 ];
+		snprintf( name, sizeof( name ), "%s_%04d.dlc", base, i );
+		IO::Path::Combine( filename, dir, name );
+
+		if( !IO::File::Exists( filename ) )
+			return true;
+	}
+	return false;
+}
+
+bool WriteCapture( const char * filename )
+{
+	COutStream		stream( filename );
+	if( !stream.IsOpen() )
+		return false;
+
+	SCaptureHeader	header;
+	memset( &header, 0, sizeof( header ) );
+	header.Magic    = kCaptureMagic;
+	header.Version  = kCaptureVersion;
+	header.RamSize  = gRamSize;
+	header.Hacks    = g_ROM.HACKS_u32;
+	header.TvType   = g_ROM.TvType;
+	header.PageSize = kPageSize;
+	memcpy( header.RomName, g_ROM.rh.Name, sizeof( header.RomName ) );
+
+	bool			ok( stream.WriteData( &header, sizeof( header ) ) );
+	ok = ok && stream.WriteData( g_pMemoryBuffers[ MEM_SP_MEM ], MemoryRegionSizes[ MEM_SP_MEM ] );
+	ok = ok && stream.WriteData( g_pMemoryBuffers[ MEM_VI_REG ], MemoryRegionSizes[ MEM_VI_REG ] );
+
+	// Most of RDRAM is untouched in most games, so leave out the pages which are still clear
+	for( u32 page = 0; ok && page < gRamSize / kPageSize; ++page )
+	{
+		const u8 *	p_page( g_pu8RamBase + page * kPageSize );
+		if( IsPageEmpty( p_page ) )
+			continue;
+
+		ok = stream.WriteData( &page, sizeof( page ) ) &&
+			 stream.WriteData( p_page, kPageSize );
+	}
+
+	ok = ok && stream.WriteData( &kEndOfPages, sizeof( kEndOfPages ) );
+	return stream.Flush() && ok;
+}
+
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void DLCapture_Request( u32 num_frames )
+{
+	gFramesToCapture = num_frames;
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void DLCapture_OnProcess()
+{
+	if( gFramesToCapture == 0 )
+		return;
+
+	gFramesToCapture = gFramesToCapture - 1;
+
+	IO::Filename	filename;
+	if( !FindCaptureFilename( filename ) )
+	{
+		DBGConsole_Msg( 0, "No free display list capture filename" );
+		gFramesToCapture = 0;
+		return;
+	}
+
+	if( WriteCapture( filename ) )
+	{
+		DBGConsole_Msg( 0, "Captured display list to [C%s]", filename );
+	}
+	else
+	{
+		DBGConsole_Msg( 0, "Failed to write display list capture [C%s]", filename );
+		IO::File::Delete( filename );
+		gFramesToCapture = 0;
+	}
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+bool DLCapture_Load( const char * filename, SDLCaptureInfo * p_info )
+{
+	CInStream		stream( filename );
+	if( !stream.IsOpen() )
+		return false;
+
+	SCaptureHeader	header;
+	if( !stream.ReadData( &header, sizeof( header ) ) ||
+		header.Magic != kCaptureMagic ||
+		header.Version != kCaptureVersion ||
+		header.PageSize != kPageSize ||
+		header.RamSize > MemoryRegionSizes[ MEM_RD_RAM ] )
+	{
+		return false;
+	}
+
+	memset( g_pMemoryBuffers[ MEM_RD_RAM ], 0, MemoryRegionSizes[ MEM_RD_RAM ] );
+
+	if( !stream.ReadData( g_pMemoryBuffers[ MEM_SP_MEM ], MemoryRegionSizes[ MEM_SP_MEM ] ) ||
+		!stream.ReadData( g_pMemoryBuffers[ MEM_VI_REG ], MemoryRegionSizes[ MEM_VI_REG ] ) )
+	{
+		return false;
+	}
+
+	for( ;; )
+	{
+		u32		page;
+		if( !stream.ReadData( &page, sizeof( page ) ) )
+			return false;
+
+		if( page == kEndOfPages )
+			break;
+
+		if( page >= header.RamSize / kPageSize ||
+			!stream.ReadData( g_pu8RamBase + page * kPageSize, kPageSize ) )
+		{
+			return false;
+		}
+	}
+
+	DirtyPages_MarkAll();
+
+	gRamSize          = header.RamSize;
+	g_ROM.HACKS_u32   = header.Hacks;
+	g_ROM.TvType      = header.TvType;
+
+	p_info->RamSize = header.RamSize;
+	p_info->Hacks   = header.Hacks;
+	p_info->TvType  = header.TvType;
+	memcpy( p_info->RomName, header.RomName, sizeof( header.RomName ) );
+	p_info->RomName[ sizeof( header.RomName ) ] = '\0';
+	return true;
+}
@@ -0,0 +1,49 @@
+/*
+Copyright (C) 2012 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#pragma once
+
+#ifndef HLEGRAPHICS_DLCAPTURE_H_
+#define HLEGRAPHICS_DLCAPTURE_H_
+
+//
+//	Writes display list tasks to Dumps/dlcapture, one file per frame, with
+//	everything DLParser_Process reads: the OSTask and ucode in SP memory, the
+//	VI registers, the rom's game hacks and RDRAM. dlreplay (DLReplay.cpp)
+//	loads them back and renders them without running the rest of the emulator.
+//
+
+// Captures the next num_frames display lists. Safe to call from any thread.
+void	DLCapture_Request( u32 num_frames );
+
+// Called by DLParser_Process before it starts on a task
+void	DLCapture_OnProcess();
+
+struct SDLCaptureInfo
+{
+	u32		RamSize;
+	u32		Hacks;				// RomInfo::HACKS_u32
+	u32		TvType;
+	char	RomName[ 21 ];
+};
+
+// Restores RDRAM, SP memory and the VI registers from a capture
+bool	DLCapture_Load( const char * filename, SDLCaptureInfo * p_info );
+
+#endif // HLEGRAPHICS_DLCAPTURE_H_
@@ -28,12 +28,14 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "RDPStateManager.h"
 #include "TextureCache.h"
 #include "ConvertImage.h"			// Convert555ToRGBA
+#include "DLCapture.h"
 #include "Microcode.h"
 #include "uCodes/UcodeDefs.h"
 #include "uCodes/Ucode.h"
 
 #include "Config/ConfigOptions.h"
 #include "Core/CPU.h"
+#include "Core/DirtyPages.h"
 #include "Core/Memory.h"
 #include "Core/ROM.h"
 #include "Debug/DBGConsole.h"
@@ -47,6 +49,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "Test/BatchTest.h"
 #include "Utility/IO.h"
 #include "Utility/Profiler.h"
+#include "Utility/Timing.h"
 
 //*****************************************************************************
 //
@@ -193,6 +196,8 @@ static const char * gCustomInstructionName[256];
 
 bool					gFrameskipActive {false};
 
+static SDLCommandStats *	gCommandStats {NULL};
+
 //*****************************************************************************
 //
 //*****************************************************************************
@@ -324,6 +329,7 @@ void DLParser_DumpVtxInfo(u32 address, u32 v0_idx, u32 num_verts)
 bool DLParser_Initialise()
 {
 	gFirstCall = true;
+	gLastUcodeBase = 0;
 
 	// Reset scissor to default
 	scissors.top = 0;
@@ -472,7 +478,20 @@ static u32 DLParser_ProcessDList(u32 instruction_limit)
 
 		PROFILE_DL_CMD( command.inst.cmd );
 
-		gUcodeFunc[ command.inst.cmd ]( command );
+		if( gCommandStats != NULL )
+		{
+			u64 start, end;
+			NTiming::GetPreciseTime( &start );
+			gUcodeFunc[ command.inst.cmd ]( command );
+			NTiming::GetPreciseTime( &end );
+
+			gCommandStats->Count[ command.inst.cmd ]++;
+			gCommandStats->Ticks[ command.inst.cmd ] += end - start;
+		}
+		else
+		{
+			gUcodeFunc[ command.inst.cmd ]( command );
+		}
 
 		DL_END_INSTR();
 
@@ -485,8 +504,8 @@ static u32 DLParser_ProcessDList(u32 instruction_limit)
 				return current_instruction_count;
 			}
 		}
-		current_instruction_count++;
 #endif
+		current_instruction_count++;
 
 		// Check limit
 		if (gDlistStack.limit >= 0)
@@ -515,6 +534,8 @@ u32 DLParser_Process(u32 instruction_limit, DLDebugOutput * debug_output)
 		return 0;
 	}
 
+	DLCapture_OnProcess();
+
 	// Shut down the debug console when we start rendering
 	// TODO: Clear the front/backbuffer the first time this function is called
 	// to remove any stuff lingering on the screen.
@@ -529,9 +550,9 @@ u32 DLParser_Process(u32 instruction_limit, DLDebugOutput * debug_output)
 	if( g_ROM.GameHacks != CHAMELEON_TWIST_2 ) gGraphicsPlugin->UpdateScreen();
 
 	OSTask * pTask {(OSTask *)(g_pu8SpMemBase + 0x0FC0)};
-	u32 code_base {(u32)pTask->t.ucode & 0x1fffffff};
+	u32 code_base {(u32)(uintptr_t)pTask->t.ucode & 0x1fffffff};
 	u32 code_size {pTask->t.ucode_size};
-	u32 data_base {(u32)pTask->t.ucode_data & 0x1fffffff};
+	u32 data_base {(u32)(uintptr_t)pTask->t.ucode_data & 0x1fffffff};
 	u32 data_size {pTask->t.ucode_data_size};
 	u32 stack_size {pTask->t.dram_stack_size >> 6};
 
@@ -547,12 +568,13 @@ u32 DLParser_Process(u32 instruction_limit, DLDebugOutput * debug_output)
 	gRDPOtherMode.H = 0;
 
 	gRDPFrame++;
+	DirtyPages_NextEpoch();
 
 	CTextureCache::Get()->PurgeOldTextures();
 
 	// Initialise stack
 	gDlistStackPointer=0;
-	gDlistStack.address[0] = (u32)pTask->t.data_ptr;
+	gDlistStack.address[0] = (u32)(uintptr_t)pTask->t.data_ptr;
 	gDlistStack.limit = -1;
 
 	gRDPStateManager.Reset();
@@ -599,12 +621,32 @@ u32 DLParser_Process(u32 instruction_limit, DLDebugOutput * debug_output)
 #ifdef DAEDALUS_BATCH_TEST_ENABLED
 	CBatchTestEventHandler * handler( BatchTest_GetHandler() );
 	if( handler )
-		handler->OnDisplayListComplete();
+		handler->OnDisplayListComplete( count );
 #endif
 
 	return count;
 }
 
+//*****************************************************************************
+//
+//*****************************************************************************
+void DLParser_SetCommandStats( SDLCommandStats * stats )
+{
+	gCommandStats = stats;
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+const char * DLParser_GetCommandName( u32 cmd )
+{
+#if defined(DAEDALUS_DEBUG_DISPLAYLIST) || defined(DAEDALUS_ENABLE_PROFILING)
+	return gUcodeName[ cmd & 0xff ];
+#else
+	return NULL;
+#endif
+}
+
 //*****************************************************************************
 //
 //*****************************************************************************
@@ -33,4 +33,18 @@ void DLParser_Finalise();
 const u32 kUnlimitedInstructionCount = u32( ~0 );
 u32 DLParser_Process(u32 instruction_limit = kUnlimitedInstructionCount, DLDebugOutput * debug_output = NULL);
 
+// Time spent in each command's handler, indexed by command byte. Draws are deferred, so
+// some of the cost of a triangle command lands on whichever command flushes it.
+struct SDLCommandStats
+{
+	u32		Count[ 256 ];
+	u64		Ticks[ 256 ];		// NTiming::GetPreciseTime units
+};
+
+// Pass NULL to stop collecting. Off by default, as timing every command isn't free.
+void DLParser_SetCommandStats( SDLCommandStats * stats );
+
+// Only available in debug and profiling builds, NULL otherwise
+const char * DLParser_GetCommandName( u32 cmd );
+
 #endif // HLEGRAPHICS_DLPARSER_H_
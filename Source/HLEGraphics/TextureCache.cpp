@@ -49,6 +49,7 @@ CTextureCache::CTextureCache()
 #endif
 {
 	memset( mpCacheHashTable, 0, sizeof(mpCacheHashTable) );
+	memset( &mStats, 0, sizeof(mStats) );
 }
 
 CTextureCache::~CTextureCache()
@@ -120,7 +121,7 @@ void CTextureCache::DropTextures()
 }
 
 #ifdef PROFILE_TEXTURE_CACHE
-#define RECORD_CACHE_HIT( a, b )		TextureCacheStat( a, b, mTextures.size() )
+#define RECORD_CACHE_HIT( a, b )		RecordCacheHit( a, b ); TextureCacheStat( a, b, mTextures.size() )
 
 static void TextureCacheStat( u32 l1_hit, u32 l2_hit, u32 size )
 {
@@ -138,7 +139,7 @@ static void TextureCacheStat( u32 l1_hit, u32 l2_hit, u32 size )
 }
 #else
 
-#define RECORD_CACHE_HIT( a, b )
+#define RECORD_CACHE_HIT( a, b )		RecordCacheHit( a, b )
 
 #endif
 
@@ -42,6 +42,14 @@ public:
 	void		PurgeOldTextures();
 	void		DropTextures();
 
+	struct SStats
+	{
+		u32		Lookups;
+		u32		HashHits;		// Found in mpCacheHashTable
+		u32		SortedHits;		// Found by searching mTextures
+	};
+	const SStats &	GetStats() const	{ return mStats; }
+
 
 #ifdef DAEDALUS_DEBUG_DISPLAYLIST
 	Mutex * 	GetDebugMutex()		{ return &mDebugMutex; }
@@ -66,6 +74,13 @@ public:
 private:
 	CachedTexture * GetOrCreateCachedTexture(const TextureInfo & ti);
 
+	void		RecordCacheHit( u32 hash_hit, u32 sorted_hit )
+	{
+		mStats.Lookups++;
+		mStats.HashHits += hash_hit;
+		mStats.SortedHits += sorted_hit;
+	}
+
 	//
 	//	We implement a 2-way skewed associative cache.
 	//	Each TextureInfo is hashed using two different methods, to reduce the chance of collisions
@@ -81,6 +96,7 @@ private:
 	typedef std::vector< CachedTexture * >	TextureVec;
 	TextureVec			mTextures;
 	CachedTexture *		mpCacheHashTable[HASH_TABLE_SIZE];
+	SStats				mStats;
 #ifdef DAEDALUS_DEBUG_DISPLAYLIST
 	Mutex				mDebugMutex;
 #endif
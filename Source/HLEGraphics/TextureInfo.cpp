@@ -21,9 +21,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "stdafx.h"
 #include "TextureInfo.h"
 
-#include "Config/ConfigOptions.h"
 #include "Core/Memory.h"
-#include "Core/ROM.h"
+#include "Math/MathUtil.h"
 #include "OSHLE/ultra_gbi.h"
 #include "Utility/Hash.h"
 #include "Utility/Profiler.h"
@@ -41,88 +40,56 @@ u32 TextureInfo::GetSizeInBits() const
 	return gImageSizesInBits[ Size ];
 }
 
-// Fast hash for checking is data in a texture source has changed //Corn
-u32 TextureInfo::GenerateHashValue() const
+// Size in bytes of the palette a CI texture uses, or 0 if it doesn't have one
+static u32 GetPaletteSize( const TextureInfo & ti )
+{
+	if( ti.GetFormat() != G_IM_FMT_CI || ti.GetTlutAddress() == 0 )
+		return 0;
+
+	// 16 or 256 16 bit entries
+	return ti.GetSize() == G_IM_SIZ_4b ? 16 * 2 : 256 * 2;
+}
+
+// Hash of everything the texture is converted from: all of its rows, and its palette if it has one.
+// This used to sample a few rows (more for some games) to keep the cost down, which missed updates
+// to the rows in between. fast_hash is quick enough to read the lot.
+u64 TextureInfo::GenerateHashValue() const
 {
-	//Rewritten to use less recources //Corn
 #ifdef DAEDALUS_ENABLE_PROFILING
 	DAEDALUS_PROFILE( "TextureInfo::GenerateHashValue" );
 #endif
-	// If CRC checking is disabled, always return 0
-	if ( gCheckTextureHashFrequency == 0 ) return 0;
-
-	//DAEDALUS_ASSERT( (GetLoadAddress() + Height * Pitch) < 4*1024*1024, "Address of texture is out of bounds" );
+	u32	address( GetLoadAddress() );
+	if( address >= MAX_RAM_ADDRESS )
+		return 0;
 
-	//Number of places to do fragment hash from in texture
-	//More rows will use more CPU...
-	u32 CHK_ROW {5};
-	u32 hash_value {};
-	u8 *ptr_u8 {g_pu8RamBase + GetLoadAddress()};
+	//Get size in bytes, seems to be more accurate (alternative -> Height * Width * (1<<Size) >> 1;)
+	u32	length( Min< u32 >( Height * Pitch, MAX_RAM_ADDRESS - address ) );
+	u64	hash_value( fast_hash( g_pu8RamBase + address, length, 0 ) );
 
-	if( g_ROM.GameHacks == YOSHI )
+	//If texture has a palette then make hash of that too, as some games only change the colours
+	u32	palette_size( GetPaletteSize( *this ) );
+	if( palette_size > 0 )
 	{
-		CHK_ROW = 49;
-		if (GetFormat() == G_IM_FMT_CI)
-		{
-			//Check palette changes too but only first 16 palette values//Corn
-			const u32* ptr_u32 {(u32*)GetTlutAddress()};
-			for (u32 z {}; z < 8; z++) hash_value = ((hash_value << 1) | (hash_value >> 0x1F)) ^ *ptr_u32++;
-		}
-	}
-	else if( g_ROM.GameHacks == WORMS_ARMAGEDDON )
-	{
-		CHK_ROW = 1000;
-		if (GetFormat() == G_IM_FMT_CI)
-		{
-			//Check palette changes too but only first 16 palette values//Corn
-			const u32* ptr_u32 {(u32*)GetTlutAddress()};
-			for (u32 z {}; z < 8; z++) hash_value = ((hash_value << 1) | (hash_value >> 0x1F)) ^ *ptr_u32++;
-		}
+		hash_value = fast_hash( reinterpret_cast< const void * >( GetTlutAddress() ), palette_size, hash_value );
 	}
 
-	u32 step {(u32)(Height * Pitch)};	//Get size in bytes, seems to be more accurate (alternative -> Height * Width * (1<<Size) >> 1;)
-
-	if((u32)ptr_u8 & 0x3)	//Check if aligned to 4 bytes if not then align
-	{
-		ptr_u8 += 4 - ((u32)ptr_u8 & 0x3);
-		step   -= 4 - ((u32)ptr_u8 & 0x3);
-	}
+	return hash_value;
+}
 
-	u32 *ptr_u32 {(u32*)ptr_u8};	//use 32bit access
-	step = step >> 2;	//convert to 32bit access
+// Could GenerateHashValue() have changed since the start of epoch? See Core/DirtyPages.h.
+bool TextureInfo::WrittenSince( u32 epoch ) const
+{
+	if( DirtyPages_WrittenSince( GetLoadAddress(), Height * Pitch, epoch ) )
+		return true;
 
-	//We want to sample the texture data as far apart as possible
-	if (step < (CHK_ROW << 2))	//if texture is small hash all of it
+	u32	palette_size( GetPaletteSize( *this ) );
+	if( palette_size > 0 )
 	{
-		for (u32 z {}; z < step; z++)
-		{
-			hash_value = ((hash_value << 1) | (hash_value >> 0x1F)) ^ ptr_u32[z];
-		}
+		// The palette is a host pointer. If it's not into RDRAM (e.g. it's in TMEM), there's no telling.
+		uintptr_t	palette( uintptr_t( GetTlutAddress() ) - reinterpret_cast< uintptr_t >( g_pu8RamBase ) );
+		if( palette >= MAX_RAM_ADDRESS || DirtyPages_WrittenSince( u32( palette ), palette_size, epoch ) )
+			return true;
 	}
-	else	//if texture is big, hash only some parts inside it
-	{
-		step = (step - 4) / CHK_ROW;
-		for (u32 y {}; y < CHK_ROW; y++)
-		{
-			hash_value = ((hash_value << 1) | (hash_value >> 0x1F)) ^ ptr_u32[0];
-			hash_value = ((hash_value << 1) | (hash_value >> 0x1F)) ^ ptr_u32[1];
-			hash_value = ((hash_value << 1) | (hash_value >> 0x1F)) ^ ptr_u32[2];
-			hash_value = ((hash_value << 1) | (hash_value >> 0x1F)) ^ ptr_u32[3];
-			ptr_u32 += step;
-		}
-	}
-
-	//If texture has a palette then make hash of that too
-	//Might not be needed but it would catch if only the colors are changed in a palette texture
-	//It is a bit expensive CPU wise so better leave out unless really needed
-	//It assumes 4 byte alignment so we use u32 (faster than u8)
-	//Used in OOT for the sky, really minor so is not worth the CPU time to always check for it
-	/*if (GetFormat() == G_IM_FMT_CI)
-	{
-		const u32* ptr_u32 = (u32*)GetTlutAddress();
-		for (u32 z = 0; z < ((GetSize() == G_IM_SIZ_4b)? 8 : 128); z++) hash_value ^= *ptr_u32++;
-	}*/
 
-	//printf("%08X %d S%d P%d H%d W%d B%d\n", hash_value, step, Size, Pitch, Height, Width, Height * Pitch);
-	return hash_value;
+	return false;
 }
@@ -36,7 +36,7 @@ struct TextureInfo
 {
 private:
 	u32			LoadAddress;		// Address to texture surface
-	u32			TlutAddress;		// Address to palette
+	uintptr_t	TlutAddress;		// Host address of the palette
 	u16			Width;				// X dimensions
 	u16			Height;				// Y dimensions
 	u16			Pitch;				// Number of bytes in a texture row
@@ -68,13 +68,16 @@ public:
 	//inline u32				GetHashCode() const				{ return murmur2_neutral_hash( reinterpret_cast< const u8 * >( this ), sizeof( TextureInfo ), 0 ); }
 
 	// Compute a hash of the contents of the texture data. Not to be confused with GetHashCode() that hashes the Textureinfo!
-	u32						GenerateHashValue() const;
+	u64						GenerateHashValue() const;
+
+	// Whether the texture's data or palette could have been written since the start of epoch
+	bool					WrittenSince( u32 epoch ) const;
 
 	const char *			GetFormatName() const;
 	u32						GetSizeInBits() const;
 
 	inline u32				GetLoadAddress() const			{ return LoadAddress; }
-	inline u32				GetTlutAddress() const			{ return TlutAddress; }
+	inline uintptr_t		GetTlutAddress() const			{ return TlutAddress; }
 	inline u32				GetTmemAddress() const			{ return TmemAddress; }
 	inline u32				GetFormat() const				{ return Format; }
 	inline u32				GetSize() const					{ return Size; }
@@ -92,7 +95,7 @@ public:
 	inline bool				GetWhite() const				{ return White; }
 
 	inline void				SetLoadAddress( u32 address )	{ LoadAddress = address; }
-	inline void				SetTlutAddress( u32 address )	{ TlutAddress = address; }
+	inline void				SetTlutAddress( uintptr_t address )	{ TlutAddress = address; }
 	inline void				SetTmemAddress( u32 address )	{ TmemAddress = address; }
 	inline void				SetFormat( u32 format )			{ Format = format; }
 	inline void				SetSize( u32 size )				{ Size = size; }
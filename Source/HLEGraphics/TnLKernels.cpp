@@ -0,0 +1,226 @@
+/*
+Copyright (C) 2012 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#include "stdafx.h"
+#include "TnLKernels.h"
+
+#include "Debug/DBGConsole.h"
+#include "Math/Math.h"
+#include "Math/MathUtil.h"
+
+v3 TnL_LightVert( const TnLParams & tnl, const v3 & norm )
+{
+	const v3 & col {tnl.Lights[tnl.NumLights].Colour};
+	v3 result( col.x, col.y, col.z );
+
+	for ( u32 l {}; l < tnl.NumLights; l++ )
+	{
+		f32 fCosT {norm.Dot( tnl.Lights[l].Direction )};
+		if (fCosT > 0.0f)
+		{
+			result.x += tnl.Lights[l].Colour.x * fCosT;
+			result.y += tnl.Lights[l].Colour.y * fCosT;
+			result.z += tnl.Lights[l].Colour.z * fCosT;
+		}
+	}
+
+	//Clamp to 1.0
+	if( result.x > 1.0f ) result.x = 1.0f;
+	if( result.y > 1.0f ) result.y = 1.0f;
+	if( result.z > 1.0f ) result.z = 1.0f;
+
+	return result;
+}
+
+v3 TnL_LightPointVert( const TnLParams & tnl, const v4 & w )
+{
+	const v3 & col {tnl.Lights[tnl.NumLights].Colour};
+	v3 result( col.x, col.y, col.z );
+
+	for ( u32 l {}; l < tnl.NumLights; l++ )
+	{
+		if ( tnl.Lights[l].SkipIfZero )
+		{
+			v3 distance_vec( tnl.Lights[l].Position.x-w.x, tnl.Lights[l].Position.y-w.y, tnl.Lights[l].Position.z-w.z );
+
+			f32 light_qlen {distance_vec.LengthSq()};
+			f32 light_llen {sqrtf( light_qlen )};
+
+			f32 at = tnl.Lights[l].ca + tnl.Lights[l].la * light_llen + tnl.Lights[l].qa * light_qlen;
+			if (at > 0.0f)
+			{
+				f32 fCosT = 1.0f/at;
+				result.x += tnl.Lights[l].Colour.x * fCosT;
+				result.y += tnl.Lights[l].Colour.y * fCosT;
+				result.z += tnl.Lights[l].Colour.z * fCosT;
+			}
+		}
+	}
+
+	//Clamp to 1.0
+	if( result.x > 1.0f ) result.x = 1.0f;
+	if( result.y > 1.0f ) result.y = 1.0f;
+	if( result.z > 1.0f ) result.z = 1.0f;
+
+	return result;
+}
+
+static void TransformVertices_Scalar( DaedalusVtx4 * p_out, const FiddledVtx * p_in, u32 num_vertices,
+									  const Matrix4x4 & mat_world_project, const Matrix4x4 & mat_world, const TnLParams & tnl, bool fog )
+{
+	for (u32 i = 0; i < num_vertices; i++)
+	{
+		const FiddledVtx & vert = p_in[i];
+		DaedalusVtx4 & out = p_out[i];
+
+		// VTX Transform
+		//
+		v4 w( f32( vert.x ), f32( vert.y ), f32( vert.z ), 1.0f );
+
+		v4 & projected( out.ProjectedPos );
+		projected = mat_world_project.Transform( w );
+		out.TransformedPos = mat_world.Transform( w );
+
+		//	Initialise the clipping flags
+		//
+		u32 clip_flags {};
+		if		(projected.x < -projected.w)	clip_flags |= X_POS;
+		else if (projected.x > projected.w)		clip_flags |= X_NEG;
+
+		if		(projected.y < -projected.w)	clip_flags |= Y_POS;
+		else if (projected.y > projected.w)		clip_flags |= Y_NEG;
+
+		if		(projected.z < -projected.w)	clip_flags |= Z_POS;
+		else if (projected.z > projected.w)		clip_flags |= Z_NEG;
+		out.ClipFlags = clip_flags;
+
+		// LIGHTING OR COLOR
+		//
+		if ( tnl.Flags.Light )
+		{
+			v3 model_normal(f32( vert.norm_x ), f32( vert.norm_y ), f32( vert.norm_z ) );
+			v3 vecTransformedNormal {};
+			vecTransformedNormal = mat_world.TransformNormal( model_normal );
+			vecTransformedNormal.Normalise();
+
+			v3 col {};
+
+			if ( tnl.Flags.PointLight )
+			{//POINT LIGHT
+				col = TnL_LightPointVert( tnl, w ); // Majora's Mask uses this
+			}
+			else
+			{//NORMAL LIGHT
+				col = TnL_LightVert( tnl, vecTransformedNormal );
+			}
+			out.Colour.x = col.x;
+			out.Colour.y = col.y;
+			out.Colour.z = col.z;
+			out.Colour.w = vert.rgba_a * (1.0f / 255.0f);
+
+			// ENV MAPPING
+			//
+			if ( tnl.Flags.TexGen )
+			{
+				// Update texture coords n.b. need to divide tu/tv by bogus scale on addition to buffer
+				// If the vert is already lit, then there is no normal (and hence we can't generate tex coord)
+#if 1			// 1->Lets use mat_world_project instead of mat_world for nicer effect (see SSV space ship) //Corn
+				vecTransformedNormal = mat_world_project.TransformNormal( model_normal );
+				vecTransformedNormal.Normalise();
+#endif
+
+				const v3 & norm {vecTransformedNormal};
+
+				if( tnl.Flags.TexGenLin )
+				{
+					out.Texture.x = 0.5f * ( 1.0f + norm.x );
+					out.Texture.y = 0.5f * ( 1.0f + norm.y );
+				}
+				else
+				{
+					//Cheap way to do Acos(x)/Pi (abs() fixes star in SM64, sort of) //Corn
+					f32 NormX {fabsf( norm.x )};
+					f32 NormY {fabsf( norm.y )};
+					out.Texture.x =  0.5f - 0.25f * NormX - 0.25f * NormX * NormX * NormX;
+					out.Texture.y =  0.5f - 0.25f * NormY - 0.25f * NormY * NormY * NormY;
+				}
+			}
+			else
+			{
+				//Set Texture coordinates
+				out.Texture.x = (float)vert.tu * tnl.TextureScaleX;
+				out.Texture.y = (float)vert.tv * tnl.TextureScaleY;
+			}
+		}
+		else
+		{
+			// FLAT shade
+			out.Colour = v4( vert.rgba_r * (1.0f / 255.0f), vert.rgba_g * (1.0f / 255.0f), vert.rgba_b * (1.0f / 255.0f), vert.rgba_a * (1.0f / 255.0f) );
+
+			//Set Texture coordinates
+			out.Texture.x = (float)vert.tu * tnl.TextureScaleX;
+			out.Texture.y = (float)vert.tv * tnl.TextureScaleY;
+		}
+
+		//Fog
+		if ( fog )
+		{
+			if(projected.w > 0.0f)	//checking for positive w fixes near plane fog errors //Corn
+			{
+				f32 eye_z {projected.z / projected.w};
+				f32 fog_alpha {eye_z * tnl.FogMult + tnl.FogOffs};
+				out.Colour.w = Clamp< f32 >( fog_alpha, 0.0f, 1.0f );
+			}
+			else
+			{
+				out.Colour.w = 0.0f;
+			}
+		}
+	}
+}
+
+const TnLKernels gTnLKernelsScalar =
+{
+	"Scalar",
+	TransformVertices_Scalar,
+};
+
+const TnLKernels * gTnLKernels = &gTnLKernelsScalar;
+
+const TnLKernels * TnL_SelectKernels()
+{
+#ifdef DAEDALUS_TNL_X86
+	__builtin_cpu_init();
+	if( __builtin_cpu_supports( "avx" ) )
+		return &gTnLKernelsAVX;
+	if( __builtin_cpu_supports( "sse4.1" ) )
+		return &gTnLKernelsSSE41;
+#endif
+	return &gTnLKernelsScalar;
+}
+
+bool TnL_InitKernels()
+{
+	gTnLKernels = TnL_SelectKernels();
+
+	#ifdef DAEDALUS_DEBUG_CONSOLE
+	DBGConsole_Msg( 0, "T&L kernels: %s", gTnLKernels->Name );
+	#endif
+	return true;
+}
@@ -0,0 +1,194 @@
+/*
+Copyright (C) 2012 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#pragma once
+
+#ifndef HLEGRAPHICS_TNLKERNELS_H_
+#define HLEGRAPHICS_TNLKERNELS_H_
+
+#include "Math/Matrix4x4.h"
+#include "Math/Vector3.h"
+#include "Math/Vector4.h"
+#include "HLEGraphics/DaedalusVtx.h"
+
+// As with the audio HLE kernels, the SSE4.1 and AVX versions are built with
+// per-function target attributes and picked at runtime.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DAEDALUS_TNL_X86
+#endif
+
+struct FiddledVtx
+{
+        s16 y;
+        s16 x;
+
+        union
+        {
+			s16 flag;
+            struct
+            {
+				s8 normz;
+				u8 pad;
+            };
+        };
+        s16 z;
+
+        s16 tv;
+        s16 tu;
+
+        union
+        {
+            struct
+            {
+                    u8 rgba_a;
+                    u8 rgba_b;
+                    u8 rgba_g;
+                    u8 rgba_r;
+            };
+            struct
+            {
+                    s8 norm_a;
+                    s8 norm_z;      // b
+                    s8 norm_y;      // g
+                    s8 norm_x;      // r
+            };
+        };
+};
+DAEDALUS_STATIC_ASSERT( sizeof(FiddledVtx) == 16 );
+
+ALIGNED_TYPE(struct, DaedalusLight, 16)
+{
+	v3		Direction;		// w component is ignored. Should be normalised
+	u32		SkipIfZero;		// Used by CBFD & MM
+	v3		Colour;			// Colour, components in range 0..1
+	f32		Iscale;			// Used by CBFD
+	v4		Position;		// Position -32768 to 32767
+	f32		ca;				// Used by MM(GBI2 point light)
+	f32		la;				// Used by MM(GBI2 point light)
+	f32		qa;				// Used by MM(GBI2 point light)
+	u32		Pad0;			// Padding
+};
+DAEDALUS_STATIC_ASSERT( sizeof( DaedalusLight ) == 64 );	//Size=64 bytes and order is important or VFPU ASM for PSP will fail
+
+// Order here should be the same as in TnLMode
+enum ETnLModeFlags
+{
+	TNL_LIGHT		= 1 << 0,
+	TNL_TEXGEN		= 1 << 1,
+	TNL_TEXGENLIN	= 1 << 2,
+	TNL_FOG			= 1 << 3,
+	TNL_SHADE		= 1 << 4,
+	TNL_ZBUFFER		= 1 << 5,
+	TNL_TRICULL		= 1 << 6,
+	TNL_CULLBACK	= 1 << 7,
+	TNL_POINTLIGHT	= 1 << 8,
+};
+
+struct TnLMode
+{
+	union
+	{
+		struct
+		{
+			u32 Light : 1;			// 0x1
+			u32 TexGen : 1;			// 0x2
+			u32 TexGenLin : 1;		// 0x4
+			u32 Fog : 1;			// 0x8
+			u32 Shade : 1;			// 0x10
+			u32 Zbuffer : 1;		// 0x20
+			u32 TriCull : 1;		// 0x40
+			u32 CullBack : 1;		// 0x80
+			u32 PointLight : 1;		// 0x100
+			u32 pad0 : 23;			// 0x0
+		};
+
+		struct
+		{
+			u16 Modes;
+			u16 Texture;
+		};
+
+		u32	_u32;
+	};
+};
+
+ALIGNED_TYPE(struct, TnLParams, 16)
+{
+	TnLMode			Flags;			//TnL flags
+	u32				NumLights;		//Number of lights
+	f32				TextureScaleX;	//Texture scale X
+	f32				TextureScaleY;	//Texture scale Y
+	DaedalusLight	Lights[12];		//Conker uses up to 12 lights
+	f32				CoordMod[16];	//Used by CBFD lights
+	f32				FogMult;		//Fog mult
+	f32				FogOffs;		//Fog offset
+};
+//DAEDALUS_STATIC_ASSERT( sizeof( TnLParams ) == 32 );
+
+// Bits for clipping
+// 543210
+// +++---
+// zyxzyx
+// NB: These are ordered such that the VFPU can generate them easily - make sure you keep the VFPU code up to date if changing these.
+#define X_NEG  0x01	//left
+#define Y_NEG  0x02	//bottom
+#define Z_NEG  0x04	//far
+#define X_POS  0x08	//right
+#define Y_POS  0x10	//top
+#define Z_POS  0x20	//near
+#define CLIP_TEST_FLAGS ( X_POS | X_NEG | Y_POS | Y_NEG | Z_POS | Z_NEG )
+
+// Most vertices a kernel transforms in one call. BaseRenderer splits larger loads.
+static const u32 kTnLBatchSize = 32;
+
+//
+//	The vertex transform and lighting of BaseRenderer::SetNewVertexInfo, for
+//	platforms without TnLVFPU.S. The vector versions work on the whole batch at
+//	once, with the vertices unpacked into one array per component (see
+//	HLEGraphics/TnLKernelsSIMD.inl). Results should match the scalar kernel to
+//	within rounding, and the clip flags exactly - see HLEGraphics/TnLKernels_test.cpp
+//	and HLEGraphics/TnLKernels_bench.cpp.
+//
+struct TnLKernels
+{
+	const char *	Name;
+
+	// Fills in everything but Pad for num_vertices (at most kTnLBatchSize) vertices.
+	// Colour.w is only overwritten with fog if fog is set, as only the PSP fogs per vertex.
+	void	(*TransformVertices)( DaedalusVtx4 * p_out, const FiddledVtx * p_in, u32 num_vertices,
+								  const Matrix4x4 & world_project, const Matrix4x4 & world, const TnLParams & tnl, bool fog );
+};
+
+extern const TnLKernels		gTnLKernelsScalar;
+#ifdef DAEDALUS_TNL_X86
+extern const TnLKernels		gTnLKernelsSSE41;
+extern const TnLKernels		gTnLKernelsAVX;
+#endif
+
+// The fastest set of kernels this CPU supports. Scalar until TnL_InitKernels is called.
+extern const TnLKernels *	gTnLKernels;
+
+const TnLKernels *			TnL_SelectKernels();
+bool						TnL_InitKernels();
+
+// Lighting for a single vertex, as the scalar kernel does it. Each component is clamped to 1.
+v3							TnL_LightVert( const TnLParams & tnl, const v3 & norm );
+v3							TnL_LightPointVert( const TnLParams & tnl, const v4 & w );
+
+#endif // HLEGRAPHICS_TNLKERNELS_H_
@@ -0,0 +1,297 @@
+/*
+Copyright (C) 2012 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+//
+//	The vector T&L kernel, written against VecF, a vector of kLanes floats.
+//	Whoever includes this supplies, in its own namespace:
+//
+//		TNL_SIMD_TARGET				attributes for every function here
+//		VecF, kLanes
+//		VLoad, VStore				aligned f32 loads and stores
+//		VStoreBits					stores the raw bits of each lane to a u32
+//		VSet, VBits					broadcast a float, or a u32's bits
+//		VAdd, VSub, VMul, VDiv, VMin, VMax, VSqrt, VAbs
+//		VLess, VGreater				all bits set in the lanes where the comparison holds
+//		VAnd, VOr, VAndNot			VAndNot( a, b ) is a & ~b
+//
+//	See HLEGraphics/TnLKernelsX86.cpp. A NEON version only needs the above.
+//
+//	Arithmetic is done in the same order as the scalar kernel, without fused
+//	multiply-adds, so the results only differ where the scalar code is compiled
+//	differently (e.g. with x87 or FMA contraction).
+//
+
+DAEDALUS_STATIC_ASSERT( kTnLBatchSize % kLanes == 0 );
+
+// The vertices being transformed, one array per component
+struct TnLBatch
+{
+	// In
+	ALIGNED_MEMBER(f32, X[ kTnLBatchSize ], 32);
+	ALIGNED_MEMBER(f32, Y[ kTnLBatchSize ], 32);
+	ALIGNED_MEMBER(f32, Z[ kTnLBatchSize ], 32);
+	ALIGNED_MEMBER(f32, NormX[ kTnLBatchSize ], 32);
+	ALIGNED_MEMBER(f32, NormY[ kTnLBatchSize ], 32);
+	ALIGNED_MEMBER(f32, NormZ[ kTnLBatchSize ], 32);
+	ALIGNED_MEMBER(f32, R[ kTnLBatchSize ], 32);
+	ALIGNED_MEMBER(f32, G[ kTnLBatchSize ], 32);
+	ALIGNED_MEMBER(f32, B[ kTnLBatchSize ], 32);
+	ALIGNED_MEMBER(f32, A[ kTnLBatchSize ], 32);
+	ALIGNED_MEMBER(f32, TU[ kTnLBatchSize ], 32);
+	ALIGNED_MEMBER(f32, TV[ kTnLBatchSize ], 32);
+
+	// Out
+	ALIGNED_MEMBER(f32, TransX[ kTnLBatchSize ], 32);
+	ALIGNED_MEMBER(f32, TransY[ kTnLBatchSize ], 32);
+	ALIGNED_MEMBER(f32, TransZ[ kTnLBatchSize ], 32);
+	ALIGNED_MEMBER(f32, TransW[ kTnLBatchSize ], 32);
+	ALIGNED_MEMBER(f32, ProjX[ kTnLBatchSize ], 32);
+	ALIGNED_MEMBER(f32, ProjY[ kTnLBatchSize ], 32);
+	ALIGNED_MEMBER(f32, ProjZ[ kTnLBatchSize ], 32);
+	ALIGNED_MEMBER(f32, ProjW[ kTnLBatchSize ], 32);
+	ALIGNED_MEMBER(f32, ColR[ kTnLBatchSize ], 32);
+	ALIGNED_MEMBER(f32, ColG[ kTnLBatchSize ], 32);
+	ALIGNED_MEMBER(f32, ColB[ kTnLBatchSize ], 32);
+	ALIGNED_MEMBER(f32, ColA[ kTnLBatchSize ], 32);
+	ALIGNED_MEMBER(f32, U[ kTnLBatchSize ], 32);
+	ALIGNED_MEMBER(f32, V[ kTnLBatchSize ], 32);
+	ALIGNED_MEMBER(u32, ClipFlags[ kTnLBatchSize ], 32);
+};
+
+// One component of Matrix4x4::Transform, for a point with w = 1
+TNL_SIMD_TARGET static inline VecF TransformPoint( VecF x, VecF y, VecF z, f32 mx, f32 my, f32 mz, f32 mw )
+{
+	return VAdd( VAdd( VAdd( VMul( x, VSet( mx ) ), VMul( y, VSet( my ) ) ), VMul( z, VSet( mz ) ) ), VSet( mw ) );
+}
+
+// One component of Matrix4x4::TransformNormal
+TNL_SIMD_TARGET static inline VecF TransformNormal( VecF x, VecF y, VecF z, f32 mx, f32 my, f32 mz )
+{
+	return VAdd( VAdd( VMul( x, VSet( mx ) ), VMul( y, VSet( my ) ) ), VMul( z, VSet( mz ) ) );
+}
+
+TNL_SIMD_TARGET static inline VecF Dot( VecF ax, VecF ay, VecF az, VecF bx, VecF by, VecF bz )
+{
+	return VAdd( VAdd( VMul( ax, bx ), VMul( ay, by ) ), VMul( az, bz ) );
+}
+
+// v3::Normalise, which leaves zero length vectors alone
+TNL_SIMD_TARGET static inline void Normalise( VecF & x, VecF & y, VecF & z )
+{
+	VecF	len_sq( Dot( x, y, z, x, y, z ) );
+	VecF	non_zero( VGreater( len_sq, VSet( 0.0f ) ) );
+	VecF	r( VAnd( non_zero, VDiv( VSet( 1.0f ), VSqrt( len_sq ) ) ) );
+	VecF	keep( VAndNot( VSet( 1.0f ), non_zero ) );
+
+	r = VOr( r, keep );
+	x = VMul( x, r );
+	y = VMul( y, r );
+	z = VMul( z, r );
+}
+
+// The scalar code sets the POS flag if p < -w, otherwise the NEG flag if p > w
+TNL_SIMD_TARGET static inline VecF ClipBits( VecF p, VecF w, VecF neg_w, u32 pos, u32 neg )
+{
+	VecF	below( VLess( p, neg_w ) );
+	VecF	above( VAndNot( VGreater( p, w ), below ) );
+
+	return VOr( VAnd( below, VBits( pos ) ), VAnd( above, VBits( neg ) ) );
+}
+
+TNL_SIMD_TARGET static inline void TransformLanes( TnLBatch & b, u32 i, const Matrix4x4 & wp, const Matrix4x4 & w, const TnLParams & tnl, bool fog )
+{
+	const VecF	x( VLoad( &b.X[ i ] ) );
+	const VecF	y( VLoad( &b.Y[ i ] ) );
+	const VecF	z( VLoad( &b.Z[ i ] ) );
+
+	const VecF	proj_x( TransformPoint( x, y, z, wp.m11, wp.m21, wp.m31, wp.m41 ) );
+	const VecF	proj_y( TransformPoint( x, y, z, wp.m12, wp.m22, wp.m32, wp.m42 ) );
+	const VecF	proj_z( TransformPoint( x, y, z, wp.m13, wp.m23, wp.m33, wp.m43 ) );
+	const VecF	proj_w( TransformPoint( x, y, z, wp.m14, wp.m24, wp.m34, wp.m44 ) );
+	VStore( &b.ProjX[ i ], proj_x );
+	VStore( &b.ProjY[ i ], proj_y );
+	VStore( &b.ProjZ[ i ], proj_z );
+	VStore( &b.ProjW[ i ], proj_w );
+
+	VStore( &b.TransX[ i ], TransformPoint( x, y, z, w.m11, w.m21, w.m31, w.m41 ) );
+	VStore( &b.TransY[ i ], TransformPoint( x, y, z, w.m12, w.m22, w.m32, w.m42 ) );
+	VStore( &b.TransZ[ i ], TransformPoint( x, y, z, w.m13, w.m23, w.m33, w.m43 ) );
+	VStore( &b.TransW[ i ], TransformPoint( x, y, z, w.m14, w.m24, w.m34, w.m44 ) );
+
+	const VecF	neg_w( VSub( VSet( 0.0f ), proj_w ) );
+	VStoreBits( &b.ClipFlags[ i ], VOr( VOr( ClipBits( proj_x, proj_w, neg_w, X_POS, X_NEG ),
+											  ClipBits( proj_y, proj_w, neg_w, Y_POS, Y_NEG ) ),
+											  ClipBits( proj_z, proj_w, neg_w, Z_POS, Z_NEG ) ) );
+
+	const VecF	inv_255( VSet( 1.0f / 255.0f ) );
+	VecF		col_a( VMul( VLoad( &b.A[ i ] ), inv_255 ) );
+	VecF		tex_u( VMul( VLoad( &b.TU[ i ] ), VSet( tnl.TextureScaleX ) ) );
+	VecF		tex_v( VMul( VLoad( &b.TV[ i ] ), VSet( tnl.TextureScaleY ) ) );
+
+	if( tnl.Flags.Light )
+	{
+		const VecF	model_x( VLoad( &b.NormX[ i ] ) );
+		const VecF	model_y( VLoad( &b.NormY[ i ] ) );
+		const VecF	model_z( VLoad( &b.NormZ[ i ] ) );
+
+		const v3 &	ambient( tnl.Lights[ tnl.NumLights ].Colour );
+		VecF		col_r( VSet( ambient.x ) );
+		VecF		col_g( VSet( ambient.y ) );
+		VecF		col_b( VSet( ambient.z ) );
+
+		if( tnl.Flags.PointLight )
+		{
+			// Majora's Mask uses this. Distances are from the untransformed vertex.
+			for( u32 l = 0; l < tnl.NumLights; l++ )
+			{
+				const DaedalusLight &	light( tnl.Lights[ l ] );
+				if( !light.SkipIfZero )
+					continue;
+
+				const VecF	dx( VSub( VSet( light.Position.x ), x ) );
+				const VecF	dy( VSub( VSet( light.Position.y ), y ) );
+				const VecF	dz( VSub( VSet( light.Position.z ), z ) );
+				const VecF	qlen( Dot( dx, dy, dz, dx, dy, dz ) );
+				const VecF	llen( VSqrt( qlen ) );
+				const VecF	at( VAdd( VAdd( VSet( light.ca ), VMul( VSet( light.la ), llen ) ), VMul( VSet( light.qa ), qlen ) ) );
+				const VecF	cos_t( VAnd( VGreater( at, VSet( 0.0f ) ), VDiv( VSet( 1.0f ), at ) ) );
+
+				col_r = VAdd( col_r, VMul( VSet( light.Colour.x ), cos_t ) );
+				col_g = VAdd( col_g, VMul( VSet( light.Colour.y ), cos_t ) );
+				col_b = VAdd( col_b, VMul( VSet( light.Colour.z ), cos_t ) );
+			}
+		}
+		else
+		{
+			VecF	norm_x( TransformNormal( model_x, model_y, model_z, w.m11, w.m21, w.m31 ) );
+			VecF	norm_y( TransformNormal( model_x, model_y, model_z, w.m12, w.m22, w.m32 ) );
+			VecF	norm_z( TransformNormal( model_x, model_y, model_z, w.m13, w.m23, w.m33 ) );
+			Normalise( norm_x, norm_y, norm_z );
+
+			for( u32 l = 0; l < tnl.NumLights; l++ )
+			{
+				const DaedalusLight &	light( tnl.Lights[ l ] );
+				const VecF	dot( Dot( norm_x, norm_y, norm_z, VSet( light.Direction.x ), VSet( light.Direction.y ), VSet( light.Direction.z ) ) );
+				const VecF	cos_t( VAnd( VGreater( dot, VSet( 0.0f ) ), dot ) );
+
+				col_r = VAdd( col_r, VMul( VSet( light.Colour.x ), cos_t ) );
+				col_g = VAdd( col_g, VMul( VSet( light.Colour.y ), cos_t ) );
+				col_b = VAdd( col_b, VMul( VSet( light.Colour.z ), cos_t ) );
+			}
+		}
+
+		VStore( &b.ColR[ i ], VMin( col_r, VSet( 1.0f ) ) );
+		VStore( &b.ColG[ i ], VMin( col_g, VSet( 1.0f ) ) );
+		VStore( &b.ColB[ i ], VMin( col_b, VSet( 1.0f ) ) );
+
+		if( tnl.Flags.TexGen )
+		{
+			// As with the scalar code, this uses the world-project matrix for a nicer effect
+			VecF	norm_x( TransformNormal( model_x, model_y, model_z, wp.m11, wp.m21, wp.m31 ) );
+			VecF	norm_y( TransformNormal( model_x, model_y, model_z, wp.m12, wp.m22, wp.m32 ) );
+			VecF	norm_z( TransformNormal( model_x, model_y, model_z, wp.m13, wp.m23, wp.m33 ) );
+			Normalise( norm_x, norm_y, norm_z );
+
+			if( tnl.Flags.TexGenLin )
+			{
+				tex_u = VMul( VSet( 0.5f ), VAdd( VSet( 1.0f ), norm_x ) );
+				tex_v = VMul( VSet( 0.5f ), VAdd( VSet( 1.0f ), norm_y ) );
+			}
+			else
+			{
+				const VecF	abs_x( VAbs( norm_x ) );
+				const VecF	abs_y( VAbs( norm_y ) );
+				const VecF	quarter_x( VMul( VSet( 0.25f ), abs_x ) );
+				const VecF	quarter_y( VMul( VSet( 0.25f ), abs_y ) );
+
+				tex_u = VSub( VSub( VSet( 0.5f ), quarter_x ), VMul( VMul( quarter_x, abs_x ), abs_x ) );
+				tex_v = VSub( VSub( VSet( 0.5f ), quarter_y ), VMul( VMul( quarter_y, abs_y ), abs_y ) );
+			}
+		}
+	}
+	else
+	{
+		VStore( &b.ColR[ i ], VMul( VLoad( &b.R[ i ] ), inv_255 ) );
+		VStore( &b.ColG[ i ], VMul( VLoad( &b.G[ i ] ), inv_255 ) );
+		VStore( &b.ColB[ i ], VMul( VLoad( &b.B[ i ] ), inv_255 ) );
+	}
+
+	if( fog )
+	{
+		// Vertices behind the eye get no fog alpha at all
+		const VecF	fog_alpha( VAdd( VMul( VDiv( proj_z, proj_w ), VSet( tnl.FogMult ) ), VSet( tnl.FogOffs ) ) );
+		const VecF	in_front( VGreater( proj_w, VSet( 0.0f ) ) );
+
+		col_a = VAnd( in_front, VMin( VMax( fog_alpha, VSet( 0.0f ) ), VSet( 1.0f ) ) );
+	}
+
+	VStore( &b.ColA[ i ], col_a );
+	VStore( &b.U[ i ], tex_u );
+	VStore( &b.V[ i ], tex_v );
+}
+
+TNL_SIMD_TARGET static void TransformVertices( DaedalusVtx4 * p_out, const FiddledVtx * p_in, u32 num_vertices,
+											   const Matrix4x4 & world_project, const Matrix4x4 & world, const TnLParams & tnl, bool fog )
+{
+	DAEDALUS_ASSERT( num_vertices <= kTnLBatchSize, "Too many vertices for one batch (%d)", num_vertices );
+
+	TnLBatch	b;
+	const u32	num_lanes( ( num_vertices + kLanes - 1 ) & ~( kLanes - 1 ) );
+
+	for( u32 i = 0; i < num_vertices; i++ )
+	{
+		const FiddledVtx &	vert( p_in[ i ] );
+		b.X[ i ]     = f32( vert.x );
+		b.Y[ i ]     = f32( vert.y );
+		b.Z[ i ]     = f32( vert.z );
+		b.NormX[ i ] = f32( vert.norm_x );
+		b.NormY[ i ] = f32( vert.norm_y );
+		b.NormZ[ i ] = f32( vert.norm_z );
+		b.R[ i ]     = f32( vert.rgba_r );
+		b.G[ i ]     = f32( vert.rgba_g );
+		b.B[ i ]     = f32( vert.rgba_b );
+		b.A[ i ]     = f32( vert.rgba_a );
+		b.TU[ i ]    = f32( vert.tu );
+		b.TV[ i ]    = f32( vert.tv );
+	}
+
+	// Whatever comes out of the padding lanes is thrown away
+	for( u32 i = num_vertices; i < num_lanes; i++ )
+	{
+		b.X[ i ] = b.Y[ i ] = b.Z[ i ] = 0.0f;
+		b.NormX[ i ] = b.NormY[ i ] = b.NormZ[ i ] = 0.0f;
+		b.R[ i ] = b.G[ i ] = b.B[ i ] = b.A[ i ] = 0.0f;
+		b.TU[ i ] = b.TV[ i ] = 0.0f;
+	}
+
+	for( u32 i = 0; i < num_lanes; i += kLanes )
+	{
+		TransformLanes( b, i, world_project, world, tnl, fog );
+	}
+
+	for( u32 i = 0; i < num_vertices; i++ )
+	{
+		DaedalusVtx4 &	out( p_out[ i ] );
+		out.TransformedPos = v4( b.TransX[ i ], b.TransY[ i ], b.TransZ[ i ], b.TransW[ i ] );
+		out.ProjectedPos   = v4( b.ProjX[ i ], b.ProjY[ i ], b.ProjZ[ i ], b.ProjW[ i ] );
+		out.Colour         = v4( b.ColR[ i ], b.ColG[ i ], b.ColB[ i ], b.ColA[ i ] );
+		out.Texture        = v2( b.U[ i ], b.V[ i ] );
+		out.ClipFlags      = b.ClipFlags[ i ];
+	}
+}
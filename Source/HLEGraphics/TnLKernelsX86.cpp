@@ -0,0 +1,118 @@
+/*
+Copyright (C) 2012 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+//
+//	SSE4.1 and AVX versions of the T&L kernel. Both share the kernel in
+//	TnLKernelsSIMD.inl, and only differ in the vector operations they give it.
+//
+
+#include "stdafx.h"
+#include "TnLKernels.h"
+
+#ifdef DAEDALUS_TNL_X86
+
+#include <immintrin.h>
+
+#include "Utility/Alignment.h"
+
+//*****************************************************************************
+//	SSE4.1
+//*****************************************************************************
+namespace TnLSSE41
+{
+
+#define TNL_SIMD_TARGET		__attribute__((target("sse4.1")))
+
+typedef __m128		VecF;
+static const u32	kLanes = 4;
+
+TNL_SIMD_TARGET static inline VecF VLoad( const f32 * p )					{ return _mm_load_ps( p ); }
+TNL_SIMD_TARGET static inline void VStore( f32 * p, VecF a )				{ _mm_store_ps( p, a ); }
+TNL_SIMD_TARGET static inline void VStoreBits( u32 * p, VecF a )			{ _mm_store_si128( (__m128i *)p, _mm_castps_si128( a ) ); }
+TNL_SIMD_TARGET static inline VecF VSet( f32 a )							{ return _mm_set1_ps( a ); }
+TNL_SIMD_TARGET static inline VecF VBits( u32 a )							{ return _mm_castsi128_ps( _mm_set1_epi32( a ) ); }
+TNL_SIMD_TARGET static inline VecF VAdd( VecF a, VecF b )					{ return _mm_add_ps( a, b ); }
+TNL_SIMD_TARGET static inline VecF VSub( VecF a, VecF b )					{ return _mm_sub_ps( a, b ); }
+TNL_SIMD_TARGET static inline VecF VMul( VecF a, VecF b )					{ return _mm_mul_ps( a, b ); }
+TNL_SIMD_TARGET static inline VecF VDiv( VecF a, VecF b )					{ return _mm_div_ps( a, b ); }
+TNL_SIMD_TARGET static inline VecF VMin( VecF a, VecF b )					{ return _mm_min_ps( a, b ); }
+TNL_SIMD_TARGET static inline VecF VMax( VecF a, VecF b )					{ return _mm_max_ps( a, b ); }
+TNL_SIMD_TARGET static inline VecF VSqrt( VecF a )							{ return _mm_sqrt_ps( a ); }
+TNL_SIMD_TARGET static inline VecF VAbs( VecF a )							{ return _mm_andnot_ps( _mm_set1_ps( -0.0f ), a ); }
+TNL_SIMD_TARGET static inline VecF VLess( VecF a, VecF b )					{ return _mm_cmplt_ps( a, b ); }
+TNL_SIMD_TARGET static inline VecF VGreater( VecF a, VecF b )				{ return _mm_cmpgt_ps( a, b ); }
+TNL_SIMD_TARGET static inline VecF VAnd( VecF a, VecF b )					{ return _mm_and_ps( a, b ); }
+TNL_SIMD_TARGET static inline VecF VOr( VecF a, VecF b )					{ return _mm_or_ps( a, b ); }
+TNL_SIMD_TARGET static inline VecF VAndNot( VecF a, VecF b )				{ return _mm_andnot_ps( b, a ); }
+
+#include "TnLKernelsSIMD.inl"
+
+#undef TNL_SIMD_TARGET
+
+}
+
+const TnLKernels gTnLKernelsSSE41 =
+{
+	"SSE4.1",
+	TnLSSE41::TransformVertices,
+};
+
+//*****************************************************************************
+//	AVX
+//*****************************************************************************
+namespace TnLAVX
+{
+
+#define TNL_SIMD_TARGET		__attribute__((target("avx")))
+
+typedef __m256		VecF;
+static const u32	kLanes = 8;
+
+TNL_SIMD_TARGET static inline VecF VLoad( const f32 * p )					{ return _mm256_load_ps( p ); }
+TNL_SIMD_TARGET static inline void VStore( f32 * p, VecF a )				{ _mm256_store_ps( p, a ); }
+TNL_SIMD_TARGET static inline void VStoreBits( u32 * p, VecF a )			{ _mm256_store_si256( (__m256i *)p, _mm256_castps_si256( a ) ); }
+TNL_SIMD_TARGET static inline VecF VSet( f32 a )							{ return _mm256_set1_ps( a ); }
+TNL_SIMD_TARGET static inline VecF VBits( u32 a )							{ return _mm256_castsi256_ps( _mm256_set1_epi32( a ) ); }
+TNL_SIMD_TARGET static inline VecF VAdd( VecF a, VecF b )					{ return _mm256_add_ps( a, b ); }
+TNL_SIMD_TARGET static inline VecF VSub( VecF a, VecF b )					{ return _mm256_sub_ps( a, b ); }
+TNL_SIMD_TARGET static inline VecF VMul( VecF a, VecF b )					{ return _mm256_mul_ps( a, b ); }
+TNL_SIMD_TARGET static inline VecF VDiv( VecF a, VecF b )					{ return _mm256_div_ps( a, b ); }
+TNL_SIMD_TARGET static inline VecF VMin( VecF a, VecF b )					{ return _mm256_min_ps( a, b ); }
+TNL_SIMD_TARGET static inline VecF VMax( VecF a, VecF b )					{ return _mm256_max_ps( a, b ); }
+TNL_SIMD_TARGET static inline VecF VSqrt( VecF a )							{ return _mm256_sqrt_ps( a ); }
+TNL_SIMD_TARGET static inline VecF VAbs( VecF a )							{ return _mm256_andnot_ps( _mm256_set1_ps( -0.0f ), a ); }
+TNL_SIMD_TARGET static inline VecF VLess( VecF a, VecF b )					{ return _mm256_cmp_ps( a, b, _CMP_LT_OQ ); }
+TNL_SIMD_TARGET static inline VecF VGreater( VecF a, VecF b )				{ return _mm256_cmp_ps( a, b, _CMP_GT_OQ ); }
+TNL_SIMD_TARGET static inline VecF VAnd( VecF a, VecF b )					{ return _mm256_and_ps( a, b ); }
+TNL_SIMD_TARGET static inline VecF VOr( VecF a, VecF b )					{ return _mm256_or_ps( a, b ); }
+TNL_SIMD_TARGET static inline VecF VAndNot( VecF a, VecF b )				{ return _mm256_andnot_ps( b, a ); }
+
+#include "TnLKernelsSIMD.inl"
+
+#undef TNL_SIMD_TARGET
+
+}
+
+const TnLKernels gTnLKernelsAVX =
+{
+	"AVX",
+	TnLAVX::TransformVertices,
+};
+
+#endif // DAEDALUS_TNL_X86
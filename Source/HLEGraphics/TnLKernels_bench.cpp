@@ -0,0 +1,217 @@
+// Microbenchmark for the T&L kernels. Transforms batches of random vertices through the scalar, SSE4.1
+// and AVX kernels in each of the lighting modes games use, and reports the largest difference from
+// the scalar results alongside the timings.
+
+#include "stdafx.h"
+#include "HLEGraphics/TnLKernels.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <vector>
+
+static const u32	kNumVertices = 4096;			// Enough to fall out of L1, like a busy frame
+static const u32	kMinTransformedVertices = 4000000;
+
+struct SMode
+{
+	const char *	Name;
+	u32				Flags;
+	bool			Fog;
+};
+
+static const SMode	kModes[] =
+{
+	{ "Unlit",		0,										false },
+	{ "Unlit+fog",	0,										true },
+	{ "Lit",		TNL_LIGHT,								false },
+	{ "Point",		TNL_LIGHT | TNL_POINTLIGHT,				false },
+	{ "EnvMap",		TNL_LIGHT | TNL_TEXGEN,					false },
+	{ "EnvMapLin",	TNL_LIGHT | TNL_TEXGEN | TNL_TEXGENLIN,	false },
+};
+
+static u32 gSeed( 0x12345678 );
+
+static u32 Random()
+{
+	gSeed = gSeed * 1664525 + 1013904223;
+	return gSeed >> 8;
+}
+
+static f32 RandomFloat( f32 lo, f32 hi )
+{
+	return lo + ( hi - lo ) * f32( Random() & 0xffff ) / 65536.0f;
+}
+
+struct SScene
+{
+	Matrix4x4					World;
+	Matrix4x4					WorldProject;
+	TnLParams					TnL;
+	std::vector< FiddledVtx >	Vertices;
+	std::vector< u32 >			BatchSizes;			// Games load anything from a handful of vertices to a full batch
+};
+
+static void MakeScene( SScene & scene )
+{
+	f32		a( 0.7f ), c( cosf( a ) ), s( sinf( a ) );
+	scene.World = Matrix4x4( c, 0.0f, -s, 0.0f,
+							 0.0f, 1.0f, 0.0f, 0.0f,
+							 s, 0.0f, c, 0.0f,
+							 50.0f, -80.0f, -1200.0f, 1.0f );
+
+	const f32	n( 10.0f ), f( 5000.0f );
+	Matrix4x4	project( 1.5f, 0.0f, 0.0f, 0.0f,
+						 0.0f, 2.0f, 0.0f, 0.0f,
+						 0.0f, 0.0f, -( f + n ) / ( f - n ), -1.0f,
+						 0.0f, 0.0f, -2.0f * f * n / ( f - n ), 0.0f );
+	scene.WorldProject = scene.World * project;
+
+	scene.TnL = TnLParams();
+	scene.TnL.NumLights = 2;
+	scene.TnL.TextureScaleX = 1.0f / 32.0f;
+	scene.TnL.TextureScaleY = 1.0f / 32.0f;
+	scene.TnL.FogMult = 12.0f;
+	scene.TnL.FogOffs = -11.0f;
+	for( u32 l = 0; l <= scene.TnL.NumLights; ++l )
+	{
+		DaedalusLight &	light( scene.TnL.Lights[ l ] );
+		light.Direction = v3( RandomFloat( -1.0f, 1.0f ), RandomFloat( -1.0f, 1.0f ), RandomFloat( 0.1f, 1.0f ) );
+		light.Direction.Normalise();
+		light.Colour = v3( RandomFloat( 0.0f, 0.6f ), RandomFloat( 0.0f, 0.6f ), RandomFloat( 0.0f, 0.6f ) );
+		light.Position = v4( RandomFloat( -1000.0f, 1000.0f ), RandomFloat( -1000.0f, 1000.0f ), RandomFloat( -1000.0f, 1000.0f ), 1.0f );
+		light.SkipIfZero = 1;
+		light.ca = 1.0f;
+		light.la = 0.002f;
+		light.qa = 0.00001f;
+	}
+
+	scene.Vertices.resize( kNumVertices );
+	for( u32 i = 0; i < kNumVertices; ++i )
+	{
+		FiddledVtx &	vert( scene.Vertices[ i ] );
+		vert.x = s16( RandomFloat( -1000.0f, 1000.0f ) );
+		vert.y = s16( RandomFloat( -1000.0f, 1000.0f ) );
+		vert.z = s16( RandomFloat( -1000.0f, 1000.0f ) );
+		vert.flag = s16( Random() );
+		vert.tu = s16( Random() );
+		vert.tv = s16( Random() );
+		vert.rgba_r = u8( Random() );
+		vert.rgba_g = u8( Random() );
+		vert.rgba_b = u8( Random() );
+		vert.rgba_a = u8( Random() );
+	}
+
+	for( u32 total = 0; total < kNumVertices; )
+	{
+		u32		n( Random() % 3 == 0 ? 3 + Random() % ( kTnLBatchSize - 3 ) : kTnLBatchSize );
+		if( total + n > kNumVertices )
+			n = kNumVertices - total;
+		scene.BatchSizes.push_back( n );
+		total += n;
+	}
+}
+
+static void TransformScene( const TnLKernels & kernels, const SScene & scene, bool fog, DaedalusVtx4 * p_out )
+{
+	u32		v( 0 );
+	for( u32 b = 0; b < scene.BatchSizes.size(); ++b )
+	{
+		kernels.TransformVertices( p_out + v, &scene.Vertices[ v ], scene.BatchSizes[ b ], scene.WorldProject, scene.World, scene.TnL, fog );
+		v += scene.BatchSizes[ b ];
+	}
+}
+
+static f32 MaxDifference( const v4 & a, const v4 & b )
+{
+	f32		d( fabsf( a.x - b.x ) );
+	if( fabsf( a.y - b.y ) > d )	d = fabsf( a.y - b.y );
+	if( fabsf( a.z - b.z ) > d )	d = fabsf( a.z - b.z );
+	if( fabsf( a.w - b.w ) > d )	d = fabsf( a.w - b.w );
+	return d;
+}
+
+template< typename T > static double Time( T fn )
+{
+	std::chrono::high_resolution_clock::time_point	start( std::chrono::high_resolution_clock::now() );
+	fn();
+	std::chrono::high_resolution_clock::time_point	end( std::chrono::high_resolution_clock::now() );
+	return std::chrono::duration< double, std::milli >( end - start ).count();
+}
+
+int main( int argc, char ** argv )
+{
+	SScene	scene;
+	MakeScene( scene );
+
+	std::vector< const TnLKernels * >	kernels;
+	kernels.push_back( &gTnLKernelsScalar );
+#ifdef DAEDALUS_TNL_X86
+	__builtin_cpu_init();
+	if( __builtin_cpu_supports( "sse4.1" ) )
+		kernels.push_back( &gTnLKernelsSSE41 );
+	if( __builtin_cpu_supports( "avx" ) )
+		kernels.push_back( &gTnLKernelsAVX );
+#endif
+
+	printf( "%u vertices in %u batches. Runtime selection: %s\n", kNumVertices, (u32)scene.BatchSizes.size(), TnL_SelectKernels()->Name );
+
+	std::vector< DaedalusVtx4 >	expected( kNumVertices );
+	std::vector< DaedalusVtx4 >	actual( kNumVertices );
+	const u32					repeats( kMinTransformedVertices / kNumVertices );
+	bool						clip_flags_match( true );
+
+	for( u32 m = 0; m < ARRAYSIZE( kModes ); ++m )
+	{
+		const SMode &	mode( kModes[ m ] );
+		scene.TnL.Flags._u32 = mode.Flags;
+
+		TransformScene( gTnLKernelsScalar, scene, mode.Fog, &expected[ 0 ] );
+
+		double	scalar_ms( 0.0 );
+		for( u32 k = 0; k < kernels.size(); ++k )
+		{
+			TransformScene( *kernels[ k ], scene, mode.Fog, &actual[ 0 ] );
+
+			f32		max_diff( 0.0f );
+			u32		clip_mismatches( 0 );
+			for( u32 i = 0; i < kNumVertices; ++i )
+			{
+				const DaedalusVtx4 &	e( expected[ i ] );
+				const DaedalusVtx4 &	a( actual[ i ] );
+				f32		d( MaxDifference( e.ProjectedPos, a.ProjectedPos ) / ( 1.0f + fabsf( e.ProjectedPos.w ) ) );
+				if( d > max_diff )	max_diff = d;
+				d = MaxDifference( e.Colour, a.Colour );
+				if( d > max_diff )	max_diff = d;
+				d = MaxDifference( v4( e.Texture.x, e.Texture.y, 0.0f, 0.0f ), v4( a.Texture.x, a.Texture.y, 0.0f, 0.0f ) );
+				if( d > max_diff )	max_diff = d;
+				if( e.ClipFlags != a.ClipFlags )
+					clip_mismatches++;
+			}
+			clip_flags_match &= clip_mismatches == 0;
+
+			double	ms( Time( [&]()
+			{
+				for( u32 r = 0; r < repeats; ++r )
+				{
+					TransformScene( *kernels[ k ], scene, mode.Fog, &actual[ 0 ] );
+				}
+			} ) );
+
+			if( k == 0 )
+			{
+				scalar_ms = ms;
+			}
+			printf( "%-10s %-7s %8.2fms (%5.2fns/vertex, %4.2fx) max diff %g, %u clip flag mismatches\n", mode.Name, kernels[ k ]->Name,
+					ms, ms * 1e6 / ( repeats * kNumVertices ), scalar_ms / ms, max_diff, clip_mismatches );
+		}
+	}
+
+	if( !clip_flags_match )
+	{
+		printf( "Vector kernels don't produce the same clip flags!\n" );
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,149 @@
+// Checks each vector T&L kernel this CPU supports against the scalar one, in each lighting mode and
+// for every batch size. Positions, colours and texture coordinates must match to within rounding, and
+// clip flags exactly.
+
+#include <stdafx.h>
+#include "HLEGraphics/TnLKernels.h"
+
+#include <math.h>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+static u32 gSeed( 0x12345678 );
+
+static u32 Random()
+{
+	gSeed = gSeed * 1664525 + 1013904223;
+	return gSeed >> 8;
+}
+
+// Uniform in [lo, hi)
+static f32 RandomFloat( f32 lo, f32 hi )
+{
+	return lo + ( hi - lo ) * f32( Random() & 0xffff ) / 65536.0f;
+}
+
+static std::vector< const TnLKernels * > GetVectorKernels()
+{
+	std::vector< const TnLKernels * >	kernels;
+#ifdef DAEDALUS_TNL_X86
+	__builtin_cpu_init();
+	if( __builtin_cpu_supports( "sse4.1" ) )
+		kernels.push_back( &gTnLKernelsSSE41 );
+	if( __builtin_cpu_supports( "avx" ) )
+		kernels.push_back( &gTnLKernelsAVX );
+#endif
+	return kernels;
+}
+
+class TnLKernelsTest : public ::testing::TestWithParam< u32 >
+{
+protected:
+	virtual void SetUp()
+	{
+		// A rotated, scaled and translated model in front of a perspective projection
+		f32		a( RandomFloat( 0.0f, 6.28f ) ), c( cosf( a ) ), s( sinf( a ) ), scale( RandomFloat( 0.5f, 2.0f ) );
+		mWorld = Matrix4x4( c * scale, 0.0f, -s * scale, 0.0f,
+							0.0f, scale, 0.0f, 0.0f,
+							s * scale, 0.0f, c * scale, 0.0f,
+							RandomFloat( -200.0f, 200.0f ), RandomFloat( -200.0f, 200.0f ), RandomFloat( -1500.0f, -500.0f ), 1.0f );
+
+		const f32	n( 10.0f ), f( 5000.0f );
+		Matrix4x4	project( 1.5f, 0.0f, 0.0f, 0.0f,
+							 0.0f, 2.0f, 0.0f, 0.0f,
+							 0.0f, 0.0f, -( f + n ) / ( f - n ), -1.0f,
+							 0.0f, 0.0f, -2.0f * f * n / ( f - n ), 0.0f );
+		mWorldProject = mWorld * project;
+
+		mTnL = TnLParams();
+		mTnL.Flags._u32 = GetParam();
+		mTnL.NumLights = 3;
+		mTnL.TextureScaleX = 1.0f / 32.0f;
+		mTnL.TextureScaleY = 1.0f / 64.0f;
+		mTnL.FogMult = 12.0f;
+		mTnL.FogOffs = -11.0f;
+		for( u32 l = 0; l <= mTnL.NumLights; ++l )
+		{
+			DaedalusLight &	light( mTnL.Lights[ l ] );
+			light.Direction = v3( RandomFloat( -1.0f, 1.0f ), RandomFloat( -1.0f, 1.0f ), RandomFloat( 0.1f, 1.0f ) );
+			light.Direction.Normalise();
+			light.Colour = v3( RandomFloat( 0.0f, 0.6f ), RandomFloat( 0.0f, 0.6f ), RandomFloat( 0.0f, 0.6f ) );
+			light.Position = v4( RandomFloat( -1000.0f, 1000.0f ), RandomFloat( -1000.0f, 1000.0f ), RandomFloat( -1000.0f, 1000.0f ), 1.0f );
+			light.SkipIfZero = l != 1;
+			light.ca = RandomFloat( 0.5f, 2.0f );
+			light.la = RandomFloat( 0.0f, 0.01f );
+			light.qa = RandomFloat( 0.0f, 0.0001f );
+		}
+
+		for( u32 i = 0; i < kTnLBatchSize; ++i )
+		{
+			FiddledVtx &	vert( mVertices[ i ] );
+			vert.x = s16( RandomFloat( -2000.0f, 2000.0f ) );
+			vert.y = s16( RandomFloat( -2000.0f, 2000.0f ) );
+			vert.z = s16( RandomFloat( -2000.0f, 2000.0f ) );
+			vert.flag = s16( Random() );
+			vert.tu = s16( Random() );
+			vert.tv = s16( Random() );
+			vert.rgba_r = u8( Random() );
+			vert.rgba_g = u8( Random() );
+			vert.rgba_b = u8( Random() );
+			vert.rgba_a = u8( Random() );
+		}
+		// A zero normal, which the kernels must leave alone rather than divide by
+		mVertices[ 3 ].norm_x = mVertices[ 3 ].norm_y = mVertices[ 3 ].norm_z = 0;
+	}
+
+	static void ExpectNear( const v4 & expected, const v4 & actual, u32 vertex, const char * what )
+	{
+		EXPECT_NEAR( expected.x, actual.x, 1e-4f * (1.0f + fabsf( expected.x )) ) << what << ".x of vertex " << vertex;
+		EXPECT_NEAR( expected.y, actual.y, 1e-4f * (1.0f + fabsf( expected.y )) ) << what << ".y of vertex " << vertex;
+		EXPECT_NEAR( expected.z, actual.z, 1e-4f * (1.0f + fabsf( expected.z )) ) << what << ".z of vertex " << vertex;
+		EXPECT_NEAR( expected.w, actual.w, 1e-4f * (1.0f + fabsf( expected.w )) ) << what << ".w of vertex " << vertex;
+	}
+
+	Matrix4x4		mWorld;
+	Matrix4x4		mWorldProject;
+	TnLParams		mTnL;
+	FiddledVtx		mVertices[ kTnLBatchSize ];
+};
+
+TEST_P(TnLKernelsTest, MatchesScalar)
+{
+	std::vector< const TnLKernels * >	kernels( GetVectorKernels() );
+
+	for( u32 k = 0; k < kernels.size(); ++k )
+	{
+		for( u32 fog = 0; fog < 2; ++fog )
+		{
+			// Every batch size, to cover the padding lanes
+			for( u32 n = 1; n <= kTnLBatchSize; ++n )
+			{
+				DaedalusVtx4	expected[ kTnLBatchSize ];
+				DaedalusVtx4	actual[ kTnLBatchSize ];
+
+				gTnLKernelsScalar.TransformVertices( expected, mVertices, n, mWorldProject, mWorld, mTnL, fog != 0 );
+				kernels[ k ]->TransformVertices( actual, mVertices, n, mWorldProject, mWorld, mTnL, fog != 0 );
+
+				SCOPED_TRACE( kernels[ k ]->Name );
+				for( u32 i = 0; i < n; ++i )
+				{
+					ExpectNear( expected[ i ].TransformedPos, actual[ i ].TransformedPos, i, "TransformedPos" );
+					ExpectNear( expected[ i ].ProjectedPos, actual[ i ].ProjectedPos, i, "ProjectedPos" );
+					ExpectNear( expected[ i ].Colour, actual[ i ].Colour, i, "Colour" );
+					ExpectNear( v4( expected[ i ].Texture.x, expected[ i ].Texture.y, 0.0f, 0.0f ),
+								v4( actual[ i ].Texture.x, actual[ i ].Texture.y, 0.0f, 0.0f ), i, "Texture" );
+					EXPECT_EQ( expected[ i ].ClipFlags, actual[ i ].ClipFlags ) << "ClipFlags of vertex " << i;
+				}
+			}
+		}
+	}
+}
+
+INSTANTIATE_TEST_CASE_P(Modes, TnLKernelsTest, ::testing::Values(0u,
+																  TNL_LIGHT,
+																  TNL_LIGHT | TNL_POINTLIGHT,
+																  TNL_LIGHT | TNL_TEXGEN,
+																  TNL_LIGHT | TNL_TEXGEN | TNL_TEXGENLIN,
+																  TNL_LIGHT | TNL_POINTLIGHT | TNL_TEXGEN));
@@ -24,6 +24,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include <stddef.h>		// offsetof
 
+#include <algorithm>
+#include <vector>
+
 #include "patch_symbols.h"
 #include "OS.h"
 #include "OSMesgQueue.h"
@@ -50,6 +53,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "Utility/Endian.h"
 #include "Utility/FastMemcpy.h"
 #include "Utility/Profiler.h"
+#include "Utility/ThreadPool.h"
+#include "Utility/Timing.h"
 
 #ifdef DAEDALUS_PSP
 #include "Graphics/GraphicsContext.h"
@@ -109,7 +114,7 @@ static bool gPatchesApplied = false;
 
 void Patch_ResetSymbolTable();
 void Patch_RecurseAndFind();
-static bool Patch_LocateFunction(PatchSymbol * ps);
+static bool Patch_LocateFunction(u32 symbol_index);
 static bool Patch_VerifyLocation(PatchSymbol * ps, u32 index);
 static bool Patch_VerifyLocation_CheckSignature(PatchSymbol * ps, PatchSignature * psig, u32 index);
 static bool Patch_GetCache();
@@ -152,7 +157,11 @@ void Patch_ApplyPatches()
 	if (!gOSHooksEnabled)
 		return;
 
-	if (!Patch_GetCache())
+	u64 start;
+	NTiming::GetPreciseTime(&start);
+
+	bool cached = Patch_GetCache();
+	if (!cached)
 	{
 		Patch_RecurseAndFind();
 
@@ -160,6 +169,10 @@ void Patch_ApplyPatches()
 		Patch_FlushCache();
 	}
 
+	u64 end;
+	NTiming::GetPreciseTime(&end);
+	DBGConsole_Msg(0, "OS HLE: detection took %dms (%s)", (u32)NTiming::ToMilliseconds(end - start), cached ? "from .hle cache" : "scanned");
+
 	// Do this every time or just when originally patched
 	/*result = */OS_Reset();
 }
@@ -214,6 +227,12 @@ void Patch_ApplyPatch(u32 i)
 									g_PatchSymbols[i]->Signatures->NumOps,
 									(void*)g_PatchSymbols[i]->Function);
 
+	if (!frag->GetEntryTarget().IsSet())
+	{
+		delete frag;
+		return;
+	}
+
 	gFragmentCache.InsertFragment(frag);
 #endif
 }
@@ -486,6 +505,232 @@ bool Patch_Hacks( PatchSymbol * ps )
 }
 
 
+//
+//	Rather than sweeping RAM once per signature, RAM is scanned once up front and
+//	each location is checked against every signature's first op and the crc of its
+//	first PATCH_PARTIAL_CRC_LEN ops. Patch_LocateFunction then only has to verify the
+//	few locations that pass.
+//
+//	The ops in the partial crc are masked according to the signature's cross
+//	references, so signatures are grouped by the mask they need.
+//
+namespace
+{
+	enum EPrefixMask
+	{
+		PM_NONE = 0,		// Only J targets are masked
+		PM_JUMP,			// Must be a J/JAL, target masked
+		PM_VARIABLE,		// Low halfword masked
+	};
+
+	struct SignatureEntry
+	{
+		PatchSignature *		Signature;
+		std::vector<u32>		Candidates;		// Word indices into RAM, ascending
+	};
+
+	struct PrefixGroup
+	{
+		u32						Mask;			// EPrefixMask for each op, 2 bits each
+		u64						FirstOps;		// Bit for each first op in the group
+		std::vector< std::pair<u32, u32> >	Keys;	// Partial crc, entry. Sorted
+	};
+
+	typedef std::vector< std::pair<u32, u32> >	CandidateList;	// Entry, word index
+
+	const u32							kScanBatchWords = 64 * 1024;
+
+	std::vector<SignatureEntry>			gSignatureEntries;
+	std::vector<u32>					gSymbolFirstEntry;		// Entries for symbol i are [gSymbolFirstEntry[i], gSymbolFirstEntry[i+1])
+	std::vector<PrefixGroup>			gPrefixGroups;
+	std::vector<u32>					gShortEntries;			// Too short for a partial crc, matched on the first op alone
+	u64									gAllFirstOps;
+	std::vector<CandidateList>			gBatchCandidates;
+
+u32 GetPrefixMask(const PatchSignature * psig)
+{
+	u32 mask = 0;
+	for (const PatchCrossRef * pcr = psig->CrossRefs; pcr->Offset != u32(~0); pcr++)
+	{
+		if (pcr->Offset < PATCH_PARTIAL_CRC_LEN)
+		{
+			u32 type = pcr->Type == PX_JUMP ? PM_JUMP : PM_VARIABLE;
+			mask |= type << (pcr->Offset * 2);
+		}
+	}
+	return mask;
+}
+
+// Matches the masking done in Patch_VerifyLocation_CheckSignature
+bool GetPrefixCRC(const u32 * code, u32 mask, u32 * p_crc)
+{
+	u32 crc = 0;
+	for (u32 m = 0; m < PATCH_PARTIAL_CRC_LEN; m++)
+	{
+		OpCode op;
+		op._u32 = code[m];
+		op = GetCorrectOp( op );
+
+		switch ((mask >> (m * 2)) & 3)
+		{
+		case PM_JUMP:
+			if (op.op != OP_JAL && op.op != OP_J)
+				return false;
+			op.target = 0;
+			break;
+		case PM_VARIABLE:
+			op._u32 &= ~0x0000ffff;
+			break;
+		default:
+			if (op.op == OP_J)
+				op.target = 0;
+			break;
+		}
+
+		crc = daedalus_crc32(crc, (u8*)&op, 4);
+	}
+
+	*p_crc = crc;
+	return true;
+}
+
+void Patch_BuildSignatureIndex()
+{
+	gSignatureEntries.clear();
+	gSymbolFirstEntry.clear();
+	gPrefixGroups.clear();
+	gShortEntries.clear();
+	gAllFirstOps = 0;
+
+	for (u32 i = 0; i < nPatchSymbols; i++)
+	{
+		gSymbolFirstEntry.push_back(gSignatureEntries.size());
+
+		PatchSymbol * ps = g_PatchSymbols[i];
+		for (u32 s = 0; ps->Signatures[s].NumOps != 0; s++)
+		{
+			PatchSignature * psig = &ps->Signatures[s];
+			u32 entry = gSignatureEntries.size();
+
+			SignatureEntry signature_entry;
+			signature_entry.Signature = psig;
+			gSignatureEntries.push_back(signature_entry);
+
+			gAllFirstOps |= u64(1) << psig->FirstOp;
+
+			if (psig->NumOps < PATCH_PARTIAL_CRC_LEN)
+			{
+				gShortEntries.push_back(entry);
+				continue;
+			}
+
+			u32 mask = GetPrefixMask(psig);
+			u32 g = 0;
+			while (g < gPrefixGroups.size() && gPrefixGroups[g].Mask != mask)
+				g++;
+
+			if (g == gPrefixGroups.size())
+			{
+				PrefixGroup group;
+				group.Mask = mask;
+				group.FirstOps = 0;
+				gPrefixGroups.push_back(group);
+			}
+
+			gPrefixGroups[g].FirstOps |= u64(1) << psig->FirstOp;
+			gPrefixGroups[g].Keys.push_back(std::make_pair(psig->PartialCRC, entry));
+		}
+	}
+	gSymbolFirstEntry.push_back(gSignatureEntries.size());
+
+	for (u32 g = 0; g < gPrefixGroups.size(); g++)
+	{
+		std::sort(gPrefixGroups[g].Keys.begin(), gPrefixGroups[g].Keys.end());
+	}
+}
+
+// Scans batches of kScanBatchWords words, so the results can be merged in address order
+void Patch_ScanBatches(void * arg, u32 begin, u32 end)
+{
+	const u32 * code_base( g_pu32RamBase );
+	const u32 num_words( gRamSize >> 2 );
+
+	for (u32 batch = begin; batch < end; batch++)
+	{
+		CandidateList & candidates( gBatchCandidates[batch] );
+
+		u32 batch_end = std::min((batch + 1) * kScanBatchWords, num_words);
+		for (u32 i = batch * kScanBatchWords; i < batch_end; i++)
+		{
+			OpCode op;
+			op._u32 = code_base[i];
+			op = GetCorrectOp( op );
+
+			u64 op_bit = u64(1) << op.op;
+			if ((gAllFirstOps & op_bit) == 0)
+				continue;
+
+			for (u32 s = 0; s < gShortEntries.size(); s++)
+			{
+				if (gSignatureEntries[gShortEntries[s]].Signature->FirstOp == op.op)
+					candidates.push_back(std::make_pair(gShortEntries[s], i));
+			}
+
+			if (i + PATCH_PARTIAL_CRC_LEN > num_words)
+				continue;
+
+			for (u32 g = 0; g < gPrefixGroups.size(); g++)
+			{
+				const PrefixGroup & group( gPrefixGroups[g] );
+
+				u32 crc;
+				if ((group.FirstOps & op_bit) == 0 || !GetPrefixCRC(&code_base[i], group.Mask, &crc))
+					continue;
+
+				std::vector< std::pair<u32, u32> >::const_iterator it = std::lower_bound(group.Keys.begin(), group.Keys.end(), std::make_pair(crc, u32(0)));
+				for (; it != group.Keys.end() && it->first == crc; ++it)
+				{
+					if (gSignatureEntries[it->second].Signature->FirstOp == op.op)
+						candidates.push_back(std::make_pair(it->second, i));
+				}
+			}
+		}
+	}
+}
+
+void Patch_ScanForCandidates()
+{
+	u32 num_batches = ((gRamSize >> 2) + kScanBatchWords - 1) / kScanBatchWords;
+	gBatchCandidates.assign(num_batches, CandidateList());
+
+	ThreadPool_ParallelFor(num_batches, 1, Patch_ScanBatches, NULL);
+
+	u32 num_candidates = 0;
+	for (u32 b = 0; b < num_batches; b++)
+	{
+		const CandidateList & candidates( gBatchCandidates[b] );
+		for (u32 c = 0; c < candidates.size(); c++)
+		{
+			gSignatureEntries[candidates[c].first].Candidates.push_back(candidates[c].second);
+		}
+		num_candidates += candidates.size();
+	}
+	gBatchCandidates.clear();
+
+	DBGConsole_Msg(0, "OS HLE: %d candidate locations for %d signatures", num_candidates, (u32)gSignatureEntries.size());
+}
+
+void Patch_FreeSignatureIndex()
+{
+	std::vector<SignatureEntry>().swap(gSignatureEntries);
+	std::vector<u32>().swap(gSymbolFirstEntry);
+	std::vector<PrefixGroup>().swap(gPrefixGroups);
+	std::vector<u32>().swap(gShortEntries);
+	std::vector<CandidateList>().swap(gBatchCandidates);
+}
+
+}
+
 //ToDo: Add Status bar for loading OSHLE Patch Symbols.
 void Patch_RecurseAndFind()
 {
@@ -493,7 +738,10 @@ void Patch_RecurseAndFind()
 	u32 first;
 	u32 last;
 
-	DBGConsole_Msg(0, "Searching for os functions. This may take several seconds...");
+	DBGConsole_Msg(0, "Searching for os functions...");
+
+	Patch_BuildSignatureIndex();
+	Patch_ScanForCandidates();
 
 	// Keep looping until a pass does not resolve any more symbols
 	nFound = 0;
@@ -534,10 +782,12 @@ void Patch_RecurseAndFind()
 
 		// Symbol not found, attempt to locate on this pass. This may
 		// fail if all dependent symbols are not found
-		if (Patch_LocateFunction(g_PatchSymbols[i]))
+		if (Patch_LocateFunction(i))
 			nFound++;
 	}
 
+	Patch_FreeSignatureIndex();
+
 	if ( gCPUState.IsJobSet( CPU_STOP_RUNNING ) )
 	{
 #ifdef DAEDALUS_DEBUG_CONSOLE
@@ -671,33 +921,22 @@ void Patch_RecurseAndFind()
 
 }
 
-// Attempt to locate this symbol.
-bool Patch_LocateFunction(PatchSymbol * ps)
+// Attempt to locate this symbol, at the locations found by Patch_ScanForCandidates.
+bool Patch_LocateFunction(u32 symbol_index)
 {
-	OpCode op;
-	const u32 * code_base( g_pu32RamBase );
+	PatchSymbol * ps = g_PatchSymbols[symbol_index];
 
-	for (u32 s = 0; s < ps->Signatures[s].NumOps; s++)
+	for (u32 e = gSymbolFirstEntry[symbol_index]; e < gSymbolFirstEntry[symbol_index + 1]; e++)
 	{
-		PatchSignature * psig;
-		psig = &ps->Signatures[s];
+		const SignatureEntry & entry( gSignatureEntries[e] );
 
-		// Sweep through OS range
-		for (u32 i = 0; i < (gRamSize>>2); i++)
+		for (u32 c = 0; c < entry.Candidates.size(); c++)
 		{
-			op._u32 = code_base[i];
-			op = GetCorrectOp( op );
-
-			// First op must match!
-			if ( psig->FirstOp != op.op )
-				continue;
-
-			// See if function i exists at this location
-			if (Patch_VerifyLocation_CheckSignature(ps, psig, i))
+			// See if function exists at this location
+			if (Patch_VerifyLocation_CheckSignature(ps, entry.Signature, entry.Candidates[c]))
 			{
 				return true;
 			}
-
 		}
 	}
 
@@ -204,6 +204,7 @@ TEST_DISABLE_SP_FUNCS
 
 	// Translate virtual addresses to physical...
 	fast_memcpy(pDstTask, pSrcTask, sizeof(OSTask));
+	Memory_MarkWritten( pDstTask, sizeof(OSTask) );
 
 	if (pDstTask->t.ucode != 0)
 		pDstTask->t.ucode = (u64 *)ConvertToPhysics((u32)pDstTask->t.ucode);
@@ -7,6 +7,9 @@
 #include "Graphics/GraphicsContext.h"
 
 #include "Graphics/ColourValue.h"
+#include "SysGL/HLEGraphics/RendererGL.h"
+#include "SysGL/HLEGraphics/RenderThreadGL.h"
+#include "Config/ConfigOptions.h"
 
 
 static u32 SCR_WIDTH = 640;
@@ -95,6 +98,11 @@ bool GraphicsContextGL::Initialise()
 	glfwWindowHint(GLFW_DEPTH_BITS, 24);
 	//glfwWindowHint(GLFW_STENCIL_BITS, 0);
 
+	if (gHeadlessGraphics)
+	{
+		glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	}
+
 	// Open a window and create its OpenGL context
 	gWindow = glfwCreateWindow( SCR_WIDTH, SCR_HEIGHT,
 								"Daedalus",
@@ -115,6 +123,12 @@ bool GraphicsContextGL::Initialise()
 	// Enable vertical sync (on cards that support it)
 	glfwSwapInterval( 1 );
 
+	// Don't let the display's refresh rate cap benchmarks
+	if (gHeadlessGraphics)
+	{
+		glfwSwapInterval( 0 );
+	}
+
 	// Initialise GLEW
 	//glewExperimental = GL_TRUE;
 	GLenum err = glewInit();
@@ -158,57 +172,114 @@ void GraphicsContextGL::ClearAllSurfaces()
 	ClearToBlack();
 }
 
+// Any draws the renderer is holding back have to go out before we clear.
+static void FlushRendererDraws()
+{
+	if (gRendererGL != NULL)
+		gRendererGL->FlushDraws();
+}
+
+// The GL calls below go through RenderThread_Submit, so they end up on the render thread if it's running.
+struct ClearCommand
+{
+	GLbitfield	Mask;
+	u32			Colour;
+};
+
+static void ExecuteClear(const void * p_data)
+{
+	const ClearCommand * cmd = static_cast<const ClearCommand *>(p_data);
+
+	if (cmd->Mask & GL_DEPTH_BUFFER_BIT)
+	{
+		RendererGL::InvalidateRenderState();
+		glDepthMask(GL_TRUE);
+		glClearDepth( 1.0f );
+	}
+	if (cmd->Mask & GL_COLOR_BUFFER_BIT)
+	{
+		c32 colour( cmd->Colour );
+		glClearColor( colour.GetRf(), colour.GetGf(), colour.GetBf(), colour.GetAf() );
+	}
+	glClear( cmd->Mask );
+}
+
+static void SubmitClear(GLbitfield mask, const c32 & colour)
+{
+	FlushRendererDraws();
+
+	ClearCommand cmd = { mask, colour.GetColour() };
+	RenderThread_Submit(ExecuteClear, &cmd, sizeof(cmd));
+}
+
 void GraphicsContextGL::ClearToBlack()
 {
-	glDepthMask(GL_TRUE);
-	glClearDepth( 1.0f );
-	glClearColor( 0.0f, 0.0f, 0.0f, 0.0f );
-	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+	SubmitClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, c32( 0 ) );
 }
 
 void GraphicsContextGL::ClearZBuffer()
 {
-	glDepthMask(GL_TRUE);
-	glClearDepth( 1.0f );
-	glClear( GL_DEPTH_BUFFER_BIT );
+	SubmitClear( GL_DEPTH_BUFFER_BIT, c32( 0 ) );
 }
 
 void GraphicsContextGL::ClearColBuffer(const c32 & colour)
 {
-	glClearColor( colour.GetRf(), colour.GetGf(), colour.GetBf(), colour.GetAf() );
-	glClear( GL_COLOR_BUFFER_BIT );
+	SubmitClear( GL_COLOR_BUFFER_BIT, colour );
 }
 
 void GraphicsContextGL::ClearColBufferAndDepth(const c32 & colour)
 {
-	glDepthMask(GL_TRUE);
-	glClearDepth( 1.0f );
-	glClearColor( colour.GetRf(), colour.GetGf(), colour.GetBf(), colour.GetAf() );
-	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+	SubmitClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, colour );
+}
+
+struct ScreenSizeCommand
+{
+	u32		Width;
+	u32		Height;
+};
+
+static void ExecuteBeginFrame(const void * p_data)
+{
+	const ScreenSizeCommand * cmd = static_cast<const ScreenSizeCommand *>(p_data);
+
+	glViewport( 0, 0, cmd->Width, cmd->Height );
+	glScissor( 0, 0, cmd->Width, cmd->Height );
 }
 
 void GraphicsContextGL::BeginFrame()
 {
 	// Get window size (may be different than the requested size)
-	u32 width, height;
-	GetScreenSize(&width, &height);
+	ScreenSizeCommand cmd;
+	GetScreenSize(&cmd.Width, &cmd.Height);
 
 	// Special case: avoid division by zero below
-	height = height > 0 ? height : 1;
+	cmd.Height = cmd.Height > 0 ? cmd.Height : 1;
 
-	glViewport( 0, 0, width, height );
-	glScissor( 0, 0, width, height );
+	FlushRendererDraws();
+	RenderThread_Submit(ExecuteBeginFrame, &cmd, sizeof(cmd));
 }
 
 void GraphicsContextGL::EndFrame()
 {
+	// Start the render thread on the scene while we get on with the next one.
+	FlushRendererDraws();
+	RenderThread_EndFrame();
 }
 
-void GraphicsContextGL::UpdateFrame( bool wait_for_vbl )
+static void ExecuteSwapBuffers(const void * p_data)
 {
 	glfwSwapBuffers(gWindow);
+}
+
+void GraphicsContextGL::UpdateFrame( bool wait_for_vbl )
+{
+	FlushRendererDraws();
+	RenderThread_Submit(ExecuteSwapBuffers, NULL, 0);
 //	if( gCleanSceneEnabled ) //TODO: This should be optional
 	{
 		ClearColBuffer( c32(0xff000000) ); // ToDo : Use gFillColor instead?
 	}
+
+	// Don't hold the swap back until the end of the next scene.
+	RenderThread_EndFrame();
 }
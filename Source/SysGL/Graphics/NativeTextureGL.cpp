@@ -23,6 +23,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "Graphics/NativePixelFormat.h"
 
 #include "Math/MathUtil.h"
+#include "SysGL/HLEGraphics/RendererGL.h"
+#include "SysGL/HLEGraphics/RenderThreadGL.h"
 
 #include <stdlib.h>
 #include <png.h>
@@ -30,6 +32,23 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 static const u32 kPalette4BytesRequired = 16 * sizeof( NativePf8888 );
 static const u32 kPalette8BytesRequired = 256 * sizeof( NativePf8888 );
 
+static u32 GetPaletteBytesRequired( ETextureFormat texture_format )
+{
+	switch (texture_format)
+	{
+	case TexFmt_CI4_8888:	return kPalette4BytesRequired;
+	case TexFmt_CI8_8888:	return kPalette8BytesRequired;
+	default:				return 0;
+	}
+}
+
+// The renderer defers draws, so make sure any using this texture go out before it's changed.
+static void FlushRendererDraws()
+{
+	if (gRendererGL != NULL)
+		gRendererGL->FlushDraws();
+}
+
 static u32 GetTextureBlockWidth( u32 dimension, ETextureFormat texture_format )
 {
 	DAEDALUS_ASSERT( GetNextPowerOf2( dimension ) == dimension, "This is not a power of 2" );
@@ -64,23 +83,38 @@ CNativeTexture::CNativeTexture( u32 w, u32 h, ETextureFormat texture_format )
 ,	mpData( NULL )
 ,	mpPalette( NULL )
 ,	mTextureId( 0 )
+,	mTextureQueued( false )
 {
-	glGenTextures( 1, &mTextureId );
+	if (RenderThread_IsRunning())
+	{
+		// mTextureId is filled in by the time anything recorded after this is played back.
+		CNativeTexture * texture = this;
+		RenderThread_Submit( CreateTextureGL, &texture, sizeof(texture) );
+		RenderThread_KeepAlive( this );
+		mTextureQueued = true;
+	}
+	else
+	{
+		glGenTextures( 1, &mTextureId );
+		RendererGL::InvalidateRenderState();		// A new texture can have the same address as an old one
+	}
 
 	size_t data_len = GetBytesRequired();
 	mpData = malloc(data_len);
 	memset(mpData, 0, data_len);
 
-	if (texture_format == TexFmt_CI4_8888)
-	{
-		mpPalette = malloc(kPalette8BytesRequired);
-	}
-	else if (texture_format == TexFmt_CI8_8888)
+	u32 palette_len = GetPaletteBytesRequired( texture_format );
+	if (palette_len > 0)
 	{
-		mpPalette = malloc(kPalette4BytesRequired);
+		mpPalette = malloc(palette_len);
 	}
 }
 
+static void DeleteTextureGL( const void * p_data )
+{
+	glDeleteTextures( 1, static_cast<const GLuint *>( p_data ) );
+}
+
 CNativeTexture::~CNativeTexture()
 {
 	if (mpData)
@@ -88,12 +122,21 @@ CNativeTexture::~CNativeTexture()
 	if (mpPalette)
 		free(mpPalette);
 
-	glDeleteTextures( 1, &mTextureId );
+	FlushRendererDraws();
+	RenderThread_Submit( DeleteTextureGL, &mTextureId, sizeof(mTextureId) );
+}
+
+void CNativeTexture::CreateTextureGL( const void * p_data )
+{
+	CNativeTexture * texture = *static_cast<CNativeTexture * const *>( p_data );
+	glGenTextures( 1, &texture->mTextureId );
+	RendererGL::InvalidateRenderState();		// A new texture can have the same address as an old one
 }
 
 bool CNativeTexture::HasData() const
 {
-	return mTextureId != 0;
+	// Don't look at mTextureId if the render thread might be writing it
+	return mTextureQueued || mTextureId != 0;
 }
 
 void CNativeTexture::InstallTexture() const
@@ -267,121 +310,161 @@ CRefPtr<CNativeTexture>	CNativeTexture::CreateFromPng( const char * p_filename,
 }
 
 
+// Texel data for the render thread follows this
+struct UploadCommand
+{
+	CNativeTexture *	Texture;
+	u32					PaletteLen;
+};
+
 void CNativeTexture::SetData( void * data, void * palette )
 {
 	// It's pretty gross that we don't pass this in, or better yet, provide a way for
 	// the caller to write directly to our buffers instead of setting the data.
-	size_t data_len = GetBytesRequired();
-	memcpy(mpData, data, data_len);
+	const u32 data_len    = GetBytesRequired();
+	const u32 palette_len = GetPaletteBytesRequired( mTextureFormat );
 
-	if (mTextureFormat == TexFmt_CI4_8888)
-	{
-		memcpy(mpPalette, palette, kPalette4BytesRequired);
-	}
-	else if (mTextureFormat == TexFmt_CI8_8888)
+	memcpy(mpData, data, data_len);
+	if (palette_len > 0)
 	{
-		memcpy(mpPalette, palette, kPalette8BytesRequired);
+		memcpy(mpPalette, palette, palette_len);
 	}
 
 	if (HasData())
 	{
-		glBindTexture( GL_TEXTURE_2D, mTextureId );
-		glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+		FlushRendererDraws();
 
-		switch (mTextureFormat)
+		if (RenderThread_IsRunning())
 		{
-		case TexFmt_5650:
-			glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA,
-						  mCorrectedWidth, mCorrectedHeight,
-						  0, GL_RGB, GL_UNSIGNED_SHORT_5_6_5_REV, data );
-			break;
-		case TexFmt_5551:
-			glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA,
-						  mCorrectedWidth, mCorrectedHeight,
-						  0, GL_RGBA, GL_UNSIGNED_SHORT_1_5_5_5_REV, data );
-			break;
-		case TexFmt_4444:
-			glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA,
-						  mCorrectedWidth, mCorrectedHeight,
-						  0, GL_RGBA, GL_UNSIGNED_SHORT_4_4_4_4_REV, data );
+			// The caller's buffers won't be around by the time the render thread gets to this, so take a copy.
+			u8 * p_command = static_cast<u8 *>( RenderThread_AllocCommand( UploadTextureGL, sizeof(UploadCommand) + data_len + palette_len ) );
+
+			UploadCommand * cmd = reinterpret_cast<UploadCommand *>( p_command );
+			cmd->Texture    = this;
+			cmd->PaletteLen = palette_len;
+			memcpy( p_command + sizeof(UploadCommand), data, data_len );
+			if (palette_len > 0)
+			{
+				memcpy( p_command + sizeof(UploadCommand) + data_len, palette, palette_len );
+			}
 
-			break;
-		case TexFmt_8888:
-			glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA,
-						  mCorrectedWidth, mCorrectedHeight,
-						  0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, data );
+			RenderThread_KeepAlive( this );
+		}
+		else
+		{
+			UploadGL( data, palette );
+		}
+	}
+}
 
-			break;
-		case TexFmt_CI4_8888:
-			{
-				// Convert palletised texture to non-palletised. This is wsteful - we should avoid generating these updated for OSX.
-				const NativePfCI44 * pix_ptr = static_cast< const NativePfCI44 * >( data );
-				const NativePf8888 * pal_ptr = static_cast< const NativePf8888 * >( palette );
+void CNativeTexture::UploadTextureGL( const void * p_data )
+{
+	const UploadCommand * cmd     = static_cast<const UploadCommand *>( p_data );
+	const u8 *            texels  = reinterpret_cast<const u8 *>( cmd + 1 );
+	const u8 *            palette = texels + cmd->Texture->GetBytesRequired();
 
-				NativePf8888 * out = static_cast<NativePf8888 *>( malloc(mCorrectedWidth * mCorrectedHeight * sizeof(NativePf8888)) );
-				NativePf8888 * out_ptr = out;
+	cmd->Texture->UploadGL( texels, cmd->PaletteLen > 0 ? palette : NULL );
+}
 
-				u32 pitch = GetStride();
+void CNativeTexture::UploadGL( const void * data, const void * palette ) const
+{
+	RendererGL::InvalidateRenderState();
+	glBindTexture( GL_TEXTURE_2D, mTextureId );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
 
-				for (u32 y = 0; y < mCorrectedHeight; ++y)
-				{
-					for (u32 x = 0; x < mCorrectedWidth; ++x)
-					{
-						NativePfCI44	colors  = pix_ptr[ x / 2 ];
-						u8				pal_idx = (x&1) ? colors.GetIdxA() : colors.GetIdxB();
+	switch (mTextureFormat)
+	{
+	case TexFmt_5650:
+		glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA,
+					  mCorrectedWidth, mCorrectedHeight,
+					  0, GL_RGB, GL_UNSIGNED_SHORT_5_6_5_REV, data );
+		break;
+	case TexFmt_5551:
+		glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA,
+					  mCorrectedWidth, mCorrectedHeight,
+					  0, GL_RGBA, GL_UNSIGNED_SHORT_1_5_5_5_REV, data );
+		break;
+	case TexFmt_4444:
+		glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA,
+					  mCorrectedWidth, mCorrectedHeight,
+					  0, GL_RGBA, GL_UNSIGNED_SHORT_4_4_4_4_REV, data );
+
+		break;
+	case TexFmt_8888:
+		glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA,
+					  mCorrectedWidth, mCorrectedHeight,
+					  0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, data );
+
+		break;
+	case TexFmt_CI4_8888:
+		{
+			// Convert palletised texture to non-palletised. This is wsteful - we should avoid generating these updated for OSX.
+			const NativePfCI44 * pix_ptr = static_cast< const NativePfCI44 * >( data );
+			const NativePf8888 * pal_ptr = static_cast< const NativePf8888 * >( palette );
 
-						*out_ptr = pal_ptr[ pal_idx ];
-						out_ptr++;
-					}
+			NativePf8888 * out = static_cast<NativePf8888 *>( malloc(mCorrectedWidth * mCorrectedHeight * sizeof(NativePf8888)) );
+			NativePf8888 * out_ptr = out;
 
-					pix_ptr = reinterpret_cast<const NativePfCI44 *>( reinterpret_cast<const u8 *>(pix_ptr) + pitch );
-				}
+			u32 pitch = GetStride();
 
-				glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA,
-							  mCorrectedWidth, mCorrectedHeight,
-							  0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, out );
+			for (u32 y = 0; y < mCorrectedHeight; ++y)
+			{
+				for (u32 x = 0; x < mCorrectedWidth; ++x)
+				{
+					NativePfCI44	colors  = pix_ptr[ x / 2 ];
+					u8				pal_idx = (x&1) ? colors.GetIdxA() : colors.GetIdxB();
+
+					*out_ptr = pal_ptr[ pal_idx ];
+					out_ptr++;
+				}
 
-				free(out);
+				pix_ptr = reinterpret_cast<const NativePfCI44 *>( reinterpret_cast<const u8 *>(pix_ptr) + pitch );
 			}
-			break;
 
-		case TexFmt_CI8_8888:
-			{
-				// Convert palletised texture to non-palletised. This is wsteful - we should avoid generating these updated for OSX.
-				const NativePfCI8 *  pix_ptr = static_cast< const NativePfCI8 * >( data );
-				const NativePf8888 * pal_ptr = static_cast< const NativePf8888 * >( palette );
+			glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA,
+						  mCorrectedWidth, mCorrectedHeight,
+						  0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, out );
 
-				NativePf8888 * out = static_cast<NativePf8888 *>( malloc(mCorrectedWidth * mCorrectedHeight * sizeof(NativePf8888)) );
-				NativePf8888 * out_ptr = out;
+			free(out);
+		}
+		break;
 
-				u32 pitch = GetStride();
+	case TexFmt_CI8_8888:
+		{
+			// Convert palletised texture to non-palletised. This is wsteful - we should avoid generating these updated for OSX.
+			const NativePfCI8 *  pix_ptr = static_cast< const NativePfCI8 * >( data );
+			const NativePf8888 * pal_ptr = static_cast< const NativePf8888 * >( palette );
 
-				for (u32 y = 0; y < mCorrectedHeight; ++y)
-				{
-					for (u32 x = 0; x < mCorrectedWidth; ++x)
-					{
-						u8	pal_idx = pix_ptr[ x ].Bits;
+			NativePf8888 * out = static_cast<NativePf8888 *>( malloc(mCorrectedWidth * mCorrectedHeight * sizeof(NativePf8888)) );
+			NativePf8888 * out_ptr = out;
 
-						*out_ptr = pal_ptr[ pal_idx ];
-						out_ptr++;
-					}
+			u32 pitch = GetStride();
 
-					pix_ptr = reinterpret_cast<const NativePfCI8 *>( reinterpret_cast<const u8 *>(pix_ptr) + pitch );
-				}
+			for (u32 y = 0; y < mCorrectedHeight; ++y)
+			{
+				for (u32 x = 0; x < mCorrectedWidth; ++x)
+				{
+					u8	pal_idx = pix_ptr[ x ].Bits;
 
-				glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA,
-							  mCorrectedWidth, mCorrectedHeight,
-							  0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, out );
+					*out_ptr = pal_ptr[ pal_idx ];
+					out_ptr++;
+				}
 
-				free(out);
+				pix_ptr = reinterpret_cast<const NativePfCI8 *>( reinterpret_cast<const u8 *>(pix_ptr) + pitch );
 			}
-			break;
 
-		default:
-			DAEDALUS_ASSERT( !IsTextureFormatPalettised( mTextureFormat ), "Unhandled palette texture" );
-			DAEDALUS_ASSERT( palette == NULL, "Palette provided when not needed" );
-			break;
+			glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA,
+						  mCorrectedWidth, mCorrectedHeight,
+						  0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, out );
+
+			free(out);
 		}
+		break;
+
+	default:
+		DAEDALUS_ASSERT( !IsTextureFormatPalettised( mTextureFormat ), "Unhandled palette texture" );
+		DAEDALUS_ASSERT( palette == NULL, "Palette provided when not needed" );
+		break;
 	}
 }
 
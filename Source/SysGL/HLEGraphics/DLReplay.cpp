@@ -0,0 +1,311 @@
+/*
+Copyright (C) 2012 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+//
+//	dlreplay - renders display lists captured with F9 (see HLEGraphics/DLCapture.h)
+//	without running the CPU, RSP or audio, and reports how long they took.
+//
+//		dlreplay [-null] [-cold] [-n repeats] capture.dlc...
+//
+//	-null	Swap RendererGL for a renderer which does the T&L, clipping and texture
+//			lookups but draws nothing. Textures are still GL objects, so a hidden
+//			GL context is created either way.
+//	-cold	Drop the texture cache before every repeat, to measure texture conversion.
+//
+
+#include "stdafx.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "Config/ConfigOptions.h"
+#include "Graphics/GraphicsContext.h"
+#include "HLEGraphics/BaseRenderer.h"
+#include "HLEGraphics/CachedTexture.h"
+#include "HLEGraphics/DLCapture.h"
+#include "HLEGraphics/DLParser.h"
+#include "HLEGraphics/TextureCache.h"
+#include "Plugins/GraphicsPlugin.h"
+#include "SysGL/GL.h"
+#include "System/Paths.h"
+#include "System/System.h"
+#include "Utility/IO.h"
+#include "Utility/Timing.h"
+
+namespace
+{
+
+class NullRenderer : public BaseRenderer
+{
+public:
+	virtual void		RestoreRenderStates()	{}
+
+	virtual DaedalusVtx *	AllocVertices( u32 num_vertices )
+	{
+		if( mVertices.size() < num_vertices )
+		{
+			mVertices.resize( num_vertices );
+		}
+		return &mVertices[ 0 ];
+	}
+	virtual void		FlushDraws()			{}
+	virtual void		SetGLViewport( s32 x, s32 y, s32 w, s32 h )	{}
+	virtual void		SetGLScissor( s32 x, s32 y, s32 w, s32 h )	{}
+
+	virtual void		RenderTriangles( DaedalusVtx * p_vertices, u32 num_vertices, bool disable_zbuffer )
+	{
+		if( mTnL.Flags.Texture )
+		{
+			UpdateTileSnapshots( mTextureTile );
+		}
+	}
+
+	virtual void		TexRect( u32 tile_idx, const v2 & xy0, const v2 & xy1, TexCoord st0, TexCoord st1 )		{ UpdateTileSnapshots( tile_idx ); }
+	virtual void		TexRectFlip( u32 tile_idx, const v2 & xy0, const v2 & xy1, TexCoord st0, TexCoord st1 )	{ UpdateTileSnapshots( tile_idx ); }
+	virtual void		FillRect( const v2 & xy0, const v2 & xy1, u32 color )									{}
+
+	virtual void		Draw2DTexture( f32 x0, f32 y0, f32 x1, f32 y1, f32 u0, f32 v0, f32 u1, f32 v1, const CNativeTexture * texture )	{}
+	virtual void		Draw2DTextureR( f32 x0, f32 y0, f32 x1, f32 y1, f32 x2, f32 y2, f32 x3, f32 y3, f32 s, f32 t )					{}
+
+private:
+	std::vector< DaedalusVtx >	mVertices;
+};
+
+struct SReplayTotals
+{
+	u64		Ticks;
+	u64		Commands;
+	u64		Triangles;
+	u32		Conversions;
+};
+
+bool	gNullRenderer = false;
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void Replay( u32 repeats, bool cold, SReplayTotals * p_totals )
+{
+	u64		tris_before( gRenderer->GetNumTrisSubmitted() );
+	u32		conversions_before( CachedTexture::GetNumConversions() );
+	u64		ticks( 0 );
+	u64		commands( 0 );
+
+	for( u32 i = 0; i < repeats; ++i )
+	{
+		if( cold )
+		{
+			CTextureCache::Get()->DropTextures();
+		}
+
+		u64		start, end;
+		NTiming::GetPreciseTime( &start );
+
+		commands += DLParser_Process();
+
+		// Make sure the GPU's work is counted too
+		if( !gNullRenderer )
+		{
+			glFinish();
+		}
+
+		NTiming::GetPreciseTime( &end );
+		ticks += end - start;
+	}
+
+	p_totals->Ticks       = ticks;
+	p_totals->Commands    = commands;
+	p_totals->Triangles   = gRenderer->GetNumTrisSubmitted() - tris_before;
+	p_totals->Conversions = CachedTexture::GetNumConversions() - conversions_before;
+}
+
+void PrintCommandStats( const SDLCommandStats & stats, u64 freq )
+{
+	std::vector< u32 >	cmds;
+	for( u32 i = 0; i < 256; ++i )
+	{
+		if( stats.Count[ i ] > 0 )
+		{
+			cmds.push_back( i );
+		}
+	}
+
+	struct SortByTime
+	{
+		const SDLCommandStats & Stats;
+		SortByTime( const SDLCommandStats & stats ) : Stats( stats ) {}
+		bool operator()( u32 a, u32 b ) const		{ return Stats.Ticks[ a ] > Stats.Ticks[ b ]; }
+	};
+	std::sort( cmds.begin(), cmds.end(), SortByTime( stats ) );
+
+	printf( "    %-28s %10s %10s %10s\n", "command", "count", "total ms", "ns/call" );
+	for( u32 i = 0; i < cmds.size(); ++i )
+	{
+		u32				cmd( cmds[ i ] );
+		const char *	name( DLParser_GetCommandName( cmd ) );
+		char			hex_name[ 8 ];
+		if( name == NULL )
+		{
+			snprintf( hex_name, sizeof( hex_name ), "0x%02x", cmd );
+			name = hex_name;
+		}
+
+		f64		seconds( f64( stats.Ticks[ cmd ] ) / f64( freq ) );
+		printf( "    %-28s %10u %10.3f %10.1f\n", name, stats.Count[ cmd ], seconds * 1000.0,
+				seconds * 1000000000.0 / f64( stats.Count[ cmd ] ) );
+	}
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+bool ReplayCapture( const char * filename, u32 repeats, bool cold )
+{
+	SDLCaptureInfo	info;
+	if( !DLCapture_Load( filename, &info ) )
+	{
+		fprintf( stderr, "%s: not a display list capture\n", filename );
+		return false;
+	}
+
+	// Captures may come from different roms, so start each one from scratch
+	CTextureCache::Get()->DropTextures();
+	DLParser_Initialise();
+
+	u64		freq;
+	NTiming::GetPreciseFrequency( &freq );
+
+	// Once to detect the ucode and fill the texture cache, then timed
+	SReplayTotals	totals;
+	Replay( 1, false, &totals );
+	Replay( repeats, cold, &totals );
+
+	f64		seconds( f64( totals.Ticks ) / f64( freq ) );
+	if( seconds <= 0.0 )
+	{
+		seconds = 1.0 / f64( freq );
+	}
+
+	printf( "%s (%s, %s)\n", filename, info.RomName, gNullRenderer ? "null renderer" : "GL" );
+	printf( "  %u frames in %.3fs, %.3fms/frame\n", repeats, seconds, seconds * 1000.0 / f64( repeats ) );
+	printf( "  %.0f commands/s, %.0f triangles/s, %u texture conversions (%.1f/frame)\n",
+			f64( totals.Commands ) / seconds, f64( totals.Triangles ) / seconds,
+			totals.Conversions, f64( totals.Conversions ) / f64( repeats ) );
+
+	// Timing every command slows things down, so it gets its own pass
+	SDLCommandStats	stats;
+	memset( &stats, 0, sizeof( stats ) );
+	DLParser_SetCommandStats( &stats );
+	Replay( repeats, cold, &totals );
+	DLParser_SetCommandStats( NULL );
+
+	PrintCommandStats( stats, freq );
+	return true;
+}
+
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+int main( int argc, char ** argv )
+{
+	if( argc > 0 )
+	{
+		IO::Filename exe_path;
+		realpath( argv[0], exe_path );
+
+		strcpy( gDaedalusExePath, exe_path );
+		IO::Path::RemoveFileSpec( gDaedalusExePath );
+	}
+
+	u32							repeats( 100 );
+	bool						cold( false );
+	std::vector< const char * >	files;
+
+	for( int i = 1; i < argc; ++i )
+	{
+		if( strcmp( argv[i], "-null" ) == 0 )
+		{
+			gNullRenderer = true;
+		}
+		else if( strcmp( argv[i], "-cold" ) == 0 )
+		{
+			cold = true;
+		}
+		else if( strcmp( argv[i], "-n" ) == 0 && i + 1 < argc )
+		{
+			repeats = strtoul( argv[++i], NULL, 10 );
+		}
+		else
+		{
+			files.push_back( argv[i] );
+		}
+	}
+
+	if( files.empty() || repeats == 0 )
+	{
+		fprintf( stderr, "usage: %s [-null] [-cold] [-n repeats] capture.dlc...\n", argc > 0 ? argv[0] : "dlreplay" );
+		return 1;
+	}
+
+	gHeadlessGraphics = true;
+
+	if( !System_Init() )
+		return 1;
+
+	gGraphicsPlugin = CreateGraphicsPlugin();
+	if( gGraphicsPlugin == NULL )
+	{
+		fprintf( stderr, "Couldn't create the graphics plugin\n" );
+		System_Finalize();
+		return 1;
+	}
+
+	BaseRenderer *	renderer_gl( gRenderer );
+	NullRenderer *	renderer_null( NULL );
+	if( gNullRenderer )
+	{
+		renderer_null = new NullRenderer;
+		gRenderer = renderer_null;
+	}
+
+	int		result( 0 );
+	for( u32 i = 0; i < files.size(); ++i )
+	{
+		if( !ReplayCapture( files[i], repeats, cold ) )
+		{
+			result = 1;
+		}
+	}
+
+	gRenderer = renderer_gl;
+	delete renderer_null;
+
+	gGraphicsPlugin->RomClosed();
+	delete gGraphicsPlugin;
+	gGraphicsPlugin = NULL;
+
+	System_Finalize();
+	return result;
+}
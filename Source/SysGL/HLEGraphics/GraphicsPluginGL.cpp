@@ -2,7 +2,11 @@
 
 #include <stdio.h>
 
+#include "Config/ConfigOptions.h"
+
 #include "Core/Memory.h"
+#include "Core/ROMBuffer.h"
+#include "Core/Rewind.h"
 
 #include "Debug/DBGConsole.h"
 
@@ -18,6 +22,8 @@
 #include "Utility/Timing.h"
 
 #include "SysGL/GL.h"
+#include "SysGL/HLEGraphics/RendererGL.h"
+#include "SysGL/HLEGraphics/RenderThreadGL.h"
 
 EFrameskipValue     gFrameskipValue = FV_DISABLED;
 u32                 gVISyncRate     = 1500;
@@ -31,6 +37,8 @@ namespace
 	float				gCurrentFramerate = 0.0f;
 	u64					gLastFramerateCalcTime = 0;
 	u64					gTicksPerSecond = 0;
+	u64					gLastRenderWaitTicks = 0;
+	float				gRenderWaitMsPerFrame = 0.0f;
 
 #ifdef DAEDALUS_FRAMERATE_ANALYSIS
 	u32					gTotalFrames = 0;
@@ -73,6 +81,10 @@ static void	UpdateFramerate()
 		//gCurrentVblrate = float( gVblCount * gTicksPerSecond ) / float( ticks_since_recalc );
 		gCurrentFramerate = float( gFlipCount * gTicksPerSecond ) / float( ticks_since_recalc );
 
+		u64		render_wait_ticks( RenderThread_GetWaitTicks() );
+		gRenderWaitMsPerFrame = float( render_wait_ticks - gLastRenderWaitTicks ) * 1000.0f / float( gTicksPerSecond * gFlipCount );
+		gLastRenderWaitTicks = render_wait_ticks;
+
 		//gVblCount = 0;
 		gFlipCount = 0;
 		gLastFramerateCalcTime = now;
@@ -136,6 +148,21 @@ bool CGraphicsPluginImpl::Initialise()
 		return false;
 	}
 
+	// The display list debugger draws and reads back from the emulation thread, so it needs GL there.
+#ifndef DAEDALUS_DEBUG_DISPLAYLIST
+	if (gRenderThreadEnabled)
+	{
+		if (RenderThread_Start())
+		{
+			DBGConsole_Msg(0, "Started the render thread");
+		}
+		else
+		{
+			DBGConsole_Msg(0, "Unable to start the render thread - rendering on the emulation thread");
+		}
+	}
+#endif
+
 	return true;
 }
 
@@ -159,9 +186,16 @@ void CGraphicsPluginImpl::UpdateScreen()
 	{
 		UpdateFramerate();
 
-		// FIXME: safe printf
-		char string[22];
-		sprintf(string, "Daedalus | FPS %#.1f", gCurrentFramerate);
+		char string[200];
+		int len = snprintf(string, sizeof(string), "Daedalus | FPS %#.1f | Draws %d | States %d | Shader hitches %d | ROM stalls %dms | Rewind %.2fms (restore %.2fms)", gCurrentFramerate,
+				 gRendererGL->GetNumDrawCalls(), gRendererGL->GetNumStateChanges(), gRendererGL->GetNumShaderHitches(), RomBuffer::GetLoadStallMs(),
+				 Rewind_GetCaptureMs(), Rewind_GetRestoreMs());
+
+		// How long the emulation thread is held up waiting for the render thread to catch up
+		if (RenderThread_IsRunning() && len > 0 && len < (int)sizeof(string))
+		{
+			snprintf(string + len, sizeof(string) - len, " | Render wait %.2fms", gRenderWaitMsPerFrame);
+		}
 
 		glfwSetWindowTitle(gWindow, string);
 
@@ -172,6 +206,7 @@ void CGraphicsPluginImpl::UpdateScreen()
 		}
 
 		CGraphicsContext::Get()->UpdateFrame( false );
+		RomBuffer::ReportFirstFrame();
 
 		LastOrigin = current_origin;
 	}
@@ -180,6 +215,10 @@ void CGraphicsPluginImpl::UpdateScreen()
 void CGraphicsPluginImpl::RomClosed()
 {
 	DBGConsole_Msg(0, "Finalising GLGraphics");
+
+	// Shaders are written to the cache on this thread, and textures deleted, so take GL back first
+	RenderThread_Stop();
+
 	DLParser_Finalise();
 	CTextureCache::Destroy();
 	DestroyRenderer();
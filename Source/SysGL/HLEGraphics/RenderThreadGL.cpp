@@ -0,0 +1,317 @@
+/*
+Copyright (C) 2012 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#include "stdafx.h"
+#include "RenderThreadGL.h"
+
+#include <string.h>
+
+#include <vector>
+
+#include "Graphics/NativeTexture.h"
+#include "HLEGraphics/DaedalusVtx.h"
+#include "Math/MathUtil.h"
+#include "SysGL/GL.h"
+#include "Utility/Cond.h"
+#include "Utility/Mutex.h"
+#include "Utility/Thread.h"
+#include "Utility/Timing.h"
+
+namespace
+{
+
+// Each command is a CommandHeader followed by its data, both padded to kCommandAlign
+struct CommandHeader
+{
+	RenderCommandFunc	Func;
+	u32					Size;
+};
+
+const u32	kCommandAlign = 16;
+
+inline u32 AlignCommandSize( u32 size )
+{
+	return ( size + kCommandAlign - 1 ) & ~( kCommandAlign - 1 );
+}
+
+const u32	kCommandHeaderSize = AlignCommandSize( sizeof( CommandHeader ) );
+
+struct RenderFrame
+{
+	std::vector< u8 >						Commands;
+	std::vector< DaedalusVtx >				Vertices;		// Grows to fit the busiest frame. The first NumVertices are in use.
+	u32										NumVertices;
+	std::vector< CRefPtr<CNativeTexture> >	Textures;		// Released once the frame has been played back
+};
+
+RenderFrame		gFrames[ 2 ];
+
+Mutex			gFrameMutex( "RenderThread" );
+Cond *			gFrameQueuedCond {};		// Signalled when there's a frame for the render thread, or it should quit
+Cond *			gFrameDoneCond {};			// Signalled when the render thread finishes a frame
+ThreadHandle	gRenderThread {kInvalidThreadHandle};
+
+// Shared with the render thread, protected by gFrameMutex
+RenderFrame *	gPlayFrame {};
+bool			gRenderThreadQuit {};
+
+// Only touched by the emulation thread
+u32				gRecordFrame {};
+u64				gWaitTicks {};
+
+// Only touched by the render thread
+const DaedalusVtx *	gPlaybackVertices {};
+
+void PlayFrame( const RenderFrame & frame )
+{
+	gPlaybackVertices = frame.Vertices.empty() ? NULL : &frame.Vertices[ 0 ];
+
+	size_t	offset( 0 );
+	while( offset < frame.Commands.size() )
+	{
+		const CommandHeader *	header( reinterpret_cast< const CommandHeader * >( &frame.Commands[ offset ] ) );
+
+		header->Func( &frame.Commands[ offset + kCommandHeaderSize ] );
+		offset += kCommandHeaderSize + header->Size;
+	}
+
+	gPlaybackVertices = NULL;
+}
+
+void ResetFrame( RenderFrame & frame )
+{
+	frame.Commands.clear();
+	frame.NumVertices = 0;
+
+	// Destroying a texture records a command to delete its GL texture, so this has to come
+	// after the commands are cleared, to put it in the frame that's about to be recorded.
+	frame.Textures.clear();
+}
+
+u32 DAEDALUS_THREAD_CALL_TYPE RenderThread_Main( void * arg )
+{
+	glfwMakeContextCurrent( gWindow );
+
+	MutexLock	lock( &gFrameMutex );
+
+	for( ;; )
+	{
+		while( gPlayFrame == NULL && !gRenderThreadQuit )
+		{
+			CondWait( gFrameQueuedCond, &gFrameMutex, kTimeoutInfinity );
+		}
+
+		// Finish any frame we've been given before quitting
+		if( gPlayFrame == NULL )
+			break;
+
+		RenderFrame *	frame( gPlayFrame );
+
+		gFrameMutex.Unlock();
+		PlayFrame( *frame );
+		gFrameMutex.Lock();
+
+		gPlayFrame = NULL;
+		CondSignal( gFrameDoneCond );
+	}
+
+	glfwMakeContextCurrent( NULL );
+	return 0;
+}
+
+void DestroyConds()
+{
+	if( gFrameQueuedCond != NULL )	{ CondDestroy( gFrameQueuedCond ); gFrameQueuedCond = NULL; }
+	if( gFrameDoneCond != NULL )	{ CondDestroy( gFrameDoneCond ); gFrameDoneCond = NULL; }
+}
+
+}
+
+bool RenderThread_Start()
+{
+	DAEDALUS_ASSERT( gRenderThread == kInvalidThreadHandle, "The render thread is already running" );
+
+	gFrameQueuedCond = CondCreate();
+	gFrameDoneCond = CondCreate();
+	if( gFrameQueuedCond == NULL || gFrameDoneCond == NULL )
+	{
+		DestroyConds();
+		return false;
+	}
+
+	gPlayFrame = NULL;
+	gRenderThreadQuit = false;
+	gRecordFrame = 0;
+
+	// A context can only be current on one thread at a time
+	glfwMakeContextCurrent( NULL );
+
+	gRenderThread = CreateThread( "Render", RenderThread_Main, NULL );
+	if( gRenderThread == kInvalidThreadHandle )
+	{
+		glfwMakeContextCurrent( gWindow );
+		DestroyConds();
+		return false;
+	}
+
+	return true;
+}
+
+void RenderThread_Stop()
+{
+	if( gRenderThread == kInvalidThreadHandle )
+		return;
+
+	RenderThread_EndFrame();
+
+	{
+		MutexLock	lock( &gFrameMutex );
+		gRenderThreadQuit = true;
+		CondSignal( gFrameQueuedCond );
+	}
+	JoinThread( gRenderThread, -1 );
+	ReleaseThreadHandle( gRenderThread );
+	gRenderThread = kInvalidThreadHandle;
+	gRenderThreadQuit = false;
+
+	DestroyConds();
+
+	glfwMakeContextCurrent( gWindow );
+
+	// Textures released by the last RenderThread_EndFrame will have recorded their deletes here
+	PlayFrame( gFrames[ gRecordFrame ] );
+
+	// Now the thread has stopped, anything released here is deleted straight away
+	for( u32 i = 0; i < ARRAYSIZE( gFrames ); ++i )
+	{
+		ResetFrame( gFrames[ i ] );
+		std::vector< u8 >().swap( gFrames[ i ].Commands );
+		std::vector< DaedalusVtx >().swap( gFrames[ i ].Vertices );
+	}
+}
+
+bool RenderThread_IsRunning()
+{
+	return gRenderThread != kInvalidThreadHandle;
+}
+
+void RenderThread_Submit( RenderCommandFunc func, const void * p_data, u32 size )
+{
+	if( gRenderThread == kInvalidThreadHandle )
+	{
+		func( p_data );
+		return;
+	}
+
+	void *	p_dest( RenderThread_AllocCommand( func, size ) );
+	if( size > 0 )
+	{
+		memcpy( p_dest, p_data, size );
+	}
+}
+
+void * RenderThread_AllocCommand( RenderCommandFunc func, u32 size )
+{
+	DAEDALUS_ASSERT( gRenderThread != kInvalidThreadHandle, "Recording a command without the render thread" );
+
+	RenderFrame &	frame( gFrames[ gRecordFrame ] );
+	const u32		data_size( AlignCommandSize( size ) );
+	const size_t	offset( frame.Commands.size() );
+
+	frame.Commands.resize( offset + kCommandHeaderSize + data_size );
+
+	CommandHeader *	header( reinterpret_cast< CommandHeader * >( &frame.Commands[ offset ] ) );
+	header->Func = func;
+	header->Size = data_size;
+
+	return &frame.Commands[ offset + kCommandHeaderSize ];
+}
+
+void RenderThread_KeepAlive( CNativeTexture * texture )
+{
+	std::vector< CRefPtr<CNativeTexture> > &	textures( gFrames[ gRecordFrame ].Textures );
+
+	// Consecutive draws tend to share textures
+	if( textures.empty() || textures.back() != texture )
+	{
+		textures.push_back( texture );
+	}
+}
+
+DaedalusVtx * RenderThread_AllocVertices( u32 num_vertices )
+{
+	RenderFrame &	frame( gFrames[ gRecordFrame ] );
+	const u32		required( frame.NumVertices + num_vertices );
+
+	if( frame.Vertices.size() < required )
+	{
+		frame.Vertices.resize( Max< size_t >( frame.Vertices.size() * 2, required ) );
+	}
+
+	return &frame.Vertices[ frame.NumVertices ];
+}
+
+u32 RenderThread_CommitVertices( const DaedalusVtx * p_vertices, u32 num_vertices )
+{
+	RenderFrame &	frame( gFrames[ gRecordFrame ] );
+	const u32		first( frame.NumVertices );
+
+	DAEDALUS_ASSERT( p_vertices == &frame.Vertices[ first ], "Vertices weren't allocated by RenderThread_AllocVertices" );
+
+	frame.NumVertices = first + num_vertices;
+	return first;
+}
+
+const DaedalusVtx * RenderThread_GetPlaybackVertices()
+{
+	return gPlaybackVertices;
+}
+
+void RenderThread_EndFrame()
+{
+	if( gRenderThread == kInvalidThreadHandle )
+		return;
+
+	u64		start;
+	u64		end;
+	NTiming::GetPreciseTime( &start );
+
+	{
+		MutexLock	lock( &gFrameMutex );
+		while( gPlayFrame != NULL )
+		{
+			CondWait( gFrameDoneCond, &gFrameMutex, kTimeoutInfinity );
+		}
+
+		gPlayFrame = &gFrames[ gRecordFrame ];
+		CondSignal( gFrameQueuedCond );
+	}
+
+	NTiming::GetPreciseTime( &end );
+	gWaitTicks += end - start;
+
+	// The render thread has finished with the other frame, so it can be reused
+	gRecordFrame ^= 1;
+	ResetFrame( gFrames[ gRecordFrame ] );
+}
+
+u64 RenderThread_GetWaitTicks()
+{
+	return gWaitTicks;
+}
@@ -0,0 +1,86 @@
+/*
+Copyright (C) 2012 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#pragma once
+
+#ifndef SYSGL_HLEGRAPHICS_RENDERTHREADGL_H_
+#define SYSGL_HLEGRAPHICS_RENDERTHREADGL_H_
+
+//
+//	Moves the GL calls for display lists off the emulation thread.
+//
+//	The display list walk, T&L and texture conversion still happen on the
+//	emulation thread, which records what it would have sent to GL as a list of
+//	commands: a function to run on the render thread plus a copy of its
+//	arguments. Vertices are recorded alongside. At the end of each scene, and
+//	after each swap, the recorded frame is handed to the render thread, which
+//	owns the GL context and plays it back while the emulation thread records
+//	the next one into the other buffer.
+//
+//	When the render thread isn't running, commands are run as they're
+//	submitted, so the renderer has a single code path either way.
+//
+//	Command data is copied as raw memory and may be played back after the
+//	objects which recorded it are gone, so it must not hold anything which
+//	needs constructing or destroying. Textures referred to by a command must
+//	be passed to RenderThread_KeepAlive, as refcounts are only safe to change
+//	on the emulation thread.
+//
+
+struct DaedalusVtx;
+class CNativeTexture;
+
+typedef void (*RenderCommandFunc)( const void * p_data );
+
+// Hands the GL context over to a new render thread. Returns false (and leaves
+// the context where it was) if the thread couldn't be started.
+bool				RenderThread_Start();
+
+// Plays back anything already recorded, then takes the GL context back
+void				RenderThread_Stop();
+
+bool				RenderThread_IsRunning();
+
+// Runs func( p_data ) on the render thread, or straight away if it's not running
+void				RenderThread_Submit( RenderCommandFunc func, const void * p_data, u32 size );
+
+// Room for a command's data, to be filled in by the caller. Only valid until the next command
+// is recorded. Must only be used while the render thread is running.
+void *				RenderThread_AllocCommand( RenderCommandFunc func, u32 size );
+
+// Holds a reference to texture until the frame being recorded has been played back
+void				RenderThread_KeepAlive( CNativeTexture * texture );
+
+// Room for vertices at the end of the frame being recorded, which is used up by
+// RenderThread_CommitVertices. Returns the index of the first vertex in the frame.
+DaedalusVtx *		RenderThread_AllocVertices( u32 num_vertices );
+u32					RenderThread_CommitVertices( const DaedalusVtx * p_vertices, u32 num_vertices );
+
+// The vertices of the frame being played back, for draw commands to resolve their indices.
+// NULL unless called by a command running on the render thread.
+const DaedalusVtx *	RenderThread_GetPlaybackVertices();
+
+// Hands the recorded frame to the render thread. If it's still busy with the previous
+// frame, this waits for it first.
+void				RenderThread_EndFrame();
+
+// Total time the emulation thread has spent waiting in RenderThread_EndFrame
+u64					RenderThread_GetWaitTicks();
+
+#endif // SYSGL_HLEGRAPHICS_RENDERTHREADGL_H_
@@ -1,21 +1,29 @@
 #include "stdafx.h"
 #include "RendererGL.h"
 
+#include <stddef.h>
+
+#include <unordered_map>
 #include <vector>
 
 #include "Core/ROM.h"
 #include "Debug/DBGConsole.h"
+#include "Debug/Dump.h"
 #include "Graphics/ColourValue.h"
 #include "Graphics/GraphicsContext.h"
 #include "Graphics/NativeTexture.h"
+#include "HLEGraphics/CachedTexture.h"
 #include "HLEGraphics/DLDebug.h"
 #include "HLEGraphics/RDPStateManager.h"
 #include "OSHLE/ultra_gbi.h"
 #include "SysGL/GL.h"
+#include "SysGL/HLEGraphics/RenderThreadGL.h"
 #include "System/Paths.h"
+#include "Utility/Hash.h"
 #include "Utility/IO.h"
 #include "Utility/Macros.h"
 #include "Utility/Profiler.h"
+#include "Utility/Timing.h"
 
 
 BaseRenderer * gRenderer   = NULL;
@@ -68,23 +76,142 @@ const float kShiftScales[] = {
 };
 DAEDALUS_STATIC_ASSERT(ARRAYSIZE(kShiftScales) == 16);
 
-enum
+// Vertices are kept as DaedalusVtx in a single interleaved ring buffer. With GL_ARB_buffer_storage
+// the ring is mapped once and the renderer writes into it directly. The ring is split into thirds,
+// each fenced when we move off it, so we only wait if the GPU is still drawing from a third we want
+// to reuse. Without buffer storage we fill a copy in system memory and upload each draw's vertices.
+static const u32 kNumVertexSections  = 3;
+static const u32 kVerticesPerSection = 16 * 1024;
+static const u32 kNumVertices        = kNumVertexSections * kVerticesPerSection;
+
+static GLuint        gVAO;
+static GLuint        gVBO;
+static DaedalusVtx * gVertices          = NULL;
+static bool          gVerticesMapped    = false;
+static u32           gVertexSection     = 0;
+static u32           gNextVertex        = 0;
+static GLsync        gSectionFences[kNumVertexSections] = {};
+
+// Everything ApplyRenderState depends on. Keys are zeroed before they're filled in, so they can be
+// hashed and compared as raw memory. The scissor and viewport aren't included - changing them flushes.
+// Keys are also what draws are recorded with for the render thread, so they mustn't refer to anything
+// which could change before they're played back.
+struct RenderStateKey
 {
-	kPositionBuffer,
-	kTexCoordBuffer,
-	kColorBuffer,
-
-	kNumBuffers,
+	float				Project[16];
+	float				UVScale[2];
+	float				UVOffset[2];
+	u64					OtherMode;
+	u64					Mux;
+	u32					PrimColour;
+	u32					EnvColour;
+	u32					BlendColour;
+	f32					PrimLODFraction;
+	u32					DisableZBuffer;
+	u32					TnLZBuffer;
+	u32					ForceLinearFilter;
+	u32					Frame;
+	u32					Override2D;			// Draw2DTexture's blend and sampler settings
+
+	CNativeTexture *	Texture[kNumTextures];
+	u32					Tile[kNumTextures][2];
+	u32					TileSize[kNumTextures][2];
+	s16					TileTopLeft[kNumTextures][2];
+	u32					TexWrap[kNumTextures][2];
 };
 
-static GLuint gVAO;
-static GLuint gVBOs[kNumBuffers];
+// Triangles from RenderTriangles and the rects aren't drawn straight away. While the render state stays
+// the same, later batches (which AllocVertices places straight after) are merged in and drawn together.
+// This relies on GL state not changing while a draw is pending, so anything which touches it
+// outside of a draw needs to call FlushDraws() first.
+// With the render thread running, gPendingFirst is an index into the frame being recorded rather
+// than into gVertices, and nothing stops a batch growing past a section, so merging stops there.
+static RenderStateKey gPendingKey;
+static u32            gPendingKeyHash    = 0;
+static u32            gPendingFirst      = 0;
+static u32            gPendingCount      = 0;
+
+static void FlushPendingDraw();
+
+// Written by the render thread (if there is one) and read for the window title, so they may be a frame out.
+static u32            gNumDrawCalls      = 0;
+static u32            gNumStateChanges   = 0;
+static u32            gLastDrawCalls     = 0;
+static u32            gLastStateChanges  = 0;
+
+// The state the render thread (if there is one) last applied. Draws with the same key don't apply it again.
+static RenderStateKey gAppliedKey;
+static bool           gAppliedKeyValid   = false;
+
+static void DrawVertices(GLenum prim, u32 first, u32 count)
+{
+	if (!gVerticesMapped)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, gVBO);
+		glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(DaedalusVtx), count * sizeof(DaedalusVtx), &gVertices[first]);
+	}
+
+	glDrawArrays(prim, first, count);
+	++gNumDrawCalls;
+}
+
+// The fence needs to follow every draw from this section, so any pending draw must be flushed first.
+static void NextVertexSection()
+{
+	if (gVerticesMapped)
+	{
+		gSectionFences[gVertexSection] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	gVertexSection = (gVertexSection + 1) % kNumVertexSections;
+	gNextVertex    = gVertexSection * kVerticesPerSection;
+
+	if (GLsync fence = gSectionFences[gVertexSection])
+	{
+		DAEDALUS_PROFILE( "NextVertexSection - wait" );
 
-const int kMaxVertices = 1000;
+		while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+		{
+		}
+		glDeleteSync(fence);
+		gSectionFences[gVertexSection] = NULL;
+	}
+}
+
+static bool InitVertexBuffer()
+{
+	pglGenVertexArrays(1, &gVAO);
+	pglBindVertexArray(gVAO);
 
-static float 	gPositionBuffer[kMaxVertices][3];
-static TexCoord gTexCoordBuffer[kMaxVertices];
-static u32 		gColorBuffer[kMaxVertices];
+	glGenBuffers(1, &gVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, gVBO);
+
+	const GLsizeiptr bytes = kNumVertices * sizeof(DaedalusVtx);
+
+	if (GLEW_ARB_buffer_storage)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+		glBufferStorage(GL_ARRAY_BUFFER, bytes, NULL, flags);
+		gVertices = static_cast<DaedalusVtx *>(glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, flags));
+		gVerticesMapped = gVertices != NULL;
+	}
+
+	if (!gVerticesMapped)
+	{
+		// NB: if glBufferStorage succeeded but mapping failed the storage is immutable, so start afresh.
+		glDeleteBuffers(1, &gVBO);
+		glGenBuffers(1, &gVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, gVBO);
+		glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_DYNAMIC_DRAW);
+
+		gVertices = static_cast<DaedalusVtx *>(malloc(bytes));
+	}
+
+	gVertexSection = 0;
+	gNextVertex    = 0;
+	return gVertices != NULL;
+}
 
 bool initgl()
 {
@@ -123,19 +250,11 @@ bool initgl()
     RESOLVE_GL_FCN(PFN_glDeleteVertexArrays, pglDeleteVertexArrays, "glDeleteVertexArrays");
     RESOLVE_GL_FCN(PFN_glBindVertexArray, pglBindVertexArray, "glBindVertexArray");
 
-	pglGenVertexArrays(1, &gVAO);
-	pglBindVertexArray(gVAO);
-
-	glGenBuffers(kNumBuffers, gVBOs);
-
-	glBindBuffer(GL_ARRAY_BUFFER, gVBOs[kPositionBuffer]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(gPositionBuffer), gPositionBuffer, GL_DYNAMIC_DRAW);
-
-	glBindBuffer(GL_ARRAY_BUFFER, gVBOs[kTexCoordBuffer]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(gTexCoordBuffer), gTexCoordBuffer, GL_DYNAMIC_DRAW);
-
-	glBindBuffer(GL_ARRAY_BUFFER, gVBOs[kColorBuffer]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(gColorBuffer), gColorBuffer, GL_DYNAMIC_DRAW);
+	if (!InitVertexBuffer())
+	{
+		DAEDALUS_ERROR("Couldn't allocate vertex buffer");
+		return false;
+	}
 	return true;
 }
 
@@ -167,6 +286,37 @@ struct ShaderConfiguration
 	u32		ClampS1 : 1;
 	u32		ClampT1 : 1;
 	u8		AlphaThreshold;
+
+	u32		Hash;			// Set by UpdateHash() once the fields above are filled in. Not part of the configuration.
+
+	// Everything but the mux, packed into one word for hashing and for the shader cache.
+	u32 GetFlags() const
+	{
+		return CycleType | (BilerpFilter << 2) | (ClampS0 << 3) | (ClampT0 << 4) |
+			   (ClampS1 << 5) | (ClampT1 << 6) | (AlphaThreshold << 8);
+	}
+
+	void SetFlags(u32 flags)
+	{
+		CycleType      = flags & 3;
+		BilerpFilter   = (flags >> 2) & 1;
+		ClampS0        = (flags >> 3) & 1;
+		ClampT0        = (flags >> 4) & 1;
+		ClampS1        = (flags >> 5) & 1;
+		ClampT1        = (flags >> 6) & 1;
+		AlphaThreshold = (flags >> 8) & 0xff;
+	}
+
+	void UpdateHash()
+	{
+		u32 words[] = { (u32)Mux, (u32)(Mux >> 32), GetFlags() };
+		Hash = murmur2_hash(words, sizeof(words), 0);
+	}
+};
+
+struct ShaderConfigurationHasher
+{
+	size_t operator()(const ShaderConfiguration & config) const		{ return config.Hash; }
 };
 
 inline bool operator==(const ShaderConfiguration & a, const ShaderConfiguration & b)
@@ -191,6 +341,8 @@ struct ShaderProgram
 	GLint				uloc_primcol;
 	GLint				uloc_envcol;
 	GLint				uloc_primlodfrac;
+	GLint				uloc_uvscale;
+	GLint				uloc_uvoffset;
 
 	GLint				uloc_tileclamp[kNumTextures];
 	GLint				uloc_tiletl[kNumTextures];
@@ -203,8 +355,20 @@ struct ShaderProgram
 	GLint				uloc_texture[kNumTextures];
 
 	GLint				uloc_foo;
+
+	u32					rom_session;		// The last gShaderSession this program was used in
 };
-static std::vector<ShaderProgram *>		gShaders;
+
+typedef std::unordered_map<ShaderConfiguration, ShaderProgram *, ShaderConfigurationHasher> ShaderMap;
+static ShaderMap						gShaders;
+
+// Programs used while this rom has been running, which are written to the shader cache when it closes.
+static std::vector<ShaderProgram *>		gRomShaders;
+static u32								gShaderSession = 0;
+
+// Compiles which weren't covered by the shader cache, and would have caused a hitch.
+static u32								gNumShaderHitches = 0;
+static u64								gShaderHitchTicks = 0;
 
 
 /* Creates a shader object of the specified type using the specified text
@@ -262,6 +426,11 @@ static GLuint make_shader_program(const char ** vertex_lines, size_t num_vertex_
 				glAttachShader(program, vertex_shader);
 				glAttachShader(program, fragment_shader);
 
+				if (GLEW_ARB_get_program_binary)
+				{
+					glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+				}
+
 				glLinkProgram(program);
 				glGetProgramiv(program, GL_LINK_STATUS, &program_ok);
 
@@ -339,6 +508,8 @@ static const char * kAlphaParams8[8] = {
 static const char* default_vertex_shader =
 "#version 150\n"
 "uniform mat4 uProject;\n"
+"uniform vec2 uUVScale;\n"
+"uniform vec2 uUVOffset;\n"
 "in      vec3 in_pos;\n"
 "in      vec2 in_uv;\n"
 "in      vec4 in_col;\n"
@@ -347,7 +518,7 @@ static const char* default_vertex_shader =
 "\n"
 "void main()\n"
 "{\n"
-"	v_st = in_uv;\n"
+"	v_st = trunc(in_uv * uUVScale + uUVOffset);\n"
 "	v_col = in_col;\n"
 "	gl_Position = uProject * vec4(in_pos, 1.0);\n"
 "}\n";
@@ -473,6 +644,8 @@ static void InitShaderProgram(ShaderProgram * program, const ShaderConfiguration
 	program->uloc_primcol      = glGetUniformLocation(shader_program, "uPrimColour");
 	program->uloc_envcol       = glGetUniformLocation(shader_program, "uEnvColour");
 	program->uloc_primlodfrac  = glGetUniformLocation(shader_program, "uPrimLODFrac");
+	program->uloc_uvscale      = glGetUniformLocation(shader_program, "uUVScale");
+	program->uloc_uvoffset     = glGetUniformLocation(shader_program, "uUVOffset");
 
 	program->uloc_foo			= glGetUniformLocation(shader_program, "uFoo");
 
@@ -494,27 +667,31 @@ static void InitShaderProgram(ShaderProgram * program, const ShaderConfiguration
 	program->uloc_texscale[1]   = glGetUniformLocation(shader_program, "uTexScale1");
 	program->uloc_texture[1]    = glGetUniformLocation(shader_program, "uTexture1");
 
+	const GLsizei stride = sizeof(DaedalusVtx);
+
+	glBindBuffer(GL_ARRAY_BUFFER, gVBO);
+
 	GLuint attrloc;
 	attrloc = glGetAttribLocation(program->program, "in_pos");
-	glBindBuffer(GL_ARRAY_BUFFER, gVBOs[kPositionBuffer]);
 	glEnableVertexAttribArray(attrloc);
-	glVertexAttribPointer(attrloc, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	glVertexAttribPointer(attrloc, 3, GL_FLOAT, GL_FALSE, stride, (const GLvoid *)offsetof(DaedalusVtx, Position));
 
 	attrloc = glGetAttribLocation(program->program, "in_uv");
-	glBindBuffer(GL_ARRAY_BUFFER, gVBOs[kTexCoordBuffer]);
 	glEnableVertexAttribArray(attrloc);
-	glVertexAttribPointer(attrloc, 2, GL_SHORT, GL_FALSE, 0, 0);
+	glVertexAttribPointer(attrloc, 2, GL_FLOAT, GL_FALSE, stride, (const GLvoid *)offsetof(DaedalusVtx, Texture));
 
 	attrloc = glGetAttribLocation(program->program, "in_col");
-	glBindBuffer(GL_ARRAY_BUFFER, gVBOs[kColorBuffer]);
 	glEnableVertexAttribArray(attrloc);
-	glVertexAttribPointer(attrloc, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, 0);
+	glVertexAttribPointer(attrloc, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (const GLvoid *)offsetof(DaedalusVtx, Colour));
 }
 
-void RendererGL::MakeShaderConfigFromCurrentState(ShaderConfiguration * config) const
+static void MakeShaderConfig(const RenderStateKey & key, ShaderConfiguration * config)
 {
-	config->Mux = mMux;
-	config->CycleType = gRDPOtherMode.cycle_type;
+	RDP_OtherMode other_mode;
+	other_mode._u64 = key.OtherMode;
+
+	config->Mux = key.Mux;
+	config->CycleType = other_mode.cycle_type;
 	config->AlphaThreshold = 0;
 	config->BilerpFilter = true;
 	config->ClampS0 = false;
@@ -523,13 +700,13 @@ void RendererGL::MakeShaderConfigFromCurrentState(ShaderConfiguration * config)
 	config->ClampT1 = false;
 
 	// Initiate Alpha test
-	if( (gRDPOtherMode.alpha_compare == G_AC_THRESHOLD) && !gRDPOtherMode.alpha_cvg_sel )
+	if( (other_mode.alpha_compare == G_AC_THRESHOLD) && !other_mode.alpha_cvg_sel )
 	{
 		// G_AC_THRESHOLD || G_AC_DITHER
 		// FIXME(strmnnrmn): alpha func: (mAlphaThreshold | g_ROM.ALPHA_HACK) ? GL_GEQUAL : GL_GREATER
-		config->AlphaThreshold = mBlendColour.GetA();
+		config->AlphaThreshold = c32(key.BlendColour).GetA();
 	}
-	else if (gRDPOtherMode.cvg_x_alpha)
+	else if (other_mode.cvg_x_alpha)
 	{
 		// Going over 0x70 brakes OOT, but going lesser than that makes lines on games visible...ex: Paper Mario.
 		// ALso going over 0x30 breaks the birds in Tarzan :(. Need to find a better way to leverage this.
@@ -550,7 +727,7 @@ void RendererGL::MakeShaderConfigFromCurrentState(ShaderConfiguration * config)
 	if (cycle_type == CYCLE_FILL)
 		config->AlphaThreshold = 0;
 
-	config->BilerpFilter = (gRDPOtherMode.text_filt != G_TF_POINT) || (gGlobalPreferences.ForceLinearFilter);
+	config->BilerpFilter = (other_mode.text_filt != G_TF_POINT) || (key.ForceLinearFilter);
 
 	// If running the bilinear filter, check if we need to clamp in S or T.
 	// Really, this is checking to see how we set mTexWrap in PrepareTexRectUVs.
@@ -558,49 +735,345 @@ void RendererGL::MakeShaderConfigFromCurrentState(ShaderConfiguration * config)
 	// (NB: better fix for California Speed is just to force a point filter...)
 	if (config->BilerpFilter)
 	{
-		config->ClampS0 = mTexWrap[0].u == GU_CLAMP;
-		config->ClampT0 = mTexWrap[0].v == GU_CLAMP;
+		config->ClampS0 = key.TexWrap[0][0] == GU_CLAMP;
+		config->ClampT0 = key.TexWrap[0][1] == GU_CLAMP;
 
-		config->ClampS1 = mTexWrap[1].u == GU_CLAMP;
-		config->ClampT1 = mTexWrap[1].v == GU_CLAMP;
+		config->ClampS1 = key.TexWrap[1][0] == GU_CLAMP;
+		config->ClampT1 = key.TexWrap[1][1] == GU_CLAMP;
 	}
+
+	config->UpdateHash();
 }
 
-static ShaderProgram * GetShaderForConfig(const ShaderConfiguration & config)
+static void NoteRomShader(ShaderProgram * program)
 {
-	DAEDALUS_ASSERT( gN64FramentLibrary != NULL, "Haven't initialised the n64 fragment library" );
-
-	for (u32 i = 0; i < gShaders.size(); ++i)
+	if (program->rom_session != gShaderSession)
 	{
-		ShaderProgram * program = gShaders[i];
-		if (program->config == config)
-			return program;
+		program->rom_session = gShaderSession;
+		gRomShaders.push_back(program);
 	}
+}
 
-	char frag_shader[2048];
-	SprintShader(frag_shader, config);
+// If binary is non-NULL we try to load the program from that first, falling back to compiling it.
+static ShaderProgram * CreateShaderProgram(const ShaderConfiguration & config, const void * binary, GLenum binary_format, GLsizei binary_length)
+{
+	DAEDALUS_ASSERT( gN64FramentLibrary != NULL, "Haven't initialised the n64 fragment library" );
+
+	GLuint shader_program = 0;
 
-	const char * vertex_lines[] = { default_vertex_shader };
-	const char * fragment_lines[] = { gN64FramentLibrary, frag_shader };
+	if (binary != NULL && GLEW_ARB_get_program_binary)
+	{
+		shader_program = glCreateProgram();
+		glProgramBinary(shader_program, binary_format, binary, binary_length);
+
+		// The driver can reject binaries at any time (e.g. after an update), so check it took.
+		GLint program_ok;
+		glGetProgramiv(shader_program, GL_LINK_STATUS, &program_ok);
+		if (program_ok != GL_TRUE)
+		{
+			glDeleteProgram(shader_program);
+			shader_program = 0;
+		}
+	}
 
-	GLuint shader_program = make_shader_program(
-								vertex_lines, ARRAYSIZE(vertex_lines),
-								fragment_lines, ARRAYSIZE(fragment_lines));
 	if (shader_program == 0)
 	{
-		fprintf(stderr, "ERROR: during creation of the shader program\n");
-		return NULL;
+		char frag_shader[2048];
+		SprintShader(frag_shader, config);
+
+		const char * vertex_lines[] = { default_vertex_shader };
+		const char * fragment_lines[] = { gN64FramentLibrary, frag_shader };
+
+		shader_program = make_shader_program(
+									vertex_lines, ARRAYSIZE(vertex_lines),
+									fragment_lines, ARRAYSIZE(fragment_lines));
+		if (shader_program == 0)
+		{
+			fprintf(stderr, "ERROR: during creation of the shader program\n");
+			return NULL;
+		}
 	}
 
 	ShaderProgram * program = new ShaderProgram;
 	InitShaderProgram(program, config, shader_program);
-	gShaders.push_back(program);
+	program->rom_session = 0;
+	gShaders[config] = program;
 
 	return program;
 }
 
-void RendererGL::RestoreRenderStates()
+static ShaderProgram * GetShaderForConfig(const ShaderConfiguration & config)
+{
+	ShaderMap::const_iterator it = gShaders.find(config);
+	if (it != gShaders.end())
+	{
+		NoteRomShader(it->second);
+		return it->second;
+	}
+
+	u64 start;
+	u64 end;
+	NTiming::GetPreciseTime(&start);
+
+	ShaderProgram * program = CreateShaderProgram(config, NULL, 0, 0);
+
+	NTiming::GetPreciseTime(&end);
+
+	gNumShaderHitches++;
+	gShaderHitchTicks += end - start;
+
+	if (program == NULL)
+		return NULL;
+
+	DBGConsole_Msg(0, "Compiled shader for mux %llx, cycle %d in %dms", config.Mux, config.CycleType, (u32)NTiming::ToMilliseconds(end - start));
+
+	NoteRomShader(program);
+	return program;
+}
+
+//*****************************************************************************
+// Shader cache
+//
+// When a rom closes, the configurations of all the shaders it used are written
+// out alongside its saves, along with the linked program binaries where the
+// driver supports GL_ARB_get_program_binary. These are all created up front
+// the next time the rom is started, so we don't stall compiling mid-game.
+// Binaries are only reused with the same driver and shader source.
+//*****************************************************************************
+static const u32 kShaderCacheMagic   = 0x43485344;		// 'DSHC'
+static const u32 kShaderCacheVersion = 1;
+static const u32 kMaxShaderBinaryLength = 4 * 1024 * 1024;	// Anything bigger is a corrupt cache
+
+struct ShaderCacheHeader
+{
+	u32		Magic;
+	u32		Version;
+	u32		DriverHash;
+	u32		NumEntries;
+};
+
+struct ShaderCacheEntry
 {
+	u64		Mux;
+	u32		Flags;
+	u32		BinaryFormat;
+	u32		BinaryLength;		// Followed by this many bytes of program binary
+};
+
+static u32 GetShaderDriverHash()
+{
+	const char * strings[] = {
+		(const char *)glGetString(GL_VENDOR),
+		(const char *)glGetString(GL_RENDERER),
+		(const char *)glGetString(GL_VERSION),
+		default_vertex_shader,
+		default_fragment_shader_fmt,
+		gN64FramentLibrary,
+	};
+
+	u32 hash = 0;
+	for (u32 i = 0; i < ARRAYSIZE(strings); ++i)
+	{
+		if (strings[i] != NULL)
+			hash = murmur2_hash(strings[i], strlen(strings[i]), hash);
+	}
+	return hash;
+}
+
+static void GetShaderCacheFilename(IO::Filename & filename)
+{
+	Dump_GetSaveDirectory(filename, g_ROM.mFileName, ".shaders");
+}
+
+static void LoadShaderCache()
+{
+	gShaderSession++;
+	gRomShaders.clear();
+	gNumShaderHitches = 0;
+	gShaderHitchTicks = 0;
+
+	IO::Filename filename;
+	GetShaderCacheFilename(filename);
+
+	FILE * fh = fopen(filename, "rb");
+	if (fh == NULL)
+		return;
+
+	ShaderCacheHeader header;
+	if (fread(&header, sizeof(header), 1, fh) != 1 ||
+		header.Magic != kShaderCacheMagic || header.Version != kShaderCacheVersion)
+	{
+		DBGConsole_Msg(0, "Ignoring out of date shader cache [C%s]", filename);
+		fclose(fh);
+		return;
+	}
+
+	const bool use_binaries = header.DriverHash == GetShaderDriverHash();
+
+	// Binary lengths are checked against what's left of the file, so a truncated or corrupt cache
+	// can't make us allocate and read garbage
+	long file_pos = ftell(fh);
+	fseek(fh, 0, SEEK_END);
+	long file_size = ftell(fh);
+	fseek(fh, file_pos, SEEK_SET);
+
+	u64 start;
+	u64 end;
+	NTiming::GetPreciseTime(&start);
+
+	std::vector<u8> binary;
+	u32 num_loaded = 0;
+	u32 num_binaries = 0;
+
+	for (u32 i = 0; i < header.NumEntries; ++i)
+	{
+		ShaderCacheEntry entry;
+		if (fread(&entry, sizeof(entry), 1, fh) != 1)
+			break;
+
+		if (entry.BinaryLength > kMaxShaderBinaryLength ||
+			entry.BinaryLength > u32(file_size - ftell(fh)))
+		{
+			DBGConsole_Msg(0, "Ignoring corrupt shader cache [C%s]", filename);
+			break;
+		}
+
+		binary.resize(entry.BinaryLength);
+		if (entry.BinaryLength > 0 && fread(&binary[0], entry.BinaryLength, 1, fh) != 1)
+			break;
+
+		ShaderConfiguration config;
+		memset(&config, 0, sizeof(config));
+		config.Mux = entry.Mux;
+		config.SetFlags(entry.Flags);
+		config.UpdateHash();
+
+		ShaderProgram * program;
+		ShaderMap::const_iterator it = gShaders.find(config);
+		if (it != gShaders.end())
+		{
+			program = it->second;
+		}
+		else
+		{
+			const bool has_binary = use_binaries && entry.BinaryLength > 0;
+
+			program = CreateShaderProgram(config, has_binary ? &binary[0] : NULL, entry.BinaryFormat, entry.BinaryLength);
+			if (program == NULL)
+				continue;
+
+			num_binaries += has_binary;
+		}
+
+		NoteRomShader(program);
+		num_loaded++;
+	}
+
+	fclose(fh);
+
+	NTiming::GetPreciseTime(&end);
+
+	DBGConsole_Msg(0, "Prepared %d shaders (%d from binaries) in %dms", num_loaded, num_binaries, (u32)NTiming::ToMilliseconds(end - start));
+}
+
+static void SaveShaderCache()
+{
+	DBGConsole_Msg(0, "Shaders: %d used, %d compiled mid-game taking %dms",
+				   (u32)gRomShaders.size(), gNumShaderHitches, (u32)NTiming::ToMilliseconds(gShaderHitchTicks));
+
+	if (gRomShaders.empty())
+		return;
+
+	IO::Filename filename;
+	GetShaderCacheFilename(filename);
+
+	// Write to a temporary file first, so a crash never leaves a half written cache behind
+	IO::Filename temp_filename;
+	IO::Path::Assign(temp_filename, filename);
+	IO::Path::AddExtension(temp_filename, ".tmp");
+
+	FILE * fh = fopen(temp_filename, "wb");
+	if (fh == NULL)
+		return;
+
+	ShaderCacheHeader header;
+	header.Magic      = kShaderCacheMagic;
+	header.Version    = kShaderCacheVersion;
+	header.DriverHash = GetShaderDriverHash();
+	header.NumEntries = gRomShaders.size();
+	bool ok = fwrite(&header, sizeof(header), 1, fh) == 1;
+
+	std::vector<u8> binary;
+
+	for (u32 i = 0; i < gRomShaders.size(); ++i)
+	{
+		const ShaderProgram * program = gRomShaders[i];
+
+		ShaderCacheEntry entry;
+		entry.Mux          = program->config.Mux;
+		entry.Flags        = program->config.GetFlags();
+		entry.BinaryFormat = 0;
+		entry.BinaryLength = 0;
+
+		if (GLEW_ARB_get_program_binary)
+		{
+			GLint length = 0;
+			glGetProgramiv(program->program, GL_PROGRAM_BINARY_LENGTH, &length);
+			if (length > 0)
+			{
+				binary.resize(length);
+
+				GLenum format;
+				glGetProgramBinary(program->program, length, &length, &format, &binary[0]);
+
+				entry.BinaryFormat = format;
+				entry.BinaryLength = length;
+			}
+		}
+
+		ok &= fwrite(&entry, sizeof(entry), 1, fh) == 1;
+		if (entry.BinaryLength > 0)
+		{
+			ok &= fwrite(&binary[0], entry.BinaryLength, 1, fh) == 1;
+		}
+	}
+
+	ok &= fclose(fh) == 0;
+
+	// MoveFile won't replace an existing file on Windows
+	if (ok && !IO::File::Move(temp_filename, filename))
+	{
+		IO::File::Delete(filename);
+		ok = IO::File::Move(temp_filename, filename);
+	}
+
+	if (!ok)
+	{
+		DBGConsole_Msg(0, "Failed to write shader cache [C%s]", filename);
+		IO::File::Delete(temp_filename);
+	}
+}
+
+struct RestoreRenderStatesCommand
+{
+	u32		Width;
+	u32		Height;
+};
+
+static void ExecuteRestoreRenderStates(const void * p_data)
+{
+	const RestoreRenderStatesCommand * cmd = static_cast<const RestoreRenderStatesCommand *>(p_data);
+
+	// Start each frame on a fresh section of the vertex buffer.
+	NextVertexSection();
+
+	gLastDrawCalls    = gNumDrawCalls;
+	gLastStateChanges = gNumStateChanges;
+	gNumDrawCalls     = 0;
+	gNumStateChanges  = 0;
+
+	RendererGL::InvalidateRenderState();
+
 	// Initialise the device to our default state
 
 	// No fog
@@ -609,10 +1082,7 @@ void RendererGL::RestoreRenderStates()
 	// We do our own culling
 	glDisable(GL_CULL_FACE);
 
-	u32 width, height;
-	CGraphicsContext::Get()->GetScreenSize(&width, &height);
-
-	glScissor(0,0, width,height);
+	glScissor(0,0, cmd->Width,cmd->Height);
 	glEnable(GL_SCISSOR_TEST);
 
 	// We do our own lighting
@@ -638,49 +1108,107 @@ void RendererGL::RestoreRenderStates()
 	glEnable(GL_POLYGON_OFFSET_FILL);
 }
 
-// Strip out vertex stream into separate buffers.
-// TODO(strmnnrmn): Renderer should support generating this data directly.
-void RendererGL::RenderDaedalusVtx(int prim, const DaedalusVtx * vertices, int count)
+void RendererGL::RestoreRenderStates()
 {
-	DAEDALUS_ASSERT(count <= kMaxVertices, "Too many vertices!");
+	FlushPendingDraw();
 
-	// Avoid crashing in the unlikely even that our buffers aren't long enough.
-	if (count > kMaxVertices)
-		count = kMaxVertices;
+	// The screen size comes from GLFW, which only works on the main thread.
+	RestoreRenderStatesCommand cmd;
+	CGraphicsContext::Get()->GetScreenSize(&cmd.Width, &cmd.Height);
 
-	// Hack to fix the sun in Zelda OOT/MM
-	const f32 scale = ( g_ROM.ZELDA_HACK &&(gRDPOtherMode.L == 0x0c184241) ) ? 16.f : 32.f;
+	RenderThread_Submit(ExecuteRestoreRenderStates, &cmd, sizeof(cmd));
+}
+
+DaedalusVtx * RendererGL::AllocVertices(u32 num_vertices)
+{
+	DAEDALUS_ASSERT(num_vertices <= kVerticesPerSection, "Too many vertices!");
+
+	// The render thread copies each draw's vertices into gVertices as it plays them back.
+	if (RenderThread_IsRunning())
+		return RenderThread_AllocVertices(num_vertices);
 
-	for (int i = 0; i < count; ++i)
+	if (gNextVertex + num_vertices > (gVertexSection + 1) * kVerticesPerSection)
 	{
-		const DaedalusVtx * vtx = &vertices[i];
+		FlushPendingDraw();
+		NextVertexSection();
+	}
 
-		gPositionBuffer[i][0] = vtx->Position.x;
-		gPositionBuffer[i][1] = vtx->Position.y;
-		gPositionBuffer[i][2] = vtx->Position.z;
+	return &gVertices[gNextVertex];
+}
 
-		// FIXME(strmnnrmn): maintain the texture coords in 10.5 format.
-		gTexCoordBuffer[i].s = (int)(vtx->Texture.x * scale);
-		gTexCoordBuffer[i].t = (int)(vtx->Texture.y * scale);
+// Uses up vertices from the last call to AllocVertices, returning the index draws refer to them by.
+static u32 CommitVertices(const DaedalusVtx * p_vertices, u32 num_vertices)
+{
+	if (RenderThread_IsRunning())
+		return RenderThread_CommitVertices(p_vertices, num_vertices);
 
-		gColorBuffer[i] = vtx->Colour.GetColour();
-	}
+	const u32 first = p_vertices - gVertices;
+
+	DAEDALUS_ASSERT(first == gNextVertex, "Vertices weren't allocated by AllocVertices");
 
-	RenderDaedalusVtxStreams(prim, &gPositionBuffer[0][0], &gTexCoordBuffer[0], &gColorBuffer[0], count);
+	gNextVertex = first + num_vertices;
+	return first;
 }
 
-void RendererGL::RenderDaedalusVtxStreams(int prim, const float * positions, const TexCoord * uvs, const u32 * colours, int count)
+void RendererGL::FlushDraws()
 {
-	glBindBuffer(GL_ARRAY_BUFFER, gVBOs[kPositionBuffer]);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * 3 * count, positions);
+	FlushPendingDraw();
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, gVBOs[kTexCoordBuffer]);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(TexCoord) * count, uvs);
+void RendererGL::InvalidateRenderState()
+{
+	gAppliedKeyValid = false;
+}
+
+struct RectCommand
+{
+	s32		X;
+	s32		Y;
+	s32		Width;
+	s32		Height;
+};
 
-	glBindBuffer(GL_ARRAY_BUFFER, gVBOs[kColorBuffer]);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(u32) * count, colours);
+static void ExecuteViewport(const void * p_data)
+{
+	const RectCommand * cmd = static_cast<const RectCommand *>(p_data);
+	glViewport(cmd->X, cmd->Y, cmd->Width, cmd->Height);
+}
 
-	glDrawArrays(prim, 0, count);
+static void ExecuteScissor(const void * p_data)
+{
+	const RectCommand * cmd = static_cast<const RectCommand *>(p_data);
+	glScissor(cmd->X, cmd->Y, cmd->Width, cmd->Height);
+}
+
+void RendererGL::SetGLViewport(s32 x, s32 y, s32 w, s32 h)
+{
+	FlushPendingDraw();
+
+	RectCommand cmd = { x, y, w, h };
+	RenderThread_Submit(ExecuteViewport, &cmd, sizeof(cmd));
+}
+
+void RendererGL::SetGLScissor(s32 x, s32 y, s32 w, s32 h)
+{
+	FlushPendingDraw();
+
+	RectCommand cmd = { x, y, w, h };
+	RenderThread_Submit(ExecuteScissor, &cmd, sizeof(cmd));
+}
+
+u32 RendererGL::GetNumDrawCalls() const
+{
+	return gLastDrawCalls;
+}
+
+u32 RendererGL::GetNumStateChanges() const
+{
+	return gLastStateChanges;
+}
+
+u32 RendererGL::GetNumShaderHitches() const
+{
+	return gNumShaderHitches;
 }
 
 /*
@@ -738,12 +1266,12 @@ static inline void DebugBlender(u32 cycle_type, u32 blender, u32 alpha_cvg_sel,
 }
 #endif
 
-static void InitBlenderMode()
+static void InitBlenderMode(const RDP_OtherMode & other_mode)
 {
-	u32 cycle_type    = gRDPOtherMode.cycle_type;
-	u32 cvg_x_alpha   = gRDPOtherMode.cvg_x_alpha;
-	u32 alpha_cvg_sel = gRDPOtherMode.alpha_cvg_sel;
-	u32 blendmode     = gRDPOtherMode.blender;
+	u32 cycle_type    = other_mode.cycle_type;
+	u32 cvg_x_alpha   = other_mode.cvg_x_alpha;
+	u32 alpha_cvg_sel = other_mode.alpha_cvg_sel;
+	u32 blendmode     = other_mode.blender;
 
 	// NB: If we're running in 1cycle mode, ignore the 2nd cycle.
 	u32 active_mode = (cycle_type == CYCLE_2CYCLE) ? blendmode : (blendmode & 0xcccc);
@@ -873,11 +1401,22 @@ inline u32 MakeMirror(u32 mirror, u32 m)
 	return (mirror && m) ? (1<<m) : 0;
 }
 
-void RendererGL::PrepareRenderState(const float (&mat_project)[16], bool disable_zbuffer)
+// Runs on the render thread, if there is one.
+static void ApplyRenderState(const RenderStateKey & key)
 {
-	DAEDALUS_PROFILE( "RendererGL::PrepareRenderState" );
+	DAEDALUS_PROFILE( "ApplyRenderState" );
 
-	if ( disable_zbuffer )
+	if (gAppliedKeyValid && memcmp(&key, &gAppliedKey, sizeof(key)) == 0)
+		return;
+
+	++gNumStateChanges;
+	gAppliedKey      = key;
+	gAppliedKeyValid = true;
+
+	RDP_OtherMode other_mode;
+	other_mode._u64 = key.OtherMode;
+
+	if ( key.DisableZBuffer )
 	{
 		glDisable(GL_DEPTH_TEST);
 		glDepthMask(GL_FALSE);
@@ -885,7 +1424,7 @@ void RendererGL::PrepareRenderState(const float (&mat_project)[16], bool disable
 	else
 	{
 		// Decal mode
-		if( gRDPOtherMode.zmode == 3 )
+		if( other_mode.zmode == 3 )
 		{
 			glPolygonOffset(-1.0, -1.0);
 		}
@@ -895,7 +1434,7 @@ void RendererGL::PrepareRenderState(const float (&mat_project)[16], bool disable
 		}
 
 		// Enable or Disable ZBuffer test
-		if ( (mTnL.Flags.Zbuffer & gRDPOtherMode.z_cmp) | gRDPOtherMode.z_upd )
+		if ( (key.TnLZBuffer & other_mode.z_cmp) | other_mode.z_upd )
 		{
 			glEnable(GL_DEPTH_TEST);
 		}
@@ -904,16 +1443,16 @@ void RendererGL::PrepareRenderState(const float (&mat_project)[16], bool disable
 			glDisable(GL_DEPTH_TEST);
 		}
 
-		glDepthMask(gRDPOtherMode.z_upd ? GL_TRUE : GL_FALSE);
+		glDepthMask(other_mode.z_upd ? GL_TRUE : GL_FALSE);
 	}
 
 
-	u32 cycle_mode = gRDPOtherMode.cycle_type;
+	u32 cycle_mode = other_mode.cycle_type;
 
 	// Initiate Blender
-	if(cycle_mode < CYCLE_COPY && gRDPOtherMode.force_bl)
+	if(cycle_mode < CYCLE_COPY && other_mode.force_bl)
 	{
-		InitBlenderMode();
+		InitBlenderMode(other_mode);
 	}
 	else
 	{
@@ -921,23 +1460,29 @@ void RendererGL::PrepareRenderState(const float (&mat_project)[16], bool disable
 	}
 
 	ShaderConfiguration config;
-	MakeShaderConfigFromCurrentState(&config);
+	MakeShaderConfig(key, &config);
 
 	const ShaderProgram * program = GetShaderForConfig(config);
 	if (program == NULL)
 	{
 		// There must have been some failure to compile the shader. Abort!
 		DBGConsole_Msg(0, "Couldn't generate a shader for mux %llx, cycle %d, alpha %d\n", config.Mux, config.CycleType, config.AlphaThreshold);
+		gAppliedKeyValid = false;
 		return;
 	}
 
 	glUseProgram(program->program);
 
-	glUniformMatrix4fv(program->uloc_project, 1, GL_FALSE, mat_project);
+	glUniformMatrix4fv(program->uloc_project, 1, GL_FALSE, key.Project);
+
+	const c32 prim_colour(key.PrimColour);
+	const c32 env_colour(key.EnvColour);
 
-	glUniform4f(program->uloc_primcol, mPrimitiveColour.GetRf(), mPrimitiveColour.GetGf(), mPrimitiveColour.GetBf(), mPrimitiveColour.GetAf());
-	glUniform4f(program->uloc_envcol,  mEnvColour.GetRf(),       mEnvColour.GetGf(),       mEnvColour.GetBf(),       mEnvColour.GetAf());
-	glUniform1f(program->uloc_primlodfrac, mPrimLODFraction);
+	glUniform4f(program->uloc_primcol, prim_colour.GetRf(), prim_colour.GetGf(), prim_colour.GetBf(), prim_colour.GetAf());
+	glUniform4f(program->uloc_envcol,  env_colour.GetRf(),  env_colour.GetGf(),  env_colour.GetBf(),  env_colour.GetAf());
+	glUniform1f(program->uloc_primlodfrac, key.PrimLODFraction);
+	glUniform2f(program->uloc_uvscale,  key.UVScale[0],  key.UVScale[1]);
+	glUniform2f(program->uloc_uvoffset, key.UVOffset[0], key.UVOffset[1]);
 
 	// Second texture is sampled in 2 cycle mode if text_lod is clear (when set,
 	// gRDPOtherMode.text_lod enables mipmapping, but we just set lod_frac to 0.
@@ -945,15 +1490,14 @@ void RendererGL::PrepareRenderState(const float (&mat_project)[16], bool disable
 
 	bool install_textures[] = { true, use_t1 };
 
-extern u32 gRDPFrame;
-	glUniform1i(program->uloc_foo, gRDPFrame);
+	glUniform1i(program->uloc_foo, key.Frame);
 
 	for (u32 i = 0; i < kNumTextures; ++i)
 	{
 		if (!install_textures[i])
 			continue;
 
-		CNativeTexture * texture = mBoundTexture[i];
+		const CNativeTexture * texture = key.Texture[i];
 
 		if (texture != NULL)
 		{
@@ -961,9 +1505,13 @@ extern u32 gRDPFrame;
 
 			texture->InstallTexture();
 
-			u8 tile_idx = mActiveTile[i];
-			const RDP_Tile &     rdp_tile  = gRDPStateManager.GetTile( tile_idx );
-			const RDP_TileSize & tile_size = gRDPStateManager.GetTileSize( tile_idx );
+			RDP_Tile rdp_tile;
+			rdp_tile.cmd0 = key.Tile[i][0];
+			rdp_tile.cmd1 = key.Tile[i][1];
+
+			RDP_TileSize tile_size;
+			tile_size.cmd0 = key.TileSize[i][0];
+			tile_size.cmd1 = key.TileSize[i][1];
 
 			// NB: think this can be done just once per program.
 			glUniform1i(program->uloc_texture[i], i);
@@ -983,12 +1531,12 @@ extern u32 gRDPFrame;
 			glUniform2i(program->uloc_tilemask[i],   mask_bits_s,   mask_bits_t);
 			glUniform2i(program->uloc_tilemirror[i], mirror_bits_s, mirror_bits_t);
 
-			glUniform2i(program->uloc_tiletl[i], mTileTopLeft[i].s, mTileTopLeft[i].t);
-			glUniform2i(program->uloc_tilebr[i], tile_size.right,   tile_size.bottom);
+			glUniform2i(program->uloc_tiletl[i], key.TileTopLeft[i][0], key.TileTopLeft[i][1]);
+			glUniform2i(program->uloc_tilebr[i], tile_size.right,       tile_size.bottom);
 
 			glUniform2f(program->uloc_texscale[i], 1.f / texture->GetCorrectedWidth(), 1.f / texture->GetCorrectedHeight());
 
-			if( (gRDPOtherMode.text_filt != G_TF_POINT) | (gGlobalPreferences.ForceLinearFilter) )
+			if( (other_mode.text_filt != G_TF_POINT) | (key.ForceLinearFilter) )
 			{
 				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -999,16 +1547,139 @@ extern u32 gRDPFrame;
 				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 			}
 
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, mTexWrap[i].u);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, mTexWrap[i].v);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, key.TexWrap[i][0]);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, key.TexWrap[i][1]);
 		}
 	}
+
+	if (key.Override2D)
+	{
+		glEnable(GL_BLEND);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+}
+
+struct DrawCommand
+{
+	RenderStateKey	Key;
+	GLenum			Prim;
+	u32				First;
+	u32				Count;
+};
+
+static void ExecuteDraw(const void * p_data)
+{
+	const DrawCommand * cmd = static_cast<const DrawCommand *>(p_data);
+
+	ApplyRenderState(cmd->Key);
+
+	u32 first = cmd->First;
+
+	// Recorded for the render thread, so the vertices are in the frame rather than the ring.
+	if (const DaedalusVtx * p_vertices = RenderThread_GetPlaybackVertices())
+	{
+		DAEDALUS_ASSERT(cmd->Count <= kVerticesPerSection, "Draw doesn't fit in a vertex section");
+
+		if (gNextVertex + cmd->Count > (gVertexSection + 1) * kVerticesPerSection)
+		{
+			NextVertexSection();
+		}
+
+		memcpy(&gVertices[gNextVertex], &p_vertices[cmd->First], cmd->Count * sizeof(DaedalusVtx));
+		first = gNextVertex;
+		gNextVertex += cmd->Count;
+	}
+
+	DrawVertices(cmd->Prim, first, cmd->Count);
+}
+
+static void SubmitDraw(const RenderStateKey & key, GLenum prim, u32 first, u32 count)
+{
+	DrawCommand cmd;
+	cmd.Key   = key;
+	cmd.Prim  = prim;
+	cmd.First = first;
+	cmd.Count = count;
+
+	RenderThread_Submit(ExecuteDraw, &cmd, sizeof(cmd));
+}
+
+static void FlushPendingDraw()
+{
+	if (gPendingCount > 0)
+	{
+		SubmitDraw(gPendingKey, GL_TRIANGLES, gPendingFirst, gPendingCount);
+		gPendingCount = 0;
+	}
+}
+
+// The render thread's draws refer to textures by pointer, so they need holding on to until it's done.
+// This is done as soon as a key is made, so a texture can't go while a draw using it is pending.
+static void KeepTexturesAlive(const RenderStateKey & key)
+{
+	if (!RenderThread_IsRunning())
+		return;
+
+	for (u32 i = 0; i < kNumTextures; ++i)
+	{
+		if (key.Texture[i] != NULL)
+		{
+			RenderThread_KeepAlive(key.Texture[i]);
+		}
+	}
+}
+
+// Draws a triangle list. Vertices must have come from the last call to AllocVertices.
+void RendererGL::RenderDaedalusVtx(const RenderStateKey & key, const DaedalusVtx * vertices, u32 count)
+{
+	const u32 key_hash = murmur2_hash(&key, sizeof(key), 0);
+	const u32 first    = CommitVertices(vertices, count);
+
+	if (gPendingCount > 0 && key_hash == gPendingKeyHash &&
+		first == gPendingFirst + gPendingCount &&
+		gPendingCount + count <= kVerticesPerSection &&
+		memcmp(&key, &gPendingKey, sizeof(key)) == 0)
+	{
+		gPendingCount += count;
+	}
+	else
+	{
+		FlushPendingDraw();
+		KeepTexturesAlive(key);
+
+		gPendingKey     = key;
+		gPendingKeyHash = key_hash;
+		gPendingFirst   = first;
+		gPendingCount   = count;
+	}
+}
+
+// Rects are drawn as two triangles so they can be merged like everything else.
+// The corners are in triangle strip order.
+static void WriteQuad(DaedalusVtx * p_vertices, const DaedalusVtx & v0, const DaedalusVtx & v1, const DaedalusVtx & v2, const DaedalusVtx & v3)
+{
+	p_vertices[0] = v0;
+	p_vertices[1] = v1;
+	p_vertices[2] = v2;
+	p_vertices[3] = v2;
+	p_vertices[4] = v1;
+	p_vertices[5] = v3;
 }
 
 // FIXME(strmnnrmn): for fill/copy modes this does more work than needed.
 // It ends up copying colour/uv coords when not needed, and can use a shader uniform for the fill colour.
 void RendererGL::RenderTriangles( DaedalusVtx * p_vertices, u32 num_vertices, bool disable_zbuffer )
 {
+	// Hack to fix the sun in Zelda OOT/MM
+	const f32 scale = ( g_ROM.ZELDA_HACK &&(gRDPOtherMode.L == 0x0c184241) ) ? 16.f : 32.f;
+
+	// NB: the vertices live in write-combined memory, so the texgen adjustment is applied by the vertex shader.
+	v2 uv_scale( scale, scale );
+	v2 uv_offset( 0.f, 0.f );
+
 	if (mTnL.Flags.Texture)
 	{
 		UpdateTileSnapshots( mTextureTile );
@@ -1026,17 +1697,61 @@ void RendererGL::RenderTriangles( DaedalusVtx * p_vertices, u32 num_vertices, bo
 				float y = (float)mTileTopLeft[0].t / 4.f;
 				float w = (float)texture->GetCorrectedWidth();
 				float h = (float)texture->GetCorrectedHeight();
-				for (u32 i = 0; i < num_vertices; ++i)
-				{
-					p_vertices[i].Texture.x = (p_vertices[i].Texture.x * w) + x;
-					p_vertices[i].Texture.y = (p_vertices[i].Texture.y * h) + y;
-				}
+
+				uv_scale  = v2( w * scale, h * scale );
+				uv_offset = v2( x * scale, y * scale );
 			}
 		}
 	}
 
-	PrepareRenderState(gProjection.m, disable_zbuffer);
-	RenderDaedalusVtx(GL_TRIANGLES, p_vertices, num_vertices);
+	RenderStateKey key;
+	MakeRenderStateKey(&key, gProjection.m, disable_zbuffer, uv_scale, uv_offset);
+
+	RenderDaedalusVtx(key, p_vertices, num_vertices);
+}
+
+// uv_scale and uv_offset take the vertices' texture coords to the 10.5 format the RDP works in.
+void RendererGL::MakeRenderStateKey(RenderStateKey * key, const float (&mat_project)[16], bool disable_zbuffer, const v2 & uv_scale, const v2 & uv_offset) const
+{
+	memset(key, 0, sizeof(RenderStateKey));
+
+	memcpy(key->Project, mat_project, sizeof(key->Project));
+	key->UVScale[0]         = uv_scale.x;
+	key->UVScale[1]         = uv_scale.y;
+	key->UVOffset[0]        = uv_offset.x;
+	key->UVOffset[1]        = uv_offset.y;
+	key->OtherMode          = gRDPOtherMode._u64;
+	key->Mux                = mMux;
+	key->PrimColour         = mPrimitiveColour.GetColour();
+	key->EnvColour          = mEnvColour.GetColour();
+	key->BlendColour        = mBlendColour.GetColour();
+	key->PrimLODFraction    = mPrimLODFraction;
+	key->DisableZBuffer     = disable_zbuffer;
+	key->TnLZBuffer         = mTnL.Flags.Zbuffer;
+	key->ForceLinearFilter  = gGlobalPreferences.ForceLinearFilter;
+	key->Frame              = gRDPFrame;
+
+	for (u32 i = 0; i < kNumTextures; ++i)
+	{
+		// NB: the shader configuration depends on the wrap modes whether or not there's a texture.
+		key->TexWrap[i][0]     = mTexWrap[i].u;
+		key->TexWrap[i][1]     = mTexWrap[i].v;
+
+		CNativeTexture * texture = mBoundTexture[i];
+		if (texture == NULL)
+			continue;
+
+		const RDP_Tile &     rdp_tile  = gRDPStateManager.GetTile( mActiveTile[i] );
+		const RDP_TileSize & tile_size = gRDPStateManager.GetTileSize( mActiveTile[i] );
+
+		key->Texture[i]        = texture;
+		key->Tile[i][0]        = rdp_tile.cmd0;
+		key->Tile[i][1]        = rdp_tile.cmd1;
+		key->TileSize[i][0]    = tile_size.cmd0;
+		key->TileSize[i][1]    = tile_size.cmd1;
+		key->TileTopLeft[i][0] = mTileTopLeft[i].s;
+		key->TileTopLeft[i][1] = mTileTopLeft[i].t;
+	}
 }
 
 void RendererGL::TexRect( u32 tile_idx, const v2 & xy0, const v2 & xy1, TexCoord st0, TexCoord st1 )
@@ -1046,10 +1761,12 @@ void RendererGL::TexRect( u32 tile_idx, const v2 & xy0, const v2 & xy1, TexCoord
 	UpdateTileSnapshots( tile_idx );
 
 	// NB: we have to do this after UpdateTileSnapshot, as it set up mTileTopLeft etc.
-	// We have to do it before PrepareRenderState, because those values are applied to the graphics state.
+	// We have to do it before MakeRenderStateKey, because those values are applied to the graphics state.
 	PrepareTexRectUVs(&st0, &st1);
 
-	PrepareRenderState(mScreenToDevice.mRaw, gRDPOtherMode.depth_source ? false : true);
+	// st0/st1 are already in 10.5 format.
+	RenderStateKey key;
+	MakeRenderStateKey(&key, mScreenToDevice.mRaw, gRDPOtherMode.depth_source ? false : true, v2( 1.f, 1.f ), v2( 0.f, 0.f ));
 
 	v2 screen0;
 	v2 screen1;
@@ -1061,28 +1778,13 @@ void RendererGL::TexRect( u32 tile_idx, const v2 & xy0, const v2 & xy1, TexCoord
 
 	const f32 depth = gRDPOtherMode.depth_source ? mPrimDepth : 0.0f;
 
-	float positions[] = {
-		screen0.x, screen0.y, depth,
-		screen1.x, screen0.y, depth,
-		screen0.x, screen1.y, depth,
-		screen1.x, screen1.y, depth,
-	};
-
-	TexCoord uvs[] = {
-		TexCoord( st0.s, st0.t ),
-		TexCoord( st1.s, st0.t ),
-		TexCoord( st0.s, st1.t ),
-		TexCoord( st1.s, st1.t ),
-	};
-
-	u32 colours[] = {
-		0xffffffff,
-		0xffffffff,
-		0xffffffff,
-		0xffffffff,
-	};
-
-	RenderDaedalusVtxStreams(GL_TRIANGLE_STRIP, positions, uvs, colours, 4);
+	DaedalusVtx * p_vertices = AllocVertices(6);
+	WriteQuad(p_vertices,
+			  DaedalusVtx( v3( screen0.x, screen0.y, depth ), 0xffffffff, v2( st0.s, st0.t ) ),
+			  DaedalusVtx( v3( screen1.x, screen0.y, depth ), 0xffffffff, v2( st1.s, st0.t ) ),
+			  DaedalusVtx( v3( screen0.x, screen1.y, depth ), 0xffffffff, v2( st0.s, st1.t ) ),
+			  DaedalusVtx( v3( screen1.x, screen1.y, depth ), 0xffffffff, v2( st1.s, st1.t ) ));
+	RenderDaedalusVtx(key, p_vertices, 6);
 
 #ifdef DAEDALUS_DEBUG_DISPLAYLIST
 	++mNumRect;
@@ -1094,10 +1796,12 @@ void RendererGL::TexRectFlip( u32 tile_idx, const v2 & xy0, const v2 & xy1, TexC
 	UpdateTileSnapshots( tile_idx );
 
 	// NB: we have to do this after UpdateTileSnapshot, as it set up mTileTopLeft etc.
-	// We have to do it before PrepareRenderState, because those values are applied to the graphics state.
+	// We have to do it before MakeRenderStateKey, because those values are applied to the graphics state.
 	PrepareTexRectUVs(&st0, &st1);
 
-	PrepareRenderState(mScreenToDevice.mRaw, gRDPOtherMode.depth_source ? false : true);
+	// st0/st1 are already in 10.5 format.
+	RenderStateKey key;
+	MakeRenderStateKey(&key, mScreenToDevice.mRaw, gRDPOtherMode.depth_source ? false : true, v2( 1.f, 1.f ), v2( 0.f, 0.f ));
 
 	v2 screen0;
 	v2 screen1;
@@ -1109,28 +1813,13 @@ void RendererGL::TexRectFlip( u32 tile_idx, const v2 & xy0, const v2 & xy1, TexC
 
 	const f32 depth = gRDPOtherMode.depth_source ? mPrimDepth : 0.0f;
 
-	float positions[] = {
-		screen0.x, screen0.y, depth,
-		screen1.x, screen0.y, depth,
-		screen0.x, screen1.y, depth,
-		screen1.x, screen1.y, depth,
-	};
-
-	TexCoord uvs[] = {
-		TexCoord( st0.s, st0.t ),
-		TexCoord( st0.s, st1.t ),
-		TexCoord( st1.s, st0.t ),
-		TexCoord( st1.s, st1.t ),
-	};
-
-	u32 colours[] = {
-		0xffffffff,
-		0xffffffff,
-		0xffffffff,
-		0xffffffff,
-	};
-
-	RenderDaedalusVtxStreams(GL_TRIANGLE_STRIP, positions, uvs, colours, 4);
+	DaedalusVtx * p_vertices = AllocVertices(6);
+	WriteQuad(p_vertices,
+			  DaedalusVtx( v3( screen0.x, screen0.y, depth ), 0xffffffff, v2( st0.s, st0.t ) ),
+			  DaedalusVtx( v3( screen1.x, screen0.y, depth ), 0xffffffff, v2( st0.s, st1.t ) ),
+			  DaedalusVtx( v3( screen0.x, screen1.y, depth ), 0xffffffff, v2( st1.s, st0.t ) ),
+			  DaedalusVtx( v3( screen1.x, screen1.y, depth ), 0xffffffff, v2( st1.s, st1.t ) ));
+	RenderDaedalusVtx(key, p_vertices, 6);
 
 #ifdef DAEDALUS_DEBUG_DISPLAYLIST
 	++mNumRect;
@@ -1139,7 +1828,8 @@ void RendererGL::TexRectFlip( u32 tile_idx, const v2 & xy0, const v2 & xy1, TexC
 
 void RendererGL::FillRect( const v2 & xy0, const v2 & xy1, u32 color )
 {
-	PrepareRenderState(mScreenToDevice.mRaw, gRDPOtherMode.depth_source ? false : true);
+	RenderStateKey key;
+	MakeRenderStateKey(&key, mScreenToDevice.mRaw, gRDPOtherMode.depth_source ? false : true, v2( 32.f, 32.f ), v2( 0.f, 0.f ));
 
 	v2 screen0;
 	v2 screen1;
@@ -1150,29 +1840,15 @@ void RendererGL::FillRect( const v2 & xy0, const v2 & xy1, u32 color )
 
 	const f32 depth = gRDPOtherMode.depth_source ? mPrimDepth : 0.0f;
 
-	float positions[] = {
-		screen0.x, screen0.y, depth,
-		screen1.x, screen0.y, depth,
-		screen0.x, screen1.y, depth,
-		screen1.x, screen1.y, depth,
-	};
-
-	// NB - these aren't needed. Could just pass NULL to RenderDaedalusVtxStreams?
-	TexCoord uvs[] = {
-		TexCoord( 0.f, 0.f ),
-		TexCoord( 1.f, 0.f ),
-		TexCoord( 0.f, 1.f ),
-		TexCoord( 1.f, 1.f ),
-	};
+	// NB - the uvs aren't needed.
+	DaedalusVtx * p_vertices = AllocVertices(6);
+	WriteQuad(p_vertices,
+			  DaedalusVtx( v3( screen0.x, screen0.y, depth ), color, v2( 0.f, 0.f ) ),
+			  DaedalusVtx( v3( screen1.x, screen0.y, depth ), color, v2( 1.f, 0.f ) ),
+			  DaedalusVtx( v3( screen0.x, screen1.y, depth ), color, v2( 0.f, 1.f ) ),
+			  DaedalusVtx( v3( screen1.x, screen1.y, depth ), color, v2( 1.f, 1.f ) ));
 
-	u32 colours[] = {
-		color,
-		color,
-		color,
-		color,
-	};
-
-	RenderDaedalusVtxStreams(GL_TRIANGLE_STRIP, positions, uvs, colours, 4);
+	RenderDaedalusVtx(key, p_vertices, 6);
 
 #ifdef DAEDALUS_DEBUG_DISPLAYLIST
 	++mNumRect;
@@ -1188,13 +1864,9 @@ void RendererGL::Draw2DTexture(f32 x0, f32 y0, f32 x1, f32 y1,
 	// FIXME(strmnnrmn): is this right? Gross anyway.
 	gRDPOtherMode.cycle_type = CYCLE_COPY;
 
-	PrepareRenderState(mScreenToDevice.mRaw, false /* disable_depth */);
-
-	glEnable(GL_BLEND);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	RenderStateKey key;
+	MakeRenderStateKey(&key, mScreenToDevice.mRaw, false /* disable_depth */, v2( 32.f, 32.f ), v2( 0.f, 0.f ));
+	key.Override2D = true;
 
 	float sx0 = N64ToScreenX(x0);
 	float sy0 = N64ToScreenY(y0);
@@ -1204,28 +1876,14 @@ void RendererGL::Draw2DTexture(f32 x0, f32 y0, f32 x1, f32 y1,
 
 	const f32 depth = 0.0f;
 
-	float positions[] = {
-		sx0, sy0, depth,
-		sx1, sy0, depth,
-		sx0, sy1, depth,
-		sx1, sy1, depth,
-	};
-
-	TexCoord uvs[] = {
-		TexCoord( u0, v0 ),
-		TexCoord( u1, v0 ),
-		TexCoord( u0, v1 ),
-		TexCoord( u1, v1 ),
-	};
+	DaedalusVtx * p_vertices = AllocVertices(6);
+	WriteQuad(p_vertices,
+			  DaedalusVtx( v3( sx0, sy0, depth ), 0xffffffff, v2( u0, v0 ) ),
+			  DaedalusVtx( v3( sx1, sy0, depth ), 0xffffffff, v2( u1, v0 ) ),
+			  DaedalusVtx( v3( sx0, sy1, depth ), 0xffffffff, v2( u0, v1 ) ),
+			  DaedalusVtx( v3( sx1, sy1, depth ), 0xffffffff, v2( u1, v1 ) ));
 
-	u32 colours[] = {
-		0xffffffff,
-		0xffffffff,
-		0xffffffff,
-		0xffffffff,
-	};
-
-	RenderDaedalusVtxStreams(GL_TRIANGLE_STRIP, positions, uvs, colours, 4);
+	RenderDaedalusVtx(key, p_vertices, 6);
 }
 
 void RendererGL::Draw2DTextureR(f32 x0, f32 y0,
@@ -1239,38 +1897,21 @@ void RendererGL::Draw2DTextureR(f32 x0, f32 y0,
 	// FIXME(strmnnrmn): is this right? Gross anyway.
 	gRDPOtherMode.cycle_type = CYCLE_COPY;
 
-	PrepareRenderState(mScreenToDevice.mRaw, false /* disable_depth */);
-
-	glEnable(GL_BLEND);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	RenderStateKey key;
+	MakeRenderStateKey(&key, mScreenToDevice.mRaw, false /* disable_depth */, v2( 32.f, 32.f ), v2( 0.f, 0.f ));
+	key.Override2D = true;
 
 	const f32 depth = 0.0f;
 
-	float positions[] = {
-		N64ToScreenX(x0), N64ToScreenY(y0), depth,
-		N64ToScreenX(x1), N64ToScreenY(y1), depth,
-		N64ToScreenX(x2), N64ToScreenY(y2), depth,
-		N64ToScreenX(x3), N64ToScreenY(y3), depth,
-	};
-
-	TexCoord uvs[] = {
-		TexCoord( 0.f, 0.f ),
-		TexCoord(   s, 0.f ),
-		TexCoord(   s,   t ),
-		TexCoord( 0.f,   t ),
-	};
-
-	u32 colours[] = {
-		0xffffffff,
-		0xffffffff,
-		0xffffffff,
-		0xffffffff,
-	};
+	// The corners go round the quad, so the last two swap to make a strip.
+	DaedalusVtx * p_vertices = AllocVertices(6);
+	WriteQuad(p_vertices,
+			  DaedalusVtx( v3( N64ToScreenX(x0), N64ToScreenY(y0), depth ), 0xffffffff, v2( 0.f, 0.f ) ),
+			  DaedalusVtx( v3( N64ToScreenX(x1), N64ToScreenY(y1), depth ), 0xffffffff, v2(   s, 0.f ) ),
+			  DaedalusVtx( v3( N64ToScreenX(x3), N64ToScreenY(y3), depth ), 0xffffffff, v2( 0.f,   t ) ),
+			  DaedalusVtx( v3( N64ToScreenX(x2), N64ToScreenY(y2), depth ), 0xffffffff, v2(   s,   t ) ));
 
-	RenderDaedalusVtxStreams(GL_TRIANGLE_FAN, positions, uvs, colours, 4);
+	RenderDaedalusVtx(key, p_vertices, 6);
 }
 
 bool CreateRenderer()
@@ -1278,10 +1919,14 @@ bool CreateRenderer()
 	DAEDALUS_ASSERT_Q(gRenderer == NULL);
 	gRendererGL = new RendererGL();
 	gRenderer   = gRendererGL;
+
+	LoadShaderCache();
 	return true;
 }
 void DestroyRenderer()
 {
+	SaveShaderCache();
+
 	delete gRendererGL;
 	gRendererGL = NULL;
 	gRenderer   = NULL;
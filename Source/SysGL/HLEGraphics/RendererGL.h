@@ -8,6 +8,10 @@ class RendererGL : public BaseRenderer
 public:
 	virtual void		RestoreRenderStates();
 
+	virtual DaedalusVtx *	AllocVertices(u32 num_vertices);
+	virtual void		FlushDraws();
+	virtual void		SetGLViewport(s32 x, s32 y, s32 w, s32 h);
+	virtual void		SetGLScissor(s32 x, s32 y, s32 w, s32 h);
 	virtual void		RenderTriangles(DaedalusVtx * p_vertices, u32 num_vertices, bool disable_zbuffer);
 
 	virtual void		TexRect(u32 tile_idx, const v2 & xy0, const v2 & xy1, TexCoord st0, TexCoord st1);
@@ -20,13 +24,20 @@ public:
 									   f32 x2, f32 y2, f32 x3, f32 y3,
 									   f32 s, f32 t);
 
-private:
-	void 				MakeShaderConfigFromCurrentState(struct ShaderConfiguration * config) const;
+	// Call on the render thread after touching GL state outside of a draw, so the next draw applies all of it.
+	static void			InvalidateRenderState();
+
+	// Counts for the last complete frame.
+	u32					GetNumDrawCalls() const;
+	u32					GetNumStateChanges() const;
 
-	void 				PrepareRenderState(const float (&mat_project)[16], bool disable_zbuffer);
+	// Shaders which had to be compiled mid-game since the rom started.
+	u32					GetNumShaderHitches() const;
+
+private:
+	void 				MakeRenderStateKey(struct RenderStateKey * key, const float (&mat_project)[16], bool disable_zbuffer, const v2 & uv_scale, const v2 & uv_offset) const;
 
-	void 				RenderDaedalusVtx(int prim, const DaedalusVtx * vertices, int count);
-	void 				RenderDaedalusVtxStreams(int prim, const float * positions, const TexCoord * uvs, const u32 * colours, int count);
+	void 				RenderDaedalusVtx(const struct RenderStateKey & key, const DaedalusVtx * vertices, u32 count);
 };
 
 // NB: this is equivalent to gRenderer, but points to the implementation class, for platform-specific functionality.
@@ -5,6 +5,7 @@
 
 #include "Core/CPU.h"
 #include "Core/ROM.h"
+#include "HLEGraphics/DLCapture.h"
 
 #include "SysGL/GL.h"
 #include "System/Paths.h"
@@ -15,6 +16,12 @@
 
 static void HandleKeys(GLFWwindow * window, int key, int scancode, int action, int mods)
 {
+	// Holding backspace keeps stepping back through the rewind snapshots
+	if (key == GLFW_KEY_BACKSPACE && action != GLFW_RELEASE)
+	{
+		CPU_RequestRewind();
+	}
+
 	if (action == GLFW_PRESS)
 	{
 		if (key >= '0' && key <= '9')
@@ -102,6 +109,12 @@ static void HandleKeys(GLFWwindow * window, int key, int scancode, int action, i
 			}
 		}
 #endif
+		// F9 captures the next display list for dlreplay, shift+F9 the next 10
+		if (key == GLFW_KEY_F9)
+		{
+			DLCapture_Request((mods & GLFW_MOD_SHIFT) ? 10 : 1);
+		}
+
 		if (key == GLFW_KEY_ESCAPE)
 		{
 			glfwSetWindowShouldClose(window, GL_TRUE);
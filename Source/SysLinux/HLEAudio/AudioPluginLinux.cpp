@@ -1,10 +1,314 @@
+/*
+Copyright (C) 2003 Azimer
+Copyright (C) 2012 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+//
+//	Based on the OSX plugin. The ABI is processed on the emulation thread and
+//	the resampled output is queued in a lock-free CAudioBuffer, which SDL's
+//	audio thread drains. Neither side ever waits on the other.
+//
+
 #include "stdafx.h"
 #include "Plugins/AudioPlugin.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+
+#include <SDL2/SDL.h>
+
 #include "Config/ConfigOptions.h"
+#include "Core/Memory.h"
+#include "Debug/DBGConsole.h"
+#include "HLEAudio/AudioBuffer.h"
+#include "HLEAudio/AudioHLETask.h"
+#include "HLEAudio/audiohle.h"
+#include "Utility/FramerateLimiter.h"
+#include "Utility/Thread.h"
+#include "Utility/Timing.h"
+
+EAudioPluginMode gAudioPluginEnabled = APM_ENABLED_SYNC;
+
+#define DEBUG_AUDIO  0
+
+#if DEBUG_AUDIO
+#define DPF_AUDIO(...)	do { printf(__VA_ARGS__); } while(0)
+#else
+#define DPF_AUDIO(...)	do { (void)sizeof(__VA_ARGS__); } while(0)
+#endif
+
+static const u32 kOutputFrequency = 44100;
+static const u32 kAudioBufferSize = 1024 * 1024;	// Circular buffer length. Converts N64 samples out our output rate.
+static const u32 kNumChannels = 2;
+
+// How much output we aim to keep queued ahead of the device. In sync mode the
+// framerate limiter sleeps whenever we get further ahead than this.
+// Setting this too low and we run the risk of skipping.
+// Setting this too high and we run the risk of being very laggy.
+static const u32 kLatencyTargetMs = 30;
+
+// In async mode nothing holds the emulation back, so rather than let the
+// latency grow without limit, whole buffers are dropped past this point.
+static const u32 kMaxAsyncBufferLengthMs = 4 * kLatencyTargetMs;
+
+// Samples SDL asks for in each callback (~23ms at 44.1KHz).
+static const u16 kDeviceBufferSamples = 1024;
+
+class AudioPluginLinux : public CAudioPlugin
+{
+public:
+	AudioPluginLinux();
+	virtual ~AudioPluginLinux();
+
+	virtual bool			StartEmulation();
+	virtual void			StopEmulation();
+
+	virtual void			DacrateChanged(int system_type);
+	virtual void			LenChanged();
+	virtual u32				ReadLength()			{ return 0; }
+	virtual EProcessResult	ProcessAList();
+
+	void					AddBuffer(void * ptr, u32 length);	// Uploads a new buffer and returns status
+
+	void					StopAudio();						// Stops the Audio PlayBack (as if paused)
+	void					StartAudio();						// Starts the Audio PlayBack (as if unpaused)
+
+	static void				AudioSyncFunction(void * arg);
+	static void				AudioCallback(void * arg, Uint8 * stream, int len);
+
+private:
+	u32						GetBufferLengthMs() const	{ return (1000 * mAudioBuffer.GetNumBufferedSamples()) / kOutputFrequency; }
+
+private:
+	CAudioBuffer			mAudioBuffer;
+	u32						mFrequency;
+	SDL_AudioDeviceID		mDevice;
+
+	std::atomic<u32>		mNumUnderruns;	// Callbacks which ran out of samples. Written by SDL's thread.
+	u32						mNumOverruns;	// Buffers which were dropped or didn't fit
+};
+
+AudioPluginLinux::AudioPluginLinux()
+:	mAudioBuffer( kAudioBufferSize )
+,	mFrequency( 44100 )
+,	mDevice( 0 )
+,	mNumUnderruns( 0 )
+,	mNumOverruns( 0 )
+{
+}
+
+AudioPluginLinux::~AudioPluginLinux()
+{
+	StopAudio();
+}
+
+bool AudioPluginLinux::StartEmulation()
+{
+	return true;
+}
+
+void AudioPluginLinux::StopEmulation()
+{
+	AudioHLETask_Flush();
+	Audio_Reset();
+	StopAudio();
+}
+
+void AudioPluginLinux::DacrateChanged(int system_type)
+{
+	u32 clock      = (system_type == ST_NTSC) ? VI_NTSC_CLOCK : VI_PAL_CLOCK;
+	u32 dacrate   = Memory_AI_GetRegister(AI_DACRATE_REG);
+	u32	frequency = clock / (dacrate + 1);
+
+	DBGConsole_Msg(0, "Audio frequency: %d", frequency);
+	mFrequency = frequency;
+}
 
-EAudioPluginMode gAudioPluginEnabled = APM_DISABLED;
+void AudioPluginLinux::LenChanged()
+{
+	if (gAudioPluginEnabled > APM_DISABLED)
+	{
+		u32	address = Memory_AI_GetRegister(AI_DRAM_ADDR_REG) & 0xFFFFFF;
+		u32	length  = Memory_AI_GetRegister(AI_LEN_REG);
+
+		AddBuffer( g_pu8RamBase + address, length );
+	}
+	else
+	{
+		StopAudio();
+	}
+}
+
+EProcessResult AudioPluginLinux::ProcessAList()
+{
+	// In async mode the SP stays busy until the task completes (see HLEAudio/AudioHLETask.cpp)
+	if (gAudioPluginEnabled != APM_ENABLED_ASYNC)
+		Memory_SP_SetRegisterBits(SP_STATUS_REG, SP_STATUS_HALT);
+
+	EProcessResult result = PR_NOT_STARTED;
+
+	switch (gAudioPluginEnabled)
+	{
+		case APM_DISABLED:
+			result = PR_COMPLETED;
+			break;
+		// The ABI runs on a worker thread while the CPU carries on, and the output doesn't pace the emulation
+		case APM_ENABLED_ASYNC:
+			result = AudioHLETask_Start();
+			break;
+		case APM_ENABLED_SYNC:
+			Audio_Ucode();
+			result = PR_COMPLETED;
+			break;
+	}
+
+	return result;
+}
+
+void AudioPluginLinux::AddBuffer(void * ptr, u32 length)
+{
+	if (length == 0)
+		return;
+
+	u32 num_samples = length / sizeof( Sample );
+
+	if (gAudioPluginEnabled == APM_ENABLED_ASYNC && GetBufferLengthMs() > kMaxAsyncBufferLengthMs)
+	{
+		DPF_AUDIO("Dropping %d samples - bufferlen %d\n", num_samples, GetBufferLengthMs());
+		mNumOverruns++;
+		return;
+	}
+
+	mAudioBuffer.AddSamples( reinterpret_cast<const Sample *>(ptr), num_samples, mFrequency, kOutputFrequency );
+
+	// CAudioBuffer drops whatever doesn't fit rather than wait for the device
+	u32 remaining_samples = mAudioBuffer.GetNumBufferedSamples();
+	if (remaining_samples + 1 >= kAudioBufferSize)
+	{
+		mNumOverruns++;
+	}
+
+	// Don't open the device until there's something to play
+	if (mDevice == 0)
+		StartAudio();
+
+	float ms = (float)num_samples * 1000.f / (float)mFrequency;
+	DPF_AUDIO("Queuing %d samples @%dHz - %.2fms - bufferlen now %d\n",
+		num_samples, mFrequency, ms, (1000 * remaining_samples) / kOutputFrequency);
+}
+
+void AudioPluginLinux::AudioCallback(void * arg, Uint8 * stream, int len)
+{
+	AudioPluginLinux * plugin = static_cast<AudioPluginLinux *>(arg);
+
+	u32 num_samples     = len / sizeof(Sample);
+	u32 samples_written = plugin->mAudioBuffer.Drain(reinterpret_cast<Sample *>(stream), num_samples);
+
+	// Drain fills the rest with silence
+	if (samples_written < num_samples)
+	{
+		plugin->mNumUnderruns.fetch_add(1, std::memory_order_relaxed);
+		DPF_AUDIO("********************* Audio buffer is empty ***********************\n");
+	}
+}
+
+void AudioPluginLinux::AudioSyncFunction(void * arg)
+{
+	AudioPluginLinux * plugin = static_cast<AudioPluginLinux *>(arg);
+#if DEBUG_AUDIO
+	static u64 last_time = 0;
+	u64 now;
+	NTiming::GetPreciseTime(&now);
+	if (last_time == 0) last_time = now;
+	DPF_AUDIO("VBL: %dms elapsed. Audio buffer len %dms\n", (s32)NTiming::ToMilliseconds(now-last_time), plugin->GetBufferLengthMs());
+	last_time = now;
+#endif
+
+	if (gAudioPluginEnabled != APM_ENABLED_SYNC)
+		return;
+
+	u32 buffer_len = plugin->GetBufferLengthMs();
+	if (buffer_len > kLatencyTargetMs)
+	{
+		ThreadSleepMs(buffer_len - kLatencyTargetMs);
+	}
+}
+
+void AudioPluginLinux::StartAudio()
+{
+	if (mDevice != 0)
+		return;
+
+	if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0)
+	{
+		DBGConsole_Msg(0, "Failed to initialise SDL audio: %s", SDL_GetError());
+		gAudioPluginEnabled = APM_DISABLED;
+		return;
+	}
+
+	SDL_AudioSpec want;
+	SDL_AudioSpec have;
+	memset(&want, 0, sizeof(want));
+	want.freq     = kOutputFrequency;
+	want.format   = AUDIO_S16SYS;
+	want.channels = kNumChannels;
+	want.samples  = kDeviceBufferSamples;
+	want.callback = &AudioCallback;
+	want.userdata = this;
+
+	// No allowed changes - SDL converts if the device wants something else
+	mDevice = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
+	if (mDevice == 0)
+	{
+		DBGConsole_Msg(0, "Failed to open the audio device: %s", SDL_GetError());
+		SDL_QuitSubSystem(SDL_INIT_AUDIO);
+		gAudioPluginEnabled = APM_DISABLED;
+		return;
+	}
+
+	mNumUnderruns = 0;
+	mNumOverruns = 0;
+
+	// Install the sync function.
+	FramerateLimiter_SetAuxillarySyncFunction(&AudioSyncFunction, this);
+
+	SDL_PauseAudioDevice(mDevice, 0);
+}
+
+void AudioPluginLinux::StopAudio()
+{
+	if (mDevice == 0)
+		return;
+
+	// Waits for any callback in progress to finish
+	SDL_CloseAudioDevice(mDevice);
+	SDL_QuitSubSystem(SDL_INIT_AUDIO);
+	mDevice = 0;
+
+	// Remove the sync function.
+	FramerateLimiter_SetAuxillarySyncFunction(NULL, NULL);
+
+	DBGConsole_Msg(0, "Audio stopped: %d underruns, %d overruns", mNumUnderruns.load(), mNumOverruns);
+}
 
 CAudioPlugin * CreateAudioPlugin()
 {
-	return NULL;
+	return new AudioPluginLinux();
 }
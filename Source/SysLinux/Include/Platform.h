@@ -38,8 +38,27 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define DAEDALUS_ATTRIBUTE_NOINLINE __attribute__((noinline))
 #endif
 
+// Clang only
+#ifndef __has_feature
+#define __has_feature(x) 0
+#endif
+
 #define DAEDALUS_HALT			__builtin_trap()
 //#define DAEDALUS_HALT			__builtin_debugger()
 #define DAEDALUS_GL
 
+// The dynarec only has a 64 bit intel backend on Linux (SysPosix/DynaRec/x64). It's opt in
+// (cmake -DX64_DYNAREC=ON) until it's been run against the interpreter (daedalus --bench -compare).
+#if defined(__x86_64__) && defined(DAEDALUS_X64_DYNAREC)
+#define DAEDALUS_ENABLE_DYNAREC
+#endif
+
+// The x64 dynarec marks the RDRAM pages it stores to (see Core/DirtyPages.h)
+#define DAEDALUS_DYNAREC_MARKS_DIRTY_PAGES
+
+// Mirrors RDRAM into a reserved 4GB region (see Core/Fastmem.h). The fault handler decodes x86-64 instructions
+#if defined(__x86_64__)
+#define DAEDALUS_FASTMEM
+#endif
+
 #endif // SYSLINUX_INCLUDE_PLATFORM_H_
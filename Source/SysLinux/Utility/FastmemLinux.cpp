@@ -0,0 +1,326 @@
+/*
+Copyright (C) 2012 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#include "stdafx.h"
+#include "Core/Fastmem.h"
+
+#ifdef DAEDALUS_FASTMEM
+
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "Core/Memory.h"
+#include "Debug/DBGConsole.h"
+
+u8 *	gFastmemBase = NULL;
+
+namespace
+{
+
+const u64		FASTMEM_REGION_SIZE = 0x100000000ULL;		// The whole 32 bit address space
+const u32		RDRAM_MIRRORS[] = { 0x80000000, 0xA0000000 };
+
+int					gRamFD = -1;
+u8 *				gRamView = NULL;		// Outside the region, always fully mapped
+u32					gRamMappedSize = 0;
+struct sigaction	gPreviousAction;
+
+// ModRM register numbers to mcontext registers
+const int			REGISTER_MAP[ 16 ] =
+{
+	REG_RAX, REG_RCX, REG_RDX, REG_RBX, REG_RSP, REG_RBP, REG_RSI, REG_RDI,
+	REG_R8,  REG_R9,  REG_R10, REG_R11, REG_R12, REG_R13, REG_R14, REG_R15,
+};
+
+//*****************************************************************************
+//	Emulates the access that faulted, using the same paths as the lookup tables.
+//	Only the forms of mov generated by the Fastmem_ accessors are understood.
+//*****************************************************************************
+bool HandleFastmemFault( ucontext_t * p_context, u32 address )
+{
+	greg_t *	regs( p_context->uc_mcontext.gregs );
+	const u8 *	p( reinterpret_cast< const u8 * >( regs[ REG_RIP ] ) );
+
+	bool		operand_16( false );
+	u8			rex( 0 );
+
+	if( *p == 0x66 )
+	{
+		operand_16 = true;
+		++p;
+	}
+	if( ( *p & 0xf0 ) == 0x40 )
+	{
+		rex = *p++;
+	}
+
+	u8			opcode( *p++ );
+	u8			opcode2( 0 );
+	if( opcode == 0x0f )
+	{
+		opcode2 = *p++;
+	}
+
+	u8			modrm( *p++ );
+	u32			mod( modrm >> 6 );
+	u32			rm( modrm & 7 );
+	u32			reg( ( ( modrm >> 3 ) & 7 ) | ( ( rex & 0x4 ) << 1 ) );
+	bool		wide( ( rex & 0x8 ) != 0 );
+
+	if( mod == 3 )
+		return false;
+
+	// Skip the SIB byte and displacement to find the next instruction
+	if( rm == 4 )
+	{
+		u8	sib( *p++ );
+		if( mod == 0 && ( sib & 7 ) == 5 )
+			p += 4;
+	}
+	else if( mod == 0 && rm == 5 )
+	{
+		p += 4;
+	}
+	if( mod == 1 )		p += 1;
+	else if( mod == 2 )	p += 4;
+
+	u32			size( 0 );
+	bool		is_store( false );
+	bool		sign_extend( false );
+
+	if( opcode == 0x8b )					{ size = wide ? 8 : operand_16 ? 2 : 4; }
+	else if( opcode == 0x89 )				{ size = wide ? 8 : operand_16 ? 2 : 4; is_store = true; }
+	else if( opcode == 0x88 )				{ size = 1; is_store = true; }
+	else if( opcode == 0x63 && wide )		{ size = 4; sign_extend = true; }
+	else if( opcode == 0x0f )
+	{
+		switch( opcode2 )
+		{
+		case 0xb6:	size = 1; break;
+		case 0xb7:	size = 2; break;
+		case 0xbe:	size = 1; sign_extend = true; break;
+		case 0xbf:	size = 2; sign_extend = true; break;
+		default:	return false;
+		}
+	}
+	else
+	{
+		return false;
+	}
+
+	greg_t &	host_reg( regs[ REGISTER_MAP[ reg ] ] );
+
+	if( is_store )
+	{
+		u64		value( host_reg );
+
+		// Without a REX prefix, byte registers 4-7 are ah, ch, dh and bh
+		if( size == 1 && rex == 0 && reg >= 4 )
+		{
+			value = u64( regs[ REGISTER_MAP[ reg - 4 ] ] ) >> 8;
+		}
+
+		switch( size )
+		{
+		case 1:	*(u8 *)ReadAddress( address ) = u8( value );	break;
+		case 2:	*(u16 *)ReadAddress( address ) = u16( value );	break;
+		case 4:	WriteAddress( address, u32( value ) );			break;
+		case 8:	*(u64 *)ReadAddress( address ) = value;			break;
+		}
+	}
+	else
+	{
+		const void *	p_src( ReadAddress( address ) );
+		u64				value( 0 );
+
+		switch( size )
+		{
+		case 1:	value = sign_extend ? u64( s64( *(const s8 *)p_src ) )  : *(const u8 *)p_src;	break;
+		case 2:	value = sign_extend ? u64( s64( *(const s16 *)p_src ) ) : *(const u16 *)p_src;	break;
+		case 4:	value = sign_extend ? u64( s64( *(const s32 *)p_src ) ) : *(const u32 *)p_src;	break;
+		case 8:	value = *(const u64 *)p_src;													break;
+		}
+
+		if( opcode == 0x8b && operand_16 )
+		{
+			// Only the low word of the register is written
+			host_reg = greg_t( ( u64( host_reg ) & ~0xffffULL ) | ( value & 0xffff ) );
+		}
+		else if( wide || opcode == 0x63 )
+		{
+			host_reg = greg_t( value );
+		}
+		else
+		{
+			// 32 bit destinations clear the upper half
+			host_reg = greg_t( u32( value ) );
+		}
+	}
+
+	regs[ REG_RIP ] = greg_t( reinterpret_cast< uintptr_t >( p ) );
+	return true;
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void FastmemSignalHandler( int sig, siginfo_t * p_info, void * p_context )
+{
+	u8 *	fault_address( reinterpret_cast< u8 * >( p_info->si_addr ) );
+
+	if( gFastmemBase != NULL &&
+		fault_address >= gFastmemBase &&
+		u64( fault_address - gFastmemBase ) < FASTMEM_REGION_SIZE &&
+		HandleFastmemFault( reinterpret_cast< ucontext_t * >( p_context ), u32( fault_address - gFastmemBase ) ) )
+	{
+		return;
+	}
+
+	// Not ours - pass it on, or put the old handler back and let the access fault again
+	if( ( gPreviousAction.sa_flags & SA_SIGINFO ) && gPreviousAction.sa_sigaction != NULL )
+	{
+		gPreviousAction.sa_sigaction( sig, p_info, p_context );
+	}
+	else if( gPreviousAction.sa_handler != SIG_DFL && gPreviousAction.sa_handler != SIG_IGN )
+	{
+		gPreviousAction.sa_handler( sig );
+	}
+	else
+	{
+		sigaction( SIGSEGV, &gPreviousAction, NULL );
+	}
+}
+
+void Unmap()
+{
+	if( gFastmemBase != NULL )
+	{
+		munmap( gFastmemBase, FASTMEM_REGION_SIZE );
+		gFastmemBase = NULL;
+	}
+	if( gRamView != NULL )
+	{
+		munmap( gRamView, gRamMappedSize );
+		gRamView = NULL;
+	}
+	if( gRamFD >= 0 )
+	{
+		close( gRamFD );
+		gRamFD = -1;
+	}
+	gRamMappedSize = 0;
+}
+
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+u8 * Fastmem_Init( u32 ram_size )
+{
+	DAEDALUS_ASSERT( gFastmemBase == NULL, "Fastmem is already initialised" );
+
+	gRamFD = memfd_create( "daedalus-rdram", MFD_CLOEXEC );
+	if( gRamFD < 0 || ftruncate( gRamFD, ram_size ) != 0 )
+	{
+		Unmap();
+		return NULL;
+	}
+	gRamMappedSize = ram_size;
+
+	void *	view( mmap( NULL, ram_size, PROT_READ | PROT_WRITE, MAP_SHARED, gRamFD, 0 ) );
+	if( view == MAP_FAILED )
+	{
+		Unmap();
+		return NULL;
+	}
+	gRamView = reinterpret_cast< u8 * >( view );
+
+	void *	region( mmap( NULL, FASTMEM_REGION_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 ) );
+	if( region == MAP_FAILED )
+	{
+		Unmap();
+		return NULL;
+	}
+	gFastmemBase = reinterpret_cast< u8 * >( region );
+
+	for( u32 i = 0; i < ARRAYSIZE( RDRAM_MIRRORS ); ++i )
+	{
+		void *	mirror( mmap( gFastmemBase + RDRAM_MIRRORS[ i ], ram_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, gRamFD, 0 ) );
+		if( mirror == MAP_FAILED )
+		{
+			Unmap();
+			return NULL;
+		}
+	}
+
+	struct sigaction	action;
+	memset( &action, 0, sizeof( action ) );
+	action.sa_sigaction = FastmemSignalHandler;
+	action.sa_flags = SA_SIGINFO | SA_NODEFER;		// The handlers may fault again, e.g. RSP tasks started by a register write
+	sigemptyset( &action.sa_mask );
+
+	if( sigaction( SIGSEGV, &action, &gPreviousAction ) != 0 )
+	{
+		Unmap();
+		return NULL;
+	}
+
+	#ifdef DAEDALUS_DEBUG_CONSOLE
+	DBGConsole_Msg( 0, "Fastmem: RDRAM mirrored at %p", gFastmemBase + RDRAM_MIRRORS[ 0 ] );
+	#endif
+	return gRamView;
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void Fastmem_Fini()
+{
+	if( gFastmemBase != NULL )
+	{
+		sigaction( SIGSEGV, &gPreviousAction, NULL );
+	}
+	Unmap();
+}
+
+//*****************************************************************************
+//	Pages past ram_size are still backed, so they can come back when the
+//	expansion pak is turned on again
+//*****************************************************************************
+void Fastmem_SetRamSize( u32 ram_size )
+{
+	DAEDALUS_ASSERT( ram_size <= gRamMappedSize, "RDRAM is bigger than the fastmem mapping" );
+
+	for( u32 i = 0; i < ARRAYSIZE( RDRAM_MIRRORS ); ++i )
+	{
+		u8 *	mirror( gFastmemBase + RDRAM_MIRRORS[ i ] );
+
+		mprotect( mirror, ram_size, PROT_READ | PROT_WRITE );
+		if( ram_size < gRamMappedSize )
+		{
+			mprotect( mirror + ram_size, gRamMappedSize - ram_size, PROT_NONE );
+		}
+	}
+}
+
+#endif // DAEDALUS_FASTMEM
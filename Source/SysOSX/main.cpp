@@ -19,6 +19,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "stdafx.h"
 
+#include "Config/ConfigOptions.h"
 #include "Core/CPU.h"
 #include "Debug/DBGConsole.h"
 #include "Interface/RomDB.h"
@@ -51,6 +52,22 @@ int main(int argc, char **argv)
 
 	//ReadConfiguration();
 
+	// Memory_Init needs to know about this, so it has to be picked out before System_Init
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--fastmem") == 0)
+			gFastmemEnabled = true;
+	}
+
+#ifdef DAEDALUS_BATCH_BENCH
+	// The benchmark starts a process for each rom, which does its own System_Init
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--bench") == 0)
+			return BatchBenchMain(argc, argv);
+	}
+#endif
+
 	if (!System_Init())
 		return 1;
 
@@ -76,6 +93,19 @@ int main(int argc, char **argv)
 					batch_test = true;
 					break;
 				}
+				else if (strcmp( arg, "-render-thread" ) == 0 )
+				{
+					gRenderThreadEnabled = true;
+				}
+				else if (strcmp( arg, "-rewind" ) == 0 )
+				{
+					// Capture a rewind snapshot every N VIs
+					if (i+1 < argc)
+					{
+						gRewindInterval = atoi(argv[i+1]);
+						++i;
+					}
+				}
 				else if (strcmp( arg, "-roms" ) == 0 )
 				{
 					if (i+1 < argc)
@@ -128,6 +158,8 @@ int main(int argc, char **argv)
 
 //FIXME: All this stuff needs tidying
 
+// The x64 dynarec (SysPosix/DynaRec/x64) provides these when it's built
+#ifndef DAEDALUS_ENABLE_DYNAREC
 void Dynarec_ClearedCPUStuffToDo()
 {
 }
@@ -143,4 +175,5 @@ void _EnterDynaRec()
 	DAEDALUS_ASSERT(false, "Unimplemented");
 }
 }
+#endif
 
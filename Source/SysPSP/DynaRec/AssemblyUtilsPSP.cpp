@@ -83,6 +83,22 @@ bool	PatchJumpLong( CJumpLocation jump, CCodeLabel target )
 }
 
 
+//	Return the location a long jump currently targets
+
+CCodeLabel	GetJumpTarget( CJumpLocation jump )
+{
+	const PspOpCode &	op_code( *reinterpret_cast< const PspOpCode * >( jump.GetTargetU8P() ) );
+	const u32			address( reinterpret_cast< u32 >( jump.GetTargetU8P() ) );
+
+	if( op_code.op == OP_J || op_code.op == OP_JAL )
+	{
+		return CCodeLabel( reinterpret_cast< const void * >( ( (address + 4) & 0xF0000000 ) | ( op_code.target << 2 ) ) );
+	}
+
+	return CCodeLabel( jump.GetTargetU8P() + 4 + ( s32( s16( op_code.offset ) ) << 2 ) );
+}
+
+
 //	As above but invalidates the instruction cache for the specified address.
 
 bool	PatchJumpLongAndFlush( CJumpLocation jump, CCodeLabel target )
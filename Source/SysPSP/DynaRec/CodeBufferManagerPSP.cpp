@@ -114,7 +114,7 @@ public:
 	virtual void				Reset();
 	virtual void				Finalise();
 
-	virtual CCodeGenerator *	StartNewBlock();
+	virtual CCodeGenerator *	StartNewBlock( u32 num_instructions );
 	virtual u32					FinaliseCurrentBlock();
 
 private:
@@ -173,7 +173,7 @@ void	CCodeBufferManagerPSP::Finalise()
 
 //
 
-CCodeGenerator * CCodeBufferManagerPSP::StartNewBlock()
+CCodeGenerator * CCodeBufferManagerPSP::StartNewBlock( u32 num_instructions )
 {
 	u8 * primary( mPrimaryBuffer.StartNewBlock() );
 	u8 * secondary( mSecondaryBuffer.StartNewBlock() );
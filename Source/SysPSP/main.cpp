@@ -403,6 +403,14 @@ static void	DumpDynarecStats( float elapsed_time )
 		cached_regs_ratio = u32( fRatio );
 	}
 
+	u32		tlb_cache_ratio( 0 );
+	if(gTLBReadHit + gTLBWriteHit > 0)
+	{
+		float fRatio = float((gTLBCacheReadHit + gTLBCacheWriteHit) * 100.0f / float(gTLBReadHit + gTLBWriteHit));
+
+		tlb_cache_ratio = u32( fRatio );
+	}
+
 	const char * const TERMINAL_SAVE_CURSOR			= "\033[s";
 	const char * const TERMINAL_RESTORE_CURSOR		= "\033[u";
 //	const char * const TERMINAL_TOP_LEFT			= "\033[2A\033[2K";
@@ -411,13 +419,17 @@ static void	DumpDynarecStats( float elapsed_time )
 	printf( TERMINAL_SAVE_CURSOR );
 	printf( TERMINAL_TOP_LEFT );
 
-	printf( "Frame: %dms, DynaRec %d%%, Regs cached %d%%, Lookup success %d/%d", u32(elapsed_time * 1000.0f), dynarec_ratio, cached_regs_ratio, gFragmentLookupSuccess, gFragmentLookupFailure );
+	printf( "Frame: %dms, DynaRec %d%%, Regs cached %d%%, Lookup success %d/%d, TLB cache %d%%", u32(elapsed_time * 1000.0f), dynarec_ratio, cached_regs_ratio, gFragmentLookupSuccess, gFragmentLookupFailure, tlb_cache_ratio );
 
 	printf( TERMINAL_RESTORE_CURSOR );
 	fflush( stdout );
 
 	gFragmentLookupSuccess = 0;
 	gFragmentLookupFailure = 0;
+	gTLBReadHit = 0;
+	gTLBWriteHit = 0;
+	gTLBCacheReadHit = 0;
+	gTLBCacheWriteHit = 0;
 }
 #endif
 
@@ -0,0 +1,510 @@
+/*
+Copyright (C) 2001,2005 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#include "stdafx.h"
+#include "DynaRec/CodeBufferManager.h"
+#include "CodeBufferManagerPosix.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <map>
+#include <vector>
+
+#include "Core/Dynamo.h"
+#include "Debug/DBGConsole.h"
+
+#include "x64/CodeGeneratorX64.h"
+
+//
+//	Layout is the same as on W32: a large range of address space is reserved
+//	up front so the buffer never moves (which would invalidate all the
+//	fragment pointers and jumps), and is committed a megabyte at a time.
+//	Code which is rarely executed goes in the second buffer, 192MB in.
+//
+//	Space released by retired fragments is reused in both buffers. A block's
+//	size isn't known until it's been assembled, so a hole is only used if it
+//	has the same kMaxBlockSize bytes the end of the buffer would give it.
+//	FinaliseCurrentBlock() checks the bound in all builds. A block which
+//	overran may have overwritten its neighbours, so it's dropped and the
+//	cache flushed.
+//
+//	Once either buffer gets within kFlushMargin of its end, or memory can't be
+//	committed, the fragment cache is flushed at the next safe point. Until
+//	then there's still room for the block being assembled.
+//
+static const u32	kReservedSize		= 256 * 1024 * 1024;
+static const u32	kSecondBufferOffset	= 192 * 1024 * 1024;
+static const u32	kCommitSize			= 1024 * 1024;
+static const u32	kMaxBlockSize		= 32768;
+static const u32	kFlushMargin		= 4 * kMaxBlockSize;
+
+static bool			gWriteXorExecute = false;
+
+//*****************************************************************************
+//
+//*****************************************************************************
+static void	ProtectRange( const void * p_address, u32 length, int prot )
+{
+	const uintptr_t	page_mask( uintptr_t( sysconf( _SC_PAGESIZE ) ) - 1 );
+	uintptr_t		start( reinterpret_cast< uintptr_t >( p_address ) & ~page_mask );
+	uintptr_t		end( ( reinterpret_cast< uintptr_t >( p_address ) + length + page_mask ) & ~page_mask );
+
+	mprotect( reinterpret_cast< void * >( start ), end - start, prot );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CodeBuffer_BeginWrite( const void * p_address, u32 length )
+{
+	if( gWriteXorExecute )
+	{
+		ProtectRange( p_address, length, PROT_READ | PROT_WRITE );
+	}
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CodeBuffer_EndWrite( const void * p_address, u32 length )
+{
+	if( gWriteXorExecute )
+	{
+		ProtectRange( p_address, length, PROT_READ | PROT_EXEC );
+	}
+}
+
+//*****************************************************************************
+//	Space released by retired fragments, sorted by offset and coalesced.
+//*****************************************************************************
+struct SCodeRange
+{
+	u32		Offset;
+	u32		Size;
+};
+
+class CFreeRanges
+{
+public:
+	bool	Find( u32 * p_offset ) const;
+	void	Take( u32 offset, u32 used );
+	void	Release( u32 offset, u32 size, u32 * p_buffer_ptr );
+	void	Clear()										{ mRanges.clear(); }
+
+private:
+	std::vector< SCodeRange >	mRanges;
+};
+
+//*****************************************************************************
+//	Finds the smallest hole with room for a whole block
+//*****************************************************************************
+bool	CFreeRanges::Find( u32 * p_offset ) const
+{
+	bool	found( false );
+	u32		best_size( 0 );
+	for( u32 i = 0; i < mRanges.size(); ++i )
+	{
+		u32		size( mRanges[ i ].Size );
+		if( size >= kMaxBlockSize && ( !found || size < best_size ) )
+		{
+			*p_offset = mRanges[ i ].Offset;
+			found = true;
+			best_size = size;
+			if( size == kMaxBlockSize )
+				break;
+		}
+	}
+	return found;
+}
+
+//*****************************************************************************
+//	Takes what a block used (rounded to 16 bytes) off the front of its hole
+//*****************************************************************************
+void	CFreeRanges::Take( u32 offset, u32 used )
+{
+	used = ( used + 15 ) & ~15;
+	for( std::vector< SCodeRange >::iterator it = mRanges.begin(); it != mRanges.end(); ++it )
+	{
+		if( it->Offset == offset )
+		{
+			it->Offset += used;
+			it->Size -= used;
+			if( it->Size == 0 )
+			{
+				mRanges.erase( it );
+			}
+			break;
+		}
+	}
+}
+
+//*****************************************************************************
+//	If the hole reaches the end of the used space, *p_buffer_ptr is wound back
+//*****************************************************************************
+void	CFreeRanges::Release( u32 offset, u32 size, u32 * p_buffer_ptr )
+{
+	SCodeRange	range;
+	range.Offset = offset;
+	range.Size = ( size + 15 ) & ~15;
+
+	std::vector< SCodeRange >::iterator	it( mRanges.begin() );
+	while( it != mRanges.end() && it->Offset < range.Offset )
+	{
+		++it;
+	}
+	it = mRanges.insert( it, range );
+
+	// Merge with the following range
+	std::vector< SCodeRange >::iterator	next( it + 1 );
+	if( next != mRanges.end() && it->Offset + it->Size == next->Offset )
+	{
+		it->Size += next->Size;
+		mRanges.erase( next );
+	}
+
+	// Merge with the preceding range
+	if( it != mRanges.begin() )
+	{
+		std::vector< SCodeRange >::iterator	prev( it - 1 );
+		if( prev->Offset + prev->Size == it->Offset )
+		{
+			prev->Size += it->Size;
+			it = mRanges.erase( it ) - 1;
+		}
+	}
+
+	if( it + 1 == mRanges.end() && it->Offset + it->Size >= *p_buffer_ptr )
+	{
+		*p_buffer_ptr = it->Offset;
+		mRanges.erase( it );
+	}
+}
+
+class CCodeBufferManagerPosix : public CCodeBufferManager
+{
+public:
+	CCodeBufferManagerPosix()
+		:	mpBuffer( NULL )
+		,	mBufferPtr( 0 )
+		,	mBufferSize( 0 )
+		,	mpSecondBuffer( NULL )
+		,	mSecondBufferPtr( 0 )
+		,	mSecondBufferSize( 0 )
+		,	mEntryStubSize( 0 )
+		,	mBlockPtr( 0 )
+		,	mBlockFromFreeList( false )
+		,	mSecondBlockPtr( 0 )
+		,	mSecondBlockFromFreeList( false )
+	{
+	}
+
+	virtual bool			Initialise();
+	virtual void			Reset();
+	virtual void			Finalise();
+
+	virtual CCodeGenerator *StartNewBlock( u32 num_instructions );
+	virtual u32				FinaliseCurrentBlock();
+	virtual void			ReleaseBlock( CCodeLabel start, u32 size );
+
+private:
+			bool			Commit( u8 * p_base, u32 * p_size );
+			bool			Reserve( u8 * p_base, u32 * p_size, u32 ptr, u32 limit );
+
+private:
+
+	u8	*					mpBuffer;
+	u32						mBufferPtr;
+	u32						mBufferSize;
+
+	u8 *					mpSecondBuffer;
+	u32						mSecondBufferPtr;
+	u32						mSecondBufferSize;
+
+	u32						mEntryStubSize;
+
+	CFreeRanges				mFreeRanges;
+	CFreeRanges				mSecondFreeRanges;
+
+	// Where each live block's slow paths went, by the offset of its primary code
+	typedef std::map< u32, SCodeRange >	SecondaryRangeMap;
+	SecondaryRangeMap		mSecondaryRanges;
+
+	u32						mBlockPtr;
+	bool					mBlockFromFreeList;
+	u32						mSecondBlockPtr;
+	bool					mSecondBlockFromFreeList;
+
+private:
+	CAssemblyBuffer			mPrimaryBuffer;
+	CAssemblyBuffer			mSecondaryBuffer;
+};
+
+//*****************************************************************************
+//
+//*****************************************************************************
+CCodeBufferManager *	CCodeBufferManager::Create()
+{
+	return new CCodeBufferManagerPosix;
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+bool	CCodeBufferManagerPosix::Initialise()
+{
+	// Try to place the buffer just below our own code, so calls out to the
+	// interpreter and helpers can use rel32 displacements. This is only a hint,
+	// CCodeGeneratorX64 falls back to absolute calls if it's not honoured.
+	uintptr_t	text( reinterpret_cast< uintptr_t >( &CCodeBufferManager::Create ) );
+	uintptr_t	hint( text > 0x40000000 ? ( text - 0x40000000 ) & ~uintptr_t( 0xffff ) : 0 );
+
+	void *		p( mmap( reinterpret_cast< void * >( hint ), kReservedSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 ) );
+	if( p == MAP_FAILED )
+		return false;
+
+	mpBuffer = reinterpret_cast< u8 * >( p );
+	mBufferPtr = 0;
+	mBufferSize = 0;
+
+	mpSecondBuffer = mpBuffer + kSecondBufferOffset;
+	mSecondBufferPtr = 0;
+	mSecondBufferSize = 0;
+
+	// Some hardened kernels refuse PROT_WRITE|PROT_EXEC
+	gWriteXorExecute = mprotect( mpBuffer, kCommitSize, PROT_READ | PROT_WRITE | PROT_EXEC ) != 0;
+	#ifdef DAEDALUS_DEBUG_CONSOLE
+	if( gWriteXorExecute )
+	{
+		DBGConsole_Msg(0, "RWX mappings unavailable, dynarec buffer is W^X");
+	}
+	#endif
+
+	if( !Commit( mpBuffer, &mBufferSize ) )
+	{
+		Finalise();
+		return false;
+	}
+
+	// The entry stub lives at the start of the buffer and survives Reset()
+	CAssemblyBuffer		stub_buffer;
+	stub_buffer.SetBuffer( mpBuffer );
+	CCodeGeneratorX64::GenerateEntryStub( &stub_buffer );
+	mEntryStubSize = ( stub_buffer.GetSize() + 15 ) & ~15;
+	CodeBuffer_EndWrite( mpBuffer, mEntryStubSize );
+
+	mBufferPtr = mEntryStubSize;
+
+	return true;
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+bool	CCodeBufferManagerPosix::Commit( u8 * p_base, u32 * p_size )
+{
+	int		prot( gWriteXorExecute ? PROT_READ | PROT_WRITE : PROT_READ | PROT_WRITE | PROT_EXEC );
+
+	if( mprotect( p_base + *p_size, kCommitSize, prot ) != 0 )
+	{
+		#ifdef DAEDALUS_DEBUG_CONSOLE
+		DBGConsole_Msg(0, "SR Buffer allocation failed"); // maybe this should be an abort?
+		#endif
+		return false;
+	}
+
+	*p_size += kCommitSize;
+	#ifdef DAEDALUS_DEBUG_CONSOLE
+	DBGConsole_Msg(0, "Allocated %dMB of storage for dynarec buffer", *p_size / (1024*1024));
+	#endif
+	return true;
+}
+
+//*****************************************************************************
+//	Makes sure a block can be assembled at ptr, in a buffer which can grow to
+//	limit bytes. Two blocks' worth is kept committed ahead, so if a commit
+//	fails there's still room for this one. Returns false if there isn't.
+//*****************************************************************************
+bool	CCodeBufferManagerPosix::Reserve( u8 * p_base, u32 * p_size, u32 ptr, u32 limit )
+{
+	if( ptr + kFlushMargin > limit )
+	{
+		CPU_ResetFragmentCache();
+	}
+
+	while( *p_size < limit && ptr + 2 * kMaxBlockSize > *p_size )
+	{
+		if( !Commit( p_base, p_size ) )
+		{
+			CPU_ResetFragmentCache();
+			break;
+		}
+	}
+
+	return ptr + kMaxBlockSize <= *p_size;
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CCodeBufferManagerPosix::Reset()
+{
+	mBufferPtr = mEntryStubSize;
+	mSecondBufferPtr = 0;
+	mFreeRanges.Clear();
+	mSecondFreeRanges.Clear();
+	mSecondaryRanges.clear();
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CCodeBufferManagerPosix::Finalise()
+{
+	if (mpBuffer != NULL)
+	{
+		munmap( mpBuffer, kReservedSize );
+		mpBuffer = NULL;
+	}
+
+	mpSecondBuffer = NULL;
+	mBufferSize = 0;
+	mSecondBufferSize = 0;
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+CCodeGenerator * CCodeBufferManagerPosix::StartNewBlock( u32 num_instructions )
+{
+	// Prefer holes left by retired fragments
+	mBlockFromFreeList = mFreeRanges.Find( &mBlockPtr );
+	mSecondBlockFromFreeList = mSecondFreeRanges.Find( &mSecondBlockPtr );
+
+	// We assume that no single entry will generate more than 32k of storage
+	u32 aligned_ptr( (mBufferPtr + 15) & (~15) );
+	if( ( !mBlockFromFreeList && !Reserve( mpBuffer, &mBufferSize, aligned_ptr, kSecondBufferOffset ) ) ||
+		( !mSecondBlockFromFreeList && !Reserve( mpSecondBuffer, &mSecondBufferSize, mSecondBufferPtr, kReservedSize - kSecondBufferOffset ) ) )
+	{
+		#ifdef DAEDALUS_DEBUG_CONSOLE
+		DBGConsole_Msg(0, "Dynarec buffer is full, dropping fragment");
+		#endif
+		return NULL;
+	}
+
+	if( !mBlockFromFreeList )
+	{
+		u32	padding( aligned_ptr - mBufferPtr );
+		if( padding > 0 )
+		{
+			CodeBuffer_BeginWrite( mpBuffer + mBufferPtr, padding );
+			memset( mpBuffer + mBufferPtr, 0xcc, padding );		// 0xcc is 'int 3'
+			CodeBuffer_EndWrite( mpBuffer + mBufferPtr, padding );
+		}
+
+		mBufferPtr = aligned_ptr;
+		mBlockPtr = aligned_ptr;
+	}
+
+	if( !mSecondBlockFromFreeList )
+	{
+		mSecondBlockPtr = mSecondBufferPtr;
+	}
+
+	CodeBuffer_BeginWrite( mpBuffer + mBlockPtr, kMaxBlockSize );
+	CodeBuffer_BeginWrite( mpSecondBuffer + mSecondBlockPtr, kMaxBlockSize );
+
+	mPrimaryBuffer.SetBuffer( mpBuffer + mBlockPtr );
+	mSecondaryBuffer.SetBuffer( mpSecondBuffer + mSecondBlockPtr );
+
+	return new CCodeGeneratorX64( &mPrimaryBuffer, &mSecondaryBuffer );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+u32 CCodeBufferManagerPosix::FinaliseCurrentBlock()
+{
+	u32		main_block_size( mPrimaryBuffer.GetSize() );
+	u32		second_block_size( mSecondaryBuffer.GetSize() );
+
+	CodeBuffer_EndWrite( mpBuffer + mBlockPtr, kMaxBlockSize );
+	CodeBuffer_EndWrite( mpSecondBuffer + mSecondBlockPtr, kMaxBlockSize );
+
+	// Whatever came after the block may have been overwritten, so none of the cache can be trusted
+	if( main_block_size > kMaxBlockSize || second_block_size > kMaxBlockSize )
+	{
+		fprintf( stderr, "Dynarec block overran its space (%u/%u bytes), flushing the cache\n", main_block_size, second_block_size );
+		CPU_ResetFragmentCache();
+		return 0;
+	}
+
+	if( mBlockFromFreeList )
+	{
+		mFreeRanges.Take( mBlockPtr, main_block_size );
+	}
+	else
+	{
+		mBufferPtr += main_block_size;
+	}
+
+	if( mSecondBlockFromFreeList )
+	{
+		mSecondFreeRanges.Take( mSecondBlockPtr, second_block_size );
+	}
+	else
+	{
+		mSecondBufferPtr += second_block_size;
+		mSecondBufferPtr = ((mSecondBufferPtr - 1) & 0xfffffff0) + 0x10; // align to 16-byte boundary
+	}
+
+	if( second_block_size > 0 )
+	{
+		SCodeRange	range;
+		range.Offset = mSecondBlockPtr;
+		range.Size = second_block_size;
+		mSecondaryRanges[ mBlockPtr ] = range;
+	}
+
+	return main_block_size;
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void CCodeBufferManagerPosix::ReleaseBlock( CCodeLabel start, u32 size )
+{
+	const u8 *	p( start.GetTargetU8P() );
+	if( p < mpBuffer + mEntryStubSize || p >= mpBuffer + mBufferPtr )
+		return;
+
+	u32		offset( u32( p - mpBuffer ) );
+
+	SecondaryRangeMap::iterator	it( mSecondaryRanges.find( offset ) );
+	if( it != mSecondaryRanges.end() )
+	{
+		mSecondFreeRanges.Release( it->second.Offset, it->second.Size, &mSecondBufferPtr );
+		mSecondaryRanges.erase( it );
+	}
+
+	mFreeRanges.Release( offset, size, &mBufferPtr );
+}
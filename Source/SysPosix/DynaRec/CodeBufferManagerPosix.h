@@ -0,0 +1,33 @@
+/*
+Copyright (C) 2001,2005 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#pragma once
+
+#ifndef SYSPOSIX_DYNAREC_CODEBUFFERMANAGERPOSIX_H_
+#define SYSPOSIX_DYNAREC_CODEBUFFERMANAGERPOSIX_H_
+
+#include "Utility/DaedalusTypes.h"
+
+// If the host refuses writable+executable mappings, the code buffer is kept
+// W^X and any code which is patched after it has been generated has to be
+// bracketed with these.
+void	CodeBuffer_BeginWrite( const void * p_address, u32 length );
+void	CodeBuffer_EndWrite( const void * p_address, u32 length );
+
+#endif // SYSPOSIX_DYNAREC_CODEBUFFERMANAGERPOSIX_H_
@@ -0,0 +1,738 @@
+/*
+Copyright (C) 2001,2005 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#include "stdafx.h"
+#include "AssemblyWriterX64.h"
+
+namespace
+{
+	inline bool IsS8( s32 value )
+	{
+		return value >= -128 && value <= 127;
+	}
+}
+
+//*****************************************************************************
+//	Emit a REX prefix if any of the operands use the extended registers, or
+//	for a 64 bit operation. force is used for byte access to spl/bpl/sil/dil,
+//	which otherwise encode as ah/ch/dh/bh.
+//*****************************************************************************
+void	CAssemblyWriterX64::EmitREX( bool wide, u32 reg, u32 index, u32 base, bool force )
+{
+	u8	rex( 0x40 );
+
+	if( wide )		rex |= 0x08;
+	if( reg & 8 )	rex |= 0x04;
+	if( index & 8 )	rex |= 0x02;
+	if( base & 8 )	rex |= 0x01;
+
+	if( rex != 0x40 || force )
+	{
+		EmitBYTE( rex );
+	}
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::EmitModRM_Reg( u32 reg, u32 rm )
+{
+	EmitBYTE( 0xc0 | ((reg & 7) << 3) | (rm & 7) );
+}
+
+//*****************************************************************************
+//	[base + offset]. rsp/r12 always need a SIB byte, and rbp/r13 can't be
+//	encoded without a displacement.
+//*****************************************************************************
+void	CAssemblyWriterX64::EmitModRM_BaseOffset( u32 reg, EIntelReg ibase, s32 offset )
+{
+	u32		base( ibase & 7 );
+	u8		mod;
+
+	if( offset == 0 && base != 5 )	mod = 0x00;
+	else if( IsS8( offset ) )		mod = 0x40;
+	else							mod = 0x80;
+
+	EmitBYTE( mod | ((reg & 7) << 3) | base );
+	if( base == 4 )
+	{
+		EmitBYTE( 0x24 );
+	}
+
+	if( mod == 0x40 )		EmitBYTE( u8( offset ) );
+	else if( mod == 0x80 )	EmitDWORD( u32( offset ) );
+}
+
+//*****************************************************************************
+//	[base + index]
+//*****************************************************************************
+void	CAssemblyWriterX64::EmitModRM_BaseIndex( u32 reg, EIntelReg ibase, EIntelReg iindex )
+{
+	DAEDALUS_ASSERT( iindex != RSP_CODE, "rsp can't be used as an index register" );
+
+	u32		base( ibase & 7 );
+	u8		mod( base == 5 ? 0x40 : 0x00 );
+
+	EmitBYTE( mod | ((reg & 7) << 3) | 0x04 );
+	EmitBYTE( ((iindex & 7) << 3) | base );
+
+	if( mod == 0x40 )
+	{
+		EmitBYTE( 0x00 );
+	}
+}
+
+//*****************************************************************************
+//	op	reg1, reg2		(for opcodes of the form op r, r/m)
+//*****************************************************************************
+void	CAssemblyWriterX64::EmitRegReg( u8 opcode, bool wide, EIntelReg reg1, EIntelReg reg2 )
+{
+	EmitREX( wide, reg1, 0, reg2 );
+	EmitBYTE( opcode );
+	EmitModRM_Reg( reg1, reg2 );
+}
+
+//*****************************************************************************
+//	add/or/and/sub/xor/cmp reg, imm
+//*****************************************************************************
+void	CAssemblyWriterX64::EmitGroup1Imm( u32 ext, bool wide, EIntelReg reg, s32 data )
+{
+	EmitREX( wide, 0, 0, reg );
+	if( IsS8( data ) )
+	{
+		EmitBYTE( 0x83 );
+		EmitModRM_Reg( ext, reg );
+		EmitBYTE( u8( data ) );
+	}
+	else
+	{
+		EmitBYTE( 0x81 );
+		EmitModRM_Reg( ext, reg );
+		EmitDWORD( u32( data ) );
+	}
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::EmitShiftImm( u32 ext, EIntelReg reg, u8 sa )
+{
+	EmitREX( false, 0, 0, reg );
+	EmitBYTE( 0xc1 );
+	EmitModRM_Reg( ext, reg );
+	EmitBYTE( sa );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::EmitRegMemBaseOffset( u8 opcode, bool wide, u32 reg, EIntelReg ibase, s32 offset )
+{
+	EmitREX( wide, reg, 0, ibase );
+	EmitBYTE( opcode );
+	EmitModRM_BaseOffset( reg, ibase, offset );
+}
+
+//*****************************************************************************
+//	opcode2 is only emitted for two byte (0x0f xx) opcodes
+//*****************************************************************************
+void	CAssemblyWriterX64::EmitRegMemBaseIndex( u8 prefix, u8 opcode1, u8 opcode2, bool wide, bool force_rex, EIntelReg reg, EIntelReg ibase, EIntelReg iindex )
+{
+	if( prefix != 0 )
+	{
+		EmitBYTE( prefix );
+	}
+	EmitREX( wide, reg, iindex, ibase, force_rex );
+	EmitBYTE( opcode1 );
+	if( opcode1 == 0x0f )
+	{
+		EmitBYTE( opcode2 );
+	}
+	EmitModRM_BaseIndex( reg, ibase, iindex );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::PUSH(EIntelReg reg)
+{
+	EmitREX( false, 0, 0, reg );
+	EmitBYTE(0x50 | (reg & 7));
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::POP(EIntelReg reg)
+{
+	EmitREX( false, 0, 0, reg );
+	EmitBYTE(0x58 | (reg & 7));
+}
+
+//*****************************************************************************
+//	add	reg1, reg2
+//*****************************************************************************
+void	CAssemblyWriterX64::ADD(EIntelReg reg1, EIntelReg reg2)
+{
+	EmitRegReg( 0x03, false, reg1, reg2 );
+}
+
+//*****************************************************************************
+//	sub	reg1, reg2
+//*****************************************************************************
+void	CAssemblyWriterX64::SUB(EIntelReg reg1, EIntelReg reg2)
+{
+	EmitRegReg( 0x2b, false, reg1, reg2 );
+}
+
+//*****************************************************************************
+//	and	reg1, reg2
+//*****************************************************************************
+void	CAssemblyWriterX64::AND(EIntelReg reg1, EIntelReg reg2)
+{
+	EmitRegReg( 0x23, false, reg1, reg2 );
+}
+
+//*****************************************************************************
+//	or	reg1, reg2
+//*****************************************************************************
+void	CAssemblyWriterX64::OR(EIntelReg reg1, EIntelReg reg2)
+{
+	EmitRegReg( 0x0b, false, reg1, reg2 );
+}
+
+//*****************************************************************************
+//	xor	reg1, reg2
+//*****************************************************************************
+void	CAssemblyWriterX64::XOR(EIntelReg reg1, EIntelReg reg2)
+{
+	EmitRegReg( 0x33, false, reg1, reg2 );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::ADD64(EIntelReg reg1, EIntelReg reg2)
+{
+	EmitRegReg( 0x03, true, reg1, reg2 );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::SUB64(EIntelReg reg1, EIntelReg reg2)
+{
+	EmitRegReg( 0x2b, true, reg1, reg2 );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::AND64(EIntelReg reg1, EIntelReg reg2)
+{
+	EmitRegReg( 0x23, true, reg1, reg2 );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::OR64(EIntelReg reg1, EIntelReg reg2)
+{
+	EmitRegReg( 0x0b, true, reg1, reg2 );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::XOR64(EIntelReg reg1, EIntelReg reg2)
+{
+	EmitRegReg( 0x33, true, reg1, reg2 );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::NOT64(EIntelReg reg)
+{
+	EmitREX( true, 0, 0, reg );
+	EmitBYTE( 0xf7 );
+	EmitModRM_Reg( 2, reg );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::ADDI(EIntelReg reg, s32 data)
+{
+	if( data == 0 )
+		return;
+
+	EmitGroup1Imm( 0, false, reg, data );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::ANDI(EIntelReg reg, u32 data)
+{
+	EmitGroup1Imm( 4, false, reg, s32( data ) );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::XOR_I32(EIntelReg reg, u32 data)
+{
+	EmitGroup1Imm( 6, false, reg, s32( data ) );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::ORI64(EIntelReg reg, s32 data)
+{
+	EmitGroup1Imm( 1, true, reg, data );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::XORI64(EIntelReg reg, s32 data)
+{
+	EmitGroup1Imm( 6, true, reg, data );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::SHLI(EIntelReg reg, u8 sa)
+{
+	EmitShiftImm( 4, reg, sa );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::SHRI(EIntelReg reg, u8 sa)
+{
+	EmitShiftImm( 5, reg, sa );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::SARI(EIntelReg reg, u8 sa)
+{
+	EmitShiftImm( 7, reg, sa );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::CMP(EIntelReg reg1, EIntelReg reg2)
+{
+	EmitRegReg( 0x3b, false, reg1, reg2 );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::CMP64(EIntelReg reg1, EIntelReg reg2)
+{
+	EmitRegReg( 0x3b, true, reg1, reg2 );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::CMPI64(EIntelReg reg, s32 data)
+{
+	EmitGroup1Imm( 7, true, reg, data );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::TEST(EIntelReg reg1, EIntelReg reg2)
+{
+	EmitRegReg( 0x85, false, reg1, reg2 );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::TEST64(EIntelReg reg1, EIntelReg reg2)
+{
+	EmitRegReg( 0x85, true, reg1, reg2 );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::CMP_MEM_BASE_OFFSET_I32( EIntelReg ibase, s32 offset, u32 data )
+{
+	EmitRegMemBaseOffset( 0x81, false, 7, ibase, offset );
+	EmitDWORD( data );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::CMP_MEM_BASE_OFFSET_I8( EIntelReg ibase, s32 offset, s8 data )
+{
+	EmitRegMemBaseOffset( 0x83, false, 7, ibase, offset );
+	EmitBYTE( u8( data ) );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::ADDI_MEM_BASE_OFFSET( EIntelReg ibase, s32 offset, s8 data )
+{
+	EmitRegMemBaseOffset( 0x83, false, 0, ibase, offset );
+	EmitBYTE( u8( data ) );
+}
+
+//*****************************************************************************
+//	setl	reg_8
+//*****************************************************************************
+void	CAssemblyWriterX64::SETL(EIntelReg reg)
+{
+	EmitREX( false, 0, 0, reg, reg >= RSP_CODE );
+	EmitBYTE( 0x0f );
+	EmitBYTE( 0x9c );
+	EmitModRM_Reg( 0, reg );
+}
+
+//*****************************************************************************
+//	setb	reg_8
+//*****************************************************************************
+void	CAssemblyWriterX64::SETB(EIntelReg reg)
+{
+	EmitREX( false, 0, 0, reg, reg >= RSP_CODE );
+	EmitBYTE( 0x0f );
+	EmitBYTE( 0x92 );
+	EmitModRM_Reg( 0, reg );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+CJumpLocation CAssemblyWriterX64::JumpConditionalLong( CCodeLabel target, u8 jump_type )
+{
+	const u32	JUMP_LONG_LENGTH = 6;
+
+	CJumpLocation	jump_location( mpAssemblyBuffer->GetJumpLocation() );
+	s32				offset( jump_location.GetOffset( target ) - JUMP_LONG_LENGTH );
+
+	EmitBYTE( 0x0f );
+	EmitBYTE( jump_type );		//
+	EmitDWORD( offset );
+
+	return jump_location;
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+CJumpLocation CAssemblyWriterX64::JELong( CCodeLabel target )
+{
+	return JumpConditionalLong( target, 0x84 );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+CJumpLocation CAssemblyWriterX64::JNELong( CCodeLabel target )
+{
+	return JumpConditionalLong( target, 0x85 );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+CJumpLocation CAssemblyWriterX64::JAELong( CCodeLabel target )
+{
+	return JumpConditionalLong( target, 0x83 );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::JMP_REG( EIntelReg reg )
+{
+	EmitREX( false, 0, 0, reg );
+	EmitBYTE( 0xff );
+	EmitModRM_Reg( 4, reg );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::CALL_REG( EIntelReg reg )
+{
+	EmitREX( false, 0, 0, reg );
+	EmitBYTE( 0xff );
+	EmitModRM_Reg( 2, reg );
+}
+
+//*****************************************************************************
+//	The caller is responsible for checking that target is within +/-2GB
+//*****************************************************************************
+CJumpLocation	CAssemblyWriterX64::CALL( CCodeLabel target )
+{
+	const u32	CALL_LONG_LENGTH = 5;
+
+	CJumpLocation	jump_location( mpAssemblyBuffer->GetJumpLocation() );
+	s32				offset( jump_location.GetOffset( target ) - CALL_LONG_LENGTH );
+
+	EmitBYTE( 0xe8 );
+	EmitDWORD( offset );
+
+	return jump_location;
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+CJumpLocation	CAssemblyWriterX64::JMPLong( CCodeLabel target )
+{
+	const u32	JUMP_DIRECT_LONG_LENGTH = 5;
+
+	CJumpLocation	jump_location( mpAssemblyBuffer->GetJumpLocation() );
+	s32				offset( jump_location.GetOffset( target ) - JUMP_DIRECT_LONG_LENGTH );
+
+	EmitBYTE(0xe9);
+	EmitDWORD( static_cast< u32 >( offset ) );
+
+	return jump_location;
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::RET()
+{
+	EmitBYTE(0xc3);
+}
+
+//*****************************************************************************
+//	mov	reg1, reg2
+//*****************************************************************************
+void	CAssemblyWriterX64::MOV(EIntelReg reg1, EIntelReg reg2)
+{
+	if( reg1 == reg2 )
+		return;
+
+	EmitRegReg( 0x8b, false, reg1, reg2 );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::MOV64(EIntelReg reg1, EIntelReg reg2)
+{
+	if( reg1 == reg2 )
+		return;
+
+	EmitRegReg( 0x8b, true, reg1, reg2 );
+}
+
+//*****************************************************************************
+//	movsxd	reg1, reg2
+//*****************************************************************************
+void	CAssemblyWriterX64::MOVSXD(EIntelReg reg1, EIntelReg reg2)
+{
+	EmitRegReg( 0x63, true, reg1, reg2 );
+}
+
+//*****************************************************************************
+//	movzx	reg1, reg2_8
+//*****************************************************************************
+void	CAssemblyWriterX64::MOVZX8(EIntelReg reg1, EIntelReg reg2)
+{
+	EmitREX( false, reg1, 0, reg2, reg2 >= RSP_CODE );
+	EmitBYTE( 0x0f );
+	EmitBYTE( 0xb6 );
+	EmitModRM_Reg( reg1, reg2 );
+}
+
+//*****************************************************************************
+//	mov	reg, data
+//*****************************************************************************
+void	CAssemblyWriterX64::MOVI(EIntelReg reg, u32 data)
+{
+	if( data == 0 )
+	{
+		XOR( reg, reg );
+		return;
+	}
+
+	EmitREX( false, 0, 0, reg );
+	EmitBYTE( 0xb8 | (reg & 7) );
+	EmitDWORD( data );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::MOVI_64(EIntelReg reg, u64 data)
+{
+	if( data <= 0xffffffffULL )
+	{
+		MOVI( reg, u32( data ) );
+		return;
+	}
+
+	EmitREX( true, 0, 0, reg );
+	EmitBYTE( 0xb8 | (reg & 7) );
+	EmitDWORD( u32( data ) );
+	EmitDWORD( u32( data >> 32 ) );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::MOV_REG_MEM_BASE_OFFSET( EIntelReg idst, EIntelReg ibase, s32 offset )
+{
+	EmitRegMemBaseOffset( 0x8b, false, idst, ibase, offset );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::MOV64_REG_MEM_BASE_OFFSET( EIntelReg idst, EIntelReg ibase, s32 offset )
+{
+	EmitRegMemBaseOffset( 0x8b, true, idst, ibase, offset );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::MOV_MEM_BASE_OFFSET_REG( EIntelReg ibase, s32 offset, EIntelReg isrc )
+{
+	EmitRegMemBaseOffset( 0x89, false, isrc, ibase, offset );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::MOV64_MEM_BASE_OFFSET_REG( EIntelReg ibase, s32 offset, EIntelReg isrc )
+{
+	EmitRegMemBaseOffset( 0x89, true, isrc, ibase, offset );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::MOVI_MEM_BASE_OFFSET( EIntelReg ibase, s32 offset, u32 data )
+{
+	EmitRegMemBaseOffset( 0xc7, false, 0, ibase, offset );
+	EmitDWORD( data );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::MOVI64_MEM_BASE_OFFSET( EIntelReg ibase, s32 offset, s32 data )
+{
+	EmitRegMemBaseOffset( 0xc7, true, 0, ibase, offset );
+	EmitDWORD( u32( data ) );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::MOVI8_MEM_BASE_OFFSET( EIntelReg ibase, s32 offset, u8 data )
+{
+	EmitRegMemBaseOffset( 0xc6, false, 0, ibase, offset );
+	EmitBYTE( data );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::MOV_REG_MEM_BASE_INDEX( EIntelReg idst, EIntelReg ibase, EIntelReg iindex )
+{
+	EmitRegMemBaseIndex( 0, 0x8b, 0, false, false, idst, ibase, iindex );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::MOVSXD_REG_MEM_BASE_INDEX( EIntelReg idst, EIntelReg ibase, EIntelReg iindex )
+{
+	EmitRegMemBaseIndex( 0, 0x63, 0, true, false, idst, ibase, iindex );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::MOVSX8_REG_MEM_BASE_INDEX( EIntelReg idst, EIntelReg ibase, EIntelReg iindex )
+{
+	EmitRegMemBaseIndex( 0, 0x0f, 0xbe, true, false, idst, ibase, iindex );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::MOVZX8_REG_MEM_BASE_INDEX( EIntelReg idst, EIntelReg ibase, EIntelReg iindex )
+{
+	EmitRegMemBaseIndex( 0, 0x0f, 0xb6, false, false, idst, ibase, iindex );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::MOVSX16_REG_MEM_BASE_INDEX( EIntelReg idst, EIntelReg ibase, EIntelReg iindex )
+{
+	EmitRegMemBaseIndex( 0, 0x0f, 0xbf, true, false, idst, ibase, iindex );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::MOVZX16_REG_MEM_BASE_INDEX( EIntelReg idst, EIntelReg ibase, EIntelReg iindex )
+{
+	EmitRegMemBaseIndex( 0, 0x0f, 0xb7, false, false, idst, ibase, iindex );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::MOV_MEM_BASE_INDEX_REG( EIntelReg ibase, EIntelReg iindex, EIntelReg isrc )
+{
+	EmitRegMemBaseIndex( 0, 0x89, 0, false, false, isrc, ibase, iindex );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::MOV16_MEM_BASE_INDEX_REG( EIntelReg ibase, EIntelReg iindex, EIntelReg isrc )
+{
+	EmitRegMemBaseIndex( 0x66, 0x89, 0, false, false, isrc, ibase, iindex );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CAssemblyWriterX64::MOV8_MEM_BASE_INDEX_REG( EIntelReg ibase, EIntelReg iindex, EIntelReg isrc )
+{
+	EmitRegMemBaseIndex( 0, 0x88, 0, false, isrc >= RSP_CODE, isrc, ibase, iindex );
+}
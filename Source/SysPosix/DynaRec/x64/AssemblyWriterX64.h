@@ -0,0 +1,172 @@
+/*
+Copyright (C) 2001,2005 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#pragma once
+
+#ifndef SYSPOSIX_DYNAREC_X64_ASSEMBLYWRITERX64_H_
+#define SYSPOSIX_DYNAREC_X64_ASSEMBLYWRITERX64_H_
+
+#include "DynaRec/AssemblyBuffer.h"
+#include "DynarecTargetX64.h"
+
+//
+//	All memory operands are expressed relative to a base register. There's no
+//	absolute addressing in 64 bit mode (it's rip-relative), so anything which is
+//	not reachable from one of the fixed base registers (see DynarecTargetX64.h)
+//	has to have its address loaded into a register first.
+//
+//	Instructions without a 64 suffix operate on the low 32 bits of the register
+//	and zero the upper 32 bits of the destination, as the hardware does.
+//
+class CAssemblyWriterX64
+{
+	public:
+		CAssemblyWriterX64( CAssemblyBuffer * p_buffer )
+			:	mpAssemblyBuffer( p_buffer )
+		{
+		}
+
+	public:
+		CAssemblyBuffer *	GetAssemblyBuffer() const									{ return mpAssemblyBuffer; }
+		void				SetAssemblyBuffer( CAssemblyBuffer * p_buffer )				{ mpAssemblyBuffer = p_buffer; }
+
+	// XXXX
+	private:
+	public:
+				inline void NOP()
+				{
+					EmitBYTE(0x90);
+				}
+
+				inline void INT3()
+				{
+					EmitBYTE(0xcc);
+				}
+
+				void				PUSH(EIntelReg reg);
+				void				POP(EIntelReg reg);
+
+				void				ADD(EIntelReg reg1, EIntelReg reg2);				// add	reg1, reg2
+				void				SUB(EIntelReg reg1, EIntelReg reg2);
+				void				AND(EIntelReg reg1, EIntelReg reg2);
+				void				OR(EIntelReg reg1, EIntelReg reg2);
+				void				XOR(EIntelReg reg1, EIntelReg reg2);
+
+				void				ADD64(EIntelReg reg1, EIntelReg reg2);
+				void				SUB64(EIntelReg reg1, EIntelReg reg2);
+				void				AND64(EIntelReg reg1, EIntelReg reg2);
+				void				OR64(EIntelReg reg1, EIntelReg reg2);
+				void				XOR64(EIntelReg reg1, EIntelReg reg2);
+				void				NOT64(EIntelReg reg1);
+
+				void				ADDI(EIntelReg reg, s32 data);
+				void				ANDI(EIntelReg reg, u32 data);
+				void				XOR_I32(EIntelReg reg, u32 data);
+				void				ORI64(EIntelReg reg, s32 data);						// or	reg, data (sign extended to 64 bits)
+				void				XORI64(EIntelReg reg, s32 data);
+
+				void				SHLI(EIntelReg reg, u8 sa);
+				void				SHRI(EIntelReg reg, u8 sa);
+				void				SARI(EIntelReg reg, u8 sa);
+
+				void				CMP(EIntelReg reg1, EIntelReg reg2);
+				void				CMP64(EIntelReg reg1, EIntelReg reg2);
+				void				CMPI64(EIntelReg reg, s32 data);
+				void				TEST(EIntelReg reg1, EIntelReg reg2);
+				void				TEST64(EIntelReg reg1, EIntelReg reg2);
+
+				void				CMP_MEM_BASE_OFFSET_I32( EIntelReg ibase, s32 offset, u32 data );	// cmp		dword ptr [base + offset], data
+				void				CMP_MEM_BASE_OFFSET_I8( EIntelReg ibase, s32 offset, s8 data );	// cmp		dword ptr [base + offset], data (sign extended)
+				void				ADDI_MEM_BASE_OFFSET( EIntelReg ibase, s32 offset, s8 data );		// add		dword ptr [base + offset], data (sign extended)
+
+				void				SETL(EIntelReg reg);
+				void				SETB(EIntelReg reg);
+
+				CJumpLocation		JMPLong( CCodeLabel target );
+				CJumpLocation		JNELong( CCodeLabel target );
+				CJumpLocation		JELong( CCodeLabel target );
+				CJumpLocation		JAELong( CCodeLabel target );
+
+				void				JMP_REG( EIntelReg reg );
+				void				CALL_REG( EIntelReg reg );
+				CJumpLocation		CALL( CCodeLabel target );
+				void				RET();
+
+				void				MOV(EIntelReg reg1, EIntelReg reg2);				// mov  reg1, reg2
+				void				MOV64(EIntelReg reg1, EIntelReg reg2);
+				void				MOVSXD(EIntelReg reg1, EIntelReg reg2);				// movsxd reg1, reg2	(sign extend 32 -> 64)
+				void				MOVZX8(EIntelReg reg1, EIntelReg reg2);				// movzx reg1, reg2_8
+
+				void				MOVI(EIntelReg reg, u32 data);						// mov reg, data
+				void				MOVI_64(EIntelReg reg, u64 data);					// mov reg, data
+
+				void				MOV_REG_MEM_BASE_OFFSET( EIntelReg idst, EIntelReg ibase, s32 offset );		// mov dst, dword ptr [base + offset]
+				void				MOV64_REG_MEM_BASE_OFFSET( EIntelReg idst, EIntelReg ibase, s32 offset );		// mov dst, qword ptr [base + offset]
+				void				MOV_MEM_BASE_OFFSET_REG( EIntelReg ibase, s32 offset, EIntelReg isrc );		// mov dword ptr [base + offset], src
+				void				MOV64_MEM_BASE_OFFSET_REG( EIntelReg ibase, s32 offset, EIntelReg isrc );		// mov qword ptr [base + offset], src
+
+				void				MOVI_MEM_BASE_OFFSET( EIntelReg ibase, s32 offset, u32 data );		// mov dword ptr [base + offset], data
+				void				MOVI64_MEM_BASE_OFFSET( EIntelReg ibase, s32 offset, s32 data );	// mov qword ptr [base + offset], data (sign extended)
+				void				MOVI8_MEM_BASE_OFFSET( EIntelReg ibase, s32 offset, u8 data );		// mov byte ptr [base + offset], data
+
+				void				MOV_REG_MEM_BASE_INDEX( EIntelReg idst, EIntelReg ibase, EIntelReg iindex );			// mov dst, dword ptr [base + index]
+				void				MOVSXD_REG_MEM_BASE_INDEX( EIntelReg idst, EIntelReg ibase, EIntelReg iindex );		// movsxd dst, dword ptr [base + index]
+				void				MOVSX8_REG_MEM_BASE_INDEX( EIntelReg idst, EIntelReg ibase, EIntelReg iindex );		// movsx dst, byte ptr [base + index]	(64 bit)
+				void				MOVZX8_REG_MEM_BASE_INDEX( EIntelReg idst, EIntelReg ibase, EIntelReg iindex );		// movzx dst, byte ptr [base + index]
+				void				MOVSX16_REG_MEM_BASE_INDEX( EIntelReg idst, EIntelReg ibase, EIntelReg iindex );		// movsx dst, word ptr [base + index]	(64 bit)
+				void				MOVZX16_REG_MEM_BASE_INDEX( EIntelReg idst, EIntelReg ibase, EIntelReg iindex );		// movzx dst, word ptr [base + index]
+
+				void				MOV_MEM_BASE_INDEX_REG( EIntelReg ibase, EIntelReg iindex, EIntelReg isrc );			// mov dword ptr [base + index], src
+				void				MOV16_MEM_BASE_INDEX_REG( EIntelReg ibase, EIntelReg iindex, EIntelReg isrc );		// mov word ptr [base + index], src
+				void				MOV8_MEM_BASE_INDEX_REG( EIntelReg ibase, EIntelReg iindex, EIntelReg isrc );			// mov byte ptr [base + index], src
+
+	private:
+				CJumpLocation		JumpConditionalLong( CCodeLabel target, u8 jump_type );
+
+				void				EmitREX( bool wide, u32 reg, u32 index, u32 base, bool force = false );
+				void				EmitModRM_Reg( u32 reg, u32 rm );
+				void				EmitModRM_BaseOffset( u32 reg, EIntelReg ibase, s32 offset );
+				void				EmitModRM_BaseIndex( u32 reg, EIntelReg ibase, EIntelReg iindex );
+
+				void				EmitRegReg( u8 opcode, bool wide, EIntelReg reg1, EIntelReg reg2 );
+				void				EmitGroup1Imm( u32 ext, bool wide, EIntelReg reg, s32 data );
+				void				EmitShiftImm( u32 ext, EIntelReg reg, u8 sa );
+				void				EmitRegMemBaseOffset( u8 opcode, bool wide, u32 reg, EIntelReg ibase, s32 offset );
+				void				EmitRegMemBaseIndex( u8 prefix, u8 opcode1, u8 opcode2, bool wide, bool force_rex, EIntelReg reg, EIntelReg ibase, EIntelReg iindex );
+
+		inline void EmitBYTE(u8 byte)
+		{
+			mpAssemblyBuffer->EmitBYTE( byte );
+		}
+
+		inline void EmitWORD(u16 word)
+		{
+			mpAssemblyBuffer->EmitWORD( word );
+		}
+
+		inline void EmitDWORD(u32 dword)
+		{
+			mpAssemblyBuffer->EmitDWORD( dword );
+		}
+
+	private:
+		CAssemblyBuffer *				mpAssemblyBuffer;
+};
+
+#endif // SYSPOSIX_DYNAREC_X64_ASSEMBLYWRITERX64_H_
@@ -0,0 +1,1068 @@
+/*
+Copyright (C) 2001,2005 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+
+#include "stdafx.h"
+#include "CodeGeneratorX64.h"
+
+#include <stddef.h>
+
+#include "Config/ConfigOptions.h"
+#include "Core/CPU.h"
+#include "Core/Memory.h"
+#include "Core/R4300.h"
+#include "Core/Registers.h"
+#include "Debug/DBGConsole.h"
+#include "Debug/DebugLog.h"
+#include "DynaRec/AssemblyUtils.h"
+#include "DynaRec/IndirectExitMap.h"
+#include "DynaRec/StaticAnalysis.h"
+#include "DynaRec/Trace.h"
+#include "OSHLE/ultra_R4300.h"
+
+
+using namespace AssemblyUtils;
+
+//*****************************************************************************
+//	XXXX
+//*****************************************************************************
+void Dynarec_ClearedCPUStuffToDo()
+{
+}
+void Dynarec_SetCPUStuffToDo()
+{
+}
+
+//*****************************************************************************
+//	Set up by GenerateEntryStub()
+//*****************************************************************************
+typedef void (* EntryStubFunction)( const void * p_function, const void * p_cpu_state, const void * p_rebased_mem, u32 mem_limit );
+static EntryStubFunction	gEnterDynaRecStub = NULL;
+
+//*****************************************************************************
+//
+//*****************************************************************************
+CCodeGeneratorX64::CCodeGeneratorX64( CAssemblyBuffer * p_primary, CAssemblyBuffer * p_secondary )
+:	CCodeGenerator( )
+,	CAssemblyWriterX64( p_primary )
+,	mpPrimary( p_primary )
+,	mpSecondary( p_secondary )
+,	mpBasePointer( NULL )
+{
+}
+
+//*****************************************************************************
+//	void stub( p_function (rdi), &gCPUState (rsi), g_pu8RamBase_8000 (rdx), mem_limit (ecx) )
+//
+//	Saves the callee-saved registers we use as fixed bases, then calls into the
+//	fragment. Six pushes plus the call leave the stack 16 byte aligned inside
+//	the fragment, so fragments can call out to C functions without adjusting it.
+//*****************************************************************************
+void	CCodeGeneratorX64::GenerateEntryStub( CAssemblyBuffer * p_buffer )
+{
+	CAssemblyWriterX64	writer( p_buffer );
+
+	gEnterDynaRecStub = reinterpret_cast< EntryStubFunction >( const_cast< void * >( p_buffer->GetLabel().GetTarget() ) );
+
+	writer.PUSH( RBX_CODE );
+	writer.PUSH( RBP_CODE );
+	writer.PUSH( R12_CODE );
+	writer.PUSH( R13_CODE );
+	writer.PUSH( R14_CODE );
+	writer.PUSH( R15_CODE );
+
+	writer.MOV64( CPU_STATE_BASE_REG, RSI_CODE );
+	writer.MOV64( MEMORY_BASE_REG, RDX_CODE );
+	writer.MOV( MEMORY_SIZE_REG, RCX_CODE );
+	writer.ADDI( MEMORY_SIZE_REG, s32( 0x80000000 ) );		// mem_limit - 0x80000000
+
+	writer.CALL_REG( RDI_CODE );
+
+	writer.POP( R15_CODE );
+	writer.POP( R14_CODE );
+	writer.POP( R13_CODE );
+	writer.POP( R12_CODE );
+	writer.POP( RBP_CODE );
+	writer.POP( RBX_CODE );
+	writer.RET();
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CCodeGeneratorX64::Finalise( ExceptionHandlerFn p_exception_handler_fn, const std::vector< CJumpLocation > & exception_handler_jumps )
+{
+	if( !exception_handler_jumps.empty() )
+	{
+		GenerateExceptionHander( p_exception_handler_fn, exception_handler_jumps );
+	}
+
+	SetAssemblyBuffer( NULL );
+	mpPrimary = NULL;
+	mpSecondary = NULL;
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CCodeGeneratorX64::Initialise( u32 entry_address, u32 exit_address, u32 * hit_counter, const void * p_base, const SRegisterUsageInfo & register_usage )
+{
+	if( hit_counter != NULL )
+	{
+		MOVI_64( RAX_CODE, reinterpret_cast< uintptr_t >( hit_counter ) );
+		ADDI_MEM_BASE_OFFSET( RAX_CODE, 0, 1 );
+	}
+
+	// The entry stub loads p_base into CPU_STATE_BASE_REG, so everything it points at is addressed from there.
+	// Every instruction loads its operands from gCPUState and stores its result straight back, so there's
+	// no register allocation to do and register_usage isn't needed.
+	mpBasePointer = reinterpret_cast< const u8 * >( p_base );
+}
+
+//*****************************************************************************
+//	Offsets from CPU_STATE_BASE_REG, which points at the p_base passed to Initialise
+//*****************************************************************************
+s32	CCodeGeneratorX64::CPUStateOffset( const void * p_var ) const
+{
+	s64		offset( reinterpret_cast< const u8 * >( p_var ) - mpBasePointer );
+
+	#ifdef DAEDALUS_ENABLE_ASSERTS
+	DAEDALUS_ASSERT( mpBasePointer != NULL, "Generating code before Initialise" );
+	DAEDALUS_ASSERT( offset == s32( offset ), "Variable is too far from the base pointer" );
+	#endif
+
+	return s32( offset );
+}
+
+s32	CCodeGeneratorX64::GPROffset( EN64Reg reg ) const
+{
+	return CPUStateOffset( &gCPUState.CPU[ reg ]._u64 );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+RegisterSnapshotHandle	CCodeGeneratorX64::GetRegisterSnapshot()
+{
+	// Nothing is held in host registers, so branch handlers have nothing to restore
+	return RegisterSnapshotHandle( 0 );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+CCodeLabel	CCodeGeneratorX64::GetEntryPoint() const
+{
+	return mpPrimary->GetStartAddress();
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+CCodeLabel	CCodeGeneratorX64::GetCurrentLocation() const
+{
+	return mpPrimary->GetLabel();
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+u32	CCodeGeneratorX64::GetCompiledCodeSize() const
+{
+	return mpPrimary->GetSize() + mpSecondary->GetSize();
+}
+
+//*****************************************************************************
+//	Use a direct call if the target is reachable with a 32 bit displacement,
+//	otherwise go through rax.
+//*****************************************************************************
+void	CCodeGeneratorX64::CallFunction( const void * p_function )
+{
+	const u8 *	p_current( GetAssemblyBuffer()->GetLabel().GetTargetU8P() );
+	s64			displacement( reinterpret_cast< const u8 * >( p_function ) - p_current );
+
+	if( displacement > -0x7ffff000LL && displacement < 0x7ffff000LL )
+	{
+		CALL( CCodeLabel( p_function ) );
+	}
+	else
+	{
+		MOVI_64( RAX_CODE, reinterpret_cast< uintptr_t >( p_function ) );
+		CALL_REG( RAX_CODE );
+	}
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+CJumpLocation CCodeGeneratorX64::GenerateExitCode( u32 exit_address, u32 jump_address, u32 num_instructions, CCodeLabel next_fragment )
+{
+	#ifdef DAEDALUS_ENABLE_ASSERTS
+	DAEDALUS_ASSERT( !next_fragment.IsSet() || jump_address == 0, "Shouldn't be specifying a jump address if we have a next fragment?" );
+	#endif
+
+#ifdef _DEBUG
+	if(exit_address == u32(~0))
+	{
+		INT3();
+	}
+#endif
+
+	MOVI(RDI_CODE, num_instructions);
+	CallFunction( reinterpret_cast< const void * >( CPU_UpdateCounter ) );
+
+	// This jump may be NULL, in which case we patch it below
+	// This gets patched with a jump to the next fragment if the target is later found
+	CJumpLocation jump_to_next_fragment( GenerateBranchIfNotSet( const_cast< u32 * >( &gCPUState.StuffToDo ), next_fragment ) );
+
+	// If the flag was set, we need in initialise the pc/delay to exit with
+	CCodeLabel interpret_next_fragment( GetAssemblyBuffer()->GetLabel() );
+
+	u8		exit_delay;
+
+	if( jump_address != 0 )
+	{
+		SetVar( &gCPUState.TargetPC, jump_address );
+		exit_delay = EXEC_DELAY;
+	}
+	else
+	{
+		exit_delay = NO_DELAY;
+	}
+
+	SetVar8( &gCPUState.Delay, exit_delay );
+	SetVar( &gCPUState.CurrentPC, exit_address );
+
+	// No need to call CPU_SetPC(), as this is handled by CFragment when we exit
+	RET();
+
+	// Patch up the exit jump
+	if( !next_fragment.IsSet() )
+	{
+		PatchJumpLong( jump_to_next_fragment, interpret_next_fragment );
+	}
+
+	return jump_to_next_fragment;
+}
+
+//*****************************************************************************
+// Handle branching back to the interpreter after an ERET
+//*****************************************************************************
+void CCodeGeneratorX64::GenerateEretExitCode( u32 num_instructions, CIndirectExitMap * p_map )
+{
+	MOVI(RDI_CODE, num_instructions);
+	CallFunction( reinterpret_cast< const void * >( CPU_UpdateCounter ) );
+
+	// We always exit to the interpreter, regardless of the state of gCPUState.StuffToDo
+
+	// Eret is a bit bodged so we exit at PC + 4
+	MOV_REG_MEM_BASE_OFFSET( RAX_CODE, CPU_STATE_BASE_REG, CPUStateOffset( &gCPUState.CurrentPC ) );
+	ADDI( RAX_CODE, 4 );
+	MOV_MEM_BASE_OFFSET_REG( CPU_STATE_BASE_REG, CPUStateOffset( &gCPUState.CurrentPC ), RAX_CODE );
+	SetVar8( &gCPUState.Delay, NO_DELAY );
+
+	// No need to call CPU_SetPC(), as this is handled by CFragment when we exit
+
+	RET();
+}
+
+//*****************************************************************************
+// Handle branching back to the interpreter after an indirect jump
+//*****************************************************************************
+void CCodeGeneratorX64::GenerateIndirectExitCode( u32 num_instructions, CIndirectExitMap * p_map )
+{
+	MOVI(RDI_CODE, num_instructions);
+	CallFunction( reinterpret_cast< const void * >( CPU_UpdateCounter ) );
+
+	CCodeLabel		no_target( NULL );
+	CJumpLocation	jump_to_next_fragment( GenerateBranchIfNotSet( const_cast< u32 * >( &gCPUState.StuffToDo ), no_target ) );
+
+	CCodeLabel		exit_dynarec( GetAssemblyBuffer()->GetLabel() );
+	// New return address is in gCPUState.TargetPC
+	MOV_REG_MEM_BASE_OFFSET( RAX_CODE, CPU_STATE_BASE_REG, CPUStateOffset( &gCPUState.TargetPC ) );
+	MOV_MEM_BASE_OFFSET_REG( CPU_STATE_BASE_REG, CPUStateOffset( &gCPUState.CurrentPC ), RAX_CODE );
+	SetVar8( &gCPUState.Delay, NO_DELAY );
+
+	// No need to call CPU_SetPC(), as this is handled by CFragment when we exit
+
+	RET();
+
+	// gCPUState.StuffToDo == 0, try to jump to the indirect target
+	PatchJumpLong( jump_to_next_fragment, GetAssemblyBuffer()->GetLabel() );
+
+	MOVI_64( RDI_CODE, reinterpret_cast< uintptr_t >( p_map ) );
+	MOV_REG_MEM_BASE_OFFSET( RSI_CODE, CPU_STATE_BASE_REG, CPUStateOffset( &gCPUState.TargetPC ) );
+	CallFunction( reinterpret_cast< const void * >( IndirectExitMap_Lookup ) );
+
+	// If the target was not found, exit
+	TEST64( RAX_CODE, RAX_CODE );
+	JELong( exit_dynarec );
+
+	JMP_REG( RAX_CODE );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void CCodeGeneratorX64::GenerateExceptionHander( ExceptionHandlerFn p_exception_handler_fn, const std::vector< CJumpLocation > & exception_handler_jumps )
+{
+	CCodeLabel exception_handler( GetAssemblyBuffer()->GetLabel() );
+
+	CallFunction( reinterpret_cast< const void * >( p_exception_handler_fn ) );
+	RET();
+
+	for( std::vector< CJumpLocation >::const_iterator it = exception_handler_jumps.begin(); it != exception_handler_jumps.end(); ++it )
+	{
+		CJumpLocation	jump( *it );
+		PatchJumpLong( jump, exception_handler );
+	}
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CCodeGeneratorX64::SetVar( const u32 * p_var, u32 value )
+{
+	MOVI_MEM_BASE_OFFSET( CPU_STATE_BASE_REG, CPUStateOffset( p_var ), value );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CCodeGeneratorX64::SetVar8( const u32 * p_var, u8 value )
+{
+	MOVI_MEM_BASE_OFFSET( CPU_STATE_BASE_REG, CPUStateOffset( p_var ), value );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CCodeGeneratorX64::GenerateBranchHandler( CJumpLocation branch_handler_jump, RegisterSnapshotHandle snapshot )
+{
+	PatchJumpLong( branch_handler_jump, GetAssemblyBuffer()->GetLabel() );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+CJumpLocation	CCodeGeneratorX64::GenerateBranchAlways( CCodeLabel target )
+{
+	return JMPLong( target );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+CJumpLocation	CCodeGeneratorX64::GenerateBranchIfSet( const u32 * p_var, CCodeLabel target )
+{
+	CMP_MEM_BASE_OFFSET_I8( CPU_STATE_BASE_REG, CPUStateOffset( p_var ), 0 );
+
+	return JNELong( target );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+CJumpLocation	CCodeGeneratorX64::GenerateBranchIfNotSet( const u32 * p_var, CCodeLabel target )
+{
+	CMP_MEM_BASE_OFFSET_I8( CPU_STATE_BASE_REG, CPUStateOffset( p_var ), 0 );
+
+	return JELong( target );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+CJumpLocation	CCodeGeneratorX64::GenerateBranchIfEqual8( const u32 * p_var, u8 value, CCodeLabel target )
+{
+	CMP_MEM_BASE_OFFSET_I8( CPU_STATE_BASE_REG, CPUStateOffset( p_var ), s8( value ) );
+
+	return JELong( target );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+CJumpLocation	CCodeGeneratorX64::GenerateBranchIfNotEqual32( const u32 * p_var, u32 value, CCodeLabel target )
+{
+	CMP_MEM_BASE_OFFSET_I32( CPU_STATE_BASE_REG, CPUStateOffset( p_var ), value );
+
+	return JNELong( target );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+CJumpLocation	CCodeGeneratorX64::GenerateBranchIfNotEqual8( const u32 * p_var, u8 value, CCodeLabel target )
+{
+	CMP_MEM_BASE_OFFSET_I8( CPU_STATE_BASE_REG, CPUStateOffset( p_var ), s8( value ) );
+
+	return JNELong( target );
+}
+
+//*****************************************************************************
+//	Generates instruction handler for the specified op code.
+//	Returns a jump location if an exception handler is required
+//*****************************************************************************
+CJumpLocation	CCodeGeneratorX64::GenerateOpCode( const STraceEntry& ti, bool branch_delay_slot, const SBranchDetails * p_branch, CJumpLocation * p_branch_jump)
+{
+	u32 address = ti.Address;
+	bool exception = false;
+	OpCode op_code = ti.OpCode;
+
+	if (op_code._u32 == 0)
+	{
+		if( branch_delay_slot )
+		{
+			SetVar8( &gCPUState.Delay, NO_DELAY );
+		}
+		return CJumpLocation();
+	}
+
+	if( branch_delay_slot )
+	{
+		SetVar8( &gCPUState.Delay, EXEC_DELAY );
+	}
+
+	const EN64Reg	rs = EN64Reg( op_code.rs );
+	const EN64Reg	rt = EN64Reg( op_code.rt );
+	const EN64Reg	rd = EN64Reg( op_code.rd );
+	const u32		sa = op_code.sa;
+	const EN64Reg	base = EN64Reg( op_code.base );
+	const u32		ft = op_code.ft;
+
+	CJumpLocation	exception_handler;
+	CCodeLabel		no_target( NULL );
+
+	// Memory accesses are inlined for RDRAM, anything else falls back to the
+	// interpreter in the secondary buffer (which sets up exception_handler)
+	bool handled = false;
+	switch(op_code.op)
+	{
+		case OP_J:			handled = true; break;
+		case OP_JAL:		GenerateJAL( address ); handled = true; break;
+		case OP_CACHE:		GenerateCACHE( base, op_code.immediate, rt ); handled = true; break;
+
+		case OP_LW:			GenerateLW( ti, rt, base, s16(op_code.immediate), &exception_handler ); handled = true; break;
+		case OP_LB:			GenerateLB( ti, rt, base, s16(op_code.immediate), &exception_handler ); handled = true; break;
+		case OP_LBU:		GenerateLBU( ti, rt, base, s16(op_code.immediate), &exception_handler ); handled = true; break;
+		case OP_LH:			GenerateLH( ti, rt, base, s16(op_code.immediate), &exception_handler ); handled = true; break;
+		case OP_LHU:		GenerateLHU( ti, rt, base, s16(op_code.immediate), &exception_handler ); handled = true; break;
+		case OP_LWC1:		GenerateLWC1( ti, ft, base, s16(op_code.immediate), &exception_handler ); handled = true; break;
+		case OP_SW:			GenerateSW( ti, rt, base, s16(op_code.immediate), &exception_handler ); handled = true; break;
+		case OP_SH:			GenerateSH( ti, rt, base, s16(op_code.immediate), &exception_handler ); handled = true; break;
+		case OP_SB:			GenerateSB( ti, rt, base, s16(op_code.immediate), &exception_handler ); handled = true; break;
+		case OP_SWC1:		GenerateSWC1( ti, ft, base, s16(op_code.immediate), &exception_handler ); handled = true; break;
+
+		case OP_ADDIU:
+		case OP_ADDI:		GenerateADDIU( rt, rs, s16(op_code.immediate) ); handled = true; break;
+		case OP_ANDI:		GenerateANDI( rt, rs, op_code.immediate ); handled = true; break;
+		case OP_ORI:		GenerateORI( rt, rs, op_code.immediate ); handled = true; break;
+		case OP_XORI:		GenerateXORI( rt, rs, op_code.immediate ); handled = true; break;
+		case OP_LUI:		GenerateLUI( rt, s16(op_code.immediate) ); handled = true; break;
+		case OP_SLTI:		GenerateSLTI( rt, rs, s16(op_code.immediate), false ); handled = true; break;
+		case OP_SLTIU:		GenerateSLTI( rt, rs, s16(op_code.immediate), true ); handled = true; break;
+
+		case OP_SPECOP:
+			{
+				switch(op_code.spec_op)
+				{
+				case SpecOp_SLL:	GenerateSLL( rd, rt, sa );	handled = true; break;
+				case SpecOp_SRA:	GenerateSRA( rd, rt, sa );	handled = true; break;
+				case SpecOp_SRL:	GenerateSRL( rd, rt, sa );	handled = true; break;
+
+				case SpecOp_ADDU:	GenerateADDU( rd, rs, rt );	handled = true; break;
+				case SpecOp_SUBU:	GenerateSUBU( rd, rs, rt );	handled = true; break;
+				case SpecOp_AND:	GenerateAND( rd, rs, rt );	handled = true; break;
+				case SpecOp_OR:		GenerateOR( rd, rs, rt );	handled = true; break;
+				case SpecOp_XOR:	GenerateXOR( rd, rs, rt );	handled = true; break;
+				case SpecOp_NOR:	GenerateNOR( rd, rs, rt );	handled = true; break;
+				case SpecOp_SLT:	GenerateSLT( rd, rs, rt, false );	handled = true; break;
+				case SpecOp_SLTU:	GenerateSLT( rd, rs, rt, true );	handled = true; break;
+				default:
+					break;
+				}
+			}
+			break;
+
+		default:
+			break;
+	}
+
+	if (!handled)
+	{
+		if( R4300_InstructionHandlerNeedsPC( op_code ) )
+		{
+			SetVar( &gCPUState.CurrentPC, address );
+			exception = true;
+		}
+		GenerateGenericR4300( op_code, R4300_GetInstructionHandler( op_code ) );
+	}
+
+	if( exception )
+	{
+		exception_handler = GenerateBranchIfSet( const_cast< u32 * >( &gCPUState.StuffToDo ), no_target );
+	}
+
+	// Check whether we want to invert the status of this branch
+	if( p_branch != NULL )
+	{
+		//
+		// Check if the branch has been taken
+		//
+		if( p_branch->Direct )
+		{
+			if( p_branch->ConditionalBranchTaken )
+			{
+				*p_branch_jump = GenerateBranchIfNotEqual8( &gCPUState.Delay, DO_DELAY, no_target );
+			}
+			else
+			{
+				*p_branch_jump = GenerateBranchIfEqual8( &gCPUState.Delay, DO_DELAY, no_target );
+			}
+		}
+		else
+		{
+			// XXXX eventually just exit here, and skip default exit code below
+			if( p_branch->Eret )
+			{
+				*p_branch_jump = GenerateBranchAlways( no_target );
+			}
+			else
+			{
+				*p_branch_jump = GenerateBranchIfNotEqual32( &gCPUState.TargetPC, p_branch->TargetAddress, no_target );
+			}
+		}
+	}
+	else
+	{
+		if( branch_delay_slot )
+		{
+			SetVar8( &gCPUState.Delay, NO_DELAY );
+		}
+	}
+
+	return exception_handler;
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CCodeGeneratorX64::GenerateGenericR4300( OpCode op_code, CPU_Instruction p_instruction )
+{
+	// XXXX Flush all fp registers before a generic call
+
+	MOVI(RDI_CODE, op_code._u32);
+	CallFunction( reinterpret_cast< const void * >( p_instruction ) );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+CJumpLocation CCodeGeneratorX64::ExecuteNativeFunction( CCodeLabel speed_hack, bool check_return )
+{
+	CallFunction( speed_hack.GetTarget() );
+	if( check_return )
+	{
+		TEST( RAX_CODE, RAX_CODE );
+
+		return JELong( CCodeLabel(NULL) );
+	}
+	else
+	{
+		return CJumpLocation(NULL);
+	}
+}
+
+//*****************************************************************************
+//	Register file helpers
+//*****************************************************************************
+void	CCodeGeneratorX64::LoadGPRLo( EIntelReg reg, EN64Reg mreg )
+{
+	if( mreg == N64Reg_R0 )
+	{
+		MOVI( reg, 0 );
+	}
+	else
+	{
+		MOV_REG_MEM_BASE_OFFSET( reg, CPU_STATE_BASE_REG, GPROffset( mreg ) );
+	}
+}
+
+void	CCodeGeneratorX64::LoadGPR64( EIntelReg reg, EN64Reg mreg )
+{
+	if( mreg == N64Reg_R0 )
+	{
+		MOVI( reg, 0 );
+	}
+	else
+	{
+		MOV64_REG_MEM_BASE_OFFSET( reg, CPU_STATE_BASE_REG, GPROffset( mreg ) );
+	}
+}
+
+void	CCodeGeneratorX64::StoreGPR64( EN64Reg mreg, EIntelReg reg )
+{
+	MOV64_MEM_BASE_OFFSET_REG( CPU_STATE_BASE_REG, GPROffset( mreg ), reg );
+}
+
+void	CCodeGeneratorX64::StoreGPRSignExtend( EN64Reg mreg, EIntelReg reg )
+{
+	MOVSXD( reg, reg );
+	StoreGPR64( mreg, reg );
+}
+
+//*****************************************************************************
+//	Computes the address into ecx and checks that it falls in RDRAM
+//	(0x80000000 + gRamSize). Returns the jump to the slow path, which is
+//	generated by GenerateMemoryAccessEnd(). On the fast path rcx is left
+//	holding the (twiddled) offset from MEMORY_BASE_REG, and rdx the offset
+//	into RDRAM, for GenerateMarkDirtyPage().
+//	With fastmem, MEMORY_BASE_REG is gFastmemBase and RDRAM is mapped at
+//	0xA0000000 as well, so KSEG1 accesses can take the fast path too. The
+//	check stays, as the slow path has to be able to raise exceptions.
+//*****************************************************************************
+CCodeGeneratorX64::SMemoryAccess	CCodeGeneratorX64::GenerateMemoryAccess( const STraceEntry& ti, EN64Reg base, s16 offset, u8 twiddle )
+{
+	LoadGPRLo( RCX_CODE, base );
+	ADDI( RCX_CODE, offset );
+	MOV( RDX_CODE, RCX_CODE );
+#ifdef DAEDALUS_FASTMEM
+	if( gFastmemBase != NULL )
+	{
+		ANDI( RDX_CODE, 0xdfffffff );
+	}
+#endif
+	XOR_I32( RDX_CODE, 0x80000000 );
+	CMP( RDX_CODE, MEMORY_SIZE_REG );
+
+	CJumpLocation	slow_path_jump( JAELong( CCodeLabel( NULL ) ) );
+	SMemoryAccess	access = { slow_path_jump, mpPrimary->GetLabel() };
+
+	if( twiddle != 0 )
+	{
+		XOR_I32( RCX_CODE, twiddle );
+	}
+
+	return access;
+}
+
+//*****************************************************************************
+//	Emit the slow path into the secondary buffer. TLB mapped addresses are
+//	looked up in g_TLBCache first, and on a hit rcx is rebased so the access
+//	on the fast path reaches the right host page (and rdx is set to the RDRAM
+//	offset, as GenerateMemoryAccess() would have). Anything else calls the
+//	interpreter handler, which deals with TLB misses and hardware registers.
+//*****************************************************************************
+void	CCodeGeneratorX64::GenerateMemoryAccessEnd( const STraceEntry& ti, const SMemoryAccess & access, CJumpLocation * p_exception_jump )
+{
+	DAEDALUS_STATIC_ASSERT( sizeof( TLBCacheEntry ) == 16 );
+
+	CCodeLabel		continue_location( mpPrimary->GetLabel() );
+
+	SetAssemblyBuffer( mpSecondary );
+
+	PatchJumpLong( access.SlowPathJump, mpSecondary->GetLabel() );
+
+	// ecx holds the untwiddled virtual address
+	MOV( RDX_CODE, RCX_CODE );
+	SHRI( RDX_CODE, TLB_CACHE_PAGE_SHIFT );
+	ANDI( RDX_CODE, TLB_CACHE_MASK );
+	SHLI( RDX_CODE, 4 );
+	MOVI_64( RAX_CODE, reinterpret_cast< u64 >( g_TLBCache ) );
+	ADD64( RAX_CODE, RDX_CODE );
+	MOV_REG_MEM_BASE_OFFSET( RDX_CODE, RAX_CODE, offsetof( TLBCacheEntry, VPage ) );
+	XOR( RDX_CODE, RCX_CODE );
+	SHRI( RDX_CODE, TLB_CACHE_PAGE_SHIFT );
+	CJumpLocation	tlb_miss( JNELong( CCodeLabel( NULL ) ) );
+
+	MOV64_REG_MEM_BASE_OFFSET( RAX_CODE, RAX_CODE, offsetof( TLBCacheEntry, Base ) );
+	MOVI_64( RDX_CODE, 0 - reinterpret_cast< u64 >( g_pu8RamBase ) );
+	ADD64( RDX_CODE, RAX_CODE );
+	ADD64( RDX_CODE, RCX_CODE );
+	SUB64( RAX_CODE, MEMORY_BASE_REG );
+	ADD64( RCX_CODE, RAX_CODE );
+	JMPLong( access.FastPathLabel );
+
+	PatchJumpLong( tlb_miss, mpSecondary->GetLabel() );
+
+	SetVar( &gCPUState.CurrentPC, ti.Address );
+	GenerateGenericR4300( ti.OpCode, R4300_GetInstructionHandler( ti.OpCode ) );
+	*p_exception_jump = GenerateBranchIfSet( const_cast< u32 * >( &gCPUState.StuffToDo ), CCodeLabel( NULL ) );
+	JMPLong( continue_location );
+
+	SetAssemblyBuffer( mpPrimary );
+}
+
+//*****************************************************************************
+//	Marks the page of RDRAM a store on the fast path just wrote to (see
+//	Core/DirtyPages.h). Expects rdx to hold the RDRAM offset. Trashes rax.
+//*****************************************************************************
+void	CCodeGeneratorX64::GenerateMarkDirtyPage()
+{
+	SHRI( RDX_CODE, kDirtyPageShift );
+	ANDI( RDX_CODE, kNumDirtyPages - 1 );
+	MOVI_64( RAX_CODE, reinterpret_cast< u64 >( gDirtyPages ) );
+	ADD64( RAX_CODE, RDX_CODE );
+	MOVI8_MEM_BASE_OFFSET( RAX_CODE, 0, 1 );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void	CCodeGeneratorX64::GenerateCACHE( EN64Reg base, s16 offset, u32 cache_op )
+{
+	u32 dwCache = cache_op & 0x3;
+	u32 dwAction = (cache_op >> 2) & 0x7;
+
+	// For instruction cache invalidation, make sure we let the CPU know so the whole
+	// dynarec system can be invalidated
+	if(dwCache == 0 && (dwAction == 0 || dwAction == 4))
+	{
+		LoadGPRLo( RDI_CODE, base );
+		ADDI( RDI_CODE, offset );
+		MOVI( RSI_CODE, 0x20 );
+		CallFunction( reinterpret_cast< const void * >( CPU_InvalidateICacheRange ) );
+	}
+	else
+	{
+		// We don't care about data cache etc
+	}
+}
+
+void	CCodeGeneratorX64::GenerateLW( const STraceEntry& ti, EN64Reg rt, EN64Reg base, s16 offset, CJumpLocation * p_exception_jump )
+{
+	SMemoryAccess	access( GenerateMemoryAccess( ti, base, offset, 0 ) );
+
+	if( rt != N64Reg_R0 )
+	{
+		MOVSXD_REG_MEM_BASE_INDEX( RAX_CODE, MEMORY_BASE_REG, RCX_CODE );
+		StoreGPR64( rt, RAX_CODE );
+	}
+
+	GenerateMemoryAccessEnd( ti, access, p_exception_jump );
+}
+
+void	CCodeGeneratorX64::GenerateLB( const STraceEntry& ti, EN64Reg rt, EN64Reg base, s16 offset, CJumpLocation * p_exception_jump )
+{
+	SMemoryAccess	access( GenerateMemoryAccess( ti, base, offset, U8_TWIDDLE ) );
+
+	if( rt != N64Reg_R0 )
+	{
+		MOVSX8_REG_MEM_BASE_INDEX( RAX_CODE, MEMORY_BASE_REG, RCX_CODE );
+		StoreGPR64( rt, RAX_CODE );
+	}
+
+	GenerateMemoryAccessEnd( ti, access, p_exception_jump );
+}
+
+void	CCodeGeneratorX64::GenerateLBU( const STraceEntry& ti, EN64Reg rt, EN64Reg base, s16 offset, CJumpLocation * p_exception_jump )
+{
+	SMemoryAccess	access( GenerateMemoryAccess( ti, base, offset, U8_TWIDDLE ) );
+
+	if( rt != N64Reg_R0 )
+	{
+		MOVZX8_REG_MEM_BASE_INDEX( RAX_CODE, MEMORY_BASE_REG, RCX_CODE );
+		StoreGPR64( rt, RAX_CODE );
+	}
+
+	GenerateMemoryAccessEnd( ti, access, p_exception_jump );
+}
+
+void	CCodeGeneratorX64::GenerateLH( const STraceEntry& ti, EN64Reg rt, EN64Reg base, s16 offset, CJumpLocation * p_exception_jump )
+{
+	SMemoryAccess	access( GenerateMemoryAccess( ti, base, offset, U16_TWIDDLE ) );
+
+	if( rt != N64Reg_R0 )
+	{
+		MOVSX16_REG_MEM_BASE_INDEX( RAX_CODE, MEMORY_BASE_REG, RCX_CODE );
+		StoreGPR64( rt, RAX_CODE );
+	}
+
+	GenerateMemoryAccessEnd( ti, access, p_exception_jump );
+}
+
+void	CCodeGeneratorX64::GenerateLHU( const STraceEntry& ti, EN64Reg rt, EN64Reg base, s16 offset, CJumpLocation * p_exception_jump )
+{
+	SMemoryAccess	access( GenerateMemoryAccess( ti, base, offset, U16_TWIDDLE ) );
+
+	if( rt != N64Reg_R0 )
+	{
+		MOVZX16_REG_MEM_BASE_INDEX( RAX_CODE, MEMORY_BASE_REG, RCX_CODE );
+		StoreGPR64( rt, RAX_CODE );
+	}
+
+	GenerateMemoryAccessEnd( ti, access, p_exception_jump );
+}
+
+void	CCodeGeneratorX64::GenerateLWC1( const STraceEntry& ti, u32 ft, EN64Reg base, s16 offset, CJumpLocation * p_exception_jump )
+{
+	SMemoryAccess	access( GenerateMemoryAccess( ti, base, offset, 0 ) );
+
+	MOV_REG_MEM_BASE_INDEX( RAX_CODE, MEMORY_BASE_REG, RCX_CODE );
+	MOV_MEM_BASE_OFFSET_REG( CPU_STATE_BASE_REG, CPUStateOffset( &gCPUState.FPU[ft]._u32 ), RAX_CODE );
+
+	GenerateMemoryAccessEnd( ti, access, p_exception_jump );
+}
+
+void	CCodeGeneratorX64::GenerateSW( const STraceEntry& ti, EN64Reg rt, EN64Reg base, s16 offset, CJumpLocation * p_exception_jump )
+{
+	SMemoryAccess	access( GenerateMemoryAccess( ti, base, offset, 0 ) );
+
+	LoadGPRLo( RAX_CODE, rt );
+	MOV_MEM_BASE_INDEX_REG( MEMORY_BASE_REG, RCX_CODE, RAX_CODE );
+	GenerateMarkDirtyPage();
+
+	GenerateMemoryAccessEnd( ti, access, p_exception_jump );
+}
+
+void	CCodeGeneratorX64::GenerateSH( const STraceEntry& ti, EN64Reg rt, EN64Reg base, s16 offset, CJumpLocation * p_exception_jump )
+{
+	SMemoryAccess	access( GenerateMemoryAccess( ti, base, offset, U16_TWIDDLE ) );
+
+	LoadGPRLo( RAX_CODE, rt );
+	MOV16_MEM_BASE_INDEX_REG( MEMORY_BASE_REG, RCX_CODE, RAX_CODE );
+	GenerateMarkDirtyPage();
+
+	GenerateMemoryAccessEnd( ti, access, p_exception_jump );
+}
+
+void	CCodeGeneratorX64::GenerateSB( const STraceEntry& ti, EN64Reg rt, EN64Reg base, s16 offset, CJumpLocation * p_exception_jump )
+{
+	SMemoryAccess	access( GenerateMemoryAccess( ti, base, offset, U8_TWIDDLE ) );
+
+	LoadGPRLo( RAX_CODE, rt );
+	MOV8_MEM_BASE_INDEX_REG( MEMORY_BASE_REG, RCX_CODE, RAX_CODE );
+	GenerateMarkDirtyPage();
+
+	GenerateMemoryAccessEnd( ti, access, p_exception_jump );
+}
+
+void	CCodeGeneratorX64::GenerateSWC1( const STraceEntry& ti, u32 ft, EN64Reg base, s16 offset, CJumpLocation * p_exception_jump )
+{
+	SMemoryAccess	access( GenerateMemoryAccess( ti, base, offset, 0 ) );
+
+	MOV_REG_MEM_BASE_OFFSET( RAX_CODE, CPU_STATE_BASE_REG, CPUStateOffset( &gCPUState.FPU[ft]._u32 ) );
+	MOV_MEM_BASE_INDEX_REG( MEMORY_BASE_REG, RCX_CODE, RAX_CODE );
+	GenerateMarkDirtyPage();
+
+	GenerateMemoryAccessEnd( ti, access, p_exception_jump );
+}
+
+//*****************************************************************************
+//	ALU ops. Writes to r0 are discarded.
+//*****************************************************************************
+void	CCodeGeneratorX64::GenerateADDIU( EN64Reg rt, EN64Reg rs, s16 immediate )
+{
+	if( rt == N64Reg_R0 )
+		return;
+
+	LoadGPRLo( RAX_CODE, rs );
+	ADDI( RAX_CODE, immediate );
+	StoreGPRSignExtend( rt, RAX_CODE );
+}
+
+void	CCodeGeneratorX64::GenerateANDI( EN64Reg rt, EN64Reg rs, u16 immediate )
+{
+	if( rt == N64Reg_R0 )
+		return;
+
+	// 32 bit ops zero the upper half of rax
+	LoadGPRLo( RAX_CODE, rs );
+	ANDI( RAX_CODE, immediate );
+	StoreGPR64( rt, RAX_CODE );
+}
+
+void	CCodeGeneratorX64::GenerateORI( EN64Reg rt, EN64Reg rs, u16 immediate )
+{
+	if( rt == N64Reg_R0 )
+		return;
+
+	LoadGPR64( RAX_CODE, rs );
+	ORI64( RAX_CODE, immediate );
+	StoreGPR64( rt, RAX_CODE );
+}
+
+void	CCodeGeneratorX64::GenerateXORI( EN64Reg rt, EN64Reg rs, u16 immediate )
+{
+	if( rt == N64Reg_R0 )
+		return;
+
+	LoadGPR64( RAX_CODE, rs );
+	XORI64( RAX_CODE, immediate );
+	StoreGPR64( rt, RAX_CODE );
+}
+
+void	CCodeGeneratorX64::GenerateLUI( EN64Reg rt, s16 immediate )
+{
+	if( rt == N64Reg_R0 )
+		return;
+
+	MOVI64_MEM_BASE_OFFSET( CPU_STATE_BASE_REG, GPROffset( rt ), s32( immediate ) << 16 );
+}
+
+void	CCodeGeneratorX64::GenerateSLTI( EN64Reg rt, EN64Reg rs, s16 immediate, bool is_unsigned )
+{
+	if( rt == N64Reg_R0 )
+		return;
+
+	// The immediate is sign extended for both the signed and unsigned compare
+	LoadGPR64( RAX_CODE, rs );
+	CMPI64( RAX_CODE, immediate );
+	if( is_unsigned )	SETB( RAX_CODE );
+	else				SETL( RAX_CODE );
+	MOVZX8( RAX_CODE, RAX_CODE );
+	StoreGPR64( rt, RAX_CODE );
+}
+
+void	CCodeGeneratorX64::GenerateADDU( EN64Reg rd, EN64Reg rs, EN64Reg rt )
+{
+	if( rd == N64Reg_R0 )
+		return;
+
+	LoadGPRLo( RAX_CODE, rs );
+	LoadGPRLo( RDX_CODE, rt );
+	ADD( RAX_CODE, RDX_CODE );
+	StoreGPRSignExtend( rd, RAX_CODE );
+}
+
+void	CCodeGeneratorX64::GenerateSUBU( EN64Reg rd, EN64Reg rs, EN64Reg rt )
+{
+	if( rd == N64Reg_R0 )
+		return;
+
+	LoadGPRLo( RAX_CODE, rs );
+	LoadGPRLo( RDX_CODE, rt );
+	SUB( RAX_CODE, RDX_CODE );
+	StoreGPRSignExtend( rd, RAX_CODE );
+}
+
+void	CCodeGeneratorX64::GenerateAND( EN64Reg rd, EN64Reg rs, EN64Reg rt )
+{
+	if( rd == N64Reg_R0 )
+		return;
+
+	LoadGPR64( RAX_CODE, rs );
+	LoadGPR64( RDX_CODE, rt );
+	AND64( RAX_CODE, RDX_CODE );
+	StoreGPR64( rd, RAX_CODE );
+}
+
+void	CCodeGeneratorX64::GenerateOR( EN64Reg rd, EN64Reg rs, EN64Reg rt )
+{
+	if( rd == N64Reg_R0 )
+		return;
+
+	LoadGPR64( RAX_CODE, rs );
+	LoadGPR64( RDX_CODE, rt );
+	OR64( RAX_CODE, RDX_CODE );
+	StoreGPR64( rd, RAX_CODE );
+}
+
+void	CCodeGeneratorX64::GenerateXOR( EN64Reg rd, EN64Reg rs, EN64Reg rt )
+{
+	if( rd == N64Reg_R0 )
+		return;
+
+	LoadGPR64( RAX_CODE, rs );
+	LoadGPR64( RDX_CODE, rt );
+	XOR64( RAX_CODE, RDX_CODE );
+	StoreGPR64( rd, RAX_CODE );
+}
+
+void	CCodeGeneratorX64::GenerateNOR( EN64Reg rd, EN64Reg rs, EN64Reg rt )
+{
+	if( rd == N64Reg_R0 )
+		return;
+
+	LoadGPR64( RAX_CODE, rs );
+	LoadGPR64( RDX_CODE, rt );
+	OR64( RAX_CODE, RDX_CODE );
+	NOT64( RAX_CODE );
+	StoreGPR64( rd, RAX_CODE );
+}
+
+void	CCodeGeneratorX64::GenerateSLT( EN64Reg rd, EN64Reg rs, EN64Reg rt, bool is_unsigned )
+{
+	if( rd == N64Reg_R0 )
+		return;
+
+	LoadGPR64( RAX_CODE, rs );
+	LoadGPR64( RDX_CODE, rt );
+	CMP64( RAX_CODE, RDX_CODE );
+	if( is_unsigned )	SETB( RAX_CODE );
+	else				SETL( RAX_CODE );
+	MOVZX8( RAX_CODE, RAX_CODE );
+	StoreGPR64( rd, RAX_CODE );
+}
+
+void	CCodeGeneratorX64::GenerateSLL( EN64Reg rd, EN64Reg rt, u32 sa )
+{
+	if( rd == N64Reg_R0 )
+		return;
+
+	LoadGPRLo( RAX_CODE, rt );
+	SHLI( RAX_CODE, sa );
+	StoreGPRSignExtend( rd, RAX_CODE );
+}
+
+void	CCodeGeneratorX64::GenerateSRL( EN64Reg rd, EN64Reg rt, u32 sa )
+{
+	if( rd == N64Reg_R0 )
+		return;
+
+	LoadGPRLo( RAX_CODE, rt );
+	SHRI( RAX_CODE, sa );
+	StoreGPRSignExtend( rd, RAX_CODE );
+}
+
+void	CCodeGeneratorX64::GenerateSRA( EN64Reg rd, EN64Reg rt, u32 sa )
+{
+	if( rd == N64Reg_R0 )
+		return;
+
+	LoadGPRLo( RAX_CODE, rt );
+	SARI( RAX_CODE, sa );
+	StoreGPRSignExtend( rd, RAX_CODE );
+}
+
+void	CCodeGeneratorX64::GenerateJAL( u32 address )
+{
+	MOVI64_MEM_BASE_OFFSET( CPU_STATE_BASE_REG, GPROffset( N64Reg_RA ), s32( address + 8 ) );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void R4300_CALL_TYPE _EnterDynaRec( const void * p_function, const void * p_base_pointer, const void * p_rebased_mem, u32 mem_limit )
+{
+	#ifdef DAEDALUS_ENABLE_ASSERTS
+	DAEDALUS_ASSERT( gEnterDynaRecStub != NULL, "Dynarec entry stub hasn't been generated" );
+	#endif
+
+#ifdef DAEDALUS_FASTMEM
+	// Fragments index the whole fastmem region rather than rebased RDRAM (see GenerateMemoryAccess)
+	if( gFastmemBase != NULL )
+	{
+		p_rebased_mem = gFastmemBase;
+	}
+#endif
+
+	gEnterDynaRecStub( p_function, p_base_pointer, p_rebased_mem, mem_limit );
+}
@@ -0,0 +1,133 @@
+/*
+Copyright (C) 2001,2005 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#pragma once
+
+#ifndef SYSPOSIX_DYNAREC_X64_CODEGENERATORX64_H_
+#define SYSPOSIX_DYNAREC_X64_CODEGENERATORX64_H_
+
+#include "DynaRec/CodeGenerator.h"
+#include "AssemblyWriterX64.h"
+#include "DynarecTargetX64.h"
+#include "DynaRec/TraceRecorder.h"
+
+class CCodeGeneratorX64 : public CCodeGenerator, public CAssemblyWriterX64
+{
+	public:
+		CCodeGeneratorX64( CAssemblyBuffer * p_primary, CAssemblyBuffer * p_secondary );
+
+		// Emits the trampoline used by _EnterDynaRec to set up the fixed base registers.
+		// This must be generated once, before any fragments are executed.
+		static void					GenerateEntryStub( CAssemblyBuffer * p_buffer );
+
+		virtual void				Initialise( u32 entry_address, u32 exit_address, u32 * hit_counter, const void * p_base, const SRegisterUsageInfo & register_usage );
+		virtual void				Finalise( ExceptionHandlerFn p_exception_handler_fn, const std::vector< CJumpLocation > & exception_handler_jumps );
+
+		virtual RegisterSnapshotHandle	GetRegisterSnapshot();
+
+		virtual CCodeLabel			GetEntryPoint() const;
+		virtual CCodeLabel			GetCurrentLocation() const;
+		virtual u32					GetCompiledCodeSize() const;
+
+		virtual	CJumpLocation		GenerateExitCode( u32 exit_address, u32 jump_address, u32 num_instructions, CCodeLabel next_fragment );
+		virtual void				GenerateEretExitCode( u32 num_instructions, CIndirectExitMap * p_map );
+		virtual void				GenerateIndirectExitCode( u32 num_instructions, CIndirectExitMap * p_map );
+
+		virtual void				GenerateBranchHandler( CJumpLocation branch_handler_jump, RegisterSnapshotHandle snapshot );
+
+		virtual CJumpLocation		GenerateOpCode( const STraceEntry& ti, bool branch_delay_slot, const SBranchDetails * p_branch, CJumpLocation * p_branch_jump);
+
+		virtual CJumpLocation		ExecuteNativeFunction( CCodeLabel speed_hack, bool check_return );
+
+	private:
+				void				SetVar( const u32 * p_var, u32 value );
+				void				SetVar8( const u32 * p_var, u8 value );
+
+				void				CallFunction( const void * p_function );
+
+				CJumpLocation		GenerateBranchAlways( CCodeLabel target );
+				CJumpLocation		GenerateBranchIfSet( const u32 * p_var, CCodeLabel target );
+				CJumpLocation		GenerateBranchIfNotSet( const u32 * p_var, CCodeLabel target );
+				CJumpLocation		GenerateBranchIfEqual8( const u32 * p_var, u8 value, CCodeLabel target );
+				CJumpLocation		GenerateBranchIfNotEqual32( const u32 * p_var, u32 value, CCodeLabel target );
+				CJumpLocation		GenerateBranchIfNotEqual8( const u32 * p_var, u8 value, CCodeLabel target );
+
+				void				GenerateGenericR4300( OpCode op_code, CPU_Instruction p_instruction );
+
+				void				GenerateExceptionHander( ExceptionHandlerFn p_exception_handler_fn, const std::vector< CJumpLocation > & exception_handler_jumps );
+	private:
+				CAssemblyBuffer *	mpPrimary;
+				CAssemblyBuffer *	mpSecondary;
+				const u8 *			mpBasePointer;
+
+				s32					CPUStateOffset( const void * p_var ) const;
+				s32					GPROffset( EN64Reg reg ) const;
+
+	private:
+				// Register file helpers. Results are always written back as 64 bit values
+				void	LoadGPRLo( EIntelReg reg, EN64Reg mreg );
+				void	LoadGPR64( EIntelReg reg, EN64Reg mreg );
+				void	StoreGPR64( EN64Reg mreg, EIntelReg reg );
+				void	StoreGPRSignExtend( EN64Reg mreg, EIntelReg reg );
+
+				struct SMemoryAccess
+				{
+					CJumpLocation	SlowPathJump;
+					CCodeLabel		FastPathLabel;		// Where the slow path rejoins when the address is in the TLB cache
+				};
+
+				SMemoryAccess	GenerateMemoryAccess( const STraceEntry& ti, EN64Reg base, s16 offset, u8 twiddle );
+				void			GenerateMemoryAccessEnd( const STraceEntry& ti, const SMemoryAccess & access, CJumpLocation * p_exception_jump );
+				void			GenerateMarkDirtyPage();
+
+				void	GenerateCACHE( EN64Reg base, s16 offset, u32 cache_op );
+				void	GenerateLW( const STraceEntry& ti, EN64Reg rt, EN64Reg base, s16 offset, CJumpLocation * p_exception_jump );
+				void	GenerateLB( const STraceEntry& ti, EN64Reg rt, EN64Reg base, s16 offset, CJumpLocation * p_exception_jump );
+				void	GenerateLBU( const STraceEntry& ti, EN64Reg rt, EN64Reg base, s16 offset, CJumpLocation * p_exception_jump );
+				void	GenerateLH( const STraceEntry& ti, EN64Reg rt, EN64Reg base, s16 offset, CJumpLocation * p_exception_jump );
+				void	GenerateLHU( const STraceEntry& ti, EN64Reg rt, EN64Reg base, s16 offset, CJumpLocation * p_exception_jump );
+				void	GenerateLWC1( const STraceEntry& ti, u32 ft, EN64Reg base, s16 offset, CJumpLocation * p_exception_jump );
+				void	GenerateSW( const STraceEntry& ti, EN64Reg rt, EN64Reg base, s16 offset, CJumpLocation * p_exception_jump );
+				void	GenerateSH( const STraceEntry& ti, EN64Reg rt, EN64Reg base, s16 offset, CJumpLocation * p_exception_jump );
+				void	GenerateSB( const STraceEntry& ti, EN64Reg rt, EN64Reg base, s16 offset, CJumpLocation * p_exception_jump );
+				void	GenerateSWC1( const STraceEntry& ti, u32 ft, EN64Reg base, s16 offset, CJumpLocation * p_exception_jump );
+
+				void	GenerateADDIU( EN64Reg rt, EN64Reg rs, s16 immediate );
+				void	GenerateANDI( EN64Reg rt, EN64Reg rs, u16 immediate );
+				void	GenerateORI( EN64Reg rt, EN64Reg rs, u16 immediate );
+				void	GenerateXORI( EN64Reg rt, EN64Reg rs, u16 immediate );
+				void	GenerateLUI( EN64Reg rt, s16 immediate );
+				void	GenerateSLTI( EN64Reg rt, EN64Reg rs, s16 immediate, bool is_unsigned );
+
+				void	GenerateADDU( EN64Reg rd, EN64Reg rs, EN64Reg rt );
+				void	GenerateSUBU( EN64Reg rd, EN64Reg rs, EN64Reg rt );
+				void	GenerateAND( EN64Reg rd, EN64Reg rs, EN64Reg rt );
+				void	GenerateOR( EN64Reg rd, EN64Reg rs, EN64Reg rt );
+				void	GenerateXOR( EN64Reg rd, EN64Reg rs, EN64Reg rt );
+				void	GenerateNOR( EN64Reg rd, EN64Reg rs, EN64Reg rt );
+				void	GenerateSLT( EN64Reg rd, EN64Reg rs, EN64Reg rt, bool is_unsigned );
+
+				void	GenerateJAL( u32 address );
+
+				void	GenerateSLL( EN64Reg rd, EN64Reg rt, u32 sa );
+				void	GenerateSRL( EN64Reg rd, EN64Reg rt, u32 sa );
+				void	GenerateSRA( EN64Reg rd, EN64Reg rt, u32 sa );
+};
+
+#endif // SYSPOSIX_DYNAREC_X64_CODEGENERATORX64_H_
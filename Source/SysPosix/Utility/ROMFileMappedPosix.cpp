@@ -0,0 +1,233 @@
+/*
+Copyright (C) 2006 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#include "stdafx.h"
+#include "Utility/ROMFileMapped.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Utility/IO.h"
+#include "Utility/Stream.h"
+
+//*****************************************************************************
+//
+//*****************************************************************************
+ROMFileMapped::ROMFileMapped( const char * filename, const char * swapped_filename )
+:	ROMFile( filename )
+,	mData( NULL )
+,	mRomSize( 0 )
+,	mSwappedCopy( false )
+{
+	IO::Path::Assign( mSwappedFilename, swapped_filename );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+ROMFileMapped::~ROMFileMapped()
+{
+	if( mData != NULL )
+	{
+		munmap( mData, mRomSize );
+	}
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+bool ROMFileMapped::Open( COutputStream & messages )
+{
+	DAEDALUS_ASSERT( mData == NULL, "Opening the file twice?" );
+
+	//
+	//	Determine which byteswapping mode to use
+	//
+	FILE *	fh( fopen( mFilename, "rb" ) );
+	if( fh == NULL )
+	{
+		return false;
+	}
+
+	u32		header;
+	bool	read_header( fread( &header, sizeof( u32 ), 1, fh ) == 1 );
+	fclose( fh );
+
+	if( !read_header || !SetHeaderMagic( header ) )
+	{
+		return false;
+	}
+
+	if( !RequiresSwapping() )
+	{
+		return Map( mFilename );
+	}
+
+	//
+	//	Anything else is swapped into a copy the first time it's opened
+	//
+	if( !IsSwappedCopyCurrent() && !WriteSwappedCopy( messages ) )
+	{
+		return false;
+	}
+
+	mSwappedCopy = true;
+	return Map( mSwappedFilename );
+}
+
+//*****************************************************************************
+//	The copy is out of date if the rom has been replaced since it was written
+//*****************************************************************************
+bool ROMFileMapped::IsSwappedCopyCurrent() const
+{
+	struct stat		rom_stat;
+	struct stat		copy_stat;
+
+	if( stat( mFilename, &rom_stat ) != 0 || stat( mSwappedFilename, &copy_stat ) != 0 )
+	{
+		return false;
+	}
+
+	return copy_stat.st_size == rom_stat.st_size && copy_stat.st_mtime >= rom_stat.st_mtime;
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+bool ROMFileMapped::WriteSwappedCopy( COutputStream & messages )
+{
+	// Write to a temporary file first, so a half written copy is never mistaken for a good one
+	IO::Filename	temp_filename;
+	IO::Path::Assign( temp_filename, mSwappedFilename );
+	IO::Path::AddExtension( temp_filename, ".tmp" );
+
+	FILE *	src( fopen( mFilename, "rb" ) );
+	if( src == NULL )
+	{
+		return false;
+	}
+
+	FILE *	dst( fopen( temp_filename, "wb" ) );
+	if( dst == NULL )
+	{
+		messages << "Unable to create swapped rom '" << temp_filename << "'\n";
+		fclose( src );
+		return false;
+	}
+
+	const u32		TEMP_BUFFER_SIZE = 1024 * 1024;
+	u8 *			p_temp_buffer( new u8[ TEMP_BUFFER_SIZE ] );
+	bool			failed( false );
+
+	while( !failed )
+	{
+		// Keep whole words together so they can be swapped
+		u32		length( fread( p_temp_buffer, 1, TEMP_BUFFER_SIZE, src ) );
+		if( length == 0 )
+			break;
+
+		CorrectSwap( p_temp_buffer, length & ~3 );
+		failed = fwrite( p_temp_buffer, 1, length, dst ) != length;
+	}
+	failed |= ferror( src ) != 0;
+
+	delete [] p_temp_buffer;
+	fclose( src );
+	failed |= fclose( dst ) != 0;
+
+	if( failed || !IO::File::Move( temp_filename, mSwappedFilename ) )
+	{
+		messages << "Failed to write swapped rom to '" << mSwappedFilename << "' - out of disk space?\n";
+		IO::File::Delete( temp_filename );
+		return false;
+	}
+
+	return true;
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+bool ROMFileMapped::Map( const char * filename )
+{
+	int		fd( open( filename, O_RDONLY ) );
+	if( fd < 0 )
+	{
+		return false;
+	}
+
+	struct stat		s;
+	if( fstat( fd, &s ) != 0 || s.st_size <= 0 || u64( s.st_size ) > 0xffffffff )
+	{
+		close( fd );
+		return false;
+	}
+
+	// The mapping is private, so patches like the CRC fixes in ROM.cpp don't reach the file
+	void *	data( mmap( NULL, size_t( s.st_size ), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 ) );
+	close( fd );
+
+	if( data == MAP_FAILED )
+	{
+		return false;
+	}
+
+	// Start reading the rom in the background, as the boot code and first DMAs will want it soon
+	madvise( data, size_t( s.st_size ), MADV_WILLNEED );
+
+	mData = reinterpret_cast< u8 * >( data );
+	mRomSize = u32( s.st_size );
+	return true;
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+bool ROMFileMapped::LoadRawData( u32 bytes_to_read, u8 *p_bytes, COutputStream & messages )
+{
+	DAEDALUS_ASSERT( mData != NULL, "Reading data when Open failed?" );
+
+	if( p_bytes == NULL || bytes_to_read > mRomSize )
+	{
+		return false;
+	}
+
+	memcpy( p_bytes, mData, bytes_to_read );
+	return true;
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+bool ROMFileMapped::ReadChunk( u32 offset, u8 * p_dst, u32 length )
+{
+	DAEDALUS_ASSERT( mData != NULL, "Reading data when Open failed?" );
+
+	if( offset > mRomSize || length > mRomSize - offset )
+	{
+		return false;
+	}
+
+	memcpy( p_dst, mData + offset, length );
+	return true;
+}
@@ -62,6 +62,30 @@ bool	PatchJumpLong( CJumpLocation jump, CCodeLabel target )
 	return true;
 }
 
+//*****************************************************************************
+//	Return the location a long jump currently targets
+//*****************************************************************************
+CCodeLabel	GetJumpTarget( CJumpLocation jump )
+{
+	const u32	JUMP_DIRECT_LONG_LENGTH = 5;
+	const u32	JUMP_LONG_LENGTH = 6;
+
+	const u8 *	p_jump_addr( jump.GetTargetU8P() );
+	s32			offset;
+
+	if( *p_jump_addr == 0xe8 || *p_jump_addr == 0xe9 )
+	{
+		offset = *reinterpret_cast< const s32 * >( p_jump_addr + 1 );
+		return CCodeLabel( p_jump_addr + JUMP_DIRECT_LONG_LENGTH + offset );
+	}
+
+	#ifdef DAEDALUS_ENABLE_ASSERTS
+	DAEDALUS_ASSERT( *p_jump_addr == 0x0f, "Unhandled jump type" );
+	#endif
+	offset = *reinterpret_cast< const s32 * >( p_jump_addr + 2 );
+	return CCodeLabel( p_jump_addr + JUMP_LONG_LENGTH + offset );
+}
+
 //*****************************************************************************
 //	As above no (need to flush on intel)
 //*****************************************************************************
@@ -22,9 +22,12 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "Core/Memory.h"
 #include "Core/CPU.h"
 #include "Core/Save.h"
+#include "Core/SaveState.h"
 #include "Core/PIF.h"
+#include "Core/Rewind.h"
 #include "Core/ROMBuffer.h"
 #include "Core/RomSettings.h"
+#include "Core/JpegKernels.h"
 
 #include "Interface/RomDB.h"
 #ifdef DAEDALUS_PSP
@@ -32,6 +35,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #endif
 
 #include "Graphics/GraphicsContext.h"
+#include "HLEAudio/AudioHLEKernels.h"
+#include "HLEAudio/AudioHLETask.h"
+#include "HLEGraphics/TnLKernels.h"
 
 #if defined(DAEDALUS_OSX) || defined(DAEDALUS_W32)
 #include "SysOSX/Debug/WebDebug.h"
@@ -44,10 +50,12 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #endif
 
 #include "Utility/FramerateLimiter.h"
+#include "Utility/Hash.h"
 #include "Utility/Synchroniser.h"
 #include "Utility/Macros.h"
 #include "Utility/Profiler.h"
 #include "Utility/Preferences.h"
+#include "Utility/ThreadPool.h"
 #ifdef DAEDALUS_PSP
 #include "Utility/Translate.h"
 #endif
@@ -172,6 +180,14 @@ static const SysEntityEntry gSysInitTable[] =
 #endif
 	{"Preference",			CPreferences::Create,		CPreferences::Destroy},
 	{"Memory",				Memory_Init,				Memory_Fini},
+	{"ThreadPool",			ThreadPool_Init,			ThreadPool_Fini},
+	{"AudioHLE",			AudioHLE_InitKernels,		NULL},
+	{"JpegKernels",			Jpeg_InitKernels,			NULL},
+	{"TnLKernels",			TnL_InitKernels,			NULL},
+	{"HashKernels",			Hash_InitKernels,			NULL},
+#ifdef DAEDALUS_AUDIO_HLE_TASKS
+	{"AudioHLETask",		AudioHLETask_Init,			AudioHLETask_Fini},
+#endif
 
 	{"Controller",			CController::Create,		CController::Destroy},
 	{"RomBuffer",			RomBuffer::Create,			RomBuffer::Destroy},
@@ -210,6 +226,8 @@ static const RomEntityEntry gRomInitTable[] =
 	{"ROM",					ROM_ReBoot,				ROM_Unload},
 	{"Controller",			CController::Reset,		CController::RomClose},
 	{"Save",				Save_Reset,				Save_Fini},
+	{"SaveState",			NULL,					SaveState_Flush},
+	{"Rewind",				Rewind_RomOpen,			Rewind_RomClose},
 #ifdef DAEDALUS_ENABLE_SYNCHRONISATION
 	{"CSynchroniser",		CSynchroniser::InitialiseSynchroniser, CSynchroniser::Destroy},
 #endif
@@ -0,0 +1,560 @@
+/*
+Copyright (C) 2012 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#include "stdafx.h"
+#include "BatchTest.h"
+
+#if defined( DAEDALUS_BATCH_TEST_ENABLED ) && defined( DAEDALUS_BATCH_BENCH )
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "Config/ConfigOptions.h"
+#include "Core/CPU.h"
+#include "Debug/Dump.h"
+#include "DynaRec/FragmentCache.h"
+#include "HLEGraphics/TextureCache.h"
+#include "System/System.h"
+#include "Utility/IO.h"
+#include "Utility/Timer.h"
+
+static bool gBatchHeadless = false;
+static bool gBatchInterpreterOnly = false;
+
+void BatchTest_ApplyPreferenceOverrides()
+{
+	if( !gBatchHeadless )
+		return;
+
+	// Benchmarks run flat out and without sound, whatever the preferences say
+	gSpeedSyncEnabled = 0;
+	gAudioPluginEnabled = APM_DISABLED;
+
+	if( gBatchInterpreterOnly )
+	{
+		gDynarecEnabled = false;
+	}
+}
+
+namespace
+{
+
+const u32 DEFAULT_BENCH_VBLS = 3000;
+
+// Sent from each child back to the parent. Plain data, so it can go straight down a pipe.
+struct SBenchResult
+{
+	bool	Completed;
+	s32		TerminationReason;
+	u32		NumVerticalBlanks;
+	u32		NumDisplayListCommands;
+	u64		NumEmulatedInstructions;
+	f32		Seconds;
+	u32		NumFragments;
+	u32		NumFragmentFlushes;
+	u32		TextureLookups;
+	u32		TextureHits;
+};
+
+struct SBenchJob
+{
+	std::string		Rom;
+	bool			Interpreter;
+	pid_t			Pid;
+	int				ReadFD;
+	SBenchResult	Result;
+	u32				BytesRead;
+	int				Status;
+	long			PeakRSSKB;
+};
+
+//*****************************************************************************
+//	Runs in the child process. Never returns.
+//*****************************************************************************
+void RunBenchChild( const char * rom, bool interpreter, u32 max_vbls, int write_fd )
+{
+	gBatchHeadless = true;
+	gBatchInterpreterOnly = interpreter;
+	gHeadlessGraphics = true;
+
+	// Keep the console quiet, so the parent's progress output is readable
+	int		null_fd( open( "/dev/null", O_WRONLY ) );
+	if( null_fd >= 0 )
+	{
+		dup2( null_fd, STDOUT_FILENO );
+		close( null_fd );
+	}
+
+	SBenchResult	result;
+	memset( &result, 0, sizeof( result ) );
+
+	if( System_Init() )
+	{
+		CBatchTestEventHandler	handler;
+		handler.SetLimits( 0, max_vbls );
+		handler.Reset();
+		BatchTest_InstallHandler( &handler );
+
+		if( System_Open( rom ) )
+		{
+			CTimer		timer;
+			CPU_Run();
+			result.Seconds = timer.GetElapsedSecondsSinceReset();
+
+			result.Completed = true;
+			result.TerminationReason = handler.GetTerminationReason();
+			result.NumVerticalBlanks = handler.GetNumVerticalBlanks();
+			result.NumDisplayListCommands = handler.GetNumDisplayListCommands();
+			result.NumEmulatedInstructions = handler.GetNumEmulatedInstructions();
+
+			// Collect these before System_Close throws them away
+#ifdef DAEDALUS_ENABLE_DYNAREC
+			result.NumFragments = gFragmentCache.GetCacheSize();
+			result.NumFragmentFlushes = gFragmentCache.GetClearCount();
+#endif
+			if( CTextureCache::IsAvailable() )
+			{
+				const CTextureCache::SStats &	stats( CTextureCache::Get()->GetStats() );
+				result.TextureLookups = stats.Lookups;
+				result.TextureHits = stats.HashHits + stats.SortedHits;
+			}
+
+			System_Close();
+		}
+
+		BatchTest_RemoveHandler();
+		System_Finalize();
+	}
+
+	const u8 *	p_data( reinterpret_cast< const u8 * >( &result ) );
+	u32			remaining( sizeof( result ) );
+	while( remaining > 0 )
+	{
+		ssize_t		written( write( write_fd, p_data, remaining ) );
+		if( written <= 0 )
+			break;
+		p_data += written;
+		remaining -= u32( written );
+	}
+	close( write_fd );
+
+	// Skip atexit handlers and stdio flushing inherited from the parent
+	_exit( result.Completed ? 0 : 1 );
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+bool StartBenchJob( SBenchJob & job, u32 max_vbls )
+{
+	int		fds[ 2 ];
+	if( pipe( fds ) != 0 )
+		return false;
+
+	// Don't let the children inherit unflushed output and write it twice
+	fflush( stdout );
+	fflush( stderr );
+
+	pid_t	pid( fork() );
+	if( pid < 0 )
+	{
+		close( fds[ 0 ] );
+		close( fds[ 1 ] );
+		return false;
+	}
+
+	if( pid == 0 )
+	{
+		close( fds[ 0 ] );
+		RunBenchChild( job.Rom.c_str(), job.Interpreter, max_vbls, fds[ 1 ] );
+	}
+
+	close( fds[ 1 ] );
+	job.Pid = pid;
+	job.ReadFD = fds[ 0 ];
+	job.BytesRead = 0;
+	memset( &job.Result, 0, sizeof( job.Result ) );
+	return true;
+}
+
+//*****************************************************************************
+//	Reads whatever the child sent before it exited. A crashed child leaves a short read.
+//*****************************************************************************
+void DrainBenchJob( SBenchJob & job )
+{
+	u8 *	p_data( reinterpret_cast< u8 * >( &job.Result ) );
+	while( job.BytesRead < sizeof( job.Result ) )
+	{
+		ssize_t		bytes( read( job.ReadFD, p_data + job.BytesRead, sizeof( job.Result ) - job.BytesRead ) );
+		if( bytes <= 0 )
+			break;
+		job.BytesRead += u32( bytes );
+	}
+	close( job.ReadFD );
+	job.ReadFD = -1;
+
+	if( job.BytesRead != sizeof( job.Result ) )
+	{
+		memset( &job.Result, 0, sizeof( job.Result ) );
+	}
+}
+
+//*****************************************************************************
+//
+//*****************************************************************************
+void GetStatusString( const SBenchJob & job, char * buffer, u32 length )
+{
+	if( WIFSIGNALED( job.Status ) )
+	{
+		snprintf( buffer, length, "crashed (signal %d)", WTERMSIG( job.Status ) );
+	}
+	else if( !job.Result.Completed )
+	{
+		snprintf( buffer, length, "failed to start" );
+	}
+	else
+	{
+		CBatchTestEventHandler::ETerminationReason	reason( CBatchTestEventHandler::ETerminationReason( job.Result.TerminationReason ) );
+		snprintf( buffer, length, "%s", CBatchTestEventHandler::GetTerminationReasonString( reason ) );
+	}
+}
+
+f64 PerSecond( f64 value, f32 seconds )
+{
+	return seconds > 0.0f ? value / seconds : 0.0;
+}
+
+const char * GetCoreName( const SBenchJob & job )
+{
+	return job.Interpreter ? "interpreter" : "dynarec";
+}
+
+//*****************************************************************************
+//	Rom names go into both files, so keep them to something that needs no escaping
+//*****************************************************************************
+std::string GetRomName( const SBenchJob & job )
+{
+	// FindFileName gives NULL for a path with no directory in it
+	const char *	name( IO::Path::FindFileName( job.Rom.c_str() ) );
+	std::string		out( name != NULL ? name : job.Rom.c_str() );
+	for( u32 i = 0; i < out.size(); ++i )
+	{
+		char	c( out[ i ] );
+		if( c == '"' || c == '\\' || c == ',' || u8( c ) < 0x20 )
+		{
+			out[ i ] = '_';
+		}
+	}
+	return out;
+}
+
+//*****************************************************************************
+//	For -compare, where each rom's dynarec run is followed by its interpreter run
+//*****************************************************************************
+void PrintComparison( const std::vector< SBenchJob > & jobs )
+{
+	printf( "\n%-32s %14s %14s %8s\n", "Rom", "Interp VI/s", "Dynarec VI/s", "Speedup" );
+	for( u32 i = 0; i + 1 < jobs.size(); i += 2 )
+	{
+		const SBenchJob &	dynarec( jobs[ i ] );
+		const SBenchJob &	interp( jobs[ i + 1 ] );
+		f64					dynarec_vis( PerSecond( dynarec.Result.NumVerticalBlanks, dynarec.Result.Seconds ) );
+		f64					interp_vis( PerSecond( interp.Result.NumVerticalBlanks, interp.Result.Seconds ) );
+
+		printf( "%-32s %14.2f %14.2f", GetRomName( dynarec ).c_str(), interp_vis, dynarec_vis );
+		if( dynarec.Result.Completed && interp.Result.Completed && interp_vis > 0.0 )
+		{
+			printf( " %7.2fx\n", dynarec_vis / interp_vis );
+		}
+		else
+		{
+			printf( " %8s\n", "-" );
+		}
+	}
+}
+
+void WriteCSVRow( FILE * fh, const SBenchJob & job )
+{
+	const SBenchResult &	r( job.Result );
+	char					status[ 64 ];
+	GetStatusString( job, status, sizeof( status ) );
+
+	fprintf( fh, "%s,%s,%s,%u,%.3f,%.2f,%.0f,%.0f,%u,%u,%u,%.4f,%ld\n",
+		GetRomName( job ).c_str(),
+		GetCoreName( job ),
+		status,
+		r.NumVerticalBlanks,
+		r.Seconds,
+		PerSecond( r.NumVerticalBlanks, r.Seconds ),
+		PerSecond( f64( r.NumEmulatedInstructions ), r.Seconds ),
+		PerSecond( r.NumDisplayListCommands, r.Seconds ),
+		r.NumFragments,
+		r.NumFragmentFlushes,
+		r.TextureLookups,
+		r.TextureLookups > 0 ? f64( r.TextureHits ) / f64( r.TextureLookups ) : 0.0,
+		job.PeakRSSKB );
+	fflush( fh );
+}
+
+void WriteJSON( FILE * fh, const std::vector< SBenchJob > & jobs )
+{
+	fprintf( fh, "[\n" );
+	for( u32 i = 0; i < jobs.size(); ++i )
+	{
+		const SBenchJob &		job( jobs[ i ] );
+		const SBenchResult &	r( job.Result );
+		char					status[ 64 ];
+		GetStatusString( job, status, sizeof( status ) );
+
+		fprintf( fh, "\t{ \"rom\": \"%s\", \"core\": \"%s\", \"status\": \"%s\", \"vbls\": %u, \"seconds\": %.3f, "
+					 "\"vi_per_s\": %.2f, \"instructions_per_s\": %.0f, \"dl_commands_per_s\": %.0f, "
+					 "\"fragments\": %u, \"fragment_flushes\": %u, "
+					 "\"texture_lookups\": %u, \"texture_hit_rate\": %.4f, \"peak_rss_kb\": %ld }%s\n",
+			GetRomName( job ).c_str(),
+			GetCoreName( job ),
+			status,
+			r.NumVerticalBlanks,
+			r.Seconds,
+			PerSecond( r.NumVerticalBlanks, r.Seconds ),
+			PerSecond( f64( r.NumEmulatedInstructions ), r.Seconds ),
+			PerSecond( r.NumDisplayListCommands, r.Seconds ),
+			r.NumFragments,
+			r.NumFragmentFlushes,
+			r.TextureLookups,
+			r.TextureLookups > 0 ? f64( r.TextureHits ) / f64( r.TextureLookups ) : 0.0,
+			job.PeakRSSKB,
+			i + 1 < jobs.size() ? "," : "" );
+	}
+	fprintf( fh, "]\n" );
+}
+
+}
+
+//*****************************************************************************
+//	daedalus --bench [--fastmem] [-interp | -compare] [-j jobs] [-vbls count] [-o output] <rom or directory>...
+//	Writes <output>.csv as each rom finishes and <output>.json at the end.
+//	--fastmem is picked up by main() before we get here; -interp turns the dynarec off,
+//	and -compare runs each rom with both the dynarec and the interpreter.
+//*****************************************************************************
+int BatchBenchMain( int argc, char* argv[] )
+{
+	long		num_jobs( sysconf( _SC_NPROCESSORS_ONLN ) );
+	u32			max_vbls( DEFAULT_BENCH_VBLS );
+	const char *	output_base( NULL );
+	bool		compare( false );
+
+	std::vector< std::string >	roms;
+
+	for( int i = 1; i < argc; ++i )
+	{
+		const char * arg( argv[i] );
+		if( strcmp( arg, "--bench" ) == 0 || strcmp( arg, "--fastmem" ) == 0 )
+		{
+			continue;
+		}
+		else if( strcmp( arg, "-interp" ) == 0 )
+		{
+			gBatchInterpreterOnly = true;
+		}
+		else if( strcmp( arg, "-compare" ) == 0 )
+		{
+			compare = true;
+		}
+		else if( strcmp( arg, "-j" ) == 0 && i+1 < argc )
+		{
+			num_jobs = atoi( argv[++i] );
+		}
+		else if( strcmp( arg, "-vbls" ) == 0 && i+1 < argc )
+		{
+			max_vbls = atoi( argv[++i] );
+		}
+		else if( strcmp( arg, "-o" ) == 0 && i+1 < argc )
+		{
+			output_base = argv[++i];
+		}
+		else if( IO::Directory::IsDirectory( arg ) )
+		{
+			MakeRomList( arg, roms );
+		}
+		else
+		{
+			roms.push_back( arg );
+		}
+	}
+
+	if( roms.empty() )
+	{
+		fprintf( stderr, "Usage: %s --bench [--fastmem] [-interp | -compare] [-j jobs] [-vbls count] [-o output] <rom or directory>...\n", argv[0] );
+		return 1;
+	}
+
+	if( num_jobs < 1 )
+		num_jobs = 1;
+	if( max_vbls == 0 )
+		max_vbls = DEFAULT_BENCH_VBLS;
+
+	IO::Filename	base;
+	if( output_base != NULL )
+	{
+		IO::Path::Assign( base, output_base );
+	}
+	else
+	{
+		IO::Filename	batchdir;
+		Dump_GetDumpDirectory( batchdir, "batch" );
+		IO::Path::Combine( base, batchdir, "bench" );
+	}
+
+	IO::Filename	csv_path;
+	IO::Filename	json_path;
+	IO::Path::Assign( csv_path, base );
+	IO::Path::AddExtension( csv_path, ".csv" );
+	IO::Path::Assign( json_path, base );
+	IO::Path::AddExtension( json_path, ".json" );
+
+	FILE *	csv_fh( fopen( csv_path, "w" ) );
+	if( csv_fh == NULL )
+	{
+		fprintf( stderr, "Unable to open '%s' for writing\n", csv_path );
+		return 1;
+	}
+	fprintf( csv_fh, "rom,core,status,vbls,seconds,vi_per_s,instructions_per_s,dl_commands_per_s,fragments,fragment_flushes,texture_lookups,texture_hit_rate,peak_rss_kb\n" );
+
+#ifndef DAEDALUS_ENABLE_DYNAREC
+	if( compare || !gBatchInterpreterOnly )
+	{
+		printf( "This build has no dynarec, so the interpreter is used throughout\n" );
+	}
+#endif
+
+	printf( "Benchmarking %u roms for %u VBLs each, %ld at a time (%s, fastmem %s)\n", u32( roms.size() ), max_vbls, num_jobs,
+			compare ? "dynarec and interpreter" : gBatchInterpreterOnly ? "interpreter" : "dynarec", gFastmemEnabled ? "on" : "off" );
+
+	std::vector< SBenchJob >	jobs;
+	for( u32 i = 0; i < roms.size(); ++i )
+	{
+		SBenchJob	job;
+		job.Rom = roms[ i ];
+		job.Interpreter = compare ? false : gBatchInterpreterOnly;
+		jobs.push_back( job );
+
+		if( compare )
+		{
+			job.Interpreter = true;
+			jobs.push_back( job );
+		}
+	}
+
+	u32							next_job( 0 );
+	u32							num_running( 0 );
+	u32							num_finished( 0 );
+
+	while( num_finished < jobs.size() )
+	{
+		while( next_job < jobs.size() && num_running < u32( num_jobs ) )
+		{
+			SBenchJob &		job( jobs[ next_job++ ] );
+			job.Status = 0;
+			job.PeakRSSKB = 0;
+
+			if( StartBenchJob( job, max_vbls ) )
+			{
+				++num_running;
+			}
+			else
+			{
+				fprintf( stderr, "Unable to start a process for %s\n", job.Rom.c_str() );
+				memset( &job.Result, 0, sizeof( job.Result ) );
+				job.Pid = -1;
+				WriteCSVRow( csv_fh, job );
+				++num_finished;
+			}
+		}
+
+		if( num_running == 0 )
+			continue;
+
+		int				status;
+		struct rusage	usage;
+		pid_t			pid( wait4( -1, &status, 0, &usage ) );
+		if( pid < 0 )
+		{
+			perror( "wait4" );
+			break;
+		}
+
+		for( u32 i = 0; i < next_job; ++i )
+		{
+			SBenchJob &		job( jobs[ i ] );
+			if( job.Pid != pid )
+				continue;
+
+			job.Pid = -1;
+			job.Status = status;
+#ifdef DAEDALUS_OSX
+			job.PeakRSSKB = usage.ru_maxrss / 1024;		// Bytes on OSX
+#else
+			job.PeakRSSKB = usage.ru_maxrss;
+#endif
+			DrainBenchJob( job );
+			WriteCSVRow( csv_fh, job );
+
+			char	status_string[ 64 ];
+			GetStatusString( job, status_string, sizeof( status_string ) );
+			printf( "[%u/%u] %s (%s): %s, %.2f VI/s\n", num_finished + 1, u32( jobs.size() ), job.Rom.c_str(), GetCoreName( job ), status_string,
+					PerSecond( job.Result.NumVerticalBlanks, job.Result.Seconds ) );
+
+			--num_running;
+			++num_finished;
+			break;
+		}
+	}
+
+	fclose( csv_fh );
+
+	FILE *	json_fh( fopen( json_path, "w" ) );
+	if( json_fh == NULL )
+	{
+		fprintf( stderr, "Unable to open '%s' for writing\n", json_path );
+		return 1;
+	}
+	WriteJSON( json_fh, jobs );
+	fclose( json_fh );
+
+	if( compare )
+	{
+		PrintComparison( jobs );
+	}
+
+	printf( "Results written to %s and %s\n", csv_path, json_path );
+	return 0;
+}
+
+#endif // DAEDALUS_BATCH_TEST_ENABLED && DAEDALUS_BATCH_BENCH
@@ -71,6 +71,7 @@ FILE * gBatchFH = NULL;
 FILE * gRomLogFH = NULL;
 CBatchTestEventHandler * gBatchTestEventHandler = NULL;
 
+#ifdef DAEDALUS_ENABLE_ASSERTS
 static EAssertResult BatchAssertHook( const char * expression, const char * file, unsigned int line, const char * msg, ... )
 {
 	char buffer[ 1024 ];
@@ -85,6 +86,7 @@ static EAssertResult BatchAssertHook( const char * expression, const char * file
 
 	return AR_IGNORE;
 }
+#endif
 
 CBatchTestEventHandler * BatchTest_GetHandler()
 {
@@ -96,6 +98,29 @@ static void BatchVblHandler( void * arg )
 	gBatchTestEventHandler->OnVerticalBlank();
 }
 
+void BatchTest_InstallHandler( CBatchTestEventHandler * handler )
+{
+	gBatchTestEventHandler = handler;
+
+#ifdef DAEDALUS_ENABLE_ASSERTS
+	//	Set up an assert hook to capture all asserts
+	SetAssertHook( BatchAssertHook );
+#endif
+
+	// Hook in our Vbl handler.
+	CPU_RegisterVblCallback( &BatchVblHandler, NULL );
+}
+
+void BatchTest_RemoveHandler()
+{
+	CPU_UnregisterVblCallback( &BatchVblHandler, NULL );
+#ifdef DAEDALUS_ENABLE_ASSERTS
+	SetAssertHook( NULL );
+#endif
+
+	gBatchTestEventHandler = NULL;
+}
+
 static void MakeNewLogFilename( IO::Filename & filepath, const char * rundir )
 {
 	u32 count = 0;
@@ -192,7 +217,7 @@ void BatchTestMain( int argc, char* argv[] )
 		}
 	}
 
-	gBatchTestEventHandler = new CBatchTestEventHandler();
+	CBatchTestEventHandler * handler = new CBatchTestEventHandler();
 
 	IO::Filename logpath;
 	MakeNewLogFilename( logpath, rundir );
@@ -212,11 +237,7 @@ void BatchTestMain( int argc, char* argv[] )
 
 	CTimer	timer;
 
-	//	Set up an assert hook to capture all asserts
-	SetAssertHook( BatchAssertHook );
-
-	// Hook in our Vbl handler.
-	CPU_RegisterVblCallback( &BatchVblHandler, NULL );
+	BatchTest_InstallHandler( handler );
 
 	IO::Filename tmpfilepath;
 	IO::Path::Combine( tmpfilepath, rundir, "tmp.tmp" );
@@ -289,14 +310,12 @@ void BatchTestMain( int argc, char* argv[] )
 
 	}
 
-	CPU_UnregisterVblCallback( &BatchVblHandler, NULL );
-	SetAssertHook( NULL );
+	BatchTest_RemoveHandler();
 
 	fclose( gBatchFH );
 	gBatchFH = NULL;
 
-	delete gBatchTestEventHandler;
-	gBatchTestEventHandler = NULL;
+	delete handler;
 }
 
 // Should make these configurable
@@ -305,8 +324,14 @@ const u32 MAX_VBLS_WITHOUT_DL = 1000;
 const f32 BATCH_TIME_LIMIT = 60.0f;
 
 CBatchTestEventHandler::CBatchTestEventHandler()
-:	mNumDisplayListsCompleted( 0 )
+:	mMaxDisplayLists( MAX_DLS )
+,	mMaxVerticalBlanks( 0 )
+,	mNumDisplayListsCompleted( 0 )
+,	mNumDisplayListCommands( 0 )
+,	mNumVerticalBlanks( 0 )
 ,	mNumVerticalBlanksSinceDisplayList( 0 )
+,	mNumEmulatedInstructions( 0 )
+,	mLastCount( 0 )
 ,	mTerminationReason( TR_UNKNOWN )
 {
 
@@ -315,23 +340,34 @@ CBatchTestEventHandler::CBatchTestEventHandler()
 void CBatchTestEventHandler::Reset()
 {
 	mNumDisplayListsCompleted = 0;
+	mNumDisplayListCommands = 0;
+	mNumVerticalBlanks = 0;
 	mNumVerticalBlanksSinceDisplayList = 0;
+	mNumEmulatedInstructions = 0;
+	mLastCount = 0;
 	mTimer.Reset();
 	mTerminationReason = TR_UNKNOWN;
 	mAsserts.clear();
 }
 
+void CBatchTestEventHandler::SetLimits( u32 max_display_lists, u32 max_vertical_blanks )
+{
+	mMaxDisplayLists = max_display_lists;
+	mMaxVerticalBlanks = max_vertical_blanks;
+}
+
 void CBatchTestEventHandler::Terminate( ETerminationReason reason )
 {
 	mTerminationReason = reason;
 	CPU_Halt( "End of batch run" );
 }
 
-void CBatchTestEventHandler::OnDisplayListComplete()
+void CBatchTestEventHandler::OnDisplayListComplete( u32 num_commands )
 {
 	++mNumDisplayListsCompleted;
+	mNumDisplayListCommands += num_commands;
 	mNumVerticalBlanksSinceDisplayList = 0;
-	if( MAX_DLS != 0 && mNumDisplayListsCompleted >= MAX_DLS )
+	if( mMaxDisplayLists != 0 && mNumDisplayListsCompleted >= mMaxDisplayLists )
 	{
 		Terminate( TR_REACHED_DL_COUNT );
 	}
@@ -339,6 +375,21 @@ void CBatchTestEventHandler::OnDisplayListComplete()
 
 void CBatchTestEventHandler::OnVerticalBlank()
 {
+	// COUNT advances by COUNTER_INCREMENT_PER_OP for each op, so this counts the ops emulated since the last VBL
+	u32 count( gCPUState.CPUControl[C0_COUNT]._u32 );
+	if( mNumVerticalBlanks > 0 )
+	{
+		mNumEmulatedInstructions += ( count - mLastCount ) / COUNTER_INCREMENT_PER_OP;
+	}
+	mLastCount = count;
+
+	++mNumVerticalBlanks;
+	if( mMaxVerticalBlanks != 0 && mNumVerticalBlanks >= mMaxVerticalBlanks )
+	{
+		Terminate( TR_REACHED_VBL_COUNT );
+		return;
+	}
+
 	++mNumVerticalBlanksSinceDisplayList;
 	if( mNumVerticalBlanksSinceDisplayList > MAX_VBLS_WITHOUT_DL )
 	{
@@ -351,6 +402,7 @@ void CBatchTestEventHandler::OnVerticalBlank()
 	}
 }
 
+#ifdef DAEDALUS_ENABLE_ASSERTS
 EAssertResult CBatchTestEventHandler::OnAssert( const char * expression, const char * file, unsigned int line, const char * formatted_msg )
 {
 	u32		assert_hash( murmur2_hash( (const u8 *)file, strlen( file ), line ) );
@@ -369,6 +421,7 @@ EAssertResult CBatchTestEventHandler::OnAssert( const char * expression, const c
 	// Don't return AR_IGNORE as this prevents asserts firing for subsequent roms
 	return AR_IGNORE_ONCE;
 }
+#endif
 
 void CBatchTestEventHandler::OnDebugMessage( const char * msg )
 {
@@ -384,6 +437,7 @@ const char * CBatchTestEventHandler::GetTerminationReasonString( ETerminationRea
 	{
 	case TR_UNKNOWN:						return "Unknown";
 	case TR_REACHED_DL_COUNT:				return "Reached display list count";
+	case TR_REACHED_VBL_COUNT:				return "Reached vertical blank count";
 	case TR_TIME_LIMIT_REACHED:				return "Time limit reached";
 	case TR_TOO_MANY_VBLS_WITH_NO_DL:		return "Too many vertical blanks without a display list";
 	}
@@ -399,7 +453,7 @@ void CBatchTestEventHandler::PrintSummary( FILE * fh )
 
 	fprintf( fh, "\n\nSummary:\n--------\n\n" );
 	fprintf( fh, "Termination Reason: [%s] - %s\n", success ? " OK " : "FAIL", reason );
-	fprintf( fh, "Display Lists Completed: %d / %d\n", mNumDisplayListsCompleted, MAX_DLS );
+	fprintf( fh, "Display Lists Completed: %d / %d\n", mNumDisplayListsCompleted, mMaxDisplayLists );
 }
 
 
@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include <stdio.h>
 
+#include <string>
 #include <vector>
 
 #include "Utility/Timer.h"
@@ -34,30 +35,48 @@ public:
 	{
 		TR_UNKNOWN						= -1,
 		TR_REACHED_DL_COUNT				= 0,
+		TR_REACHED_VBL_COUNT			= 1,
 		TR_TIME_LIMIT_REACHED			= 0x80000000,
 		TR_TOO_MANY_VBLS_WITH_NO_DL,
 	};
 
 	void				Reset();
 
+	// 0 for no limit. Defaults to MAX_DLS display lists and no VBL limit
+	void				SetLimits( u32 max_display_lists, u32 max_vertical_blanks );
+
 	void				Terminate( ETerminationReason reason );
 
-	void				OnDisplayListComplete();
+	void				OnDisplayListComplete( u32 num_commands );
 	void				OnVerticalBlank();
 	void				OnDebugMessage( const char * msg );
 
+#ifdef DAEDALUS_ENABLE_ASSERTS
 	EAssertResult		OnAssert( const char * expression, const char * file, unsigned int line, const char * formatted_msg );
+#endif
 
 	ETerminationReason	GetTerminationReason() const { return mTerminationReason; }
 
+	u32					GetNumDisplayListsCompleted() const		{ return mNumDisplayListsCompleted; }
+	u32					GetNumDisplayListCommands() const		{ return mNumDisplayListCommands; }
+	u32					GetNumVerticalBlanks() const			{ return mNumVerticalBlanks; }
+	u64					GetNumEmulatedInstructions() const		{ return mNumEmulatedInstructions; }
+	u32					GetNumAsserts() const					{ return mAsserts.size(); }
+
 	void				PrintSummary( FILE * fh );
 
 	static const char * GetTerminationReasonString( ETerminationReason reason );
 
 private:
 	CTimer				mTimer;
+	u32					mMaxDisplayLists;
+	u32					mMaxVerticalBlanks;
 	u32					mNumDisplayListsCompleted;
+	u32					mNumDisplayListCommands;
+	u32					mNumVerticalBlanks;
 	u32					mNumVerticalBlanksSinceDisplayList;
+	u64					mNumEmulatedInstructions;
+	u32					mLastCount;				// C0_COUNT at the last VBL
 	ETerminationReason	mTerminationReason;
 
 	std::vector<u32>	mAsserts;
@@ -65,6 +84,26 @@ private:
 
 CBatchTestEventHandler * BatchTest_GetHandler();
 
+// Hooks the handler into the VBL callbacks and the assert handler
+void BatchTest_InstallHandler( CBatchTestEventHandler * handler );
+void BatchTest_RemoveHandler();
+
+void MakeRomList( const char * romdir, std::vector< std::string > & roms );
+
 void BatchTestMain( int argc, char* argv[] );
 
+// Forks a process per rom, so needs POSIX
+#if defined( DAEDALUS_LINUX ) || defined( DAEDALUS_OSX )
+#define DAEDALUS_BATCH_BENCH
+#endif
+
+#ifdef DAEDALUS_BATCH_BENCH
+// Runs each rom for a fixed number of VBLs with no sound and a hidden window, and reports how fast it went.
+// Call this instead of System_Init - each rom gets its own process, which does its own init.
+int BatchBenchMain( int argc, char* argv[] );
+
+// Called once the rom's preferences are applied, to turn off anything that would skew the results
+void BatchTest_ApplyPreferenceOverrides();
+#endif
+
 #endif
@@ -21,6 +21,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "stdafx.h"
 #include "Utility/Hash.h"
 
+#include <string.h>
+
+#include "Debug/DBGConsole.h"
+
 //-----------------------------------------------------------------------------
 // MurmurHash2, by Austin Appleby
 // Note - This code makes a few assumptions about how your machine behaves -
@@ -132,3 +136,165 @@ unsigned int murmur2_neutral_hash ( const void * key, int len, unsigned int seed
 
 	return h;
 }
+
+//-----------------------------------------------------------------------------
+// fast_hash. See Hash.h for the outline.
+//-----------------------------------------------------------------------------
+
+static const u64 kPrime32_1 = 0x9E3779B1ULL;
+static const u64 kPrime32_2 = 0x85EBCA77ULL;
+static const u64 kPrime32_3 = 0xC2B2AE3DULL;
+static const u64 kPrime64_1 = 0x9E3779B185EBCA87ULL;
+static const u64 kPrime64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const u64 kPrime64_3 = 0x165667B19E3779F9ULL;
+static const u64 kPrime64_4 = 0x85EBCA77C2B2AE63ULL;
+static const u64 kPrime64_5 = 0x27D4EB2F165667C5ULL;
+
+// Arbitrary, from splitmix64
+static const u64 gHashKey[ kHashKeySize ] =
+{
+	0x86d0d5e90be5c834ULL, 0x6cf07ccc9da2e949ULL, 0x4ad27b5569fdfd8dULL, 0x7f6efe19e6607319ULL,
+	0xd16d8bf8f57cb6f3ULL, 0x598c4e0b750cef73ULL, 0xeab12a602d3b8a69ULL, 0x0c1fb218b23b337dULL,
+	0xb83ab94bcb2457a0ULL, 0x8dfc60963750040fULL, 0x93cac9156fd8024dULL, 0x28e3af155d698407ULL,
+	0x2894d6bdf670b12aULL, 0x9523c9816dc70104ULL, 0xea934d56cc92fb4fULL, 0x29cbc565e950903aULL,
+	0x761c4e8795398af4ULL, 0xa9683b922f3f8e31ULL, 0xf31e260ee7dc5ebaULL, 0x4c03fc450155a138ULL,
+	0xe4f1e56769a196a3ULL, 0xaa72946276e5732eULL, 0xb2c13b3548594722ULL, 0x7163a47343d022a6ULL,
+};
+
+static inline u64 HashRead64( const u8 * p )
+{
+	u64 v;
+	memcpy( &v, p, sizeof( v ) );
+	return v;
+}
+
+static inline void AccumulateStripe( u64 * acc, const u8 * data, const u64 * key )
+{
+	for( u32 i = 0; i < 8; ++i )
+	{
+		u64 d = HashRead64( data + i * 8 );
+		u64 k = d ^ key[ i ];
+		acc[ i ^ 1 ] += d;
+		acc[ i ]     += ( k & 0xffffffff ) * ( k >> 32 );
+	}
+}
+
+static inline void ScrambleAccumulators( u64 * acc, const u64 * key )
+{
+	for( u32 i = 0; i < 8; ++i )
+	{
+		u64 a = acc[ i ];
+		a ^= a >> 47;
+		a ^= key[ kHashStripesPerBlock + i ];
+		acc[ i ] = a * kPrime32_1;
+	}
+}
+
+static void AccumulateBlocks_Scalar( u64 * acc, const u8 * data, u32 num_blocks, const u64 * key )
+{
+	for( u32 b = 0; b < num_blocks; ++b )
+	{
+		for( u32 s = 0; s < kHashStripesPerBlock; ++s )
+		{
+			AccumulateStripe( acc, data + s * kHashStripeSize, key + s );
+		}
+		ScrambleAccumulators( acc, key );
+		data += kHashBlockSize;
+	}
+}
+
+// The 128 bit product of a and b, folded to 64 bits. Done in 32 bit pieces, as not every compiler has a 128 bit type.
+static inline u64 MulFold64( u64 a, u64 b )
+{
+	u64 a_lo = a & 0xffffffff, a_hi = a >> 32;
+	u64 b_lo = b & 0xffffffff, b_hi = b >> 32;
+
+	u64 lo_lo = a_lo * b_lo;
+	u64 hi_lo = a_hi * b_lo;
+	u64 lo_hi = a_lo * b_hi;
+	u64 hi_hi = a_hi * b_hi;
+
+	u64 cross = ( lo_lo >> 32 ) + ( hi_lo & 0xffffffff ) + lo_hi;
+	u64 upper = ( hi_lo >> 32 ) + ( cross >> 32 ) + hi_hi;
+	u64 lower = ( cross << 32 ) | ( lo_lo & 0xffffffff );
+	return lower ^ upper;
+}
+
+u64 fast_hash_kernels( const HashKernels & kernels, const void * key, u32 len, u64 seed )
+{
+	const u8 * data = (const u8 *)key;
+
+	u64 acc[ 8 ] = { kPrime32_3, kPrime64_1, kPrime64_2, kPrime64_3, kPrime64_4, kPrime32_2, kPrime64_5, kPrime32_1 };
+	for( u32 i = 0; i < 8; ++i )
+	{
+		acc[ i ] += ( i & 1 ) ? 0 - seed : seed;
+	}
+
+	u32 num_blocks = len / kHashBlockSize;
+	if( num_blocks > 0 )
+	{
+		kernels.AccumulateBlocks( acc, data, num_blocks, gHashKey );
+	}
+
+	// The rest is less than a block, so it's not worth vectorising
+	u32 offset  = num_blocks * kHashBlockSize;
+	u32 stripe  = 0;
+	for( ; offset + kHashStripeSize <= len; offset += kHashStripeSize, ++stripe )
+	{
+		AccumulateStripe( acc, data + offset, gHashKey + stripe );
+	}
+	if( offset < len )
+	{
+		// Zero padded. The length is mixed in below, so this doesn't collide with real zeros.
+		u8 last[ kHashStripeSize ];
+		memset( last, 0, sizeof( last ) );
+		memcpy( last, data + offset, len - offset );
+		AccumulateStripe( acc, last, gHashKey + stripe );
+	}
+
+	u64 h = len * kPrime64_1;
+	for( u32 i = 0; i < 4; ++i )
+	{
+		h += MulFold64( acc[ 2 * i ] ^ gHashKey[ 4 * i + 1 ], acc[ 2 * i + 1 ] ^ gHashKey[ 4 * i + 3 ] );
+	}
+
+	h ^= h >> 37;
+	h *= 0x165667919E3779F9ULL;
+	h ^= h >> 32;
+	return h;
+}
+
+u64 fast_hash( const void * key, u32 len, u64 seed )
+{
+	return fast_hash_kernels( *gHashKernels, key, len, seed );
+}
+
+const HashKernels gHashKernelsScalar =
+{
+	"Scalar",
+	AccumulateBlocks_Scalar,
+};
+
+const HashKernels * gHashKernels = &gHashKernelsScalar;
+
+const HashKernels * Hash_SelectKernels()
+{
+#ifdef DAEDALUS_HASH_X86
+	__builtin_cpu_init();
+	if( __builtin_cpu_supports( "avx2" ) )
+		return &gHashKernelsAVX2;
+	if( __builtin_cpu_supports( "sse2" ) )
+		return &gHashKernelsSSE2;
+#endif
+	return &gHashKernelsScalar;
+}
+
+bool Hash_InitKernels()
+{
+	gHashKernels = Hash_SelectKernels();
+
+	#ifdef DAEDALUS_DEBUG_CONSOLE
+	DBGConsole_Msg( 0, "Hash kernels: %s", gHashKernels->Name );
+	#endif
+	return true;
+}
@@ -22,7 +22,52 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #ifndef UTILITY_HASH_H_
 #define UTILITY_HASH_H_
 
+#include "Utility/DaedalusTypes.h"
+
+// As with the JPEG kernels, the SSE2 and AVX2 versions are built with
+// per-function target attributes and picked at runtime.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DAEDALUS_HASH_X86
+#endif
+
 unsigned int murmur2_hash ( const void * key, int len, unsigned int seed );
 unsigned int murmur2_neutral_hash ( const void * key, int len, unsigned int seed );
 
+//
+//	A 64 bit hash of every byte of a buffer, after XXH3. Data is consumed in
+//	64 byte stripes, each mixed into eight 64 bit accumulators with a 32x32->64
+//	multiply per lane, so it maps straight onto vector registers. Every 16
+//	stripes (a block) the accumulators are scrambled.
+//
+//	The result depends only on the bytes, length and seed: every set of
+//	kernels must give the same hash - see Utility/Hash_bench.cpp.
+//
+static const u32	kHashStripeSize		= 64;
+static const u32	kHashStripesPerBlock	= 16;
+static const u32	kHashBlockSize		= kHashStripeSize * kHashStripesPerBlock;
+static const u32	kHashKeySize		= kHashStripesPerBlock + 8;		// In u64s. The scramble uses the last 8.
+
+struct HashKernels
+{
+	const char *	Name;
+
+	// Mixes num_blocks whole blocks from data into acc[8]. data needn't be aligned.
+	void	(*AccumulateBlocks)( u64 * acc, const u8 * data, u32 num_blocks, const u64 * key );
+};
+
+extern const HashKernels	gHashKernelsScalar;
+#ifdef DAEDALUS_HASH_X86
+extern const HashKernels	gHashKernelsSSE2;
+extern const HashKernels	gHashKernelsAVX2;
+#endif
+
+// The fastest set of kernels this CPU supports. Scalar until Hash_InitKernels is called.
+extern const HashKernels *	gHashKernels;
+
+const HashKernels *			Hash_SelectKernels();
+bool						Hash_InitKernels();
+
+u64		fast_hash( const void * key, u32 len, u64 seed );
+u64		fast_hash_kernels( const HashKernels & kernels, const void * key, u32 len, u64 seed );
+
 #endif // UTILITY_HASH_H_
@@ -0,0 +1,151 @@
+/*
+Copyright (C) 2006 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+//
+//	SSE2 and AVX2 versions of AccumulateBlocks in Hash.cpp. Each 64 bit lane
+//	does exactly what the scalar code does to the matching accumulator, so the
+//	hashes are identical. The scalar code's acc[i ^ 1] += d is a swap of the
+//	32 bit halves of each 128 bit lane pair.
+//
+
+#include "stdafx.h"
+#include "Utility/Hash.h"
+
+#ifdef DAEDALUS_HASH_X86
+
+#include <immintrin.h>
+
+#define TARGET_SSE2		__attribute__((target("sse2")))
+#define TARGET_AVX2		__attribute__((target("avx2")))
+
+//*****************************************************************************
+//	SSE2
+//*****************************************************************************
+TARGET_SSE2 static inline __m128i AccumulateLane_SSE2( __m128i acc, const u8 * data, const u64 * key )
+{
+	__m128i d    = _mm_loadu_si128( (const __m128i *)data );
+	__m128i k    = _mm_xor_si128( d, _mm_loadu_si128( (const __m128i *)key ) );
+	__m128i prod = _mm_mul_epu32( k, _mm_srli_epi64( k, 32 ) );
+	__m128i swap = _mm_shuffle_epi32( d, _MM_SHUFFLE( 1, 0, 3, 2 ) );
+	return _mm_add_epi64( _mm_add_epi64( acc, swap ), prod );
+}
+
+TARGET_SSE2 static inline __m128i ScrambleLane_SSE2( __m128i acc, const u64 * key )
+{
+	const __m128i prime = _mm_set1_epi32( (int)0x9E3779B1 );
+
+	acc = _mm_xor_si128( acc, _mm_srli_epi64( acc, 47 ) );
+	acc = _mm_xor_si128( acc, _mm_loadu_si128( (const __m128i *)key ) );
+
+	// 64x32 multiply: the low half's product, plus the high half's shifted up
+	__m128i lo = _mm_mul_epu32( acc, prime );
+	__m128i hi = _mm_mul_epu32( _mm_srli_epi64( acc, 32 ), prime );
+	return _mm_add_epi64( lo, _mm_slli_epi64( hi, 32 ) );
+}
+
+TARGET_SSE2 static void AccumulateBlocks_SSE2( u64 * acc, const u8 * data, u32 num_blocks, const u64 * key )
+{
+	__m128i a[ 4 ];
+	for( u32 i = 0; i < 4; ++i )
+	{
+		a[ i ] = _mm_loadu_si128( (const __m128i *)( acc + i * 2 ) );
+	}
+
+	for( u32 b = 0; b < num_blocks; ++b )
+	{
+		for( u32 s = 0; s < kHashStripesPerBlock; ++s )
+		{
+			const u8 *	stripe = data + s * kHashStripeSize;
+			for( u32 i = 0; i < 4; ++i )
+			{
+				a[ i ] = AccumulateLane_SSE2( a[ i ], stripe + i * 16, key + s + i * 2 );
+			}
+		}
+		for( u32 i = 0; i < 4; ++i )
+		{
+			a[ i ] = ScrambleLane_SSE2( a[ i ], key + kHashStripesPerBlock + i * 2 );
+		}
+		data += kHashBlockSize;
+	}
+
+	for( u32 i = 0; i < 4; ++i )
+	{
+		_mm_storeu_si128( (__m128i *)( acc + i * 2 ), a[ i ] );
+	}
+}
+
+const HashKernels gHashKernelsSSE2 =
+{
+	"SSE2",
+	AccumulateBlocks_SSE2,
+};
+
+//*****************************************************************************
+//	AVX2
+//*****************************************************************************
+TARGET_AVX2 static inline __m256i AccumulateLane_AVX2( __m256i acc, const u8 * data, const u64 * key )
+{
+	__m256i d    = _mm256_loadu_si256( (const __m256i *)data );
+	__m256i k    = _mm256_xor_si256( d, _mm256_loadu_si256( (const __m256i *)key ) );
+	__m256i prod = _mm256_mul_epu32( k, _mm256_srli_epi64( k, 32 ) );
+	__m256i swap = _mm256_shuffle_epi32( d, _MM_SHUFFLE( 1, 0, 3, 2 ) );
+	return _mm256_add_epi64( _mm256_add_epi64( acc, swap ), prod );
+}
+
+TARGET_AVX2 static inline __m256i ScrambleLane_AVX2( __m256i acc, const u64 * key )
+{
+	const __m256i prime = _mm256_set1_epi32( (int)0x9E3779B1 );
+
+	acc = _mm256_xor_si256( acc, _mm256_srli_epi64( acc, 47 ) );
+	acc = _mm256_xor_si256( acc, _mm256_loadu_si256( (const __m256i *)key ) );
+
+	__m256i lo = _mm256_mul_epu32( acc, prime );
+	__m256i hi = _mm256_mul_epu32( _mm256_srli_epi64( acc, 32 ), prime );
+	return _mm256_add_epi64( lo, _mm256_slli_epi64( hi, 32 ) );
+}
+
+TARGET_AVX2 static void AccumulateBlocks_AVX2( u64 * acc, const u8 * data, u32 num_blocks, const u64 * key )
+{
+	__m256i a0 = _mm256_loadu_si256( (const __m256i *)( acc + 0 ) );
+	__m256i a1 = _mm256_loadu_si256( (const __m256i *)( acc + 4 ) );
+
+	for( u32 b = 0; b < num_blocks; ++b )
+	{
+		for( u32 s = 0; s < kHashStripesPerBlock; ++s )
+		{
+			const u8 *	stripe = data + s * kHashStripeSize;
+			a0 = AccumulateLane_AVX2( a0, stripe +  0, key + s + 0 );
+			a1 = AccumulateLane_AVX2( a1, stripe + 32, key + s + 4 );
+		}
+		a0 = ScrambleLane_AVX2( a0, key + kHashStripesPerBlock + 0 );
+		a1 = ScrambleLane_AVX2( a1, key + kHashStripesPerBlock + 4 );
+		data += kHashBlockSize;
+	}
+
+	_mm256_storeu_si256( (__m256i *)( acc + 0 ), a0 );
+	_mm256_storeu_si256( (__m256i *)( acc + 4 ), a1 );
+}
+
+const HashKernels gHashKernelsAVX2 =
+{
+	"AVX2",
+	AccumulateBlocks_AVX2,
+};
+
+#endif // DAEDALUS_HASH_X86
@@ -0,0 +1,251 @@
+// Benchmark for fast_hash, the texture cache's content hash. Checks the scalar, SSE2 and AVX2 kernels
+// give the same hash for every length and alignment, then times each of them against the sampled hash
+// the texture cache used before (5 rows of 16 bytes) over textures of typical sizes.
+// Also replays a simple frame, where only a few textures' pages are written, to show how much hashing
+// Core/DirtyPages.h saves.
+
+#include "stdafx.h"
+#include "Core/DirtyPages.h"
+#include "Utility/Hash.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+static const u32	kRamSize = 8 * 1024 * 1024;
+static const u32	kMinHashedBytes = 2u * 1024 * 1024 * 1024;
+static const u32	kTexturesPerFrame = 200;
+static const u32	kWrittenTexturesPerFrame = 8;
+static const u32	kNumFrames = 1000;
+
+struct STextureSize
+{
+	const char *	Name;
+	u32				Pitch;
+	u32				Height;
+};
+
+static const STextureSize	gTextureSizes[] =
+{
+	{ "32x32 16bpp",	 64,  32 },
+	{ "64x32 16bpp",	128,  32 },
+	{ "64x64 32bpp",	256,  64 },
+	{ "320x240 16bpp",	640, 240 },		// A framebuffer, e.g. for motion blur
+};
+
+static u32 gRandomSeed = 0x12345678;
+
+static u32 Random()
+{
+	gRandomSeed = gRandomSeed * 1664525 + 1013904223;
+	return gRandomSeed;
+}
+
+// The sampled hash TextureInfo::GenerateHashValue used to compute: 5 rows of 16 bytes, or all of it if smaller
+static u32 SampledHash( const u8 * p, u32 length )
+{
+	const u32	kCheckRows = 5;
+	const u32 *	ptr_u32 = (const u32 *)p;
+	u32			step = length >> 2;
+	u32			hash_value = 0;
+
+	if( step < ( kCheckRows << 2 ) )
+	{
+		for( u32 z = 0; z < step; z++ )
+		{
+			hash_value = ( ( hash_value << 1 ) | ( hash_value >> 0x1F ) ) ^ ptr_u32[ z ];
+		}
+	}
+	else
+	{
+		step = ( step - 4 ) / kCheckRows;
+		for( u32 y = 0; y < kCheckRows; y++ )
+		{
+			hash_value = ( ( hash_value << 1 ) | ( hash_value >> 0x1F ) ) ^ ptr_u32[ 0 ];
+			hash_value = ( ( hash_value << 1 ) | ( hash_value >> 0x1F ) ) ^ ptr_u32[ 1 ];
+			hash_value = ( ( hash_value << 1 ) | ( hash_value >> 0x1F ) ) ^ ptr_u32[ 2 ];
+			hash_value = ( ( hash_value << 1 ) | ( hash_value >> 0x1F ) ) ^ ptr_u32[ 3 ];
+			ptr_u32 += step;
+		}
+	}
+	return hash_value;
+}
+
+static std::vector< const HashKernels * > GetKernels()
+{
+	std::vector< const HashKernels * >	kernels;
+	kernels.push_back( &gHashKernelsScalar );
+#ifdef DAEDALUS_HASH_X86
+	__builtin_cpu_init();
+	if( __builtin_cpu_supports( "sse2" ) )	kernels.push_back( &gHashKernelsSSE2 );
+	if( __builtin_cpu_supports( "avx2" ) )	kernels.push_back( &gHashKernelsAVX2 );
+#endif
+	return kernels;
+}
+
+static bool CheckKernelsMatch( const std::vector< const HashKernels * > & kernels, const u8 * ram )
+{
+	u32	num_mismatches = 0;
+	u32	num_checks = 0;
+
+	for( u32 length = 0; length <= 3 * kHashBlockSize + 2 * kHashStripeSize; ++length )
+	{
+		for( u32 align = 0; align < 8; ++align )
+		{
+			u64	seed = length & 1 ? 0 : Random();
+			u64	expected = fast_hash_kernels( gHashKernelsScalar, ram + align, length, seed );
+
+			for( size_t k = 1; k < kernels.size(); ++k )
+			{
+				if( fast_hash_kernels( *kernels[ k ], ram + align, length, seed ) != expected )
+				{
+					if( num_mismatches++ < 10 )
+					{
+						printf( "  %s differs from scalar for length %u, alignment %u\n", kernels[ k ]->Name, length, align );
+					}
+				}
+			}
+			++num_checks;
+		}
+	}
+
+	// Flipping any one bit should change the hash
+	std::vector< u8 >	copy( ram, ram + 4096 );
+	u64	original = fast_hash_kernels( gHashKernelsScalar, copy.data(), copy.size(), 0 );
+	u32	num_collisions = 0;
+	for( u32 bit = 0; bit < copy.size() * 8; ++bit )
+	{
+		copy[ bit >> 3 ] ^= 1 << ( bit & 7 );
+		if( fast_hash_kernels( gHashKernelsScalar, copy.data(), copy.size(), 0 ) == original )
+		{
+			++num_collisions;
+		}
+		copy[ bit >> 3 ] ^= 1 << ( bit & 7 );
+	}
+
+	printf( "Checked %u lengths/alignments: %u mismatches. Single bit flips in 4KB: %u collisions\n\n", num_checks, num_mismatches, num_collisions );
+	return num_mismatches == 0 && num_collisions == 0;
+}
+
+template< typename F >
+static double TimeHashes( const u8 * ram, u32 length, u32 iterations, F hash, u64 * p_sink )
+{
+	auto	start = std::chrono::high_resolution_clock::now();
+	u64		sink = 0;
+	u32		offset = 0;
+	for( u32 i = 0; i < iterations; ++i )
+	{
+		sink += hash( ram + offset, length );
+
+		// Walk through RDRAM, as textures don't all sit in L1
+		offset += ( length + 4095 ) & ~4095;
+		if( offset + length > kRamSize )
+			offset = 0;
+	}
+	auto	end = std::chrono::high_resolution_clock::now();
+
+	*p_sink += sink;
+	return std::chrono::duration< double >( end - start ).count();
+}
+
+static void SimulateFrames( const u8 * ram, u64 * p_sink )
+{
+	// Textures scattered through RDRAM, a few of which are written each frame
+	const u32			kTextureSize = 64 * 32 * 2;
+	std::vector< u32 >	addresses;
+	for( u32 i = 0; i < kTexturesPerFrame; ++i )
+	{
+		addresses.push_back( ( Random() % ( kRamSize - kTextureSize ) ) & ~7 );
+	}
+
+	std::vector< u32 >	hash_epochs( kTexturesPerFrame, 0 );
+	u64					num_hashed = 0;
+	u64					sink = 0;
+
+	auto	start = std::chrono::high_resolution_clock::now();
+	for( u32 frame = 0; frame < kNumFrames; ++frame )
+	{
+		for( u32 i = 0; i < kWrittenTexturesPerFrame; ++i )
+		{
+			DirtyPages_MarkRange( addresses[ Random() % kTexturesPerFrame ], kTextureSize );
+		}
+		DirtyPages_NextEpoch();
+
+		for( u32 i = 0; i < kTexturesPerFrame; ++i )
+		{
+			if( DirtyPages_WrittenSince( addresses[ i ], kTextureSize, hash_epochs[ i ] ) )
+			{
+				hash_epochs[ i ] = DirtyPages_GetEpoch();
+				sink += fast_hash( ram + addresses[ i ], kTextureSize, 0 );
+				++num_hashed;
+			}
+		}
+	}
+	auto	end = std::chrono::high_resolution_clock::now();
+
+	double	tracked = std::chrono::duration< double >( end - start ).count();
+
+	start = std::chrono::high_resolution_clock::now();
+	for( u32 frame = 0; frame < kNumFrames; ++frame )
+	{
+		for( u32 i = 0; i < kTexturesPerFrame; ++i )
+		{
+			sink += fast_hash( ram + addresses[ i ], kTextureSize, 0 );
+		}
+	}
+	end = std::chrono::high_resolution_clock::now();
+
+	double	untracked = std::chrono::duration< double >( end - start ).count();
+
+	printf( "\n%u frames of %u 64x32 textures, %u written per frame:\n", kNumFrames, kTexturesPerFrame, kWrittenTexturesPerFrame );
+	printf( "  Hash every texture:      %8.2f us/frame\n", untracked * 1e6 / kNumFrames );
+	printf( "  Hash written textures:   %8.2f us/frame (%.1f hashed per frame, including page tracking)\n",
+			tracked * 1e6 / kNumFrames, double( num_hashed ) / kNumFrames );
+
+	*p_sink += sink;
+}
+
+int main( int argc, char ** argv )
+{
+	std::vector< u8 >	ram( kRamSize + 64 );
+	for( size_t i = 0; i < ram.size(); ++i )
+	{
+		ram[ i ] = u8( Random() >> 24 );
+	}
+
+	std::vector< const HashKernels * >	kernels( GetKernels() );
+
+	if( !CheckKernelsMatch( kernels, ram.data() ) )
+	{
+		printf( "FAILED\n" );
+		return 1;
+	}
+
+	u64	sink = 0;
+
+	printf( "%-16s %-8s %12s %12s\n", "Texture", "Kernels", "ns/texture", "GB/s" );
+	for( const STextureSize & size : gTextureSizes )
+	{
+		u32	length = size.Pitch * size.Height;
+		u32	iterations = kMinHashedBytes / length;
+
+		double	t = TimeHashes( ram.data(), length, iterations, SampledHash, &sink );
+		printf( "%-16s %-8s %12.1f %12s\n", size.Name, "Sampled", t * 1e9 / iterations, "-" );
+
+		for( const HashKernels * k : kernels )
+		{
+			auto	hash = [k]( const u8 * p, u32 len ) { return fast_hash_kernels( *k, p, len, 0 ); };
+
+			t = TimeHashes( ram.data(), length, iterations, hash, &sink );
+			printf( "%-16s %-8s %12.1f %12.2f\n", size.Name, k->Name, t * 1e9 / iterations, double( length ) * iterations / t / 1e9 );
+		}
+	}
+
+	Hash_InitKernels();
+	SimulateFrames( ram.data(), &sink );
+
+	printf( "\n(%llx)\n", (unsigned long long)sink );
+	return 0;
+}
@@ -209,6 +209,12 @@ bool	ROMFileCompressed::Seek( u32 offset, u8 * p_scratch_block, u32 block_size )
 	int		err;
 	u32		current_offset( unztell( mZipFile ) );
 
+	// Sequential reads don't need to seek, whatever size they are
+	if( current_offset == offset )
+	{
+		return true;
+	}
+
 	DAEDALUS_ASSERT( (current_offset % block_size) == 0, "Performance: Trying to seek and current offset isn't a multiple of the block size" );
 	DAEDALUS_ASSERT( (offset % block_size) == 0, "Performance: Trying to seek to an address which isn't the block size" );
 
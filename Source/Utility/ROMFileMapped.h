@@ -0,0 +1,75 @@
+/*
+Copyright (C) 2006 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#pragma once
+
+#ifndef UTILITY_ROMFILEMAPPED_H_
+#define UTILITY_ROMFILEMAPPED_H_
+
+#include "ROMFile.h"
+
+// Implemented with mmap in SysPosix/Utility/ROMFileMappedPosix.cpp
+#if defined( DAEDALUS_LINUX ) || defined( DAEDALUS_OSX )
+#define DAEDALUS_MAPPED_ROMS
+#endif
+
+#ifdef DAEDALUS_MAPPED_ROMS
+
+//
+//	Maps an uncompressed rom into memory rather than reading it in, so pages are
+//	only loaded from disk as the game touches them.
+//	Roms which aren't already in our byte order are converted once into
+//	swapped_filename, and that copy is mapped from then on.
+//
+class ROMFileMapped : public ROMFile
+{
+public:
+	ROMFileMapped( const char * filename, const char * swapped_filename );
+	virtual ~ROMFileMapped();
+
+	virtual bool		Open( COutputStream & messages );
+
+	virtual bool		IsCompressed() const			{ return false; }
+	virtual u32			GetRomSize() const				{ return mRomSize; }
+
+	virtual bool		ReadChunk( u32 offset, u8 * p_dst, u32 length );
+
+			// The whole rom, already swapped. Writes are private to this process.
+			u8 *		GetData() const					{ return mData; }
+
+			// True if the data comes from swapped_filename rather than the rom itself
+			bool		IsSwappedCopy() const			{ return mSwappedCopy; }
+
+private:
+	virtual bool		LoadRawData( u32 bytes_to_read, u8 *p_bytes, COutputStream & messages );
+
+			bool		IsSwappedCopyCurrent() const;
+			bool		WriteSwappedCopy( COutputStream & messages );
+			bool		Map( const char * filename );
+
+private:
+	IO::Filename		mSwappedFilename;
+	u8 *				mData;
+	u32					mRomSize;
+	bool				mSwappedCopy;
+};
+
+#endif // DAEDALUS_MAPPED_ROMS
+
+#endif // UTILITY_ROMFILEMAPPED_H_
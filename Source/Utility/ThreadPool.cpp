@@ -0,0 +1,207 @@
+/*
+Copyright (C) 2001,2006-2007 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#include "stdafx.h"
+#include "ThreadPool.h"
+
+// The PSP has no Cond implementation, and its second CPU is driven by the JobManager instead
+#ifndef DAEDALUS_PSP
+#define DAEDALUS_THREAD_POOL_WORKERS
+#endif
+
+#ifdef DAEDALUS_THREAD_POOL_WORKERS
+
+#include <thread>
+#include <vector>
+
+#include "Debug/DBGConsole.h"
+#include "Utility/Cond.h"
+#include "Utility/Mutex.h"
+#include "Utility/Thread.h"
+
+// The jobs run on the pool are short, so beyond this more threads mostly add wakeup latency
+static const u32			kMaxWorkers = 7;
+
+static Mutex				gCallMutex( "ThreadPoolCall" );	// Serialises ParallelFor callers
+static Mutex				gPoolMutex( "ThreadPool" );
+static Cond *				gWorkCond {};		// Signalled when there are batches left to take, or the workers should quit
+static Cond *				gDoneCond {};		// Signalled when the last batch finishes
+static std::vector< ThreadHandle >	gWorkers;
+
+// The job in progress, protected by gPoolMutex
+static bool					gQuit {};
+static ThreadPoolJob		gJob {};
+static void *				gJobArg {};
+static u32					gJobCount {};
+static u32					gJobBatchSize {};
+static u32					gJobNext {};
+static u32					gJobDone {};
+
+// Takes batches of the current job until there are none left. Called with gPoolMutex held.
+static void ThreadPool_RunBatches()
+{
+	while( gJobNext < gJobCount )
+	{
+		u32		begin( gJobNext );
+		u32		end( gJobCount - begin > gJobBatchSize ? begin + gJobBatchSize : gJobCount );
+		gJobNext = end;
+
+		// Wake another worker to take the next batch
+		if( gJobNext < gJobCount )
+		{
+			CondSignal( gWorkCond );
+		}
+
+		ThreadPoolJob	job( gJob );
+		void *			arg( gJobArg );
+
+		gPoolMutex.Unlock();
+		job( arg, begin, end );
+		gPoolMutex.Lock();
+
+		gJobDone += end - begin;
+		if( gJobDone == gJobCount )
+		{
+			CondSignal( gDoneCond );
+		}
+	}
+}
+
+static u32 DAEDALUS_THREAD_CALL_TYPE ThreadPool_WorkerThread( void * arg )
+{
+	MutexLock	lock( &gPoolMutex );
+
+	while( !gQuit )
+	{
+		if( gJobNext < gJobCount )
+		{
+			ThreadPool_RunBatches();
+		}
+		else
+		{
+			CondWait( gWorkCond, &gPoolMutex, kTimeoutInfinity );
+		}
+	}
+	return 0;
+}
+
+bool ThreadPool_Init()
+{
+	gWorkCond = CondCreate();
+	gDoneCond = CondCreate();
+	if( gWorkCond == NULL || gDoneCond == NULL )
+		return false;
+
+	u32		num_cores( std::thread::hardware_concurrency() );
+	u32		num_workers( num_cores > 1 ? num_cores - 1 : 0 );
+	if( num_workers > kMaxWorkers )
+	{
+		num_workers = kMaxWorkers;
+	}
+
+	for( u32 i {}; i < num_workers; ++i )
+	{
+		ThreadHandle	handle( CreateThread( "ThreadPool", ThreadPool_WorkerThread, NULL ) );
+		if( handle == kInvalidThreadHandle )
+			break;
+
+		gWorkers.push_back( handle );
+	}
+
+	#ifdef DAEDALUS_DEBUG_CONSOLE
+	DBGConsole_Msg( 0, "Thread pool: %d workers", (u32)gWorkers.size() );
+	#endif
+	return true;
+}
+
+void ThreadPool_Fini()
+{
+	{
+		MutexLock	lock( &gPoolMutex );
+		gQuit = true;
+		for( size_t i {}; i < gWorkers.size(); ++i )
+		{
+			CondSignal( gWorkCond );
+		}
+	}
+
+	for( size_t i {}; i < gWorkers.size(); ++i )
+	{
+		JoinThread( gWorkers[ i ], -1 );
+		ReleaseThreadHandle( gWorkers[ i ] );
+	}
+	gWorkers.clear();
+	gQuit = false;
+
+	if( gWorkCond != NULL )	{ CondDestroy( gWorkCond ); gWorkCond = NULL; }
+	if( gDoneCond != NULL )	{ CondDestroy( gDoneCond ); gDoneCond = NULL; }
+}
+
+void ThreadPool_ParallelFor( u32 count, u32 batch_size, ThreadPoolJob job, void * arg )
+{
+	if( gWorkers.empty() || count <= batch_size )
+	{
+		if( count > 0 )
+		{
+			job( arg, 0, count );
+		}
+		return;
+	}
+
+	MutexLock	call_lock( &gCallMutex );
+	MutexLock	lock( &gPoolMutex );
+
+	gJob = job;
+	gJobArg = arg;
+	gJobCount = count;
+	gJobBatchSize = batch_size;
+	gJobNext = 0;
+	gJobDone = 0;
+
+	ThreadPool_RunBatches();
+
+	while( gJobDone < gJobCount )
+	{
+		CondWait( gDoneCond, &gPoolMutex, kTimeoutInfinity );
+	}
+
+	gJobCount = 0;
+	gJobNext = 0;
+}
+
+#else // DAEDALUS_THREAD_POOL_WORKERS
+
+bool ThreadPool_Init()
+{
+	return true;
+}
+
+void ThreadPool_Fini()
+{
+}
+
+void ThreadPool_ParallelFor( u32 count, u32 batch_size, ThreadPoolJob job, void * arg )
+{
+	if( count > 0 )
+	{
+		job( arg, 0, count );
+	}
+}
+
+#endif // DAEDALUS_THREAD_POOL_WORKERS
@@ -0,0 +1,44 @@
+/*
+Copyright (C) 2001,2006-2007 StrmnNrmn
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#pragma once
+
+#ifndef UTILITY_THREADPOOL_H_
+#define UTILITY_THREADPOOL_H_
+
+#include "Utility/DaedalusTypes.h"
+
+// Called with a range of items [begin, end) to process
+typedef void ( * ThreadPoolJob )( void * arg, u32 begin, u32 end );
+
+//
+//	Starts a worker for each core after the first. Until this is called
+//	(and on platforms without threads) ThreadPool_ParallelFor runs jobs inline.
+//
+bool	ThreadPool_Init();
+void	ThreadPool_Fini();
+
+//
+//	Splits [0, count) into batches of batch_size items and runs job on them across the pool.
+//	The calling thread takes batches too, and doesn't return until all of them are done.
+//	Calls from different threads take turns. Jobs mustn't call ParallelFor themselves.
+//
+void	ThreadPool_ParallelFor( u32 count, u32 batch_size, ThreadPoolJob job, void * arg );
+
+#endif // UTILITY_THREADPOOL_H_